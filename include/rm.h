@@ -78,6 +78,7 @@
 #include "rm_error.h"
 #include "rm_util.h"
 #include "md5.h"
+#include "rm_prof.h"
 
 
 /* @brief   Strong checksum struct. MD5. */
@@ -91,6 +92,9 @@ struct rm_ch_ch
 {
 	uint32_t        f_ch;   /* Fast and cheap 32-bit rolling checksum,
 							 * MUST be cheap to compute at every byte offset */
+	uint32_t        c_ch;   /* CRC32C of block, computed (and sent) only if session
+							 * has RM_PREFILTER_CRC32C, 0 otherwise. Fast checksum matches
+							 * are checked with it before strong checksum is computed. */
 	struct rm_md5   s_ch;   /* Strong and computationally expensive 128-bit checksum,
 							 * MUST have a very low probability of collision.
 							 * This is computed only when fast & cheap checksum matches
@@ -137,10 +141,14 @@ struct rm_delta_e
 {
 	enum RM_DELTA_ELEMENT_TYPE  type;
 	size_t                      ref;
-	unsigned char               *raw_bytes;
+	unsigned char               *raw_bytes;     /* NULL for literal range (RM_PUSH_TX): bytes are at @raw_off in @x */
 	size_t                      raw_bytes_n;
+	uint64_t                    raw_off;
 	struct twlist_head          link;           /* to link me in list/stack/queue */
 };
+/* memory held by delta element @e while it is queued */
+#define rm_delta_e_queue_charge(e)	(sizeof(struct rm_delta_e) + ((e)->type == RM_DELTA_ELEMENT_RAW_BYTES && (e)->raw_bytes != NULL ? (e)->raw_bytes_n : 0))
+
 enum rm_tx_status
 {
 	RM_TX_STATUS_OK                 = 0,    /* WANTED */
@@ -151,7 +159,7 @@ enum rm_rx_status
 	RM_RX_STATUS_OK                 = 0,    /* most wanted */
 	RM_RX_STATUS_INTERNAL_ERR       = 1,    /* bad call, NULL session, prvt session or file pointers */
 	RM_RX_STATUS_DELTA_RX_ACCEPT_FAIL	= 2,	/* accept on delta socket error */
-	RM_RX_STATUS_DELTA_RX_TCP_FAIL	= 3,	/* error while reading socket in rm_session_delta_rx_f_remote */
+	RM_RX_STATUS_DELTA_RX_TCP_FAIL	= 3,	/* error while reading delta stream from socket */
 	RM_RX_STATUS_DELTA_PROC_FAIL    = 4,	/* error processing delta element */
 	RM_RX_STATUS_CH_CH_RX_TCP_DISCONNECT	= 5,	/* read 0 bytes while reading socket in rm_session_ch_ch_rx_f - receiver closed connection prematurely */
 	RM_RX_STATUS_CH_CH_RX_TCP_FAIL	= 6,	/* error while reading socket in rm_session_ch_ch_rx_f */
@@ -159,7 +167,11 @@ enum rm_rx_status
 	RM_RX_STATUS_CONNECT_TIMEOUT	= 8,
 	RM_RX_STATUS_CONNECT_REFUSED	= 9,
 	RM_RX_STATUS_CONNECT_HOSTUNREACH	= 10,
-	RM_RX_STATUS_CONNECT_GEN_ERR	= 11
+	RM_RX_STATUS_CONNECT_GEN_ERR	= 11,
+	RM_RX_STATUS_DIGEST_TX_FAIL		= 12,	/* error while transmitting digest of @x after delta stream */
+	RM_RX_STATUS_DIGEST_RX_FAIL		= 13,	/* error while reading digest of @x after delta stream */
+	RM_RX_STATUS_DIGEST_MISMATCH	= 14,	/* digest of reconstructed @z differs from digest of @x */
+	RM_RX_STATUS_CH_CH_RX_SPILL		= 15	/* checksums can't be spilled to disk (rm_spill) */
 };
 enum rm_reconstruct_method
 {
@@ -167,6 +179,33 @@ enum rm_reconstruct_method
 	RM_RECONSTRUCT_METHOD_COPY_BUFFERED         = 1     /* @y doesn't exist and --forced flag is specified, rolling proc is not used, file is simply copied,
 														   rec_ctx->delta_raw_n == 1, rec_ctx->rec_by_raw == file size */
 };
+enum rm_integrity_status
+{
+	RM_INTEGRITY_NOT_CHECKED    = 0,    /* no digest computed (empty file, copy buffered or rolling proc failed) */
+	RM_INTEGRITY_SENT           = 1,    /* transmitter: digest of @x has been sent to receiver after delta stream */
+	RM_INTEGRITY_OK             = 2,    /* digest of reconstructed @z equals digest of @x */
+	RM_INTEGRITY_MISMATCH       = 3     /* digest of reconstructed @z differs from digest of @x */
+};
+struct rm_ch_ch_hash_stats
+{
+	uint8_t                     bits;       /* hashtable of nonoverlapping checksums has 2^bits buckets, 0: no table (directory push: biggest table) */
+	size_t                      buckets_n;
+	size_t                      entries_n;
+	size_t                      used_n;     /* buckets with at least one checksum */
+	size_t                      chain_max;
+	size_t                      chain_hist[RM_HASH_CHAIN_HIST_N];   /* buckets by number of checksums in them, last counts all longer chains */
+};
+struct rm_ch_ch_spill_stats
+{
+	uint64_t                    entries_n;  /* checksums spilled to disk, 0: spill not used */
+	size_t                      runs_n;     /* sorted runs merged */
+	size_t                      filter_bytes;
+	uint8_t                     filter_k;   /* hashes per fast checksum */
+	size_t                      index_bytes;
+	uint64_t                    probes_n;   /* fast checksums filter let through */
+	uint64_t                    false_n;    /* of them not in sorted file */
+	uint64_t                    reads_n;    /* pages of sorted file read */
+};
 struct rm_delta_reconstruct_ctx
 {
 	enum rm_reconstruct_method  method; /* updated by rx thread */
@@ -180,9 +219,28 @@ struct rm_delta_reconstruct_ctx
 	size_t                      send_threshold; /* limit on the value of bytes to be sent in a single delta RAW element */
 	uint8_t                     copy_all_threshold_fired, copy_tail_threshold_fired; /* updated by tx thread */
 	struct timespec             time_real; /* updated by main thread (tx_local_push)*/
+	struct timespec             time_setup; /* remote push: from session start until receiver accepted request (MSG_PUSH_ACK), updated by main thread (tx_remote_push) */
 	double                      time_cpu;
 	size_t                      collisions_1st_level, collisions_2nd_level, collisions_3rd_level; /* updated by rx thread */
 	uint16_t					msg_push_len;
+	enum rm_integrity_status    integrity; /* updated by rx thread */
+	struct rm_md5               x_digest; /* MD5 of @x, computed by tx thread in rolling proc */
+	struct rm_md5               z_digest; /* MD5 of @z, computed by rx thread as elements are reconstructed */
+	size_t                      delta_queue_limit; /* bytes of delta elements allowed in queue before rolling proc waits, 0: no limit */
+	size_t                      delta_queue_bytes_peak; /* max bytes held by delta queue */
+	size_t                      delta_queue_stalls_n; /* number of times rolling proc waited for space in delta queue */
+	double                      delta_queue_stall_time; /* seconds rolling proc spent waiting for space in delta queue */
+	struct rm_prof              prof; /* per-stage timing of rolling proc and delta consumer (RM_PROF builds only, zeroed otherwise) */
+	uint8_t                     codec, codec_level; /* remote push: RM_CODEC_* of literal payloads accepted by receiver */
+	size_t                      rec_by_raw_z; /* remote push with codec: literal payload bytes on the wire (compressed and stored) */
+	size_t                      rec_by_raw_stored; /* remote push with codec: literal bytes sent stored (too short or incompressible) */
+	struct rm_ch_ch_hash_stats  h_stats; /* transmitter: chain lengths of checksums hashtable rolling proc searched */
+	struct rm_ch_ch_spill_stats spill_stats; /* transmitter: checksums kept on disk because hashtable wouldn't fit memory limit */
+	size_t                      next_tried_n, next_hit_n; /* transmitter: block following last matched one verified before hashtable lookup, and matched */
+	uint8_t                     roll; /* RM_ROLL_* of fast checksums, remote push: accepted by receiver */
+	uint64_t                    roll_seed; /* RM_ROLL_POLY: seed of session */
+	uint8_t                     prefilter; /* RM_PREFILTER_* of checksums, remote push: accepted by receiver */
+	size_t                      prefilter_pass_n, prefilter_reject_n; /* transmitter: fast checksum matches which CRC32C confirmed (MD5 computed then) and rejected (counted in collisions_2nd_level too) */
 };
 
 /* @brief   Calculate similar to adler32 fast checksum on a given
@@ -246,6 +304,59 @@ rm_fast_check_roll(uint32_t adler, unsigned char a_k,
 uint32_t
 rm_fast_check_roll_tail(uint32_t adler, unsigned char a_k, size_t L);
 
+/* @brief   Rolling checksum used for fast checksums of session.
+ * @details RM_ROLL_FAST keeps fast checksum itself as state. RM_ROLL_POLY state
+ *          is sum of table[byte] * base^(len-1-i) mod 2^64 over bytes of window,
+ *          table is drawn from per-session seed, so blocks of low entropy data
+ *          (text, runs of zeros) don't fall on few fast checksums and can't be
+ *          crafted to collide. Fast checksum is high half of state. */
+struct rm_roll {
+	uint8_t             type;           /* RM_ROLL_* */
+	size_t              L;              /* window */
+	uint64_t            pow;            /* RM_ROLL_POLY: base^(L-1) */
+	uint64_t            table[256];     /* RM_ROLL_POLY: values of bytes */
+};
+
+/* @brief   Prepare rolling checksum @type over windows of @L bytes, @seed is used by RM_ROLL_POLY. */
+void
+rm_roll_init(struct rm_roll *r, uint8_t type, uint64_t seed, size_t L) __attribute__((nonnull(1)));
+
+/* @brief   Rolling checksum state of @len bytes at @data. */
+uint64_t
+rm_roll_block(const struct rm_roll *r, const unsigned char *data, size_t len) __attribute__((nonnull(1,2)));
+
+/* @brief   Rolls state @h of window [k,k+L-1] to [k+1,k+L]. */
+uint64_t
+rm_roll_roll(const struct rm_roll *r, uint64_t h, unsigned char a_k, unsigned char a_kL) __attribute__((nonnull(1)));
+
+/* @brief   Removes byte @a_k from front of window of @len bytes with state @h. */
+uint64_t
+rm_roll_roll_tail(const struct rm_roll *r, uint64_t h, unsigned char a_k, size_t len) __attribute__((nonnull(1)));
+
+/* @brief   Rolls state @h of window at @data through @n offsets, @res[i] gets state of window at @data + 1 + i.
+ * @details Same as @n calls of rm_roll_roll, L + @n bytes at @data are read. RM_ROLL_FAST
+ *          computes 16 offsets at once with prefix sums in vector registers (AVX2 on
+ *          x86-64 CPUs which have it), RM_ROLL_POLY depends on previous state and rolls
+ *          offsets one by one. */
+void
+rm_roll_batch(const struct rm_roll *r, uint64_t h, const unsigned char *data, size_t n, uint64_t res[]) __attribute__((nonnull(1,3,5)));
+
+/* @brief   Fast checksum of window with state @h. */
+uint32_t
+rm_roll_f_ch(const struct rm_roll *r, uint64_t h) __attribute__((nonnull(1)));
+
+uint8_t
+rm_roll_supported(uint8_t type);
+
+const char*
+rm_roll_str(uint8_t type);
+
+/* @brief   Parse rolling checksum name (fast, poly).
+ * @return  RM_ERR_OK - parsed,
+ *          RM_ERR_ARG - unknown name */
+enum rm_error
+rm_roll_parse(const char *s, uint8_t *type) __attribute__((nonnull(1,2)));
+
 /* @brief   Calculate rolling checksum on a given file block
  *          of size @len starting from @data, modulo @M.
  * @details @M MUST be less than 2^16, 0x10000 */
@@ -259,6 +370,23 @@ rm_rolling_ch(const unsigned char *data, size_t len, uint32_t M);
 void
 rm_md5(const unsigned char *data, size_t len, unsigned char res[16]);
 
+/* @brief   Strong checksums of @n independent blocks, @res[i] gets MD5 of @len[i] bytes at @data[i].
+ * @details Up to RM_MD5_LANES blocks are hashed in parallel lanes of vector registers
+ *          (AVX2 on x86-64 CPUs which have it), digests are the same as of rm_md5.
+ *          Blocks may differ in length, lanes of shorter blocks idle. */
+void
+rm_md5_lanes(const unsigned char *const data[], const size_t len[], unsigned char *const res[], size_t n);
+
+/* @brief   CRC32C (Castagnoli) of @len bytes at @data continuing @crc (0 at start).
+ * @details Uses SSE4.2 crc32 instruction on x86-64 CPUs which have it,
+ *          table driven otherwise. */
+uint32_t
+rm_crc32c(uint32_t crc, const unsigned char *data, size_t len);
+
+/* @brief   Table driven CRC32C, same result as rm_crc32c on any CPU. */
+uint32_t
+rm_crc32c_sw(uint32_t crc, const unsigned char *data, size_t len);
+
 /* @brief   Copy @bytes_n bytes from @x into @y.
  * @details Calls fread/fwrite buffered API functions.
  *          Files must be already opened.
@@ -269,6 +397,12 @@ rm_md5(const unsigned char *data, size_t len, unsigned char res[16]);
 enum rm_error
 rm_copy_buffered(FILE *x, FILE *y, size_t bytes_n, pthread_mutex_t *file_mutex);
 
+/* @brief   Copy @bytes_n bytes from @x into @y updating @md5 context.
+ * @details As rm_copy_buffered, each chunk written to @y is also fed
+ *          into @md5 (if not NULL) so no extra read of @y is needed. */
+enum rm_error
+rm_copy_buffered_md5(FILE *x, FILE *y, size_t bytes_n, pthread_mutex_t *file_mutex, MD5_CTX *md5);
+
 /* @brief   Copy @bytes_n bytes from @x starting at @offset
  *          into @dst buffer.
  * @details Calls fread buffered API functions writing directly to @dst.
@@ -307,14 +441,24 @@ rm_fpwrite(const void *buf, size_t size, size_t items_n, size_t offset, FILE *f,
 enum rm_error
 rm_copy_buffered_offset(FILE *x, FILE *y, size_t bytes_n, size_t x_offset, size_t y_offset, pthread_mutex_t *file_mutex);
 
+/* @brief   Copy @bytes_n bytes from @x at offset @x_offset into @y at @y_offset
+ *          updating @md5 context.
+ * @details As rm_copy_buffered_offset, each chunk written to @y is also fed
+ *          into @md5 (if not NULL). */
+enum rm_error
+rm_copy_buffered_offset_md5(FILE *x, FILE *y, size_t bytes_n, size_t x_offset, size_t y_offset, pthread_mutex_t *file_mutex, MD5_CTX *md5);
+
 typedef enum rm_error (rm_delta_f)(void*);
 
 struct rm_session;
 
 /* @brief   Rolling checksum procedure.
- * @details Runs rolling checksum procedure using @rm_fast_check_roll
+ * @details Runs rolling checksum procedure using rolling checksum of session (rec_ctx.roll)
  *          to move the checksum, starting from byte @from.
  * @param   h - hashtable of nonoverlapping checkums,
+ * @param   h_bits - @h has 2^h_bits buckets,
+ * @param   h_mutex - lock of @h (may be NULL), held for whole procedure, @h must be
+ *          complete when rolling starts,
  * @param   f_x - file on which rolling is performed, must be already opened,
  * @param   delta_f - tx/reconstruct callback, NOTE: this callback takes ownership
  *          of the delta elements allocated by rolling proc - this function MUST
@@ -322,13 +466,18 @@ struct rm_session;
  * @param   L - block size,
  * @param   from - starting point, 0 to start from beginning
  * PARAMETERS TAKEN FROM session's RECONSTRUCTION CONTEXT
- * @param   copy_all_threshold - single RM_DELTA_ELEMENT_RAW_BYTES element
- *          will be passed to delta_f callback if file f_x size is below this threshold,
- * @param   copy_tail_threshold - tail will be sent as single RM_DELTA_ELEMENT_RAW_BYTES
- *          element if less than this bytes to roll has left
+ * @param   copy_all_threshold - whole file f_x will be passed to delta_f callback
+ *          as RM_DELTA_ELEMENT_RAW_BYTES elements if its size is below this threshold,
+ * @param   copy_tail_threshold - tail will be sent as RM_DELTA_ELEMENT_RAW_BYTES
+ *          elements if less than this bytes to roll has left (elements copied
+ *          this way are at most RM_DELTA_RAW_BUF_LEN bytes each)
  * @param   send_threshold - raw bytes will not be sent if there is less than this number of them
  *          in the buffer unless delta reference elements is being produced, that means
  *          raw bytes will be sent if delta element comes or @send_threshold has been reached
+ *          On success MD5 of all bytes of @x addressed by delta elements is stored
+ *          in session's rec_ctx.x_digest (computed as elements are produced, no extra I/O).
+ *          Block following the one matched last is verified first (if fast checksums
+ *          are equal) without hashtable lookup, edits leave most blocks in order.
  * @return  RM_ERR_OK - success,
  *          RM_ERR_BAD_CALL - NULL session or file has been passed, L is 0 or send threshold is 0
  *          RM_ERR_FSTAT_X - fstat failed on @x,
@@ -340,7 +489,7 @@ struct rm_session;
  *          RM_ERR_TX_TAIL - tx on tail failed,
  *          RM_ERR_TX_ZERO_DIFF - zero difference tx failed */
 enum rm_error
-rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_mutex_t *h_mutex,
+rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, uint8_t h_bits, pthread_mutex_t *h_mutex,
 		FILE *f_x, rm_delta_f *delta_f, size_t from);
 
 /* @brief   Start execution of @f function in new thread.
@@ -361,9 +510,13 @@ struct rm_roll_proc_cb_arg
  *          This is being called from rolling checksum proc
  *          rm_rolling_ch_proc. Enqueues delta elements to queue
  *          and signals this to delta_rx_tid in local push session.
+ *          If queue holds tx_delta_e_queue_limit bytes already, waits
+ *          until consumer makes space for the element.
  * @return  RM_ERR_OK - success,
  *          RM_ERR_BAD_CALL - callback argument and/or session and/or delta
- *          and/or private session object is NULL */
+ *          and/or private session object is NULL,
+ *          RM_ERR_QUEUE_CLOSED - consumer doesn't take elements anymore.
+ *          Ownership of delta element is taken only on success. */
 rm_delta_f
 rm_roll_proc_cb_1 __attribute__((nonnull(1)));
 
@@ -0,0 +1,121 @@
+/* @file        rm_codec.h
+ * @brief       Compression of literal (RAW_BYTES) delta payloads.
+ * @details     Codec is negotiated per session in MSG_PUSH/MSG_PUSH_ACK.
+ *              zlib context spans whole delta stream of the file, each payload
+ *              is flushed so receiver can decode it as soon as it arrives while
+ *              later payloads still refer to earlier ones. zstd payloads are
+ *              separate frames. Payloads which are too short or come after data
+ *              that didn't compress are sent stored and bypass both contexts, so
+ *              they stay in step. Payload which doesn't get smaller is sent stored
+ *              too, never expanded: compressor takes it out of its deflate window
+ *              (from its own copy of the window). zstd is available in builds
+ *              with RM_ZSTD defined (make RM_ZSTD=1), zlib always.
+ *              Reference-aware mode (RM_CODEC_REF) sets recently matched blocks
+ *              as dictionary before each compressed payload. Transmitter reads
+ *              them from @x and receiver from @y, they are equal by strong
+ *              checksum, so literals which are near-copies of matched data
+ *              (shifted records, small edits inside blocks) compress against it.
+ *              Newly matched blocks end back-off.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        20 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_CODEC_H
+#define RSYNCME_CODEC_H
+
+
+#include "rm_defs.h"
+
+#include <zlib.h>
+#ifdef RM_ZSTD
+#include <zstd.h>
+#endif
+
+
+struct rm_codec_extent {
+	uint64_t            off;            /* in file of matched blocks */
+	size_t              len;
+	size_t              ref;            /* last block */
+	uint64_t            pos;            /* in result file, merging by @ref and @pos gives the same extents on both sides */
+};
+
+struct rm_codec {
+	uint8_t             type;           /* RM_CODEC_* without RM_CODEC_REF */
+	uint8_t             level;          /* 0: codec's default */
+	uint8_t             compress;       /* compressor (transmitter) or decompressor (receiver) */
+	size_t              skip_left;      /* compressor: literal bytes to send stored before compression is tried again */
+	size_t              skip_next;      /* compressor: next back-off, doubles each time literals don't compress */
+	unsigned char       *buf;           /* compressor: output */
+	size_t              buf_size;
+	z_stream            zs;
+	unsigned char       *hist;          /* compressor (zlib): copy of deflate window, last RM_CODEC_ZLIB_DICT_MAX bytes of it, in buffer twice that size */
+	size_t              hist_n;
+	uint8_t             ref;            /* reference-aware */
+	int                 dict_fd;        /* reference-aware: file of matched blocks (@x on transmitter, @y on receiver) */
+	struct rm_codec_extent  extents[RM_CODEC_DICT_EXTENTS];    /* ring of matched blocks, newest at @extents_head - 1 */
+	uint32_t            extents_head;
+	uint32_t            extents_n;
+	uint8_t             dict_stale;     /* blocks matched since dictionary was set */
+	unsigned char       *dict;          /* RM_CODEC_DICT_MAX */
+	size_t              dict_n;
+#ifdef RM_ZSTD
+	ZSTD_CCtx           *zc;
+	ZSTD_DCtx           *zd;
+#endif
+};
+
+/* @brief   Codec can be used in this build. */
+uint8_t rm_codec_supported(uint8_t type);
+
+const char* rm_codec_str(uint8_t type);
+
+/* @brief   Parse codec given as "name[+ref][:level]" (none, zlib, zstd).
+ * @return  RM_ERR_OK - parsed,
+ *          RM_ERR_ARG - unknown name or bad level */
+enum rm_error rm_codec_parse(const char *s, uint8_t *type, uint8_t *level) __attribute__((nonnull(1,2,3)));
+
+/* @brief   Prepare compressor (@compress 1) or decompressor of delta stream.
+ * @details @dict_fd is file blocks recorded with rm_codec_dict_add are read from
+ *          if @type has RM_CODEC_REF set.
+ * @return  RM_ERR_OK - ready (nothing to do for RM_CODEC_NONE),
+ *          RM_ERR_ARG - codec not supported,
+ *          RM_ERR_MEM - no memory */
+enum rm_error rm_codec_init(struct rm_codec *c, uint8_t type, uint8_t level, uint8_t compress, int dict_fd) __attribute__((nonnull(1)));
+
+void rm_codec_free(struct rm_codec *c) __attribute__((nonnull(1)));
+
+/* @brief   Record @len bytes at @off in file of matched blocks, block @ref matched at @pos
+ *          in result by REFERENCE element.
+ * @details Both sides must record the same blocks in the same order, no-op if not reference-aware. */
+void rm_codec_dict_add(struct rm_codec *c, size_t ref, uint64_t pos, uint64_t off, size_t len) __attribute__((nonnull(1)));
+
+/* @brief   Decompressor: next compressed payload starts, sets dictionary in reference-aware mode.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_READ - can't read matched blocks,
+ *          RM_ERR_CODEC - codec refused dictionary */
+enum rm_error rm_codec_element_start(struct rm_codec *c) __attribute__((nonnull(1)));
+
+/* @brief   Max size of compressed payload of @src_n literal bytes, receiver rejects bigger. */
+size_t rm_codec_bound(size_t src_n);
+
+/* @brief   Compress literal payload @src of @src_n bytes.
+ * @details On return *dst points to *dst_n bytes of compressed payload (valid until
+ *          next call) or *dst_n is 0 and payload should be sent stored. Compressed
+ *          payload is always smaller than @src_n.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_MEM - no memory,
+ *          RM_ERR_READ - can't read matched blocks (reference-aware),
+ *          RM_ERR_CODEC - compression failed */
+enum rm_error rm_codec_compress(struct rm_codec *c, const unsigned char *src, size_t src_n, const unsigned char **dst, size_t *dst_n) __attribute__((nonnull(1,4,5)));
+
+/* @brief   Feed @src_n bytes of compressed payload to decompressor, at most @dst_n bytes
+ *          of output are written to @dst.
+ * @details Call again while input is left or output filled whole @dst.
+ *          *src_used and *dst_used both 0 means no progress can be made.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_CODEC - corrupt payload */
+enum rm_error rm_codec_decompress(struct rm_codec *c, const unsigned char *src, size_t src_n, size_t *src_used, unsigned char *dst, size_t dst_n, size_t *dst_used) __attribute__((nonnull(1,4,5,7)));
+
+
+#endif  /* RSYNCME_CODEC_H */
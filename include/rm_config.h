@@ -10,7 +10,9 @@
 
 
 #define RM_SERVER_PORT			5556	    /* control */
-#define RM_SERVER_LISTENQ		25			/* server's awaiting connections max, note: it is just a hint to the kernel */
+#define RM_SERVER_LISTENQ		1024		/* server's awaiting connections max, note: it is just a hint to the kernel (capped by somaxconn) */
+#define RM_SERVER_EPOLL_EVENTS	64			/* events handled per single wake up of daemon's event loop */
+#define RM_SERVER_MSG_TIMEOUT_S	10			/* connection must deliver complete message within that many seconds after accept */
 #define RM_TCP_MSG_MAX_LEN		256         /* maximum length of TCP control message */
 #define RM_IP_AUTH              "127.0.0.1" /* authorized IP, requests from which will be processed */
 #define RM_DEFAULT_PORT         5048u       /* default daemon's port */
@@ -16,6 +16,8 @@
 #include "twhash.h"
 #include "rm_serialize.h"
 #include "rm_wq.h"
+#include "rm_exec.h"
+#include "rm_metrics.h"
 #include "rm_session.h"
 
 #include <arpa/inet.h>
@@ -38,6 +40,8 @@ struct rsyncme
     uint32_t		M;	/* modulus in fast checksum computation, 2^16 is good choice for simplicity and speed */
 
     struct rm_workqueue     wq;
+    struct rm_exec          exec;   /* drives remote push sessions once work from wq has set them up */
+    struct rm_metrics       metrics;    /* counters served on daemon's metrics socket */
 };
 
 /* @brief  Helper struct to pass connection settings into TCP events thread. */
@@ -48,6 +48,7 @@
 #include <signal.h>
 #include <syslog.h>
 #include <stdint.h>
+#include <inttypes.h>           /* PRIu64 */
 #include <ctype.h>              /* isprint */
 #include <libgen.h>             /* dirname */
 #include <uuid/uuid.h>
@@ -71,7 +72,11 @@
 
 #define RM_UNIQUE_STRING_LEN        37u         /* including '\0' at the end, MUST be longer than sizeof(uuid_t)! */
 #define RM_SESSION_HASH_BITS        10          /* 10 bits hash, array size == 1024 */
-#define RM_NONOVERLAPPING_HASH_BITS 17          /* 17 bits hash, array size == 524 288 (131 072) */
+#define RM_NONOVERLAPPING_HASH_BITS 17          /* 17 bits hash, array size == 524 288 (131 072), fixed size used by tests */
+#define RM_NONOVERLAPPING_HASH_BITS_MIN 8       /* checksums hashtable is sized from expected number of blocks, but never smaller than 256 buckets */
+#define RM_NONOVERLAPPING_HASH_BITS_MAX 28      /* nor bigger than 2^28 buckets (2GB of bucket heads) */
+#define RM_NONOVERLAPPING_HASH_LOAD 1           /* target load factor, max checksums per bucket on average */
+#define RM_HASH_CHAIN_HIST_N        8u          /* checksums hashtable chain lengths histogram size */
 #define RM_FILE_LEN_MAX             1000        /* max len of names of @x, @y files, MUST be > RM_UNIQUE_STRING_LEN */
 #define RM_UUID_LEN                 16u			/* as uuid_t on Debian */
 
@@ -89,6 +94,7 @@
 #define RM_STRONG_CHECK_BYTES       16u
 #define RM_CH_CH_SIZE				20u
 #define RM_CH_CH_REF_SIZE			(RM_CH_CH_SIZE + 8)
+#define RM_CH_CH_PREFILTER_SIZE		(RM_CH_CH_SIZE + 4)	/* checksums followed by CRC32C of block (session with RM_PREFILTER_CRC32C) */
 #define RM_NANOSEC_PER_SEC          1000000000U
 #define RM_CORE_HASH_CHALLENGE_BITS 32u
 
@@ -103,7 +109,53 @@
 /* defaults */
 #define RM_DEFAULT_L                512u		/* default block size in bytes */
 #define RM_L1_CACHE_RECOMMENDED     8192u		/* buffer size, so that it should fit into L1 cache on most architectures */
-#define RM_WORKERS_N                8u			/* default number of workers for main work queue */
+#define RM_WORKERS_N                8u			/* number of workers for main work queue if number of online CPUs is unknown */
+#define RM_WORKERS_PER_CPU          2u			/* workers for main work queue per online CPU */
+#define RM_WORKERS_MAX              1024u
+#define RM_EXEC_EPOLL_EVENTS        64u			/* events handled per single wake up of executor thread */
+#define RM_EXEC_WAIT_MS             200			/* executor threads check for stop that often */
+#define RM_EXEC_STEP_BYTES          262144u		/* session task yields to other tasks after moving that many bytes in single step */
+#define RM_DELTA_MODE_CONN          0u			/* MSG_PUSH: deltas over dedicated connection to receiver's ephemeral port */
+#define RM_DELTA_MODE_FRAMED        1u			/* MSG_PUSH: checksums and deltas framed on control connection */
+#define RM_CODEC_NONE               0u			/* MSG_PUSH: literal delta payloads sent as they are */
+#define RM_CODEC_ZLIB               1u			/* MSG_PUSH: literal delta payloads deflated (raw deflate stream spanning whole file) */
+#define RM_CODEC_ZSTD               2u			/* MSG_PUSH: literal delta payloads compressed with zstd (builds with RM_ZSTD only) */
+#define RM_CODEC_REF                0x80u		/* MSG_PUSH: flag of codec, literal payloads compressed against recently matched blocks of @y (reference-aware) */
+#define RM_CODEC_TYPE_MASK          0x7fu
+#define RM_CODEC_DICT_MAX           262144u		/* reference-aware codec: at most that many bytes of matched blocks are used as dictionary (zlib uses last 32 KiB) */
+#define RM_CODEC_DICT_EXTENTS       64u			/* reference-aware codec: matched blocks are remembered as that many extents (adjacent blocks merge) */
+#define RM_CODEC_MIN_BYTES          64u			/* shorter literal payloads are always sent stored */
+#define RM_CODEC_SKIP_MIN           65536u		/* after literal payload which didn't compress that many literal bytes are sent stored, */
+#define RM_CODEC_SKIP_MAX           8388608u	/* back-off doubles each time it happens again, up to this */
+#define RM_ROLL_FAST                0u			/* MSG_PUSH: fast checksum is sum of bytes and sum of sums mod 2^16 (rm_fast_check_block) */
+#define RM_ROLL_POLY                1u			/* MSG_PUSH: fast checksum is high half of seeded polynomial (Rabin-Karp) hash mod 2^64 */
+#define RM_ROLL_POLY_BASE           0x9e3779b97f4a7c15ULL	/* odd, so base is invertible mod 2^64 and powers don't degenerate to 0 */
+#define RM_ROLL_BATCH               64u			/* rolling proc: checksums of that many offsets of nonmatching region are computed at once and their buckets prefetched */
+#define RM_ROLL_WIN_LEN             1048576u	/* rolling proc: read-ahead over @x which bytes entering and leaving window are taken from */
+#define RM_PREFILTER_NONE           0u			/* MSG_PUSH: strong checksum is computed for each fast checksum match */
+#define RM_PREFILTER_CRC32C         1u			/* MSG_PUSH: CRC32C of block follows its checksums, fast checksum matches are checked with it before MD5 */
+#define RM_CRC32C_POLY              0x82f63b78u	/* Castagnoli polynomial, reflected */
+#define RM_MD5_LANES                8u			/* blocks hashed at once by rm_md5_lanes, 8 x 32-bit words fill AVX2 register */
+#define RM_TREE_INFLIGHT_DEFAULT    4u			/* default number of files of directory push in flight (checksums sent, deltas not yet received) */
+#define RM_TREE_INFLIGHT_MAX        64u			/* each file in flight keeps open files and nonoverlapping checksums hashtable */
+#define RM_TREE_LIST_BUF_LEN        65536u		/* file list of directory push is coalesced into writes of that size */
+#define RM_TREE_ENTRIES_N           1024u		/* receiver allocates that many entries of file list at first and grows them as entries come, not by number announced in MSG_PUSH_TREE */
+#define RM_DELTA_QUEUE_BYTES        4194304u	/* default limit on bytes held by delta elements queued between rolling proc and delta consumer */
+#define RM_DELTA_RAW_RANGE_MAX      1048576u	/* remote push: literal runs sent from @x without copy are split into elements of at most that many bytes */
+#define RM_DELTA_RAW_BUF_LEN        65536u		/* literal ranges are read through buffer of that size for digest of @x, and sent through it if sendfile can't be used */
+#define RM_ZOUT_BUF_LEN             1048576u	/* result file is written in chunks of that size */
+#define RM_ZOUT_ALIGN               4096u		/* alignment of buffer, offset and length of O_DIRECT write */
+#define RM_METRICS_SOCKET_PATH      "/usr/local/rsyncme/rsyncme.sock"	/* daemon's metrics are served on this Unix socket */
+#define RM_METRICS_RATE_WINDOW_S    10u			/* sessions/s is averaged over that many last seconds */
+#define RM_METRICS_REQ_LEN_MAX      64u			/* metrics request line ("text" or "json") */
+#define RM_METRICS_ERRORS_N         256u		/* errors are counted per code, codes fit in 8 bits */
+#define RM_PROF_CHAIN_HIST_N        16u			/* bucket walk lengths histogram size (RM_PROF builds) */
+#define RM_CH_CH_MEM_BYTES          2147483648u	/* default limit on memory held by nonoverlapping checksums on transmitter, they are spilled to disk if hashtable wouldn't fit */
+#define RM_CH_CH_MALLOC_OVERHEAD    16u			/* bytes malloc adds to each checksum of hashtable, used to estimate its memory */
+#define RM_SPILL_MEM_MIN            1048576u	/* spill of checksums gets at least that much memory */
+#define RM_SPILL_IO_LEN             65536u		/* runs of spilled checksums are merged through buffers of that size */
+#define RM_SPILL_PAGE_RECS          128u		/* checksums per page of sorted spill file, doubled until index of pages takes at most 1/8 of memory */
+#define RM_SPILL_FILTER_K_MAX       8u			/* hashes per fast checksum in Bloom filter of spilled checksums */
 
 #define rm_container_of(ptr, type, member) __extension__({  \
 		const typeof( ((type *)0)->member ) *__mptr = (ptr);    \
@@ -120,7 +172,7 @@ typedef uint8_t rm_push_flags;  /* Bit  meaning
 								 * 4    (--force) force creation of @y if it doesn't exist
 								 * 5    IPv4 given,
 								 * 6    (--leave) do not delete @y after @z has been reconstructed,
-								 * 7 */
+								 * 7    MD5 digest of @x follows delta stream, receiver verifies @z */
 
 enum rm_session_type {
 	RM_PUSH_LOCAL,
@@ -222,7 +274,13 @@ enum rm_error {
 	RM_ERR_FSTAT_TMP = 81,
 	RM_ERR_TCP = 82,
 	RM_ERR_TCP_DISCONNECT = 83,
-	RM_ERR_UNKNOWN_ERROR = 84
+	RM_ERR_UNKNOWN_ERROR = 84,
+	RM_ERR_DIGEST_MISMATCH = 85,
+	RM_ERR_TREE_PARTIAL = 86,
+	RM_ERR_AGAIN = 87,
+	RM_ERR_TIMEOUT = 88,
+	RM_ERR_QUEUE_CLOSED = 89,
+	RM_ERR_CODEC = 90
 		/* max error code limited by size of flags in rm_msg_push_ack (8 bits, 255) */ 
 };
 
@@ -238,7 +296,10 @@ enum rm_pt_type {
 	RM_PT_MSG_PULL,
 	RM_PT_MSG_PULL_ACK,
 	RM_PT_MSG_ACK,
-	RM_PT_MSG_BYE
+	RM_PT_MSG_BYE,
+	RM_PT_MSG_PUSH_TREE,		/* directory push: roots and number of files, file list follows on the same connection */
+	RM_PT_MSG_PUSH_FILE,		/* single entry of directory push file list */
+	RM_PT_MSG_PUSH_TREE_ACK		/* directory push summary, sent by receiver after all files have been handled */
 };
 
 struct rm_core_options
@@ -248,6 +309,8 @@ struct rm_core_options
 	uint8_t		daemon;
 	uint16_t	delta_conn_timeout_s;
 	uint16_t	delta_conn_timeout_us;
+	size_t		delta_queue_bytes;	/* producer of delta elements waits once that many bytes are queued, 0: no limit */
+	uint8_t		z_direct;			/* receiver writes result files with O_DIRECT */
 };
 
 /* prototypes */
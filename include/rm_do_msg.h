@@ -46,8 +46,16 @@ struct rm_msg_push_ack {
 	struct rm_msg_ack	ack;
 	uint16_t			delta_port;				/* receiver awaits deltas on that port from transmitter of file */
 	uint64_t			ch_ch_n;				/* receiver will send that many nonoverlapping checkums */
+	uint8_t				codec;					/* RM_CODEC_* accepted by receiver for literal payloads, sent only if not RM_CODEC_NONE */
+	uint8_t				codec_level;
+	uint8_t				roll;					/* RM_ROLL_* accepted by receiver for fast checksums, sent (after codec, even if RM_CODEC_NONE) only if not RM_ROLL_FAST */
+	uint8_t				prefilter;				/* RM_PREFILTER_* accepted by receiver, sent (after roll) only if not RM_PREFILTER_NONE */
 };
 #define RM_MSG_PUSH_ACK_LEN	(RM_MSG_HDR_LEN + 2 + 8)
+#define RM_MSG_PUSH_ACK_CODEC_LEN	(RM_MSG_PUSH_ACK_LEN + 2)		/* ACK with accepted codec */
+#define RM_MSG_PUSH_ACK_ROLL_LEN	(RM_MSG_PUSH_ACK_CODEC_LEN + 1)	/* and rolling checksum */
+#define RM_MSG_PUSH_ACK_PREFILTER_LEN	(RM_MSG_PUSH_ACK_ROLL_LEN + 1)	/* and prefilter */
+#define RM_MSG_ACK_LEN_MAX	RM_MSG_PUSH_ACK_PREFILTER_LEN
 
 union rm_msg_ack_u {
 	struct rm_msg_ack		msg_ack;
@@ -67,15 +75,60 @@ struct rm_msg_push
 	char                z[RM_FILE_LEN_MAX];     /* z file name  */
 	uint16_t			ch_ch_port;				/* transmitter awaits nonoverlapping checksums on that port from receiver of file (not used yet, main connection port is used as checksums channel as of now) */
 	uint64_t			bytes;					/* number of bytes to be xfered by transmitter (these bytes will be txed by delta and/or by raw) */
+	uint8_t				delta_mode;				/* RM_DELTA_MODE_*, absent in messages of older transmitters (RM_DELTA_MODE_CONN) */
+	uint8_t				codec;					/* RM_CODEC_* requested for literal payloads, absent in messages of older transmitters (RM_CODEC_NONE) */
+	uint8_t				codec_level;			/* 0: codec's default */
+	uint8_t				roll;					/* RM_ROLL_* requested for fast checksums, absent in messages of older transmitters (RM_ROLL_FAST) */
+	uint64_t			roll_seed;				/* RM_ROLL_POLY: seed of session */
+	uint8_t				prefilter;				/* RM_PREFILTER_* requested, absent in messages of older transmitters (RM_PREFILTER_NONE) */
 };
 
+/* Directory push. Transmitter sends MSG_PUSH_TREE, waits for generic ACK
+ * and then sends @files_n MSG_PUSH_FILE entries. For each entry receiver
+ * replies with MSG_PUSH_ACK (@delta_port 0: deltas follow on this connection)
+ * and framed nonoverlapping checksums, in list order, while transmitter sends delta
+ * streams of files in the same order. Receiver ends with MSG_PUSH_TREE_ACK. */
+struct rm_msg_push_tree
+{
+	struct rm_msg_hdr	*hdr;                   /* header, MUST be first, flags apply to each file as in MSG_PUSH */
+	unsigned char       ssid[16];               /* transmitter's session id */
+	size_t              L;                      /* block size   */
+	uint16_t            inflight;               /* number of files transmitter keeps in flight */
+	uint64_t            files_n;                /* number of MSG_PUSH_FILE entries that follow */
+	uint16_t            y_sz;                   /* size of string including terminating NULL byte '\0' */
+	char                y[RM_FILE_LEN_MAX];     /* root of reference tree */
+	uint16_t            z_sz;                   /* size of string including terminating NULL byte '\0' */
+	char                z[RM_FILE_LEN_MAX];     /* root of result tree (optional) */
+	uint8_t             codec;                  /* RM_CODEC_* requested for literal payloads of each file, absent in messages of older transmitters */
+	uint8_t             codec_level;
+	uint8_t             roll;                   /* RM_ROLL_* requested for fast checksums of each file, absent in messages of older transmitters */
+	uint64_t            roll_seed;
+	uint8_t             prefilter;              /* RM_PREFILTER_* requested for each file, absent in messages of older transmitters */
+};
+
+struct rm_msg_push_file
+{
+	struct rm_msg_hdr	*hdr;                   /* header, MUST be first */
+	uint64_t			bytes;					/* size of file, number of bytes to be xfered by transmitter */
+	uint16_t            path_sz;                /* size of string including terminating NULL byte '\0' */
+	char                path[RM_FILE_LEN_MAX];  /* file name relative to the roots of the trees */
+};
+#define RM_MSG_PUSH_FILE_LEN_MAX	(RM_MSG_HDR_LEN + 8 + 2 + RM_FILE_LEN_MAX)
+
+struct rm_msg_push_tree_ack {
+	struct rm_msg_ack	ack;					/* flags = RM_ERR_OK if all files have been synced, error of first failed file otherwise */
+	uint64_t			files_ok_n;
+	uint64_t			files_fail_n;
+};
+#define RM_MSG_PUSH_TREE_ACK_LEN	(RM_MSG_HDR_LEN + 8 + 8)
+
 /* transmitter sends PULL(x,y) -> this means receiver does PUSH(y,x) */
 struct rm_msg_pull
 {
 	struct rm_msg_hdr	*hdr;                   /* header, MUST be first */
 	unsigned char       ssid[16];               /* transmitter's session id */
 	size_t              L;                      /* block size   */
-	uint32_t            ch_ch_n;                /* number of elements in the ch_ch list,
+	uint64_t            ch_ch_n;                /* number of elements in the ch_ch list,
 												   that follows this msg, ch_ch elements
 												   are being sent in chunks while computing
 												   hashes on file */
@@ -90,6 +143,13 @@ struct rm_msg_pull
 enum rm_error rm_msg_push_alloc(struct rm_msg_push *msg) __attribute__ ((nonnull(1)));
 void rm_msg_push_free(struct rm_msg_push *msg) __attribute__ ((nonnull(1)));
 
+void rm_msg_push_tree_free(struct rm_msg_push_tree *msg) __attribute__ ((nonnull(1)));
+
+/* @brief       Validate path of file of directory push received in MSG_PUSH_FILE.
+ * @return      1 if path is relative, has no empty, "." or ".." components
+ *              (so it stays below the root and names file once), 0 otherwise. */
+int rm_do_msg_push_tree_path_valid(const char *path) __attribute__ ((nonnull(1)));
+
 enum rm_error rm_msg_ack_alloc(struct rm_msg_ack *ack) __attribute__ ((nonnull(1)));
 void rm_msg_ack_free(struct rm_msg_ack *ack) __attribute__ ((nonnull(1)));
 enum rm_error rm_msg_push_ack_alloc(struct rm_msg_push_ack *ack) __attribute__ ((nonnull(1)));
@@ -104,6 +164,15 @@ void rm_msg_push_ack_free(struct rm_msg_push_ack *ack) __attribute__ ((nonnull(1
  *              but as synchronous dctor by worker thread. */
 void* rm_do_msg_push_rx(void* arg);
 
+/* @brief       Handles incoming directory push request.
+ * @details     Work struct callback for RM_WORK_PROCESS_MSG_PUSH_TREE.
+ *              Reads the file list from the control connection and syncs
+ *              each file in its own RM_PUSH_RX session. Checksums of up to
+ *              @inflight files are sent ahead by separate thread while
+ *              deltas of the oldest file are received and reconstructed
+ *              in this thread, all over the single control connection. */
+void* rm_do_msg_push_tree_rx(void* arg);
+
 /* @brief       Handles incoming rsync pull request in new sesion.
  * @details     Daemon's message. */
 int rm_do_msg_pull_rx(struct rsyncme* rm, unsigned char *buf);
@@ -115,6 +184,7 @@ uint16_t rm_calc_msg_len(void *arg);
 /* destructors */
 
 void rm_msg_push_dtor(void *arg);
+void rm_msg_push_tree_dtor(void *arg);
 
 #endif  /* RSYNCME_DO_MSG_H */
 
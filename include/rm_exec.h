@@ -0,0 +1,84 @@
+/* @file        rm_exec.h
+ * @brief       Session pipeline executor.
+ * @details     Fixed pool of threads, each driving its share of session tasks
+ *              by I/O readiness (epoll). A task is a state machine: it is stepped
+ *              when its descriptor becomes ready, does what it can without blocking
+ *              on the socket and tells what it waits for next. Number of threads
+ *              doesn't depend on the number of sessions.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 09:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_EXEC_H
+#define RSYNCME_EXEC_H
+
+
+#include "rm_defs.h"
+#include "twlist.h"
+
+
+enum rm_exec_wait {
+	RM_EXEC_WAIT_IN,                        /* step again when descriptor is readable */
+	RM_EXEC_WAIT_OUT,                       /* step again when descriptor is writable */
+	RM_EXEC_WAIT_IN_OUT,                    /* step again when descriptor is readable or writable (task both receives and sends on it) */
+	RM_EXEC_DONE                            /* task finished (successfuly or not), destructor will be called */
+};
+
+struct rm_exec_thread;
+
+struct rm_exec_task {
+	int                     fd;             /* descriptor task waits on, step may change it (e.g. listening -> accepted socket) */
+	enum rm_exec_wait (*f)(struct rm_exec_task *t);     /* step */
+	void (*f_dtor)(struct rm_exec_task *t, uint8_t aborted);    /* called once task is done or executor is stopped (@aborted set) */
+
+	int                     fd_registered;  /* internal: descriptor in epoll set */
+	enum rm_exec_wait       wait;           /* internal: events registered for fd_registered */
+	struct rm_exec_thread   *thread;        /* internal: owner */
+	struct twlist_head      link;           /* internal: in owner's list of tasks */
+};
+
+struct rm_exec_thread {
+	uint32_t                idx;
+	pthread_t               tid;
+	int                     epfd;
+	struct twlist_head      tasks;          /* tasks owned by this thread */
+	uint32_t                tasks_n;
+	uint64_t                steps_n;        /* number of steps executed, written by this thread only */
+	pthread_mutex_t         mutex;          /* protects tasks list, tasks_n and stopped */
+	uint8_t                 stopped;        /* tasks left have been (are being) aborted, new tasks are refused */
+	uint8_t                 running;        /* thread has been created and not joined yet */
+	struct rm_exec          *exec;          /* owner */
+};
+
+struct rm_exec {
+	struct rm_exec_thread   *threads;
+	uint32_t                threads_n;
+	uint32_t                next_thread_idx;    /* round-robin placement of new tasks */
+	pthread_mutex_t         mutex;              /* protects next_thread_idx */
+	volatile uint8_t        stop;               /* threads exit when set */
+};
+
+/* @brief   Default number of executor threads: one per online CPU (RM_WORKERS_N if unknown). */
+uint32_t rm_exec_threads_n_default(void);
+
+/* @brief   Start executor threads.
+ * @return  RM_ERR_OK - at least one thread running,
+ *          RM_ERR_MEM - no memory,
+ *          RM_ERR_LAUNCH_WORKER - no thread could be started */
+enum rm_error rm_exec_init(struct rm_exec *e, uint32_t threads_n) __attribute__((nonnull(1)));
+
+/* @brief   Stop and join executor threads. Tasks not finished yet are destroyed with @aborted flag set. */
+enum rm_error rm_exec_stop(struct rm_exec *e) __attribute__((nonnull(1)));
+
+/* @brief   Hand task over to the executor.
+ * @details Task's descriptor must be nonblocking. The first step is made once
+ *          @wait condition is met on task's @fd. Executor owns the task after this
+ *          returns RM_ERR_OK, caller still owns it otherwise.
+ * @return  RM_ERR_OK - task submitted,
+ *          RM_ERR_BAD_CALL - executor is stopping (or @wait is RM_EXEC_DONE),
+ *          RM_ERR_FAIL - can't wait on task's descriptor */
+enum rm_error rm_exec_submit(struct rm_exec *e, struct rm_exec_task *t, enum rm_exec_wait wait) __attribute__((nonnull(1,2)));
+
+
+#endif  /* RSYNCME_EXEC_H */
@@ -0,0 +1,74 @@
+/* @file        rm_metrics.h
+ * @brief       Daemon's live metrics.
+ * @details     Daemon-wide counters updated as sessions start and end, rendered
+ *              together with progress of active sessions and workqueue/executor
+ *              state on request from local Unix socket (Prometheus text or JSON).
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 02:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_METRICS_H
+#define RSYNCME_METRICS_H
+
+
+#include "rm_defs.h"
+
+
+enum rm_metrics_format {
+	RM_METRICS_FORMAT_TEXT,                 /* Prometheus text exposition: "# TYPE" line per family, then sample per line ("name{labels} value"), worker, executor thread and session fields are families labeled by idx or ssid */
+	RM_METRICS_FORMAT_JSON                  /* single JSON object */
+};
+
+struct rm_delta_reconstruct_ctx;
+
+struct rm_metrics {
+	pthread_mutex_t         mutex;          /* protects everything below */
+	struct timespec         clk_start;      /* CLOCK_MONOTONIC, daemon start */
+	uint64_t                sessions_started_n;
+	uint64_t                sessions_ended_n;
+	uint64_t                rec_by_ref, rec_by_raw;     /* bytes of ended sessions */
+	uint64_t                delta_ref_n, delta_raw_n, delta_tail_n, delta_zero_diff_n;
+	uint64_t                errors_n[RM_METRICS_ERRORS_N];  /* indexed by enum rm_error */
+	time_t                  rate_sec[RM_METRICS_RATE_WINDOW_S];     /* second (monotonic) counted in bucket */
+	uint32_t                rate_n[RM_METRICS_RATE_WINDOW_S];       /* sessions started in that second */
+	uint64_t                scrapes_n;
+};
+
+/* @brief   Rendered metrics, grown as needed. */
+struct rm_metrics_buf {
+	char                    *data;
+	size_t                  len;
+	size_t                  size;
+	uint8_t                 oom;            /* set if growing failed, output is truncated */
+};
+
+void rm_metrics_init(struct rm_metrics *m) __attribute__((nonnull(1)));
+void rm_metrics_deinit(struct rm_metrics *m) __attribute__((nonnull(1)));
+
+/* @brief   Count session inserted into daemon's table. */
+void rm_metrics_session_start(struct rm_metrics *m) __attribute__((nonnull(1)));
+
+/* @brief   Count session removed from daemon's table and add its reconstruction results. */
+void rm_metrics_session_end(struct rm_metrics *m, const struct rm_delta_reconstruct_ctx *rec_ctx) __attribute__((nonnull(1,2)));
+
+/* @brief   Count failed request. */
+void rm_metrics_error(struct rm_metrics *m, enum rm_error err) __attribute__((nonnull(1)));
+
+/* @brief   Render metrics of daemon @rm into @b.
+ * @details Takes daemon's mutex for the time of listing sessions and each session's
+ *          mutex just to copy its progress, so it can be called as often as once a second.
+ * @return  RM_ERR_OK - rendered,
+ *          RM_ERR_MEM - no memory (output truncated) */
+enum rm_error rm_metrics_render(struct rsyncme *rm, enum rm_metrics_format fmt, struct rm_metrics_buf *b) __attribute__((nonnull(1,3)));
+
+void rm_metrics_buf_free(struct rm_metrics_buf *b) __attribute__((nonnull(1)));
+
+/* @brief   Create nonblocking listening Unix socket at @path (stale socket file is removed).
+ * @return  RM_ERR_OK - listening, *fd set,
+ *          RM_ERR_TOO_MUCH_REQUESTED - path too long,
+ *          RM_ERR_FAIL - socket, bind or listen failed */
+enum rm_error rm_metrics_listen(const char *path, int *fd) __attribute__((nonnull(1,2)));
+
+
+#endif  /* RSYNCME_METRICS_H */
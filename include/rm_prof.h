@@ -0,0 +1,69 @@
+/* @file        rm_prof.h
+ * @brief       Per-stage timing of rolling proc and reconstruction.
+ * @details     Opt-in (build with RM_PROF defined, make RM_PROF=1). Each thread
+ *              laps its own CLOCK_THREAD_CPUTIME_ID clock at stage boundaries
+ *              and charges the time since previous lap to the stage just done,
+ *              so a lap costs one clock read (see rm_prof_clock_overhead).
+ *              Without RM_PROF the RM_PROF_* macros do nothing and
+ *              struct rm_prof stays zeroed.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 04:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_PROF_H
+#define RSYNCME_PROF_H
+
+
+#include "rm_defs.h"
+
+
+enum rm_prof_stage {
+	RM_PROF_READ,               /* rolling proc: reads of @x (block, byte, copy for strong check) */
+	RM_PROF_ROLL,               /* rolling proc: fast checksum of block or roll by byte */
+	RM_PROF_BUCKET,             /* rolling proc: hashing of fast checksum and walk of hashtable bucket */
+	RM_PROF_STRONG,             /* rolling proc: strong checksum of candidate block and compare */
+	RM_PROF_DIGEST,             /* rolling proc: digest of @x */
+	RM_PROF_QUEUE,              /* rolling proc: handoff of delta element to consumer (including waits for space in queue) */
+	RM_PROF_TX,                 /* delta transmitter: delta element written to socket */
+	RM_PROF_REC,                /* receiver: delta element applied to @z */
+	RM_PROF_STAGES_N
+};
+
+struct rm_prof_stage_stat {
+	uint64_t                n;              /* laps */
+	uint64_t                ns;             /* thread CPU time */
+};
+
+struct rm_prof {
+	struct rm_prof_stage_stat   stage[RM_PROF_STAGES_N];
+	uint64_t                    chain_hist[RM_PROF_CHAIN_HIST_N];   /* bucket walks by number of entries visited, last counts all longer walks */
+};
+
+/* @brief   Start lapping, @lap is thread's CPU time now. */
+void rm_prof_lap_start(struct timespec *lap) __attribute__((nonnull(1)));
+
+/* @brief   Charge time since @lap to stage @st of @p, move @lap to now. */
+void rm_prof_lap(struct rm_prof *p, enum rm_prof_stage st, struct timespec *lap) __attribute__((nonnull(1,3)));
+
+/* @brief   Count bucket walk that visited @n entries. */
+void rm_prof_chain(struct rm_prof *p, size_t n) __attribute__((nonnull(1)));
+
+/* @brief   Add counters of @src to @dst. */
+void rm_prof_add(struct rm_prof *dst, const struct rm_prof *src) __attribute__((nonnull(1,2)));
+
+/* @brief   Measured cost of single CLOCK_THREAD_CPUTIME_ID read, in ns. */
+double rm_prof_clock_overhead(void);
+
+#ifdef RM_PROF
+#define RM_PROF_LAP_START(lap)      rm_prof_lap_start(lap)
+#define RM_PROF_LAP(p, st, lap)     rm_prof_lap((p), (st), (lap))
+#define RM_PROF_CHAIN(p, n)         rm_prof_chain((p), (n))
+#else
+#define RM_PROF_LAP_START(lap)      ((void) (lap))
+#define RM_PROF_LAP(p, st, lap)     ((void) (p), (void) (lap))
+#define RM_PROF_CHAIN(p, n)         ((void) (p), (void) (n))
+#endif
+
+
+#endif  /* RSYNCME_PROF_H */
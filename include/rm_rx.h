@@ -16,6 +16,7 @@
 
 #include "rm_session.h"
 #include "rm_tcp.h"
+#include "rm_zout.h"
 
 
 /* @brief   Calculates ch_ch structs for all non-overlapping
@@ -60,9 +61,39 @@ int rm_rx_f_tx_ch_ch_ref_1(const struct f_tx_ch_ch_ref_arg_1 arg);
  *          RM_ERR_MEM - malloc failed,
  *          RM_ERR_READ - read I/O failed,
  *          RM_ERR_TX - transmission error */
-int rm_rx_insert_nonoverlapping_ch_ch_ref(int fd, FILE *f_x, const char *fname, struct twhlist_head *h, size_t L,
+int rm_rx_insert_nonoverlapping_ch_ch_ref(int fd, FILE *f_x, const char *fname, struct twhlist_head *h, uint8_t h_bits, size_t L,
         int (*f_tx_ch_ch_ref)(int fd, const struct rm_ch_ch_ref *e), size_t limit, size_t *blocks_n, pthread_mutex_t *file_mutex);
 
+/* @brief   Same as rm_rx_insert_nonoverlapping_ch_ch_ref but checksums are TXed
+ *          through @f_tx_ch_ch_ref with opaque @tx_arg (e.g. framed channel)
+ *          and fast checksums are computed with @roll (rm_fast_check_block if NULL).
+ *          CRC32C of blocks is computed too if @prefilter is RM_PREFILTER_CRC32C. */
+int rm_rx_insert_nonoverlapping_ch_ch_ref_arg(void *tx_arg, FILE *f_x, const char *fname, struct twhlist_head *h, uint8_t h_bits, size_t L, const struct rm_roll *roll, uint8_t prefilter,
+        int (*f_tx_ch_ch_ref)(void *tx_arg, const struct rm_ch_ch_ref *e), size_t limit, size_t *blocks_n, pthread_mutex_t *file_mutex);
+
+/* @brief   Number of hash bits of checksums hashtable for @blocks_n nonoverlapping checksums.
+ * @details Table gets at least @blocks_n / RM_NONOVERLAPPING_HASH_LOAD buckets (power of 2),
+ *          clamped to [RM_NONOVERLAPPING_HASH_BITS_MIN, RM_NONOVERLAPPING_HASH_BITS_MAX]. */
+uint8_t rm_rx_ch_ch_hash_bits(uint64_t blocks_n);
+
+/* @brief   Memory taken by checksums hashtable holding @blocks_n checksums (estimate). */
+uint64_t rm_rx_ch_ch_hash_bytes(uint64_t blocks_n);
+
+/* @brief   Allocate empty checksums hashtable of 2^@bits buckets.
+ * @return  Table or NULL if no memory. */
+struct twhlist_head* rm_rx_ch_ch_hash_create(uint8_t bits);
+
+/* @brief   Free all checksums in @h and table itself, @h may be NULL. */
+void rm_rx_ch_ch_hash_free(struct twhlist_head *h, uint8_t bits);
+
+/* @brief   Index checksums in @h by block number.
+ * @details *refs_n is set to number of blocks, entries of blocks not in @h are NULL.
+ * @return  Array to free or NULL if @h is empty or no memory. */
+const struct rm_ch_ch_ref** rm_rx_ch_ch_hash_index(const struct twhlist_head *h, uint8_t bits, size_t *refs_n) __attribute__((nonnull(1,3)));
+
+/* @brief   Collect chain lengths of @h into @st. */
+void rm_rx_ch_ch_hash_stats(const struct twhlist_head *h, uint8_t bits, struct rm_ch_ch_hash_stats *st) __attribute__((nonnull(1,3)));
+
 /* @brief   Calculates ch_ch structs for all non-overlapping @L bytes blocks (last one may be less than @L)
  *          from file @f and inserts them into array @checkums.
  * @param   checksums - pointer to array of structs rm_ch_ch, array size must be sufficient to contain all checksums,
@@ -96,8 +127,13 @@ struct rm_rx_delta_element_arg {
 	FILE							*f_y;
 	FILE							*f_z;
 	struct rm_delta_reconstruct_ctx	*rec_ctx;
-	int								fd;
+	struct rm_tcp_chan				*chan;			/* delta channel (RM_PUSH_TX only) */
 	pthread_mutex_t					*file_mutex;
+	MD5_CTX							*z_md5;			/* if not NULL, updated with bytes written to @f_z */
+	struct rm_codec					*codec;			/* compressor of literal payloads accepted by receiver (RM_PUSH_TX only), NULL if none */
+	uint64_t						x_off;			/* offset in @x of current element (RM_PUSH_TX only) */
+	FILE							*f_x;			/* literal ranges are sent from it (RM_PUSH_TX only) */
+	struct rm_zout					*z_out;			/* if not NULL, @f_z is written through it and @f_y read with pread (no @file_mutex) */
 };
 /* @brief   Used in local session in local push.
  * @details	Reconstruction procedure.
@@ -106,14 +142,19 @@ struct rm_rx_delta_element_arg {
  *          RM_ERR_COPY_OFFSET - copy offset failed,
  *          RM_ERR_WRITE - fpwrite failed,
  *          RM_ERR_COPY_BUFFERED - copy buffered failed,
- *          RM_ERR_ARG - unknown delta type */
+ *          RM_ERR_ARG - unknown delta type
+ *          Caller flushes @z_out once all elements are processed. */
 enum rm_error rm_rx_process_delta_element(void *arg) __attribute__((nonnull(1)));
 
 /* @brief	Used in local session's rm_session_delta_rx_f_local() thread proc in remote push as delta TCP TX callback.
  * @details	In remote push this function will tx deltas over TCP socket connected to remote receiver's TCP port
  *			(port number is received by transmitter in RM_MSG_PUSH_ACK message sent by remote receiver and it is stored
  *			in session's ack message pointed to by @msg_push_ack pointer).
- */
+ *			With @codec literal payload is followed by size of compressed payload
+ *			(0 if it is sent stored) and then by compressed payload.
+ * @return	RM_ERR_OK - success,
+ *			RM_ERR_WRITE - TX failed,
+ *			RM_ERR_CODEC - compression failed */
 enum rm_error rm_rx_tx_delta_element(void *arg) __attribute__((nonnull(1)));
 
 /* @brief	Prints statistics to the stderr.
@@ -121,5 +162,11 @@ enum rm_error rm_rx_tx_delta_element(void *arg) __attribute__((nonnull(1)));
  *			xfer_direction - 0 : RECEIVER, 1 : TRANSMITTER */
 void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote, uint8_t xfer_direction);
 
+/* @brief   Print size, load and chain lengths of checksums hashtable. */
+void rm_rx_print_hash_stats(const struct rm_ch_ch_hash_stats *st) __attribute__((nonnull(1)));
+
+/* @brief   Print memory and disk reads of checksums spilled to disk. */
+void rm_rx_print_spill_stats(const struct rm_ch_ch_spill_stats *st) __attribute__((nonnull(1)));
+
 
 #endif	/* RSYNCME_RX_H */
@@ -11,12 +11,34 @@
 
 #include "rm.h"
 #include "rm_core.h"
+#include "rm_codec.h"
 #include "rm_rx.h"
+#include "rm_spill.h"
 #include "twlist.h"
 
 
 extern enum rm_loglevel RM_LOGLEVEL;
 
+enum rm_session_phase
+{
+	RM_SESSION_PHASE_SETUP,         /* request being validated, files opened */
+	RM_SESSION_PHASE_CH_CH_TX,      /* nonoverlapping checksums of @y being sent */
+	RM_SESSION_PHASE_DELTA_RX,      /* delta elements being received and applied */
+	RM_SESSION_PHASE_FINALIZE       /* delta stream done, result being moved into place */
+};
+
+/* Progress of receiving session, published (under session's mutex) for metrics
+ * as session goes, not only at the end as rec_ctx is. */
+struct rm_session_progress
+{
+	enum rm_session_phase   phase;
+	uint64_t                ch_ch_tx_n;     /* nonoverlapping checksums sent */
+	uint64_t                bytes_rx;       /* bytes of delta stream received */
+	uint64_t                deltas_n;       /* delta elements applied */
+	uint64_t                rec_by_ref, rec_by_raw;
+	struct timespec         clk_start;      /* CLOCK_MONOTONIC, session creation */
+};
+
 struct rm_session
 {
 	struct twhlist_node     hlink;  /* hashtable handle */
@@ -43,8 +65,6 @@ struct rm_session
 	char					*f_z_bname;
 	char					*f_z_dname;
 
-	char					pwd_init[PATH_MAX];
-
 	enum rm_session_type    type;
 	struct rm_delta_reconstruct_ctx rec_ctx;
 	void                    *prvt;
@@ -53,6 +73,7 @@ struct rm_session
 	enum rm_loglevel        loglevel;
 	char                    ssid1[RM_UNIQUE_STRING_LEN];
 	char                    ssid2[RM_UNIQUE_STRING_LEN];
+	struct rm_session_progress  progress;   /* protected by @mutex */
 };
 
 /* Transmitter/receiver, local. */
@@ -61,14 +82,25 @@ struct rm_session_push_local
 	pthread_t               delta_tx_tid;       /* producer (of delta elements, rolling checksum proc) */
 	enum rm_tx_status       delta_tx_status;
 
-	struct twhlist_head     *h;                 /* nonoverlapping checksums hashtable, points to stack-allocated table */
+	struct twhlist_head     *h;                 /* nonoverlapping checksums hashtable, owned by caller (rm_rx_ch_ch_hash_create) */
+	uint8_t                 h_bits;             /* @h has 2^h_bits buckets */
+	struct rm_spill         *spill;             /* if not NULL checksums are there instead of @h (hashtable wouldn't fit memory limit) */
 	pthread_mutex_t			h_mutex;			/* protects hashtable */
 
 	twfifo_queue    tx_delta_e_queue;           /* queue of delta elements */
 	pthread_mutex_t tx_delta_e_queue_mutex;
 	pthread_cond_t  tx_delta_e_queue_signal;    /* signalled by rolling proc when
 												   new delta element has been produced */
+	pthread_cond_t  tx_delta_e_queue_space;     /* signalled by consumer when delta element has been dequeued */
+	size_t          tx_delta_e_queue_bytes;     /* bytes held by queued delta elements (see rm_delta_e_queue_charge) */
+	size_t          tx_delta_e_queue_limit;     /* rolling proc waits while queue is not empty and would exceed this, 0: no limit */
+	size_t          tx_delta_e_queue_bytes_peak;
+	size_t          tx_delta_e_queue_stalls_n;  /* number of waits of rolling proc for space in queue */
+	double          tx_delta_e_queue_stall_time;    /* seconds rolling proc spent waiting */
+	uint8_t         tx_delta_e_queue_closed;    /* set (under tx_delta_e_queue_mutex) by consumer if it stops taking elements, rolling proc fails then */
 	rm_delta_f              *delta_tx_f;        /* delta tx callback (in RM_PUSH_LOCAL enqueues delta elements, in RM_PUSH_TX the same) */
+	uint8_t                 delta_tx_done;      /* set (under tx_delta_e_queue_mutex) once rolling proc returned and digest of @x is in session's rec_ctx */
+	uint8_t                 delta_raw_ranges;   /* rolling proc passes literal runs as ranges of @x, transmitter sends them from @x (RM_PUSH_TX without codec) */
 
 	pthread_t               delta_rx_tid;       /* consumer of delta elements (reconstruction function in local push, delta transmitter in remote push) */
 	enum rm_rx_status       delta_rx_status;
@@ -88,6 +120,11 @@ struct rm_session_push_rx
 
 	int						delta_fd;           /* socket handle */
 	uint16_t				delta_port;
+	int						tmp_dir_fd;			/* directory of result, @tmp (f_z_name) is created in and renamed from it */
+	uint8_t					codec;				/* RM_CODEC_* of literal payloads accepted from MSG_PUSH, sent back in MSG_PUSH_ACK */
+	uint8_t					codec_level;
+	struct rm_roll			roll;				/* fast checksums of @y, RM_ROLL_* accepted from MSG_PUSH is sent back in MSG_PUSH_ACK */
+	uint8_t					prefilter;			/* RM_PREFILTER_* accepted from MSG_PUSH, sent back in MSG_PUSH_ACK */
 	pthread_t               delta_rx_tid;       /* receiver of delta elements */
 	enum rm_rx_status       delta_rx_status;
 	twfifo_queue    rx_delta_e_queue;           /* rx queue of delta elements */
@@ -154,10 +191,6 @@ void rm_session_free(struct rm_session *s) __attribute__((nonnull(1)));
 
 /* HIGH LEVEL API */
 
-/* @brief   Tx nonoverlapping checksums (not delta yet!) (B calculates
- *          them and B calls this method)*/
-void* rm_session_ch_ch_tx_f(void *arg) __attribute__((nonnull(1)));
-
 /* @brief   Rx checksums (not delta yet!) calculated by receiver (B)
  *          on nonoverlapping blocks (B calculates
  *          them and A calls this method). */
@@ -181,7 +214,32 @@ void* rm_session_delta_tx_f(void *arg);
  *				pointer points to that message).
  */
 void* rm_session_delta_rx_f_local(void *arg) __attribute__((nonnull(1)));
-void* rm_session_delta_rx_f_remote(void *arg) __attribute__((nonnull(1)));
+
+/* @brief   Stop taking delta elements: free those queued and wake up rolling proc,
+ *          which fails on next element with RM_ERR_QUEUE_CLOSED. */
+void rm_session_delta_queue_close(struct rm_session_push_local *prvt_local) __attribute__((nonnull(1)));
+
+/* @brief		Create executor task receiving file in remote push.
+ * @details		Session must have been validated (rm_session_assign_validate_from_msg_push)
+ *				and ACK sent. Control socket (and delta listening socket if any) are
+ *				made nonblocking. Submit returned task with RM_EXEC_WAIT_OUT. If submit
+ *				fails, call task's f_dtor with @aborted set. @f_done is called in either case.
+ * @return		Task or NULL if no memory. */
+struct rm_exec_task* rm_session_push_rx_task_create(struct rm_session *s, void (*f_done)(struct rm_session *s, void *arg), void *arg) __attribute__((nonnull(1,2)));
+
+/* @brief		Step checksums tx of task that is not submitted to executor.
+ * @details		Directory push drives the tasks of its files itself, as they share
+ *				control connection (framed delta mode only). Checksums go to task's fd.
+ * @return		RM_EXEC_WAIT_OUT - call again when socket is writable,
+ *				RM_EXEC_WAIT_IN - checksums are out, feed deltas next (none for empty file),
+ *				RM_EXEC_DONE - failed, call f_dtor. */
+enum rm_exec_wait rm_session_push_rx_task_ch_ch_step(struct rm_exec_task *task) __attribute__((nonnull(1)));
+
+/* @brief		Feed payload of delta frames to task that is not submitted to executor.
+ * @details		Sets @end once digest (or the last element if there is no digest)
+ *				has been processed or stream is broken, call f_dtor then.
+ * @return		Number of bytes consumed, less than @bytes_n only if @end is set. */
+size_t rm_session_push_rx_task_delta_feed(struct rm_exec_task *task, const unsigned char *src, size_t bytes_n, uint8_t *end) __attribute__((nonnull(1,2,4)));
 
 
 #endif  /* RSYNCME_SESSION_H */
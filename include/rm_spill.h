@@ -0,0 +1,86 @@
+/* @file        rm_spill.h
+ * @brief       Nonoverlapping checksums of huge reference file kept on disk.
+ * @details     Hashtable of checksums costs about 64 bytes per block of @y,
+ *              too much for multi-terabyte files. If it wouldn't fit in memory
+ *              limit given to transmitter checksums are gathered in runs which
+ *              are sorted by fast checksum and written to temporary file, runs are
+ *              then merged into single sorted file. Only Bloom filter over fast
+ *              checksums and index of first fast checksum of each page of sorted
+ *              file stay in memory. Rolling proc asks filter at each offset and
+ *              reads (single) page of sorted file only if filter says checksum
+ *              may be present. Filter gets what is left of memory limit after
+ *              index, with 2^32 bits it is exact.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        22 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_SPILL_H
+#define RSYNCME_SPILL_H
+
+
+#include "rm.h"
+
+
+struct rm_spill_run {
+	uint64_t            off;            /* first record in runs file */
+	uint64_t            n;
+};
+
+struct rm_spill {
+	int                 fd;             /* sorted checksums */
+	int                 runs_fd;        /* sorted runs before merge */
+	size_t              mem_bytes;
+	struct rm_ch_ch_ref *recs;          /* run being gathered */
+	size_t              recs_n;
+	size_t              recs_max;
+	struct rm_spill_run *runs;
+	size_t              runs_n;
+	uint64_t            entries_n;
+	uint64_t            *filter;        /* Bloom filter, 2^filter_bits bits */
+	uint8_t             filter_bits;
+	uint8_t             filter_k;
+	uint32_t            *index;         /* fast checksum of first record of each page */
+	uint64_t            pages_n;
+	size_t              page_recs;      /* records per page */
+	struct rm_ch_ch_ref *page;          /* page read last */
+	uint64_t            page_no;        /* of @page, UINT64_MAX: none */
+	size_t              page_n;         /* records in @page */
+	struct rm_ch_ch_ref *hits;          /* result of rm_spill_find */
+	size_t              hits_max;
+	struct rm_ch_ch_spill_stats stats;
+};
+
+/* @brief   Prepare spill of checksums which may use @mem_bytes of memory.
+ * @details Temporary files are created in $TMPDIR (or /tmp) and unlinked at once.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_OPEN_TMP - can't create temporary file,
+ *          RM_ERR_MEM - no memory */
+enum rm_error rm_spill_init(struct rm_spill *sp, size_t mem_bytes) __attribute__((nonnull(1)));
+
+/* @brief   Free memory and close files. */
+void rm_spill_free(struct rm_spill *sp) __attribute__((nonnull(1)));
+
+/* @brief   Add checksum of block @e->ref.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_MEM - no memory,
+ *          RM_ERR_WRITE - run can't be written */
+enum rm_error rm_spill_add(struct rm_spill *sp, const struct rm_ch_ch_ref *e) __attribute__((nonnull(1,2)));
+
+/* @brief   All checksums have been added, merge runs and build filter and index.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_MEM - no memory,
+ *          RM_ERR_READ - runs can't be read,
+ *          RM_ERR_WRITE - runs or sorted file can't be written */
+enum rm_error rm_spill_finish(struct rm_spill *sp) __attribute__((nonnull(1)));
+
+/* @brief   Find checksums with fast checksum @f_ch.
+ * @details On return *hits points to *hits_n records (valid until next call),
+ *          records with same strong checksum are returned once (lowest block).
+ * @return  RM_ERR_OK - success (*hits_n may be 0),
+ *          RM_ERR_READ - sorted file can't be read,
+ *          RM_ERR_MEM - no memory */
+enum rm_error rm_spill_find(struct rm_spill *sp, uint32_t f_ch, const struct rm_ch_ch_ref **hits, size_t *hits_n) __attribute__((nonnull(1,3,4)));
+
+
+#endif  /* RSYNCME_SPILL_H */
@@ -16,11 +16,96 @@
 
 #include <fcntl.h>
 #include <netdb.h>
+#include <sys/sendfile.h>
 
 
 struct rm_ch_ch_ref;
 
 
+/* Framed channel. Checksums and deltas of a session may be carried as frames
+ * on the control connection instead of on dedicated delta connection.
+ * Frame is header (channel 1B, flags 1B, payload length 2B, big endian)
+ * followed by payload. Stream of each channel ends on frame boundary
+ * so control messages can follow it unframed. */
+#define RM_TCP_FRAME_HDR_LEN		4u
+#define RM_TCP_FRAME_LEN_MAX		0xffffu		/* max payload */
+#define RM_TCP_FRAME_SENDFILE_MIN	8192u		/* file bytes sent in own frames with sendfile from this size, shorter are copied into frame */
+
+enum rm_tcp_chan_id {
+	RM_TCP_CHAN_CH_CH	= 1,					/* nonoverlapping checksums, receiver -> transmitter */
+	RM_TCP_CHAN_DELTA	= 2						/* delta elements and digest of @x, transmitter -> receiver */
+};
+
+struct rm_tcp_chan {
+	int				fd;
+	uint8_t			id;
+	uint8_t			framed;						/* 0: plain stream over dedicated connection, data is passed through */
+	unsigned char	*buf;						/* framed only: payload being built (TX) or consumed (RX) */
+	size_t			len;						/* payload bytes in @buf */
+	size_t			pos;						/* RX: payload bytes already consumed */
+	uint64_t		sendfile_n;					/* TX: file bytes sent with sendfile */
+};
+
+/* Receiver of literal bytes into file. */
+struct rm_tcp_file_rx {
+	int				pipe_fd[2];					/* literal bytes are spliced from socket to file through it, -1 if not used */
+	int				tee_fd[2];					/* spliced bytes are duplicated into it with tee for digest, -1 if not used */
+	unsigned char	*buf;						/* RM_DELTA_RAW_BUF_LEN: bytes go through it if they can't be spliced, duplicated bytes are hashed through it */
+};
+
+/* @brief       Init channel over @fd.
+ * @return      RM_ERR_OK or RM_ERR_MEM if frame buffer can't be allocated. */
+enum rm_error rm_tcp_chan_init(struct rm_tcp_chan *c, int fd, enum rm_tcp_chan_id id, uint8_t framed) __attribute__((nonnull(1)));
+/* @brief       Free frame buffer, doesn't close @fd. Unflushed data is dropped. */
+void rm_tcp_chan_free(struct rm_tcp_chan *c) __attribute__((nonnull(1)));
+/* @brief       TX @bytes_n bytes. In framed mode bytes are buffered and sent in frames
+ *              of at most RM_TCP_FRAME_LEN_MAX bytes, call rm_tcp_chan_flush at the end of stream. */
+enum rm_error rm_tcp_chan_tx(struct rm_tcp_chan *c, const void *src, size_t bytes_n) __attribute__((nonnull(1,2)));
+enum rm_error rm_tcp_chan_flush(struct rm_tcp_chan *c) __attribute__((nonnull(1)));
+/* @brief       TX @bytes_n bytes of file @fd at @offset, file offset of @fd is not changed.
+ * @details     Plain stream sends them with sendfile (falls back to read and write if file
+ *              can't be sent that way). Framed channel flushes buffered bytes and sends
+ *              each frame's header with MSG_MORE followed by payload with sendfile,
+ *              less than RM_TCP_FRAME_SENDFILE_MIN bytes are read straight into frame.
+ * @return      RM_ERR_OK - success,
+ *              RM_ERR_READ - file can't be read or is shorter,
+ *              RM_ERR_WRITE - connection error,
+ *              RM_ERR_MEM - no memory for fallback buffer */
+enum rm_error rm_tcp_chan_tx_file(struct rm_tcp_chan *c, int fd, uint64_t offset, size_t bytes_n) __attribute__((nonnull(1)));
+/* @brief       RX @bytes_n bytes. In framed mode frames of other channels are reported as RM_ERR_MSG_PT_UNKNOWN. */
+enum rm_error rm_tcp_chan_rx(struct rm_tcp_chan *c, void *dst, size_t bytes_n) __attribute__((nonnull(1,2)));
+/* @brief       Prepare @r, with pipes for splice and tee if @splice is set (pipe is not used if it can't be created).
+ * @return      RM_ERR_OK or RM_ERR_MEM if buffer can't be allocated. */
+enum rm_error rm_tcp_file_rx_init(struct rm_tcp_file_rx *r, uint8_t splice) __attribute__((nonnull(1)));
+void rm_tcp_file_rx_free(struct rm_tcp_file_rx *r) __attribute__((nonnull(1)));
+/* @brief       Splice at most @bytes_n bytes waiting on socket @sock_fd into file @fd at @offset
+ *              through pipe of @r, *moved is set to bytes written.
+ * @details     Takes from socket once, so can be used on nonblocking socket. @md5, if not
+ *              NULL, is updated with the bytes duplicated from pipe with tee (bytes tee
+ *              didn't duplicate are read back from file). Socket must be positioned at
+ *              literal bytes, in framed stream @bytes_n must not exceed payload left in frame.
+ * @return      RM_ERR_OK - success,
+ *              RM_ERR_AGAIN - nothing waiting on nonblocking socket,
+ *              RM_ERR_BAD_CALL - @r has no pipe or splice isn't supported (pipe is closed
+ *                  then and nothing was taken from socket, caller should read instead),
+ *              RM_ERR_EOF - connection closed,
+ *              RM_ERR_READ - connection or file read error,
+ *              RM_ERR_WRITE - file can't be written */
+enum rm_error rm_tcp_file_rx_splice(struct rm_tcp_file_rx *r, int sock_fd, int fd, uint64_t offset, size_t bytes_n, MD5_CTX *md5, size_t *moved) __attribute__((nonnull(1,7)));
+/* @brief       RX @bytes_n bytes into file @fd at @offset, file offset of @fd is not changed.
+ * @details     Plain stream is spliced from socket to file if @r has pipe (falls back
+ *              to read and write if splice isn't supported), framed channel goes through
+ *              buffer of @r. @md5, if not NULL, is updated with the bytes.
+ * @return      RM_ERR_OK - success,
+ *              RM_ERR_READ - connection error or EOF,
+ *              RM_ERR_WRITE - file can't be written */
+enum rm_error rm_tcp_chan_rx_file(struct rm_tcp_chan *c, struct rm_tcp_file_rx *r, int fd, uint64_t offset, size_t bytes_n, MD5_CTX *md5) __attribute__((nonnull(1,2)));
+/* tx checksums only, @arg is struct rm_tcp_chan */
+int rm_tcp_chan_tx_ch_ch(void *arg, const struct rm_ch_ch_ref *e);
+
+/* tx checksums followed by CRC32C of block (RM_PREFILTER_CRC32C), @arg is struct rm_tcp_chan */
+int rm_tcp_chan_tx_ch_ch_c(void *arg, const struct rm_ch_ch_ref *e);
+
 enum rm_error rm_tcp_rx(int fd, void *dst, size_t bytes_n);
 enum rm_error rm_tcp_tx(int fd, void *src, size_t bytes_n);
 
@@ -29,8 +114,17 @@ int rm_tcp_tx_ch_ch(int fd, const struct rm_ch_ch_ref *e);
 /* tx checksums & ref */
 int rm_tcp_tx_ch_ch_ref(int fd, const struct rm_ch_ch_ref *e);
 
+/* @brief       Serialize ACK into @buf (at least RM_MSG_ACK_LEN_MAX bytes).
+ * @return      Length of the message, 0 if @pt is not ACK type. */
+size_t rm_tcp_msg_ack_serialize(unsigned char *buf, enum rm_pt_type pt, enum rm_error status, struct rm_session *s) __attribute__((nonnull(1)));
 enum rm_error rm_tcp_tx_msg_ack(int fd, enum rm_pt_type pt, enum rm_error status, struct rm_session *s);
 
+/* @brief       Serialize summary of directory push into @buf (at least RM_MSG_PUSH_TREE_ACK_LEN bytes).
+ * @return      Length of the message. */
+size_t rm_tcp_msg_push_tree_ack_serialize(unsigned char *buf, enum rm_error status, uint64_t files_ok_n, uint64_t files_fail_n) __attribute__((nonnull));
+/* @brief       Tx summary of directory push. */
+enum rm_error rm_tcp_tx_msg_push_tree_ack(int fd, enum rm_error status, uint64_t files_ok_n, uint64_t files_fail_n);
+
 /* @brief       Set socket blocking mode.
  * @details     @on is either 0 or 1, if it is 0 blocking mode is turned off
  *              and socket becomes nonblocking, if @on == 1 socket blocking
@@ -14,7 +14,23 @@
 
 
 struct rm_tx_options {																					/* TODO move all copy_* and timeout_* options here */
-	uint8_t	loglevel;
+	uint8_t		loglevel;
+	uint16_t	inflight;																				/* directory push: files in flight (checksums received ahead of deltas) */
+	size_t		queue_bytes;																			/* limit on bytes of delta elements queued for transmission/reconstruction, 0: no limit */
+	uint8_t		codec;																					/* RM_CODEC_* requested for literal payloads, receiver may refuse it */
+	uint8_t		codec_level;																			/* 0: codec's default */
+	size_t		mem_bytes;																				/* limit on memory of nonoverlapping checksums, they are spilled to disk above it, 0: no limit */
+	uint8_t		roll;																					/* RM_ROLL_* of fast checksums requested, receiver may refuse it */
+	uint8_t		prefilter;																				/* RM_PREFILTER_* requested, receiver may refuse it */
+};
+
+/* Result of directory push. */
+struct rm_tx_tree_stats {
+	uint64_t						files_n;															/* regular files found in @x */
+	uint64_t						files_ok_n;															/* as reported by receiver */
+	uint64_t						files_fail_n;
+	uint64_t						bytes_n;															/* sum of sizes of files */
+	struct rm_delta_reconstruct_ctx	rec_ctx;															/* sum of counters of all files */
 };
 
 /* @brief   Locally sync files @x and @y such that
@@ -51,4 +67,19 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
         struct rm_delta_reconstruct_ctx *rec_ctx, const char *addr, uint16_t port, uint16_t timeout_s, uint16_t timeout_us, const char **err_str, struct rm_tx_options *opt);
 
 
+/* @brief   Push directory tree @x to remote @y (or @z if given).
+ * @details Regular files found recursively in @x are synced with files
+ *          under same relative paths in remote @y, all over single control
+ *          connection. File list, nonoverlapping checksums and delta streams
+ *          are pipelined: at most opt->inflight files have checksums received
+ *          and are being rolled ahead of the file whose deltas are being sent. Flags apply to each file as in single
+ *          file push, missing subdirectories are created by receiver
+ *          if --force is set.
+ * @return  RM_ERR_OK if all files have been synced, RM_ERR_TREE_PARTIAL if some
+ *          of them failed (see @stats), other error if push couldn't be completed. */
+enum rm_error rm_tx_remote_push_tree(const char *x, const char *y, const char *z, size_t L, size_t copy_all_threshold,
+		size_t copy_tail_threshold, size_t send_threshold, rm_push_flags flags,
+		struct rm_tx_tree_stats *stats, const char *addr, uint16_t port, uint16_t timeout_s, uint16_t timeout_us, const char **err_str, struct rm_tx_options *opt);
+
+
 #endif	/* RSYNCME_TX_H */
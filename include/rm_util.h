@@ -75,6 +75,13 @@ rm_util_daemonize(const char *dir, int noclose, const char *logname);
 int
 rm_util_chdir_umask_openlog(const char *dir, int noclose, const char *logname, uint8_t ignore_signals);
 
+/* @brief       Create directory @dir and all missing parent directories.
+ * @return      RM_ERR_OK - success (also if @dir already exists),
+ *              RM_ERR_BAD_CALL - @dir is NULL, empty or too long,
+ *              RM_ERR_DIR - mkdir failed */
+int
+rm_util_mkdir_p(const char *dir, mode_t mode);
+
 #ifdef DDEBUG
 #define RM_D_ERR(fmt, args...) fprintf(stderr, "DEBUG ERR: %s:%d:%s(): " fmt, __FILE__, __LINE__, __func__, ##args)
 #else
@@ -26,31 +26,50 @@ enum rm_work_type {
 	RM_WORK_PROCESS_MSG_PUSH = 0,
 	RM_WORK_PROCESS_MSG_PULL = 1,
 	RM_WORK_PROCESS_MSG_BYE = 2,
+	RM_WORK_PROCESS_MSG_PUSH_TREE = 3,
 	RM_WORK_PROCESS_N
 };
 const char *rm_work_type_str[RM_WORK_PROCESS_N + 1];
 
 struct rm_worker {              /* thread wrapper */
-	uint8_t         idx;        /* index in workqueue table */
+	uint32_t        idx;        /* index in workqueue table */
 	pthread_t       tid;
-	twfifo_queue    queue;      /* queue of work structs */
-	pthread_mutex_t mutex;
-	pthread_cond_t  signal;     /* signaled when new item is enqueued to this worker's queue */
+	twfifo_queue    queue;      /* work structs: work is added at the tail, owner and thieves take the oldest from the head */
+	uint32_t        queue_n;    /* number of work structs in the queue */
+	uint64_t        steals_n;   /* number of work structs this worker has taken from other workers' queues */
+	uint64_t        done_n;     /* number of work structs processed by this worker */
+	pthread_mutex_t mutex;      /* protects queue, counters and flags */
+	pthread_cond_t  signal;     /* signaled when work is enqueued to this worker's queue, there is work to steal or on stop */
 	uint8_t         active;		/* successfuly created and waiting for work */
 	uint8_t         busy;		/* active thread (successfuly created and waiting for work) may be busy while processing work */
+	uint8_t         idle;		/* found no work in own queue nor in others', about to sleep or sleeping */
+	uint8_t         wake;		/* woken to look for work again */
+	uint8_t         running;	/* thread has been created and not joined yet */
 	struct rm_workqueue *wq;    /* owner */
 };
 
+struct rm_worker_stats {
+	uint32_t        queue_n;
+	uint64_t        steals_n;
+	uint64_t        done_n;
+	uint8_t         busy;
+};
+
 struct rm_workqueue {
 	struct rm_worker    *workers;
-	uint8_t             workers_n;          /* number of worker threads */
+	uint32_t            workers_n;          /* number of worker threads */
 	uint32_t            workers_active_n;   /* number of active worker threads: successfuly created and accepting work */
 	const char          *name;
 	uint8_t             running;            /* 0 - no, 1 - yes */
-	uint8_t             first_active_worker_idx;
-	uint8_t             next_worker_idx_to_use; /* index of next worker to use for enquing the work in round-robin fashion */
+	uint32_t            first_active_worker_idx;
+	uint32_t            next_worker_idx_to_use; /* index of next worker to use for enquing the work in round-robin fashion */
 };
 
+/* @brief   Default number of workers.
+ * @details Sized from the number of online CPUs (RM_WORKERS_PER_CPU workers per CPU, as sessions
+ *          block on network I/O), RM_WORKERS_N if it can't be determined. */
+uint32_t rm_wq_workers_n_default(void);
+
 /* @brief   Start the worker threads.
  * @details After this returns the @workers_n variable in workqueue is set to the numbers of successfuly created
  *          and now running threads. It isn't neccessary the same number that has been passed to this function. */
@@ -62,13 +81,16 @@ void rm_wq_workqueue_free(struct rm_workqueue *wq);
 struct rm_workqueue* rm_wq_workqueue_create(uint32_t workers_n, const char *name);
 enum rm_error rm_wq_workqueue_stop(struct rm_workqueue *wq);
 
+/* @brief   Snapshot of worker's queue depth and counters. */
+void rm_wq_worker_stats(struct rm_worker *w, struct rm_worker_stats *stats) __attribute__((nonnull(1,2)));
+
 struct rm_work {
 	struct twlist_head  link;
 	enum rm_work_type   task;
 	struct rsyncme      *rm;
 	struct rm_msg       *msg;               /* message handle */
 	int                 fd;                 /* socket */
-	uint8_t				worker_idx;			/* index of worker in the workers table of workqueue, which is processing this work */					
+	uint32_t			worker_idx;			/* index of worker in the workers table of workqueue, which is processing this work */					
 	void* (*f)(void*);                      /* processing */
 	void (*f_dtor)(void*);                  /* destructor */
 };
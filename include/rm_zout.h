@@ -0,0 +1,73 @@
+/* @file        rm_zout.h
+ * @brief       Write-combining output of result file @z.
+ * @details     Reconstruction produces @z front to back. Instead of fseek and fwrite
+ *              per delta element (L bytes per REFERENCE), bytes of consecutive
+ *              elements are gathered in one large buffer and written by single
+ *              pwrite once it fills. @z is preallocated to its final size so
+ *              filesystem can place it in few extents even when many files are
+ *              received at once. With O_DIRECT (rsyncme_d --direct) chunks bypass
+ *              page cache, writes which aren't aligned to RM_ZOUT_ALIGN (last
+ *              chunk) are done buffered.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        21 Oct 2026 09:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_ZOUT_H
+#define RSYNCME_ZOUT_H
+
+
+#include "rm_defs.h"
+#include "md5.h"
+
+
+struct rm_zout {
+	int                 fd;
+	unsigned char       *buf;           /* RM_ZOUT_BUF_LEN, aligned to RM_ZOUT_ALIGN */
+	size_t              buf_n;          /* bytes gathered */
+	uint64_t            off;            /* offset in @z of buf[0] */
+	uint8_t             direct;         /* O_DIRECT is set on @fd */
+};
+
+/* @brief   Prepare output to @fd which will receive @size bytes.
+ * @details Space is reserved with fallocate (file size is not changed, failure
+ *          other than ENOSPC is ignored), O_DIRECT is set if @direct and filesystem
+ *          supports it.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_MEM - no memory,
+ *          RM_ERR_WRITE - no space for @size bytes */
+enum rm_error rm_zout_init(struct rm_zout *z, int fd, uint64_t size, uint8_t direct) __attribute__((nonnull(1)));
+
+/* @brief   Free buffer, gathered bytes not flushed are dropped. */
+void rm_zout_free(struct rm_zout *z) __attribute__((nonnull(1)));
+
+/* @brief   Get space for bytes at @offset in @z.
+ * @details *dst points to *dst_n bytes of buffer, caller fills some of them and
+ *          calls rm_zout_commit. Gathered bytes are flushed first if buffer is
+ *          full or @offset doesn't follow them.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_WRITE - flush failed */
+enum rm_error rm_zout_reserve(struct rm_zout *z, uint64_t offset, unsigned char **dst, size_t *dst_n) __attribute__((nonnull(1,3,4)));
+
+/* @brief   @bytes_n bytes of space got from rm_zout_reserve are filled. */
+void rm_zout_commit(struct rm_zout *z, size_t bytes_n) __attribute__((nonnull(1)));
+
+/* @brief   Write @bytes_n bytes of @src at @offset in @z.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_WRITE - flush failed */
+enum rm_error rm_zout_write(struct rm_zout *z, uint64_t offset, const unsigned char *src, size_t bytes_n) __attribute__((nonnull(1,3)));
+
+/* @brief   Copy @bytes_n bytes at @src_offset in @src_fd to @offset in @z.
+ * @details Bytes are read straight into buffer, @md5 if not NULL is updated with them.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_READ - @src_fd can't be read or is too short,
+ *          RM_ERR_WRITE - flush failed */
+enum rm_error rm_zout_copy(struct rm_zout *z, int src_fd, uint64_t src_offset, uint64_t offset, size_t bytes_n, MD5_CTX *md5) __attribute__((nonnull(1)));
+
+/* @brief   Write gathered bytes.
+ * @return  RM_ERR_OK - success,
+ *          RM_ERR_WRITE - write failed */
+enum rm_error rm_zout_flush(struct rm_zout *z) __attribute__((nonnull(1)));
+
+
+#endif  /* RSYNCME_ZOUT_H */
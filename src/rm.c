@@ -11,6 +11,7 @@
 #include "rm.h"
 #include "rm_util.h"
 #include "rm_session.h"
+#include "rm_rx.h"
 
 
 uint32_t
@@ -157,6 +158,210 @@ rm_fast_check_roll_tail(uint32_t adler, unsigned char a_k, size_t L) {
 	return (r2 << 16) | r1;
 }
 
+/* splitmix64 */
+static uint64_t
+rm_roll_rand(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/* base^n mod 2^64 */
+static uint64_t
+rm_roll_pow(size_t n) {
+	uint64_t    res = 1, b = RM_ROLL_POLY_BASE;
+
+	while (n > 0) {
+		if (n & 1)
+			res *= b;
+		b *= b;
+		n >>= 1;
+	}
+	return res;
+}
+
+void
+rm_roll_init(struct rm_roll *r, uint8_t type, uint64_t seed, size_t L) {
+	uint32_t    i = 0;
+
+	memset(r, 0, sizeof(*r));
+	r->type = type;
+	r->L = L;
+	if (type != RM_ROLL_POLY)
+		return;
+	for (i = 0; i < 256; ++i)
+		r->table[i] = rm_roll_rand(&seed);
+	r->pow = rm_roll_pow(L > 0 ? L - 1 : 0);
+}
+
+uint64_t
+rm_roll_block(const struct rm_roll *r, const unsigned char *data, size_t len) {
+	uint64_t    h = 0;
+	size_t      i = 0;
+
+	if (r->type != RM_ROLL_POLY)
+		return rm_fast_check_block(data, len);
+	for (i = 0; i < len; ++i)
+		h = h * RM_ROLL_POLY_BASE + r->table[data[i]];
+	return h;
+}
+
+uint64_t
+rm_roll_roll(const struct rm_roll *r, uint64_t h, unsigned char a_k, unsigned char a_kL) {
+	if (r->type != RM_ROLL_POLY)
+		return rm_fast_check_roll((uint32_t) h, a_k, a_kL, r->L);
+	return (h - r->table[a_k] * r->pow) * RM_ROLL_POLY_BASE + r->table[a_kL];
+}
+
+uint64_t
+rm_roll_roll_tail(const struct rm_roll *r, uint64_t h, unsigned char a_k, size_t len) {
+	if (r->type != RM_ROLL_POLY)
+		return rm_fast_check_roll_tail((uint32_t) h, a_k, len);
+	return h - r->table[a_k] * (len == r->L ? r->pow : rm_roll_pow(len - 1));
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 9)						/* __builtin_convertvector */
+#define RM_ROLL_VEC_LANES   16u
+
+typedef uint16_t rm_roll_vec __attribute__((vector_size(2 * RM_ROLL_VEC_LANES)));	/* offset of each lane, sums are mod 2^16 as in rm_fast_check_roll */
+typedef unsigned char rm_roll_bytes __attribute__((vector_size(RM_ROLL_VEC_LANES)));
+typedef uint32_t rm_roll_pair __attribute__((vector_size(2 * RM_ROLL_VEC_LANES)));	/* r2 << 16 | r1 of half of lanes */
+typedef uint64_t rm_roll_res __attribute__((vector_size(4 * RM_ROLL_VEC_LANES)));
+
+/* Inclusive prefix sum of lanes of @v, lanes shifted in from vector of zeros. */
+static inline __attribute__((always_inline)) void
+rm_roll_vec_prefix(rm_roll_vec *v) {
+	const rm_roll_vec   zero = { 0 };
+	const rm_roll_vec   sh1 = { 16, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14 };
+	const rm_roll_vec   sh2 = { 16, 16, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13 };
+	const rm_roll_vec   sh4 = { 16, 16, 16, 16, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+	const rm_roll_vec   sh8 = { 16, 16, 16, 16, 16, 16, 16, 16, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+	*v += __builtin_shuffle(*v, zero, sh1);
+	*v += __builtin_shuffle(*v, zero, sh2);
+	*v += __builtin_shuffle(*v, zero, sh4);
+	*v += __builtin_shuffle(*v, zero, sh8);
+}
+
+/* After j + 1 steps r1 = r1_0 + D[j], r2 = r2_0 + (j + 1) * r1_0 + (D[0] + ... + D[j]) - L * K[j],
+ * where D and K are prefix sums of (a_kL - a_k) and a_k. State of last lane is carried to all
+ * lanes of next vector, offsets which don't fill vector are rolled one by one. */
+static inline __attribute__((always_inline)) void
+rm_roll_batch_fast_run(uint32_t ch, const unsigned char *data, size_t L, size_t n, uint64_t res[]) {
+	const rm_roll_vec   steps = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+	const rm_roll_vec   last = { 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15 };
+	const rm_roll_vec   lo = { 0, 16, 1, 17, 2, 18, 3, 19, 4, 20, 5, 21, 6, 22, 7, 23 };
+	const rm_roll_vec   hi = { 8, 24, 9, 25, 10, 26, 11, 27, 12, 28, 13, 29, 14, 30, 15, 31 };
+	rm_roll_bytes       b_k, b_kL;
+	rm_roll_vec         k, d, r1, r2, r1_0 = { 0 }, r2_0 = { 0 };
+	rm_roll_res         v;
+	size_t              i = 0;
+
+	r1_0 += (uint16_t) ch;
+	r2_0 += (uint16_t) (ch >> 16);
+	for (i = 0; i + RM_ROLL_VEC_LANES <= n; i += RM_ROLL_VEC_LANES) {
+		memcpy(&b_k, data + i, sizeof(b_k));
+		memcpy(&b_kL, data + i + L, sizeof(b_kL));
+		k = __builtin_convertvector(b_k, rm_roll_vec);
+		d = __builtin_convertvector(b_kL, rm_roll_vec) - k;
+		rm_roll_vec_prefix(&d);
+		rm_roll_vec_prefix(&k);
+		r1 = r1_0 + d;
+		r2 = d;
+		rm_roll_vec_prefix(&r2);
+		r2 += r2_0 + steps * r1_0 - (uint16_t) L * k;
+		v = __builtin_convertvector((rm_roll_pair) __builtin_shuffle(r1, r2, lo), rm_roll_res);
+		memcpy(res + i, &v, sizeof(v));
+		v = __builtin_convertvector((rm_roll_pair) __builtin_shuffle(r1, r2, hi), rm_roll_res);
+		memcpy(res + i + RM_ROLL_VEC_LANES / 2, &v, sizeof(v));
+		r1_0 = __builtin_shuffle(r1, last);
+		r2_0 = __builtin_shuffle(r2, last);
+	}
+	ch = ((uint32_t) r2_0[0] << 16) | r1_0[0];
+	for (; i < n; ++i) {
+		ch = rm_fast_check_roll(ch, data[i], data[i + L], L);
+		res[i] = ch;
+	}
+}
+
+#if defined(__x86_64__)
+static void __attribute__((target("avx2")))
+rm_roll_batch_fast_avx2(uint32_t ch, const unsigned char *data, size_t L, size_t n, uint64_t res[]) {
+	rm_roll_batch_fast_run(ch, data, L, n, res);
+}
+#endif
+
+static void
+rm_roll_batch_fast_generic(uint32_t ch, const unsigned char *data, size_t L, size_t n, uint64_t res[]) {
+	rm_roll_batch_fast_run(ch, data, L, n, res);
+}
+#endif
+
+void
+rm_roll_batch(const struct rm_roll *r, uint64_t h, const unsigned char *data, size_t n, uint64_t res[]) {
+	size_t  i = 0;
+
+	if (r->type == RM_ROLL_POLY) {
+		for (i = 0; i < n; ++i) {
+			h = (h - r->table[data[i]] * r->pow) * RM_ROLL_POLY_BASE + r->table[data[i + r->L]];
+			res[i] = h;
+		}
+		return;
+	}
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 9)
+#if defined(__x86_64__)
+	if (__builtin_cpu_supports("avx2")) {
+		rm_roll_batch_fast_avx2((uint32_t) h, data, r->L, n, res);
+		return;
+	}
+#endif
+	rm_roll_batch_fast_generic((uint32_t) h, data, r->L, n, res);
+#else
+	for (i = 0; i < n; ++i) {
+		h = rm_fast_check_roll((uint32_t) h, data[i], data[i + r->L], r->L);
+		res[i] = h;
+	}
+#endif
+}
+
+uint32_t
+rm_roll_f_ch(const struct rm_roll *r, uint64_t h) {
+	if (r->type != RM_ROLL_POLY)
+		return (uint32_t) h;
+	return (uint32_t) (h >> 32);															/* low bits of polynomial mod 2^64 mix poorly */
+}
+
+uint8_t
+rm_roll_supported(uint8_t type) {
+	return (type == RM_ROLL_FAST || type == RM_ROLL_POLY);
+}
+
+const char*
+rm_roll_str(uint8_t type) {
+	switch (type) {
+		case RM_ROLL_FAST:
+			return "fast";
+		case RM_ROLL_POLY:
+			return "poly";
+		default:
+			return "unknown";
+	}
+}
+
+enum rm_error
+rm_roll_parse(const char *s, uint8_t *type) {
+	if (strcmp(s, "fast") == 0) {
+		*type = RM_ROLL_FAST;
+	} else if (strcmp(s, "poly") == 0) {
+		*type = RM_ROLL_POLY;
+	} else {
+		return RM_ERR_ARG;
+	}
+	return RM_ERR_OK;
+}
+
 uint32_t
 rm_rolling_ch(const unsigned char *data, size_t len,
 		uint32_t M) {
@@ -191,8 +396,255 @@ rm_md5(const unsigned char *data, size_t len,
 	md5_final(&ctx, res);
 }
 
+typedef uint32_t rm_md5_vec __attribute__((vector_size(4 * RM_MD5_LANES)));	/* word of each lane */
+
+#define RM_MD5_F(x, y, z)   ((z) ^ ((x) & ((y) ^ (z))))
+#define RM_MD5_G(x, y, z)   ((y) ^ ((z) & ((x) ^ (y))))
+#define RM_MD5_H(x, y, z)   ((x) ^ (y) ^ (z))
+#define RM_MD5_I(x, y, z)   ((y) ^ ((x) | ~(z)))
+#define RM_MD5_STEP(f, a, b, c, d, m, s, t) { \
+	(a) += f((b), (c), (d)) + (m) + (uint32_t) (t); \
+	(a) = (b) + (((a) << (s)) | ((a) >> (32 - (s)))); }
+
+/* 64 byte block @p[k] of each lane k into state @st. */
+static inline __attribute__((always_inline)) void
+rm_md5_lanes_transform(rm_md5_vec st[4], const unsigned char *const p[RM_MD5_LANES]) {
+	uint32_t    w[16][RM_MD5_LANES];
+	rm_md5_vec  m[16], a, b, c, d;
+	size_t      i = 0, k = 0;
+	const unsigned char *q = NULL;
+
+	for (k = 0; k < RM_MD5_LANES; ++k) {														/* transpose, word i of all lanes goes to m[i] */
+		q = p[k];
+		for (i = 0; i < 16; ++i, q += 4)
+			w[i][k] = (uint32_t) q[0] | ((uint32_t) q[1] << 8) | ((uint32_t) q[2] << 16) | ((uint32_t) q[3] << 24);
+	}
+	memcpy(m, w, sizeof(m));
+	a = st[0];
+	b = st[1];
+	c = st[2];
+	d = st[3];
+
+	RM_MD5_STEP(RM_MD5_F, a, b, c, d, m[0],   7, 0xd76aa478);
+	RM_MD5_STEP(RM_MD5_F, d, a, b, c, m[1],  12, 0xe8c7b756);
+	RM_MD5_STEP(RM_MD5_F, c, d, a, b, m[2],  17, 0x242070db);
+	RM_MD5_STEP(RM_MD5_F, b, c, d, a, m[3],  22, 0xc1bdceee);
+	RM_MD5_STEP(RM_MD5_F, a, b, c, d, m[4],   7, 0xf57c0faf);
+	RM_MD5_STEP(RM_MD5_F, d, a, b, c, m[5],  12, 0x4787c62a);
+	RM_MD5_STEP(RM_MD5_F, c, d, a, b, m[6],  17, 0xa8304613);
+	RM_MD5_STEP(RM_MD5_F, b, c, d, a, m[7],  22, 0xfd469501);
+	RM_MD5_STEP(RM_MD5_F, a, b, c, d, m[8],   7, 0x698098d8);
+	RM_MD5_STEP(RM_MD5_F, d, a, b, c, m[9],  12, 0x8b44f7af);
+	RM_MD5_STEP(RM_MD5_F, c, d, a, b, m[10], 17, 0xffff5bb1);
+	RM_MD5_STEP(RM_MD5_F, b, c, d, a, m[11], 22, 0x895cd7be);
+	RM_MD5_STEP(RM_MD5_F, a, b, c, d, m[12],  7, 0x6b901122);
+	RM_MD5_STEP(RM_MD5_F, d, a, b, c, m[13], 12, 0xfd987193);
+	RM_MD5_STEP(RM_MD5_F, c, d, a, b, m[14], 17, 0xa679438e);
+	RM_MD5_STEP(RM_MD5_F, b, c, d, a, m[15], 22, 0x49b40821);
+
+	RM_MD5_STEP(RM_MD5_G, a, b, c, d, m[1],   5, 0xf61e2562);
+	RM_MD5_STEP(RM_MD5_G, d, a, b, c, m[6],   9, 0xc040b340);
+	RM_MD5_STEP(RM_MD5_G, c, d, a, b, m[11], 14, 0x265e5a51);
+	RM_MD5_STEP(RM_MD5_G, b, c, d, a, m[0],  20, 0xe9b6c7aa);
+	RM_MD5_STEP(RM_MD5_G, a, b, c, d, m[5],   5, 0xd62f105d);
+	RM_MD5_STEP(RM_MD5_G, d, a, b, c, m[10],  9, 0x02441453);
+	RM_MD5_STEP(RM_MD5_G, c, d, a, b, m[15], 14, 0xd8a1e681);
+	RM_MD5_STEP(RM_MD5_G, b, c, d, a, m[4],  20, 0xe7d3fbc8);
+	RM_MD5_STEP(RM_MD5_G, a, b, c, d, m[9],   5, 0x21e1cde6);
+	RM_MD5_STEP(RM_MD5_G, d, a, b, c, m[14],  9, 0xc33707d6);
+	RM_MD5_STEP(RM_MD5_G, c, d, a, b, m[3],  14, 0xf4d50d87);
+	RM_MD5_STEP(RM_MD5_G, b, c, d, a, m[8],  20, 0x455a14ed);
+	RM_MD5_STEP(RM_MD5_G, a, b, c, d, m[13],  5, 0xa9e3e905);
+	RM_MD5_STEP(RM_MD5_G, d, a, b, c, m[2],   9, 0xfcefa3f8);
+	RM_MD5_STEP(RM_MD5_G, c, d, a, b, m[7],  14, 0x676f02d9);
+	RM_MD5_STEP(RM_MD5_G, b, c, d, a, m[12], 20, 0x8d2a4c8a);
+
+	RM_MD5_STEP(RM_MD5_H, a, b, c, d, m[5],   4, 0xfffa3942);
+	RM_MD5_STEP(RM_MD5_H, d, a, b, c, m[8],  11, 0x8771f681);
+	RM_MD5_STEP(RM_MD5_H, c, d, a, b, m[11], 16, 0x6d9d6122);
+	RM_MD5_STEP(RM_MD5_H, b, c, d, a, m[14], 23, 0xfde5380c);
+	RM_MD5_STEP(RM_MD5_H, a, b, c, d, m[1],   4, 0xa4beea44);
+	RM_MD5_STEP(RM_MD5_H, d, a, b, c, m[4],  11, 0x4bdecfa9);
+	RM_MD5_STEP(RM_MD5_H, c, d, a, b, m[7],  16, 0xf6bb4b60);
+	RM_MD5_STEP(RM_MD5_H, b, c, d, a, m[10], 23, 0xbebfbc70);
+	RM_MD5_STEP(RM_MD5_H, a, b, c, d, m[13],  4, 0x289b7ec6);
+	RM_MD5_STEP(RM_MD5_H, d, a, b, c, m[0],  11, 0xeaa127fa);
+	RM_MD5_STEP(RM_MD5_H, c, d, a, b, m[3],  16, 0xd4ef3085);
+	RM_MD5_STEP(RM_MD5_H, b, c, d, a, m[6],  23, 0x04881d05);
+	RM_MD5_STEP(RM_MD5_H, a, b, c, d, m[9],   4, 0xd9d4d039);
+	RM_MD5_STEP(RM_MD5_H, d, a, b, c, m[12], 11, 0xe6db99e5);
+	RM_MD5_STEP(RM_MD5_H, c, d, a, b, m[15], 16, 0x1fa27cf8);
+	RM_MD5_STEP(RM_MD5_H, b, c, d, a, m[2],  23, 0xc4ac5665);
+
+	RM_MD5_STEP(RM_MD5_I, a, b, c, d, m[0],   6, 0xf4292244);
+	RM_MD5_STEP(RM_MD5_I, d, a, b, c, m[7],  10, 0x432aff97);
+	RM_MD5_STEP(RM_MD5_I, c, d, a, b, m[14], 15, 0xab9423a7);
+	RM_MD5_STEP(RM_MD5_I, b, c, d, a, m[5],  21, 0xfc93a039);
+	RM_MD5_STEP(RM_MD5_I, a, b, c, d, m[12],  6, 0x655b59c3);
+	RM_MD5_STEP(RM_MD5_I, d, a, b, c, m[3],  10, 0x8f0ccc92);
+	RM_MD5_STEP(RM_MD5_I, c, d, a, b, m[10], 15, 0xffeff47d);
+	RM_MD5_STEP(RM_MD5_I, b, c, d, a, m[1],  21, 0x85845dd1);
+	RM_MD5_STEP(RM_MD5_I, a, b, c, d, m[8],   6, 0x6fa87e4f);
+	RM_MD5_STEP(RM_MD5_I, d, a, b, c, m[15], 10, 0xfe2ce6e0);
+	RM_MD5_STEP(RM_MD5_I, c, d, a, b, m[6],  15, 0xa3014314);
+	RM_MD5_STEP(RM_MD5_I, b, c, d, a, m[13], 21, 0x4e0811a1);
+	RM_MD5_STEP(RM_MD5_I, a, b, c, d, m[4],   6, 0xf7537e82);
+	RM_MD5_STEP(RM_MD5_I, d, a, b, c, m[11], 10, 0xbd3af235);
+	RM_MD5_STEP(RM_MD5_I, c, d, a, b, m[2],  15, 0x2ad7d2bb);
+	RM_MD5_STEP(RM_MD5_I, b, c, d, a, m[9],  21, 0xeb86d391);
+
+	st[0] += a;
+	st[1] += b;
+	st[2] += c;
+	st[3] += d;
+}
+
+/* Up to RM_MD5_LANES blocks. Block j of lane k is read from @data[k] while whole,
+ * remaining bytes, padding and bit length come from tail[k]. Lanes which have
+ * finished (or are unused) hash zeros and their state is ignored. */
+static inline __attribute__((always_inline)) void
+rm_md5_lanes_run(const unsigned char *const data[], const size_t len[], unsigned char *const res[], size_t n) {
+	static const unsigned char  zeros[64];
+	unsigned char               tail[RM_MD5_LANES][128];
+	const unsigned char         *p[RM_MD5_LANES];
+	size_t                      blocks_n[RM_MD5_LANES], full_n[RM_MD5_LANES], rest = 0, j = 0, j_max = 0, k = 0, i = 0;
+	uint64_t                    bitlen = 0;
+	rm_md5_vec                  st[4];
+
+	for (k = 0; k < RM_MD5_LANES; ++k) {
+		st[0][k] = 0x67452301;
+		st[1][k] = 0xefcdab89;
+		st[2][k] = 0x98badcfe;
+		st[3][k] = 0x10325476;
+		blocks_n[k] = 0;
+		full_n[k] = 0;
+		if (k >= n)
+			continue;
+		full_n[k] = len[k] / 64;
+		rest = len[k] % 64;
+		memcpy(tail[k], data[k] + 64 * full_n[k], rest);
+		tail[k][rest] = 0x80;
+		blocks_n[k] = full_n[k] + (rest < 56 ? 1 : 2);
+		memset(tail[k] + rest + 1, 0, 64 * (blocks_n[k] - full_n[k]) - 8 - rest - 1);
+		bitlen = (uint64_t) len[k] * 8;
+		for (i = 0; i < 8; ++i)
+			tail[k][64 * (blocks_n[k] - full_n[k]) - 8 + i] = (unsigned char) (bitlen >> (8 * i));
+		j_max = rm_max(j_max, blocks_n[k]);
+	}
+	for (j = 0; j < j_max; ++j) {
+		for (k = 0; k < RM_MD5_LANES; ++k) {
+			if (j < full_n[k])
+				p[k] = data[k] + 64 * j;
+			else if (j < blocks_n[k])
+				p[k] = tail[k] + 64 * (j - full_n[k]);
+			else
+				p[k] = zeros;
+		}
+		rm_md5_lanes_transform(st, p);
+		for (k = 0; k < n; ++k) {
+			if (j + 1 != blocks_n[k])
+				continue;
+			for (i = 0; i < 4; ++i) {															/* lane's last block, output is little endian */
+				res[k][i]      = (unsigned char) (st[0][k] >> (8 * i));
+				res[k][i + 4]  = (unsigned char) (st[1][k] >> (8 * i));
+				res[k][i + 8]  = (unsigned char) (st[2][k] >> (8 * i));
+				res[k][i + 12] = (unsigned char) (st[3][k] >> (8 * i));
+			}
+		}
+	}
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+static void __attribute__((target("avx2")))
+rm_md5_lanes_avx2(const unsigned char *const data[], const size_t len[], unsigned char *const res[], size_t n) {
+	rm_md5_lanes_run(data, len, res, n);
+}
+#endif
+
+static void
+rm_md5_lanes_generic(const unsigned char *const data[], const size_t len[], unsigned char *const res[], size_t n) {
+	rm_md5_lanes_run(data, len, res, n);
+}
+
+void
+rm_md5_lanes(const unsigned char *const data[], const size_t len[], unsigned char *const res[], size_t n) {
+	size_t  batch_n = 0;
+
+	while (n > 0) {
+		batch_n = rm_min(n, RM_MD5_LANES);
+		if (batch_n == 1) {
+			rm_md5(data[0], len[0], res[0]);													/* lanes would idle */
+		} else {
+#if defined(__GNUC__) && defined(__x86_64__)
+			if (__builtin_cpu_supports("avx2"))
+				rm_md5_lanes_avx2(data, len, res, batch_n);
+			else
+#endif
+				rm_md5_lanes_generic(data, len, res, batch_n);
+		}
+		data += batch_n;
+		len += batch_n;
+		res += batch_n;
+		n -= batch_n;
+	}
+}
+
+static uint32_t         rm_crc32c_table[256];
+static pthread_once_t   rm_crc32c_once = PTHREAD_ONCE_INIT;
+
+static void
+rm_crc32c_table_init(void) {
+	uint32_t    i = 0, j = 0, c = 0;
+
+	for (i = 0; i < 256; ++i) {
+		c = i;
+		for (j = 0; j < 8; ++j)
+			c = (c >> 1) ^ (RM_CRC32C_POLY & (0u - (c & 1)));
+		rm_crc32c_table[i] = c;
+	}
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+static uint32_t __attribute__((target("sse4.2")))
+rm_crc32c_sse42(uint32_t crc, const unsigned char *data, size_t len) {
+	uint64_t    c = crc, v = 0;
+
+	for (; len >= 8; len -= 8, data += 8) {
+		memcpy(&v, data, 8);
+		c = __builtin_ia32_crc32di(c, v);
+	}
+	for (; len > 0; --len, ++data)
+		c = __builtin_ia32_crc32qi((uint32_t) c, *data);
+	return (uint32_t) c;
+}
+#endif
+
+uint32_t
+rm_crc32c_sw(uint32_t crc, const unsigned char *data, size_t len) {
+	crc = ~crc;
+	pthread_once(&rm_crc32c_once, rm_crc32c_table_init);
+	for (; len > 0; --len, ++data)
+		crc = rm_crc32c_table[(crc ^ *data) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+uint32_t
+rm_crc32c(uint32_t crc, const unsigned char *data, size_t len) {
+#if defined(__GNUC__) && defined(__x86_64__)
+	if (__builtin_cpu_supports("sse4.2"))
+		return ~rm_crc32c_sse42(~crc, data, len);
+#endif
+	return rm_crc32c_sw(crc, data, len);
+}
+
 enum rm_error
 rm_copy_buffered(FILE *x, FILE *y, size_t bytes_n, pthread_mutex_t *file_mutex)
+{
+	return rm_copy_buffered_md5(x, y, bytes_n, file_mutex, NULL);
+}
+
+enum rm_error
+rm_copy_buffered_md5(FILE *x, FILE *y, size_t bytes_n, pthread_mutex_t *file_mutex, MD5_CTX *md5)
 {
 	size_t read, read_exp;
 	char buf[RM_L1_CACHE_RECOMMENDED];
@@ -210,6 +662,8 @@ rm_copy_buffered(FILE *x, FILE *y, size_t bytes_n, pthread_mutex_t *file_mutex)
 			err = RM_ERR_WRITE;
 			goto exit;
 		}
+		if (md5 != NULL)
+			md5_update(md5, (const BYTE*) buf, read);
 		bytes_n -= read;
 		read_exp = RM_L1_CACHE_RECOMMENDED < bytes_n ?
 			RM_L1_CACHE_RECOMMENDED : bytes_n;
@@ -244,7 +698,7 @@ rm_copy_buffered_2(FILE *x, size_t offset, void *dst, size_t bytes_n, pthread_mu
 	if (file_mutex != NULL)
 		pthread_mutex_lock(file_mutex);
 
-	if (fseek(x, offset, SEEK_SET) != 0) {
+	if (fseeko(x, (off_t) offset, SEEK_SET) != 0) {
 		err = RM_ERR_FSEEK;
 		goto exit;
 	}
@@ -283,7 +737,7 @@ rm_fpread(void *buf, size_t size, size_t items_n, size_t offset, FILE *f, pthrea
 	if (file_mutex != NULL)
 		pthread_mutex_lock(file_mutex);
 
-	if (fseek(f, offset, SEEK_SET) != 0) {
+	if (fseeko(f, (off_t) offset, SEEK_SET) != 0) {
 		return 0;
 	}
 	res = fread(buf, size, items_n, f);
@@ -304,7 +758,7 @@ rm_fpwrite(const void *buf, size_t size, size_t items_n, size_t offset, FILE *f,
 	if (file_mutex != NULL)
 		pthread_mutex_lock(file_mutex);
 
-	if (fseek(f, offset, SEEK_SET) != 0) {
+	if (fseeko(f, (off_t) offset, SEEK_SET) != 0) {
 		return 0;
 	}
 	res = fwrite(buf, size, items_n, f);
@@ -317,6 +771,12 @@ rm_fpwrite(const void *buf, size_t size, size_t items_n, size_t offset, FILE *f,
 
 enum rm_error
 rm_copy_buffered_offset(FILE *x, FILE *y, size_t bytes_n, size_t x_offset, size_t y_offset, pthread_mutex_t *file_mutex)
+{
+	return rm_copy_buffered_offset_md5(x, y, bytes_n, x_offset, y_offset, file_mutex, NULL);
+}
+
+enum rm_error
+rm_copy_buffered_offset_md5(FILE *x, FILE *y, size_t bytes_n, size_t x_offset, size_t y_offset, pthread_mutex_t *file_mutex, MD5_CTX *md5)
 {
 	enum rm_error err = RM_ERR_OK;
 	size_t read, read_exp;
@@ -334,6 +794,8 @@ rm_copy_buffered_offset(FILE *x, FILE *y, size_t bytes_n, size_t x_offset, size_
 			err = RM_ERR_WRITE;
 			goto exit;
 		}
+		if (md5 != NULL)
+			md5_update(md5, (const BYTE*) buf, read);
 		bytes_n -= read;
 		offset += read;
 		read_exp = RM_L1_CACHE_RECOMMENDED < bytes_n ?
@@ -386,42 +848,272 @@ rm_rolling_ch_proc_tx(struct rm_roll_proc_cb_arg  *cb_arg, rm_delta_f *delta_f,
 		delta_e->raw_bytes = NULL;
 	}
 	delta_e->raw_bytes_n = raw_bytes_n;
+	delta_e->raw_off = 0;
 	TWINIT_LIST_HEAD(&delta_e->link);
 	cb_arg->delta_e = delta_e;                  /* tx, signal delta_rx_tid, etc */
-	delta_f(cb_arg);                            /* TX, enqueue delta */
+	if (delta_f(cb_arg) != RM_ERR_OK) {         /* TX, enqueue delta */
+		free(delta_e);                          /* not taken, raw bytes are still owned by caller */
+		return RM_ERR_TX;
+	}
 
 	return RM_ERR_OK;
 }
 
-/* NOTE: @f_x MUST be already opened
+/* Read-ahead over @x of rolling proc. */
+struct rm_roll_win {
+	unsigned char   *buf;
+	size_t          max;            /* size of @buf */
+	size_t          off;            /* offset in @x of buf[0] */
+	size_t          n;              /* bytes in @buf */
+	MD5_CTX         *md5;           /* digest of @x, literal bytes of ranges are added to it from @buf */
+	size_t          md5_off;        /* offset in @x of literal bytes in @buf not added to @md5 yet */
+	size_t          md5_n;
+};
+
+/* Add literal bytes waiting in window to digest of @x. */
+static void
+rm_rolling_ch_proc_win_md5(struct rm_roll_win *win) {
+	if (win->md5_n > 0) {
+		md5_update(win->md5, win->buf + (win->md5_off - win->off), win->md5_n);
+		win->md5_n = 0;
+	}
+}
+
+/* Pointer to @len bytes at @pos in @x, window is refilled from @pos with single read if they aren't all in it. */
+static const unsigned char*
+rm_rolling_ch_proc_win(FILE *f_x, size_t file_sz, struct rm_roll_win *win, size_t pos, size_t len) {
+	if (pos < win->off || pos + len > win->off + win->n) {
+		rm_rolling_ch_proc_win_md5(win);														/* before bytes are gone */
+		win->off = pos;
+		win->n = rm_min(win->max, file_sz - pos);
+		if (win->n < len || rm_fpread(win->buf, 1, win->n, pos, f_x, NULL) != win->n) {
+			win->n = 0;
+			return NULL;
+		}
+	}
+	return win->buf + (pos - win->off);
+}
+
+/* Literal run of @run_n bytes at @run_off in @x is passed as range, transmitter sends it from @x.
+ * Bytes of the run still waiting in window @win are added to digest of @x first. */
+static enum rm_error
+rm_rolling_ch_proc_tx_range(struct rm_roll_proc_cb_arg *cb_arg, rm_delta_f *delta_f, struct rm_roll_win *win,
+		uint64_t run_off, size_t *run_n) {
+	struct rm_delta_e           *delta_e;
+
+	rm_rolling_ch_proc_win_md5(win);
+	delta_e = malloc(sizeof(*delta_e));
+	if (delta_e == NULL) {
+		return RM_ERR_MEM;
+	}
+	delta_e->type = RM_DELTA_ELEMENT_RAW_BYTES;
+	delta_e->ref = 0;
+	delta_e->raw_bytes = NULL;
+	delta_e->raw_bytes_n = *run_n;
+	delta_e->raw_off = run_off;
+	TWINIT_LIST_HEAD(&delta_e->link);
+	cb_arg->delta_e = delta_e;
+	if (delta_f(cb_arg) != RM_ERR_OK) {
+		free(delta_e);
+		return RM_ERR_TX;
+	}
+	*run_n = 0;
+	return RM_ERR_OK;
+}
+
+/* Bytes at offset of rolling proc and their checksums, checked against candidates
+ * with the same fast checksum. CRC32C and MD5 of them are computed once per offset. */
+struct rm_roll_verify {
+	FILE            *f_x;
+	unsigned char   *buf;           /* block being checked */
+	size_t          pos;            /* offset in @x of bytes being checked */
+	size_t          read;           /* number of them */
+	uint8_t         buf_is_block;   /* @buf holds them */
+	uint8_t         beginning_bytes_in_buf;
+	uint8_t         c_ch_ready;     /* ch.c_ch is their CRC32C */
+	uint8_t         s_ch_ready;     /* ch.s_ch is their MD5 */
+	uint8_t         prefilter;
+	struct rm_ch_ch ch;
+	size_t          prefilter_pass_n, prefilter_reject_n;
+	size_t          collisions_2nd_level;   /* fast checksum matches, strong doesn't */
+	struct rm_prof  *prof;
+	struct timespec *prof_lap;
+};
+
+/* Read bytes at @v->pos into @v->buf unless it holds them already. */
+static enum rm_error
+rm_rolling_ch_proc_buf(struct rm_roll_verify *v)
+{
+	if (v->buf_is_block == 0) {
+		if (rm_copy_buffered_2(v->f_x, v->pos, v->buf, v->read, NULL) != RM_ERR_OK)
+			return RM_ERR_COPY_BUFFERED;
+		v->buf_is_block = 1;
+		v->beginning_bytes_in_buf = 0;
+	}
+	return RM_ERR_OK;
+}
+
+/* Strong checksum of bytes at @v->pos, unless ready. */
+static enum rm_error
+rm_rolling_ch_proc_s_ch(struct rm_roll_verify *v)
+{
+	if (v->s_ch_ready)
+		return RM_ERR_OK;
+	if (rm_rolling_ch_proc_buf(v) != RM_ERR_OK)
+		return RM_ERR_COPY_BUFFERED;
+	RM_PROF_LAP(v->prof, RM_PROF_READ, v->prof_lap);
+	rm_md5(v->buf, v->read, v->ch.s_ch.data);
+	v->s_ch_ready = 1;
+	return RM_ERR_OK;
+}
+
+/* CRC32C of bytes at @v->pos, unless ready. */
+static enum rm_error
+rm_rolling_ch_proc_c_ch(struct rm_roll_verify *v)
+{
+	if (v->c_ch_ready)
+		return RM_ERR_OK;
+	if (rm_rolling_ch_proc_buf(v) != RM_ERR_OK)
+		return RM_ERR_COPY_BUFFERED;
+	RM_PROF_LAP(v->prof, RM_PROF_READ, v->prof_lap);
+	v->ch.c_ch = rm_crc32c(0, v->buf, v->read);
+	v->c_ch_ready = 1;
+	return RM_ERR_OK;
+}
+
+/* Check bytes at @v->pos against candidate @cand with the same fast checksum:
+ * CRC32C first if prefiltering (rejects most collisions without MD5), then MD5. */
+static enum rm_error
+rm_rolling_ch_proc_verify(struct rm_roll_verify *v, const struct rm_ch_ch *cand, uint8_t *match)
+{
+	*match = 0;
+	if (v->prefilter != RM_PREFILTER_NONE) {
+		if (rm_rolling_ch_proc_c_ch(v) != RM_ERR_OK)
+			return RM_ERR_COPY_BUFFERED;
+		RM_PROF_LAP(v->prof, RM_PROF_STRONG, v->prof_lap);
+		if (cand->c_ch != v->ch.c_ch) {
+			++v->prefilter_reject_n;
+			++v->collisions_2nd_level;
+			return RM_ERR_OK;
+		}
+		++v->prefilter_pass_n;
+	}
+	if (rm_rolling_ch_proc_s_ch(v) != RM_ERR_OK)
+		return RM_ERR_COPY_BUFFERED;
+	if (memcmp(cand->s_ch.data, v->ch.s_ch.data, RM_STRONG_CHECK_BYTES) == 0)
+		*match = 1;
+	else
+		++v->collisions_2nd_level;
+	RM_PROF_LAP(v->prof, RM_PROF_STRONG, v->prof_lap);
+	return RM_ERR_OK;
+}
+
+/* States of windows ahead of rolling proc in nonmatching region. State @i is
+ * of window at @off - (@n - 1 - @i). Bucket of state is prefetched when state is
+ * computed, first entry of bucket RM_ROLL_BATCH offsets later, second entry
+ * after another RM_ROLL_BATCH, so chains are in cache when offsets are reached. */
+struct rm_roll_ahead {
+	uint64_t        h[3 * RM_ROLL_BATCH];
+	uint32_t        bkt[3 * RM_ROLL_BATCH];
+	size_t          i;              /* next to use */
+	size_t          n;
+	size_t          off;            /* offset in @x of window of h[n - 1] */
+	size_t          ent1;           /* [0, ent1) have first entries prefetched */
+	size_t          ent2;           /* [0, ent2) have second entries prefetched */
+};
+
+/* Compute states ahead of window at @pos with state @h if less than 2 * RM_ROLL_BATCH are left. */
+static enum rm_error
+rm_rolling_ch_proc_ahead(struct rm_roll_ahead *a, const struct rm_roll *roll, FILE *f_x, size_t file_sz, struct rm_roll_win *win,
+		size_t pos, uint64_t h, const struct twhlist_head *ht, uint8_t h_bits) {
+	const unsigned char *p = NULL;
+	const struct twhlist_node   *node = NULL;
+	size_t          n = 0, k = 0;
+
+	if (a->i == a->n) {																		/* from current state */
+		memset(a, 0, sizeof(*a));
+		a->off = pos;
+	}
+	if (a->n - a->i >= 2 * RM_ROLL_BATCH || a->off + roll->L >= file_sz)
+		return RM_ERR_OK;
+	if (a->i > 0) {
+		memmove(a->h, a->h + a->i, (a->n - a->i) * sizeof(a->h[0]));
+		memmove(a->bkt, a->bkt + a->i, (a->n - a->i) * sizeof(a->bkt[0]));
+		a->n -= a->i;
+		a->ent1 = (a->ent1 > a->i ? a->ent1 - a->i : 0);
+		a->ent2 = (a->ent2 > a->i ? a->ent2 - a->i : 0);
+		a->i = 0;
+	}
+	n = rm_min(RM_ROLL_BATCH, file_sz - a->off - roll->L);
+	p = rm_rolling_ch_proc_win(f_x, file_sz, win, pos, a->off - pos + roll->L + n);
+	if (p == NULL)
+		return RM_ERR_READ;
+	rm_roll_batch(roll, (a->n > 0 ? a->h[a->n - 1] : h), p + (a->off - pos), n, a->h + a->n);
+	if (ht != NULL) {																		/* locked by caller for whole proc */
+		for (k = a->ent2; k < a->ent1; ++k) {
+			node = ht[a->bkt[k]].first;
+			if (node != NULL && node->next != NULL)
+				__builtin_prefetch((const char*) node->next - offsetof(struct rm_ch_ch_ref_hlink, hlink));
+		}
+		for (k = a->ent1; k < a->n; ++k) {
+			node = ht[a->bkt[k]].first;
+			if (node != NULL)
+				__builtin_prefetch((const char*) node - offsetof(struct rm_ch_ch_ref_hlink, hlink));
+		}
+		for (k = a->n; k < a->n + n; ++k) {
+			a->bkt[k] = twhash_min(rm_roll_f_ch(roll, a->h[k]), h_bits);
+			__builtin_prefetch(&ht[a->bkt[k]]);
+		}
+	}
+	a->ent2 = a->ent1;
+	a->ent1 = a->n;
+	a->n += n;
+	a->off += n;
+	return RM_ERR_OK;
+}
+
+/* NOTE: @f_x MUST be already opened, @h MUST be locked by caller
  * @param   delta_f - tx/reconstruct callback, NOTE: this callback takes ownership
  *          of the delta elements allocated by rolling proc - this function MUST
  *          assert memory is freed */
-/* TODO Verify hashtable locking needs for rm_rolling_ch_proc <-> rm_session_ch_ch_rx_f */
-enum rm_error
-rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_mutex_t *h_mutex,
-		FILE *f_x, rm_delta_f *delta_f, size_t from) {
+static enum rm_error
+rm_rolling_ch_proc_indexed(struct rm_session *s, const struct twhlist_head *h, uint8_t h_bits,
+		const struct rm_ch_ch_ref * const *by_ref, size_t by_ref_n, const struct rm_roll *roll, FILE *f_x, rm_delta_f *delta_f, size_t from) {
 	size_t          L = 0;
 	size_t          copy_all_threshold = 0, copy_tail_threshold = 0, send_threshold = 0;
 	uint32_t        hash = 0;
+	uint64_t        roll_h = 0;																		/* state of rolling checksum, v.ch.f_ch is derived from it */
 	unsigned char   *buf = NULL;
 	int             fd = -1;
 	struct stat     fs = { 0 };
 	size_t          file_sz = 0, send_left = 0, read_now = 0, read = 0, read_begin = 0;
-	uint8_t         match, beginning_bytes_in_buf;
+	uint8_t         match;
 	const struct rm_ch_ch_ref_hlink   *e = NULL;
 	size_t			ref = 0;
-	struct rm_ch_ch ch;
 	struct rm_roll_proc_cb_arg  cb_arg = { 0 };																/* callback argument */
 	size_t                      raw_bytes_n = 0, raw_bytes_max = 0;
 	unsigned char               *raw_bytes = NULL;															/* buffer for literal bytes */
+	uint8_t                     raw_ranges = 0;																/* literal runs passed as ranges of @x, they are added to digest from window */
+	size_t                      raw_run_n = 0;
+	uint64_t                    raw_run_off = 0;
 	size_t                      a_k_pos = 0, a_kL_pos = 0;
-	unsigned char               a_k = 0, a_kL = 0;															/* bytes to remove/add from rolling checksum */
+	unsigned char               a_k = 0;																	/* byte to remove from rolling checksum */
 	size_t          collisions_1st_level = 0;
-	size_t          collisions_2nd_level = 0;
 	uint8_t         copy_all = 0, copy_all_threshold_fired = 0, copy_tail_threshold_fired = 0;
-
-	/*(void) h_mutex;  Verify hashtable locking needs for rm_rolling_ch_proc <-> rm_session_ch_ch_rx_f */
+	MD5_CTX         x_md5;																						/* digest of all bytes addressed by delta elements, in order */
+	struct rm_prof  prof = { 0 };
+	struct timespec prof_lap = { 0 };
+	size_t          chain_n = 0;
+	struct rm_spill *spill = NULL;																/* checksums on disk instead of @h */
+	const struct rm_ch_ch_ref   *hits = NULL;
+	size_t          hits_n = 0, hit = 0;
+	size_t          ref_next = SIZE_MAX;																/* block following last match */
+	size_t          next_tried_n = 0, next_hit_n = 0;
+	struct rm_roll_win  win = { 0 };															/* bytes entering and leaving window */
+	const unsigned char *win_p = NULL;
+	struct rm_roll_ahead    ahead;																	/* states of next offsets of nonmatching region */
+	struct rm_roll_verify   v = { 0 };														/* bytes at a_k_pos checked against candidates */
+	enum rm_error   err = RM_ERR_OK;
 
 	if ((s == NULL) || (f_x == NULL) || (delta_f == NULL))
 		return RM_ERR_BAD_CALL;
@@ -432,12 +1124,22 @@ rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_m
 		return RM_ERR_BAD_CALL;
 
 	copy_all_threshold  = s->rec_ctx.copy_all_threshold;
+	v.prefilter         = s->rec_ctx.prefilter;
 	copy_tail_threshold = s->rec_ctx.copy_tail_threshold;
 	send_threshold      = s->rec_ctx.send_threshold;
 	if (send_threshold == 0)
 		return RM_ERR_BAD_CALL;
 
 	raw_bytes_max = rm_max(L, send_threshold);
+	if (s->type == RM_PUSH_TX) {
+		pthread_mutex_lock(&s->mutex);
+		raw_ranges = ((struct rm_session_push_tx*) s->prvt)->session_local.delta_raw_ranges;
+		spill = ((struct rm_session_push_tx*) s->prvt)->session_local.spill;
+		pthread_mutex_unlock(&s->mutex);
+	}
+
+	if (s->type == RM_PUSH_LOCAL && s->prvt != NULL)
+		spill = ((struct rm_session_push_local*) s->prvt)->spill;
 
 	fd = fileno(f_x);
 	if (fstat(fd, &fs) != 0)
@@ -448,8 +1150,10 @@ rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_m
 		return RM_ERR_TOO_MUCH_REQUESTED;   /* Nothing to do */
 
 	send_left = file_sz - from;             /* positive value */
+	md5_init(&x_md5);
+	RM_PROF_LAP_START(&prof_lap);
 
-	if ((send_left < copy_all_threshold) || (h == NULL)) {   /* copy all bytes */
+	if ((send_left < copy_all_threshold) || (h == NULL && spill == NULL)) {   /* copy all bytes */
 		copy_all_threshold_fired = 1;
 		copy_all = 1;
 		goto copy_tail;
@@ -460,13 +1164,23 @@ rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_m
 		goto copy_tail;
 	}
 
-	buf = malloc(L * sizeof(unsigned char));
-	if (buf == NULL)
-		return RM_ERR_MEM;
+	win.max = L + RM_ROLL_BATCH + RM_ROLL_WIN_LEN;
+	buf = malloc((L + win.max) * sizeof(unsigned char));										/* block being checked and read-ahead */
+	if (buf == NULL) {
+		err = RM_ERR_MEM;
+		goto out;
+	}
+	win.buf = buf + L;
+	win.md5 = &x_md5;
+	v.f_x = f_x;
+	v.buf = buf;
+	v.prof = &prof;
+	v.prof_lap = &prof_lap;
+	memset(&ahead, 0, sizeof(ahead));
 
 	a_k_pos = a_kL_pos = 0;
 	match = 1;
-	beginning_bytes_in_buf = 0;
+	v.beginning_bytes_in_buf = 0;
 	do {
 		if (send_left <= copy_tail_threshold) { /* send last bytes instead of doing normal lookup? */
 			copy_tail_threshold_fired = 1;
@@ -476,126 +1190,210 @@ rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, pthread_m
 			read_now = rm_min(L, send_left);
 			read = rm_fpread(buf, 1, read_now, a_kL_pos, f_x, NULL);
 			if (read != read_now) {
-				return RM_ERR_READ;
+				err = RM_ERR_READ;
+				goto out;
 			}
+			RM_PROF_LAP(&prof, RM_PROF_READ, &prof_lap);
 			if (read_begin == 0) {
 				read_begin = read;
-				beginning_bytes_in_buf = 1;
+				v.beginning_bytes_in_buf = 1;
 			} else {
-				beginning_bytes_in_buf = 0;
+				v.beginning_bytes_in_buf = 0;
 			}
-			ch.f_ch = rm_fast_check_block(buf, read);
+			roll_h = rm_roll_block(roll, buf, read);
+			v.ch.f_ch = rm_roll_f_ch(roll, roll_h);
+			v.buf_is_block = 1;
+			ahead.i = ahead.n = 0;
+			RM_PROF_LAP(&prof, RM_PROF_ROLL, &prof_lap);
 			a_k_pos = a_kL_pos;                             /* move a_k for next fast checksum calculation */
 			a_kL_pos = rm_min(file_sz - 1, a_k_pos + L);    /* a_kL for next fast checksum calculation */
 		} else {
+			v.buf_is_block = 0;
 			if (read == L && (a_kL_pos - a_k_pos == L)) {
-				if (rm_fpread(&a_kL, sizeof(unsigned char), 1, a_kL_pos, f_x, NULL) != 1) {
-					return RM_ERR_READ;
+				if (rm_rolling_ch_proc_ahead(&ahead, roll, f_x, file_sz, &win, a_k_pos, roll_h, (spill == NULL ? h : NULL), h_bits) != RM_ERR_OK) {
+					err = RM_ERR_READ;
+					goto out;
 				}
-				ch.f_ch = rm_fast_check_roll(ch.f_ch, a_k, a_kL, L);
+				RM_PROF_LAP(&prof, RM_PROF_READ, &prof_lap);
+				roll_h = ahead.h[ahead.i++];
+				v.ch.f_ch = rm_roll_f_ch(roll, roll_h);
 				read = read_now = rm_max(1u, a_kL_pos - a_k_pos);
 				++a_k_pos;
 				a_kL_pos = rm_min(a_kL_pos + 1, file_sz - 1);
+				RM_PROF_LAP(&prof, RM_PROF_ROLL, &prof_lap);
 			} else {
 				read = read_now = rm_max(1u, a_kL_pos - a_k_pos);
-				ch.f_ch = rm_fast_check_roll_tail(ch.f_ch, a_k, a_kL_pos - a_k_pos + 1); /* previous ch was calculated on a_kL_pos - a_k_pos + 1 bytes */
+				roll_h = rm_roll_roll_tail(roll, roll_h, a_k, a_kL_pos - a_k_pos + 1); /* previous ch was calculated on a_kL_pos - a_k_pos + 1 bytes */
+				v.ch.f_ch = rm_roll_f_ch(roll, roll_h);
 				++a_k_pos;
+				RM_PROF_LAP(&prof, RM_PROF_ROLL, &prof_lap);
 			}
 		} /* roll */
 		match = 0;
-		hash = twhash_min(ch.f_ch, RM_NONOVERLAPPING_HASH_BITS);
-		if (h_mutex != NULL)
-			pthread_mutex_lock(h_mutex);
-		twhlist_for_each_entry(e, &h[hash], hlink) {        /* hit 1, 1st Level match? (hashtable hash match) */
-			if (e->data.ch_ch.f_ch == ch.f_ch) {            /* hit 2, 2nd Level match?, (fast rolling checksum match) */
-				if (rm_copy_buffered_2(f_x, a_k_pos, buf, read, NULL) != RM_ERR_OK) {
-					return RM_ERR_COPY_BUFFERED;
+		chain_n = 0;
+		v.pos = a_k_pos;
+		v.read = read;
+		v.s_ch_ready = 0;
+		v.c_ch_ready = 0;
+		if (ref_next < by_ref_n && by_ref[ref_next] != NULL && by_ref[ref_next]->ch_ch.f_ch == v.ch.f_ch) {	/* block following last match? check it before lookup */
+			++next_tried_n;
+			if (rm_rolling_ch_proc_verify(&v, &by_ref[ref_next]->ch_ch, &match) != RM_ERR_OK) {
+				err = RM_ERR_COPY_BUFFERED;
+				goto out;
+			}
+			if (match == 1) {
+				ref = ref_next;
+				++next_hit_n;
+			}
+		}
+		if (match == 0 && spill != NULL) {
+			if (rm_spill_find(spill, v.ch.f_ch, &hits, &hits_n) != RM_ERR_OK) {	/* filter, then page of sorted file */
+				err = RM_ERR_READ;
+				goto out;
+			}
+			chain_n = hits_n;
+			if (hits_n > 0)
+				RM_PROF_LAP(&prof, RM_PROF_BUCKET, &prof_lap);
+			for (hit = 0; hit < hits_n; ++hit) {
+				if (rm_rolling_ch_proc_verify(&v, &hits[hit].ch_ch, &match) != RM_ERR_OK) {
+					err = RM_ERR_COPY_BUFFERED;
+					goto out;
 				}
-				beginning_bytes_in_buf = 0;
-				rm_md5(buf, read, ch.s_ch.data);            /* compute strong checksum. TODO something other than MD5? */
-				if (0 == memcmp(&e->data.ch_ch.s_ch.data, &ch.s_ch.data, RM_STRONG_CHECK_BYTES)) {  /* hit 3, 3rd Level match? (strong checksum match) */
-					match = 1;								/* OK, FOUND */
-					ref = e->data.ref;						/* reference */
+				if (match == 1) {
+					ref = hits[hit].ref;
 					break;
+				}
+			}
+		} else if (match == 0) {
+			hash = twhash_min(v.ch.f_ch, h_bits);
+			twhlist_for_each_entry(e, &h[hash], hlink) {        /* hit 1, 1st Level match? (hashtable hash match) */
+				++chain_n;
+				if (e->data.ch_ch.f_ch == v.ch.f_ch) {          /* hit 2, 2nd Level match?, (fast rolling checksum match) */
+					if (e->data.ref == ref_next && ref_next < by_ref_n)	/* verified already */
+						continue;
+					RM_PROF_LAP(&prof, RM_PROF_BUCKET, &prof_lap);
+					if (rm_rolling_ch_proc_verify(&v, &e->data.ch_ch, &match) != RM_ERR_OK) {	/* hit 3, 3rd Level match? (strong checksum match) */
+						err = RM_ERR_COPY_BUFFERED;
+						goto out;
+					}
+					if (match == 1) {
+						ref = e->data.ref;						/* OK, FOUND, reference */
+						break;
+					}
 				} else {
-					++collisions_2nd_level;                 /* 2nd Level collision, fast checksum match but strong checksum doesn't */
+					++collisions_1st_level;                     /* 1st Level collision, fast checksums are different but hashed to the same bucket */
 				}
-			} else {
-				++collisions_1st_level;                     /* 1st Level collision, fast checksums are different but hashed to the same bucket */
 			}
 		}
-
-		if (h_mutex != NULL)
-			pthread_mutex_unlock(h_mutex);
+		RM_PROF_CHAIN(&prof, chain_n);
+		if (match == 0)
+			RM_PROF_LAP(&prof, RM_PROF_BUCKET, &prof_lap);
 
 		if (match == 1) { /* tx RM_DELTA_ELEMENT_REFERENCE, TODO free delta object in callback!*/
+			if (raw_run_n > 0) {    /* but first: literal run? */
+				if (rm_rolling_ch_proc_tx_range(&cb_arg, delta_f, &win, raw_run_off, &raw_run_n) != RM_ERR_OK) {
+					err = RM_ERR_TX_RAW;
+					goto out;
+				}
+				RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
+			}
 			if (raw_bytes_n > 0) {    /* but first: any raw bytes buffered? */
-				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, ref - raw_bytes_n, raw_bytes, raw_bytes_n) != RM_ERR_OK) /* send them first, move ownership of raw bytes, reference is not used for RM_DELTA_ELEMENT_RAW_BYTES*/
-					return RM_ERR_TX_RAW;
+				md5_update(&x_md5, raw_bytes, raw_bytes_n);			/* before tx, callback takes ownership of raw bytes */
+				RM_PROF_LAP(&prof, RM_PROF_DIGEST, &prof_lap);
+				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, ref - raw_bytes_n, raw_bytes, raw_bytes_n) != RM_ERR_OK) { /* send them first, move ownership of raw bytes, reference is not used for RM_DELTA_ELEMENT_RAW_BYTES*/
+					err = RM_ERR_TX_RAW;
+					goto out;
+				}
+				RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
 
 				raw_bytes_n = 0;
 				raw_bytes = NULL;
 			}
+			ref_next = ref + 1;
+			md5_update(&x_md5, buf, read);							/* buf holds matched bytes */
+			RM_PROF_LAP(&prof, RM_PROF_DIGEST, &prof_lap);
 			if (read == file_sz) {
-				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_ZERO_DIFF, ref, NULL, file_sz) != RM_ERR_OK)
-					return RM_ERR_TX_ZERO_DIFF;
+				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_ZERO_DIFF, ref, NULL, file_sz) != RM_ERR_OK) {
+					err = RM_ERR_TX_ZERO_DIFF;
+					goto out;
+				}
 			} else if (read < L) {
-				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_TAIL, ref, NULL, read) != RM_ERR_OK)
-					return RM_ERR_TX_TAIL;
+				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_TAIL, ref, NULL, read) != RM_ERR_OK) {
+					err = RM_ERR_TX_TAIL;
+					goto out;
+				}
 			} else {
-				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_REFERENCE, ref,  NULL, L) != RM_ERR_OK)
-					return RM_ERR_TX_REF;
+				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_REFERENCE, ref,  NULL, L) != RM_ERR_OK) {
+					err = RM_ERR_TX_REF;
+					goto out;
+				}
 			}
+			RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
 			send_left -= read;
+		} else if (raw_ranges) { /* literal run of @x, transmitter sends it from @x */
+			win_p = rm_rolling_ch_proc_win(f_x, file_sz, &win, a_k_pos, 1);
+			if (win_p == NULL) {
+				err = RM_ERR_READ;
+				goto out;
+			}
+			a_k = *win_p;
+			RM_PROF_LAP(&prof, RM_PROF_READ, &prof_lap);
+			if (win.md5_n == 0) {                                       /* byte is added to digest from window */
+				win.md5_off = a_k_pos;
+			}
+			++win.md5_n;
+			send_left -= 1;
+			if (raw_run_n == 0) {
+				raw_run_off = a_k_pos;
+			}
+			++raw_run_n;
+			if ((raw_run_n == RM_DELTA_RAW_RANGE_MAX) || (send_left == 0)) {
+				if (rm_rolling_ch_proc_tx_range(&cb_arg, delta_f, &win, raw_run_off, &raw_run_n) != RM_ERR_OK) {
+					err = RM_ERR_TX_RAW;
+					goto out;
+				}
+				RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
+			}
 		} else { /* tx raw bytes */
-			if (raw_bytes_n == 0) {
+			if (raw_bytes == NULL) {
 				raw_bytes = malloc(raw_bytes_max * sizeof(unsigned char));
-				if (raw_bytes == NULL)
-					return RM_ERR_MEM;
+				if (raw_bytes == NULL) {
+					err = RM_ERR_MEM;
+					goto out;
+				}
 				memset(raw_bytes, 0, raw_bytes_max * sizeof(unsigned char));
 			}
-			if (beginning_bytes_in_buf == 1 && a_k_pos < read_begin) {  /* if we have still L bytes read at the beginning in the buffer */
+			if (v.beginning_bytes_in_buf == 1 && a_k_pos < read_begin) {  /* if we have still L bytes read at the beginning in the buffer */
 				a_k = buf[a_k_pos];                                     /* read a_k byte */
 			} else {
-				if (rm_fpread(&a_k, sizeof(unsigned char), 1, a_k_pos, f_x, NULL) != 1)
-					return RM_ERR_READ;
+				win_p = rm_rolling_ch_proc_win(f_x, file_sz, &win, a_k_pos, 1);
+				if (win_p == NULL) {
+					err = RM_ERR_READ;
+					goto out;
+				}
+				a_k = *win_p;
+				RM_PROF_LAP(&prof, RM_PROF_READ, &prof_lap);
 			}
 			raw_bytes[raw_bytes_n] = a_k;                               /* enqueue raw byte */
 			send_left -= 1;
 			++raw_bytes_n;
 			if ((raw_bytes_n == send_threshold) || (send_left == 0)) {               /* tx? TODO there will be more conditions on final transmit here! */
-				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, a_k_pos, raw_bytes, raw_bytes_n) != RM_ERR_OK)   /* tx, move ownership of raw bytes, reference is not used for RM_DELTA_ELEMENT_RAW_BYTES */
-					return RM_ERR_TX_RAW;
+				md5_update(&x_md5, raw_bytes, raw_bytes_n);
+				RM_PROF_LAP(&prof, RM_PROF_DIGEST, &prof_lap);
+				if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, a_k_pos, raw_bytes, raw_bytes_n) != RM_ERR_OK) {   /* tx, move ownership of raw bytes, reference is not used for RM_DELTA_ELEMENT_RAW_BYTES */
+					err = RM_ERR_TX_RAW;
+					goto out;
+				}
+				RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
 
 				raw_bytes_n = 0;
 				raw_bytes = NULL;
 			}
 		} /* match */
 	} while (send_left > 0);
-
-	pthread_mutex_lock(&s->mutex);
-	s->rec_ctx.collisions_1st_level = collisions_1st_level;
-	s->rec_ctx.collisions_2nd_level = collisions_2nd_level;
-	s->rec_ctx.copy_all_threshold_fired = copy_all_threshold_fired;
-	s->rec_ctx.copy_tail_threshold_fired = copy_tail_threshold_fired;
-	pthread_mutex_unlock(&s->mutex);
-
-	if (raw_bytes != NULL)
-		free(raw_bytes);
-
-	if (buf != NULL)
-		free(buf);
-
-	return RM_ERR_OK;
+	goto out;
 
 copy_tail:
-	pthread_mutex_lock(&s->mutex);
-	s->rec_ctx.collisions_1st_level = collisions_1st_level;
-	s->rec_ctx.collisions_2nd_level = collisions_2nd_level;
-	s->rec_ctx.copy_all_threshold_fired = copy_all_threshold_fired;
-	s->rec_ctx.copy_tail_threshold_fired = copy_tail_threshold_fired;
-	pthread_mutex_unlock(&s->mutex);
-
 	if ((copy_all == 0) && (copy_tail_threshold_fired == 1)) { /* if copy tail but not all */
 		if (match == 0) {
 			a_k_pos++;
@@ -604,36 +1402,94 @@ copy_tail:
 		}
 	}
 
+	if (raw_run_n > 0) {    /* but first: literal run? */
+		if (rm_rolling_ch_proc_tx_range(&cb_arg, delta_f, &win, raw_run_off, &raw_run_n) != RM_ERR_OK) {
+			err = RM_ERR_TX_RAW;
+			goto out;
+		}
+		RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
+	}
 	if (raw_bytes_n > 0) {    /* but first: any raw bytes buffered? */
+		md5_update(&x_md5, raw_bytes, raw_bytes_n);
+		RM_PROF_LAP(&prof, RM_PROF_DIGEST, &prof_lap);
 		if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, a_k_pos - raw_bytes_n, raw_bytes, raw_bytes_n) != RM_ERR_OK) { /* send them first, move ownership of raw bytes */
-			return RM_ERR_TX_RAW;
+			err = RM_ERR_TX_RAW;
+			goto out;
 		}
+		RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
 		raw_bytes_n = 0;
 		raw_bytes = NULL;
 	}
 
-	raw_bytes = malloc(send_left * sizeof(*raw_bytes));
-	if (raw_bytes == NULL) {
-		if (buf != NULL) free(buf);
-		return RM_ERR_MEM;
-	}
+	while (send_left > 0) {    /* in elements of at most RM_DELTA_RAW_BUF_LEN bytes, so each is bounded by queue limit */
+		raw_bytes_n = rm_min(send_left, RM_DELTA_RAW_BUF_LEN);
+		raw_bytes = malloc(raw_bytes_n * sizeof(*raw_bytes));
+		if (raw_bytes == NULL) {
+			err = RM_ERR_MEM;
+			goto out;
+		}
+		if (rm_copy_buffered_2(f_x, a_k_pos, raw_bytes, raw_bytes_n, NULL) != RM_ERR_OK) {
+			err = RM_ERR_COPY_BUFFERED_2;
+			goto out;
+		}
+		RM_PROF_LAP(&prof, RM_PROF_READ, &prof_lap);
 
-	if (rm_copy_buffered_2(f_x, a_k_pos, raw_bytes, send_left, NULL) != RM_ERR_OK) {
-		if (buf != NULL) free(buf);
-		free(raw_bytes);
-		return RM_ERR_COPY_BUFFERED_2;
+		md5_update(&x_md5, raw_bytes, raw_bytes_n);
+		RM_PROF_LAP(&prof, RM_PROF_DIGEST, &prof_lap);
+		if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, a_k_pos, raw_bytes, raw_bytes_n) != RM_ERR_OK) {   /* tx, move ownership of raw bytes */
+			err = RM_ERR_TX_RAW;
+			goto out;
+		}
+		RM_PROF_LAP(&prof, RM_PROF_QUEUE, &prof_lap);
+		raw_bytes = NULL;
+		a_k_pos += raw_bytes_n;
+		send_left -= raw_bytes_n;
 	}
+	raw_bytes_n = 0;
+	goto out;
 
-	if (rm_rolling_ch_proc_tx(&cb_arg, delta_f, RM_DELTA_ELEMENT_RAW_BYTES, a_k_pos, raw_bytes, send_left) != RM_ERR_OK) {   /* tx, move ownership of raw bytes */
-		if (buf != NULL) free(buf);
-		free(raw_bytes);
-		return RM_ERR_TX_RAW;
+out:
+	if (err == RM_ERR_OK) {
+		pthread_mutex_lock(&s->mutex);
+		s->rec_ctx.collisions_1st_level = collisions_1st_level;
+		s->rec_ctx.collisions_2nd_level = v.collisions_2nd_level;
+		s->rec_ctx.next_tried_n = next_tried_n;
+		s->rec_ctx.next_hit_n = next_hit_n;
+		s->rec_ctx.prefilter_pass_n = v.prefilter_pass_n;
+		s->rec_ctx.prefilter_reject_n = v.prefilter_reject_n;
+		s->rec_ctx.copy_all_threshold_fired = copy_all_threshold_fired;
+		s->rec_ctx.copy_tail_threshold_fired = copy_tail_threshold_fired;
+		md5_final(&x_md5, s->rec_ctx.x_digest.data);
+		s->rec_ctx.prof = prof;
+		pthread_mutex_unlock(&s->mutex);
 	}
+	free(raw_bytes);                        /* not sent, still owned here */
+	free(buf);
+	return err;
+}
 
-	if (buf != NULL)
-		free(buf);
-
-	return RM_ERR_OK;
+enum rm_error
+rm_rolling_ch_proc(struct rm_session *s, const struct twhlist_head *h, uint8_t h_bits, pthread_mutex_t *h_mutex,
+		FILE *f_x, rm_delta_f *delta_f, size_t from) {
+	const struct rm_ch_ch_ref   **by_ref = NULL;													/* checksums by block, to verify block following last match */
+	size_t                      by_ref_n = 0;
+	enum rm_error               err = RM_ERR_OK;
+	struct rm_roll              roll;
+
+	if (s != NULL)
+		rm_roll_init(&roll, s->rec_ctx.roll, s->rec_ctx.roll_seed, s->rec_ctx.L);				/* as receiver computed checksums of @y */
+	else
+		rm_roll_init(&roll, RM_ROLL_FAST, 0, 0);
+
+	if (h != NULL && h_mutex != NULL)
+		pthread_mutex_lock(h_mutex);															/* table is complete before rolling starts, single lock for whole lookup */
+	if (h != NULL)
+		by_ref = rm_rx_ch_ch_hash_index(h, h_bits, &by_ref_n);										/* no memory: lookup only */
+	err = rm_rolling_ch_proc_indexed(s, h, h_bits, by_ref, by_ref_n, &roll, f_x, delta_f, from);
+	if (h != NULL && h_mutex != NULL)
+		pthread_mutex_unlock(h_mutex);
+	free((void*) by_ref);
+	return err;
 }
 
 enum rm_error
@@ -672,6 +1528,8 @@ rm_roll_proc_cb_1(void *arg) {
 	enum rm_session_type			t = 0;
 	struct rm_delta_reconstruct_ctx	*ctx = NULL;
 	uint8_t							update_ctx = 0;
+	size_t							charge = 0;
+	struct timespec					stall_start, stall_stop, stall;
 
 	cb_arg = (struct rm_roll_proc_cb_arg*) arg;
 	if (cb_arg == NULL) {
@@ -753,8 +1611,27 @@ rm_roll_proc_cb_1(void *arg) {
 		pthread_mutex_unlock(&s->mutex);
 	}
 
+	charge = rm_delta_e_queue_charge(delta_e);
 	pthread_mutex_lock(&prvt_local->tx_delta_e_queue_mutex);    /* enqueue delta (and move ownership to delta_rx_tid!) */
+	if (prvt_local->tx_delta_e_queue_limit != 0 && prvt_local->tx_delta_e_queue_bytes != 0
+			&& prvt_local->tx_delta_e_queue_bytes + charge > prvt_local->tx_delta_e_queue_limit && prvt_local->tx_delta_e_queue_closed == 0) {	/* full, element bigger than limit is let in once queue is empty */
+		clock_gettime(CLOCK_MONOTONIC, &stall_start);
+		while (prvt_local->tx_delta_e_queue_bytes != 0 && prvt_local->tx_delta_e_queue_bytes + charge > prvt_local->tx_delta_e_queue_limit
+				&& prvt_local->tx_delta_e_queue_closed == 0)
+			pthread_cond_wait(&prvt_local->tx_delta_e_queue_space, &prvt_local->tx_delta_e_queue_mutex);
+		clock_gettime(CLOCK_MONOTONIC, &stall_stop);
+		rm_util_calc_timespec_diff(&stall_start, &stall_stop, &stall);
+		prvt_local->tx_delta_e_queue_stalls_n++;
+		prvt_local->tx_delta_e_queue_stall_time += stall.tv_sec + (double) stall.tv_nsec / RM_NANOSEC_PER_SEC;
+	}
+	if (prvt_local->tx_delta_e_queue_closed != 0) {
+		pthread_mutex_unlock(&prvt_local->tx_delta_e_queue_mutex);
+		return RM_ERR_QUEUE_CLOSED;
+	}
 	twfifo_enqueue(&delta_e->link, &prvt_local->tx_delta_e_queue);
+	prvt_local->tx_delta_e_queue_bytes += charge;
+	if (prvt_local->tx_delta_e_queue_bytes > prvt_local->tx_delta_e_queue_bytes_peak)
+		prvt_local->tx_delta_e_queue_bytes_peak = prvt_local->tx_delta_e_queue_bytes;
 	pthread_cond_signal(&prvt_local->tx_delta_e_queue_signal);
 	pthread_mutex_unlock(&prvt_local->tx_delta_e_queue_mutex);
 
@@ -766,7 +1643,7 @@ rm_file_cmp(FILE *x, FILE *y, size_t x_offset, size_t y_offset, size_t bytes_n)
 	size_t read = 0, read_exp;
 	unsigned char buf1[RM_L1_CACHE_RECOMMENDED], buf2[RM_L1_CACHE_RECOMMENDED];
 
-	if (fseek(x, x_offset, SEEK_SET) != 0 || fseek(y, y_offset, SEEK_SET) != 0) {
+	if (fseeko(x, (off_t) x_offset, SEEK_SET) != 0 || fseeko(y, (off_t) y_offset, SEEK_SET) != 0) {
 		return RM_ERR_FSEEK;
 	}
 	read_exp = RM_L1_CACHE_RECOMMENDED < bytes_n ?
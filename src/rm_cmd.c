@@ -22,7 +22,9 @@ static void rsyncme_usage(const char *name)
 		return;
 	
 	fprintf(stderr, "\nusage:\t %s push <-x file> <[-i IPv4 [-p port]]|[-y file]> [-z file] [-a threshold] [-t threshold] [-s threshold]\n\n", name);
-	fprintf(stderr, "      \t               [-l block_size] [--f(orce)] [--l(eave)] [--help] [--version] [--loglevel level]\n\n");
+	fprintf(stderr, "      \t               [-l block_size] [--f(orce)] [--l(eave)] [--help] [--version] [--loglevel level]\n");
+	fprintf(stderr, "      \t               [--tree [--inflight n]] [--queue_bytes n] [--codec name[+ref][:level]]\n");
+	fprintf(stderr, "      \t               [--mem_bytes n] [--roll fast|poly] [--prefilter]\n\n");
 	fprintf(stderr, "     \t -x           : file to synchronize\n");
 	fprintf(stderr, "     \t -i           : IP address or domain name of the receiver of file\n");
 	fprintf(stderr, "     \t -p           : receiver's port (defaults to %u)\n", RM_DEFAULT_PORT);
@@ -47,6 +49,28 @@ static void rsyncme_usage(const char *name)
 	fprintf(stderr, "     \t --help       : display this help and exit\n");
 	fprintf(stderr, "     \t --version    : output version information and exit\n");
 	fprintf(stderr, "     \t --loglevel   : set log verbosity (defalut is NORMAL)\n");
+	fprintf(stderr, "     \t --tree       : remote push only: @x, @y (and @z) are directories, all regular\n"
+			"     \t                files found in @x are synced over single connection\n");
+	fprintf(stderr, "     \t --inflight   : number of files receiver prepares ahead in --tree push\n"
+			"     \t                (defaults to %u, max %u)\n", RM_TREE_INFLIGHT_DEFAULT, RM_TREE_INFLIGHT_MAX);
+	fprintf(stderr, "     \t --queue_bytes: limit on memory held by delta elements waiting for reconstruction\n"
+			"     \t                or transmission, rolling stops until they are consumed\n"
+			"     \t                (defaults to %u, 0 means no limit)\n", RM_DELTA_QUEUE_BYTES);
+	fprintf(stderr, "     \t --codec      : remote push only: compress literal bytes of delta stream\n"
+			"     \t                with none (default), zlib or zstd (if built with it),\n"
+			"     \t                level 0 means codec's default, receiver may refuse\n"
+			"     \t                codec and then bytes are sent as they are,\n"
+			"     \t                +ref compresses them against recently matched blocks\n");
+	fprintf(stderr, "     \t --mem_bytes  : limit on memory held by checksums of @y, above it they are\n"
+			"     \t                sorted on disk and only filter and index stay in memory,\n"
+			"     \t                shared by files in flight in --tree push\n"
+			"     \t                (defaults to %u, 0 means no limit)\n", RM_CH_CH_MEM_BYTES);
+	fprintf(stderr, "     \t --roll       : rolling checksum matched against checksums of @y, fast (default)\n"
+			"     \t                or poly, polynomial over bytes mapped through table seeded\n"
+			"     \t                per session (fewer collisions on low-entropy data), receiver\n"
+			"     \t                may refuse it and then fast is used\n");
+	fprintf(stderr, "     \t --prefilter  : check fast checksum matches with CRC32C of block before MD5\n"
+			"     \t                (checksums of @y grow by 4 bytes), receiver may refuse it\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "     \t If no option is specified, --help is assumed.\n");
 
@@ -67,6 +91,9 @@ static void rsyncme_usage(const char *name)
 	fprintf(stderr, "	rsyncme push -x /tmp/foo.tar -i 245.218.125.22\n"
 			"		This will sync local /tmp/foo.tar with remote\n"
 			"		file with same name (remote becomes same as local is).\n");
+	fprintf(stderr, "	rsyncme push -x /tmp/src -i 245.218.125.22 -y /tmp/dst --tree --force\n"
+			"		This will sync all files in local directory /tmp/src with files under\n"
+			"		same relative paths in remote directory /tmp/dst (missing ones are created).\n");
 	fprintf(stderr, "	rsyncme push -x foo.tar -y bar.tar\n"
 			"		This will sync local foo.tar with local bar.tar\n"
 			"		(bar.tar becomes same as foo.tar is).\n");
@@ -80,6 +107,28 @@ static void rsyncme_range_error(char argument, unsigned long value)
 	fprintf(stderr, "\nERR, argument [%c] too big [%lu]\n\n", argument, value);
 }
 
+static void rsyncme_print_tree_stats(const struct rm_tx_tree_stats *stats)
+{
+	fprintf(stderr, "\nfiles       : [%" PRIu64 "] (synced [%" PRIu64 "], failed [%" PRIu64 "])", stats->files_n, stats->files_ok_n, stats->files_fail_n);
+	fprintf(stderr, "\nbytes       : [%" PRIu64 "] (by raw [%zu], by refs [%zu])", stats->bytes_n, stats->rec_ctx.rec_by_raw, stats->rec_ctx.rec_by_ref);
+	fprintf(stderr, "\ndeltas      : [%zu] (raw [%zu], refs [%zu])", stats->rec_ctx.delta_raw_n + stats->rec_ctx.delta_ref_n, stats->rec_ctx.delta_raw_n, stats->rec_ctx.delta_ref_n);
+	if (stats->rec_ctx.codec != RM_CODEC_NONE)
+		fprintf(stderr, "\nliterals    : [%zu] -> [%zu] (stored [%zu], codec [%s], level [%u])", stats->rec_ctx.rec_by_raw, stats->rec_ctx.rec_by_raw_z,
+				stats->rec_ctx.rec_by_raw_stored, rm_codec_str(stats->rec_ctx.codec), stats->rec_ctx.codec_level);
+	if (stats->rec_ctx.roll != RM_ROLL_FAST)
+		fprintf(stderr, "\nrolling     : [%s]", rm_roll_str(stats->rec_ctx.roll));
+	if (stats->rec_ctx.next_tried_n > 0)
+		fprintf(stderr, "\nnext block  : tried [%zu], matched [%zu] (rate [%.3f])", stats->rec_ctx.next_tried_n, stats->rec_ctx.next_hit_n,
+				(double) stats->rec_ctx.next_hit_n / stats->rec_ctx.next_tried_n);
+	if (stats->rec_ctx.prefilter != RM_PREFILTER_NONE)
+		fprintf(stderr, "\nprefilter   : crc32c passed [%zu], rejected [%zu]", stats->rec_ctx.prefilter_pass_n, stats->rec_ctx.prefilter_reject_n);
+	if (stats->rec_ctx.h_stats.bits > 0)
+		rm_rx_print_hash_stats(&stats->rec_ctx.h_stats);
+	if (stats->rec_ctx.spill_stats.entries_n > 0)
+		rm_rx_print_spill_stats(&stats->rec_ctx.spill_stats);
+	fprintf(stderr, "\ndelta queue : peak [%zu] bytes, stalls [%zu], stalled [%f] s\n", stats->rec_ctx.delta_queue_bytes_peak, stats->rec_ctx.delta_queue_stalls_n, stats->rec_ctx.delta_queue_stall_time);
+}
+
 static void help_hint(const char *name)
 {
 	if (name == NULL)
@@ -121,7 +170,9 @@ int main(int argc, char *argv[])
 	char					z_dirname[PATH_MAX];
 	char					*z_dname = NULL;
 
-	struct rm_tx_options	opt = { .loglevel = RM_LOGLEVEL_NORMAL };
+	struct rm_tx_options	opt = { .loglevel = RM_LOGLEVEL_NORMAL, .inflight = RM_TREE_INFLIGHT_DEFAULT, .queue_bytes = RM_DELTA_QUEUE_BYTES, .mem_bytes = RM_CH_CH_MEM_BYTES };
+	uint8_t					tree = 0;
+	struct rm_tx_tree_stats	tree_stats;
 
 
 	if (argc < 2) {
@@ -141,6 +192,13 @@ int main(int argc, char *argv[])
 		{ "timeout_s", required_argument, 0, 7 },
 		{ "timeout_us", required_argument, 0, 8 },
 		{ "loglevel", required_argument, 0, 9 },
+		{ "tree", no_argument, 0, 10 },
+		{ "inflight", required_argument, 0, 11 },
+		{ "queue_bytes", required_argument, 0, 12 },
+		{ "codec", required_argument, 0, 13 },
+		{ "mem_bytes", required_argument, 0, 14 },
+		{ "roll", required_argument, 0, 15 },
+		{ "prefilter", no_argument, 0, 16 },
 		{ 0 }
 	};
 
@@ -229,6 +287,73 @@ int main(int argc, char *argv[])
 				opt.loglevel = helper;
 				break;
 
+			case 10:
+				tree = 1;																											/* --tree */
+				break;
+
+			case 11:																												/* inflight */
+				helper = strtoul(optarg, &pCh, 10);
+				if (helper > RM_TREE_INFLIGHT_MAX || helper == 0) {
+					rsyncme_range_error(c, helper);
+					exit(EXIT_FAILURE);
+				}
+				if ((pCh == optarg) || (*pCh != '\0')) {    /* check */
+					fprintf(stderr, "Invalid argument\n");
+					fprintf(stderr, "Parameter conversion error, nonconvertible part is: [%s]\n", pCh);
+					help_hint(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				opt.inflight = helper;
+				break;
+
+			case 12:																												/* queue_bytes */
+				helper = strtoull(optarg, &pCh, 10);
+				if ((pCh == optarg) || (*pCh != '\0')) {    /* check */
+					fprintf(stderr, "Invalid argument\n");
+					fprintf(stderr, "Parameter conversion error, nonconvertible part is: [%s]\n", pCh);
+					help_hint(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				opt.queue_bytes = helper;
+				break;
+
+			case 13:																												/* codec */
+				if (rm_codec_parse(optarg, &opt.codec, &opt.codec_level) != RM_ERR_OK) {
+					fprintf(stderr, "Invalid argument\n");
+					fprintf(stderr, "Unknown codec [%s]\n", optarg);
+					help_hint(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				if (rm_codec_supported(opt.codec) == 0) {
+					fprintf(stderr, "Codec [%s] is not supported by this build\n", rm_codec_str(opt.codec));
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 14:																												/* mem_bytes */
+				helper = strtoull(optarg, &pCh, 10);
+				if ((pCh == optarg) || (*pCh != '\0')) {    /* check */
+					fprintf(stderr, "Invalid argument\n");
+					fprintf(stderr, "Parameter conversion error, nonconvertible part is: [%s]\n", pCh);
+					help_hint(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				opt.mem_bytes = helper;
+				break;
+
+			case 15:																												/* roll */
+				if (rm_roll_parse(optarg, &opt.roll) != RM_ERR_OK) {
+					fprintf(stderr, "Invalid argument\n");
+					fprintf(stderr, "Unknown rolling checksum [%s]\n", optarg);
+					help_hint(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 16:																												/* prefilter */
+				opt.prefilter = RM_PREFILTER_CRC32C;
+				break;
+
 			case 'x':
 				if (strlen(optarg) > RM_FILE_LEN_MAX - 1) {
 					fprintf(stderr, "-x name too long\n");
@@ -444,14 +569,24 @@ int main(int argc, char *argv[])
 			}
 		}
 	}
+	if (tree && (((push_flags & RM_BIT_5) == 0u) || (push_flags & RM_BIT_0))) {
+		fprintf(stderr, "\n--tree is supported only with remote push.\n");
+		help_hint(argv[0]);
+		exit(EXIT_FAILURE);
+	}
 	if (L <= sizeof(struct rm_ch_ch)) { /* warn there is no performance benefit in using rsyncme when block size is less than checksums overhead (apart from nonuniform distribution of byte stream transmitted) */
 		fprintf(stderr, "\nWarning: block size [%zu] disables possibility of improvement. Consider block bigger than [%zu].\n", L, sizeof(struct rm_ch_ch));
 	}
 
 	if ((push_flags & RM_BIT_5) != 0u) { /* remote request if -i is set */
 		if ((push_flags & RM_BIT_0) == 0u) { /* remote push request? */
-			fprintf(stderr, "\nRemote push.\n");
-			res = rm_tx_remote_push(xp, yp, zp, L, copy_all_threshold, copy_tail_threshold, send_threshold, push_flags, &rec_ctx, addr, port, timeout_s, timeout_us, &err_str, &opt);
+			if (tree) {
+				fprintf(stderr, "\nRemote push (tree).\n");
+				res = rm_tx_remote_push_tree(xp, yp, zp, L, copy_all_threshold, copy_tail_threshold, send_threshold, push_flags, &tree_stats, addr, port, timeout_s, timeout_us, &err_str, &opt);
+			} else {
+				fprintf(stderr, "\nRemote push.\n");
+				res = rm_tx_remote_push(xp, yp, zp, L, copy_all_threshold, copy_tail_threshold, send_threshold, push_flags, &rec_ctx, addr, port, timeout_s, timeout_us, &err_str, &opt);
+			}
 			if (res != RM_ERR_OK) {
 				fprintf(stderr, "\n");
 				switch (res) {
@@ -582,6 +717,16 @@ int main(int argc, char *argv[])
 					case RM_ERR_RENAME_TMP_Z:
 						fprintf(stderr, "Error. Receiver can't rename result file to @z [%s]\n", z);
 						goto fail;
+					case RM_ERR_DIR:
+						fprintf(stderr, "Error. @x [%s] is not a directory or can't be read\n", x);
+						goto fail;
+					case RM_ERR_FILE_SIZE:
+						fprintf(stderr, "Error. File in @x [%s] changed size during push\n", x);
+						goto fail;
+					case RM_ERR_TREE_PARTIAL:
+						fprintf(stderr, "Error. Receiver couldn't sync some of the files (see receiver's log)\n");
+						rsyncme_print_tree_stats(&tree_stats);
+						goto fail;
 					default:
 						fprintf(stderr, "\nError.\n");
 						return -1;
@@ -648,6 +793,10 @@ int main(int argc, char *argv[])
 					case RM_ERR_FILE_SIZE_REC_MISMATCH:
 						fprintf(stderr, "Error. Bad size of result file (reconstruction error)\n");
 						goto fail;
+					case RM_ERR_DIGEST_MISMATCH:
+						fprintf(stderr, "Error. Digest of result file doesn't match (reconstruction error)\n");
+						rm_rx_print_stats(rec_ctx, 0, 0);
+						goto fail;
 					case RM_ERR_UNLINK_Y:
 						fprintf(stderr, "Error. Cannot unlink @y\n");
 						goto fail;
@@ -727,6 +876,10 @@ int main(int argc, char *argv[])
 					case RM_ERR_FILE_SIZE_REC_MISMATCH:
 						fprintf(stderr, "Error. Bad size of result file (reconstruction error)\n");
 						goto fail;
+					case RM_ERR_DIGEST_MISMATCH:
+						fprintf(stderr, "Error. Digest of result file doesn't match (reconstruction error)\n");
+						rm_rx_print_stats(rec_ctx, 0, 0);
+						goto fail;
 					case RM_ERR_UNLINK_Y:
 						fprintf(stderr, "Error. Cannot unlink @x\n");
 						goto fail;
@@ -757,6 +910,10 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (tree) {
+		rsyncme_print_tree_stats(&tree_stats);
+		return RM_ERR_OK;
+	}
 	rm_rx_print_stats(rec_ctx, (push_flags & RM_BIT_5 ? 1 : 0), 1);
 	return RM_ERR_OK;
 
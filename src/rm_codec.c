@@ -0,0 +1,519 @@
+/* @file        rm_codec.c
+ * @brief       Compression of literal (RAW_BYTES) delta payloads.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        20 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_codec.h"
+
+
+#define RM_CODEC_ZLIB_WBITS     (-15)   /* raw deflate, 32 KiB window */
+#define RM_CODEC_ZLIB_MEMLEVEL  8
+#define RM_CODEC_ZLIB_DICT_MAX  32768u  /* deflate window */
+
+uint8_t
+rm_codec_supported(uint8_t type) {
+	if (type == RM_CODEC_REF) {                                             /* flag of no codec */
+		return 0;
+	}
+	switch (type & RM_CODEC_TYPE_MASK) {
+		case RM_CODEC_NONE:
+		case RM_CODEC_ZLIB:
+			return 1;
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:
+			return 1;
+#endif
+		default:
+			return 0;
+	}
+}
+
+const char*
+rm_codec_str(uint8_t type) {
+	switch (type) {
+		case RM_CODEC_NONE:
+			return "none";
+		case RM_CODEC_ZLIB:
+			return "zlib";
+		case RM_CODEC_ZSTD:
+			return "zstd";
+		case RM_CODEC_ZLIB | RM_CODEC_REF:
+			return "zlib+ref";
+		case RM_CODEC_ZSTD | RM_CODEC_REF:
+			return "zstd+ref";
+		default:
+			return "unknown";
+	}
+}
+
+enum rm_error
+rm_codec_parse(const char *s, uint8_t *type, uint8_t *level) {
+	const char      *colon = NULL;
+	size_t          name_len = 0;
+	uint8_t         ref = 0;
+	char            *end = NULL;
+	unsigned long   l = 0;
+
+	colon = strchr(s, ':');
+	name_len = (colon != NULL ? (size_t) (colon - s) : strlen(s));
+	if (name_len > 4 && strncmp(s + 4, "+ref", name_len - 4) == 0 && name_len == 8) {
+		ref = RM_CODEC_REF;
+		name_len = 4;
+	}
+	if (name_len == 4 && strncmp(s, "none", 4) == 0 && ref == 0) {
+		*type = RM_CODEC_NONE;
+	} else if (name_len == 4 && strncmp(s, "zlib", 4) == 0) {
+		*type = RM_CODEC_ZLIB;
+	} else if (name_len == 4 && strncmp(s, "zstd", 4) == 0) {
+		*type = RM_CODEC_ZSTD;
+	} else {
+		return RM_ERR_ARG;
+	}
+	*type |= ref;
+	*level = 0;
+	if (colon == NULL) {
+		return RM_ERR_OK;
+	}
+	errno = 0;
+	l = strtoul(colon + 1, &end, 10);
+	if (errno != 0 || end == colon + 1 || *end != '\0' || l > UINT8_MAX) {
+		return RM_ERR_ARG;
+	}
+	*level = (uint8_t) l;
+	return RM_ERR_OK;
+}
+
+enum rm_error
+rm_codec_init(struct rm_codec *c, uint8_t type, uint8_t level, uint8_t compress, int dict_fd) {
+	int     zlevel = Z_DEFAULT_COMPRESSION;
+
+	memset(c, 0, sizeof(*c));
+	c->type = type & RM_CODEC_TYPE_MASK;
+	c->level = level;
+	c->compress = compress;
+	c->skip_next = RM_CODEC_SKIP_MIN;
+	c->dict_fd = dict_fd;
+	if (rm_codec_supported(type) == 0) {
+		c->type = RM_CODEC_NONE;
+		return RM_ERR_ARG;
+	}
+	if (c->type != RM_CODEC_NONE && (type & RM_CODEC_REF)) {
+		c->ref = 1;
+		c->dict = malloc(RM_CODEC_DICT_MAX);
+		if (c->dict == NULL) {
+			goto fail;
+		}
+	}
+	switch (c->type) {
+		case RM_CODEC_ZLIB:
+			if (compress != 0) {
+				if (level != 0) {
+					zlevel = rm_min(level, Z_BEST_COMPRESSION);
+				}
+				c->hist = malloc(2 * RM_CODEC_ZLIB_DICT_MAX);
+				if (c->hist == NULL) {
+					goto fail;
+				}
+				if (deflateInit2(&c->zs, zlevel, Z_DEFLATED, RM_CODEC_ZLIB_WBITS, RM_CODEC_ZLIB_MEMLEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+					goto fail;
+				}
+			} else {
+				if (inflateInit2(&c->zs, RM_CODEC_ZLIB_WBITS) != Z_OK) {
+					goto fail;
+				}
+			}
+			break;
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:
+			if (compress != 0) {
+				c->zc = ZSTD_createCCtx();
+				if (c->zc == NULL) {
+					goto fail;
+				}
+				if (level != 0) {
+					ZSTD_CCtx_setParameter(c->zc, ZSTD_c_compressionLevel, rm_min(level, ZSTD_maxCLevel()));
+				}
+			} else {
+				c->zd = ZSTD_createDCtx();
+				if (c->zd == NULL) {
+					goto fail;
+				}
+			}
+			break;
+#endif
+		default:
+			break;
+	}
+	return RM_ERR_OK;
+
+fail:
+	free(c->dict);
+	c->dict = NULL;
+	free(c->hist);
+	c->hist = NULL;
+	c->type = RM_CODEC_NONE;
+	return RM_ERR_MEM;
+}
+
+void
+rm_codec_free(struct rm_codec *c) {
+	switch (c->type) {
+		case RM_CODEC_ZLIB:
+			if (c->compress != 0) {
+				deflateEnd(&c->zs);
+			} else {
+				inflateEnd(&c->zs);
+			}
+			break;
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:
+			if (c->zc != NULL) {
+				ZSTD_freeCCtx(c->zc);
+				c->zc = NULL;
+			}
+			if (c->zd != NULL) {
+				ZSTD_freeDCtx(c->zd);
+				c->zd = NULL;
+			}
+			break;
+#endif
+		default:
+			break;
+	}
+	free(c->buf);
+	c->buf = NULL;
+	c->buf_size = 0;
+	free(c->dict);
+	c->dict = NULL;
+	free(c->hist);
+	c->hist = NULL;
+	c->hist_n = 0;
+	c->type = RM_CODEC_NONE;
+}
+
+void
+rm_codec_dict_add(struct rm_codec *c, size_t ref, uint64_t pos, uint64_t off, size_t len) {
+	struct rm_codec_extent  *last = NULL;
+
+	if (c->ref == 0 || len == 0) {
+		return;
+	}
+	c->dict_stale = 1;
+	if (c->extents_n > 0) {
+		last = &c->extents[(c->extents_head + RM_CODEC_DICT_EXTENTS - 1) % RM_CODEC_DICT_EXTENTS];
+		if (last->ref + 1 == ref && last->pos + last->len == pos) {         /* next block of the same run */
+			last->len += len;
+			last->ref = ref;
+			return;
+		}
+	}
+	c->extents[c->extents_head].off = off;
+	c->extents[c->extents_head].len = len;
+	c->extents[c->extents_head].ref = ref;
+	c->extents[c->extents_head].pos = pos;
+	c->extents_head = (c->extents_head + 1) % RM_CODEC_DICT_EXTENTS;
+	c->extents_n = rm_min(c->extents_n + 1, RM_CODEC_DICT_EXTENTS);
+}
+
+/* @brief   Read newest @max bytes of matched blocks into @dict, oldest first. */
+static enum rm_error
+rm_codec_dict_load(struct rm_codec *c, size_t max) {
+	const struct rm_codec_extent    *e = NULL;
+	uint32_t    i = 0;
+	size_t      total = 0, take = 0, done = 0, at = 0;
+	ssize_t     n = 0;
+	uint64_t    off = 0;
+
+	for (i = 0; i < c->extents_n && total < max; ++i) {                     /* dictionary size */
+		e = &c->extents[(c->extents_head + RM_CODEC_DICT_EXTENTS - 1 - i) % RM_CODEC_DICT_EXTENTS];
+		total += rm_min(e->len, max - total);
+	}
+	c->dict_n = total;
+	at = total;
+	for (i = 0; at > 0; ++i) {                                              /* newest at the end, oldest extent may contribute only its tail */
+		e = &c->extents[(c->extents_head + RM_CODEC_DICT_EXTENTS - 1 - i) % RM_CODEC_DICT_EXTENTS];
+		take = rm_min(e->len, at);
+		at -= take;
+		off = e->off + e->len - take;
+		for (done = 0; done < take; done += n) {
+			n = pread(c->dict_fd, c->dict + at + done, take - done, off + done);
+			if (n <= 0) {
+				if (n < 0 && errno == EINTR) {
+					n = 0;
+					continue;
+				}
+				c->dict_n = 0;
+				return RM_ERR_READ;
+			}
+		}
+	}
+	return RM_ERR_OK;
+}
+
+/* @brief   Set dictionary before compressed payload (both sides in the same order). */
+static enum rm_error
+rm_codec_dict_set(struct rm_codec *c) {
+	enum rm_error   err = RM_ERR_OK;
+
+	switch (c->type) {
+		case RM_CODEC_ZLIB:
+			if (c->dict_stale == 0) {                                       /* window still has it, followed by literals since then */
+				return RM_ERR_OK;
+			}
+			err = rm_codec_dict_load(c, RM_CODEC_ZLIB_DICT_MAX);
+			if (err != RM_ERR_OK) {
+				return err;
+			}
+			c->dict_stale = 0;
+			if (c->dict_n == 0) {
+				return RM_ERR_OK;
+			}
+			if (c->compress != 0) {
+				return (deflateSetDictionary(&c->zs, c->dict, c->dict_n) == Z_OK ? RM_ERR_OK : RM_ERR_CODEC);
+			}
+			return (inflateSetDictionary(&c->zs, c->dict, c->dict_n) == Z_OK ? RM_ERR_OK : RM_ERR_CODEC);
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:                                                 /* each payload is a frame, prefix is referenced by each */
+			if (c->dict_stale != 0) {
+				err = rm_codec_dict_load(c, RM_CODEC_DICT_MAX);
+				if (err != RM_ERR_OK) {
+					return err;
+				}
+				c->dict_stale = 0;
+			}
+			if (c->compress == 0 && ZSTD_isError(ZSTD_DCtx_reset(c->zd, ZSTD_reset_session_only))) {	/* previous frame is decoded whole, but stream stage may not be back at frame start yet */
+				return RM_ERR_CODEC;
+			}
+			if (c->dict_n == 0) {
+				return RM_ERR_OK;
+			}
+			if (c->compress != 0) {
+				return (ZSTD_isError(ZSTD_CCtx_refPrefix(c->zc, c->dict, c->dict_n)) ? RM_ERR_CODEC : RM_ERR_OK);
+			}
+			return (ZSTD_isError(ZSTD_DCtx_refPrefix(c->zd, c->dict, c->dict_n)) ? RM_ERR_CODEC : RM_ERR_OK);
+#endif
+		default:
+			return RM_ERR_OK;
+	}
+}
+
+enum rm_error
+rm_codec_element_start(struct rm_codec *c) {
+	if (c->ref == 0) {
+#ifdef RM_ZSTD
+		if (c->type == RM_CODEC_ZSTD && ZSTD_isError(ZSTD_DCtx_reset(c->zd, ZSTD_reset_session_only))) {	/* each payload is a frame */
+			return RM_ERR_CODEC;
+		}
+#endif
+		return RM_ERR_OK;
+	}
+	return rm_codec_dict_set(c);
+}
+
+size_t
+rm_codec_bound(size_t src_n) {
+	return src_n + (src_n >> 4) + 1024;
+}
+
+/* @brief   Make room for at least @need more bytes after @used bytes of output. */
+static enum rm_error
+rm_codec_buf_reserve(struct rm_codec *c, size_t used, size_t need) {
+	unsigned char   *buf = NULL;
+	size_t          size = 0;
+
+	if (c->buf_size - used >= need) {
+		return RM_ERR_OK;
+	}
+	size = rm_max(c->buf_size * 2, used + need);
+	buf = realloc(c->buf, size);
+	if (buf == NULL) {
+		return RM_ERR_MEM;
+	}
+	c->buf = buf;
+	c->buf_size = size;
+	return RM_ERR_OK;
+}
+
+/* @brief   Append @n bytes to mirror of deflate window (last RM_CODEC_ZLIB_DICT_MAX bytes fed to compressor). */
+static void
+rm_codec_hist_add(struct rm_codec *c, const unsigned char *src, size_t n) {
+	if (n >= RM_CODEC_ZLIB_DICT_MAX) {
+		memcpy(c->hist, src + n - RM_CODEC_ZLIB_DICT_MAX, RM_CODEC_ZLIB_DICT_MAX);
+		c->hist_n = RM_CODEC_ZLIB_DICT_MAX;
+		return;
+	}
+	if (c->hist_n + n > 2 * RM_CODEC_ZLIB_DICT_MAX) {                      /* keep the window only, moved once per window of input */
+		memmove(c->hist, c->hist + c->hist_n - (RM_CODEC_ZLIB_DICT_MAX - n), RM_CODEC_ZLIB_DICT_MAX - n);
+		c->hist_n = RM_CODEC_ZLIB_DICT_MAX - n;
+	}
+	memcpy(c->hist + c->hist_n, src, n);
+	c->hist_n += n;
+}
+
+/* @brief   Take payload which has just been compressed (and dictionary set for it) out of deflate window,
+ *          payload is sent stored, so decompressor never sees any of it. */
+static enum rm_error
+rm_codec_zlib_rewind(struct rm_codec *c) {
+	size_t  n = rm_min(c->hist_n, RM_CODEC_ZLIB_DICT_MAX);
+
+	if (deflateReset(&c->zs) != Z_OK) {
+		return RM_ERR_CODEC;
+	}
+	if (n > 0 && deflateSetDictionary(&c->zs, c->hist + c->hist_n - n, n) != Z_OK) {	/* same window as decompressor has */
+		return RM_ERR_CODEC;
+	}
+	return RM_ERR_OK;
+}
+
+static enum rm_error
+rm_codec_zlib_compress(struct rm_codec *c, const unsigned char *src, size_t src_n, size_t *dst_n) {
+	size_t  out_n = 0;
+	int     ret = Z_OK;
+
+	c->zs.next_in = (Bytef*) src;
+	c->zs.avail_in = src_n;
+	do {
+		if (rm_codec_buf_reserve(c, out_n, deflateBound(&c->zs, c->zs.avail_in) + 16) != RM_ERR_OK) {
+			return RM_ERR_MEM;
+		}
+		c->zs.next_out = c->buf + out_n;
+		c->zs.avail_out = c->buf_size - out_n;
+		ret = deflate(&c->zs, Z_SYNC_FLUSH);                                /* flushed, so receiver can decode it now, history is kept */
+		if (ret != Z_OK && ret != Z_BUF_ERROR) {
+			return RM_ERR_CODEC;
+		}
+		out_n = c->buf_size - c->zs.avail_out;
+	} while (c->zs.avail_out == 0);
+	*dst_n = out_n;
+	return RM_ERR_OK;
+}
+
+#ifdef RM_ZSTD
+static enum rm_error
+rm_codec_zstd_compress(struct rm_codec *c, const unsigned char *src, size_t src_n, size_t *dst_n) {
+	ZSTD_inBuffer   in = { src, src_n, 0 };
+	ZSTD_outBuffer  out;
+	size_t          out_n = 0, left = 0;
+
+	do {
+		if (rm_codec_buf_reserve(c, out_n, in.size - in.pos + 1024) != RM_ERR_OK) {
+			return RM_ERR_MEM;
+		}
+		out.dst = c->buf + out_n;
+		out.size = c->buf_size - out_n;
+		out.pos = 0;
+		left = ZSTD_compressStream2(c->zc, &out, &in, ZSTD_e_end);         /* frame per payload, so payload sent stored instead leaves no trace, prefix is set per frame */
+		if (ZSTD_isError(left)) {
+			return RM_ERR_CODEC;
+		}
+		out_n += out.pos;
+	} while (left != 0);
+	*dst_n = out_n;
+	return RM_ERR_OK;
+}
+#endif
+
+enum rm_error
+rm_codec_compress(struct rm_codec *c, const unsigned char *src, size_t src_n, const unsigned char **dst, size_t *dst_n) {
+	enum rm_error   err = RM_ERR_OK;
+	size_t          z_n = 0;
+	uint8_t         dict_stale = 0;
+
+	*dst = NULL;
+	*dst_n = 0;
+	if (c->type == RM_CODEC_NONE || src_n < RM_CODEC_MIN_BYTES) {
+		return RM_ERR_OK;
+	}
+	if (c->skip_left > 0 && c->ref != 0 && c->dict_stale != 0) {           /* blocks matched since literals didn't compress, try against them */
+		c->skip_left = 0;
+	}
+	if (c->skip_left > 0) {                                                 /* backing off after incompressible data */
+		c->skip_left -= rm_min(c->skip_left, src_n);
+		return RM_ERR_OK;
+	}
+	dict_stale = c->dict_stale;
+	if (c->ref != 0) {
+		err = rm_codec_dict_set(c);
+		if (err != RM_ERR_OK) {
+			return err;
+		}
+	}
+	switch (c->type) {
+		case RM_CODEC_ZLIB:
+			err = rm_codec_zlib_compress(c, src, src_n, &z_n);
+			break;
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:
+			err = rm_codec_zstd_compress(c, src, src_n, &z_n);
+			break;
+#endif
+		default:
+			return RM_ERR_CODEC;
+	}
+	if (err != RM_ERR_OK) {
+		return err;
+	}
+	if (z_n + (src_n >> 4) >= src_n) {                                      /* saved less than 1/16, back off */
+		c->skip_left = c->skip_next;
+		c->skip_next = rm_min(c->skip_next * 2, RM_CODEC_SKIP_MAX);
+	} else {
+		c->skip_next = RM_CODEC_SKIP_MIN;
+	}
+	if (z_n >= src_n) {                                                     /* never send payload bigger than literals, send it stored */
+		c->dict_stale = dict_stale;                                         /* decompressor sets dictionary at next compressed payload, so must compressor */
+		if (c->type == RM_CODEC_ZLIB) {
+			return rm_codec_zlib_rewind(c);
+		}
+		return RM_ERR_OK;                                                   /* zstd frame is complete, nothing refers to it */
+	}
+	if (c->type == RM_CODEC_ZLIB) {                                         /* payload is sent compressed, decompressor's window has what compressor's has */
+		if (c->ref != 0 && dict_stale != 0) {
+			rm_codec_hist_add(c, c->dict, c->dict_n);
+		}
+		rm_codec_hist_add(c, src, src_n);
+	}
+	*dst = c->buf;
+	*dst_n = z_n;
+	return RM_ERR_OK;
+}
+
+enum rm_error
+rm_codec_decompress(struct rm_codec *c, const unsigned char *src, size_t src_n, size_t *src_used, unsigned char *dst, size_t dst_n, size_t *dst_used) {
+	int     ret = Z_OK;
+#ifdef RM_ZSTD
+	ZSTD_inBuffer   in = { src, src_n, 0 };
+	ZSTD_outBuffer  out = { dst, dst_n, 0 };
+	size_t          zret = 0;
+#endif
+
+	*src_used = 0;
+	*dst_used = 0;
+	switch (c->type) {
+		case RM_CODEC_ZLIB:
+			c->zs.next_in = (Bytef*) src;
+			c->zs.avail_in = src_n;
+			c->zs.next_out = dst;
+			c->zs.avail_out = dst_n;
+			ret = inflate(&c->zs, Z_SYNC_FLUSH);
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {                        /* stream is never finished by transmitter, so Z_STREAM_END is corruption too */
+				return RM_ERR_CODEC;
+			}
+			*src_used = src_n - c->zs.avail_in;
+			*dst_used = dst_n - c->zs.avail_out;
+			return RM_ERR_OK;
+#ifdef RM_ZSTD
+		case RM_CODEC_ZSTD:
+			zret = ZSTD_decompressStream(c->zd, &out, &in);
+			if (ZSTD_isError(zret)) {
+				return RM_ERR_CODEC;
+			}
+			*src_used = in.pos;
+			*dst_used = out.pos;
+			return RM_ERR_OK;
+#endif
+		default:
+			return RM_ERR_CODEC;
+	}
+}
@@ -18,10 +18,17 @@ enum rm_error rm_core_init(struct rsyncme *rm, struct rm_core_options *opt)
 	TWINIT_LIST_HEAD(&rm->sessions_list);
 	memcpy(&rm->opt, opt, sizeof(struct rm_core_options));
 	rm->state = RM_CORE_ST_INITIALIZED;
+	rm_metrics_init(&rm->metrics);
 
 	RM_LOG_INFO("%s", "Starting main work queue");
 
-	if (rm_wq_workqueue_init(&rm->wq, RM_WORKERS_N, "main_queue") != RM_ERR_OK) {   /* TODO CPU checking, choose optimal number of threads */
+	if (rm_wq_workqueue_init(&rm->wq, rm_wq_workers_n_default(), "main_queue") != RM_ERR_OK) {
+		return RM_ERR_WORKQUEUE_CREATE;
+	}
+
+	RM_LOG_INFO("%s", "Starting session executor");
+
+	if (rm_exec_init(&rm->exec, rm_exec_threads_n_default()) != RM_ERR_OK) {
 		return RM_ERR_WORKQUEUE_CREATE;
 	}
 	return RM_ERR_OK;
@@ -45,6 +52,13 @@ enum rm_error rm_core_deinit(struct rsyncme *rm)
 	if (rm_wq_workqueue_deinit(&rm->wq) != RM_ERR_OK) {
 		return RM_ERR_MEM;
 	}
+
+	RM_LOG_INFO("%s", "Stopping session executor");
+
+	if (rm_exec_stop(&rm->exec) != RM_ERR_OK) {
+		return RM_ERR_WORKQUEUE_STOP;
+	}
+	rm_metrics_deinit(&rm->metrics);
 	return RM_ERR_OK;
 }
 
@@ -83,16 +97,24 @@ void rm_core_session_add(struct rsyncme *rm, struct rm_session *s)
 	s->hashed_hash = twhash_min(key, TWHASH_BITS(rm->sessions));		/* save the hashed_hash */
 	rm->sessions_n++;
 	pthread_mutex_unlock(&rm->mutex);
+	rm_metrics_session_start(&rm->metrics);
 	return;
 }
 
 void rm_core_session_del(struct rsyncme *rm, struct rm_session *s)
 {
+	uint8_t	hashed = 0;
+
 	assert(s != NULL);
 	pthread_mutex_lock(&rm->mutex);
+	hashed = !twhlist_unhashed(&s->hlink);												/* failed requests are deleted even if never added */
 	twlist_del(&s->link);
 	twhash_del(&s->hlink);
+	if (hashed)
+		rm->sessions_n--;
 	pthread_mutex_unlock(&rm->mutex);
+	if (hashed)
+		rm_metrics_session_end(&rm->metrics, &s->rec_ctx);								/* session's threads/task are done, rec_ctx is final */
 }
 
 enum rm_error rm_core_authenticate(struct sockaddr_in *cli_addr)
@@ -135,7 +157,8 @@ enum rm_error rm_core_validate_hash(unsigned char *buf)
 enum rm_error rm_core_tcp_msg_valid_pt(unsigned char* buf)
 {
 	uint8_t pt = rm_get_msg_hdr_pt(buf);
-	if (pt == RM_PT_MSG_PUSH || pt == RM_PT_MSG_PUSH_ACK || pt == RM_PT_MSG_PULL || pt == RM_PT_MSG_PULL_ACK || pt == RM_PT_MSG_BYE) {
+	if (pt == RM_PT_MSG_PUSH || pt == RM_PT_MSG_PUSH_ACK || pt == RM_PT_MSG_PULL || pt == RM_PT_MSG_PULL_ACK || pt == RM_PT_MSG_BYE
+			|| pt == RM_PT_MSG_PUSH_TREE || pt == RM_PT_MSG_PUSH_FILE || pt == RM_PT_MSG_PUSH_TREE_ACK) {
 		return RM_ERR_OK;
 	}
 	return RM_ERR_FAIL;
@@ -193,6 +216,7 @@ enum rm_error rm_core_tcp_msg_assemble(int fd, enum rm_pt_type pt, void **body_r
 
 		case RM_PT_MSG_PUSH:
 		case RM_PT_MSG_PULL:
+		case RM_PT_MSG_PUSH_TREE:
 
 			*body_raw = malloc(bytes_n);
 			if (*body_raw == NULL) {
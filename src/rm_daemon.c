@@ -13,11 +13,16 @@
 #include "rm_util.h"
 #include "rm_wq.h"
 #include "rm_daemon.h"
+#include "rm_metrics.h"
 
 #include <getopt.h>
+#include <sys/epoll.h>
+#include <time.h>
 
 
 struct rsyncme  rm;
+static int                      rm_daemon_metrics_fd = -1;	/* listening Unix socket, its address marks it in epoll set */
+static struct rm_metrics_buf    rm_daemon_metrics_buf;		/* reused by each metrics request */
 
 static void rm_daemon_sigint_handler(int signo) {
 	if (signo != SIGINT)
@@ -44,6 +49,9 @@ static void rm_daemon_sighup_handler(int signo) {
 }
 
 static void rm_daemon_signal_handler(int signo) {
+	struct rm_worker_stats  ws;
+	uint32_t                i;
+
 	switch (signo) {
 		case SIGINT:
 			fprintf(stderr, "\n\n==Received SIGINT==\n\nState:\n");
@@ -52,6 +60,14 @@ static void rm_daemon_signal_handler(int signo) {
 			fprintf(stderr, "sessions_n                            \t[%u]\n", rm.sessions_n);
 			fprintf(stderr, "workers_n                             \t[%u]\n", rm.wq.workers_n);
 			fprintf(stderr, "workers_active_n                      \t[%u]\n", rm.wq.workers_active_n);
+			for (i = 0; i < rm.wq.workers_n; ++i) {
+				rm_wq_worker_stats(&rm.wq.workers[i], &ws);
+				fprintf(stderr, "worker [%4u] queue_n [%u] busy [%u] done_n [%" PRIu64 "] steals_n [%" PRIu64 "]\n", i, ws.queue_n, ws.busy, ws.done_n, ws.steals_n);
+			}
+			fprintf(stderr, "exec_threads_n                        \t[%u]\n", rm.exec.threads_n);
+			for (i = 0; i < rm.exec.threads_n; ++i) {
+				fprintf(stderr, "exec thread [%4u] tasks_n [%u] steps_n [%" PRIu64 "]\n", i, rm.exec.threads[i].tasks_n, rm.exec.threads[i].steps_n);
+			}
 			pthread_mutex_unlock(&rm.mutex);
 
 			fprintf(stderr, "\n\n");
@@ -95,21 +111,71 @@ static void rm_daemon_signal_handler(int signo) {
 	return;
 }
 
+enum rm_daemon_conn_state {
+	RM_DAEMON_CONN_HDR,									/* receiving message header */
+	RM_DAEMON_CONN_BODY,								/* header validated, receiving message body */
+	RM_DAEMON_CONN_METRICS								/* local metrics client, receiving request line */
+};
+
+struct rm_daemon_conn {									/* accepted connection that hasn't delivered complete message yet */
+	int                         fd;
+	enum rm_daemon_conn_state   state;
+	unsigned char               hdr_raw[RM_MSG_HDR_LEN];
+	struct rm_msg_hdr           *hdr;
+	unsigned char               *body_raw;
+	size_t                      to_read;				/* bytes of current part (header or body) */
+	size_t                      read_n;					/* bytes of current part received so far */
+	char                        req[RM_METRICS_REQ_LEN_MAX];	/* metrics request line */
+	struct timespec             deadline;				/* complete message must arrive before this */
+	char                        peer_addr_buf[INET6_ADDRSTRLEN];
+	const char                  *peer_addr_str;
+	uint16_t                    peer_port;
+	struct twlist_head          link;					/* in accept order, so in deadline order too */
+};
+
 static void
-do_it_all(int fd, struct rsyncme* rm) {
-	int                     to_read;
-	unsigned char           *buf = NULL, *body_raw = NULL;
-	struct rm_msg_hdr       *hdr = NULL;
-	struct rm_msg           *msg = NULL;
-	int                     err;
-	char                    peer_addr_buf[INET6_ADDRSTRLEN];
-	const char              *peer_addr_str = NULL;
-	struct sockaddr_storage peer_addr;
-	struct sockaddr_in      *peer_addr_in = NULL;
-	struct sockaddr_in6     *peer_addr_in6 = NULL;
-	socklen_t               peer_len;
-	uint16_t                peer_port;
+rm_daemon_conn_free(struct rm_daemon_conn *c) {
+	if (c->hdr != NULL) {
+		free(c->hdr);
+	}
+	if (c->body_raw != NULL) {
+		free(c->body_raw);
+	}
+	free(c);
+}
+
+/* @brief   Reject connection: send general ACK with error and close socket.
+ * @details Connection is removed from epoll set by close (it is the only reference to the socket). */
+static void
+rm_daemon_conn_reject(struct rm_daemon_conn *c, enum rm_error err) {
+	rm_metrics_error(&rm.metrics, err);
+	twlist_del(&c->link);
+	rm_tcp_tx_msg_ack(c->fd, RM_PT_MSG_ACK, err, NULL); /* send general ACK with error */
+	RM_LOG_INFO("core: TXed ACK with error [%u] to peer [%s] port [%u]", err, c->peer_addr_str, c->peer_port);
+	close(c->fd);
+	RM_LOG_INFO("core: Closed connection with peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+	rm_daemon_conn_free(c);
+}
+
+/* @brief   Close connection quietly (peer went away). */
+static void
+rm_daemon_conn_close(struct rm_daemon_conn *c) {
+	twlist_del(&c->link);
+	close(c->fd);
+	if (c->peer_addr_str != NULL) {
+		RM_LOG_INFO("core: Closing connection in passive mode, peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+	} else {
+		RM_LOG_INFO("core: Closing connection in passive mode, peer port [%u]", c->peer_port);
+	}
+	rm_daemon_conn_free(c);
+}
 
+/* @brief   Log both ends of accepted connection and authenticate peer.
+ * @details Returns new connection awaiting message header or NULL if connection
+ *          has been rejected (and closed). */
+static struct rm_daemon_conn*
+rm_daemon_conn_open(int fd, struct rsyncme* rm) {
+	struct rm_daemon_conn   *c = NULL;
 	char                    cli_addr_buf[INET6_ADDRSTRLEN];
 	const char              *cli_addr_str = NULL;
 	struct sockaddr_storage cli_addr;
@@ -117,8 +183,23 @@ do_it_all(int fd, struct rsyncme* rm) {
 	struct sockaddr_in6     *cli_addr_in6 = NULL;
 	socklen_t               cli_len;
 	uint16_t                cli_port;
-	enum rm_pt_type         pt;
-	void                    *work = NULL;
+	struct sockaddr_storage peer_addr;
+	struct sockaddr_in      *peer_addr_in = NULL;
+	struct sockaddr_in6     *peer_addr_in6 = NULL;
+	socklen_t               peer_len;
+
+	c = calloc(1, sizeof(*c));
+	if (c == NULL) {
+		RM_LOG_CRIT("%s", "core: Couldn't allocate connection. Not enough memory");
+		close(fd);
+		return NULL;
+	}
+	c->fd = fd;
+	c->state = RM_DAEMON_CONN_HDR;
+	c->to_read = RM_MSG_HDR_LEN;
+	TWINIT_LIST_HEAD(&c->link);
+	clock_gettime(CLOCK_MONOTONIC, &c->deadline);
+	c->deadline.tv_sec += RM_SERVER_MSG_TIMEOUT_S;
 
 	cli_len = sizeof(cli_addr);
 	getsockname(fd, (struct sockaddr*)&cli_addr, &cli_len); /* get our side of TCP connection */
@@ -138,151 +219,381 @@ do_it_all(int fd, struct rsyncme* rm) {
 	getpeername(fd, (struct sockaddr*)&peer_addr, &peer_len);   /* get their's side of TCP connection */
 	if (peer_addr.ss_family == AF_INET) {
 		peer_addr_in = (struct sockaddr_in*)&peer_addr;
-		peer_addr_str = inet_ntop(AF_INET, &peer_addr_in->sin_addr, peer_addr_buf, peer_len);
-		peer_port = ntohs(peer_addr_in->sin_port);
+		c->peer_addr_str = inet_ntop(AF_INET, &peer_addr_in->sin_addr, c->peer_addr_buf, sizeof c->peer_addr_buf);
+		c->peer_port = ntohs(peer_addr_in->sin_port);
 	} else { /* AF_INET6 */
-		peer_addr_in6 = (struct sockaddr_in6*)&cli_addr;
-		peer_addr_str = inet_ntop(AF_INET6, &peer_addr_in6->sin6_addr, peer_addr_buf, sizeof peer_addr_buf);
-		peer_port = ntohs(peer_addr_in6->sin6_port);
+		peer_addr_in6 = (struct sockaddr_in6*)&peer_addr;
+		c->peer_addr_str = inet_ntop(AF_INET6, &peer_addr_in6->sin6_addr, c->peer_addr_buf, sizeof c->peer_addr_buf);
+		c->peer_port = ntohs(peer_addr_in6->sin6_port);
 	}
-	if (peer_addr_str == NULL) {
+	if (c->peer_addr_str == NULL) {
 		RM_LOG_ERR("core: Can't convert binary peer's address to presentation format, [%s]", strerror(errno));
 	}
-	if (peer_addr_str == NULL) {
+	if (c->peer_addr_str == NULL) {
 		if (cli_addr_str == NULL) {
-			RM_LOG_INFO("core: Incoming connection, port [%u], handled on local port [%u]", peer_port, cli_port);
+			RM_LOG_INFO("core: Incoming connection, port [%u], handled on local port [%u]", c->peer_port, cli_port);
 		} else {
-			RM_LOG_INFO("Incoming connection, port [%u], handled on local interface [%s] port [%u]", peer_port, cli_addr_str, cli_port);
+			RM_LOG_INFO("Incoming connection, port [%u], handled on local interface [%s] port [%u]", c->peer_port, cli_addr_str, cli_port);
 		}
 	} else {
 		if (cli_addr_str == NULL) {
-			RM_LOG_INFO("core: Incoming connection, peer [%s] port [%u], handled on local port [%u]", peer_addr_str, peer_port, cli_port);
+			RM_LOG_INFO("core: Incoming connection, peer [%s] port [%u], handled on local port [%u]", c->peer_addr_str, c->peer_port, cli_port);
 		} else {
-			RM_LOG_INFO("core: Incoming connection, peer [%s] port [%u], handled on local interface [%s] port [%u]", peer_addr_str, peer_port, cli_addr_str, cli_port);
+			RM_LOG_INFO("core: Incoming connection, peer [%s] port [%u], handled on local interface [%s] port [%u]", c->peer_addr_str, c->peer_port, cli_addr_str, cli_port);
 		}
 	}
 
 	if (rm->opt.authenticate) {
 		if (rm_core_authenticate(peer_addr_in) != RM_ERR_OK) {
-			RM_LOG_ALERT("core: Authentication failed. Receiver doesn't accept requests from [%s]. Please skip --auth flag when starting the receiver to disable authentication\n", peer_addr_str);
-			err = RM_ERR_AUTH;
-			goto err_exit;
+			RM_LOG_ALERT("core: Authentication failed. Receiver doesn't accept requests from [%s]. Please skip --auth flag when starting the receiver to disable authentication\n", c->peer_addr_str);
+			rm_daemon_conn_reject(c, RM_ERR_AUTH);
+			return NULL;
 		}
 	}
+	return c;
+}
 
-	hdr = malloc(sizeof(struct rm_msg_hdr));
-	if (hdr == NULL) {
-		RM_LOG_CRIT("%s", "core: Couldn't allocate message header. Not enough memory");
-		goto err_exit;
-	}
-	to_read = RM_MSG_HDR_LEN;
-	buf = malloc(to_read);																						/* buffer for incoming message header */
-	if (buf == NULL) {
-		RM_LOG_CRIT("%s", "core: Couldn't allocate buffer for the message header. Not enough memory");
-		goto err_exit;
-	}
-
-	RM_LOG_INFO("core: Waiting for incoming header from peer [%s] port [%u], on local interface [%s] port [%u]", peer_addr_str, peer_port, cli_addr_str, cli_port);
-	err = rm_tcp_read(fd, buf, to_read);																		/* wait for incoming header */
-	if (err == RM_ERR_EOF) {
-		if (peer_addr_str != NULL) {
-			RM_LOG_INFO("core: Closing connection in passive mode, peer [%s] port [%u]", peer_addr_str, peer_port);
-		} else {
-			RM_LOG_INFO("core: Closing connection in passive mode, peer port [%u]", peer_port);
+/* @brief   Read whatever is available on nonblocking socket into current part of the message.
+ * @details Never reads past the end of the message, so data that peer sends after it
+ *          stays in the socket for the worker.
+ * @return  RM_ERR_OK when message is complete,
+ *          RM_ERR_AGAIN if socket has been drained and more data is needed,
+ *          RM_ERR_EOF if peer closed connection,
+ *          RM_ERR_READ on read error,
+ *          RM_ERR_FAIL or RM_ERR_MSG_PT_UNKNOWN if header is invalid,
+ *          RM_ERR_MEM if body couldn't be allocated */
+static enum rm_error
+rm_daemon_conn_rx(struct rm_daemon_conn *c) {
+	ssize_t         read_n;
+	unsigned char   *dst;
+	enum rm_error   err;
+
+	while (1) {
+		dst = (c->state == RM_DAEMON_CONN_HDR ? c->hdr_raw : c->body_raw);
+		while (c->read_n < c->to_read) {
+			read_n = read(c->fd, dst + c->read_n, c->to_read - c->read_n);
+			if (read_n == 0) {
+				return RM_ERR_EOF;
+			}
+			if (read_n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					return RM_ERR_AGAIN;
+				}
+				return RM_ERR_READ;
+			}
+			c->read_n += read_n;
+		}
+		if (c->state == RM_DAEMON_CONN_BODY) {
+			return RM_ERR_OK;
 		}
-		goto err_exit;
-	}
-	if (err == RM_ERR_READ) {
-		RM_LOG_PERR("%s", "core: Read failed on TCP control socket");
-		goto err_exit;
-	}
-
-	RM_LOG_INFO("core: Validating header from peer [%s] port [%u]", peer_addr_str, peer_port);
-	err = rm_core_tcp_msg_hdr_validate(buf, to_read);															/* validate the potential header of the message: check hash and pt, read_n can't be < 0 in call to validate */
-	if (err != RM_ERR_OK) {
-		RM_LOG_ERR("%s", "core: TCP control socket: bad message");
-		switch (err) {
-
-			case RM_ERR_FAIL:
-				RM_LOG_ERR("%s", "core: Message corrupted: invalid hash or message too short");
-				break;
-
-			case RM_ERR_MSG_PT_UNKNOWN:
-				RM_LOG_ERR("%s", "core: Unknown message type");
-				break;
 
-			default:
-				RM_LOG_ERR("%s", "core: Unknown error");
-				break;
+		RM_LOG_INFO("core: Validating header from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+		err = rm_core_tcp_msg_hdr_validate(c->hdr_raw, RM_MSG_HDR_LEN);				/* validate the potential header of the message: check hash and pt */
+		if (err != RM_ERR_OK) {
+			return err;
+		}
+		c->hdr = malloc(sizeof(struct rm_msg_hdr));
+		if (c->hdr == NULL) {
+			return RM_ERR_MEM;
+		}
+		rm_deserialize_msg_hdr(c->hdr_raw, c->hdr);										/* buffer is indeed the header of our message */
+		if (c->hdr->len < RM_MSG_HDR_LEN) {
+			return RM_ERR_FAIL;
+		}
+		c->state = RM_DAEMON_CONN_BODY;
+		c->to_read = c->hdr->len - RM_MSG_HDR_LEN;
+		c->read_n = 0;
+		if (c->to_read == 0) {
+			return RM_ERR_OK;
+		}
+		c->body_raw = malloc(c->to_read);
+		if (c->body_raw == NULL) {
+			return RM_ERR_MEM;
 		}
-		goto err_exit;
 	}
+}
 
-	rm_deserialize_msg_hdr(buf, hdr);																			/* buffer is indeed the header of our message */
-	free(buf);
-	buf = NULL;
-
-	pt = hdr->pt;
-	to_read = hdr->len - RM_MSG_HDR_LEN;
-
-	err = rm_core_tcp_msg_assemble(fd, pt, (void*)&body_raw, to_read);
-	if (err != RM_ERR_OK) { /* TODO handle properly */
-		goto err_exit;
-	}
-	msg = rm_deserialize_msg(pt, hdr, body_raw);
+/* @brief   Hand complete message over to the workqueue.
+ * @details Socket is removed from epoll set and switched back to blocking mode, as workers use blocking I/O.
+ *          Worker takes the ownership of TCP socket and memory allocated for msg (including hdr). */
+static void
+rm_daemon_conn_dispatch(struct rm_daemon_conn *c, int epfd, struct rsyncme* rm) {
+	struct rm_msg   *msg = NULL;
+	void            *work = NULL;
+	enum rm_pt_type pt;
+	int             flags;
+
+	pt = c->hdr->pt;
+	msg = rm_deserialize_msg(pt, c->hdr, c->body_raw);
 	if (msg == NULL) {
 		RM_LOG_CRIT("%s", "core: Error deserializing message. Not enough memory");
-		goto err_exit;
+		rm_daemon_conn_reject(c, RM_ERR_MEM);
+		return;
+	}
+	if (epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL) != 0) {
+		RM_LOG_PERR("%s", "core: Couldn't remove connection from epoll set");
+		free(msg);
+		rm_daemon_conn_reject(c, RM_ERR_TCP);
+		return;
+	}
+	flags = fcntl(c->fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(c->fd, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+		RM_LOG_PERR("%s", "core: Couldn't switch connection to blocking mode");
+		free(msg);
+		rm_daemon_conn_reject(c, RM_ERR_TCP);
+		return;
 	}
 
 	switch (pt) {																								/* message OK, process it */
 		case RM_PT_MSG_PUSH:
-			RM_LOG_INFO("core: Enqueuing MSG_PUSH work from peer [%s] port [%u]", peer_addr_str, peer_port);
-			work = rm_work_create(RM_WORK_PROCESS_MSG_PUSH, rm, msg, fd, rm_do_msg_push_rx, rm_msg_push_dtor); /* worker takes the ownership of TCP socket and memory allocated for msg (including hdr) */
-			if (work == NULL) {
-				RM_LOG_CRIT("%s", "core: Couldn't allocate work. Not enough memory");
-				goto err_exit;
-			}
-			rm_wq_queue_work(&rm->wq, work); 
+			RM_LOG_INFO("core: Enqueuing MSG_PUSH work from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+			work = rm_work_create(RM_WORK_PROCESS_MSG_PUSH, rm, msg, c->fd, rm_do_msg_push_rx, rm_msg_push_dtor);
 			break;
 
-		case RM_PT_MSG_PULL:
-			RM_LOG_INFO("core: Enqueuing MSG_PULL work from peer [%s] port [%u]", peer_addr_str, peer_port);
+		case RM_PT_MSG_PUSH_TREE:
+			RM_LOG_INFO("core: Enqueuing MSG_PUSH_TREE work from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+			work = rm_work_create(RM_WORK_PROCESS_MSG_PUSH_TREE, rm, msg, c->fd, rm_do_msg_push_tree_rx, rm_msg_push_tree_dtor);
 			break;
 
+		case RM_PT_MSG_PULL:
+			RM_LOG_INFO("core: Enqueuing MSG_PULL work from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+			goto done;
+
 		case RM_PT_MSG_BYE:
-			RM_LOG_INFO("core: Enqueuing MSG_BYE work from peer [%s] port [%u]", peer_addr_str, peer_port);
-			break;
+			RM_LOG_INFO("core: Enqueuing MSG_BYE work from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+			goto done;
 
 		default:
 			RM_LOG_ERR("%s", "core: Unknown TCP message type, this can't happen");
-			goto err_exit;
+			free(msg);
+			rm_daemon_conn_reject(c, RM_ERR_MSG_PT_UNKNOWN);
+			return;
 	}
+	if (work == NULL) {
+		RM_LOG_CRIT("%s", "core: Couldn't allocate work. Not enough memory");
+		free(msg);
+		rm_daemon_conn_reject(c, RM_ERR_MEM);
+		return;
+	}
+	rm_wq_queue_work(&rm->wq, work);
 
-	if (body_raw != NULL) {
-		free(body_raw);
-		body_raw = NULL;
+done:
+	c->hdr = NULL;																	/* now owned by msg */
+	twlist_del(&c->link);
+	rm_daemon_conn_free(c);
+}
+
+/* @brief   Close metrics client's connection (no logging, they come every second). */
+static void
+rm_daemon_metrics_close(struct rm_daemon_conn *c) {
+	twlist_del(&c->link);
+	close(c->fd);
+	rm_daemon_conn_free(c);
+}
+
+/* @brief   Read request line of metrics client ("json" or "text", also empty or just EOF for text)
+ *          and reply with metrics rendered in requested format.
+ * @details Reply is sent without waiting for the client: if it doesn't fit into socket's buffer
+ *          it is cut short, so slow client can't stall daemon's loop. Connection is closed after reply. */
+static void
+rm_daemon_metrics_on_readable(struct rm_daemon_conn *c, struct rsyncme* rm) {
+	ssize_t                 read_n;
+	enum rm_metrics_format  fmt;
+	char                    *eol;
+
+	while (c->read_n < c->to_read && memchr(c->req, '\n', c->read_n) == NULL) {
+		read_n = read(c->fd, c->req + c->read_n, c->to_read - c->read_n);
+		if (read_n == 0) {
+			break;																	/* EOF ends request too */
+		}
+		if (read_n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return;
+			}
+			rm_daemon_metrics_close(c);
+			return;
+		}
+		c->read_n += read_n;
 	}
-	return;
+	c->req[c->read_n] = '\0';
+	eol = c->req + strcspn(c->req, "\r\n");
+	*eol = '\0';
+	fmt = (strcmp(c->req, "json") == 0 ? RM_METRICS_FORMAT_JSON : RM_METRICS_FORMAT_TEXT);
+
+	rm_daemon_metrics_buf.len = 0;
+	rm_daemon_metrics_buf.oom = 0;
+	if (rm_metrics_render(rm, fmt, &rm_daemon_metrics_buf) != RM_ERR_OK) {
+		RM_LOG_CRIT("%s", "core: Couldn't render metrics. Not enough memory");
+	}
+	read_n = send(c->fd, rm_daemon_metrics_buf.data, rm_daemon_metrics_buf.len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (read_n >= 0 && (size_t) read_n < rm_daemon_metrics_buf.len) {
+		RM_LOG_WARN("core: Metrics client doesn't take whole reply at once, sent [%zd] of [%zu] bytes", read_n, rm_daemon_metrics_buf.len);
+	}
+	rm_daemon_metrics_close(c);
+}
+
+/* @brief   Receive on connection that became readable. */
+static void
+rm_daemon_conn_on_readable(struct rm_daemon_conn *c, int epfd, struct rsyncme* rm) {
+	enum rm_error err;
 
-err_exit:
-	if (hdr != NULL) {
-		free(hdr);
-		hdr = NULL;
+	if (c->state == RM_DAEMON_CONN_METRICS) {
+		rm_daemon_metrics_on_readable(c, rm);
+		return;
 	}
-	if (body_raw != NULL) {
-		free(body_raw);
-		body_raw = NULL;
+	err = rm_daemon_conn_rx(c);
+	switch (err) {
+		case RM_ERR_OK:
+			rm_daemon_conn_dispatch(c, epfd, rm);
+			break;
+		case RM_ERR_AGAIN:
+			break;
+		case RM_ERR_EOF:
+			rm_daemon_conn_close(c);
+			break;
+		case RM_ERR_READ:
+			RM_LOG_PERR("%s", "core: Read failed on TCP control socket");
+			rm_daemon_conn_close(c);
+			break;
+		case RM_ERR_MEM:
+			RM_LOG_CRIT("%s", "core: Couldn't allocate message. Not enough memory");
+			rm_daemon_conn_reject(c, err);
+			break;
+		case RM_ERR_FAIL:
+			RM_LOG_ERR("%s", "core: TCP control socket: bad message");
+			RM_LOG_ERR("%s", "core: Message corrupted: invalid hash or message too short");
+			rm_daemon_conn_reject(c, err);
+			break;
+		case RM_ERR_MSG_PT_UNKNOWN:
+			RM_LOG_ERR("%s", "core: TCP control socket: bad message");
+			RM_LOG_ERR("%s", "core: Unknown message type");
+			rm_daemon_conn_reject(c, err);
+			break;
+		default:
+			RM_LOG_ERR("%s", "core: Unknown error");
+			rm_daemon_conn_reject(c, err);
+			break;
 	}
-	if (msg != NULL) {
-		free(msg);
-		msg = NULL;
+}
+
+/* @brief   Accept all pending connections (listening socket is edge-triggered). */
+static void
+rm_daemon_accept(int listenfd, int epfd, struct twlist_head *conns, struct rsyncme* rm) {
+	int                     connfd, flags;
+	struct sockaddr_storage cli_addr;
+	socklen_t               cli_len;
+	struct rm_daemon_conn   *c = NULL;
+	struct epoll_event      ev;
+
+	while (1) {
+		cli_len = sizeof(cli_addr);
+		connfd = accept(listenfd, (struct sockaddr *) &cli_addr, &cli_len);
+		if (connfd < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				RM_LOG_PERR("%s", "core: Accept error");
+			}
+			return;
+		}
+		flags = fcntl(connfd, F_GETFL, 0);
+		if (flags < 0 || fcntl(connfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+			RM_LOG_PERR("%s", "core: Couldn't switch connection to nonblocking mode");
+			close(connfd);
+			continue;
+		}
+		c = rm_daemon_conn_open(connfd, rm);
+		if (c == NULL) {
+			continue;
+		}
+		twlist_add_tail(&c->link, conns);
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = c;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+			RM_LOG_PERR("%s", "core: Couldn't add connection to epoll set");
+			rm_daemon_conn_reject(c, RM_ERR_TCP);
+			continue;
+		}
+		RM_LOG_INFO("core: Waiting for incoming header from peer [%s] port [%u]", c->peer_addr_str, c->peer_port);
+		rm_daemon_conn_on_readable(c, epfd, rm);											/* header may be here already, edge was before registration */
 	}
+}
 
-	rm_tcp_tx_msg_ack(fd, RM_PT_MSG_ACK, err, NULL); /* send general ACK with error */
-	RM_LOG_INFO("core: TXed ACK with error [%u] to peer [%s] port [%u]", err, peer_addr_str, peer_port);
-	close(fd);
-	RM_LOG_INFO("core: Closed connection with peer [%s] port [%u]", peer_addr_str, peer_port);
+/* @brief   Accept all pending metrics clients (listening socket is edge-triggered). */
+static void
+rm_daemon_metrics_accept(int listenfd, int epfd, struct twlist_head *conns, struct rsyncme* rm) {
+	int                     connfd, flags;
+	struct rm_daemon_conn   *c = NULL;
+	struct epoll_event      ev;
+
+	while (1) {
+		connfd = accept(listenfd, NULL, NULL);
+		if (connfd < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				RM_LOG_PERR("%s", "core: Accept error on metrics socket");
+			}
+			return;
+		}
+		flags = fcntl(connfd, F_GETFL, 0);
+		if (flags < 0 || fcntl(connfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+			close(connfd);
+			continue;
+		}
+		c = calloc(1, sizeof(*c));
+		if (c == NULL) {
+			RM_LOG_CRIT("%s", "core: Couldn't allocate metrics connection. Not enough memory");
+			close(connfd);
+			continue;
+		}
+		c->fd = connfd;
+		c->state = RM_DAEMON_CONN_METRICS;
+		c->to_read = RM_METRICS_REQ_LEN_MAX - 1;
+		clock_gettime(CLOCK_MONOTONIC, &c->deadline);
+		c->deadline.tv_sec += RM_SERVER_MSG_TIMEOUT_S;
+		twlist_add_tail(&c->link, conns);
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = c;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &ev) != 0) {
+			RM_LOG_PERR("%s", "core: Couldn't add metrics connection to epoll set");
+			rm_daemon_metrics_close(c);
+			continue;
+		}
+		rm_daemon_metrics_on_readable(c, rm);										/* request may be here already */
+	}
+}
+
+/* @brief   Drop connections which haven't delivered complete message in time. */
+static void
+rm_daemon_conn_expire(struct twlist_head *conns) {
+	struct twlist_head      *pos, *n;
+	struct rm_daemon_conn   *c;
+	struct timespec         now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	twlist_for_each_safe(pos, n, conns) {
+		c = twlist_entry(pos, struct rm_daemon_conn, link);
+		if (c->deadline.tv_sec > now.tv_sec || (c->deadline.tv_sec == now.tv_sec && c->deadline.tv_nsec > now.tv_nsec)) {
+			break;																	/* list is in deadline order */
+		}
+		if (c->state == RM_DAEMON_CONN_METRICS) {
+			rm_daemon_metrics_close(c);
+			continue;
+		}
+		RM_LOG_WARN("core: Peer [%s] port [%u] didn't send complete message within [%u]s", c->peer_addr_str, c->peer_port, RM_SERVER_MSG_TIMEOUT_S);
+		rm_daemon_conn_reject(c, RM_ERR_TIMEOUT);
+	}
 }
 
 static void rsyncme_d_usage(const char *name)
@@ -294,6 +605,10 @@ static void rsyncme_d_usage(const char *name)
 	fprintf(stderr, "     \t -l           : logging level [0-3]\n"
 			"     \t                0 - no logging, 1 - normal, 2 - +threads, 3 - verbose\n");
 	fprintf(stderr, "     \t --auth       : authenticate requests\n");
+	fprintf(stderr, "     \t --metrics    : path of Unix socket on which metrics are served, default [%s]\n"
+			"     \t                send \"json\" or \"text\" line to get daemon's counters and active sessions\n", RM_METRICS_SOCKET_PATH);
+	fprintf(stderr, "     \t --no_metrics : don't serve metrics\n");
+	fprintf(stderr, "     \t --direct     : write received files with O_DIRECT, bypassing page cache\n");
 	fprintf(stderr, "     \t --help       : display this help and exit\n");
 	fprintf(stderr, "     \t --version    : output version information and exit\n");
 	fprintf(stderr, "     \t --verbose    : max logging\n");
@@ -305,6 +620,8 @@ static void rsyncme_d_usage(const char *name)
 	fprintf(stderr, "	rsyncme_d -l 2\n"
 			"\t\tThis will start daemon with logging including information\n"
 			"\t\tfrom worker threads\n");
+	fprintf(stderr, "	echo json | nc -U %s\n"
+			"\t\tThis will print metrics of running daemon as JSON\n", RM_METRICS_SOCKET_PATH);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "For more information please consult documentation.\n");
 	fprintf(stderr, "\n");
@@ -327,18 +644,21 @@ int main(int argc, char *argv[]) {
 	char                c = 0;
 	char                *pCh = NULL;
 	unsigned long long  helper = 0;
-	int                     listenfd = -1, connfd = -1;
+	int                     listenfd = -1, epfd = -1, flags = 0;
 	int                     err = -1, errsv = -1;
+	int                     events_n = 0, i = 0;
+	struct epoll_event      ev, events[RM_SERVER_EPOLL_EVENTS];
+	struct twlist_head      conns;															/* accepted connections which haven't delivered complete message yet */
 	struct sockaddr_in      srv_addr_in = {0};;
-	struct sockaddr_storage cli_addr = {0};;
-	socklen_t               cli_len = 0;
 	struct sigaction        sa;
 	enum rm_error           status = RM_ERR_OK;
 	char ip[INET_ADDRSTRLEN];
 	const char *ipptr = NULL;
 	struct rm_core_options	opt = {0};
+	const char              *metrics_path = RM_METRICS_SOCKET_PATH;
 
 	memset(&sa, 0, sizeof(struct sigaction));
+	TWINIT_LIST_HEAD(&conns);
 
 	int option_index = 0;
 	struct option long_options[] = {
@@ -347,6 +667,9 @@ int main(int argc, char *argv[]) {
 		{ "help", no_argument, 0, 3 },
 		{ "version", no_argument, 0, 4 },
 		{ "verbose", no_argument, 0, 5 },
+		{ "metrics", required_argument, 0, 6 },
+		{ "no_metrics", no_argument, 0, 7 },
+		{ "direct", no_argument, 0, 8 },
 		{ 0 }
 	};
 
@@ -384,6 +707,18 @@ int main(int argc, char *argv[]) {
 				opt.loglevel = RM_LOGLEVEL_VERBOSE;										/* --verbose */
 				break;
 
+			case 6:
+				metrics_path = optarg;													/* --metrics */
+				break;
+
+			case 7:
+				metrics_path = NULL;													/* --no_metrics */
+				break;
+
+			case 8:
+				opt.z_direct = 1;														/* --direct */
+				break;
+
 			case 'l':
 				helper = strtoul(optarg, &pCh, 10);
 				if (helper > RM_LOGLEVEL_VERBOSE) {
@@ -461,8 +796,8 @@ int main(int argc, char *argv[]) {
 		}
 		exit(EXIT_FAILURE);
 	}
-	if (rm.wq.workers_active_n != RM_WORKERS_N) {   /* TODO CPU checking, choose optimal number of threads */
-		RM_LOG_WARN("core: Couldn't start all workers for main work queue, [%u] requested but only [%u] started", RM_WORKERS_N, rm.wq.workers_n);
+	if (rm.wq.workers_active_n != rm.wq.workers_n) {
+		RM_LOG_WARN("core: Couldn't start all workers for main work queue, [%u] requested but only [%u] started", rm.wq.workers_n, rm.wq.workers_active_n);
 	} else {
 		RM_LOG_INFO("core: Main work queue started with [%u] worker threads", rm.wq.workers_n);
 	}
@@ -496,6 +831,42 @@ int main(int argc, char *argv[]) {
 	}
 	RM_LOG_INFO("core: Listening on address [%s], port [%u]", ipptr, ntohs(srv_addr_in.sin_port));
 
+	flags = fcntl(listenfd, F_GETFL, 0);
+	if (flags < 0 || fcntl(listenfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		RM_LOG_PERR("%s", "core: Couldn't switch server's managing socket to nonblocking mode");
+		exit(EXIT_FAILURE);
+	}
+	epfd = epoll_create1(0);
+	if (epfd < 0) {
+		RM_LOG_PERR("%s", "core: Couldn't create epoll instance");
+		exit(EXIT_FAILURE);
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = NULL;																/* NULL marks server's managing socket, connections carry their state */
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &ev) != 0) {
+		RM_LOG_PERR("%s", "core: Couldn't add server's managing socket to epoll set");
+		exit(EXIT_FAILURE);
+	}
+	if (metrics_path != NULL) {
+		status = rm_metrics_listen(metrics_path, &rm_daemon_metrics_fd);
+		if (status != RM_ERR_OK) {
+			RM_LOG_PERR("core: Couldn't listen on metrics socket [%s], metrics won't be served", metrics_path);
+		} else {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLET;
+			ev.data.ptr = &rm_daemon_metrics_fd;
+			if (epoll_ctl(epfd, EPOLL_CTL_ADD, rm_daemon_metrics_fd, &ev) != 0) {
+				RM_LOG_PERR("%s", "core: Couldn't add metrics socket to epoll set, metrics won't be served");
+				close(rm_daemon_metrics_fd);
+				rm_daemon_metrics_fd = -1;
+				unlink(metrics_path);
+			} else {
+				RM_LOG_INFO("core: Serving metrics on [%s]", metrics_path);
+			}
+		}
+	}
+
 	sa.sa_handler = rm_daemon_sigint_handler;
 	sa.sa_flags = 0;
 	sigemptyset(&sa.sa_mask);
@@ -515,26 +886,41 @@ int main(int argc, char *argv[]) {
 		RM_LOG_PERR("%s", "core: Couldn't set signal handler for SIGHUP");
 
 	while(rm.state != RM_CORE_ST_SHUT_DOWN) {
-		cli_len = sizeof(cli_addr);
-		if ((connfd = accept(listenfd, (struct sockaddr *) &cli_addr, &cli_len)) < 0) {
+		events_n = epoll_wait(epfd, events, RM_SERVER_EPOLL_EVENTS, 1000);	/* wake up at least once a second to expire stalled connections */
+		if (events_n < 0) {
 			errsv = errno;
 			if (errsv == EINTR) {
-				RM_LOG_PERR("%s", "core: Accept interrupted");
+				RM_LOG_PERR("%s", "core: Wait interrupted");
 
 				if (rm.signal_pending == 1)
 					rm_daemon_signal_handler(rm.signo);
 
 				continue;
 			} else {
-				RM_LOG_PERR("%s", "core: Accept error");
+				RM_LOG_PERR("%s", "core: Wait error");
 				continue;
 			}
 		}
-		do_it_all(connfd, &rm);
+		for (i = 0; i < events_n; ++i) {
+			if (events[i].data.ptr == NULL) {
+				rm_daemon_accept(listenfd, epfd, &conns, &rm);
+			} else if (events[i].data.ptr == &rm_daemon_metrics_fd) {
+				rm_daemon_metrics_accept(rm_daemon_metrics_fd, epfd, &conns, &rm);
+			} else {
+				rm_daemon_conn_on_readable(events[i].data.ptr, epfd, &rm);		/* read also on error/hangup, so it is detected */
+			}
+		}
+		rm_daemon_conn_expire(&conns);
 	}
 
 	RM_LOG_INFO("%s", "core: Shutdown");
 
+	if (rm_daemon_metrics_fd != -1) {
+		close(rm_daemon_metrics_fd);
+		unlink(metrics_path);
+	}
+	rm_metrics_buf_free(&rm_daemon_metrics_buf);
+
 	pthread_mutex_lock(&rm.mutex);
 	status = rm_core_deinit(&rm);
 	pthread_mutex_unlock(&rm.mutex);
@@ -5,6 +5,8 @@
  * @copyright   LGPLv2.1 */
 
 
+#define _GNU_SOURCE		/* renameat, unlinkat */
+
 #include "rm_defs.h"
 #include "rm_core.h"
 #include "rm_serialize.h"
@@ -53,15 +55,188 @@ void rm_msg_push_ack_free(struct rm_msg_push_ack *ack) {
 	free(ack);
 }
 
+/* Check status of session threads, close files and move reconstructed @tmp
+ * into place (@z if given, @y otherwise). */
+static enum rm_error rm_do_msg_push_rx_finalize(struct rm_session *s)
+{
+	struct rm_session_push_rx	*prvt = s->prvt;
+	struct rm_msg_push			*m = prvt->msg_push;
+	int							fd_z = -1;
+	struct stat					fs = {0};
+
+	if (prvt->ch_ch_tx_status != RM_TX_STATUS_OK)
+		return RM_ERR_CH_CH_TX_THREAD;
+
+	if (prvt->delta_rx_status == RM_RX_STATUS_DIGEST_MISMATCH) {											/* @tmp is corrupted, don't rename it */
+		unlinkat(prvt->tmp_dir_fd, s->f_z_name, 0);
+		return RM_ERR_DIGEST_MISMATCH;
+	}
+	if (prvt->delta_rx_status != RM_RX_STATUS_OK)
+		return RM_ERR_DELTA_RX_THREAD;
+
+	if (s->f_y != NULL) {																					/* fflush and close f_y */
+		fflush(s->f_y);
+		fclose(s->f_y);
+	}
+
+	if (s->f_z != NULL) {																					/* fflush and close f_z */
+		fflush(s->f_z);
+		fd_z = fileno(s->f_z);
+		memset(&fs, 0, sizeof(fs));
+		if (fstat(fd_z, &fs) != 0) {
+			s->f_y = NULL;
+			s->f_z = NULL;
+			return RM_ERR_FSTAT_TMP;
+		}
+		fclose(s->f_z);
+		s->f_z = NULL;
+	}
+
+	if ((m->hdr->flags & RM_BIT_6) == 0u) {																	/* if --leave not set */
+		if (m->z_sz > 0) {																					/* if @z is set */
+			if (s->f_y && unlink(m->y) != 0) {																/* remove @y if it exists */
+				s->f_y = NULL;
+				return RM_ERR_UNLINK_Y;
+			}
+		}
+	}
+
+	if (s->f_y != NULL)																						/* it has been flushed & closed already */
+		s->f_y = NULL;
+
+	/* sanity check */
+	if (s->f_z != NULL)																						/* it has been flushed & closed already */
+		s->f_z = NULL;
+
+	if (m->z_sz > 0) {																						/* use different name? */
+		if (renameat(prvt->tmp_dir_fd, s->f_z_name, AT_FDCWD, m->z) == -1)
+			return RM_ERR_RENAME_TMP_Z;
+	} else {
+		if (renameat(prvt->tmp_dir_fd, s->f_z_name, AT_FDCWD, m->y) == -1)
+			return RM_ERR_RENAME_TMP_Y;
+	}
+	return RM_ERR_OK;
+}
+
+/* Log why push request failed. */
+static void rm_do_msg_push_rx_log_err(const char *name, struct rm_session *s, enum rm_error err)
+{
+	if (s == NULL) {																						/* session failed to create */
+		RM_LOG_ERR("[%s] [FAIL]: ERR [%u], failed to create session", name, err);
+		return;
+	}
+	switch (err) {
+
+		case RM_ERR_Y_Z_SYNC:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, --leave option set (do not delete @y after @z has been synced) but @z name is not given or is same as @y", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_Y_NULL:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, @y file name must be specified", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_FSTAT_Y:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't fstat @y", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_FSTAT_Z:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't fstat @z", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_FSTAT_TMP:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't fstat @tmp", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_OPEN_Z:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't open @z", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_OPEN_Y:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't open @y (should transmitter set --force flag?)", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_GETCWD:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't get current working directory", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_CHDIR_Z:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't change current working directory to @z's dir", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_CHDIR_Y:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't change current working directory to @y's dir", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_OPEN_TMP:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_WRITE:																					/* error sending RM_MSG_PUSH_ACK */
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : error sending PUSH ack", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_BAD_CALL:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, bad arguments", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_UNLINK_Y:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't unlink @y", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_RENAME_TMP_Y:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't rename @tmp to @y", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_RENAME_TMP_Z:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't rename @tmp to @z", name, s->ssid1, s->ssid2, err);
+			break;
+
+		case RM_ERR_CH_CH_TX_THREAD:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : checksums tx failed with error [%u]", name, s->ssid1, s->ssid2, err, ((struct rm_session_push_rx*) s->prvt)->ch_ch_tx_status);
+			break;
+
+		case RM_ERR_DELTA_RX_THREAD:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : delta rx failed with error [%u]", name, s->ssid1, s->ssid2, err, ((struct rm_session_push_rx*) s->prvt)->delta_rx_status);
+			break;
+
+		case RM_ERR_DIGEST_MISMATCH:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : digest of reconstructed file doesn't match digest of @x, @tmp removed", name, s->ssid1, s->ssid2, err);
+			rm_rx_print_stats(s->rec_ctx, 1, 0);
+			break;
+
+		default:
+			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : default", name, s->ssid1, s->ssid2, err);
+	}
+}
+
+/* Completion of session task, called in executor thread once the file has been
+ * received (or receiving failed). */
+static void rm_do_msg_push_rx_done(struct rm_session *s, void *arg)
+{
+	struct rsyncme		*rm = (struct rsyncme*) arg;
+	const char			*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH];
+	enum rm_error		err = RM_ERR_OK;
+
+	err = rm_do_msg_push_rx_finalize(s);																	/* check task status, move result into place */
+	if (err == RM_ERR_OK) {
+		rm_rx_print_stats(s->rec_ctx, 1, 0);
+		RM_LOG_INFO("[%s] [8]: [%s] -> [%s], Session [%u][%u] ended", name, s->ssid1, s->ssid2, s->hash, s->hashed_hash);
+	} else {
+		rm_do_msg_push_rx_log_err(name, s, err);
+		rm_metrics_error(&rm->metrics, err);
+	}
+	rm_core_session_del(rm, s);
+	rm_session_free(s);																						/* frees msg and closes control connection */
+}
+
 void* rm_do_msg_push_rx(void* arg) {
 	enum rm_error					err = RM_ERR_OK;
 	struct rm_session				*s = NULL;
 	struct rm_session_push_rx		*prvt = NULL;
 	struct rm_msg_push				*msg_push = NULL;
 	uint8_t							ack_tx_err = 0;															/* set to 1 if ACK tx failed */
-	int								fd_z = -1;
-	struct stat                     fs = {0};
 	struct rm_core_options			opt = {0};
+	struct rm_exec_task				*task = NULL;
 
 	struct rm_work* work = (struct rm_work*) arg;
 	msg_push = (struct rm_msg_push*) work->msg;
@@ -74,6 +249,7 @@ void* rm_do_msg_push_rx(void* arg) {
 
 	s = rm_session_create(RM_PUSH_RX, &opt);
 	if (s == NULL || s->prvt == NULL) {
+		err = RM_ERR_CREATE_SESSION;
 		if (rm_tcp_tx_msg_ack(work->fd, RM_PT_MSG_PUSH_ACK, RM_ERR_CREATE_SESSION, NULL) != RM_ERR_OK) {	/* send ACK explaining error */
 			ack_tx_err = 1;
 		}
@@ -100,22 +276,26 @@ void* rm_do_msg_push_rx(void* arg) {
 		goto fail;
 	}
 
-	/* open delta port for listening thread (port dynamically assigned as delta_port is initialised to 0) */
-	RM_LOG_INFO("[%s] [3]: [%s] -> [%s], Opening ephemeral delta rx port", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+	if (msg_push->delta_mode == RM_DELTA_MODE_FRAMED) {														/* checksums and deltas as framed channels on this connection, delta port 0 in ACK tells so */
+		RM_LOG_INFO("[%s] [3]: [%s] -> [%s], Deltas framed on control connection", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+	} else {																								/* open delta port for listening thread (port dynamically assigned as delta_port is initialised to 0) */
+		RM_LOG_INFO("[%s] [3]: [%s] -> [%s], Opening ephemeral delta rx port", rm_work_type_str[work->task], s->ssid1, s->ssid2);
 
-	err = rm_tcp_listen(&prvt->delta_fd, INADDR_ANY, &prvt->delta_port, 0, RM_SERVER_LISTENQ); 
-	if (err != RM_ERR_OK) {
-		if (rm_tcp_tx_msg_ack(work->fd, RM_PT_MSG_PUSH_ACK, err, s) != RM_ERR_OK) {							/* send ACK with error */
-			ack_tx_err = 1;
+		err = rm_tcp_listen(&prvt->delta_fd, INADDR_ANY, &prvt->delta_port, 0, RM_SERVER_LISTENQ); 
+		if (err != RM_ERR_OK) {
+			if (rm_tcp_tx_msg_ack(work->fd, RM_PT_MSG_PUSH_ACK, err, s) != RM_ERR_OK) {						/* send ACK with error */
+				ack_tx_err = 1;
+			}
+			prvt->delta_fd = -1;
+			goto fail;
 		}
-		prvt->delta_fd = -1;
-		goto fail;
 	}
 
 	RM_LOG_INFO("[%s] [4]: [%s] -> [%s], x [%s], y [%s], z [%s], L [%zu], flags [0x%02x], tmp [%s], listening on delta rx port [%u]", rm_work_type_str[work->task], s->ssid1, s->ssid2, msg_push->x, msg_push->y, msg_push->z, msg_push->L, msg_push->hdr->flags, s->f_z_name, prvt->delta_port);
 
 	if (rm_tcp_tx_msg_ack(work->fd, RM_PT_MSG_PUSH_ACK, RM_ERR_OK, s) != RM_ERR_OK) {						/* send ACK OK */
 		ack_tx_err = 1;
+		err = RM_ERR_WRITE;
 		goto fail;
 	}
 
@@ -125,190 +305,648 @@ void* rm_do_msg_push_rx(void* arg) {
 
 	RM_LOG_INFO("[%s] [6]: [%s] -> [%s], Session hashed to [%u][%u]", rm_work_type_str[work->task], s->ssid1, s->ssid2, s->hash, s->hashed_hash);
 
-	err = rm_launch_thread(&prvt->ch_ch_tx_tid, rm_session_ch_ch_tx_f, s, PTHREAD_CREATE_JOINABLE);			/* start tx_ch_ch and rx delta threads, save pids in session object */
-	if (err != RM_ERR_OK) {
+	task = rm_session_push_rx_task_create(s, rm_do_msg_push_rx_done, work->rm);								/* checksums tx and delta rx are done by session executor, not by threads of this session */
+	if (task == NULL) {
+		err = RM_ERR_MEM;
 		goto fail;
 	}
+	work->fd = -1;																							/* session owns control connection and message now */
+	work->msg = NULL;
 
-	RM_LOG_INFO("[%s] [7]: [%s] -> [%s], Checksums tx thread started", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+	RM_LOG_INFO("[%s] [7]: [%s] -> [%s], Handing session over to executor", rm_work_type_str[work->task], s->ssid1, s->ssid2);
 
-	err = rm_launch_thread(&prvt->delta_rx_tid, rm_session_delta_rx_f_remote, s, PTHREAD_CREATE_JOINABLE);	/* start rx delta thread */
-	if (err != RM_ERR_OK) {
-		goto fail;
+	if (rm_exec_submit(&work->rm->exec, task, RM_EXEC_WAIT_OUT) != RM_ERR_OK) {
+		RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], can't submit session task to executor", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+		task->f_dtor(task, 1);																				/* reports failure and frees session */
 	}
+	return NULL;
 
-	RM_LOG_INFO("[%s] [8]: [%s] -> [%s], Delta rx thread started", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+fail:
+	rm_do_msg_push_rx_log_err(rm_work_type_str[work->task], s, err);
+	rm_metrics_error(&work->rm->metrics, err);
+	if (ack_tx_err == 1) {																					/* failed to send ACK */
+		/* TODO reschedule the job? */
+	}
+	if (s != NULL) {
+		if (prvt != NULL && prvt->fd == work->fd)
+			work->fd = -1;																					/* closed in rm_session_free */
+		rm_core_session_del(work->rm, s);
+		rm_session_free(s);
+		s = NULL;
+		work->msg = NULL;																					/* do not free msg again in work dtor */
+	}
+	return NULL;
+}
 
-	pthread_join(prvt->ch_ch_tx_tid, NULL);
+/* Entry of directory push file list, as received in MSG_PUSH_FILE. */
+struct rm_push_tree_entry {
+	char					*path;						/* relative to tree roots, NULL if entry has been rejected */
+	uint64_t				bytes;
+};
+
+/* Directory push receiver, executor task. All files are xfered over control connection
+ * in list order. Task receives file list and delta frames and sends ACKs and checksums
+ * of files, at most @inflight_n files ahead of the file whose deltas are being received.
+ * Each file is received by session task (rm_session_push_rx_task_create), this task
+ * steps it instead of executor. */
+struct rm_push_tree_rx {
+	struct rm_exec_task			task;						/* must be first */
+	struct rsyncme				*rm;
+	struct rm_msg_push_tree		*msg;
+	int							fd;							/* control connection */
+	struct rm_core_options		opt;
+	char						y_root[PATH_MAX];
+	char						z_root[PATH_MAX];
+	struct rm_push_tree_entry	*entries;
+	uint64_t					entries_n;					/* entries received so far */
+	uint64_t					entries_cap;				/* entries allocated */
+	struct rm_exec_task			**inflight;					/* tasks of prepared files, indexed by file number modulo @inflight_n, NULL if file has been rejected */
+	enum rm_error				*inflight_err;				/* error sent in MSG_PUSH_ACK to rejected file */
+	uint16_t					inflight_n;
+	uint64_t					sent_n;						/* files for which ACK and checksums have been sent */
+	uint8_t						sending;					/* ACK or checksums of file @sent_n are being sent */
+	uint64_t					done_n;						/* files for which deltas have been received */
+	uint64_t					files_ok_n;
+	uint64_t					files_fail_n;
+	enum rm_error				tree_err;					/* first error, TXed in summary */
+	enum rm_error				file_err;					/* result of file finalized last */
+	uint8_t						file_broken;				/* delta stream of file finalized last is broken */
+	uint8_t						summary;					/* summary is in @out */
+	unsigned char				out[RM_MSG_PUSH_TREE_ACK_LEN > RM_MSG_ACK_LEN_MAX ? RM_MSG_PUSH_TREE_ACK_LEN : RM_MSG_ACK_LEN_MAX];	/* ACK or summary being sent */
+	size_t						out_len;
+	size_t						out_pos;
+	unsigned char				*buf;						/* bytes read from control connection */
+	size_t						buf_len;
+	size_t						buf_pos;
+	unsigned char				entry[RM_MSG_PUSH_FILE_LEN_MAX];	/* file list entry being received */
+	size_t						entry_n;
+	unsigned char				frame_hdr[RM_TCP_FRAME_HDR_LEN];
+	size_t						frame_hdr_n;
+	size_t						frame_left;					/* payload bytes of current delta frame not received yet */
+};
+
+void rm_msg_push_tree_free(struct rm_msg_push_tree *msg) {
+	free(msg->hdr);
+	free(msg);
+}
 
-	RM_LOG_INFO("[%s] [9]: [%s] -> [%s], Checksums tx thread joined", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+int rm_do_msg_push_tree_path_valid(const char *path)
+{
+	const char	*p = path;
+	size_t		len = 0;
+
+	if (path[0] == '\0' || path[0] == '/')
+		return 0;
+	while (1) {
+		len = strcspn(p, "/");
+		if (len == 0)
+			return 0;																						/* "a//b" or trailing slash */
+		if (len == 1 && p[0] == '.')
+			return 0;
+		if (len == 2 && p[0] == '.' && p[1] == '.')
+			return 0;
+		p += len;
+		if (*p == '\0')
+			return 1;
+		++p;
+	}
+}
 
-	pthread_join(prvt->delta_rx_tid, NULL);
+static enum rm_error rm_do_msg_push_tree_root(const char *root, char *dst)
+{
+	if (strlen(root) > PATH_MAX - 1)
+		return RM_ERR_TOO_MUCH_REQUESTED;
+	strcpy(dst, root);																						/* relative root stays relative to daemon's directory, no session changes it */
+	return RM_ERR_OK;
+}
 
-	RM_LOG_INFO("[%s] [10]: [%s] -> [%s], All threads joined", rm_work_type_str[work->task], s->ssid1, s->ssid2);
+/* Close files of session that won't be finalized and remove @tmp.
+ * Control connection is not owned by the session. */
+static void rm_do_msg_push_tree_file_release(struct rm_push_tree_rx *t, struct rm_session *s, uint8_t unlink_tmp, uint8_t hashed)
+{
+	struct rm_session_push_rx	*prvt = s->prvt;
 
-	if (prvt->ch_ch_tx_status != RM_TX_STATUS_OK) {
-		err = RM_ERR_CH_CH_TX_THREAD;
-		goto fail;
+	prvt->fd = -1;
+	if (s->f_y != NULL) {
+		fclose(s->f_y);
+		s->f_y = NULL;
 	}
+	if (s->f_z != NULL) {
+		fclose(s->f_z);
+		s->f_z = NULL;
+		if (unlink_tmp)
+			unlinkat(prvt->tmp_dir_fd, s->f_z_name, 0);
+	}
+	if (hashed)
+		rm_core_session_del(t->rm, s);
+	rm_session_free(s);
+}
 
-	if (prvt->delta_rx_status != RM_RX_STATUS_OK) {
-		err = RM_ERR_DELTA_RX_THREAD;
+/* Create RM_PUSH_RX session for single file of the tree, open @y and @tmp. */
+static enum rm_error rm_do_msg_push_tree_file_prepare(struct rm_push_tree_rx *t, const struct rm_push_tree_entry *e, struct rm_session **s_out)
+{
+	enum rm_error				err = RM_ERR_OK;
+	struct rm_msg_push			*m = NULL;
+	struct rm_session			*s = NULL;
+	struct rm_session_push_rx	*prvt = NULL;
+	char						dir[PATH_MAX];
+	int							n = 0;
+
+	*s_out = NULL;
+	if (e->path == NULL)
+		return RM_ERR_BAD_CALL;
+
+	m = malloc(sizeof(struct rm_msg_push));
+	if (m == NULL)
+		return RM_ERR_MEM;
+	memset(m, 0, sizeof(struct rm_msg_push));
+	if (rm_msg_push_alloc(m) != RM_ERR_OK) {
+		free(m);
+		return RM_ERR_MEM;
+	}
+	m->hdr->pt = RM_PT_MSG_PUSH;
+	m->hdr->flags = t->msg->hdr->flags;
+	memcpy(m->ssid, t->msg->ssid, sizeof(m->ssid));
+	m->L = t->msg->L;
+	m->bytes = e->bytes;
+	m->delta_mode = RM_DELTA_MODE_FRAMED;
+	m->codec = t->msg->codec;																/* accepted per file, ACK of each file tells */
+	m->codec_level = t->msg->codec_level;
+	m->roll = t->msg->roll;
+	m->roll_seed = t->msg->roll_seed;
+	m->prefilter = t->msg->prefilter;
+	m->x_sz = strlen(e->path) + 1;
+	if (m->x_sz > RM_FILE_LEN_MAX) {
+		err = RM_ERR_TOO_MUCH_REQUESTED;
 		goto fail;
 	}
-
-	if (s->f_y != NULL) {																					/* fflush and close f_y */
-		fflush(s->f_y);
-		fclose(s->f_y);
+	strcpy(m->x, e->path);
+	n = snprintf(m->y, RM_FILE_LEN_MAX, "%s/%s", t->y_root, e->path);
+	if (n < 0 || n > RM_FILE_LEN_MAX - 1) {
+		err = RM_ERR_TOO_MUCH_REQUESTED;
+		goto fail;
 	}
-
-	if (s->f_z != NULL) {																					/* fflush and close f_z */
-		fflush(s->f_z);
-		fd_z = fileno(s->f_z);
-		memset(&fs, 0, sizeof(fs));
-		if (fstat(fd_z, &fs) != 0) {
-			err = RM_ERR_FSTAT_TMP;
-			s->f_y = NULL;
-			s->f_z = NULL;
+	m->y_sz = n + 1;
+	if (t->z_root[0] != '\0') {
+		n = snprintf(m->z, RM_FILE_LEN_MAX, "%s/%s", t->z_root, e->path);
+		if (n < 0 || n > RM_FILE_LEN_MAX - 1) {
+			err = RM_ERR_TOO_MUCH_REQUESTED;
 			goto fail;
 		}
-		fclose(s->f_z);
-		s->f_z = NULL;
+		m->z_sz = n + 1;
 	}
 
-	if ((prvt->msg_push->hdr->flags & RM_BIT_6) == 0u) {													/* if --leave not set */
-		if (prvt->msg_push->z_sz > 0) {																		/* if @z is set */
-			if (s->f_y && unlink(prvt->msg_push->y) != 0) {													/* remove @y if it exists */
-				s->f_y = NULL;
-				err = RM_ERR_UNLINK_Y;
-				goto fail;
-			}
-		}
+	strcpy(dir, m->z_sz > 0 ? m->z : m->y);																/* result's directory may not exist yet */
+	strcpy(dir, dirname(dir));
+	if (access(dir, F_OK) != 0 && ((m->hdr->flags & RM_BIT_4) || access(m->y, F_OK) == 0)) {
+		err = rm_util_mkdir_p(dir, 0755);
+		if (err != RM_ERR_OK)
+			goto fail;
 	}
 
-	if (s->f_y != NULL)																						/* it has been flushed & closed already */
-		s->f_y = NULL;
+	s = rm_session_create(RM_PUSH_RX, &t->opt);
+	if (s == NULL || s->prvt == NULL) {
+		err = RM_ERR_CREATE_SESSION;
+		goto fail;
+	}
+	prvt = s->prvt;
+	uuid_unparse(m->ssid, s->ssid1);
+	uuid_unparse(s->id, s->ssid2);
 
-	/* sanity check */
-	if (s->f_z != NULL)																						/* it has been flushed & closed already */
-		s->f_z = NULL;
+	err = rm_session_assign_validate_from_msg_push(s, m, t->fd);											/* validate, open result's directory and @tmp in it */
+	if (prvt->msg_push == NULL)
+		prvt->msg_push = m;																					/* session owns message from now on */
+	m = NULL;
+	if (err != RM_ERR_OK) {
+		rm_do_msg_push_tree_file_release(t, s, 1, 0);
+		return err;
+	}
+	if (e->bytes == 0)
+		prvt->ch_ch_n = 0;																					/* empty @x, nothing to match against */
 
-	if (prvt->msg_push->z_sz > 0) {																			/* use different name? */
-		if (rename(s->f_z_name, prvt->msg_push->z) == -1) {
-			err = RM_ERR_RENAME_TMP_Z;
-			goto fail;
+	rm_core_session_add(t->rm, s);
+	*s_out = s;
+	return RM_ERR_OK;
+
+fail:
+	if (s != NULL)
+		rm_session_free(s);
+	if (m != NULL)
+		rm_msg_push_free(m);
+	return err;
+}
+
+/* Completion of file task, called from its f_dtor (file tasks are not submitted to executor). */
+static void rm_do_msg_push_tree_file_done(struct rm_session *s, void *arg)
+{
+	struct rm_push_tree_rx		*t = arg;
+	struct rm_session_push_rx	*prvt = s->prvt;
+
+	t->file_broken = (prvt->delta_rx_status != RM_RX_STATUS_OK && prvt->delta_rx_status != RM_RX_STATUS_DIGEST_MISMATCH);	/* can't find start of next file */
+	t->file_err = rm_do_msg_push_rx_finalize(s);
+	if (t->opt.loglevel > RM_LOGLEVEL_NORMAL)
+		rm_rx_print_stats(s->rec_ctx, 1, 0);
+	rm_do_msg_push_tree_file_release(t, s, t->file_err != RM_ERR_OK, 1);
+}
+
+/* Deltas of file @done_n have been received (or none come for it), finalize and count it. */
+static enum rm_error rm_do_msg_push_tree_file_end(struct rm_push_tree_rx *t)
+{
+	const char			*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH_TREE];
+	uint64_t			i = t->done_n;
+	struct rm_exec_task	*f = t->inflight[i % t->inflight_n];
+	enum rm_error		err = t->inflight_err[i % t->inflight_n];
+
+	t->inflight[i % t->inflight_n] = NULL;
+	if (f != NULL) {
+		t->file_broken = 0;
+		f->f_dtor(f, 0);																					/* rm_do_msg_push_tree_file_done */
+		err = t->file_err;
+		if (t->file_broken) {
+			RM_LOG_ERR("[%s] [FAIL]: file [%" PRIu64 "] [%s], delta rx failed", name, i, t->entries[i].path);
+			return RM_ERR_DELTA_RX_THREAD;
 		}
+	}
+	if (err == RM_ERR_OK) {
+		++t->files_ok_n;
 	} else {
-		if (rename(s->f_z_name, prvt->msg_push->y) == -1) {
-			err = RM_ERR_RENAME_TMP_Y;
-			goto fail;
-		}
+		RM_LOG_ERR("[%s] [FAIL]: file [%" PRIu64 "] [%s], ERR [%u]", name, i, t->entries[i].path ? t->entries[i].path : "", err);
+		rm_metrics_error(&t->rm->metrics, err);
+		++t->files_fail_n;
+		if (t->tree_err == RM_ERR_OK)
+			t->tree_err = err;
 	}
+	t->done_n = i + 1;
+	return RM_ERR_OK;
+}
 
-	rm_rx_print_stats(s->rec_ctx, 1, 0);
-	RM_LOG_INFO("[%s] [11]: [%s] -> [%s], Session [%u][%u] ended", rm_work_type_str[work->task], s->ssid1, s->ssid2, s->hash, s->hashed_hash);
-
-	if (s != NULL) {
-		rm_core_session_del(work->rm, s);
-		rm_session_free(s);																					/* frees msg allocated for work as well */
-		s = NULL;
-		work->msg = NULL;																					/* do not free msg again in work dtor */
+/* Take bytes of file list entry from rx buffer, add entry once it is complete. */
+static enum rm_error rm_do_msg_push_tree_entry_rx(struct rm_push_tree_rx *t)
+{
+	const char				*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH_TREE];
+	struct rm_msg_hdr		hdr = {0};
+	struct rm_msg_push_file	m;
+	struct rm_push_tree_entry	*e = NULL;
+	size_t					need = RM_MSG_HDR_LEN, n = 0;
+	uint64_t				cap = 0;
+
+	m.hdr = &hdr;
+	if (t->entry_n >= RM_MSG_HDR_LEN) {																		/* header has been validated */
+		rm_deserialize_msg_hdr(t->entry, &hdr);
+		need = hdr.len;
 	}
-	return NULL;
-
-fail:
-	if (s == NULL) {																						/* session failed to create */
-		RM_LOG_ERR("[%s] [FAIL]: ERR [%u], failed to create session", rm_work_type_str[work->task], err);
+	n = rm_min(need - t->entry_n, t->buf_len - t->buf_pos);
+	memcpy(t->entry + t->entry_n, t->buf + t->buf_pos, n);
+	t->entry_n += n;
+	t->buf_pos += n;
+	if (t->entry_n < need)
+		return RM_ERR_OK;
+	if (need == RM_MSG_HDR_LEN) {
+		if (rm_core_tcp_msg_hdr_validate(t->entry, RM_MSG_HDR_LEN) != RM_ERR_OK)
+			return RM_ERR_FAIL;
+		rm_deserialize_msg_hdr(t->entry, &hdr);
+		if (hdr.pt != RM_PT_MSG_PUSH_FILE || hdr.len < RM_MSG_HDR_LEN + 8 + 2 + 2 || hdr.len > RM_MSG_PUSH_FILE_LEN_MAX)
+			return RM_ERR_MSG_PT_UNKNOWN;
+		return RM_ERR_OK;
 	}
-	switch (err) {
-
-		case RM_ERR_Y_Z_SYNC:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, --leave option set (do not delete @y after @z has been synced) but @z name is not given or is same as @y", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
-
-		case RM_ERR_Y_NULL:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, @y file name must be specified", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	rm_deserialize_msg_push_file_body(t->entry + RM_MSG_HDR_LEN, &m);
+	if (m.path_sz != hdr.len - RM_MSG_HDR_LEN - 8 - 2)
+		return RM_ERR_FAIL;
+	t->entry_n = 0;
+
+	if (t->entries_n == t->entries_cap) {
+		cap = rm_min(2 * t->entries_cap, t->msg->files_n);
+		if (cap > SIZE_MAX / sizeof(struct rm_push_tree_entry))
+			return RM_ERR_MEM;
+		e = realloc(t->entries, cap * sizeof(struct rm_push_tree_entry));
+		if (e == NULL)
+			return RM_ERR_MEM;
+		memset(e + t->entries_cap, 0, (cap - t->entries_cap) * sizeof(struct rm_push_tree_entry));
+		t->entries = e;
+		t->entries_cap = cap;
+	}
+	e = &t->entries[t->entries_n];
+	e->bytes = m.bytes;
+	if (rm_do_msg_push_tree_path_valid(m.path)) {
+		e->path = strdup(m.path);																			/* NULL rejects the file */
+	} else {
+		RM_LOG_ERR("[%s]: file [%" PRIu64 "] [%s] rejected, path must be relative and stay below the root", name, t->entries_n, m.path);
+	}
+	++t->entries_n;
+	if (t->entries_n == t->msg->files_n)
+		RM_LOG_INFO("[%s] [3]: file list of [%" PRIu64 "] entries received", name, t->msg->files_n);
+	return RM_ERR_OK;
+}
 
-		case RM_ERR_FSTAT_Y:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't fstat @y", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+/* TX ACKs and checksums of files in list order, staying at most @inflight_n files ahead
+ * of delta receiver, then summary. Sets @want_out if socket is full (or budget is out). */
+static enum rm_error rm_do_msg_push_tree_tx(struct rm_push_tree_rx *t, uint8_t *want_out)
+{
+	const char			*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH_TREE];
+	struct rm_exec_task	*f = NULL;
+	struct rm_session	*s = NULL;
+	enum rm_error		err = RM_ERR_OK;
+	ssize_t				written = 0;
+	uint64_t			i = 0;
+
+	*want_out = 0;
+	while (1) {
+		if (t->out_pos < t->out_len) {
+			written = write(t->fd, t->out + t->out_pos, t->out_len - t->out_pos);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					*want_out = 1;
+					return RM_ERR_OK;
+				}
+				return RM_ERR_WRITE;
+			}
+			t->out_pos += written;
+			continue;
+		}
+		i = t->sent_n;
+		if (t->sending) {																					/* ACK is out, checksums follow */
+			f = t->inflight[i % t->inflight_n];
+			if (f != NULL) {
+				switch (rm_session_push_rx_task_ch_ch_step(f)) {
+					case RM_EXEC_WAIT_OUT:
+						*want_out = 1;
+						return RM_ERR_OK;
+					case RM_EXEC_DONE:
+						return RM_ERR_CH_CH_TX_THREAD;
+					default:
+						break;
+				}
+			}
+			if (t->opt.loglevel > RM_LOGLEVEL_NORMAL)
+				RM_LOG_INFO("[%s]: file [%" PRIu64 "] [%s], ACK [%u] TXed", name, i, t->entries[i].path ? t->entries[i].path : "", t->inflight_err[i % t->inflight_n]);
+			t->sending = 0;
+			t->sent_n = i + 1;
+			continue;
+		}
+		if (t->done_n == t->msg->files_n) {
+			if (t->summary)
+				return RM_ERR_OK;																			/* summary is out */
+			t->out_len = rm_tcp_msg_push_tree_ack_serialize(t->out, t->tree_err, t->files_ok_n, t->files_fail_n);
+			t->out_pos = 0;
+			t->summary = 1;
+			continue;
+		}
+		if (i == t->entries_n || i - t->done_n >= t->inflight_n)
+			return RM_ERR_OK;																				/* wait for the list or for delta receiver to catch up */
+
+		err = rm_do_msg_push_tree_file_prepare(t, &t->entries[i], &s);
+		f = NULL;
+		if (s != NULL) {
+			f = rm_session_push_rx_task_create(s, rm_do_msg_push_tree_file_done, t);						/* task's fd is the control connection */
+			if (f == NULL) {
+				rm_do_msg_push_tree_file_release(t, s, 1, 1);
+				s = NULL;
+				err = RM_ERR_MEM;
+			}
+		}
+		t->inflight[i % t->inflight_n] = f;
+		t->inflight_err[i % t->inflight_n] = err;
+		t->out_len = rm_tcp_msg_ack_serialize(t->out, RM_PT_MSG_PUSH_ACK, err, s);						/* ACK with error tells transmitter to skip the file */
+		t->out_pos = 0;
+		t->sending = 1;
+	}
+}
 
-		case RM_ERR_FSTAT_Z:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't fstat @z", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+/* RX file list, then delta frames of files in list order and feed them to file tasks.
+ * Sets @want_in if bytes are expected on socket. */
+static enum rm_error rm_do_msg_push_tree_rx_deltas(struct rm_push_tree_rx *t, uint8_t *want_in, size_t *budget)
+{
+	struct rm_exec_task	*f = NULL;
+	enum rm_error		err = RM_ERR_OK;
+	ssize_t				bytes_read = 0;
+	size_t				n = 0;
+	uint16_t			len = 0;
+	uint8_t				end = 0;
+
+	*want_in = 0;
+	while (t->done_n < t->msg->files_n) {
+		if (t->entries_n == t->msg->files_n && t->done_n < t->sent_n) {
+			f = t->inflight[t->done_n % t->inflight_n];
+			if (f == NULL || t->entries[t->done_n].bytes == 0) {											/* rejected or empty, transmitter sends nothing for it */
+				err = rm_do_msg_push_tree_file_end(t);
+				if (err != RM_ERR_OK)
+					return err;
+				continue;
+			}
+		}
+		if (t->buf_pos == t->buf_len) {
+			if (t->entries_n == t->msg->files_n && t->done_n >= t->sent_n)
+				return RM_ERR_OK;																			/* nothing comes before checksums of the file are out */
+			if (*budget >= RM_EXEC_STEP_BYTES) {
+				*want_in = 1;																				/* give other sessions a turn */
+				return RM_ERR_OK;
+			}
+			bytes_read = read(t->fd, t->buf, RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX);
+			if (bytes_read < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK) {
+					*want_in = 1;
+					return RM_ERR_OK;
+				}
+				return RM_ERR_READ;
+			}
+			if (bytes_read == 0)
+				return RM_ERR_READ;																			/* transmitter gone */
+			t->buf_len = bytes_read;
+			t->buf_pos = 0;
+			*budget += bytes_read;
+			continue;
+		}
+		if (t->entries_n < t->msg->files_n) {																/* whole list comes before any deltas */
+			err = rm_do_msg_push_tree_entry_rx(t);
+			if (err != RM_ERR_OK)
+				return err;
+			continue;
+		}
+		if (t->done_n >= t->sent_n)
+			return RM_ERR_FAIL;																				/* deltas of file whose checksums haven't been sent */
+		if (t->frame_left == 0) {																			/* frame header */
+			n = rm_min(t->buf_len - t->buf_pos, RM_TCP_FRAME_HDR_LEN - t->frame_hdr_n);
+			memcpy(t->frame_hdr + t->frame_hdr_n, t->buf + t->buf_pos, n);
+			t->frame_hdr_n += n;
+			t->buf_pos += n;
+			if (t->frame_hdr_n < RM_TCP_FRAME_HDR_LEN)
+				continue;
+			t->frame_hdr_n = 0;
+			rm_deserialize_u16(t->frame_hdr + 2, &len);
+			if (t->frame_hdr[0] != RM_TCP_CHAN_DELTA || len == 0)
+				return RM_ERR_FAIL;
+			t->frame_left = len;
+			continue;
+		}
+		n = rm_min(t->buf_len - t->buf_pos, t->frame_left);
+		n = rm_session_push_rx_task_delta_feed(f, t->buf + t->buf_pos, n, &end);
+		t->buf_pos += n;
+		t->frame_left -= n;
+		if (end) {
+			err = rm_do_msg_push_tree_file_end(t);
+			if (err != RM_ERR_OK)
+				return err;
+			if (t->frame_left != 0)
+				return RM_ERR_FAIL;																			/* stream of the file ended inside of frame */
+		}
+	}
+	return RM_ERR_OK;
+}
 
-		case RM_ERR_FSTAT_TMP:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't fstat @tmp", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+static enum rm_exec_wait rm_do_msg_push_tree_rx_f(struct rm_exec_task *task)
+{
+	struct rm_push_tree_rx	*t = (struct rm_push_tree_rx*) task;
+	const char				*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH_TREE];
+	enum rm_error			err = RM_ERR_OK;
+	uint8_t					want_in = 0, want_out = 0;
+	size_t					budget = 0;
+	uint64_t				entries_n = 0, sent_n = 0, done_n = 0;
+
+	do {																									/* halves wait on each other, repeat while any of them moves on */
+		entries_n = t->entries_n;
+		sent_n = t->sent_n;
+		done_n = t->done_n;
+		err = rm_do_msg_push_tree_tx(t, &want_out);
+		if (err == RM_ERR_OK)
+			err = rm_do_msg_push_tree_rx_deltas(t, &want_in, &budget);
+		if (err != RM_ERR_OK) {
+			RM_LOG_ERR("[%s] [FAIL]: ERR [%u], control connection broken or out of sync", name, err);
+			rm_metrics_error(&t->rm->metrics, err);
+			return RM_EXEC_DONE;
+		}
+	} while ((t->entries_n != entries_n || t->sent_n != sent_n || t->done_n != done_n) && budget < RM_EXEC_STEP_BYTES);
 
-		case RM_ERR_OPEN_Z:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't open @z", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	if (t->summary && t->out_pos == t->out_len)
+		return RM_EXEC_DONE;
+	if (budget >= RM_EXEC_STEP_BYTES || (want_in && want_out))
+		return RM_EXEC_WAIT_IN_OUT;
+	return (want_out ? RM_EXEC_WAIT_OUT : RM_EXEC_WAIT_IN);
+}
 
-		case RM_ERR_OPEN_Y:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't open @y (should transmitter set --force flag?)", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+/* Release files in flight, entries and control connection. */
+static void rm_do_msg_push_tree_rx_free(struct rm_push_tree_rx *t)
+{
+	struct rm_exec_task	*f = NULL;
+	uint64_t			i = 0;
+
+	if (t->inflight != NULL) {
+		for (i = t->done_n; i < t->sent_n + t->sending; ++i) {											/* files prepared but never finished */
+			f = t->inflight[i % t->inflight_n];
+			if (f != NULL)
+				f->f_dtor(f, 1);																			/* removes @tmp */
+		}
+	}
+	if (t->entries != NULL) {
+		for (i = 0; i < t->entries_n; ++i)
+			free(t->entries[i].path);
+		free(t->entries);
+	}
+	free(t->inflight);
+	free(t->inflight_err);
+	free(t->buf);
+	if (t->fd != -1)
+		close(t->fd);
+	if (t->msg != NULL)
+		rm_msg_push_tree_free(t->msg);
+	free(t);
+}
 
-		case RM_ERR_GETCWD:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't get current working directory", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+static void rm_do_msg_push_tree_rx_dtor(struct rm_exec_task *task, uint8_t aborted)
+{
+	struct rm_push_tree_rx	*t = (struct rm_push_tree_rx*) task;
+	const char				*name = rm_work_type_str[RM_WORK_PROCESS_MSG_PUSH_TREE];
 
-		case RM_ERR_CHDIR_Z:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't change current working directory to @z's dir", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	if (aborted == 0 && t->summary && t->out_pos == t->out_len) {
+		RM_LOG_INFO("[%s] [4]: y [%s], z [%s], files [%" PRIu64 "], OK [%" PRIu64 "], failed [%" PRIu64 "]", name, t->y_root, t->z_root, t->msg->files_n, t->files_ok_n, t->files_fail_n);
+	} else {
+		RM_LOG_ERR("[%s] [FAIL]: aborted after [%" PRIu64 "] files, OK [%" PRIu64 "], failed [%" PRIu64 "]", name, t->done_n, t->files_ok_n, t->files_fail_n);
+	}
+	rm_do_msg_push_tree_rx_free(t);
+}
 
-		case RM_ERR_CHDIR_Y:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, can't change current working directory to @y's dir", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+void* rm_do_msg_push_tree_rx(void* arg) {
+	enum rm_error					err = RM_ERR_OK;
+	struct rm_push_tree_rx			*t = NULL;
 
-		case RM_ERR_OPEN_TMP:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	struct rm_work* work = (struct rm_work*) arg;
 
-		case RM_ERR_WRITE:																					/* error sending RM_MSG_PUSH_ACK */
-			if (s != NULL) {
-				RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : error sending PUSH ack", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			} else {
-				RM_LOG_ERR("[%s] [FAIL]: ERR [%u] : error sending PUSH ack", rm_work_type_str[work->task], err);
-			}
-			break;
+	RM_LOG_INFO("[%s] [0]: work started in worker [%u] thread [%llu]", rm_work_type_str[work->task], work->worker_idx, rm_gettid());
 
-		case RM_ERR_BAD_CALL:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : request can't be handled, bad arguments", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	t = calloc(1, sizeof(struct rm_push_tree_rx));
+	if (t == NULL) {
+		err = RM_ERR_MEM;
+		goto ack;
+	}
+	t->rm = work->rm;
+	t->msg = (struct rm_msg_push_tree*) work->msg;
+	t->fd = work->fd;
 
-		case RM_ERR_UNLINK_Y:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't unlink @y", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	pthread_mutex_lock(&work->rm->mutex);
+	memcpy(&t->opt, &work->rm->opt, sizeof(struct rm_core_options));
+	pthread_mutex_unlock(&work->rm->mutex);
 
-		case RM_ERR_RENAME_TMP_Y:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't rename @tmp to @y", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	RM_LOG_INFO("[%s] [1]: y [%s], z [%s], L [%zu], flags [0x%02x], files [%" PRIu64 "], inflight [%u]. Validating...", rm_work_type_str[work->task], t->msg->y, t->msg->z, t->msg->L, t->msg->hdr->flags, t->msg->files_n, t->msg->inflight);
 
-		case RM_ERR_RENAME_TMP_Z:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : can't rename @tmp to @z", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
-			break;
+	if (t->msg->L == 0) {
+		err = RM_ERR_BLOCK_SIZE;
+		goto ack;
+	}
+	if (t->msg->y_sz == 0) {
+		err = RM_ERR_Y_NULL;
+		goto ack;
+	}
+	err = rm_do_msg_push_tree_root(t->msg->y, t->y_root);
+	if (err != RM_ERR_OK)
+		goto ack;
+	if (t->msg->z_sz > 0) {
+		err = rm_do_msg_push_tree_root(t->msg->z, t->z_root);
+		if (err != RM_ERR_OK)
+			goto ack;
+	}
+	t->inflight_n = rm_max(1u, rm_min((unsigned int) t->msg->inflight, RM_TREE_INFLIGHT_MAX));
+	t->inflight = calloc(t->inflight_n, sizeof(struct rm_exec_task*));
+	t->inflight_err = calloc(t->inflight_n, sizeof(enum rm_error));
+	t->entries_cap = rm_min(t->msg->files_n, RM_TREE_ENTRIES_N);											/* @files_n comes from the wire, entries grow as they come */
+	t->entries = (t->entries_cap > 0 ? calloc(t->entries_cap, sizeof(struct rm_push_tree_entry)) : NULL);
+	t->buf = malloc(RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX);
+	if (t->inflight == NULL || t->inflight_err == NULL || (t->entries_cap > 0 && t->entries == NULL) || t->buf == NULL) {
+		err = RM_ERR_MEM;
+		goto ack;
+	}
 
-		case RM_ERR_CH_CH_TX_THREAD:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : checksums tx thread failed with error [%u]", rm_work_type_str[work->task], s->ssid1, s->ssid2, err, prvt->ch_ch_tx_status);
-			break;
+ack:
+	if (rm_tcp_tx_msg_ack(work->fd, RM_PT_MSG_ACK, err, NULL) != RM_ERR_OK || err != RM_ERR_OK) {
+		RM_LOG_ERR("[%s] [FAIL]: ERR [%u], request can't be handled", rm_work_type_str[work->task], err);
+		rm_metrics_error(&work->rm->metrics, err != RM_ERR_OK ? err : RM_ERR_WRITE);
+		goto fail;
+	}
+	if (rm_tcp_set_socket_blocking_mode(t->fd, 0) != 0) {
+		RM_LOG_ERR("[%s] [FAIL]: can't make control connection nonblocking", rm_work_type_str[work->task]);
+		goto fail;
+	}
+	work->fd = -1;																							/* task owns control connection and message now */
+	work->msg = NULL;
+	t->task.fd = t->fd;
+	t->task.f = rm_do_msg_push_tree_rx_f;
+	t->task.f_dtor = rm_do_msg_push_tree_rx_dtor;
 
-		case RM_ERR_DELTA_RX_THREAD:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : delta rx thread failed with error [%u]", rm_work_type_str[work->task], s->ssid1, s->ssid2, err, prvt->delta_rx_status);
-			break;
+	RM_LOG_INFO("[%s] [2]: y [%s], z [%s], receiving file list, handing over to executor", rm_work_type_str[work->task], t->y_root, t->z_root);
 
-		default:
-			RM_LOG_ERR("[%s] [FAIL]: [%s] -> [%s], ERR [%u] : default", rm_work_type_str[work->task], s->ssid1, s->ssid2, err);
+	if (rm_exec_submit(&work->rm->exec, &t->task, RM_EXEC_WAIT_IN_OUT) != RM_ERR_OK) {					/* first step right away, summary of empty tree is due at once */
+		RM_LOG_ERR("[%s] [FAIL]: can't submit task to executor", rm_work_type_str[work->task]);
+		t->task.f_dtor(&t->task, 1);
 	}
-	if (ack_tx_err == 1) {																					/* failed to send ACK */
-		/* TODO reschedule the job? */
-	}
-	if (s != NULL) {
-		rm_core_session_del(work->rm, s);
-		rm_session_free(s);
-		s = NULL;
-		work->msg = NULL;																					/* do not free msg again in work dtor */
+	return NULL;
+
+fail:
+	if (t != NULL) {
+		t->fd = -1;																							/* closed and freed in work dtor */
+		t->msg = NULL;
+		rm_do_msg_push_tree_rx_free(t);
 	}
 	return NULL;
 }
@@ -350,7 +988,9 @@ rm_do_msg_pull_rx(struct rsyncme *rm, unsigned char *buf) {
 uint16_t
 rm_calc_msg_len(void *arg) {
 	struct rm_msg_push  *msg_push;
-	struct rm_msg_hdr   *hdr = (struct rm_msg_hdr*) arg;
+	struct rm_msg_push_tree	*msg_push_tree;
+	struct rm_msg_push_file	*msg_push_file;
+	struct rm_msg_hdr   *hdr = ((struct rm_msg*) arg)->hdr;		/* all messages keep pointer to header as first member */
 	uint16_t            len = 0;
 
 	switch (hdr->pt) {
@@ -373,6 +1013,35 @@ rm_calc_msg_len(void *arg) {
 			}
 			len += 2;							/* ch_ch_port */
 			len += 8;							/* bytes */
+			len += 1;							/* delta_mode */
+			len += 2;							/* codec, codec_level */
+			len += 1 + 8;						/* roll, roll_seed */
+			len += 1;							/* prefilter */
+			break;
+
+		case RM_PT_MSG_PUSH_TREE:
+			msg_push_tree = (struct rm_msg_push_tree*) arg;
+			len = RM_MSG_HDR_LEN;
+			len += 16;							/* ssid */
+			len += 8;							/* L */
+			len += 2;							/* inflight */
+			len += 8;							/* files_n */
+			len += (2 + msg_push_tree->y_sz);
+			len += (2 + msg_push_tree->z_sz);
+			len += 2;							/* codec, codec_level */
+			len += 1 + 8;						/* roll, roll_seed */
+			len += 1;							/* prefilter */
+			break;
+
+		case RM_PT_MSG_PUSH_FILE:
+			msg_push_file = (struct rm_msg_push_file*) arg;
+			len = RM_MSG_HDR_LEN;
+			len += 8;							/* bytes */
+			len += (2 + msg_push_file->path_sz);
+			break;
+
+		case RM_PT_MSG_PUSH_TREE_ACK:
+			len = RM_MSG_PUSH_TREE_ACK_LEN;
 			break;
 
 		case RM_PT_MSG_PULL:    /* TODO */
@@ -385,6 +1054,16 @@ rm_calc_msg_len(void *arg) {
 			len = RM_MSG_HDR_LEN;
 			len += 2;							/* delta port */
 			len += 8;							/* checksums number */
+			if (((struct rm_msg_push_ack*) arg)->codec != RM_CODEC_NONE || ((struct rm_msg_push_ack*) arg)->roll != RM_ROLL_FAST
+					|| ((struct rm_msg_push_ack*) arg)->prefilter != RM_PREFILTER_NONE) {
+				len += 2;						/* accepted codec, codec_level */
+			}
+			if (((struct rm_msg_push_ack*) arg)->roll != RM_ROLL_FAST || ((struct rm_msg_push_ack*) arg)->prefilter != RM_PREFILTER_NONE) {
+				len += 1;						/* accepted roll */
+			}
+			if (((struct rm_msg_push_ack*) arg)->prefilter != RM_PREFILTER_NONE) {
+				len += 1;						/* accepted prefilter */
+			}
 			break;
 
 		case RM_PT_MSG_PULL_ACK:
@@ -401,6 +1080,15 @@ rm_calc_msg_len(void *arg) {
 	return len;
 }
 
+void rm_msg_push_tree_dtor(void *arg) {
+	struct rm_work *work = (struct rm_work*) arg;
+	close(work->fd);
+	if (work->msg)
+		rm_msg_push_tree_free((struct rm_msg_push_tree*) work->msg);
+	work->msg = NULL;
+	rm_work_free(work);
+}
+
 void rm_msg_push_dtor(void *arg) {
 	struct rm_work *work = (struct rm_work*) arg;
 	close(work->fd);
@@ -0,0 +1,237 @@
+/* @file        rm_exec.c
+ * @brief       Session pipeline executor.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 09:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm.h"
+#include "rm_exec.h"
+
+#include <sys/epoll.h>
+
+
+static uint32_t
+rm_exec_events(enum rm_exec_wait wait) {
+	switch (wait) {
+		case RM_EXEC_WAIT_IN:
+			return EPOLLIN;
+		case RM_EXEC_WAIT_OUT:
+			return EPOLLOUT;
+		default:
+			return EPOLLIN | EPOLLOUT;
+	}
+}
+
+/* @brief   Register task's descriptor for @wait condition (or update registration). */
+static enum rm_error
+rm_exec_task_arm(struct rm_exec_thread *th, struct rm_exec_task *t, enum rm_exec_wait wait) {
+	struct epoll_event  ev;
+
+	if (t->fd_registered == t->fd && t->wait == wait) {
+		return RM_ERR_OK;                                                       /* level-triggered, nothing to change */
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = rm_exec_events(wait);
+	ev.data.ptr = t;
+	if (t->fd_registered == t->fd) {
+		if (epoll_ctl(th->epfd, EPOLL_CTL_MOD, t->fd, &ev) == 0) {
+			t->wait = wait;
+			return RM_ERR_OK;
+		}
+		if (errno != ENOENT) {                                                  /* descriptor number reused after close, register it again */
+			return RM_ERR_FAIL;
+		}
+	} else if (t->fd_registered != -1) {
+		epoll_ctl(th->epfd, EPOLL_CTL_DEL, t->fd_registered, NULL);             /* may have been closed (and so removed) by step already */
+	}
+	t->fd_registered = -1;
+	if (epoll_ctl(th->epfd, EPOLL_CTL_ADD, t->fd, &ev) != 0) {
+		return RM_ERR_FAIL;
+	}
+	t->fd_registered = t->fd;
+	t->wait = wait;
+	return RM_ERR_OK;
+}
+
+static void
+rm_exec_task_done(struct rm_exec_thread *th, struct rm_exec_task *t, uint8_t aborted) {
+	pthread_mutex_lock(&th->mutex);
+	twlist_del(&t->link);
+	th->tasks_n--;
+	pthread_mutex_unlock(&th->mutex);
+	if (t->fd_registered != -1) {
+		epoll_ctl(th->epfd, EPOLL_CTL_DEL, t->fd_registered, NULL);
+		t->fd_registered = -1;
+	}
+	t->f_dtor(t, aborted);                                                      /* task may be freed now */
+}
+
+static void*
+rm_exec_thread_f(void *arg) {
+	struct rm_exec_thread   *th = (struct rm_exec_thread*) arg;
+	struct rm_exec_task     *t = NULL;
+	struct epoll_event      events[RM_EXEC_EPOLL_EVENTS];
+	enum rm_exec_wait       wait;
+	int                     events_n = 0, i = 0;
+
+	while (th->exec->stop == 0) {
+		events_n = epoll_wait(th->epfd, events, RM_EXEC_EPOLL_EVENTS, RM_EXEC_WAIT_MS);    /* wake up periodically to check for stop */
+		if (events_n < 0) {
+			if (errno != EINTR) {
+				RM_LOG_PERR("exec: Wait error in executor thread [%u]", th->idx);
+			}
+			continue;
+		}
+		for (i = 0; i < events_n; ++i) {
+			t = events[i].data.ptr;
+			wait = t->f(t);                                                     /* step, also on error/hangup, so step detects it */
+			th->steps_n++;
+			if (wait == RM_EXEC_DONE) {
+				rm_exec_task_done(th, t, 0);
+			} else if (rm_exec_task_arm(th, t, wait) != RM_ERR_OK) {
+				RM_LOG_PERR("exec: Can't wait on descriptor [%d] in executor thread [%u]", t->fd, th->idx);
+				rm_exec_task_done(th, t, 1);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&th->mutex);                                             /* abort what is left, refuse new tasks from now on */
+	th->stopped = 1;
+	while (twlist_empty(&th->tasks) == 0) {
+		t = twlist_first_entry(&th->tasks, struct rm_exec_task, link);
+		pthread_mutex_unlock(&th->mutex);
+		rm_exec_task_done(th, t, 1);
+		pthread_mutex_lock(&th->mutex);
+	}
+	pthread_mutex_unlock(&th->mutex);
+	return NULL;
+}
+
+uint32_t
+rm_exec_threads_n_default(void) {
+	long cpus_n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus_n < 1) {
+		return RM_WORKERS_N;
+	}
+	return rm_min((uint64_t) cpus_n, RM_WORKERS_MAX);
+}
+
+enum rm_error
+rm_exec_init(struct rm_exec *e, uint32_t threads_n) {
+	struct rm_exec_thread   *th = NULL;
+	uint32_t                i = 0, running_n = 0;
+
+	memset(e, 0, sizeof(struct rm_exec));
+	e->threads = calloc(threads_n, sizeof(struct rm_exec_thread));
+	if (e->threads == NULL) {
+		return RM_ERR_MEM;
+	}
+	e->threads_n = threads_n;
+	pthread_mutex_init(&e->mutex, NULL);
+
+	for (i = 0; i < threads_n; ++i) {
+		th = &e->threads[i];
+		th->idx = i;
+		th->exec = e;
+		TWINIT_LIST_HEAD(&th->tasks);
+		pthread_mutex_init(&th->mutex, NULL);
+		th->epfd = epoll_create1(0);
+		if (th->epfd < 0) {
+			RM_LOG_PERR("exec: Can't create epoll instance for executor thread [%u]", i);
+			continue;
+		}
+		if (rm_launch_thread(&th->tid, rm_exec_thread_f, th, PTHREAD_CREATE_JOINABLE) != RM_ERR_OK) {
+			close(th->epfd);
+			th->epfd = -1;
+			continue;
+		}
+		th->running = 1;
+		running_n++;
+	}
+	if (running_n == 0) {
+		return RM_ERR_LAUNCH_WORKER;
+	}
+	return RM_ERR_OK;
+}
+
+enum rm_error
+rm_exec_stop(struct rm_exec *e) {
+	struct rm_exec_thread   *th = NULL;
+	uint32_t                i = 0;
+	enum rm_error           err = RM_ERR_OK;
+
+	e->stop = 1;
+	for (i = 0; i < e->threads_n; ++i) {
+		th = &e->threads[i];
+		if (th->running == 1) {
+			if (pthread_join(th->tid, NULL) != 0) {
+				err = RM_ERR_FAIL;
+			}
+			th->running = 0;
+		}
+		if (th->epfd != -1) {
+			close(th->epfd);
+		}
+		pthread_mutex_destroy(&th->mutex);
+	}
+	pthread_mutex_destroy(&e->mutex);
+	free(e->threads);
+	e->threads = NULL;
+	e->threads_n = 0;
+	return err;
+}
+
+enum rm_error
+rm_exec_submit(struct rm_exec *e, struct rm_exec_task *t, enum rm_exec_wait wait) {
+	struct rm_exec_thread   *th = NULL, *c = NULL;
+	struct epoll_event      ev;
+	uint32_t                i = 0, idx = 0, tasks_n = 0, th_tasks_n = 0;
+
+	if (e->stop != 0 || wait == RM_EXEC_DONE) {
+		return RM_ERR_BAD_CALL;
+	}
+	pthread_mutex_lock(&e->mutex);                                              /* least loaded running thread, ties broken round-robin */
+	idx = e->next_thread_idx;
+	for (i = 0; i < e->threads_n; ++i) {
+		c = &e->threads[(idx + i) % e->threads_n];
+		if (c->running == 0) {
+			continue;
+		}
+		pthread_mutex_lock(&c->mutex);
+		tasks_n = c->tasks_n;
+		if (c->stopped == 0 && (th == NULL || tasks_n < th_tasks_n)) {
+			th = c;
+			th_tasks_n = tasks_n;
+		}
+		pthread_mutex_unlock(&c->mutex);
+	}
+	e->next_thread_idx = (idx + 1) % e->threads_n;
+	pthread_mutex_unlock(&e->mutex);
+	if (th == NULL) {
+		return RM_ERR_BAD_CALL;                                                 /* all threads are stopping */
+	}
+
+	t->thread = th;
+	t->fd_registered = t->fd;                                                   /* set before registration, as thread may step the task right after it */
+	t->wait = wait;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = rm_exec_events(wait);
+	ev.data.ptr = t;
+	pthread_mutex_lock(&th->mutex);                                             /* under the lock of abort sweep: task is either aborted by it or refused here */
+	if (th->stopped != 0 || e->stop != 0) {
+		pthread_mutex_unlock(&th->mutex);
+		t->fd_registered = -1;
+		return RM_ERR_BAD_CALL;
+	}
+	if (epoll_ctl(th->epfd, EPOLL_CTL_ADD, t->fd, &ev) != 0) {
+		pthread_mutex_unlock(&th->mutex);
+		t->fd_registered = -1;
+		return RM_ERR_FAIL;
+	}
+	twlist_add_tail(&t->link, &th->tasks);                                      /* step which finishes the task waits on the lock until task is listed */
+	th->tasks_n++;
+	pthread_mutex_unlock(&th->mutex);
+	return RM_ERR_OK;
+}
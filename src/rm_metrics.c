@@ -0,0 +1,466 @@
+/* @file        rm_metrics.c
+ * @brief       Daemon's live metrics.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 02:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_core.h"
+#include "rm_metrics.h"
+
+#include <sys/un.h>
+
+
+static const char *rm_metrics_phase_str[] = {
+	[RM_SESSION_PHASE_SETUP] = "setup",
+	[RM_SESSION_PHASE_CH_CH_TX] = "ch_ch_tx",
+	[RM_SESSION_PHASE_DELTA_RX] = "delta_rx",
+	[RM_SESSION_PHASE_FINALIZE] = "finalize"
+};
+
+void
+rm_metrics_init(struct rm_metrics *m) {
+	uint32_t	i = 0;
+
+	memset(m, 0, sizeof(struct rm_metrics));
+	pthread_mutex_init(&m->mutex, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &m->clk_start);
+	for (i = 0; i < RM_METRICS_RATE_WINDOW_S; ++i) {
+		m->rate_sec[i] = -1;
+	}
+}
+
+void
+rm_metrics_deinit(struct rm_metrics *m) {
+	pthread_mutex_destroy(&m->mutex);
+}
+
+void
+rm_metrics_session_start(struct rm_metrics *m) {
+	struct timespec	now = {0};
+	uint32_t		idx = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	idx = now.tv_sec % RM_METRICS_RATE_WINDOW_S;
+	pthread_mutex_lock(&m->mutex);
+	m->sessions_started_n++;
+	if (m->rate_sec[idx] != now.tv_sec) {											/* bucket holds older second, reuse it */
+		m->rate_sec[idx] = now.tv_sec;
+		m->rate_n[idx] = 0;
+	}
+	m->rate_n[idx]++;
+	pthread_mutex_unlock(&m->mutex);
+}
+
+void
+rm_metrics_session_end(struct rm_metrics *m, const struct rm_delta_reconstruct_ctx *rec_ctx) {
+	pthread_mutex_lock(&m->mutex);
+	m->sessions_ended_n++;
+	m->rec_by_ref += rec_ctx->rec_by_ref;
+	m->rec_by_raw += rec_ctx->rec_by_raw;
+	m->delta_ref_n += rec_ctx->delta_ref_n;
+	m->delta_raw_n += rec_ctx->delta_raw_n;
+	m->delta_tail_n += rec_ctx->delta_tail_n;
+	m->delta_zero_diff_n += rec_ctx->delta_zero_diff_n;
+	pthread_mutex_unlock(&m->mutex);
+}
+
+void
+rm_metrics_error(struct rm_metrics *m, enum rm_error err) {
+	if ((unsigned int) err >= RM_METRICS_ERRORS_N) {
+		return;
+	}
+	pthread_mutex_lock(&m->mutex);
+	m->errors_n[err]++;
+	pthread_mutex_unlock(&m->mutex);
+}
+
+static void
+rm_metrics_printf(struct rm_metrics_buf *b, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void
+rm_metrics_printf(struct rm_metrics_buf *b, const char *fmt, ...) {
+	va_list	ap;
+	int		n = 0;
+	size_t	size = 0;
+	char	*data = NULL;
+
+	if (b->oom) {
+		return;
+	}
+	while (1) {
+		va_start(ap, fmt);
+		n = vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+		va_end(ap);
+		if (n < 0) {
+			return;
+		}
+		if ((size_t) n < b->size - b->len) {
+			b->len += n;
+			return;
+		}
+		size = rm_max(2 * b->size, b->len + n + 1);
+		data = realloc(b->data, size);
+		if (data == NULL) {
+			b->oom = 1;
+			return;
+		}
+		b->data = data;
+		b->size = size;
+	}
+}
+
+/* @brief   Put string as label value (text) or JSON string contents, escaped. */
+static void
+rm_metrics_put_str(struct rm_metrics_buf *b, enum rm_metrics_format fmt, const char *s) {
+	for (; *s != '\0'; ++s) {
+		if (*s == '"' || *s == '\\') {
+			rm_metrics_printf(b, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			if (fmt == RM_METRICS_FORMAT_JSON) {
+				rm_metrics_printf(b, "\\u%04x", (unsigned char) *s);
+			} else {
+				rm_metrics_printf(b, "?");
+			}
+		} else {
+			rm_metrics_printf(b, "%c", *s);
+		}
+	}
+}
+
+/* @brief   Put single sample, in text format preceded by its # TYPE line. */
+static void
+rm_metrics_put_u64(struct rm_metrics_buf *b, enum rm_metrics_format fmt, const char *name, const char *type, uint64_t v) {
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "\"%s\":%" PRIu64 ",", name, v);
+	} else {
+		rm_metrics_printf(b, "# TYPE rsyncme_%s %s\nrsyncme_%s %" PRIu64 "\n", name, type, name, v);
+	}
+}
+
+static void
+rm_metrics_put_double(struct rm_metrics_buf *b, enum rm_metrics_format fmt, const char *name, const char *type, double v) {
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "\"%s\":%.3f,", name, v);
+	} else {
+		rm_metrics_printf(b, "# TYPE rsyncme_%s %s\nrsyncme_%s %.3f\n", name, type, name, v);
+	}
+}
+
+static double
+rm_metrics_elapsed(const struct timespec *start, const struct timespec *now) {
+	return (double) (now->tv_sec - start->tv_sec) + (double) (now->tv_nsec - start->tv_nsec) / RM_NANOSEC_PER_SEC;
+}
+
+/* Progress of active session, copied once per scrape so all its samples agree. */
+struct rm_metrics_session {
+	struct rm_session			*s;
+	struct rm_session_progress	p;
+	const char					*file;
+	double						elapsed;
+	double						throughput;
+};
+
+/* Samples of session, in text format each is own metric family. */
+enum rm_metrics_session_field {
+	RM_METRICS_SESSION_ELAPSED_S,
+	RM_METRICS_SESSION_BYTES_EXPECTED,
+	RM_METRICS_SESSION_BYTES_RX,
+	RM_METRICS_SESSION_CH_CH_TX_N,
+	RM_METRICS_SESSION_DELTAS_N,
+	RM_METRICS_SESSION_REC_BY_REF,
+	RM_METRICS_SESSION_REC_BY_RAW,
+	RM_METRICS_SESSION_THROUGHPUT_BPS,
+	RM_METRICS_SESSION_FIELDS_N
+};
+
+static const char *rm_metrics_session_field_str[] = {
+	[RM_METRICS_SESSION_ELAPSED_S] = "elapsed_s",
+	[RM_METRICS_SESSION_BYTES_EXPECTED] = "bytes_expected",
+	[RM_METRICS_SESSION_BYTES_RX] = "bytes_rx",
+	[RM_METRICS_SESSION_CH_CH_TX_N] = "ch_ch_tx_n",
+	[RM_METRICS_SESSION_DELTAS_N] = "deltas_n",
+	[RM_METRICS_SESSION_REC_BY_REF] = "rec_by_ref",
+	[RM_METRICS_SESSION_REC_BY_RAW] = "rec_by_raw",
+	[RM_METRICS_SESSION_THROUGHPUT_BPS] = "throughput_bps"
+};
+
+/* @brief   Copy progress of session, caller holds daemon's mutex (so session can't go away). */
+static void
+rm_metrics_session_snapshot(struct rm_session *s, const struct timespec *now, struct rm_metrics_session *ms) {
+	ms->s = s;
+	pthread_mutex_lock(&s->mutex);
+	memcpy(&ms->p, &s->progress, sizeof(ms->p));
+	pthread_mutex_unlock(&s->mutex);
+	ms->file = "";
+	if (s->type == RM_PUSH_RX && s->prvt != NULL && ((struct rm_session_push_rx*) s->prvt)->msg_push != NULL) {	/* request is not changed while session is in the table */
+		ms->file = ((struct rm_session_push_rx*) s->prvt)->msg_push->y;
+	}
+	ms->elapsed = rm_metrics_elapsed(&ms->p.clk_start, now);
+	ms->throughput = 0.0;
+	if (ms->elapsed > 0.0) {
+		ms->throughput = (double) (ms->p.rec_by_ref + ms->p.rec_by_raw) / ms->elapsed;
+	}
+}
+
+static void
+rm_metrics_put_session_field(struct rm_metrics_buf *b, const struct rm_metrics_session *ms, enum rm_metrics_session_field field) {
+	switch (field) {
+		case RM_METRICS_SESSION_ELAPSED_S:
+			rm_metrics_printf(b, "%.3f", ms->elapsed);
+			break;
+		case RM_METRICS_SESSION_BYTES_EXPECTED:
+			rm_metrics_printf(b, "%zu", ms->s->f_x_sz);
+			break;
+		case RM_METRICS_SESSION_BYTES_RX:
+			rm_metrics_printf(b, "%" PRIu64, ms->p.bytes_rx);
+			break;
+		case RM_METRICS_SESSION_CH_CH_TX_N:
+			rm_metrics_printf(b, "%" PRIu64, ms->p.ch_ch_tx_n);
+			break;
+		case RM_METRICS_SESSION_DELTAS_N:
+			rm_metrics_printf(b, "%" PRIu64, ms->p.deltas_n);
+			break;
+		case RM_METRICS_SESSION_REC_BY_REF:
+			rm_metrics_printf(b, "%" PRIu64, ms->p.rec_by_ref);
+			break;
+		case RM_METRICS_SESSION_REC_BY_RAW:
+			rm_metrics_printf(b, "%" PRIu64, ms->p.rec_by_raw);
+			break;
+		default:
+			rm_metrics_printf(b, "%.0f", ms->throughput);
+			break;
+	}
+}
+
+/* @brief   Render sessions: object per session (JSON) or family per field with sample
+ *          per session labeled by its ids, file and phase (text). */
+static void
+rm_metrics_render_sessions(const struct rm_metrics_session *ms, uint32_t ms_n, enum rm_metrics_format fmt, struct rm_metrics_buf *b) {
+	uint32_t	i = 0, field = 0;
+
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		for (i = 0; i < ms_n; ++i) {
+			rm_metrics_printf(b, "%s{\"ssid\":\"%s\",\"peer_ssid\":\"%s\",\"file\":\"", i > 0 ? "," : "", ms[i].s->ssid2, ms[i].s->ssid1);
+			rm_metrics_put_str(b, fmt, ms[i].file);
+			rm_metrics_printf(b, "\",\"phase\":\"%s\"", rm_metrics_phase_str[ms[i].p.phase]);
+			for (field = 0; field < RM_METRICS_SESSION_FIELDS_N; ++field) {
+				rm_metrics_printf(b, ",\"%s\":", rm_metrics_session_field_str[field]);
+				rm_metrics_put_session_field(b, &ms[i], field);
+			}
+			rm_metrics_printf(b, "}");
+		}
+		return;
+	}
+	if (ms_n == 0) {
+		return;
+	}
+	for (field = 0; field < RM_METRICS_SESSION_FIELDS_N; ++field) {
+		rm_metrics_printf(b, "# TYPE rsyncme_session_%s gauge\n", rm_metrics_session_field_str[field]);
+		for (i = 0; i < ms_n; ++i) {
+			rm_metrics_printf(b, "rsyncme_session_%s{ssid=\"%s\",peer_ssid=\"%s\",file=\"", rm_metrics_session_field_str[field], ms[i].s->ssid2, ms[i].s->ssid1);
+			rm_metrics_put_str(b, fmt, ms[i].file);
+			rm_metrics_printf(b, "\",phase=\"%s\"} ", rm_metrics_phase_str[ms[i].p.phase]);
+			rm_metrics_put_session_field(b, &ms[i], field);
+			rm_metrics_printf(b, "\n");
+		}
+	}
+}
+
+/* @brief   Render workers of workqueue: object per worker (JSON) or family
+ *          per counter with sample per worker labeled by its index (text). */
+static void
+rm_metrics_render_workers(struct rm_workqueue *wq, enum rm_metrics_format fmt, struct rm_metrics_buf *b) {
+	struct rm_worker_stats	ws;
+	uint32_t				i = 0, field = 0;
+	static const char		*name[] = { "queue_n", "busy", "done_n", "steals_n" };
+	static const char		*type[] = { "gauge", "gauge", "counter", "counter" };
+	uint64_t				v[4];
+
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		for (i = 0; i < wq->workers_n; ++i) {
+			rm_wq_worker_stats(&wq->workers[i], &ws);
+			rm_metrics_printf(b, "%s{\"queue_n\":%u,\"busy\":%u,\"done_n\":%" PRIu64 ",\"steals_n\":%" PRIu64 "}", i > 0 ? "," : "", ws.queue_n, ws.busy, ws.done_n, ws.steals_n);
+		}
+		return;
+	}
+	for (field = 0; field < 4 && wq->workers_n > 0; ++field) {
+		rm_metrics_printf(b, "# TYPE rsyncme_worker_%s %s\n", name[field], type[field]);
+		for (i = 0; i < wq->workers_n; ++i) {
+			rm_wq_worker_stats(&wq->workers[i], &ws);
+			v[0] = ws.queue_n;
+			v[1] = ws.busy;
+			v[2] = ws.done_n;
+			v[3] = ws.steals_n;
+			rm_metrics_printf(b, "rsyncme_worker_%s{idx=\"%u\"} %" PRIu64 "\n", name[field], i, v[field]);
+		}
+	}
+}
+
+/* @brief   Render executor threads, as workers. */
+static void
+rm_metrics_render_exec(struct rm_exec *e, enum rm_metrics_format fmt, struct rm_metrics_buf *b) {
+	struct rm_exec_thread	*th = NULL;
+	uint32_t				i = 0, field = 0, tasks_n = 0;
+
+	for (field = 0; field < (fmt == RM_METRICS_FORMAT_JSON ? 1u : 2u) && e->threads_n > 0; ++field) {
+		if (fmt != RM_METRICS_FORMAT_JSON) {
+			rm_metrics_printf(b, (field == 0 ? "# TYPE rsyncme_exec_thread_tasks_n gauge\n" : "# TYPE rsyncme_exec_thread_steps_n counter\n"));
+		}
+		for (i = 0; i < e->threads_n; ++i) {
+			th = &e->threads[i];
+			pthread_mutex_lock(&th->mutex);
+			tasks_n = th->tasks_n;
+			pthread_mutex_unlock(&th->mutex);
+			if (fmt == RM_METRICS_FORMAT_JSON) {
+				rm_metrics_printf(b, "%s{\"tasks_n\":%u,\"steps_n\":%" PRIu64 "}", i > 0 ? "," : "", tasks_n, th->steps_n);
+			} else if (field == 0) {
+				rm_metrics_printf(b, "rsyncme_exec_thread_tasks_n{idx=\"%u\"} %u\n", i, tasks_n);
+			} else {
+				rm_metrics_printf(b, "rsyncme_exec_thread_steps_n{idx=\"%u\"} %" PRIu64 "\n", i, th->steps_n);
+			}
+		}
+	}
+}
+
+enum rm_error
+rm_metrics_render(struct rsyncme *rm, enum rm_metrics_format fmt, struct rm_metrics_buf *b) {
+	struct rm_metrics			m;
+	struct rm_session			*s = NULL;
+	struct rm_metrics_session	*ms = NULL;
+	struct timespec				now = {0};
+	uint64_t					rate_n = 0, active_by_ref = 0, active_by_raw = 0;
+	uint32_t					i = 0, sessions_n = 0, ms_n = 0;
+	uint8_t						first = 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&rm->metrics.mutex);
+	rm->metrics.scrapes_n++;
+	memcpy(&m, &rm->metrics, sizeof(m));											/* snapshot, so counters are consistent with each other */
+	pthread_mutex_unlock(&rm->metrics.mutex);
+	for (i = 0; i < RM_METRICS_RATE_WINDOW_S; ++i) {
+		if (m.rate_sec[i] != -1 && now.tv_sec - m.rate_sec[i] < (time_t) RM_METRICS_RATE_WINDOW_S) {
+			rate_n += m.rate_n[i];
+		}
+	}
+
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "{");
+	}
+	rm_metrics_put_double(b, fmt, "uptime_s", "gauge", rm_metrics_elapsed(&m.clk_start, &now));
+	rm_metrics_put_u64(b, fmt, "sessions_started_n", "counter", m.sessions_started_n);
+	rm_metrics_put_u64(b, fmt, "sessions_ended_n", "counter", m.sessions_ended_n);
+	rm_metrics_put_double(b, fmt, "sessions_per_s", "gauge", (double) rate_n / RM_METRICS_RATE_WINDOW_S);
+	rm_metrics_put_u64(b, fmt, "delta_ref_n", "counter", m.delta_ref_n);
+	rm_metrics_put_u64(b, fmt, "delta_raw_n", "counter", m.delta_raw_n);
+	rm_metrics_put_u64(b, fmt, "delta_tail_n", "counter", m.delta_tail_n);
+	rm_metrics_put_u64(b, fmt, "delta_zero_diff_n", "counter", m.delta_zero_diff_n);
+	rm_metrics_put_u64(b, fmt, "scrapes_n", "counter", m.scrapes_n);
+
+	if (fmt == RM_METRICS_FORMAT_JSON) {											/* errors by code, only those that happened */
+		rm_metrics_printf(b, "\"errors\":{");
+		for (i = 0, first = 1; i < RM_METRICS_ERRORS_N; ++i) {
+			if (m.errors_n[i] > 0) {
+				rm_metrics_printf(b, "%s\"%u\":%" PRIu64, first ? "" : ",", i, m.errors_n[i]);
+				first = 0;
+			}
+		}
+		rm_metrics_printf(b, "},\"workers\":[");
+	} else {
+		rm_metrics_printf(b, "# TYPE rsyncme_errors_n counter\n");
+		for (i = 0; i < RM_METRICS_ERRORS_N; ++i) {
+			if (m.errors_n[i] > 0) {
+				rm_metrics_printf(b, "rsyncme_errors_n{code=\"%u\"} %" PRIu64 "\n", i, m.errors_n[i]);
+			}
+		}
+	}
+
+	pthread_mutex_lock(&rm->mutex);
+	rm_metrics_render_workers(&rm->wq, fmt, b);
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "],\"exec_threads\":[");
+	}
+	rm_metrics_render_exec(&rm->exec, fmt, b);
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "],\"sessions\":[");
+	}
+	sessions_n = rm->sessions_n;
+	if (sessions_n > 0) {
+		ms = malloc(sessions_n * sizeof(struct rm_metrics_session));
+		if (ms == NULL) {
+			b->oom = 1;
+		}
+	}
+	if (ms != NULL) {
+		twlist_for_each_entry(s, &rm->sessions_list, link) {
+			if (ms_n == sessions_n) {
+				break;
+			}
+			rm_metrics_session_snapshot(s, &now, &ms[ms_n]);
+			active_by_ref += ms[ms_n].p.rec_by_ref;
+			active_by_raw += ms[ms_n].p.rec_by_raw;
+			++ms_n;
+		}
+	}
+	rm_metrics_render_sessions(ms, ms_n, fmt, b);
+	pthread_mutex_unlock(&rm->mutex);
+	free(ms);
+
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "],");
+	}
+	rm_metrics_put_u64(b, fmt, "rec_by_ref", "counter", m.rec_by_ref + active_by_ref);	/* ended sessions and progress of active ones */
+	rm_metrics_put_u64(b, fmt, "rec_by_raw", "counter", m.rec_by_raw + active_by_raw);
+	if (fmt == RM_METRICS_FORMAT_JSON) {
+		rm_metrics_printf(b, "\"sessions_n\":%u}\n", sessions_n);
+	} else {
+		rm_metrics_printf(b, "# TYPE rsyncme_sessions_n gauge\nrsyncme_sessions_n %u\n", sessions_n);
+	}
+	return (b->oom ? RM_ERR_MEM : RM_ERR_OK);
+}
+
+void
+rm_metrics_buf_free(struct rm_metrics_buf *b) {
+	free(b->data);
+	memset(b, 0, sizeof(struct rm_metrics_buf));
+}
+
+enum rm_error
+rm_metrics_listen(const char *path, int *fd) {
+	struct sockaddr_un	addr;
+	int					sfd = -1, flags = 0;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) > sizeof(addr.sun_path) - 1) {
+		return RM_ERR_TOO_MUCH_REQUESTED;
+	}
+	strcpy(addr.sun_path, path);
+
+	sfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sfd < 0) {
+		return RM_ERR_FAIL;
+	}
+	unlink(path);																	/* left by daemon that didn't shut down cleanly (TCP port is ours, so no other daemon is running) */
+	if (bind(sfd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+		close(sfd);
+		return RM_ERR_FAIL;
+	}
+	if (chmod(path, 0660) != 0) {
+		goto fail;
+	}
+	if (listen(sfd, RM_SERVER_LISTENQ) != 0) {
+		goto fail;
+	}
+	flags = fcntl(sfd, F_GETFL, 0);
+	if (flags < 0 || fcntl(sfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		goto fail;
+	}
+	*fd = sfd;
+	return RM_ERR_OK;
+
+fail:
+	close(sfd);
+	unlink(path);
+	return RM_ERR_FAIL;
+}
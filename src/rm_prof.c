@@ -0,0 +1,56 @@
+/* @file        rm_prof.c
+ * @brief       Per-stage timing of rolling proc and reconstruction.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 04:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_prof.h"
+
+
+#define RM_PROF_CALIBRATE_N 10000u
+
+void
+rm_prof_lap_start(struct timespec *lap) {
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, lap);
+}
+
+void
+rm_prof_lap(struct rm_prof *p, enum rm_prof_stage st, struct timespec *lap) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	++p->stage[st].n;
+	p->stage[st].ns += (uint64_t) (now.tv_sec - lap->tv_sec) * RM_NANOSEC_PER_SEC + now.tv_nsec - lap->tv_nsec;
+	*lap = now;
+}
+
+void
+rm_prof_chain(struct rm_prof *p, size_t n) {
+	++p->chain_hist[rm_min(n, RM_PROF_CHAIN_HIST_N - 1)];
+}
+
+void
+rm_prof_add(struct rm_prof *dst, const struct rm_prof *src) {
+	uint32_t	i = 0;
+
+	for (i = 0; i < RM_PROF_STAGES_N; ++i) {
+		dst->stage[i].n += src->stage[i].n;
+		dst->stage[i].ns += src->stage[i].ns;
+	}
+	for (i = 0; i < RM_PROF_CHAIN_HIST_N; ++i) {
+		dst->chain_hist[i] += src->chain_hist[i];
+	}
+}
+
+double
+rm_prof_clock_overhead(void) {
+	struct timespec start, now;
+	uint32_t		i = 0;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (i = 0; i < RM_PROF_CALIBRATE_N; ++i) {
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	}
+	return ((double) (now.tv_sec - start.tv_sec) * RM_NANOSEC_PER_SEC + (now.tv_nsec - start.tv_nsec)) / RM_PROF_CALIBRATE_N;
+}
@@ -87,18 +87,45 @@ int rm_rx_f_tx_ch_ch_ref_1(const struct f_tx_ch_ch_ref_arg_1 arg)
 	return RM_ERR_OK;
 }
 
-int rm_rx_insert_nonoverlapping_ch_ch_ref(int fd, FILE *f, const char *fname, struct twhlist_head *h, size_t L,
+struct rm_rx_tx_ch_ch_fd_arg {
+	int	fd;
+	int	(*f_tx_ch_ch_ref)(int fd, const struct rm_ch_ch_ref *e);
+};
+
+static int rm_rx_tx_ch_ch_fd(void *arg, const struct rm_ch_ch_ref *e)
+{
+	const struct rm_rx_tx_ch_ch_fd_arg *a = arg;
+	return a->f_tx_ch_ch_ref(a->fd, e);
+}
+
+int rm_rx_insert_nonoverlapping_ch_ch_ref(int fd, FILE *f, const char *fname, struct twhlist_head *h, uint8_t h_bits, size_t L,
 		int (*f_tx_ch_ch_ref)(int fd, const struct rm_ch_ch_ref *e), size_t limit, size_t *blocks_n, pthread_mutex_t *file_mutex)
+{
+	struct rm_rx_tx_ch_ch_fd_arg	arg = { .fd = fd, .f_tx_ch_ch_ref = f_tx_ch_ch_ref };
+
+	if (fd < 0) {
+		if (blocks_n != NULL)
+			*blocks_n = 0;
+		return RM_ERR_BAD_CALL;
+	}
+	return rm_rx_insert_nonoverlapping_ch_ch_ref_arg(&arg, f, fname, h, h_bits, L, NULL, RM_PREFILTER_NONE, (f_tx_ch_ch_ref != NULL ? rm_rx_tx_ch_ch_fd : NULL), limit, blocks_n, file_mutex);
+}
+
+int rm_rx_insert_nonoverlapping_ch_ch_ref_arg(void *tx_arg, FILE *f, const char *fname, struct twhlist_head *h, uint8_t h_bits, size_t L, const struct rm_roll *roll, uint8_t prefilter,
+		int (*f_tx_ch_ch_ref)(void *tx_arg, const struct rm_ch_ch_ref *e), size_t limit, size_t *blocks_n, pthread_mutex_t *file_mutex)
 {
 	int                 ffd = -1, res = -1;
 	enum rm_error       err = 0;
 	struct stat         fs = {0};
-	size_t				file_sz = 0, read_left = 0, read_now = 0, read = 0;
-	size_t              entries_n = 0;
-	struct rm_ch_ch_ref_hlink	*e = NULL;
+	size_t				file_sz = 0, read_left = 0, read_now = 0, read = 0, off = 0;
+	size_t              entries_n = 0, lanes_n = 0, i = 0;
+	struct rm_ch_ch_ref_hlink	*e = NULL, *lanes[RM_MD5_LANES] = {NULL};
+	const unsigned char	*data[RM_MD5_LANES];
+	size_t              len[RM_MD5_LANES];
+	unsigned char       *s_ch[RM_MD5_LANES];
 	unsigned char	    *buf = NULL;
 
-	if (L == 0 || fd < 0) {
+	if (L == 0) {
 		err = RM_ERR_BAD_CALL;
 		goto done;
 	}
@@ -126,54 +153,64 @@ int rm_rx_insert_nonoverlapping_ch_ch_ref(int fd, FILE *f, const char *fname, st
 		goto done;
 	}
 
-	read_left = file_sz;																	/* read L bytes chunks */
-	read_now = rm_min(L, read_left);
+	read_left = file_sz;																	/* read up to RM_MD5_LANES blocks of L bytes at once */
+	read_now = rm_min(L * RM_MD5_LANES, read_left);
 	buf = malloc(read_now);
 	if (buf == NULL) {
-		RM_LOG_ERR("Malloc failed, L [%u], read_now [%u]", L, read_now);
+		RM_LOG_ERR("Malloc failed, L [%zu], read_now [%zu]", L, read_now);
 		err = RM_ERR_MEM;
 		goto done;
 	}
 
 	do {
+		read_now = rm_min(L * rm_min(RM_MD5_LANES, (limit > entries_n ? limit - entries_n : 1)), read_left);	/* first block is hashed even if @limit is 0 */
 		read = rm_fpread(buf, 1, read_now, L * entries_n, f, file_mutex);
 		if (read != read_now) {
 			RM_LOG_PERR("Error reading file [%s]", fname);
 			err = RM_ERR_READ;
 			goto done;
 		}
-		e = malloc(sizeof (struct rm_ch_ch_ref_hlink));										/* alloc new table entry */
-		if (e == NULL)	 {
-			RM_LOG_PERR("%s", "Can't allocate table entry, malloc failed");
-			err = RM_ERR_MEM;
-			goto done;
+		for (lanes_n = 0, off = 0; off < read; ++lanes_n, off += L) {
+			e = malloc(sizeof (struct rm_ch_ch_ref_hlink));									/* alloc new table entry */
+			if (e == NULL)	 {
+				RM_LOG_PERR("%s", "Can't allocate table entry, malloc failed");
+				err = RM_ERR_MEM;
+				goto done;
+			}
+			lanes[lanes_n] = e;
+			data[lanes_n] = buf + off;
+			len[lanes_n] = rm_min(L, read - off);
+			s_ch[lanes_n] = e->data.ch_ch.s_ch.data;
 		}
+		rm_md5_lanes(data, len, s_ch, lanes_n);												/* strong checksums of all blocks at once */
 
-		e->data.ch_ch.f_ch = rm_fast_check_block(buf, read);								/* compute checksums */
-		rm_md5(buf, read, e->data.ch_ch.s_ch.data);
+		for (i = 0; i < lanes_n; ++i) {
+			e = lanes[i];
+			e->data.ch_ch.f_ch = (roll != NULL ? rm_roll_f_ch(roll, rm_roll_block(roll, data[i], len[i])) : rm_fast_check_block(data[i], len[i]));	/* compute checksums */
+			e->data.ch_ch.c_ch = (prefilter == RM_PREFILTER_CRC32C ? rm_crc32c(0, data[i], len[i]) : 0);
 
-		e->data.ref = entries_n;															/* assign offset */
+			e->data.ref = entries_n;														/* assign offset */
 
-		if (f_tx_ch_ch_ref != NULL) {														/* tx checksums to remote A ? */
-			if (f_tx_ch_ch_ref(fd, &e->data) != RM_ERR_OK) {
-				err = RM_ERR_TX;
-				goto done;
+			if (f_tx_ch_ch_ref != NULL) {													/* tx checksums to remote A ? */
+				if (f_tx_ch_ch_ref(tx_arg, &e->data) != RM_ERR_OK) {
+					err = RM_ERR_TX;
+					goto done;
+				}
 			}
-		}
 
-		if (h != NULL) {																	/* free memory for checksums or insert them into hashtable and release memory later */
-			TWINIT_HLIST_NODE(&e->hlink);
-			twhash_add_bits(h, &e->hlink, e->data.ch_ch.f_ch, RM_NONOVERLAPPING_HASH_BITS);	/* insert into hashtable, hashing fast checksum */
-		} else {
-			free(e);
-			e = NULL;
+			if (h != NULL) {																/* free memory for checksums or insert them into hashtable and release memory later */
+				TWINIT_HLIST_NODE(&e->hlink);
+				twhash_add_bits(h, &e->hlink, e->data.ch_ch.f_ch, h_bits);				/* insert into hashtable, hashing fast checksum */
+			} else {
+				free(e);
+			}
+			lanes[i] = NULL;
+			entries_n++;
 		}
-		entries_n++;
 
 		read_left -= read;
-		read_now = rm_min(L, read_left);
 
-	} while (read_now > 0 && entries_n < limit);
+	} while (read_left > 0 && entries_n < limit);
 
 	err = RM_ERR_OK;
 
@@ -182,6 +219,9 @@ done:
 	if (blocks_n != NULL)
 		*blocks_n = entries_n;
 
+	for (i = 0; i < lanes_n; ++i)															/* not inserted */
+		free(lanes[i]);
+
 	if (buf) {
 		free(buf);
 		buf = 0;
@@ -190,14 +230,111 @@ done:
 	return err;
 }
 
+uint8_t rm_rx_ch_ch_hash_bits(uint64_t blocks_n)
+{
+	uint8_t		bits = RM_NONOVERLAPPING_HASH_BITS_MIN;
+	uint64_t	buckets_n = blocks_n / RM_NONOVERLAPPING_HASH_LOAD + (blocks_n % RM_NONOVERLAPPING_HASH_LOAD ? 1 : 0);
+
+	while (bits < RM_NONOVERLAPPING_HASH_BITS_MAX && ((uint64_t) 1 << bits) < buckets_n)
+		++bits;
+	return bits;
+}
+
+uint64_t rm_rx_ch_ch_hash_bytes(uint64_t blocks_n)
+{
+	return ((uint64_t) 1 << rm_rx_ch_ch_hash_bits(blocks_n)) * sizeof(struct twhlist_head)
+		+ blocks_n * (sizeof(struct rm_ch_ch_ref_hlink) + RM_CH_CH_MALLOC_OVERHEAD + sizeof(struct rm_ch_ch_ref*));	/* and index by block */
+}
+
+struct twhlist_head* rm_rx_ch_ch_hash_create(uint8_t bits)
+{
+	struct twhlist_head	*h = NULL;
+	size_t				bkt = 0, buckets_n = (size_t) 1 << bits;
+
+	h = malloc(buckets_n * sizeof(*h));
+	if (h == NULL)
+		return NULL;
+	for (bkt = 0; bkt < buckets_n; ++bkt)
+		TWINIT_HLIST_HEAD(&h[bkt]);
+	return h;
+}
+
+void rm_rx_ch_ch_hash_free(struct twhlist_head *h, uint8_t bits)
+{
+	size_t						bkt = 0, buckets_n = (size_t) 1 << bits;
+	struct rm_ch_ch_ref_hlink	*e = NULL;
+	struct twhlist_node			*tmp = NULL;
+
+	if (h == NULL)
+		return;
+	for (bkt = 0; bkt < buckets_n; ++bkt) {
+		twhlist_for_each_entry_safe(e, tmp, &h[bkt], hlink) {
+			free(e);
+		}
+	}
+	free(h);
+}
+
+const struct rm_ch_ch_ref** rm_rx_ch_ch_hash_index(const struct twhlist_head *h, uint8_t bits, size_t *refs_n)
+{
+	size_t							bkt = 0, buckets_n = (size_t) 1 << bits, n = 0;
+	const struct rm_ch_ch_ref_hlink	*e = NULL;
+	const struct rm_ch_ch_ref		**refs = NULL;
+
+	*refs_n = 0;
+	for (bkt = 0; bkt < buckets_n; ++bkt) {
+		twhlist_for_each_entry(e, &h[bkt], hlink) {
+			if (e->data.ref >= n)
+				n = e->data.ref + 1;
+		}
+	}
+	if (n == 0)
+		return NULL;
+	refs = calloc(n, sizeof(*refs));
+	if (refs == NULL)
+		return NULL;
+	for (bkt = 0; bkt < buckets_n; ++bkt) {
+		twhlist_for_each_entry(e, &h[bkt], hlink) {
+			if (refs[e->data.ref] == NULL)
+				refs[e->data.ref] = &e->data;
+		}
+	}
+	*refs_n = n;
+	return refs;
+}
+
+void rm_rx_ch_ch_hash_stats(const struct twhlist_head *h, uint8_t bits, struct rm_ch_ch_hash_stats *st)
+{
+	size_t							bkt = 0, buckets_n = (size_t) 1 << bits, chain_n = 0;
+	const struct rm_ch_ch_ref_hlink	*e = NULL;
+
+	memset(st, 0, sizeof(*st));
+	st->bits = bits;
+	st->buckets_n = buckets_n;
+	for (bkt = 0; bkt < buckets_n; ++bkt) {
+		chain_n = 0;
+		twhlist_for_each_entry(e, &h[bkt], hlink)
+			++chain_n;
+		st->entries_n += chain_n;
+		if (chain_n > 0)
+			++st->used_n;
+		if (chain_n > st->chain_max)
+			st->chain_max = chain_n;
+		++st->chain_hist[rm_min(chain_n, RM_HASH_CHAIN_HIST_N - 1)];
+	}
+}
+
 int rm_rx_insert_nonoverlapping_ch_ch_array(FILE *f, const char *fname, struct rm_ch_ch *checksums, size_t L,
 		int (*f_tx_ch_ch)(const struct rm_ch_ch *), size_t limit, size_t *blocks_n)
 {
 	int         ffd, res;
 	struct stat fs;
-	uint32_t	file_sz, read_left, read_now, read;
-	size_t      entries_n;
+	size_t		file_sz, read_left, read_now, read, off;
+	size_t      entries_n, lanes_n, i;
 	struct rm_ch_ch	*e = NULL;
+	const unsigned char	*data[RM_MD5_LANES];
+	size_t      len[RM_MD5_LANES];
+	unsigned char	*s_ch[RM_MD5_LANES];
 	unsigned char	*buf = NULL;
 
 	assert(f != NULL);
@@ -215,17 +352,17 @@ int rm_rx_insert_nonoverlapping_ch_ch_array(FILE *f, const char *fname, struct r
 	}
 	file_sz = fs.st_size;
 
-	read_left = file_sz; /* read L bytes chunks */
-	read_now = rm_min(L, read_left);
+	read_left = file_sz; /* read up to RM_MD5_LANES blocks of L bytes at once */
+	read_now = rm_min(L * RM_MD5_LANES, read_left);
 	buf = malloc(read_now);
 	if (buf == NULL) {
-		RM_LOG_ERR("Malloc failed, L [%u], read_now [%u]", L, read_now);
+		RM_LOG_ERR("Malloc failed, L [%zu], read_now [%zu]", L, read_now);
 		return RM_ERR_MEM;
 	}
 
 	entries_n = 0;
-	e = &checksums[0];
 	do {
+		read_now = rm_min(L * rm_min(RM_MD5_LANES, (limit > entries_n ? limit - entries_n : 1)), read_left);
 		read = fread(buf, 1, read_now, f);
 		if (read != read_now) {
 			RM_LOG_PERR("Error reading file [%s]", fname);
@@ -233,22 +370,33 @@ int rm_rx_insert_nonoverlapping_ch_ch_array(FILE *f, const char *fname, struct r
 			return RM_ERR_READ;
 		}
 
-		e->f_ch = rm_fast_check_block(buf, read); /* compute checksums */
-		rm_md5(buf, read, e->s_ch.data);
-
-		if (f_tx_ch_ch != NULL) { /* tx checksums to remote A ? */
-			if (f_tx_ch_ch(e) != RM_ERR_OK) {
-				free(buf);
-				return RM_ERR_TX;
+		lanes_n = 0;
+		off = 0;
+		do { /* empty file gets checksums of empty block */
+			data[lanes_n] = buf + off;
+			len[lanes_n] = rm_min(L, read - off);
+			s_ch[lanes_n] = checksums[entries_n + lanes_n].s_ch.data;
+			++lanes_n;
+			off += L;
+		} while (off < read);
+		rm_md5_lanes(data, len, s_ch, lanes_n); /* strong checksums of all blocks at once */
+
+		for (i = 0; i < lanes_n; ++i) {
+			e = &checksums[entries_n];
+			e->f_ch = rm_fast_check_block(data[i], len[i]); /* compute checksums */
+
+			if (f_tx_ch_ch != NULL) { /* tx checksums to remote A ? */
+				if (f_tx_ch_ch(e) != RM_ERR_OK) {
+					free(buf);
+					return RM_ERR_TX;
+				}
 			}
+			++entries_n;
 		}
-		++entries_n;
-		++e;
 
 		read_left -= read;
-		read_now = rm_min(L, read_left);
 
-	} while (read_now > 0 && entries_n < limit);
+	} while (read_left > 0 && entries_n < limit);
 
 	if (blocks_n != NULL)
 		*blocks_n = entries_n;
@@ -263,9 +411,12 @@ int rm_rx_insert_nonoverlapping_ch_ch_ref_link(FILE *f, const char *fname, struc
 {
 	int                     ffd, res;
 	struct stat             fs;
-	uint32_t	            file_sz, read_left, read_now, read;
-	size_t                  entries_n;
-	struct rm_ch_ch_ref_link *e = NULL;
+	size_t		            file_sz, read_left, read_now, read, off;
+	size_t                  entries_n, lanes_n = 0, i;
+	struct rm_ch_ch_ref_link *e = NULL, *lanes[RM_MD5_LANES];
+	const unsigned char     *data[RM_MD5_LANES];
+	size_t                  len[RM_MD5_LANES];
+	unsigned char           *s_ch[RM_MD5_LANES];
 	unsigned char           *buf = NULL;
 
 	assert(f != NULL);
@@ -283,42 +434,58 @@ int rm_rx_insert_nonoverlapping_ch_ch_ref_link(FILE *f, const char *fname, struc
 	}
 	file_sz = fs.st_size;
 
-	read_left = file_sz; /* read L bytes chunks */
-	read_now = rm_min(L, read_left);
+	read_left = file_sz; /* read up to RM_MD5_LANES blocks of L bytes at once */
+	read_now = rm_min(L * RM_MD5_LANES, read_left);
 	buf = malloc(read_now);
 	if (buf == NULL) {
-		RM_LOG_ERR("Malloc failed, L [%u], read_now [%u]", L, read_now);
+		RM_LOG_ERR("Malloc failed, L [%zu], read_now [%zu]", L, read_now);
 		return RM_ERR_MEM;
 	}
 
 	entries_n = 0;
 	do {
+		read_now = rm_min(L * rm_min(RM_MD5_LANES, (limit > entries_n ? limit - entries_n : 1)), read_left);
 		read = fread(buf, 1, read_now, f);
 		if (read != read_now) {
 			RM_LOG_PERR("Error reading file [%s]", fname);
 			free(buf);
 			return RM_ERR_READ;
 		}
-		e = malloc(sizeof (struct rm_ch_ch_ref_link));														/* alloc new table entry */
-		if (e == NULL) {
-			free(buf);
-			RM_LOG_PERR("%s", "Can't allocate list entry, malloc failed");
-			return RM_ERR_MEM;
-		}
-
-		e->data.ch_ch.f_ch = rm_fast_check_block(buf, read);												/* compute checksums */
-		rm_md5(buf, read, e->data.ch_ch.s_ch.data);
 
-		TWINIT_LIST_HEAD(&e->link); /* insert into list */
-		e->data.ref = entries_n;
-		twlist_add_tail(&e->link, l);
-
-		entries_n++;
+		lanes_n = 0;
+		off = 0;
+		do { /* empty file gets checksums of empty block */
+			e = malloc(sizeof (struct rm_ch_ch_ref_link));													/* alloc new table entry */
+			if (e == NULL) {
+				for (i = 0; i < lanes_n; ++i)
+					free(lanes[i]);
+				free(buf);
+				RM_LOG_PERR("%s", "Can't allocate list entry, malloc failed");
+				return RM_ERR_MEM;
+			}
+			lanes[lanes_n] = e;
+			data[lanes_n] = buf + off;
+			len[lanes_n] = rm_min(L, read - off);
+			s_ch[lanes_n] = e->data.ch_ch.s_ch.data;
+			++lanes_n;
+			off += L;
+		} while (off < read);
+		rm_md5_lanes(data, len, s_ch, lanes_n);																/* strong checksums of all blocks at once */
+
+		for (i = 0; i < lanes_n; ++i) {
+			e = lanes[i];
+			e->data.ch_ch.f_ch = rm_fast_check_block(data[i], len[i]);										/* compute checksums */
+
+			TWINIT_LIST_HEAD(&e->link); /* insert into list */
+			e->data.ref = entries_n;
+			twlist_add_tail(&e->link, l);
+
+			entries_n++;
+		}
 
 		read_left -= read;
-		read_now = rm_min(L, read_left);
 
-	} while (read_now > 0 && entries_n < limit);
+	} while (read_left > 0 && entries_n < limit);
 
 	*blocks_n = entries_n;
 	free(buf);
@@ -337,30 +504,59 @@ enum rm_error rm_rx_process_delta_element(void *arg)
 	FILE							*f_z = delta_pack->f_z;
 	struct rm_delta_reconstruct_ctx	*ctx = delta_pack->rec_ctx;
 	pthread_mutex_t					*m = delta_pack->file_mutex;
+	MD5_CTX							*z_md5 = delta_pack->z_md5;
+	struct rm_zout					*z_out = delta_pack->z_out;
 
 	assert(delta_e != NULL && f_z != NULL && ctx != NULL);
 	if (delta_e == NULL || f_z == NULL || ctx == NULL)
 		return RM_ERR_BAD_CALL;
 	z_offset = ctx->rec_by_ref + ctx->rec_by_raw;
 
+	if (z_out != NULL) {																					/* gather output, written in big chunks */
+		switch (delta_e->type) {
+			case RM_DELTA_ELEMENT_REFERENCE:
+			case RM_DELTA_ELEMENT_TAIL:
+				if (rm_zout_copy(z_out, fileno(f_y), delta_e->ref * ctx->L, z_offset, delta_e->raw_bytes_n, z_md5) != RM_ERR_OK)
+					return RM_ERR_COPY_OFFSET;
+				break;
+			case RM_DELTA_ELEMENT_RAW_BYTES:
+				if (rm_zout_write(z_out, z_offset, delta_e->raw_bytes, delta_e->raw_bytes_n) != RM_ERR_OK)
+					return RM_ERR_WRITE;
+				if (z_md5 != NULL)
+					md5_update(z_md5, delta_e->raw_bytes, delta_e->raw_bytes_n);
+				break;
+			case RM_DELTA_ELEMENT_ZERO_DIFF:
+				if (rm_zout_copy(z_out, fileno(f_y), 0, 0, delta_e->raw_bytes_n, z_md5) != RM_ERR_OK)
+					return RM_ERR_COPY_BUFFERED;
+				break;
+			default:
+				assert(1 == 0 && "Unknown delta element type!");
+				return RM_ERR_ARG;
+		}
+	}
+
 	switch (delta_e->type) {
 
 		case RM_DELTA_ELEMENT_REFERENCE:
-			if (rm_copy_buffered_offset(f_y, f_z, delta_e->raw_bytes_n, delta_e->ref * ctx->L, z_offset, m) != RM_ERR_OK)  /* copy referenced bytes from @f_y to @f_z */
+			if (z_out == NULL && rm_copy_buffered_offset_md5(f_y, f_z, delta_e->raw_bytes_n, delta_e->ref * ctx->L, z_offset, m, z_md5) != RM_ERR_OK)  /* copy referenced bytes from @f_y to @f_z */
 				return RM_ERR_COPY_OFFSET;
 			ctx->rec_by_ref += ctx->L;																					/* L bytes copied from @y */
 			++ctx->delta_ref_n;
 			break;
 
 		case RM_DELTA_ELEMENT_RAW_BYTES:
-			if (rm_fpwrite(delta_e->raw_bytes, delta_e->raw_bytes_n * sizeof(unsigned char), 1, z_offset, f_z, m) != 1)    /* copy raw bytes to @f_z directly */
-				return RM_ERR_WRITE;
+			if (z_out == NULL) {
+				if (rm_fpwrite(delta_e->raw_bytes, delta_e->raw_bytes_n * sizeof(unsigned char), 1, z_offset, f_z, m) != 1)    /* copy raw bytes to @f_z directly */
+					return RM_ERR_WRITE;
+				if (z_md5 != NULL)
+					md5_update(z_md5, delta_e->raw_bytes, delta_e->raw_bytes_n);
+			}
 			ctx->rec_by_raw += delta_e->raw_bytes_n;
 			++ctx->delta_raw_n;
 			break;
 
 		case RM_DELTA_ELEMENT_ZERO_DIFF:
-			if (rm_copy_buffered(f_y, f_z, delta_e->raw_bytes_n, m) != RM_ERR_OK)                                          /* copy all bytes from @f_y to @f_z */
+			if (z_out == NULL && rm_copy_buffered_md5(f_y, f_z, delta_e->raw_bytes_n, m, z_md5) != RM_ERR_OK)                                          /* copy all bytes from @f_y to @f_z */
 				return RM_ERR_COPY_BUFFERED;
 			ctx->rec_by_ref += delta_e->raw_bytes_n; /* delta ZERO_DIFF has raw_bytes_n set to indicate bytes that matched (whole file) so we can nevertheless check here at receiver that is correct */
 			++ctx->delta_ref_n;
@@ -370,7 +566,7 @@ enum rm_error rm_rx_process_delta_element(void *arg)
 
 		case RM_DELTA_ELEMENT_TAIL:
 
-			if (rm_copy_buffered_offset(f_y, f_z, delta_e->raw_bytes_n, delta_e->ref * ctx->L, z_offset, m) != RM_ERR_OK)  /* copy referenced bytes from @f_y to @f_z */
+			if (z_out == NULL && rm_copy_buffered_offset_md5(f_y, f_z, delta_e->raw_bytes_n, delta_e->ref * ctx->L, z_offset, m, z_md5) != RM_ERR_OK)  /* copy referenced bytes from @f_y to @f_z */
 				return RM_ERR_COPY_OFFSET;
 			ctx->rec_by_ref += delta_e->raw_bytes_n; /* delta TAIL has raw_bytes_n set to indicate bytes that matched (that tail) so we can nevertheless check here at receiver there is no error */
 			++ctx->delta_ref_n;
@@ -395,37 +591,41 @@ enum rm_error rm_rx_process_delta_element(void *arg)
  *			then TX ref
  *		else if it is DELTA_RAW_BYTES
  *			then	TX bytes size,
- *					TX bytes
+ *					with codec TX size of compressed bytes (0: stored),
+ *					TX bytes (compressed or stored)
  *		else
  *			it is DELTA_ZERO_DIFF, do not TX anything, we are done*/
 enum rm_error rm_rx_tx_delta_element(void *arg)
 {
 	// size_t  z_offset = 0;																							/* current offset in @f_z */
-	int fd = -1;
 	struct rm_rx_delta_element_arg	*delta_pack = arg;
 	const struct rm_delta_e			*delta_e = delta_pack->delta_e;
 	struct rm_delta_reconstruct_ctx	*ctx = delta_pack->rec_ctx;
+	struct rm_tcp_chan				*chan = delta_pack->chan;
+	const unsigned char				*z = NULL;
+	size_t							z_n = 0;
+	uint64_t						z_n_field = 0;
 
-	fd = delta_pack->fd;
-
-	if (delta_e == NULL || ctx == NULL)
+	if (delta_e == NULL || ctx == NULL || chan == NULL)
 		return RM_ERR_BAD_CALL;
 
 	/* TX delta over TCP using delta protocol */
-	if (rm_tcp_tx(fd, (void*) &delta_e->type, RM_DELTA_ELEMENT_TYPE_FIELD_SIZE) != RM_ERR_OK)							/* tx delta type over TCP connection */
+	if (rm_tcp_chan_tx(chan, &delta_e->type, RM_DELTA_ELEMENT_TYPE_FIELD_SIZE) != RM_ERR_OK)							/* tx delta type over TCP connection */
 		return RM_ERR_WRITE;
 
 	switch (delta_e->type) {
 
 		case RM_DELTA_ELEMENT_REFERENCE:																				/* receiver will copy referenced bytes from @f_y to @f_z */
-			if (rm_tcp_tx(fd, (void*) &delta_e->ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* tx ref over TCP connection */
+			if (rm_tcp_chan_tx(chan, &delta_e->ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* tx ref over TCP connection */
 				return RM_ERR_WRITE;
+			if (delta_pack->codec != NULL)																				/* matched block is in @x at current offset */
+				rm_codec_dict_add(delta_pack->codec, delta_e->ref, delta_pack->x_off, delta_pack->x_off, delta_e->raw_bytes_n);
 			ctx->rec_by_ref += delta_e->raw_bytes_n;                                                                    /* L == delta_e->raw_bytes_n for REFERNECE delta elements*/
 			++ctx->delta_ref_n;
 			break;
 
 		case RM_DELTA_ELEMENT_TAIL:																						/* receiver will copy referenced bytes from @f_y to @f_z */
-			if (rm_tcp_tx(fd, (void*) &delta_e->ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* tx ref over TCP connection */
+			if (rm_tcp_chan_tx(chan, &delta_e->ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* tx ref over TCP connection */
 				return RM_ERR_WRITE;
 			ctx->rec_by_ref += delta_e->raw_bytes_n; /* delta TAIL has raw_bytes_n set to indicate bytes that matched (that tail) so we can nevertheless check here at receiver there is no error */
 			++ctx->delta_ref_n;
@@ -434,9 +634,35 @@ enum rm_error rm_rx_tx_delta_element(void *arg)
 			break;
 
 		case RM_DELTA_ELEMENT_RAW_BYTES:																				/* receiver will copy raw bytes to @f_z directly */
-			if (rm_tcp_tx(fd, (void*) &delta_e->raw_bytes_n, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE) != RM_ERR_OK)			/* tx bytes size over TCP connection */
+			if (rm_tcp_chan_tx(chan, &delta_e->raw_bytes_n, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE) != RM_ERR_OK)			/* tx bytes size over TCP connection */
 				return RM_ERR_WRITE;
-			if (rm_tcp_tx(fd, (void*) delta_e->raw_bytes, delta_e->raw_bytes_n) != RM_ERR_OK)							/* tx bytes over TCP connection */
+			if (delta_e->raw_bytes == NULL) {																			/* literal range, bytes go from @x without copy */
+				if (delta_pack->f_x == NULL || delta_pack->codec != NULL)
+					return RM_ERR_BAD_CALL;
+				if (rm_tcp_chan_tx_file(chan, fileno(delta_pack->f_x), delta_e->raw_off, delta_e->raw_bytes_n) != RM_ERR_OK)
+					return RM_ERR_WRITE;
+				ctx->rec_by_raw += delta_e->raw_bytes_n;
+				++ctx->delta_raw_n;
+				break;
+			}
+			if (delta_pack->codec != NULL) {
+				if (rm_codec_compress(delta_pack->codec, delta_e->raw_bytes, delta_e->raw_bytes_n, &z, &z_n) != RM_ERR_OK)
+					return RM_ERR_CODEC;
+				z_n_field = z_n;
+				if (rm_tcp_chan_tx(chan, &z_n_field, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE) != RM_ERR_OK)					/* tx compressed bytes size, 0: bytes follow stored */
+					return RM_ERR_WRITE;
+				if (z_n > 0) {
+					if (rm_tcp_chan_tx(chan, z, z_n) != RM_ERR_OK)
+						return RM_ERR_WRITE;
+					ctx->rec_by_raw_z += z_n;
+					ctx->rec_by_raw += delta_e->raw_bytes_n;
+					++ctx->delta_raw_n;
+					break;
+				}
+				ctx->rec_by_raw_z += delta_e->raw_bytes_n;
+				ctx->rec_by_raw_stored += delta_e->raw_bytes_n;
+			}
+			if (rm_tcp_chan_tx(chan, delta_e->raw_bytes, delta_e->raw_bytes_n) != RM_ERR_OK)							/* tx bytes over TCP connection */
 				return RM_ERR_WRITE;
 			ctx->rec_by_raw += delta_e->raw_bytes_n;
 			++ctx->delta_raw_n;
@@ -453,10 +679,81 @@ enum rm_error rm_rx_tx_delta_element(void *arg)
 			assert(1 == 0 && "Unknown delta element type!");
 			return RM_ERR_ARG;
 	}
+	delta_pack->x_off += delta_e->raw_bytes_n;
 
 	return RM_ERR_OK;
 }
 
+static void rm_rx_print_md5(const char *name, const struct rm_md5 *digest)
+{
+	unsigned int i;
+
+	fprintf(stderr, " %s [", name);
+	for (i = 0; i < RM_STRONG_CHECK_BYTES; ++i)
+		fprintf(stderr, "%02x", digest->data[i]);
+	fprintf(stderr, "]");
+}
+
+static const char *rm_rx_prof_stage_str[RM_PROF_STAGES_N] = {
+	[RM_PROF_READ]		= "read",
+	[RM_PROF_ROLL]		= "roll",
+	[RM_PROF_BUCKET]	= "bucket",
+	[RM_PROF_STRONG]	= "strong",
+	[RM_PROF_DIGEST]	= "digest",
+	[RM_PROF_QUEUE]		= "queue",
+	[RM_PROF_TX]		= "tx",
+	[RM_PROF_REC]		= "reconstruct"
+};
+
+/* Breakdown of time spent in stages of rolling proc and delta consumer (RM_PROF builds). */
+static void rm_rx_print_prof(const struct rm_prof *prof)
+{
+	uint32_t	i = 0;
+	uint64_t	ns = 0, walks_n = 0;
+
+	for (i = 0; i < RM_PROF_STAGES_N; ++i)
+		ns += prof->stage[i].ns;
+	if (ns == 0)
+		return;
+	fprintf(stderr, "stages      : thread CPU time, clock read [%.0f] ns is charged to each lap", rm_prof_clock_overhead());
+	for (i = 0; i < RM_PROF_STAGES_N; ++i) {
+		if (prof->stage[i].n == 0)
+			continue;
+		fprintf(stderr, "\n              %-11s : [%" PRIu64 "] laps, [%lf] s (%5.1lf%%), [%.0lf] ns/lap", rm_rx_prof_stage_str[i], prof->stage[i].n,
+				(double) prof->stage[i].ns / RM_NANOSEC_PER_SEC, 100.0 * prof->stage[i].ns / ns, (double) prof->stage[i].ns / prof->stage[i].n);
+	}
+	for (i = 0; i < RM_PROF_CHAIN_HIST_N; ++i)
+		walks_n += prof->chain_hist[i];
+	if (walks_n > 0) {
+		fprintf(stderr, "\nbucket walk : entries visited [walks]");
+		for (i = 0; i < RM_PROF_CHAIN_HIST_N; ++i) {
+			if (prof->chain_hist[i] != 0)
+				fprintf(stderr, " %u%s [%" PRIu64 "]", i, (i == RM_PROF_CHAIN_HIST_N - 1 ? "+" : ""), prof->chain_hist[i]);
+		}
+	}
+	fprintf(stderr, "\n");
+}
+
+void rm_rx_print_hash_stats(const struct rm_ch_ch_hash_stats *st)
+{
+	uint32_t	i = 0;
+
+	fprintf(stderr, "\nhashtable   : buckets [%zu], checksums [%zu], load [%.3f], used buckets [%zu], max chain [%zu]",
+			st->buckets_n, st->entries_n, (double) st->entries_n / st->buckets_n, st->used_n, st->chain_max);
+	fprintf(stderr, "\n              chains                : checksums [buckets]");
+	for (i = 0; i < RM_HASH_CHAIN_HIST_N; ++i) {
+		if (st->chain_hist[i] != 0)
+			fprintf(stderr, " %u%s [%zu]", i, (i == RM_HASH_CHAIN_HIST_N - 1 ? "+" : ""), st->chain_hist[i]);
+	}
+}
+
+void rm_rx_print_spill_stats(const struct rm_ch_ch_spill_stats *st)
+{
+	fprintf(stderr, "\nspill       : checksums [%" PRIu64 "] (runs [%zu]), filter [%zu] bytes (hashes [%u]), index [%zu] bytes",
+			st->entries_n, st->runs_n, st->filter_bytes, st->filter_k, st->index_bytes);
+	fprintf(stderr, "\n              probes                : [%" PRIu64 "] (false [%" PRIu64 "]), pages read [%" PRIu64 "]", st->probes_n, st->false_n, st->reads_n);
+}
+
 void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote, uint8_t xfer_direction)
 {
 	enum rm_reconstruct_method method;
@@ -467,7 +764,12 @@ void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote,
 
 	delta_raw_overhead = rec_ctx.delta_raw_n * RM_DELTA_RAW_OVERHEAD;
 	delta_ref_overhead = rec_ctx.delta_ref_n * RM_DELTA_REF_OVERHEAD;
-	real_bytes = delta_raw_overhead + delta_ref_overhead + rec_ctx.rec_by_raw + (remote ? rec_ctx.msg_push_len + RM_MSG_PUSH_ACK_LEN : 0);
+	if (rec_ctx.codec != RM_CODEC_NONE) {																	/* literals go as compressed or stored payloads, each with its size */
+		delta_raw_overhead += rec_ctx.delta_raw_n * RM_DELTA_ELEMENT_BYTES_FIELD_SIZE;
+		real_bytes = delta_raw_overhead + delta_ref_overhead + rec_ctx.rec_by_raw_z + (remote ? rec_ctx.msg_push_len + RM_MSG_PUSH_ACK_CODEC_LEN : 0);
+	} else {
+		real_bytes = delta_raw_overhead + delta_ref_overhead + rec_ctx.rec_by_raw + (remote ? rec_ctx.msg_push_len + RM_MSG_PUSH_ACK_LEN : 0);
+	}
 
 	real_time = rec_ctx.time_real.tv_sec + (double) rec_ctx.time_real.tv_nsec / RM_NANOSEC_PER_SEC;
 	cpu_time = rec_ctx.time_cpu;
@@ -496,13 +798,33 @@ void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote,
 				fprintf(stderr, "\n              checksums overhead    : [%zu]", ch_overhead);
 			}
 			fprintf(stderr, "\n              deltas overhead       : raw [%zu], refs [%zu]", delta_raw_overhead, delta_ref_overhead);
+			if (rec_ctx.codec != RM_CODEC_NONE) {
+				fprintf(stderr, "\n              literals              : [%zu] -> [%zu] (ratio [%.3f], stored [%zu], codec [%s], level [%u])",
+						rec_ctx.rec_by_raw, rec_ctx.rec_by_raw_z, rec_ctx.rec_by_raw > 0 ? (double) rec_ctx.rec_by_raw_z / rec_ctx.rec_by_raw : 1.0,
+						rec_ctx.rec_by_raw_stored, rm_codec_str(rec_ctx.codec), rec_ctx.codec_level);
+			}
 			if (xfer_direction == 0) {																			/* RECEIVER */
 				fprintf(stderr, "\n              Total RX overhead     : [%zu]", delta_raw_overhead + delta_ref_overhead);
 				fprintf(stderr, "\n              Total RX              : [%zu]", real_bytes);
 			} else {																							/* TRANSMITTER */
 				fprintf(stderr, "\n              Total TX overhead     : [%zu]", delta_raw_overhead + delta_ref_overhead);
 				fprintf(stderr, "\n              Total TX              : [%zu]", real_bytes);
-				fprintf(stderr, "\ncollisions  : 1st [%zu], 2nd [%zu], 3rd [%zu]", rec_ctx.collisions_1st_level, rec_ctx.collisions_2nd_level, rec_ctx.collisions_3rd_level);
+				fprintf(stderr, "\ncollisions  : 1st [%zu], 2nd [%zu], 3rd [%zu] (rolling [%s])", rec_ctx.collisions_1st_level, rec_ctx.collisions_2nd_level, rec_ctx.collisions_3rd_level,
+						rm_roll_str(rec_ctx.roll));
+				if (rec_ctx.next_tried_n > 0)
+					fprintf(stderr, "\nnext block  : tried [%zu], matched [%zu] (rate [%.3f])", rec_ctx.next_tried_n, rec_ctx.next_hit_n, (double) rec_ctx.next_hit_n / rec_ctx.next_tried_n);
+				if (rec_ctx.prefilter != RM_PREFILTER_NONE)
+					fprintf(stderr, "\nprefilter   : crc32c passed [%zu], rejected [%zu]", rec_ctx.prefilter_pass_n, rec_ctx.prefilter_reject_n);
+				if (rec_ctx.h_stats.bits > 0)
+					rm_rx_print_hash_stats(&rec_ctx.h_stats);
+				if (rec_ctx.spill_stats.entries_n > 0)
+					rm_rx_print_spill_stats(&rec_ctx.spill_stats);
+			}
+			if (rec_ctx.delta_queue_bytes_peak > 0) {
+				fprintf(stderr, "\ndelta queue : peak [%zu] bytes", rec_ctx.delta_queue_bytes_peak);
+				if (rec_ctx.delta_queue_limit > 0)
+					fprintf(stderr, " (limit [%zu])", rec_ctx.delta_queue_limit);
+				fprintf(stderr, ", stalls [%zu], stalled [%f] s", rec_ctx.delta_queue_stalls_n, rec_ctx.delta_queue_stall_time);
 			}
 			break;
 
@@ -511,7 +833,32 @@ void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote,
 			exit(EXIT_FAILURE);
 			break;
 	}
+	switch (rec_ctx.integrity) {
+
+		case RM_INTEGRITY_OK:
+			fprintf(stderr, "\nintegrity   : OK,");
+			rm_rx_print_md5("md5", &rec_ctx.z_digest);
+			break;
+
+		case RM_INTEGRITY_MISMATCH:
+			fprintf(stderr, "\nintegrity   : MISMATCH,");
+			rm_rx_print_md5("@x md5", &rec_ctx.x_digest);
+			rm_rx_print_md5("@z md5", &rec_ctx.z_digest);
+			break;
+
+		case RM_INTEGRITY_SENT:
+			fprintf(stderr, "\nintegrity   : sent,");
+			rm_rx_print_md5("md5", &rec_ctx.x_digest);
+			break;
+
+		case RM_INTEGRITY_NOT_CHECKED:
+		default:
+			fprintf(stderr, "\nintegrity   : not checked");
+			break;
+	}
 	fprintf(stderr, "\ntime        : real [%lf]s, cpu [%lf]s", real_time, cpu_time);
+	if (rec_ctx.time_setup.tv_sec != 0 || rec_ctx.time_setup.tv_nsec != 0)
+		fprintf(stderr, ", setup [%lf]s", rec_ctx.time_setup.tv_sec + (double) rec_ctx.time_setup.tv_nsec / RM_NANOSEC_PER_SEC);
 	fprintf(stderr, "\nbandwidth   : [%lf]MB/s (virtual)", ((double) bytes / 1000000) / real_time);
 	fprintf(stderr, "\nbandwidth   : [%lf]MB/s (real)\n", ((double) real_bytes / 1000000) / real_time);
 	if (real_bytes <= bytes)
@@ -527,4 +874,5 @@ void rm_rx_print_stats(struct rm_delta_reconstruct_ctx rec_ctx, uint8_t remote,
 	if ((rec_ctx.copy_all_threshold_fired == 1) || (rec_ctx.copy_tail_threshold_fired == 1)) {
 		fprintf(stderr, "\n");
 	}
+	rm_rx_print_prof(&rec_ctx.prof);
 }
@@ -104,7 +104,12 @@ unsigned char* rm_serialize_msg_push(unsigned char *buf, struct rm_msg_push *m)
 	buf = rm_serialize_string(buf, m->z, m->z_sz);
 	buf = rm_serialize_u16(buf, m->ch_ch_port);
 	buf = rm_serialize_u64(buf, m->bytes);
-	return buf;
+	buf = rm_serialize_u8(buf, m->delta_mode);
+	buf = rm_serialize_u8(buf, m->codec);
+	buf = rm_serialize_u8(buf, m->codec_level);
+	buf = rm_serialize_u8(buf, m->roll);
+	buf = rm_serialize_u64(buf, m->roll_seed);
+	return rm_serialize_u8(buf, m->prefilter);
 }
 
 unsigned char* rm_serialize_msg_ack(unsigned char *buf, struct rm_msg_ack *m) {
@@ -116,13 +121,53 @@ unsigned char* rm_serialize_msg_push_ack(unsigned char *buf, struct rm_msg_push_
 	buf = rm_serialize_msg_hdr(buf, m->ack.hdr);
 	buf = rm_serialize_u16(buf, m->delta_port);
 	buf = rm_serialize_u64(buf, m->ch_ch_n);
+	if (m->codec != RM_CODEC_NONE || m->roll != RM_ROLL_FAST || m->prefilter != RM_PREFILTER_NONE) {
+		buf = rm_serialize_u8(buf, m->codec);
+		buf = rm_serialize_u8(buf, m->codec_level);
+	}
+	if (m->roll != RM_ROLL_FAST || m->prefilter != RM_PREFILTER_NONE)
+		buf = rm_serialize_u8(buf, m->roll);
+	if (m->prefilter != RM_PREFILTER_NONE)
+		buf = rm_serialize_u8(buf, m->prefilter);
+	return buf;
+}
+
+unsigned char* rm_serialize_msg_push_tree(unsigned char *buf, struct rm_msg_push_tree *m) {
+	buf = rm_serialize_msg_hdr(buf, m->hdr);
+	buf = rm_serialize_mem(buf, m->ssid, sizeof(m->ssid));
+	buf = rm_serialize_u64(buf, m->L);
+	buf = rm_serialize_u16(buf, m->inflight);
+	buf = rm_serialize_u64(buf, m->files_n);
+	buf = rm_serialize_u16(buf, m->y_sz);
+	buf = rm_serialize_string(buf, m->y, m->y_sz);
+	buf = rm_serialize_u16(buf, m->z_sz);
+	buf = rm_serialize_string(buf, m->z, m->z_sz);
+	buf = rm_serialize_u8(buf, m->codec);
+	buf = rm_serialize_u8(buf, m->codec_level);
+	buf = rm_serialize_u8(buf, m->roll);
+	buf = rm_serialize_u64(buf, m->roll_seed);
+	return rm_serialize_u8(buf, m->prefilter);
+}
+
+unsigned char* rm_serialize_msg_push_file(unsigned char *buf, struct rm_msg_push_file *m) {
+	buf = rm_serialize_msg_hdr(buf, m->hdr);
+	buf = rm_serialize_u64(buf, m->bytes);
+	buf = rm_serialize_u16(buf, m->path_sz);
+	buf = rm_serialize_string(buf, m->path, m->path_sz);
+	return buf;
+}
+
+unsigned char* rm_serialize_msg_push_tree_ack(unsigned char *buf, struct rm_msg_push_tree_ack *m) {
+	buf = rm_serialize_msg_hdr(buf, m->ack.hdr);
+	buf = rm_serialize_u64(buf, m->files_ok_n);
+	buf = rm_serialize_u64(buf, m->files_fail_n);
 	return buf;
 }
 
 unsigned char* rm_serialize_msg_pull(unsigned char *buf, struct rm_msg_pull *m) {
 	buf = rm_serialize_msg_hdr(buf, m->hdr);
-	buf = rm_serialize_u32(buf, m->L);
-	buf = rm_serialize_u32(buf, m->ch_ch_n);
+	buf = rm_serialize_u64(buf, m->L);
+	buf = rm_serialize_u64(buf, m->ch_ch_n);
 	return buf;
 }
 
@@ -246,11 +291,90 @@ unsigned char* rm_deserialize_msg_push_body(unsigned char *buf, struct rm_msg_pu
 
 /* *m takes ownership of hdr */
 unsigned char* rm_deserialize_msg_push(unsigned char *buf, struct rm_msg_hdr *hdr, struct rm_msg_push **m) {
+	unsigned char *body = buf;
+
 	(*m)->hdr = hdr;
 	buf = rm_deserialize_msg_push_body(buf, *m);
+	(*m)->delta_mode = RM_DELTA_MODE_CONN;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN < hdr->len) {												/* delta mode follows in messages of newer transmitters */
+		(*m)->delta_mode = *buf;
+		++buf;
+	}
+	(*m)->codec = RM_CODEC_NONE;
+	(*m)->codec_level = 0;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 2 <= hdr->len) {											/* and codec */
+		(*m)->codec = buf[0];
+		(*m)->codec_level = buf[1];
+		buf += 2;
+	}
+	(*m)->roll = RM_ROLL_FAST;
+	(*m)->roll_seed = 0;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 1 + 8 <= hdr->len) {										/* and rolling checksum */
+		buf = rm_deserialize_u8(buf, &(*m)->roll);
+		buf = rm_deserialize_u64(buf, &(*m)->roll_seed);
+	}
+	(*m)->prefilter = RM_PREFILTER_NONE;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 1 <= hdr->len)											/* and prefilter */
+		buf = rm_deserialize_u8(buf, &(*m)->prefilter);
+	return buf;
+}
+
+unsigned char* rm_deserialize_msg_push_tree_body(unsigned char *buf, struct rm_msg_push_tree *m) {
+	buf = rm_deserialize_mem(buf, (char*) m->ssid, sizeof(m->ssid));
+	buf = rm_deserialize_u64(buf, (uint64_t*) &m->L);
+	buf = rm_deserialize_u16(buf, &m->inflight);
+	buf = rm_deserialize_u64(buf, &m->files_n);
+	buf = rm_deserialize_u16(buf, &m->y_sz);
+	if (m->y_sz > 0) {
+		buf = rm_deserialize_string(buf, m->y, rm_min(m->y_sz, sizeof(m->y)));
+	}
+	buf = rm_deserialize_u16(buf, &m->z_sz);
+	if (m->z_sz > 0) {
+		buf = rm_deserialize_string(buf, m->z, rm_min(m->z_sz, sizeof(m->z)));
+	}
+	return buf;
+}
+
+/* *m takes ownership of hdr */
+unsigned char* rm_deserialize_msg_push_tree(unsigned char *buf, struct rm_msg_hdr *hdr, struct rm_msg_push_tree **m) {
+	unsigned char *body = buf;
+
+	(*m)->hdr = hdr;
+	buf = rm_deserialize_msg_push_tree_body(buf, *m);
+	(*m)->codec = RM_CODEC_NONE;
+	(*m)->codec_level = 0;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 2 <= hdr->len) {											/* codec follows in messages of newer transmitters */
+		(*m)->codec = buf[0];
+		(*m)->codec_level = buf[1];
+		buf += 2;
+	}
+	(*m)->roll = RM_ROLL_FAST;
+	(*m)->roll_seed = 0;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 1 + 8 <= hdr->len) {										/* and rolling checksum */
+		buf = rm_deserialize_u8(buf, &(*m)->roll);
+		buf = rm_deserialize_u64(buf, &(*m)->roll_seed);
+	}
+	(*m)->prefilter = RM_PREFILTER_NONE;
+	if ((size_t) (buf - body) + RM_MSG_HDR_LEN + 1 <= hdr->len)											/* and prefilter */
+		buf = rm_deserialize_u8(buf, &(*m)->prefilter);
+	return buf;
+}
+
+unsigned char* rm_deserialize_msg_push_file_body(unsigned char *buf, struct rm_msg_push_file *m) {
+	buf = rm_deserialize_u64(buf, &m->bytes);
+	buf = rm_deserialize_u16(buf, &m->path_sz);
+	if (m->path_sz > 0) {
+		buf = rm_deserialize_string(buf, m->path, rm_min(m->path_sz, sizeof(m->path)));
+	}
 	return buf;
 }
 
+unsigned char* rm_deserialize_msg_push_tree_ack(unsigned char *buf, struct rm_msg_push_tree_ack *ack) {
+	buf = rm_deserialize_msg_hdr(buf, ack->ack.hdr);
+	buf = rm_deserialize_u64(buf, &ack->files_ok_n);
+	return rm_deserialize_u64(buf, &ack->files_fail_n);
+}
+
 unsigned char* rm_deserialize_msg_ack(unsigned char *buf, struct rm_msg_ack *ack) {
 	return rm_deserialize_msg_hdr(buf, ack->hdr);
 }
@@ -258,7 +382,25 @@ unsigned char* rm_deserialize_msg_ack(unsigned char *buf, struct rm_msg_ack *ack
 unsigned char* rm_deserialize_msg_push_ack(unsigned char *buf, struct rm_msg_push_ack *ack) {
 	buf = rm_deserialize_msg_hdr(buf, ack->ack.hdr);
 	buf = rm_deserialize_u16(buf, &ack->delta_port);
-	return rm_deserialize_u64(buf, &ack->ch_ch_n);
+	buf = rm_deserialize_u64(buf, &ack->ch_ch_n);
+	ack->codec = RM_CODEC_NONE;
+	ack->codec_level = 0;
+	if (ack->ack.hdr->len >= RM_MSG_PUSH_ACK_CODEC_LEN) {												/* receiver accepted codec */
+		ack->codec = buf[0];
+		ack->codec_level = buf[1];
+		buf += 2;
+	}
+	ack->roll = RM_ROLL_FAST;
+	if (ack->ack.hdr->len >= RM_MSG_PUSH_ACK_ROLL_LEN) {												/* and rolling checksum */
+		ack->roll = buf[0];
+		buf += 1;
+	}
+	ack->prefilter = RM_PREFILTER_NONE;
+	if (ack->ack.hdr->len >= RM_MSG_PUSH_ACK_PREFILTER_LEN) {											/* and prefilter */
+		ack->prefilter = buf[0];
+		buf += 1;
+	}
+	return buf;
 }
 
 struct rm_msg* rm_deserialize_msg(enum rm_pt_type pt, struct rm_msg_hdr *hdr, unsigned char *body_raw) {
@@ -276,6 +418,16 @@ struct rm_msg* rm_deserialize_msg(enum rm_pt_type pt, struct rm_msg_hdr *hdr, un
 			rm_deserialize_msg_push(body_raw, hdr, (struct rm_msg_push**) &m);
 			break;
 
+		case RM_PT_MSG_PUSH_TREE:
+
+			m = malloc(sizeof(struct rm_msg_push_tree));
+			if (m == NULL) {
+				return NULL;
+			}
+			memset(m, 0, sizeof(struct rm_msg_push_tree));
+			rm_deserialize_msg_push_tree(body_raw, hdr, (struct rm_msg_push_tree**) &m);
+			break;
+
 		case RM_PT_MSG_PULL:
 		default:
 			return NULL;
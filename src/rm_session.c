@@ -7,6 +7,8 @@
  */
 
 
+#define _GNU_SOURCE		/* openat */
+
 #include "rm_session.h"
 
 
@@ -20,6 +22,7 @@ void rm_session_push_rx_init(struct rm_session_push_rx *prvt, struct rm_core_opt
 	prvt->fd = -1;
 	prvt->ch_ch_fd = -1;
 	prvt->delta_fd = -1;
+	prvt->tmp_dir_fd = -1;
 	memcpy(&prvt->opt, opt, sizeof(struct rm_core_options));
 	return;
 }
@@ -39,6 +42,10 @@ void rm_session_push_rx_free(struct rm_session_push_rx *prvt)
 		close(prvt->fd);
 		prvt->fd = -1;
 	}
+	if (prvt->tmp_dir_fd >= 0) {
+		close(prvt->tmp_dir_fd);
+		prvt->tmp_dir_fd = -1;
+	}
 	free(prvt);
 	return;
 }
@@ -46,6 +53,9 @@ void rm_session_push_rx_free(struct rm_session_push_rx *prvt)
 void rm_session_push_tx_init(struct rm_session_push_tx *prvt, struct rm_core_options *opt)
 {
 	memset(prvt, 0, sizeof(struct rm_session_push_tx));
+	prvt->fd = -1;
+	prvt->fd_delta_tx = -1;
+	prvt->fd_ch_ch_rx = -1;
 	rm_session_push_local_init(&prvt->session_local, opt);
 	prvt->session_local.delta_rx_f = rm_rx_tx_delta_element;
 	memcpy(&prvt->opt, opt, sizeof(struct rm_core_options));
@@ -64,9 +74,12 @@ void rm_session_push_local_init(struct rm_session_push_local *prvt, struct rm_co
 {
 	memset(prvt, 0, sizeof(struct rm_session_push_local));
 	pthread_mutex_init(&prvt->h_mutex, NULL);
+	prvt->h_bits = RM_NONOVERLAPPING_HASH_BITS;
 	TWINIT_LIST_HEAD(&prvt->tx_delta_e_queue);
 	pthread_mutex_init(&prvt->tx_delta_e_queue_mutex, NULL);
 	pthread_cond_init(&prvt->tx_delta_e_queue_signal, NULL);
+	pthread_cond_init(&prvt->tx_delta_e_queue_space, NULL);
+	prvt->tx_delta_e_queue_limit = opt->delta_queue_bytes;
 	prvt->delta_rx_f = rm_rx_process_delta_element;
 	memcpy(&prvt->opt, opt, sizeof(struct rm_core_options));
 	return;
@@ -78,6 +91,7 @@ static void rm_session_push_local_deinit(struct rm_session_push_local *prvt)
 		RM_LOG_ERR("%s", "Delta elements queue NOT EMPTY!\n");
 	pthread_mutex_destroy(&prvt->tx_delta_e_queue_mutex);
 	pthread_cond_destroy(&prvt->tx_delta_e_queue_signal);
+	pthread_cond_destroy(&prvt->tx_delta_e_queue_space);
 }
 
 /* frees private session, DON'T TOUCH private session after this returns */ 
@@ -90,7 +104,7 @@ void rm_session_push_local_free(struct rm_session_push_local *prvt)
 
 enum rm_error rm_session_assign_validate_from_msg_push(struct rm_session *s, struct rm_msg_push *m, int fd)
 {
-	int fd_y = -1;
+	int fd_y = -1, fd_z = -1;
 	struct stat fs;
 	size_t y_sz = 0;
 	struct rm_session_push_rx   *push_rx = NULL;
@@ -111,6 +125,17 @@ enum rm_error rm_session_assign_validate_from_msg_push(struct rm_session *s, str
 			push_rx = s->prvt;
 			push_rx->msg_push = m;
 			push_rx->fd = fd;
+			if (rm_codec_supported(m->codec)) {											/* codec of literal payloads, ACK tells transmitter if it's accepted */
+				push_rx->codec = m->codec;
+				push_rx->codec_level = m->codec_level;
+			}
+			s->rec_ctx.codec = push_rx->codec;
+			s->rec_ctx.codec_level = push_rx->codec_level;
+			rm_roll_init(&push_rx->roll, (rm_roll_supported(m->roll) ? m->roll : RM_ROLL_FAST), m->roll_seed, m->L);	/* rolling checksum of fast checksums, ACK tells if it's accepted */
+			s->rec_ctx.roll = push_rx->roll.type;
+			s->rec_ctx.roll_seed = m->roll_seed;
+			push_rx->prefilter = (m->prefilter == RM_PREFILTER_CRC32C ? m->prefilter : RM_PREFILTER_NONE);	/* CRC32C of blocks is sent with checksums if accepted */
+			s->rec_ctx.prefilter = push_rx->prefilter;
 			s->f_x = NULL;
 			s->f_x_sz = push_rx->msg_push->bytes;										/* bytes to RX, size of file to receive */
 			if (m->y_sz > 0) {
@@ -158,21 +183,23 @@ enum rm_error rm_session_assign_validate_from_msg_push(struct rm_session *s, str
 			return RM_ERR_FAIL;
 	}
 
-	if (getcwd(s->pwd_init, PATH_MAX) == NULL)									/* get current working directory */
-		return RM_ERR_GETCWD;
-	if (m->z_sz > 0) {															/* result f_z will be ultimately renamed to @z (and @y will be deleted or maybe not if --leave flag is also set) */
-		if (chdir(s->f_z_dname) == -1)
-			return RM_ERR_CHDIR_Z;
-	} else {																	/* result f_z will be renamed to @y which doesn't exist yet */
-		if (chdir(s->f_y_dname) == -1)
-			return RM_ERR_CHDIR_Y;
-	}
+	if (push_rx == NULL)
+		return RM_ERR_FAIL;														/* PULL_RX: no @tmp yet */
+	push_rx->tmp_dir_fd = open(m->z_sz > 0 ? s->f_z_dname : s->f_y_dname, O_RDONLY | O_DIRECTORY);	/* @tmp is created in and renamed from result's directory, working directory is shared by all sessions */
+	if (push_rx->tmp_dir_fd == -1)
+		return (m->z_sz > 0 ? RM_ERR_CHDIR_Z : RM_ERR_CHDIR_Y);
 
 	/* @y exists and is opened for reading  (s->f_y != NULL), reference file exists or @y doesn;t exist but --force is set */
 	rm_get_unique_string(s->f_z_name);
-	s->f_z = fopen(s->f_z_name, "wb+");													/* open tmp file @f_z for reading and writing in @z path */
-	if (s->f_z == NULL)
+	fd_z = openat(push_rx->tmp_dir_fd, s->f_z_name, O_RDWR | O_CREAT | O_EXCL, 0666);
+	if (fd_z == -1)
 		return RM_ERR_OPEN_TMP;
+	s->f_z = fdopen(fd_z, "wb+");														/* open tmp file @f_z for reading and writing in @z path */
+	if (s->f_z == NULL) {
+		close(fd_z);
+		unlinkat(push_rx->tmp_dir_fd, s->f_z_name, 0);
+		return RM_ERR_OPEN_TMP;
+	}
 
 	return RM_ERR_OK;
 }
@@ -232,6 +259,7 @@ struct rm_session *rm_session_create(enum rm_session_type t, struct rm_core_opti
 	}
 	clock_gettime(CLOCK_REALTIME, &s->clk_realtime_start);
 	s->clk_cputime_start = clock() / CLOCKS_PER_SEC;
+	clock_gettime(CLOCK_MONOTONIC, &s->progress.clk_start);
 	uuid_generate(uuid);
 	memcpy(&s->id, &uuid, rm_min(sizeof(uuid_t), RM_UUID_LEN));
 
@@ -277,83 +305,6 @@ end:
 	return;
 }
 
-/* in PUSH RX: TX checksums to transmitter of file */
-void *rm_session_ch_ch_tx_f(void *arg)
-{
-	enum rm_error                   err = RM_ERR_OK;
-	struct rm_session               *s = (struct rm_session *) arg;
-	enum rm_session_type            s_type = 0;
-	struct rm_session_push_rx       *rm_push_rx = NULL;
-	struct rm_session_pull_rx       *rm_pull_rx = NULL;
-	struct rm_msg_push              *msg_push = NULL;
-	size_t                          L = 0;
-	FILE                            *f_y = NULL;   /* file for taking non-overlapping blocks */
-	int                             fd_y = -1;
-	struct stat                     fs = {0};
-	size_t                          y_sz = 0, blocks_n_exp = 0, blocks_n = 0;
-	int                             fd = -1;
-	uint8_t							loglevel = RM_LOGLEVEL_NORMAL;
-
-	//TWDEFINE_HASHTABLE(h, RM_NONOVERLAPPING_HASH_BITS);
-	//twhash_init(h);
-
-	s_type = s->type;
-
-	switch (s_type) {
-		case RM_PUSH_RX:
-			rm_push_rx = (struct rm_session_push_rx*) s->prvt;
-			if (rm_push_rx == NULL) {
-				err = RM_ERR_RX;
-				goto done;
-			}
-			msg_push = rm_push_rx->msg_push;
-			loglevel = rm_push_rx->opt.loglevel;
-			fd = rm_push_rx->fd;																				/* TODO use separate socket for checksums TX? (ch_ch_port in receiver?) */
-			L = rm_push_rx->msg_push->L;
-			f_y = s->f_y;
-			if (f_y != NULL) {                                                                                  /* if reference file exists, split it and calc checksums */
-				fd_y = fileno(f_y);
-				memset(&fs, 0, sizeof(fs));
-				if (fstat(fd_y, &fs) != 0) {
-					err = RM_ERR_FSTAT_Y;
-					goto done;
-				}
-				y_sz = fs.st_size;
-
-				blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0);                                                   /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-				if (rm_rx_insert_nonoverlapping_ch_ch_ref(fd, f_y, msg_push->y, NULL, L, rm_tcp_tx_ch_ch, blocks_n_exp, &blocks_n, &s->y_file_mutex) != RM_ERR_OK) {  /* tx ch_ch only, no ref */
-					err = RM_ERR_NONOVERLAPPING_INSERT;
-					goto  done;
-				}
-				assert(blocks_n == blocks_n_exp && "rm_do_msg_push_rx ASSERTION failed  indicating ERROR in blocks count either here or in rm_rx_insert_nonoverlapping_ch_ch_ref");
-				if (loglevel > RM_LOGLEVEL_NORMAL)
-					RM_LOG_INFO("[%s] -> [%s], [%u]: TX-ed [%zu] nonoverlapping checksum elements", s->ssid1, s->ssid2, s->hashed_hash, blocks_n_exp);
-			} else {
-				goto done;																						/* no checkums to TX */
-			}
-			break;
-
-		case RM_PULL_RX:
-			rm_pull_rx = (struct rm_session_pull_rx*) s->prvt;
-			if (rm_pull_rx == NULL) {
-				err = RM_ERR_RX;
-				goto done;
-			}
-			fd = rm_pull_rx->fd;
-			break;
-
-		default:
-			err = RM_ERR_ARG;
-			break;
-	}
-
-done:
-	pthread_mutex_lock(&s->mutex);
-	rm_push_rx->ch_ch_tx_status = err;																			/* set session's status error */
-	pthread_mutex_unlock(&s->mutex);
-	return NULL;
-}
-
 /* in PUSH TX: RX nonoverlapping checksums and insert into hashtable */
 void *rm_session_ch_ch_rx_f(void *arg)
 {
@@ -368,12 +319,17 @@ void *rm_session_ch_ch_rx_f(void *arg)
 	pthread_mutex_t				*h_mutex = NULL;
 	enum rm_rx_status			status = RM_RX_STATUS_OK;
 	uint8_t						loglevel = RM_LOGLEVEL_NORMAL;
+	struct rm_tcp_chan			chan = {0};
+	uint8_t						h_bits = 0;
+	struct rm_spill				*spill = NULL;
 
 
 	struct rm_session *s = (struct rm_session *) arg;
 	prvt = s->prvt;
 	ack = prvt->msg_push_ack;
 	h = prvt->session_local.h;
+	h_bits = prvt->session_local.h_bits;
+	spill = prvt->session_local.spill;
 	h_mutex = &prvt->session_local.h_mutex;
 	loglevel = prvt->opt.loglevel;
 
@@ -381,23 +337,29 @@ void *rm_session_ch_ch_rx_f(void *arg)
 	ch_ch_n = ack->ch_ch_n;
 	if (ch_ch_n == 0)
 		goto done;
+	if (rm_tcp_chan_init(&chan, fd, RM_TCP_CHAN_CH_CH, ack->delta_port == 0) != RM_ERR_OK) {	/* no delta port: receiver sends framed checksums */
+		status = RM_RX_STATUS_CH_CH_RX_MEM;
+		goto err_exit;
+	}
 
 	while (ch_ch_n > 0) {
-		e = malloc(sizeof(struct rm_ch_ch_ref_hlink));
-		if (e == NULL) {
-			status = RM_RX_STATUS_CH_CH_RX_MEM;
-			goto err_exit;
+		if (e == NULL) {																/* spill reuses entry */
+			e = malloc(sizeof(struct rm_ch_ch_ref_hlink));
+			if (e == NULL) {
+				status = RM_RX_STATUS_CH_CH_RX_MEM;
+				goto err_exit;
+			}
 		}
 
 		uint32_t f_ch = 0;
-		err = rm_tcp_rx(fd, &f_ch, sizeof(f_ch));
+		err = rm_tcp_chan_rx(&chan, &f_ch, sizeof(f_ch));
 		if (err != RM_ERR_OK) {
 			status = RM_RX_STATUS_CH_CH_RX_TCP_FAIL;
 			goto err_exit;
 		}
 		rm_deserialize_u32((unsigned char *) &f_ch, &e->data.ch_ch.f_ch);
 
-		err = rm_tcp_rx(fd, &e->data.ch_ch.s_ch, RM_STRONG_CHECK_BYTES);
+		err = rm_tcp_chan_rx(&chan, &e->data.ch_ch.s_ch, RM_STRONG_CHECK_BYTES);
 		if (err != RM_ERR_OK) {
 			if (err == RM_ERR_READ)
 				status = RM_RX_STATUS_CH_CH_RX_TCP_DISCONNECT;
@@ -405,28 +367,54 @@ void *rm_session_ch_ch_rx_f(void *arg)
 				status = RM_RX_STATUS_CH_CH_RX_TCP_FAIL;
 			goto err_exit;
 		}
+		e->data.ch_ch.c_ch = 0;
+		if (ack->prefilter == RM_PREFILTER_CRC32C) {										/* CRC32C of block follows */
+			uint32_t c_ch = 0;
+			err = rm_tcp_chan_rx(&chan, &c_ch, sizeof(c_ch));
+			if (err != RM_ERR_OK) {
+				status = RM_RX_STATUS_CH_CH_RX_TCP_FAIL;
+				goto err_exit;
+			}
+			rm_deserialize_u32((unsigned char *) &c_ch, &e->data.ch_ch.c_ch);
+		}
 
 		if (loglevel >= RM_LOGLEVEL_THREADS)
 			RM_LOG_INFO("[RX]: checksum [%u]", e->data.ch_ch.f_ch);
 
 		e->data.ref = entries_n;														/* assign offset */
-		TWINIT_HLIST_NODE(&e->hlink);
-
-		pthread_mutex_lock(h_mutex); /* TODO Verify hashtable locking needs for rm_rolling_ch_proc <-> rm_session_ch_ch_rx_f */
-		twhash_add_bits(h, &e->hlink, e->data.ch_ch.f_ch, RM_NONOVERLAPPING_HASH_BITS);	/* insert into hashtable, hashing fast checksum */
-		pthread_mutex_unlock(h_mutex);
+		if (spill != NULL) {
+			if (rm_spill_add(spill, &e->data) != RM_ERR_OK) {
+				status = RM_RX_STATUS_CH_CH_RX_SPILL;
+				goto err_exit;
+			}
+		} else {
+			TWINIT_HLIST_NODE(&e->hlink);
+			pthread_mutex_lock(h_mutex); /* TODO Verify hashtable locking needs for rm_rolling_ch_proc <-> rm_session_ch_ch_rx_f */
+			twhash_add_bits(h, &e->hlink, e->data.ch_ch.f_ch, h_bits);				/* insert into hashtable, hashing fast checksum */
+			pthread_mutex_unlock(h_mutex);
+			e = NULL;
+		}
 
 		entries_n++;
 		ch_ch_n--;
 	}
+	free(e);
+	e = NULL;
+	if (spill != NULL && rm_spill_finish(spill) != RM_ERR_OK) {						/* sort spilled checksums before rolling starts */
+		status = RM_RX_STATUS_CH_CH_RX_SPILL;
+		goto err_exit;
+	}
 
 done:
+	rm_tcp_chan_free(&chan);
 	pthread_mutex_lock(&s->mutex);
 	prvt->ch_ch_rx_status = RM_RX_STATUS_OK;
 	pthread_mutex_unlock(&s->mutex);
 	return NULL; /* this thread must be created in joinable state */
 
 err_exit:
+	free(e);
+	rm_tcp_chan_free(&chan);
 	pthread_mutex_lock(&s->mutex);
 	prvt->ch_ch_rx_status = status;
 	pthread_mutex_unlock(&s->mutex);
@@ -437,6 +425,7 @@ err_exit:
 void *rm_session_delta_tx_f(void *arg)
 {
 	struct twhlist_head     *h;             /* nonoverlapping checkums */
+	uint8_t                 h_bits = 0;
 	FILE                    *f_x;           /* file on which rolling is performed */
 	rm_delta_f              *delta_tx_f;    /* tx/reconstruct callback */
 	struct rm_session       *s;
@@ -459,6 +448,7 @@ void *rm_session_delta_tx_f(void *arg)
 			if (prvt_local == NULL)
 				goto exit;
 			h       = prvt_local->h;
+			h_bits  = prvt_local->h_bits;
 			delta_tx_f = prvt_local->delta_tx_f;
 			break;
 
@@ -467,6 +457,7 @@ void *rm_session_delta_tx_f(void *arg)
 			if (prvt_tx == NULL)
 				goto exit;
 			h       = prvt_tx->session_local.h;
+			h_bits  = prvt_tx->session_local.h_bits;
 			h_mutex = &prvt_tx->session_local.h_mutex;
 			delta_tx_f = prvt_tx->session_local.delta_tx_f;
 			break;
@@ -476,7 +467,7 @@ void *rm_session_delta_tx_f(void *arg)
 	}
 	pthread_mutex_unlock(&s->mutex);
 //sleep(5);
-	err = rm_rolling_ch_proc(s, h, h_mutex, f_x, delta_tx_f, 0); /* 1. run rolling checksum procedure */
+	err = rm_rolling_ch_proc(s, h, h_bits, h_mutex, f_x, delta_tx_f, 0); /* 1. run rolling checksum procedure */
 	if (err != RM_ERR_OK)
 		status = RM_TX_STATUS_ROLLING_PROC_FAIL; /* TODO switch err to return more descriptive errors from here to delta tx thread's status */
 
@@ -484,14 +475,40 @@ void *rm_session_delta_tx_f(void *arg)
 	if (t == RM_PUSH_LOCAL) {
 		prvt_local->delta_tx_status = status;
 	} else {
+		prvt_local = &prvt_tx->session_local;
 		prvt_tx->session_local.delta_tx_status = status; /* remote push, local session part */
 	}
+	pthread_mutex_unlock(&s->mutex);
+
+	pthread_mutex_lock(&prvt_local->tx_delta_e_queue_mutex);	/* tell delta rx thread no more elements will come and @x digest is ready */
+	prvt_local->delta_tx_done = 1;
+	pthread_cond_signal(&prvt_local->tx_delta_e_queue_signal);
+	pthread_mutex_unlock(&prvt_local->tx_delta_e_queue_mutex);
+	return NULL; /* this thread must be created in joinable state */
 
 exit:
 	pthread_mutex_unlock(&s->mutex);
 	return NULL; /* this thread must be created in joinable state */
 }
 
+void rm_session_delta_queue_close(struct rm_session_push_local *prvt_local)
+{
+	struct twlist_head      *lh = NULL;
+	struct rm_delta_e       *delta_e = NULL;
+
+	pthread_mutex_lock(&prvt_local->tx_delta_e_queue_mutex);
+	prvt_local->tx_delta_e_queue_closed = 1;
+	for (twfifo_dequeue(&prvt_local->tx_delta_e_queue, lh); lh != NULL; twfifo_dequeue(&prvt_local->tx_delta_e_queue, lh)) {
+		delta_e = tw_container_of(lh, struct rm_delta_e, link);
+		if (delta_e->type == RM_DELTA_ELEMENT_RAW_BYTES)
+			free(delta_e->raw_bytes);
+		free(delta_e);
+	}
+	prvt_local->tx_delta_e_queue_bytes = 0;
+	pthread_cond_broadcast(&prvt_local->tx_delta_e_queue_space);
+	pthread_mutex_unlock(&prvt_local->tx_delta_e_queue_mutex);
+}
+
 /* in PUSH TX: dequeue delta elements and TX them to receiver of file */
 void *rm_session_delta_rx_f_local(void *arg)
 {
@@ -513,6 +530,15 @@ void *rm_session_delta_rx_f_local(void *arg)
 	struct rm_msg_push_ack			*ack = NULL;
 	enum rm_error					res = RM_ERR_OK;
 	const char						*err_str = NULL;
+	MD5_CTX							z_md5;
+	struct rm_md5					x_digest = {{0}};
+	enum rm_tx_status				tx_status = RM_TX_STATUS_OK;
+	enum rm_integrity_status		integrity = RM_INTEGRITY_NOT_CHECKED;
+	struct rm_tcp_chan				chan = {0};
+	struct rm_codec					codec = {0};	/* compressor of literal payloads (RM_PUSH_TX) */
+	struct rm_prof					prof = {0};		/* consumer's stages, added to those of rolling proc when done */
+	struct timespec					prof_lap = {0};
+	struct rm_zout					z_out = {0};	/* @f_z is written through it (RM_PUSH_LOCAL) */
 
 	uint16_t	timeout_s = 10;							/* TODO get timeouts from the user */
 	uint16_t	timeout_us = 0;
@@ -566,28 +592,47 @@ void *rm_session_delta_rx_f_local(void *arg)
 		q_signal = &prvt_tx->session_local.tx_delta_e_queue_signal;
 		loglevel = prvt_tx->opt.loglevel;
 
-		struct sockaddr peer_addr;
-		socklen_t addrlen = sizeof(peer_addr);
-		if (getpeername(prvt_tx->fd, &peer_addr, &addrlen) == -1) {
-			pthread_mutex_unlock(&s->mutex);
-			status = RM_ERR_GETPEERNAME;
-			goto err_exit;
+		if (ack->delta_port == 0) {													/* no delta port: deltas follow on the control connection as framed channel */
+			res = rm_tcp_chan_init(&chan, prvt_tx->fd, RM_TCP_CHAN_DELTA, 1);
+		} else {
+			struct sockaddr peer_addr;
+			socklen_t addrlen = sizeof(peer_addr);
+			if (getpeername(prvt_tx->fd, &peer_addr, &addrlen) == -1) {
+				pthread_mutex_unlock(&s->mutex);
+				status = RM_ERR_GETPEERNAME;
+				goto err_exit;
+			}
+			((struct sockaddr_in*)&peer_addr)->sin_port = htons(ack->delta_port);		/* use receiver's delta port from ACK */
+			res = rm_tcp_connect_nonblock_timeout_sockaddr(&prvt_tx->fd_delta_tx, &peer_addr, timeout_s, timeout_us, &err_str);
+			if (res != RM_ERR_OK) {
+				pthread_mutex_unlock(&s->mutex);
+				if (res == RM_ERR_CONNECT_TIMEOUT)
+					status = RM_RX_STATUS_CONNECT_TIMEOUT;
+				else if (res == RM_ERR_CONNECT_REFUSED)
+					status = RM_RX_STATUS_CONNECT_REFUSED;
+				else if (res == RM_ERR_CONNECT_HOSTUNREACH)
+					status = RM_RX_STATUS_CONNECT_HOSTUNREACH;
+				else
+					status = RM_RX_STATUS_CONNECT_GEN_ERR;
+				goto err_exit;
+			}
+			res = rm_tcp_chan_init(&chan, prvt_tx->fd_delta_tx, RM_TCP_CHAN_DELTA, 0);	/* plain stream on dedicated connection */
 		}
-		((struct sockaddr_in*)&peer_addr)->sin_port = htons(ack->delta_port);		/* use receiver's delta port from ACK */
-		res = rm_tcp_connect_nonblock_timeout_sockaddr(&prvt_tx->fd_delta_tx, &peer_addr, timeout_s, timeout_us, &err_str);
 		if (res != RM_ERR_OK) {
 			pthread_mutex_unlock(&s->mutex);
-			if (res == RM_ERR_CONNECT_TIMEOUT)
-				status = RM_RX_STATUS_CONNECT_TIMEOUT;
-			else if (res == RM_ERR_CONNECT_REFUSED)
-				status = RM_RX_STATUS_CONNECT_REFUSED;
-			else if (res == RM_ERR_CONNECT_HOSTUNREACH)
-				status = RM_RX_STATUS_CONNECT_HOSTUNREACH;
-			else
-				status = RM_RX_STATUS_CONNECT_GEN_ERR;
+			status = RM_RX_STATUS_INTERNAL_ERR;
 			goto err_exit;
 		}
-		delta_pack.fd = prvt_tx->fd_delta_tx;										/* tell delta_rx_f callback about new delta channel */ 											
+		delta_pack.chan = &chan;													/* tell delta_rx_f callback about delta channel */
+		delta_pack.f_x = s->f_x;													/* literal ranges are sent from it */
+		if (ack->codec != RM_CODEC_NONE) {											/* receiver accepted compression of literal payloads */
+			if (rm_codec_init(&codec, ack->codec, ack->codec_level, 1, fileno(s->f_x)) != RM_ERR_OK) {
+				pthread_mutex_unlock(&s->mutex);
+				status = RM_RX_STATUS_INTERNAL_ERR;
+				goto err_exit;
+			}
+			delta_pack.codec = &codec;
+		}
 	}
 	assert(((prvt_local != NULL) && (prvt_tx != NULL)) ^ ((prvt_local != NULL) && (prvt_tx == NULL)));
 	pthread_mutex_unlock(&s->mutex);
@@ -605,41 +650,79 @@ void *rm_session_delta_rx_f_local(void *arg)
 	delta_pack.f_y = f_y;
 	delta_pack.f_z = f_z;
 	delta_pack.rec_ctx = &rec_ctx;
+	md5_init(&z_md5);
+	if (s->type == RM_PUSH_LOCAL) {
+		delta_pack.z_md5 = &z_md5;													/* reconstruction feeds digest of @z */
+		if (rm_zout_init(&z_out, fileno(f_z), bytes_to_rx, 0) != RM_ERR_OK) {
+			status = RM_RX_STATUS_INTERNAL_ERR;
+			goto err_exit;
+		}
+		delta_pack.z_out = &z_out;
+	}
 
 	pthread_mutex_lock(q_mutex); /* sleep on delta queue and reconstruct element once awoken */
 
 	while (bytes_to_rx > 0) {
-		if (bytes_to_rx == 0) { /* checking for missing signal is not really needed here, as bytes_to_rx is local variable, nevertheless... */
-			pthread_mutex_unlock(q_mutex);
-			goto done;
-		}
-		/* process delta element */
-		for (twfifo_dequeue(q, lh); lh != NULL; twfifo_dequeue(q, lh)) { /* in case of local sync there can be only single element enqueued each time conditional variable is signaled, but in other cases it will be possible to be different most likely */
-			delta_e = tw_container_of(lh, struct rm_delta_e, link);
-			//err = rm_rx_process_delta_element(delta_e, f_y, f_z, &rec_ctx);
-			delta_pack.delta_e = delta_e;
-
-			err = prvt_local->delta_rx_f(&delta_pack);								/* reconstruct or TX */
-			if (err != 0) {
+		twfifo_dequeue(q, lh);
+		if (lh == NULL) {
+			if (prvt_local->delta_tx_done) {										/* rolling proc returned but not all bytes have been addressed */
 				pthread_mutex_unlock(q_mutex);
 				status = RM_RX_STATUS_DELTA_PROC_FAIL;
 				goto err_exit;
 			}
-
-			if (loglevel >= RM_LOGLEVEL_THREADS)
-				RM_LOG_INFO("[TX]: delta type[%u]", delta_e->type);
-
-			bytes_to_rx -= delta_e->raw_bytes_n;
-			if (delta_e->type == RM_DELTA_ELEMENT_RAW_BYTES) {
-				free(delta_e->raw_bytes);
-			}
-			free((void*)delta_e);
-		}
-		if (bytes_to_rx > 0) {
 			pthread_cond_wait(q_signal, q_mutex);
+			continue;
 		}
+		delta_e = tw_container_of(lh, struct rm_delta_e, link);
+		prvt_local->tx_delta_e_queue_bytes -= rm_delta_e_queue_charge(delta_e);
+		pthread_cond_signal(&prvt_local->tx_delta_e_queue_space);					/* rolling proc may be waiting for space */
+		pthread_mutex_unlock(q_mutex);												/* process element without holding the queue, so rolling proc can go on */
+
+		delta_pack.delta_e = delta_e;
+		RM_PROF_LAP_START(&prof_lap);
+		err = prvt_local->delta_rx_f(&delta_pack);									/* reconstruct or TX */
+		RM_PROF_LAP(&prof, (s->type == RM_PUSH_LOCAL ? RM_PROF_REC : RM_PROF_TX), &prof_lap);
+		if (loglevel >= RM_LOGLEVEL_THREADS)
+			RM_LOG_INFO("[TX]: delta type[%u]", delta_e->type);
+		bytes_to_rx -= delta_e->raw_bytes_n;
+		if (delta_e->type == RM_DELTA_ELEMENT_RAW_BYTES) {
+			free(delta_e->raw_bytes);
+		}
+		free((void*)delta_e);
+		if (err != 0) {
+			status = RM_RX_STATUS_DELTA_PROC_FAIL;
+			goto err_exit;
+		}
+		pthread_mutex_lock(q_mutex);
 	}
+	while (prvt_local->delta_tx_done == 0)											/* wait for digest of @x */
+		pthread_cond_wait(q_signal, q_mutex);
+	rec_ctx.delta_queue_limit = prvt_local->tx_delta_e_queue_limit;
+	rec_ctx.delta_queue_bytes_peak = prvt_local->tx_delta_e_queue_bytes_peak;
+	rec_ctx.delta_queue_stalls_n = prvt_local->tx_delta_e_queue_stalls_n;
+	rec_ctx.delta_queue_stall_time = prvt_local->tx_delta_e_queue_stall_time;
 	pthread_mutex_unlock(&prvt_local->tx_delta_e_queue_mutex);
+	if (z_out.buf != NULL && rm_zout_flush(&z_out) != RM_ERR_OK) {
+		status = RM_RX_STATUS_DELTA_PROC_FAIL;
+		goto err_exit;
+	}
+
+	pthread_mutex_lock(&s->mutex);
+	tx_status = prvt_local->delta_tx_status;
+	memcpy(&x_digest, &s->rec_ctx.x_digest, sizeof(struct rm_md5));
+	pthread_mutex_unlock(&s->mutex);
+	if (tx_status == RM_TX_STATUS_OK) {
+		if (s->type == RM_PUSH_LOCAL) {
+			md5_final(&z_md5, rec_ctx.z_digest.data);
+			integrity = (memcmp(x_digest.data, rec_ctx.z_digest.data, RM_STRONG_CHECK_BYTES) == 0) ? RM_INTEGRITY_OK : RM_INTEGRITY_MISMATCH;
+		} else {
+			if (rm_tcp_chan_tx(&chan, x_digest.data, RM_STRONG_CHECK_BYTES) != RM_ERR_OK || rm_tcp_chan_flush(&chan) != RM_ERR_OK) {	/* digest follows delta stream */
+				status = RM_RX_STATUS_DIGEST_TX_FAIL;
+				goto err_exit;
+			}
+			integrity = RM_INTEGRITY_SENT;
+		}
+	}
 
 done:
 	pthread_mutex_lock(&s->mutex);
@@ -648,12 +731,33 @@ done:
 		assert(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
 		rec_ctx.collisions_1st_level = s->rec_ctx.collisions_1st_level; /* tx thread might have assigned to collisions variables already and memcpy would overwrite them */
 		rec_ctx.collisions_2nd_level = s->rec_ctx.collisions_2nd_level;
+		rec_ctx.next_tried_n = s->rec_ctx.next_tried_n;
+		rec_ctx.next_hit_n = s->rec_ctx.next_hit_n;
+		rec_ctx.prefilter_pass_n = s->rec_ctx.prefilter_pass_n;
+		rec_ctx.prefilter_reject_n = s->rec_ctx.prefilter_reject_n;
 		rec_ctx.copy_all_threshold_fired = s->rec_ctx.copy_all_threshold_fired; /* tx thread might have assigned to threshold_fired variables already and memcpy would overwrite them */
 		rec_ctx.copy_tail_threshold_fired = s->rec_ctx.copy_tail_threshold_fired;
+		rec_ctx.prof = s->rec_ctx.prof;							/* stages of tx thread */
+		rm_prof_add(&rec_ctx.prof, &prof);
+		rec_ctx.x_digest = x_digest;
+		rec_ctx.integrity = integrity;
 		memcpy(&s->rec_ctx, &rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));
 		prvt_local->delta_rx_status = RM_RX_STATUS_OK;
+		rm_zout_free(&z_out);
 	} else {															/* RM_PUSH_TX */
+		s->rec_ctx.integrity = integrity;
+		s->rec_ctx.delta_queue_limit = rec_ctx.delta_queue_limit;
+		s->rec_ctx.delta_queue_bytes_peak = rec_ctx.delta_queue_bytes_peak;
+		s->rec_ctx.delta_queue_stalls_n = rec_ctx.delta_queue_stalls_n;
+		s->rec_ctx.delta_queue_stall_time = rec_ctx.delta_queue_stall_time;
+		s->rec_ctx.codec = ack->codec;
+		s->rec_ctx.codec_level = ack->codec_level;
+		s->rec_ctx.rec_by_raw_z = rec_ctx.rec_by_raw_z;
+		s->rec_ctx.rec_by_raw_stored = rec_ctx.rec_by_raw_stored;
+		rm_prof_add(&s->rec_ctx.prof, &prof);
 		prvt_tx->session_local.delta_rx_status = RM_RX_STATUS_OK;
+		rm_codec_free(&codec);
+		rm_tcp_chan_free(&chan);
 		if (prvt_tx->fd_delta_tx != -1) {
 			close(prvt_tx->fd_delta_tx);
 			prvt_tx->fd_delta_tx = -1;
@@ -663,11 +767,18 @@ done:
 	return NULL; /* this thread must be created in joinable state */
 
 err_exit:
+	if (prvt_local != NULL)
+		rm_session_delta_queue_close(prvt_local);						/* rolling proc must not wait for us anymore */
+	if (s == NULL)
+		return NULL;
 	pthread_mutex_lock(&s->mutex);
-	if (s->type == RM_PUSH_LOCAL)
+	if (s->type == RM_PUSH_LOCAL) {
 		prvt_local->delta_rx_status = status;
-	else {
+		rm_zout_free(&z_out);
+	} else {
 		prvt_tx->session_local.delta_rx_status = status;
+		rm_codec_free(&codec);
+		rm_tcp_chan_free(&chan);
 		if (prvt_tx->fd_delta_tx != -1) {
 			close(prvt_tx->fd_delta_tx);
 			prvt_tx->fd_delta_tx = -1;
@@ -677,210 +788,743 @@ err_exit:
 	return NULL; /* this thread must be created in joinable state */
 }
 
-void* rm_session_delta_rx_f_remote(void *arg)
+/* Publish progress of delta reconstruction for metrics, caller holds session's mutex. */
+static void rm_session_progress_delta(struct rm_session *s, uint64_t bytes_rx, const struct rm_delta_reconstruct_ctx *rec_ctx)
 {
-	FILE                            *f_y = NULL;		/* file on which reconstruction is performed */
-	FILE                            *f_z = NULL;		/* result file */
-	pthread_mutex_t					*file_mutex = NULL;
-	struct rm_session_push_rx       *prvt_rx = NULL;
-	rm_push_flags					push_flags = 0;
-	int								listen_fd = -1, fd = -1;
-	size_t                          bytes_to_rx = 0, y_sz = 0;
-	struct rm_session               *s = NULL;
-	struct rm_rx_delta_element_arg delta_pack = {0};
-	struct rm_delta_reconstruct_ctx rec_ctx = {0};		/* describes result of reconstruction, we will copy this to session reconstruct context after all is done to avoid locking on each delta element */
-	enum rm_error					err = RM_ERR_OK;
-	enum rm_rx_status				status = RM_RX_STATUS_OK;
-
-	struct timespec					real_time = {0};
-	double							cpu_time = 0.0;
-
-	uint8_t							loglevel = RM_LOGLEVEL_NORMAL;
-
-	struct sockaddr_storage cli_addr = {0};
-	socklen_t               cli_len = 0;
-
-	s = (struct rm_session*) arg;
-	if (s == NULL) {
-		goto err_exit;
-	}
-	assert(s != NULL);
+	s->progress.bytes_rx = bytes_rx;
+	s->progress.deltas_n = rec_ctx->delta_ref_n + rec_ctx->delta_raw_n + rec_ctx->delta_tail_n + rec_ctx->delta_zero_diff_n;
+	s->progress.rec_by_ref = rec_ctx->rec_by_ref;
+	s->progress.rec_by_raw = rec_ctx->rec_by_raw;
+}
 
-	pthread_mutex_lock(&s->mutex);
+enum rm_session_push_rx_stage
+{
+	RM_PUSH_RX_STAGE_CH_CH_TX,					/* tx nonoverlapping checksums of @y */
+	RM_PUSH_RX_STAGE_DELTA_ACCEPT,				/* wait for transmitter's connection on delta port (legacy delta mode) */
+	RM_PUSH_RX_STAGE_DELTA_RX					/* rx delta elements and digest of @x, reconstruct @z */
+};
 
-	if (s->type != RM_PUSH_RX) {
-		pthread_mutex_unlock(&s->mutex);
-		goto err_exit;
-	}
-	prvt_rx = s->prvt;
-	if (prvt_rx == NULL) {
-		pthread_mutex_unlock(&s->mutex);
-		goto err_exit;
+enum rm_session_push_rx_field
+{
+	RM_PUSH_RX_FIELD_TYPE,
+	RM_PUSH_RX_FIELD_REF,
+	RM_PUSH_RX_FIELD_RAW_LEN,
+	RM_PUSH_RX_FIELD_RAW,
+	RM_PUSH_RX_FIELD_RAW_Z_LEN,					/* with codec: size of compressed payload, 0 if stored */
+	RM_PUSH_RX_FIELD_RAW_Z,
+	RM_PUSH_RX_FIELD_DIGEST,
+	RM_PUSH_RX_FIELD_END
+};
+
+/* Receiver of file (delta vector) in daemon, as a task of session executor.
+ * Does the job of checksums tx and delta rx threads in steps that never block
+ * on the socket, so session doesn't need threads of its own. */
+struct rm_session_push_rx_task
+{
+	struct rm_exec_task				task;				/* must be first */
+	struct rm_session				*s;
+	enum rm_session_push_rx_stage	stage;
+	uint8_t							framed;				/* deltas come in frames on control connection, otherwise plain on accepted delta connection */
+	int								delta_fd;			/* accepted delta connection */
+
+	size_t							L;
+	size_t							y_sz;
+	size_t							blocks_n;			/* checksums computed so far */
+	size_t							blocks_n_exp;
+	unsigned char					*block;				/* up to RM_MD5_LANES blocks of @y */
+
+	unsigned char					*buf;				/* checksums frame being sent or bytes received */
+	size_t							frame_n;			/* checksum bytes in frame being filled */
+	size_t							buf_len;
+	size_t							buf_pos;
+
+	unsigned char					frame_hdr[RM_TCP_FRAME_HDR_LEN];	/* header of delta frame being received */
+	size_t							frame_hdr_n;
+	size_t							frame_left;			/* payload bytes of current frame not parsed yet */
+
+	enum rm_session_push_rx_field	field;				/* field of delta stream being received */
+	unsigned char					acc[RM_STRONG_CHECK_BYTES];	/* field bytes received so far */
+	size_t							acc_need;
+	size_t							acc_n;
+	size_t							raw_left;			/* raw bytes of current element not written yet */
+	size_t							z_left;				/* compressed bytes of current element not received yet */
+	struct rm_codec					codec;				/* decompressor of literal payloads */
+	struct rm_zout					z_out;				/* @z is written through it */
+	struct rm_tcp_file_rx			raw_rx;				/* stored literals on dedicated delta connection are spliced to @z */
+	uint8_t							digest;				/* digest of @x follows delta stream */
+
+	size_t							bytes_to_rx;
+	uint64_t						bytes_rx;			/* bytes of delta stream received (frame headers excluded) */
+	struct rm_delta_e				delta_e;
+	struct rm_rx_delta_element_arg	delta_pack;
+	struct rm_delta_reconstruct_ctx	rec_ctx;
+	MD5_CTX							z_md5;
+
+	enum rm_tx_status				ch_ch_tx_status;
+	enum rm_rx_status				delta_rx_status;
+	void (*f_done)(struct rm_session *s, void *arg);	/* called once task is done, statuses and rec_ctx are in session */
+	void							*arg;
+};
+
+static enum rm_exec_wait rm_session_push_rx_task_delta_rx(struct rm_session_push_rx_task *t);
+
+/* All checksums are out, wait for deltas. */
+static enum rm_exec_wait rm_session_push_rx_task_delta_start(struct rm_session_push_rx_task *t)
+{
+	struct rm_session_push_rx	*prvt = t->s->prvt;
+
+	free(t->block);
+	t->block = NULL;
+	t->buf_len = 0;
+	t->buf_pos = 0;
+	if (t->framed == 0) {
+		t->stage = RM_PUSH_RX_STAGE_DELTA_ACCEPT;
+		t->task.fd = prvt->delta_fd;
+		return RM_EXEC_WAIT_IN;
 	}
-	assert(prvt_rx != NULL);
-	push_flags	= (rm_push_flags) prvt_rx->msg_push->hdr->flags;
-	bytes_to_rx = prvt_rx->msg_push->bytes;
-	f_y         = s->f_y;
-	y_sz		= s->f_y_sz;
-	f_z			= s->f_z;
-	listen_fd	= prvt_rx->delta_fd;
-	memcpy(&rec_ctx, &s->rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));													/* init reconstruction context (L set in assign_validate() */
-	file_mutex	= &s->y_file_mutex;
-	loglevel = prvt_rx->opt.loglevel;
-
-	pthread_mutex_unlock(&s->mutex);
+	t->stage = RM_PUSH_RX_STAGE_DELTA_RX;
+	if (t->bytes_to_rx == 0)
+		return RM_EXEC_DONE;
+	return RM_EXEC_WAIT_IN;
+}
 
-	if (f_y == NULL) {
-		assert((push_flags & RM_BIT_4) && (f_z != NULL));																	/* assert force creation if @y doesn't exist? */
-		if (!(push_flags & RM_BIT_4) || (f_z == NULL)) {
-			err = RM_ERR_BAD_CALL;
-			goto err_exit;
+/* TX nonoverlapping checksums of @y, frame by frame (same wire format as rm_tcp_chan_tx_ch_ch or rm_tcp_chan_tx_ch_ch_c).
+ * Frames are sent full, as rm_tcp_chan does, step running out of budget
+ * leaves frame being filled for the next one (partial writes would be held
+ * back by Nagle until peer's delayed ACK). */
+static enum rm_exec_wait rm_session_push_rx_task_ch_ch_tx(struct rm_session_push_rx_task *t)
+{
+	struct rm_session	*s = t->s;
+	const struct rm_roll	*roll = &((struct rm_session_push_rx*) s->prvt)->roll;
+	uint8_t				prefilter = ((struct rm_session_push_rx*) s->prvt)->prefilter;
+	unsigned char		*payload = NULL, *p = NULL;
+	size_t				budget = 0, read_now = 0, frame_max = 0, rec_len = 0, lanes_max = 0, lanes_n = 0, off = 0;
+	const unsigned char	*data[RM_MD5_LANES];
+	size_t				len[RM_MD5_LANES];
+	unsigned char		*s_ch[RM_MD5_LANES];
+	ssize_t				written = 0;
+
+	payload = t->buf + (t->framed ? RM_TCP_FRAME_HDR_LEN : 0);
+	rec_len = (prefilter == RM_PREFILTER_CRC32C ? RM_CH_CH_PREFILTER_SIZE : RM_CH_CH_SIZE);
+	frame_max = (RM_TCP_FRAME_LEN_MAX / rec_len) * rec_len;
+	while (1) {
+		if (t->buf_pos < t->buf_len) {															/* send what has been prepared */
+			written = write(t->task.fd, t->buf + t->buf_pos, t->buf_len - t->buf_pos);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return RM_EXEC_WAIT_OUT;
+				t->ch_ch_tx_status = (enum rm_tx_status) RM_ERR_NONOVERLAPPING_INSERT;
+				return RM_EXEC_DONE;
+			}
+			t->buf_pos += written;
+			if (t->buf_pos == t->buf_len) {
+				t->buf_pos = 0;
+				t->buf_len = 0;
+				t->frame_n = 0;
+			}
+			continue;
 		}
-	} else {
-		/*rm_get_unique_string(f_z_name);
-		f_z = fopen(f_z_name, "wb+");																						create and open @f_z for reading and writing in @z path
-		if (f_z == NULL) {
-			err = RM_ERR_OPEN_TMP;
-			goto err_exit;
+		if (t->blocks_n == t->blocks_n_exp && t->frame_n == 0) {
+			if (((struct rm_session_push_rx*) s->prvt)->opt.loglevel > RM_LOGLEVEL_NORMAL)
+				RM_LOG_INFO("[%s] -> [%s], [%u]: TX-ed [%zu] nonoverlapping checksum elements", s->ssid1, s->ssid2, s->hashed_hash, t->blocks_n_exp);
+			return rm_session_push_rx_task_delta_start(t);
+		}
+		while (t->blocks_n < t->blocks_n_exp && t->frame_n + rec_len <= frame_max) {
+			if (budget >= RM_EXEC_STEP_BYTES)
+				return RM_EXEC_WAIT_OUT;														/* give other sessions a turn */
+			lanes_max = rm_min(rm_min(RM_MD5_LANES, t->blocks_n_exp - t->blocks_n), (frame_max - t->frame_n) / rec_len);	/* blocks hashed at once, as many as frame takes */
+			read_now = rm_min(t->L * lanes_max, t->y_sz - t->L * t->blocks_n);
+			if (rm_fpread(t->block, 1, read_now, t->L * t->blocks_n, s->f_y, &s->y_file_mutex) != read_now) {
+				RM_LOG_PERR("Error reading file [%s]", ((struct rm_session_push_rx*) s->prvt)->msg_push->y);
+				t->ch_ch_tx_status = (enum rm_tx_status) RM_ERR_NONOVERLAPPING_INSERT;
+				return RM_EXEC_DONE;
+			}
+			for (lanes_n = 0, off = 0; off < read_now; ++lanes_n, off += t->L) {
+				data[lanes_n] = t->block + off;
+				len[lanes_n] = rm_min(t->L, read_now - off);
+				p = rm_serialize_u32(payload + t->frame_n, rm_roll_f_ch(roll, rm_roll_block(roll, data[lanes_n], len[lanes_n])));
+				s_ch[lanes_n] = p;																/* filled below */
+				if (prefilter == RM_PREFILTER_CRC32C)
+					rm_serialize_u32(p + RM_STRONG_CHECK_BYTES, rm_crc32c(0, data[lanes_n], len[lanes_n]));
+				t->frame_n += rec_len;
+			}
+			rm_md5_lanes(data, len, s_ch, lanes_n);
+			budget += read_now;
+			t->blocks_n += lanes_n;
+		}
+		if (t->framed) {																		/* frame is full or these are the last checksums */
+			t->buf[0] = RM_TCP_CHAN_CH_CH;
+			t->buf[1] = 0;
+			rm_serialize_u16(t->buf + 2, t->frame_n);
+			t->buf_len = RM_TCP_FRAME_HDR_LEN + t->frame_n;
+		} else {
+			t->buf_len = t->frame_n;
 		}
-		strncpy(s->f_z_name, f_z_name, RM_UNIQUE_STRING_LEN);
-		s->f_z = f_z;
-		*/
+		t->buf_pos = 0;
 	}
+}
 
-	cli_len = sizeof(cli_addr);
-	if ((fd = accept(listen_fd, (struct sockaddr *) &cli_addr, &cli_len)) < 0) {											/* accept transmitter's incoming connection */
-		status = RM_RX_STATUS_DELTA_RX_ACCEPT_FAIL;
-		goto err_exit;
+/* Legacy delta mode: accept transmitter's delta connection. Listening socket stays open
+ * (and registered) until task is done, so its number can't be reused under executor's feet. */
+static enum rm_exec_wait rm_session_push_rx_task_delta_accept(struct rm_session_push_rx_task *t)
+{
+	struct sockaddr_storage	cli_addr = {0};
+	socklen_t				cli_len = sizeof(cli_addr);
+	int						fd = -1;
+
+	fd = accept(t->task.fd, (struct sockaddr *) &cli_addr, &cli_len);
+	if (fd < 0) {
+		if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+			return RM_EXEC_WAIT_IN;
+		t->delta_rx_status = RM_RX_STATUS_DELTA_RX_ACCEPT_FAIL;
+		return RM_EXEC_DONE;
 	}
-
-	if (bytes_to_rx == 0) {
-		goto done;
+	if (rm_tcp_set_socket_blocking_mode(fd, 0) != 0) {
+		close(fd);
+		t->delta_rx_status = RM_RX_STATUS_DELTA_RX_ACCEPT_FAIL;
+		return RM_EXEC_DONE;
 	}
+	t->delta_fd = fd;
+	t->task.fd = fd;
+	t->stage = RM_PUSH_RX_STAGE_DELTA_RX;
+	if (t->bytes_to_rx == 0)
+		return RM_EXEC_DONE;
+	return rm_session_push_rx_task_delta_rx(t);
+}
 
-	delta_pack.f_y = f_y;
-	delta_pack.f_z = f_z;
-	delta_pack.rec_ctx = &rec_ctx;
-	delta_pack.file_mutex = file_mutex;
+static void rm_session_push_rx_task_expect(struct rm_session_push_rx_task *t, enum rm_session_push_rx_field field, size_t bytes_n)
+{
+	t->field = field;
+	t->acc_need = bytes_n;
+	t->acc_n = 0;
+}
 
-	/* RX delta over TCP using delta protocol */
-	struct rm_delta_e delta_e;
-	while (bytes_to_rx > 0) {
-		memset(&delta_e, 0, sizeof(struct rm_delta_e));
+/* Delta element complete: expect next one, digest of @x or end of stream. */
+static void rm_session_push_rx_task_element_done(struct rm_session_push_rx_task *t)
+{
+	struct rm_session_push_rx	*prvt = t->s->prvt;
+
+	if (t->bytes_to_rx > 0)
+		rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_TYPE, RM_DELTA_ELEMENT_TYPE_FIELD_SIZE);
+	else if (prvt->msg_push->hdr->flags & RM_BIT_7)												/* digest of @x follows delta stream */
+		rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_DIGEST, RM_STRONG_CHECK_BYTES);
+	else
+		rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_END, 0);
+}
 
-		/* RX delta over TCP using delta protocol */
-		if (rm_tcp_rx(fd, (void*) &delta_e.type, RM_DELTA_ELEMENT_TYPE_FIELD_SIZE) != RM_ERR_OK) {							/* rx delta type over TCP connection */
-			status = RM_RX_STATUS_DELTA_RX_TCP_FAIL;
-			goto err_exit;
+/* Reconstruct from element that doesn't carry data (everything but RAW_BYTES). */
+static enum rm_rx_status rm_session_push_rx_task_element_apply(struct rm_session_push_rx_task *t)
+{
+	struct rm_delta_e	*delta_e = &t->delta_e;
+	struct timespec		prof_lap = {0};
+
+	if (delta_e->type == RM_DELTA_ELEMENT_REFERENCE && delta_e->raw_bytes_n > t->bytes_to_rx)
+		return RM_RX_STATUS_DELTA_PROC_FAIL;
+	if (delta_e->type == RM_DELTA_ELEMENT_REFERENCE)											/* matched block is in @y */
+		rm_codec_dict_add(&t->codec, delta_e->ref, t->rec_ctx.rec_by_ref + t->rec_ctx.rec_by_raw, delta_e->ref * t->rec_ctx.L, t->rec_ctx.L);
+	t->delta_pack.delta_e = delta_e;
+	RM_PROF_LAP_START(&prof_lap);
+	if (rm_rx_process_delta_element(&t->delta_pack) != RM_ERR_OK)								/* do reconstruction */
+		return RM_RX_STATUS_DELTA_PROC_FAIL;
+	RM_PROF_LAP(&t->rec_ctx.prof, RM_PROF_REC, &prof_lap);
+	if (delta_e->type == RM_DELTA_ELEMENT_REFERENCE)
+		t->bytes_to_rx -= delta_e->raw_bytes_n;
+	else
+		t->bytes_to_rx = 0;																		/* TAIL and ZERO_DIFF end the stream */
+	rm_session_push_rx_task_element_done(t);
+	return RM_RX_STATUS_OK;
+}
+
+/* Decompress @n bytes of compressed literal payload, write what comes out to @z. */
+static enum rm_rx_status rm_session_push_rx_task_raw_z(struct rm_session_push_rx_task *t, const unsigned char *src, size_t n)
+{
+	struct rm_delta_reconstruct_ctx	*rec_ctx = &t->rec_ctx;
+	size_t						in = 0, src_used = 0, dst_used = 0, cap = 0;
+	unsigned char				*dst = NULL;
+	struct timespec				prof_lap = {0};
+
+	RM_PROF_LAP_START(&prof_lap);
+	do {
+		if (rm_zout_reserve(&t->z_out, rec_ctx->rec_by_ref + rec_ctx->rec_by_raw, &dst, &cap) != RM_ERR_OK)
+			return RM_RX_STATUS_DELTA_PROC_FAIL;
+		cap = rm_min(t->raw_left, cap);
+		if (rm_codec_decompress(&t->codec, src + in, n - in, &src_used, dst, cap, &dst_used) != RM_ERR_OK)		/* straight into output buffer */
+			return RM_RX_STATUS_DELTA_PROC_FAIL;
+		if (src_used == 0 && dst_used == 0 && in < n)											/* corrupt or more bytes than element's size */
+			return RM_RX_STATUS_DELTA_PROC_FAIL;
+		if (dst_used > 0) {
+			md5_update(&t->z_md5, dst, dst_used);
+			rm_zout_commit(&t->z_out, dst_used);
+			rec_ctx->rec_by_raw += dst_used;
+			t->raw_left -= dst_used;
+			t->bytes_to_rx -= dst_used;
 		}
-		if (loglevel >= RM_LOGLEVEL_THREADS)
-			RM_LOG_INFO("[RX]: delta type[%u]", delta_e.type);
+		in += src_used;
+	} while (in < n || (cap > 0 && dst_used == cap));											/* output may be pending when buffer got full */
+	RM_PROF_LAP(&rec_ctx->prof, RM_PROF_REC, &prof_lap);
+	return RM_RX_STATUS_OK;
+}
 
-		switch (delta_e.type) {
+/* Parse @bytes_n bytes of delta stream (PROTOCOL as in rm_rx_tx_delta_element, fields
+ * in host order), raw bytes are written to @z as they come.
+ * @return	Number of bytes consumed, *status set on error. */
+static size_t rm_session_push_rx_task_parse(struct rm_session_push_rx_task *t, const unsigned char *src, size_t bytes_n, enum rm_rx_status *status)
+{
+	struct rm_session			*s = t->s;
+	struct rm_delta_e			*delta_e = &t->delta_e;
+	struct rm_delta_reconstruct_ctx	*rec_ctx = &t->rec_ctx;
+	size_t						n = 0, consumed = 0;
+	uint64_t					z_n = 0;
+	struct timespec				prof_lap = {0};
+
+	while (consumed < bytes_n && t->field != RM_PUSH_RX_FIELD_END) {
+		if (t->field == RM_PUSH_RX_FIELD_RAW) {													/* copy raw bytes to @f_z directly */
+			n = rm_min(bytes_n - consumed, t->raw_left);
+			RM_PROF_LAP_START(&prof_lap);
+			if (rm_zout_write(&t->z_out, rec_ctx->rec_by_ref + rec_ctx->rec_by_raw, src + consumed, n) != RM_ERR_OK) {
+				*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+				return consumed;
+			}
+			md5_update(&t->z_md5, src + consumed, n);
+			RM_PROF_LAP(&rec_ctx->prof, RM_PROF_REC, &prof_lap);
+			rec_ctx->rec_by_raw += n;
+			t->raw_left -= n;
+			t->bytes_to_rx -= n;
+			consumed += n;
+			if (t->raw_left == 0) {
+				++rec_ctx->delta_raw_n;
+				rm_session_push_rx_task_element_done(t);
+			}
+			continue;
+		}
+		if (t->field == RM_PUSH_RX_FIELD_RAW_Z) {												/* decompress to @f_z as compressed bytes come */
+			n = rm_min(bytes_n - consumed, t->z_left);
+			*status = rm_session_push_rx_task_raw_z(t, src + consumed, n);
+			if (*status != RM_RX_STATUS_OK)
+				return consumed;
+			t->z_left -= n;
+			consumed += n;
+			if (t->z_left == 0) {
+				if (t->raw_left != 0) {															/* payload decompressed to less than element's size */
+					*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+					return consumed;
+				}
+				++rec_ctx->delta_raw_n;
+				rm_session_push_rx_task_element_done(t);
+			}
+			continue;
+		}
+		n = rm_min(bytes_n - consumed, t->acc_need - t->acc_n);
+		memcpy(t->acc + t->acc_n, src + consumed, n);
+		t->acc_n += n;
+		consumed += n;
+		if (t->acc_n < t->acc_need)
+			break;
 
-			case RM_DELTA_ELEMENT_REFERENCE:																				/* copy referenced bytes from @f_y to @f_z */
-				if (rm_tcp_rx(fd, (void*) &delta_e.ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* rx ref over TCP connection */
-					goto err_exit;
-				delta_e.raw_bytes_n = rec_ctx.L;																			/* by definition */
+		switch (t->field) {
+
+			case RM_PUSH_RX_FIELD_TYPE:
+				memset(delta_e, 0, sizeof(struct rm_delta_e));
+				delta_e->type = t->acc[0];
+				if (((struct rm_session_push_rx*) s->prvt)->opt.loglevel >= RM_LOGLEVEL_THREADS)
+					RM_LOG_INFO("[RX]: delta type[%u]", delta_e->type);
+				switch (delta_e->type) {
+					case RM_DELTA_ELEMENT_REFERENCE:
+					case RM_DELTA_ELEMENT_TAIL:
+						rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_REF, RM_DELTA_ELEMENT_REF_FIELD_SIZE);
+						break;
+					case RM_DELTA_ELEMENT_RAW_BYTES:
+						rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_RAW_LEN, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE);
+						break;
+					case RM_DELTA_ELEMENT_ZERO_DIFF:
+						delta_e->raw_bytes_n = s->f_y_sz;												/* by definition */
+						*status = rm_session_push_rx_task_element_apply(t);
+						break;
+					default:
+						*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+						break;
+				}
+				break;
+
+			case RM_PUSH_RX_FIELD_REF:
+				memcpy(&delta_e->ref, t->acc, RM_DELTA_ELEMENT_REF_FIELD_SIZE);
+				delta_e->raw_bytes_n = (delta_e->type == RM_DELTA_ELEMENT_REFERENCE ? rec_ctx->L : t->bytes_to_rx);	/* by definition */
+				*status = rm_session_push_rx_task_element_apply(t);
 				break;
 
-			case RM_DELTA_ELEMENT_TAIL:																						/* copy referenced bytes from @f_y to @f_z */
-				if (rm_tcp_rx(fd, (void*) &delta_e.ref, RM_DELTA_ELEMENT_REF_FIELD_SIZE) != RM_ERR_OK)						/* rx ref over TCP connection */
-					goto err_exit;
-				delta_e.raw_bytes_n = bytes_to_rx;																			/* by definition */
+			case RM_PUSH_RX_FIELD_RAW_LEN:
+				memcpy(&delta_e->raw_bytes_n, t->acc, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE);
+				if (delta_e->raw_bytes_n > t->bytes_to_rx) {
+					*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+					break;
+				}
+				t->raw_left = delta_e->raw_bytes_n;
+				if (t->codec.type != RM_CODEC_NONE) {
+					rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_RAW_Z_LEN, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE);
+					break;
+				}
+				t->field = RM_PUSH_RX_FIELD_RAW;
+				if (t->raw_left == 0) {
+					++rec_ctx->delta_raw_n;
+					rm_session_push_rx_task_element_done(t);
+				}
 				break;
 
-			case RM_DELTA_ELEMENT_RAW_BYTES:																				/* copy raw bytes to @f_z directly */
-				if (rm_tcp_rx(fd, (void*) &delta_e.raw_bytes_n, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE) != RM_ERR_OK)			/* rx bytes size over TCP connection */
-					goto err_exit;
-				delta_e.raw_bytes = malloc(delta_e.raw_bytes_n);															/* malloc buffer */
-				if (delta_e.raw_bytes == NULL)
-					goto err_exit;
-				if (rm_tcp_rx(fd, (void*) delta_e.raw_bytes, delta_e.raw_bytes_n) != RM_ERR_OK)								/* rx bytes over TCP connection */
-					goto err_exit;
+			case RM_PUSH_RX_FIELD_RAW_Z_LEN:
+				memcpy(&z_n, t->acc, RM_DELTA_ELEMENT_BYTES_FIELD_SIZE);
+				if (z_n == 0) {																	/* stored */
+					rec_ctx->rec_by_raw_z += t->raw_left;
+					rec_ctx->rec_by_raw_stored += t->raw_left;
+					t->field = RM_PUSH_RX_FIELD_RAW;
+					if (t->raw_left == 0) {
+						++rec_ctx->delta_raw_n;
+						rm_session_push_rx_task_element_done(t);
+					}
+					break;
+				}
+				if (z_n > rm_codec_bound(t->raw_left)) {
+					*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+					break;
+				}
+				if (rm_codec_element_start(&t->codec) != RM_ERR_OK) {
+					*status = RM_RX_STATUS_DELTA_PROC_FAIL;
+					break;
+				}
+				rec_ctx->rec_by_raw_z += z_n;
+				t->z_left = z_n;
+				t->field = RM_PUSH_RX_FIELD_RAW_Z;
 				break;
 
-			case RM_DELTA_ELEMENT_ZERO_DIFF:
-				delta_e.raw_bytes_n = y_sz;																					/* by definition */
+			case RM_PUSH_RX_FIELD_DIGEST:
+				memcpy(rec_ctx->x_digest.data, t->acc, RM_STRONG_CHECK_BYTES);
+				md5_final(&t->z_md5, rec_ctx->z_digest.data);
+				if (memcmp(rec_ctx->x_digest.data, rec_ctx->z_digest.data, RM_STRONG_CHECK_BYTES) != 0) {
+					rec_ctx->integrity = RM_INTEGRITY_MISMATCH;
+					*status = RM_RX_STATUS_DIGEST_MISMATCH;
+					break;
+				}
+				rec_ctx->integrity = RM_INTEGRITY_OK;
+				rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_END, 0);
 				break;
 
 			default:
-				assert(1 == 0 && "Unknown delta element type!");
-				goto err_exit;
+				*status = RM_RX_STATUS_INTERNAL_ERR;
+				break;
 		}
+		if (*status != RM_RX_STATUS_OK)
+			break;
+	}
+	return consumed;
+}
 
-		delta_pack.delta_e = &delta_e;
-		err = rm_rx_process_delta_element(&delta_pack);																		/* do reconstruction */
-		if (err != 0) {
-			status = RM_RX_STATUS_DELTA_PROC_FAIL;
-			goto err_exit;
+/* Splice literal bytes of current element waiting on the socket to @z,
+ * in framed mode at most those of current frame. */
+static enum rm_error rm_session_push_rx_task_raw_splice(struct rm_session_push_rx_task *t, size_t *moved)
+{
+	struct rm_delta_reconstruct_ctx	*rec_ctx = &t->rec_ctx;
+	struct timespec				prof_lap = {0};
+	enum rm_error				err = RM_ERR_OK;
+
+	RM_PROF_LAP_START(&prof_lap);
+	err = rm_tcp_file_rx_splice(&t->raw_rx, t->task.fd, fileno(t->s->f_z), rec_ctx->rec_by_ref + rec_ctx->rec_by_raw,
+			(t->framed ? rm_min(t->raw_left, t->frame_left) : t->raw_left), (t->digest ? &t->z_md5 : NULL), moved);
+	RM_PROF_LAP(&rec_ctx->prof, RM_PROF_REC, &prof_lap);
+	if (err != RM_ERR_OK)
+		return err;
+	rec_ctx->rec_by_raw += *moved;
+	t->raw_left -= *moved;
+	if (t->framed)
+		t->frame_left -= *moved;
+	t->bytes_to_rx -= *moved;
+	if (t->raw_left == 0) {
+		++rec_ctx->delta_raw_n;
+		rm_session_push_rx_task_element_done(t);
+	}
+	return RM_ERR_OK;
+}
+
+/* RX whatever is available on the socket, strip frame headers in framed mode
+ * and feed delta parser. */
+static enum rm_exec_wait rm_session_push_rx_task_delta_rx(struct rm_session_push_rx_task *t)
+{
+	enum rm_error		err = RM_ERR_OK;
+	enum rm_rx_status	status = RM_RX_STATUS_OK;
+	size_t				budget = 0, n = 0, want = 0;
+	ssize_t				bytes_read = 0;
+	uint16_t			len = 0;
+
+	while (1) {
+		if (t->buf_pos == t->buf_len) {
+			if (budget >= RM_EXEC_STEP_BYTES)
+				return RM_EXEC_WAIT_IN;															/* give other sessions a turn */
+			want = RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX;
+			if (t->field == RM_PUSH_RX_FIELD_RAW && t->raw_rx.pipe_fd[0] != -1 && t->framed && t->frame_left == 0) {
+				if (t->raw_left >= RM_TCP_FRAME_SENDFILE_MIN)											/* transmitter sends such literals in own frames */
+					want = RM_TCP_FRAME_HDR_LEN - t->frame_hdr_n;								/* header only, payload of frame is spliced then */
+			} else if (t->field == RM_PUSH_RX_FIELD_RAW && t->raw_rx.pipe_fd[0] != -1) {		/* literal bytes go from socket to @z without copy */
+				err = rm_session_push_rx_task_raw_splice(t, &n);
+				if (err == RM_ERR_AGAIN)
+					return RM_EXEC_WAIT_IN;
+				if (err == RM_ERR_OK) {
+					budget += n;
+					t->bytes_rx += n;
+					if (t->field == RM_PUSH_RX_FIELD_END)
+						return RM_EXEC_DONE;
+					continue;
+				}
+				if (err != RM_ERR_BAD_CALL) {													/* else read from now on */
+					t->delta_rx_status = (err == RM_ERR_WRITE ? RM_RX_STATUS_DELTA_PROC_FAIL : RM_RX_STATUS_DELTA_RX_TCP_FAIL);
+					return RM_EXEC_DONE;
+				}
+			}
+			bytes_read = read(t->task.fd, t->buf, want);
+			if (bytes_read < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					return RM_EXEC_WAIT_IN;
+				t->delta_rx_status = (t->field == RM_PUSH_RX_FIELD_DIGEST ? RM_RX_STATUS_DIGEST_RX_FAIL : RM_RX_STATUS_DELTA_RX_TCP_FAIL);
+				return RM_EXEC_DONE;
+			}
+			if (bytes_read == 0) {																/* transmitter gone before end of stream */
+				t->delta_rx_status = (t->field == RM_PUSH_RX_FIELD_DIGEST ? RM_RX_STATUS_DIGEST_RX_FAIL : RM_RX_STATUS_DELTA_RX_TCP_FAIL);
+				return RM_EXEC_DONE;
+			}
+			t->buf_len = bytes_read;
+			t->buf_pos = 0;
+			budget += bytes_read;
 		}
+		if (t->framed && t->frame_left == 0) {													/* frame header */
+			n = rm_min(t->buf_len - t->buf_pos, RM_TCP_FRAME_HDR_LEN - t->frame_hdr_n);
+			memcpy(t->frame_hdr + t->frame_hdr_n, t->buf + t->buf_pos, n);
+			t->frame_hdr_n += n;
+			t->buf_pos += n;
+			if (t->frame_hdr_n < RM_TCP_FRAME_HDR_LEN)
+				continue;
+			t->frame_hdr_n = 0;
+			rm_deserialize_u16(t->frame_hdr + 2, &len);
+			if (t->frame_hdr[0] != RM_TCP_CHAN_DELTA || len == 0) {
+				t->delta_rx_status = RM_RX_STATUS_DELTA_RX_TCP_FAIL;
+				return RM_EXEC_DONE;
+			}
+			t->frame_left = len;
+			continue;
+		}
+		n = t->buf_len - t->buf_pos;
+		if (t->framed)
+			n = rm_min(n, t->frame_left);
+		n = rm_session_push_rx_task_parse(t, t->buf + t->buf_pos, n, &status);
+		t->bytes_rx += n;
+		if (status != RM_RX_STATUS_OK) {
+			t->delta_rx_status = status;
+			return RM_EXEC_DONE;
+		}
+		t->buf_pos += n;
+		if (t->framed)
+			t->frame_left -= n;
+		if (t->field == RM_PUSH_RX_FIELD_END)
+			return RM_EXEC_DONE;
+	}
+}
 
-		/* count bytes and free memory in case this is ELEMENT_RAW_BYTES */
-		switch (delta_e.type) {
+/* Publish progress for metrics. */
+static void rm_session_push_rx_task_progress(struct rm_session_push_rx_task *t)
+{
+	struct rm_session	*s = t->s;
 
-			case RM_DELTA_ELEMENT_REFERENCE:
-				bytes_to_rx -= delta_e.raw_bytes_n;
-				break;
+	pthread_mutex_lock(&s->mutex);
+	s->progress.phase = (t->stage == RM_PUSH_RX_STAGE_CH_CH_TX ? RM_SESSION_PHASE_CH_CH_TX : RM_SESSION_PHASE_DELTA_RX);
+	s->progress.ch_ch_tx_n = t->blocks_n;
+	rm_session_progress_delta(s, t->bytes_rx, &t->rec_ctx);
+	pthread_mutex_unlock(&s->mutex);
+}
 
-			case RM_DELTA_ELEMENT_RAW_BYTES:
-				bytes_to_rx -= delta_e.raw_bytes_n;
-				free(delta_e.raw_bytes);
-				break;
+static enum rm_exec_wait rm_session_push_rx_task_f(struct rm_exec_task *task)
+{
+	struct rm_session_push_rx_task	*t = (struct rm_session_push_rx_task*) task;
+	enum rm_exec_wait				wait = RM_EXEC_DONE;
 
-			case RM_DELTA_ELEMENT_TAIL:
-			case RM_DELTA_ELEMENT_ZERO_DIFF:
-				bytes_to_rx = 0;
-				break;
-		}
+	switch (t->stage) {
+		case RM_PUSH_RX_STAGE_CH_CH_TX:
+			wait = rm_session_push_rx_task_ch_ch_tx(t);
+			break;
+		case RM_PUSH_RX_STAGE_DELTA_ACCEPT:
+			wait = rm_session_push_rx_task_delta_accept(t);
+			break;
+		case RM_PUSH_RX_STAGE_DELTA_RX:
+			wait = rm_session_push_rx_task_delta_rx(t);
+			break;
+		default:
+			t->delta_rx_status = RM_RX_STATUS_INTERNAL_ERR;
+			break;
 	}
 
-done:
+	rm_session_push_rx_task_progress(t);														/* once per step */
+	return wait;
+}
+
+enum rm_exec_wait rm_session_push_rx_task_ch_ch_step(struct rm_exec_task *task)
+{
+	struct rm_session_push_rx_task	*t = (struct rm_session_push_rx_task*) task;
+	enum rm_exec_wait				wait = RM_EXEC_DONE;
+
+	if (t->stage != RM_PUSH_RX_STAGE_CH_CH_TX)
+		return RM_EXEC_WAIT_IN;
+	wait = rm_session_push_rx_task_ch_ch_tx(t);
+	rm_session_push_rx_task_progress(t);
+	if (t->stage == RM_PUSH_RX_STAGE_CH_CH_TX)
+		return wait;																			/* socket is full (or budget is out), or error */
+	return RM_EXEC_WAIT_IN;																		/* checksums are out (delta_start() returns DONE for empty @x) */
+}
+
+size_t rm_session_push_rx_task_delta_feed(struct rm_exec_task *task, const unsigned char *src, size_t bytes_n, uint8_t *end)
+{
+	struct rm_session_push_rx_task	*t = (struct rm_session_push_rx_task*) task;
+	enum rm_rx_status				status = RM_RX_STATUS_OK;
+	size_t							n = 0;
+
+	*end = 0;
+	if (t->stage != RM_PUSH_RX_STAGE_DELTA_RX || t->field == RM_PUSH_RX_FIELD_END) {
+		if (t->stage != RM_PUSH_RX_STAGE_DELTA_RX)
+			t->delta_rx_status = RM_RX_STATUS_INTERNAL_ERR;
+		*end = 1;
+		return 0;
+	}
+	n = rm_session_push_rx_task_parse(t, src, bytes_n, &status);
+	t->bytes_rx += n;
+	if (status != RM_RX_STATUS_OK) {
+		t->delta_rx_status = status;
+		*end = 1;
+	} else if (t->field == RM_PUSH_RX_FIELD_END) {
+		*end = 1;
+	}
+	rm_session_push_rx_task_progress(t);
+	return n;
+}
+
+/* Publish results in session, release task, tell the owner. */
+static void rm_session_push_rx_task_dtor(struct rm_exec_task *task, uint8_t aborted)
+{
+	struct rm_session_push_rx_task	*t = (struct rm_session_push_rx_task*) task;
+	struct rm_session				*s = t->s;
+	struct rm_session_push_rx		*prvt = s->prvt;
+	void (*f_done)(struct rm_session *s, void *arg) = t->f_done;
+	void							*arg = t->arg;
+	struct timespec					real_time = {0};
+
+	if (aborted) {
+		if (t->stage == RM_PUSH_RX_STAGE_CH_CH_TX && t->ch_ch_tx_status == RM_TX_STATUS_OK)
+			t->ch_ch_tx_status = (enum rm_tx_status) RM_ERR_FAIL;
+		if (t->delta_rx_status == RM_RX_STATUS_OK)
+			t->delta_rx_status = RM_RX_STATUS_INTERNAL_ERR;
+	}
+	if (t->delta_rx_status == RM_RX_STATUS_OK && rm_zout_flush(&t->z_out) != RM_ERR_OK)		/* rest of @z */
+		t->delta_rx_status = RM_RX_STATUS_DELTA_PROC_FAIL;
 
 	pthread_mutex_lock(&s->mutex);
 
-	s->clk_cputime_stop = (double) clock() / CLOCKS_PER_SEC; 
-	cpu_time = s->clk_cputime_stop - s->clk_cputime_start;
+	s->clk_cputime_stop = (double) clock() / CLOCKS_PER_SEC;
 	clock_gettime(CLOCK_REALTIME, &s->clk_realtime_stop);
-	real_time.tv_sec = s->clk_realtime_stop.tv_sec - s->clk_realtime_start.tv_sec; 
+	real_time.tv_sec = s->clk_realtime_stop.tv_sec - s->clk_realtime_start.tv_sec;
 	real_time.tv_nsec = s->clk_realtime_stop.tv_nsec - s->clk_realtime_start.tv_nsec;
-	rec_ctx.time_cpu = cpu_time;
-	rec_ctx.time_real = real_time;
-
-	if (fd != -1) {																											/* close accepted socket connection */
-		close(fd);
-		fd = -1;
+	t->rec_ctx.time_cpu = s->clk_cputime_stop - s->clk_cputime_start;
+	t->rec_ctx.time_real = real_time;
+	memcpy(&s->rec_ctx, &t->rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));
+	prvt->ch_ch_tx_status = t->ch_ch_tx_status;
+	prvt->delta_rx_status = t->delta_rx_status;
+	s->progress.ch_ch_tx_n = t->blocks_n;
+	rm_session_progress_delta(s, t->bytes_rx, &t->rec_ctx);
+	s->progress.phase = RM_SESSION_PHASE_FINALIZE;
+
+	if (t->delta_fd != -1) {																	/* close accepted socket connection */
+		close(t->delta_fd);
+		t->delta_fd = -1;
 	}
-	if (prvt_rx->delta_fd != -1) {
-		close(prvt_rx->delta_fd);																							/* close listening socket */
-		prvt_rx->delta_fd = -1;
+	if (prvt->delta_fd != -1) {
+		close(prvt->delta_fd);																	/* close listening socket */
+		prvt->delta_fd = -1;
 	}
 
-	assert(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == s->f_x_sz);															/* f_x_sz assigned from msg_push in assign_validate method */
-	assert(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
-	memcpy(&s->rec_ctx, &rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));
-	prvt_rx->delta_rx_status = RM_RX_STATUS_OK;
-
 	pthread_mutex_unlock(&s->mutex);
 
-	return NULL; /* this thread must be created in joinable state */
-
-err_exit:
+	rm_codec_free(&t->codec);
+	rm_zout_free(&t->z_out);
+	rm_tcp_file_rx_free(&t->raw_rx);
+	free(t->block);
+	free(t->buf);
+	free(t);
+	f_done(s, arg);
+}
 
-	pthread_mutex_lock(&s->mutex);
+struct rm_exec_task* rm_session_push_rx_task_create(struct rm_session *s, void (*f_done)(struct rm_session *s, void *arg), void *arg)
+{
+	struct rm_session_push_rx_task	*t = NULL;
+	struct rm_session_push_rx		*prvt = s->prvt;
 
-	if (fd != -1) {																											/* close accepted socket connection */
-		close(fd);
-		fd = -1;
+	t = calloc(1, sizeof(struct rm_session_push_rx_task));
+	if (t == NULL)
+		return NULL;
+	t->s = s;
+	t->f_done = f_done;
+	t->arg = arg;
+	t->delta_fd = -1;
+	t->raw_rx.pipe_fd[0] = t->raw_rx.pipe_fd[1] = -1;
+	t->raw_rx.tee_fd[0] = t->raw_rx.tee_fd[1] = -1;
+	t->framed = (prvt->msg_push->delta_mode == RM_DELTA_MODE_FRAMED);
+	t->digest = ((prvt->msg_push->hdr->flags & RM_BIT_7) != 0);
+	t->L = prvt->msg_push->L;
+	t->bytes_to_rx = prvt->msg_push->bytes;
+	if (s->f_y != NULL) {																		/* if reference file exists, split it and calc checksums */
+		t->y_sz = s->f_y_sz;
+		t->blocks_n_exp = prvt->ch_ch_n;
+		if (t->blocks_n_exp > 0) {
+			t->block = malloc(rm_min(t->L * RM_MD5_LANES, t->y_sz));
+			if (t->block == NULL)
+				goto fail;
+		}
+	}
+	t->buf = malloc(RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX);
+	if (t->buf == NULL)
+		goto fail;
+	if (prvt->codec != RM_CODEC_NONE) {
+		if (rm_codec_init(&t->codec, prvt->codec, prvt->codec_level, 0, (s->f_y != NULL ? fileno(s->f_y) : -1)) != RM_ERR_OK)
+			goto fail;
 	}
-	if (prvt_rx->delta_fd != -1) {
-		close(prvt_rx->delta_fd);																							/* close listening socket */
-		prvt_rx->delta_fd = -1;
+	if (rm_zout_init(&t->z_out, fileno(s->f_z), t->bytes_to_rx, prvt->opt.z_direct) != RM_ERR_OK)
+		goto fail;
+	if (prvt->codec == RM_CODEC_NONE && t->z_out.direct == 0) {								/* splice literals from socket, through page cache */
+		if (rm_tcp_file_rx_init(&t->raw_rx, 1) != RM_ERR_OK)
+			goto fail;
 	}
-	prvt_rx->delta_rx_status = status;
-	memcpy(&s->rec_ctx, &rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));
 
-	pthread_mutex_unlock(&s->mutex);
+	memcpy(&t->rec_ctx, &s->rec_ctx, sizeof(struct rm_delta_reconstruct_ctx));				/* init reconstruction context (L set in assign_validate() */
+	md5_init(&t->z_md5);
+	t->delta_pack.f_y = s->f_y;
+	t->delta_pack.f_z = s->f_z;
+	t->delta_pack.rec_ctx = &t->rec_ctx;
+	t->delta_pack.file_mutex = &s->y_file_mutex;
+	t->delta_pack.z_md5 = &t->z_md5;
+	t->delta_pack.z_out = &t->z_out;
+	rm_session_push_rx_task_expect(t, RM_PUSH_RX_FIELD_TYPE, RM_DELTA_ELEMENT_TYPE_FIELD_SIZE);
+
+	if (rm_tcp_set_socket_blocking_mode(prvt->fd, 0) != 0)
+		goto fail;
+	if (prvt->delta_fd != -1 && rm_tcp_set_socket_blocking_mode(prvt->delta_fd, 0) != 0)
+		goto fail;
+	t->stage = RM_PUSH_RX_STAGE_CH_CH_TX;
+	t->task.fd = prvt->fd;
+	t->task.f = rm_session_push_rx_task_f;
+	t->task.f_dtor = rm_session_push_rx_task_dtor;
+	return &t->task;
 
-	return NULL; /* this thread must be created in joinable state */
+fail:
+	rm_codec_free(&t->codec);
+	rm_zout_free(&t->z_out);
+	rm_tcp_file_rx_free(&t->raw_rx);
+	free(t->block);
+	free(t->buf);
+	free(t);
+	return NULL;
 }
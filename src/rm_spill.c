@@ -0,0 +1,442 @@
+/* @file        rm_spill.c
+ * @brief       Nonoverlapping checksums of huge reference file kept on disk.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        22 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_spill.h"
+
+
+#define RM_SPILL_IO_RECS    (RM_SPILL_IO_LEN / sizeof(struct rm_ch_ch_ref))
+
+struct rm_spill_reader {
+	struct rm_ch_ch_ref *buf;           /* RM_SPILL_IO_RECS records of run */
+	size_t              pos;
+	size_t              n;
+	uint64_t            next;           /* next record of run in runs file */
+	uint64_t            left;           /* records of run not read yet */
+};
+
+/* Order of sorted file: fast checksum, strong checksum, block. */
+static int rm_spill_rec_cmp(const void *a, const void *b)
+{
+	const struct rm_ch_ch_ref	*x = a, *y = b;
+	int							res = 0;
+
+	if (x->ch_ch.f_ch != y->ch_ch.f_ch)
+		return (x->ch_ch.f_ch < y->ch_ch.f_ch ? -1 : 1);
+	res = memcmp(x->ch_ch.s_ch.data, y->ch_ch.s_ch.data, RM_STRONG_CHECK_BYTES);
+	if (res != 0)
+		return res;
+	return (x->ref < y->ref ? -1 : (x->ref > y->ref));
+}
+
+static int rm_spill_tmp(void)
+{
+	const char	*dir = getenv("TMPDIR");
+	char		path[PATH_MAX];
+	int			fd = -1;
+
+	if (dir == NULL || dir[0] == '\0')
+		dir = "/tmp";
+	if ((size_t) snprintf(path, sizeof(path), "%s/rsyncme_spill_XXXXXX", dir) >= sizeof(path))
+		return -1;
+	fd = mkstemp(path);
+	if (fd != -1)
+		unlink(path);																		/* gone with last close */
+	return fd;
+}
+
+static enum rm_error rm_spill_pwrite(int fd, const void *buf, size_t bytes_n, uint64_t offset)
+{
+	const unsigned char	*src = buf;
+	ssize_t				n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = pwrite(fd, src, bytes_n, offset);
+		} while ((n == -1) && (errno == EINTR));
+		if (n <= 0)
+			return RM_ERR_WRITE;
+		src += n;
+		offset += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+static enum rm_error rm_spill_pread(int fd, void *buf, size_t bytes_n, uint64_t offset)
+{
+	unsigned char	*dst = buf;
+	ssize_t			n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = pread(fd, dst, bytes_n, offset);
+		} while ((n == -1) && (errno == EINTR));
+		if (n <= 0)
+			return RM_ERR_READ;
+		dst += n;
+		offset += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+/* Bit @i of @f_ch in filter, hashes are combined from two halves of 64-bit product.
+ * Filter of 2^32 bits is indexed by @f_ch itself. */
+static uint64_t rm_spill_filter_bit(const struct rm_spill *sp, uint32_t f_ch, uint8_t i)
+{
+	uint64_t	x = (uint64_t) f_ch * 0x9E3779B97F4A7C15ull;
+	uint64_t	h1 = x >> 32, h2 = (x & 0xFFFFFFFFu) | 1u;
+
+	if (sp->filter_bits == 32)
+		return f_ch;
+	return (h1 + i * h2) & (((uint64_t) 1 << sp->filter_bits) - 1);
+}
+
+static void rm_spill_filter_add(struct rm_spill *sp, uint32_t f_ch)
+{
+	uint64_t	bit = 0;
+	uint8_t		i = 0;
+
+	for (i = 0; i < sp->filter_k; ++i) {
+		bit = rm_spill_filter_bit(sp, f_ch, i);
+		sp->filter[bit >> 6] |= (uint64_t) 1 << (bit & 63);
+	}
+}
+
+static uint8_t rm_spill_filter_test(const struct rm_spill *sp, uint32_t f_ch)
+{
+	uint64_t	bit = 0;
+	uint8_t		i = 0;
+
+	for (i = 0; i < sp->filter_k; ++i) {
+		bit = rm_spill_filter_bit(sp, f_ch, i);
+		if ((sp->filter[bit >> 6] & ((uint64_t) 1 << (bit & 63))) == 0)
+			return 0;
+	}
+	return 1;
+}
+
+/* Sort gathered checksums and append them to runs file as next run. */
+static enum rm_error rm_spill_run_write(struct rm_spill *sp)
+{
+	struct rm_spill_run	*runs = NULL;
+	uint64_t			off = 0;
+
+	if (sp->recs_n == 0)
+		return RM_ERR_OK;
+	runs = realloc(sp->runs, (sp->runs_n + 1) * sizeof(*runs));
+	if (runs == NULL)
+		return RM_ERR_MEM;
+	sp->runs = runs;
+	if (sp->runs_n > 0)
+		off = sp->runs[sp->runs_n - 1].off + sp->runs[sp->runs_n - 1].n;
+	qsort(sp->recs, sp->recs_n, sizeof(*sp->recs), rm_spill_rec_cmp);
+	if (rm_spill_pwrite(sp->runs_fd, sp->recs, sp->recs_n * sizeof(*sp->recs), off * sizeof(*sp->recs)) != RM_ERR_OK)
+		return RM_ERR_WRITE;
+	sp->runs[sp->runs_n].off = off;
+	sp->runs[sp->runs_n].n = sp->recs_n;
+	++sp->runs_n;
+	sp->recs_n = 0;
+	return RM_ERR_OK;
+}
+
+static enum rm_error rm_spill_reader_fill(const struct rm_spill *sp, struct rm_spill_reader *r)
+{
+	size_t	n = rm_min(r->left, (uint64_t) RM_SPILL_IO_RECS);
+
+	r->pos = 0;
+	r->n = 0;
+	if (n == 0)
+		return RM_ERR_OK;
+	if (rm_spill_pread(sp->runs_fd, r->buf, n * sizeof(*r->buf), r->next * sizeof(*r->buf)) != RM_ERR_OK)
+		return RM_ERR_READ;
+	r->next += n;
+	r->left -= n;
+	r->n = n;
+	return RM_ERR_OK;
+}
+
+static int rm_spill_reader_cmp(const struct rm_spill_reader *a, const struct rm_spill_reader *b)
+{
+	return rm_spill_rec_cmp(&a->buf[a->pos], &b->buf[b->pos]);
+}
+
+/* Restore min-heap of readers (by current record) below @i. */
+static void rm_spill_heap_down(const struct rm_spill_reader *r, size_t *heap, size_t heap_n, size_t i)
+{
+	size_t	c = 0, t = 0;
+
+	for (;;) {
+		c = 2 * i + 1;
+		if (c >= heap_n)
+			return;
+		if (c + 1 < heap_n && rm_spill_reader_cmp(&r[heap[c + 1]], &r[heap[c]]) < 0)
+			++c;
+		if (rm_spill_reader_cmp(&r[heap[i]], &r[heap[c]]) <= 0)
+			return;
+		t = heap[i];
+		heap[i] = heap[c];
+		heap[c] = t;
+		i = c;
+	}
+}
+
+/* Merge runs into sorted file, single run already is one. Filter and index
+ * are built from records as they come out in order. */
+static enum rm_error rm_spill_merge(struct rm_spill *sp)
+{
+	struct rm_spill_reader	*r = NULL, *rd = NULL;
+	size_t					*heap = NULL, heap_n = 0, i = 0, out_n = 0;
+	struct rm_ch_ch_ref		*out = NULL;
+	const struct rm_ch_ch_ref	*rec = NULL;
+	uint64_t				rec_i = 0, out_off = 0;
+	uint8_t					copy = (sp->runs_n > 1);
+	enum rm_error			err = RM_ERR_OK;
+
+	r = calloc(sp->runs_n, sizeof(*r));
+	heap = calloc(sp->runs_n, sizeof(*heap));
+	if (copy)
+		out = malloc(RM_SPILL_IO_RECS * sizeof(*out));
+	if (r == NULL || heap == NULL || (copy && out == NULL)) {
+		err = RM_ERR_MEM;
+		goto done;
+	}
+	for (i = 0; i < sp->runs_n; ++i) {
+		r[i].buf = malloc(RM_SPILL_IO_RECS * sizeof(*r[i].buf));
+		if (r[i].buf == NULL) {
+			err = RM_ERR_MEM;
+			goto done;
+		}
+		r[i].next = sp->runs[i].off;
+		r[i].left = sp->runs[i].n;
+		err = rm_spill_reader_fill(sp, &r[i]);
+		if (err != RM_ERR_OK)
+			goto done;
+		if (r[i].n > 0)
+			heap[heap_n++] = i;
+	}
+	for (i = heap_n / 2; i-- > 0;)
+		rm_spill_heap_down(r, heap, heap_n, i);
+
+	while (heap_n > 0) {
+		rd = &r[heap[0]];
+		rec = &rd->buf[rd->pos];
+		if (rec_i % sp->page_recs == 0)
+			sp->index[rec_i / sp->page_recs] = rec->ch_ch.f_ch;
+		rm_spill_filter_add(sp, rec->ch_ch.f_ch);
+		++rec_i;
+		if (copy) {
+			out[out_n++] = *rec;
+			if (out_n == RM_SPILL_IO_RECS) {
+				err = rm_spill_pwrite(sp->fd, out, out_n * sizeof(*out), out_off);
+				if (err != RM_ERR_OK)
+					goto done;
+				out_off += out_n * sizeof(*out);
+				out_n = 0;
+			}
+		}
+		if (++rd->pos == rd->n) {
+			err = rm_spill_reader_fill(sp, rd);
+			if (err != RM_ERR_OK)
+				goto done;
+			if (rd->n == 0)
+				heap[0] = heap[--heap_n];													/* run is done */
+		}
+		rm_spill_heap_down(r, heap, heap_n, 0);
+	}
+	if (out_n > 0)
+		err = rm_spill_pwrite(sp->fd, out, out_n * sizeof(*out), out_off);
+	if (err == RM_ERR_OK && copy == 0) {													/* runs file is sorted file */
+		close(sp->fd);
+		sp->fd = sp->runs_fd;
+		sp->runs_fd = -1;
+	}
+
+done:
+	if (r != NULL) {
+		for (i = 0; i < sp->runs_n; ++i)
+			free(r[i].buf);
+	}
+	free(r);
+	free(heap);
+	free(out);
+	return err;
+}
+
+enum rm_error rm_spill_init(struct rm_spill *sp, size_t mem_bytes)
+{
+	memset(sp, 0, sizeof(*sp));
+	sp->page_no = UINT64_MAX;
+	sp->mem_bytes = rm_max(mem_bytes, (size_t) RM_SPILL_MEM_MIN);
+	sp->fd = rm_spill_tmp();
+	sp->runs_fd = rm_spill_tmp();
+	if (sp->fd == -1 || sp->runs_fd == -1) {
+		rm_spill_free(sp);
+		return RM_ERR_OPEN_TMP;
+	}
+	sp->recs_max = sp->mem_bytes / sizeof(*sp->recs);
+	sp->recs = malloc(sp->recs_max * sizeof(*sp->recs));
+	if (sp->recs == NULL) {
+		rm_spill_free(sp);
+		return RM_ERR_MEM;
+	}
+	return RM_ERR_OK;
+}
+
+void rm_spill_free(struct rm_spill *sp)
+{
+	if (sp->fd != -1)
+		close(sp->fd);
+	if (sp->runs_fd != -1)
+		close(sp->runs_fd);
+	sp->fd = sp->runs_fd = -1;
+	free(sp->recs);
+	free(sp->runs);
+	free(sp->filter);
+	free(sp->index);
+	free(sp->page);
+	free(sp->hits);
+	sp->recs = sp->page = sp->hits = NULL;
+	sp->runs = NULL;
+	sp->filter = NULL;
+	sp->index = NULL;
+	sp->pages_n = 0;
+}
+
+enum rm_error rm_spill_add(struct rm_spill *sp, const struct rm_ch_ch_ref *e)
+{
+	enum rm_error	err = RM_ERR_OK;
+
+	if (sp->recs_n == sp->recs_max) {
+		err = rm_spill_run_write(sp);
+		if (err != RM_ERR_OK)
+			return err;
+	}
+	sp->recs[sp->recs_n++] = *e;
+	++sp->entries_n;
+	return RM_ERR_OK;
+}
+
+enum rm_error rm_spill_finish(struct rm_spill *sp)
+{
+	size_t			used = 0, left = 0;
+	uint64_t		m = 0;
+	enum rm_error	err = RM_ERR_OK;
+
+	err = rm_spill_run_write(sp);
+	if (err != RM_ERR_OK)
+		return err;
+	free(sp->recs);																			/* runs are on disk, memory goes to filter and index */
+	sp->recs = NULL;
+	sp->recs_max = 0;
+	sp->stats.entries_n = sp->entries_n;
+	sp->stats.runs_n = sp->runs_n;
+	if (sp->entries_n == 0)
+		return RM_ERR_OK;
+
+	sp->page_recs = RM_SPILL_PAGE_RECS;
+	for (;;) {
+		sp->pages_n = sp->entries_n / sp->page_recs + (sp->entries_n % sp->page_recs ? 1 : 0);
+		if (sp->pages_n * sizeof(*sp->index) <= sp->mem_bytes / 8)
+			break;
+		sp->page_recs *= 2;
+	}
+	sp->index = malloc(sp->pages_n * sizeof(*sp->index));
+	sp->page = malloc(sp->page_recs * sizeof(*sp->page));
+	if (sp->index == NULL || sp->page == NULL)
+		return RM_ERR_MEM;
+
+	used = sp->pages_n * sizeof(*sp->index) + sp->page_recs * sizeof(*sp->page) + (sp->runs_n + 1) * RM_SPILL_IO_LEN;	/* merge buffers are held with filter */
+	left = (sp->mem_bytes > used ? sp->mem_bytes - used : 0);
+	sp->filter_bits = 15;
+	while (sp->filter_bits < 32 && ((uint64_t) 1 << (sp->filter_bits + 1)) / 8 <= left && ((uint64_t) 1 << sp->filter_bits) < sp->entries_n * 16)
+		++sp->filter_bits;
+	m = (uint64_t) 1 << sp->filter_bits;
+	if (sp->filter_bits == 32) {
+		sp->filter_k = 1;																	/* exact */
+	} else {
+		sp->filter_k = rm_max(1u, rm_min((unsigned int) ((m * 693 / 1000 + sp->entries_n / 2) / sp->entries_n), RM_SPILL_FILTER_K_MAX));	/* ln 2 * bits per checksum */
+	}
+	sp->filter = calloc(m / 64, sizeof(*sp->filter));
+	if (sp->filter == NULL)
+		return RM_ERR_MEM;
+	sp->stats.filter_bytes = m / 8;
+	sp->stats.filter_k = sp->filter_k;
+	sp->stats.index_bytes = sp->pages_n * sizeof(*sp->index);
+
+	return rm_spill_merge(sp);
+}
+
+/* Read page @p of sorted file, unless it is the one read last. */
+static enum rm_error rm_spill_page_read(struct rm_spill *sp, uint64_t p)
+{
+	uint64_t	first = p * sp->page_recs;
+	size_t		n = rm_min((uint64_t) sp->page_recs, sp->entries_n - first);
+
+	if (p == sp->page_no)
+		return RM_ERR_OK;
+	if (rm_spill_pread(sp->fd, sp->page, n * sizeof(*sp->page), first * sizeof(*sp->page)) != RM_ERR_OK) {
+		sp->page_no = UINT64_MAX;
+		return RM_ERR_READ;
+	}
+	sp->page_no = p;
+	sp->page_n = n;
+	++sp->stats.reads_n;
+	return RM_ERR_OK;
+}
+
+enum rm_error rm_spill_find(struct rm_spill *sp, uint32_t f_ch, const struct rm_ch_ch_ref **hits, size_t *hits_n)
+{
+	uint64_t					lo = 0, hi = sp->pages_n, mid = 0, p = 0;
+	size_t						i = 0, n = 0;
+	const struct rm_ch_ch_ref	*rec = NULL;
+	struct rm_ch_ch_ref			*grown = NULL;
+	enum rm_error				err = RM_ERR_OK;
+
+	*hits = sp->hits;
+	*hits_n = 0;
+	if (sp->pages_n == 0 || rm_spill_filter_test(sp, f_ch) == 0)
+		return RM_ERR_OK;
+	++sp->stats.probes_n;
+
+	while (lo < hi) {																		/* first page starting with @f_ch or bigger */
+		mid = lo + (hi - lo) / 2;
+		if (sp->index[mid] < f_ch)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (p = (lo > 0 ? lo - 1 : 0); p < sp->pages_n && sp->index[p] <= f_ch; ++p) {		/* @f_ch may start on page before */
+		err = rm_spill_page_read(sp, p);
+		if (err != RM_ERR_OK)
+			return err;
+		for (i = 0; i < sp->page_n; ++i) {
+			rec = &sp->page[i];
+			if (rec->ch_ch.f_ch < f_ch)
+				continue;
+			if (rec->ch_ch.f_ch > f_ch)
+				goto done;
+			if (n > 0 && memcmp(sp->hits[n - 1].ch_ch.s_ch.data, rec->ch_ch.s_ch.data, RM_STRONG_CHECK_BYTES) == 0)
+				continue;																	/* same content as block before */
+			if (n == sp->hits_max) {
+				grown = realloc(sp->hits, rm_max((size_t) 4, 2 * sp->hits_max) * sizeof(*grown));
+				if (grown == NULL)
+					return RM_ERR_MEM;
+				sp->hits = grown;
+				sp->hits_max = rm_max((size_t) 4, 2 * sp->hits_max);
+			}
+			sp->hits[n++] = *rec;
+		}
+	}
+
+done:
+	if (n == 0)
+		++sp->stats.false_n;
+	*hits = sp->hits;
+	*hits_n = n;
+	return RM_ERR_OK;
+}
@@ -5,6 +5,8 @@
  * @copyright   LGPLv2.1 */
 
 
+#define _GNU_SOURCE		/* splice */
+
 #include "rm_tcp.h"
 #include "rm.h"
 
@@ -58,6 +60,440 @@ int rm_tcp_tx_ch_ch(int fd, const struct rm_ch_ch_ref *e)
 	return 0;
 }
 
+enum rm_error rm_tcp_chan_init(struct rm_tcp_chan *c, int fd, enum rm_tcp_chan_id id, uint8_t framed)
+{
+	memset(c, 0, sizeof(struct rm_tcp_chan));
+	c->fd = fd;
+	c->id = id;
+	c->framed = framed;
+	if (framed) {
+		c->buf = malloc(RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX);						/* room for header so frame goes out in single write */
+		if (c->buf == NULL)
+			return RM_ERR_MEM;
+	}
+	return RM_ERR_OK;
+}
+
+void rm_tcp_chan_free(struct rm_tcp_chan *c)
+{
+	free(c->buf);
+	c->buf = NULL;
+	c->len = 0;
+	c->pos = 0;
+}
+
+enum rm_error rm_tcp_chan_flush(struct rm_tcp_chan *c)
+{
+	enum rm_error	err = RM_ERR_OK;
+
+	if (c->framed == 0 || c->len == 0)
+		return RM_ERR_OK;
+	c->buf[0] = c->id;
+	c->buf[1] = 0;
+	rm_serialize_u16(c->buf + 2, c->len);
+	err = rm_tcp_tx(c->fd, c->buf, RM_TCP_FRAME_HDR_LEN + c->len);
+	c->len = 0;
+	return err;
+}
+
+enum rm_error rm_tcp_chan_tx(struct rm_tcp_chan *c, const void *src, size_t bytes_n)
+{
+	enum rm_error	err = RM_ERR_OK;
+	size_t			n = 0;
+
+	if (c->framed == 0)
+		return rm_tcp_tx(c->fd, (void*) src, bytes_n);
+	while (bytes_n > 0) {
+		n = rm_min(bytes_n, RM_TCP_FRAME_LEN_MAX - c->len);
+		memcpy(c->buf + RM_TCP_FRAME_HDR_LEN + c->len, src, n);
+		c->len += n;
+		src = (const unsigned char*) src + n;
+		bytes_n -= n;
+		if (c->len == RM_TCP_FRAME_LEN_MAX) {
+			err = rm_tcp_chan_flush(c);
+			if (err != RM_ERR_OK)
+				return err;
+		}
+	}
+	return RM_ERR_OK;
+}
+
+/* Read @bytes_n bytes at @offset of @fd into @dst. */
+static enum rm_error rm_tcp_pread_all(int fd, unsigned char *dst, size_t bytes_n, uint64_t offset)
+{
+	ssize_t		n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = pread(fd, dst, bytes_n, offset);
+		} while ((n == -1) && (errno == EINTR));
+		if (n <= 0)																			/* error or file got shorter */
+			return RM_ERR_READ;
+		dst += n;
+		offset += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+/* TX @bytes_n bytes with MSG_MORE, so they go out together with what follows (frame header and its payload). */
+static enum rm_error rm_tcp_tx_more(int fd, const unsigned char *src, size_t bytes_n)
+{
+	ssize_t		n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = send(fd, src, bytes_n, MSG_MORE);
+		} while ((n == -1) && (errno == EINTR));
+		if (n == -1 && errno == ENOTSOCK)													/* not a socket, plain write */
+			return rm_tcp_tx(fd, (void*) src, bytes_n);
+		if (n < 0)
+			return RM_ERR_WRITE;
+		src += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+/* TX @bytes_n bytes of file @fd at @offset with sendfile, falls back to read and write
+ * (through frame buffer if channel is framed, it must be flushed) if file can't be sent that way. */
+static enum rm_error rm_tcp_chan_sendfile(struct rm_tcp_chan *c, int fd, uint64_t offset, size_t bytes_n)
+{
+	enum rm_error	err = RM_ERR_OK;
+	unsigned char	*buf = NULL;
+	size_t			buf_len = 0;
+	off_t			off = offset;
+	ssize_t			n = 0;
+
+	while (bytes_n > 0) {																	/* from page cache to socket */
+		do {
+			n = sendfile(c->fd, fd, &off, bytes_n);
+		} while ((n == -1) && (errno == EINTR));
+		if (n == -1 && (errno == EINVAL || errno == ENOSYS))								/* file can't be mmapped, copy the rest */
+			break;
+		if (n < 0)
+			return RM_ERR_WRITE;
+		if (n == 0)																			/* file got shorter */
+			return RM_ERR_READ;
+		c->sendfile_n += n;
+		bytes_n -= n;
+	}
+	if (bytes_n == 0)
+		return RM_ERR_OK;
+	if (c->framed) {
+		buf = c->buf;
+		buf_len = RM_TCP_FRAME_HDR_LEN + RM_TCP_FRAME_LEN_MAX;
+	} else {
+		buf_len = rm_min(bytes_n, RM_DELTA_RAW_BUF_LEN);
+		buf = malloc(buf_len);
+		if (buf == NULL)
+			return RM_ERR_MEM;
+	}
+	while (bytes_n > 0) {
+		n = rm_min(bytes_n, buf_len);
+		err = rm_tcp_pread_all(fd, buf, n, off);
+		if (err == RM_ERR_OK)
+			err = rm_tcp_tx(c->fd, buf, n);
+		if (err != RM_ERR_OK)
+			break;
+		off += n;
+		bytes_n -= n;
+	}
+	if (c->framed == 0)
+		free(buf);
+	return err;
+}
+
+enum rm_error rm_tcp_chan_tx_file(struct rm_tcp_chan *c, int fd, uint64_t offset, size_t bytes_n)
+{
+	enum rm_error	err = RM_ERR_OK;
+	unsigned char	hdr[RM_TCP_FRAME_HDR_LEN];
+	size_t			n = 0;
+
+	if (c->framed == 0)
+		return rm_tcp_chan_sendfile(c, fd, offset, bytes_n);
+	if (bytes_n < RM_TCP_FRAME_SENDFILE_MIN) {
+		while (bytes_n > 0) {																/* read straight into frame, with bytes around it */
+			n = rm_min(bytes_n, RM_TCP_FRAME_LEN_MAX - c->len);
+			err = rm_tcp_pread_all(fd, c->buf + RM_TCP_FRAME_HDR_LEN + c->len, n, offset);
+			if (err != RM_ERR_OK)
+				return err;
+			c->len += n;
+			offset += n;
+			bytes_n -= n;
+			if (c->len == RM_TCP_FRAME_LEN_MAX) {
+				err = rm_tcp_chan_flush(c);
+				if (err != RM_ERR_OK)
+					return err;
+			}
+		}
+		return RM_ERR_OK;
+	}
+	err = rm_tcp_chan_flush(c);																/* bytes buffered so far go first */
+	while (bytes_n > 0 && err == RM_ERR_OK) {												/* frames of own header and payload sent from page cache */
+		n = rm_min(bytes_n, RM_TCP_FRAME_LEN_MAX);
+		hdr[0] = c->id;
+		hdr[1] = 0;
+		rm_serialize_u16(hdr + 2, n);
+		err = rm_tcp_tx_more(c->fd, hdr, RM_TCP_FRAME_HDR_LEN);
+		if (err == RM_ERR_OK)
+			err = rm_tcp_chan_sendfile(c, fd, offset, n);
+		offset += n;
+		bytes_n -= n;
+	}
+	return err;
+}
+
+enum rm_error rm_tcp_chan_rx(struct rm_tcp_chan *c, void *dst, size_t bytes_n)
+{
+	enum rm_error	err = RM_ERR_OK;
+	unsigned char	hdr[RM_TCP_FRAME_HDR_LEN];
+	uint16_t		len = 0;
+	size_t			n = 0;
+
+	if (c->framed == 0)
+		return rm_tcp_rx(c->fd, dst, bytes_n);
+	while (bytes_n > 0) {
+		if (c->pos == c->len) {																/* next frame, read whole so stream ends exactly on frame boundary */
+			err = rm_tcp_rx(c->fd, hdr, RM_TCP_FRAME_HDR_LEN);
+			if (err != RM_ERR_OK)
+				return err;
+			rm_deserialize_u16(hdr + 2, &len);
+			if (hdr[0] != c->id || len == 0)
+				return RM_ERR_MSG_PT_UNKNOWN;
+			err = rm_tcp_rx(c->fd, c->buf, len);
+			if (err != RM_ERR_OK)
+				return err;
+			c->len = len;
+			c->pos = 0;
+		}
+		n = rm_min(bytes_n, c->len - c->pos);
+		memcpy(dst, c->buf + c->pos, n);
+		c->pos += n;
+		dst = (unsigned char*) dst + n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+enum rm_error rm_tcp_file_rx_init(struct rm_tcp_file_rx *r, uint8_t splice)
+{
+	r->pipe_fd[0] = r->pipe_fd[1] = -1;
+	r->tee_fd[0] = r->tee_fd[1] = -1;
+	r->buf = malloc(RM_DELTA_RAW_BUF_LEN);
+	if (r->buf == NULL)
+		return RM_ERR_MEM;
+	if (splice && pipe(r->pipe_fd) != 0)
+		r->pipe_fd[0] = r->pipe_fd[1] = -1;
+	if (r->pipe_fd[0] != -1 && pipe(r->tee_fd) != 0)
+		r->tee_fd[0] = r->tee_fd[1] = -1;
+	return RM_ERR_OK;
+}
+
+static void rm_tcp_file_rx_pipe_close(struct rm_tcp_file_rx *r)
+{
+	if (r->pipe_fd[0] != -1) {
+		close(r->pipe_fd[0]);
+		close(r->pipe_fd[1]);
+		r->pipe_fd[0] = r->pipe_fd[1] = -1;
+	}
+	if (r->tee_fd[0] != -1) {
+		close(r->tee_fd[0]);
+		close(r->tee_fd[1]);
+		r->tee_fd[0] = r->tee_fd[1] = -1;
+	}
+}
+
+void rm_tcp_file_rx_free(struct rm_tcp_file_rx *r)
+{
+	rm_tcp_file_rx_pipe_close(r);
+	free(r->buf);
+	r->buf = NULL;
+}
+
+/* Write @bytes_n bytes of @src to @fd at @offset. */
+static enum rm_error rm_tcp_pwrite_all(int fd, const unsigned char *src, size_t bytes_n, uint64_t offset)
+{
+	ssize_t		n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = pwrite(fd, src, bytes_n, offset);
+		} while ((n == -1) && (errno == EINTR));
+		if (n <= 0)
+			return RM_ERR_WRITE;
+		src += n;
+		offset += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+/* Read @bytes_n bytes of @fd at @offset back through buffer of @r into @md5. */
+static enum rm_error rm_tcp_file_rx_md5(struct rm_tcp_file_rx *r, int fd, uint64_t offset, size_t bytes_n, MD5_CTX *md5)
+{
+	size_t		n = 0;
+	ssize_t		read_n = 0;
+
+	for (; bytes_n > 0; bytes_n -= n, offset += n) {
+		n = rm_min(bytes_n, RM_DELTA_RAW_BUF_LEN);
+		do {
+			read_n = pread(fd, r->buf, n, offset);
+		} while ((read_n == -1) && (errno == EINTR));
+		if (read_n <= 0)
+			return RM_ERR_READ;
+		n = read_n;
+		md5_update(md5, r->buf, n);
+	}
+	return RM_ERR_OK;
+}
+
+/* Duplicate @bytes_n bytes at the front of pipe of @r into its tee pipe, returns number of them duplicated. */
+static size_t rm_tcp_file_rx_tee(struct rm_tcp_file_rx *r, size_t bytes_n)
+{
+	ssize_t		n = 0;
+
+	if (r->tee_fd[0] == -1)
+		return 0;
+	do {
+		n = tee(r->pipe_fd[0], r->tee_fd[1], bytes_n, SPLICE_F_NONBLOCK);						/* tee pipe is empty, it takes bytes of one splice */
+	} while ((n == -1) && (errno == EINTR));
+	if (n <= 0) {
+		if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+			close(r->tee_fd[0]);
+			close(r->tee_fd[1]);
+			r->tee_fd[0] = r->tee_fd[1] = -1;
+		}
+		return 0;
+	}
+	return n;
+}
+
+/* Drain @bytes_n bytes of tee pipe of @r into @md5. */
+static enum rm_error rm_tcp_file_rx_tee_md5(struct rm_tcp_file_rx *r, size_t bytes_n, MD5_CTX *md5)
+{
+	ssize_t		n = 0;
+
+	while (bytes_n > 0) {
+		do {
+			n = read(r->tee_fd[0], r->buf, rm_min(bytes_n, RM_DELTA_RAW_BUF_LEN));
+		} while ((n == -1) && (errno == EINTR));
+		if (n <= 0)
+			return RM_ERR_READ;
+		md5_update(md5, r->buf, n);
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+enum rm_error rm_tcp_file_rx_splice(struct rm_tcp_file_rx *r, int sock_fd, int fd, uint64_t offset, size_t bytes_n, MD5_CTX *md5, size_t *moved)
+{
+	loff_t			off = offset;
+	ssize_t			in = 0, out = 0;
+	size_t			left = 0, teed = 0;
+	uint8_t			file_splice = 1;
+	enum rm_error	err = RM_ERR_OK;
+
+	*moved = 0;
+	if (r->pipe_fd[0] == -1)
+		return RM_ERR_BAD_CALL;
+	do {
+		in = splice(sock_fd, NULL, r->pipe_fd[1], NULL, rm_min(bytes_n, RM_DELTA_RAW_BUF_LEN), SPLICE_F_MOVE);				/* pipe is empty, this doesn't block on it */
+	} while ((in == -1) && (errno == EINTR));
+	if (in == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		return RM_ERR_AGAIN;
+	if (in == -1 && (errno == EINVAL || errno == ENOSYS)) {														/* socket can't be spliced, nothing was taken from it */
+		rm_tcp_file_rx_pipe_close(r);
+		return RM_ERR_BAD_CALL;
+	}
+	if (in == 0)
+		return RM_ERR_EOF;
+	if (in < 0)
+		return RM_ERR_READ;
+	if (md5 != NULL)
+		teed = rm_tcp_file_rx_tee(r, in);																	/* digest from copy of pipe, file isn't read back */
+	for (left = in; left > 0; left -= out) {																		/* drain pipe into file */
+		out = -1;
+		if (file_splice) {
+			do {
+				out = splice(r->pipe_fd[0], NULL, fd, &off, left, SPLICE_F_MOVE);
+			} while ((out == -1) && (errno == EINTR));
+			if (out == -1 && (errno == EINVAL || errno == ENOSYS))												/* file can't be spliced, bytes are in pipe already */
+				file_splice = 0;
+			else if (out <= 0)
+				return RM_ERR_WRITE;
+		}
+		if (file_splice == 0) {
+			do {
+				out = read(r->pipe_fd[0], r->buf, rm_min(left, RM_DELTA_RAW_BUF_LEN));
+			} while ((out == -1) && (errno == EINTR));
+			if (out <= 0 || rm_tcp_pwrite_all(fd, r->buf, out, off) != RM_ERR_OK)
+				return RM_ERR_WRITE;
+			off += out;
+		}
+	}
+	*moved = in;
+	if (teed > 0)
+		err = rm_tcp_file_rx_tee_md5(r, teed, md5);
+	if (err == RM_ERR_OK && md5 != NULL && teed < (size_t) in)
+		err = rm_tcp_file_rx_md5(r, fd, offset + teed, in - teed, md5);										/* bytes not duplicated by tee are read back from page cache */
+	if (file_splice == 0)
+		rm_tcp_file_rx_pipe_close(r);																		/* read and write from now on */
+	return err;
+}
+
+enum rm_error rm_tcp_chan_rx_file(struct rm_tcp_chan *c, struct rm_tcp_file_rx *r, int fd, uint64_t offset, size_t bytes_n, MD5_CTX *md5)
+{
+	enum rm_error	err = RM_ERR_OK;
+	size_t			n = 0;
+
+	if (c->framed == 0) {
+		for (; bytes_n > 0; bytes_n -= n, offset += n) {
+			err = rm_tcp_file_rx_splice(r, c->fd, fd, offset, bytes_n, md5, &n);
+			if (err == RM_ERR_BAD_CALL)
+				break;																							/* read and write rest */
+			if (err != RM_ERR_OK)
+				return (err == RM_ERR_WRITE ? RM_ERR_WRITE : RM_ERR_READ);
+		}
+	}
+	for (; bytes_n > 0; bytes_n -= n, offset += n) {
+		n = rm_min(bytes_n, RM_DELTA_RAW_BUF_LEN);
+		err = rm_tcp_chan_rx(c, r->buf, n);
+		if (err != RM_ERR_OK)
+			return err;
+		err = rm_tcp_pwrite_all(fd, r->buf, n, offset);
+		if (err != RM_ERR_OK)
+			return err;
+		if (md5 != NULL)
+			md5_update(md5, r->buf, n);
+	}
+	return RM_ERR_OK;
+}
+
+int rm_tcp_chan_tx_ch_ch(void *arg, const struct rm_ch_ch_ref *e)
+{
+	unsigned char buf[RM_CH_CH_REF_SIZE], *pbuf;
+
+	pbuf = rm_serialize_u32(buf, e->ch_ch.f_ch);                                    /* serialize data */
+	memcpy(pbuf, &e->ch_ch.s_ch, RM_STRONG_CHECK_BYTES);
+	if (rm_tcp_chan_tx((struct rm_tcp_chan*) arg, buf, RM_CH_CH_SIZE) != RM_ERR_OK)
+		return -1;
+	return 0;
+}
+
+int rm_tcp_chan_tx_ch_ch_c(void *arg, const struct rm_ch_ch_ref *e)
+{
+	unsigned char buf[RM_CH_CH_PREFILTER_SIZE], *pbuf;
+
+	pbuf = rm_serialize_u32(buf, e->ch_ch.f_ch);
+	memcpy(pbuf, &e->ch_ch.s_ch, RM_STRONG_CHECK_BYTES);
+	pbuf += RM_STRONG_CHECK_BYTES;
+	rm_serialize_u32(pbuf, e->ch_ch.c_ch);
+	if (rm_tcp_chan_tx((struct rm_tcp_chan*) arg, buf, RM_CH_CH_PREFILTER_SIZE) != RM_ERR_OK)
+		return -1;
+	return 0;
+}
+
 int rm_tcp_tx_ch_ch_ref(int fd, const struct rm_ch_ch_ref *e)
 {
 	unsigned char buf[RM_CH_CH_REF_SIZE], *pbuf;
@@ -71,38 +507,75 @@ int rm_tcp_tx_ch_ch_ref(int fd, const struct rm_ch_ch_ref *e)
 	return 0;
 }
 
-enum rm_error rm_tcp_tx_msg_ack(int fd, enum rm_pt_type pt, enum rm_error status, struct rm_session *s)
+size_t rm_tcp_msg_ack_serialize(unsigned char *buf, enum rm_pt_type pt, enum rm_error status, struct rm_session *s)
 {	
 	struct rm_msg_hdr   hdr = {0};
 	union rm_msg_ack_u	ack;
-	union rm_msg_ack_u	raw_msg_ack;
 
 	memset(&ack, 0, sizeof(ack));
-	memset(&raw_msg_ack, 0, sizeof(raw_msg_ack));
 
 	hdr.pt = pt;
 	hdr.flags = status;
-	hdr.len = rm_calc_msg_len(&hdr);
-	hdr.hash = rm_core_hdr_hash(&hdr);
 	ack.msg_ack.hdr = &hdr;
+	if (pt == RM_PT_MSG_PUSH_ACK && s != NULL) {									/* if session is NULL this is ACK with error, delta port and checkums number are not valid numbers (will be TXed as 0), otherwise take values from PUSH RX session */
+		struct rm_session_push_rx *prvt = s->prvt;
+		ack.msg_push_ack.delta_port = prvt->delta_port;
+		ack.msg_push_ack.ch_ch_n = prvt->ch_ch_n;
+		ack.msg_push_ack.codec = prvt->codec;										/* length depends on it */
+		ack.msg_push_ack.codec_level = prvt->codec_level;
+		ack.msg_push_ack.roll = prvt->roll.type;
+		ack.msg_push_ack.prefilter = prvt->prefilter;
+	}
+	hdr.len = rm_calc_msg_len(&ack);
+	hdr.hash = rm_core_hdr_hash(&hdr);
 
 	switch (pt) {
 		case RM_PT_MSG_PUSH_ACK:
-			if (s != NULL) {														/* if session is NULL this is ACK with error, delta port and checkums number are not valid numbers (will be TXed as 0), otherwise take values from PUSH RX session */
-				struct rm_session_push_rx *prvt = s->prvt;
-				ack.msg_push_ack.delta_port = prvt->delta_port;
-				ack.msg_push_ack.ch_ch_n = prvt->ch_ch_n;
-			}
-			rm_serialize_msg_push_ack((unsigned char*)&raw_msg_ack, &ack.msg_push_ack);
+			rm_serialize_msg_push_ack(buf, &ack.msg_push_ack);
 			break;
 		case RM_PT_MSG_ACK:
-			rm_serialize_msg_ack((unsigned char*)&raw_msg_ack, &ack.msg_ack);
+			rm_serialize_msg_ack(buf, &ack.msg_ack);
 			break;
 		default:
-			return RM_ERR_BAD_CALL;
+			return 0;
 	}
+	return hdr.len;
+}
+
+enum rm_error rm_tcp_tx_msg_ack(int fd, enum rm_pt_type pt, enum rm_error status, struct rm_session *s)
+{
+	unsigned char	raw_msg_ack[RM_MSG_ACK_LEN_MAX];
+	size_t			len;
+
+	len = rm_tcp_msg_ack_serialize(raw_msg_ack, pt, status, s);
+	if (len == 0)
+		return RM_ERR_BAD_CALL;
+	return rm_tcp_tx(fd, raw_msg_ack, len);
+}
+
+size_t rm_tcp_msg_push_tree_ack_serialize(unsigned char *buf, enum rm_error status, uint64_t files_ok_n, uint64_t files_fail_n)
+{
+	struct rm_msg_hdr				hdr = {0};
+	struct rm_msg_push_tree_ack		ack;
+
+	memset(&ack, 0, sizeof(ack));
+	hdr.pt = RM_PT_MSG_PUSH_TREE_ACK;
+	hdr.flags = status;
+	ack.ack.hdr = &hdr;
+	ack.files_ok_n = files_ok_n;
+	ack.files_fail_n = files_fail_n;
+	hdr.len = rm_calc_msg_len(&ack);
+	hdr.hash = rm_core_hdr_hash(&hdr);
+
+	rm_serialize_msg_push_tree_ack(buf, &ack);
+	return hdr.len;
+}
+
+enum rm_error rm_tcp_tx_msg_push_tree_ack(int fd, enum rm_error status, uint64_t files_ok_n, uint64_t files_fail_n)
+{
+	unsigned char	raw_msg_ack[RM_MSG_PUSH_TREE_ACK_LEN];
 
-	return rm_tcp_tx(fd, &raw_msg_ack, hdr.len);
+	return rm_tcp_tx(fd, raw_msg_ack, rm_tcp_msg_push_tree_ack_serialize(raw_msg_ack, status, files_ok_n, files_fail_n));
 }
 
 int rm_tcp_set_socket_blocking_mode(int fd, uint8_t on)
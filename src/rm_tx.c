@@ -8,6 +8,25 @@
 #include "rm_tx.h"
 #include "rm_rx.h"
 
+#include <dirent.h>
+
+
+/* Checksums of @y go to spill instead of hashtable. */
+static int rm_tx_spill_add(void *arg, const struct rm_ch_ch_ref *e)
+{
+	return rm_spill_add(arg, e);
+}
+
+/* Seed of polynomial rolling checksum, new for each session. */
+static uint64_t rm_tx_roll_seed(void)
+{
+	uuid_t      u;
+	uint64_t    seed = 0;
+
+	uuid_generate(u);
+	memcpy(&seed, u, sizeof(seed));
+	return seed;
+}
 
 enum rm_error
 rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t copy_all_threshold,
@@ -20,9 +39,10 @@ rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t c
 	uint8_t     reference_file_exist = 0;
 	struct stat fs;
 	size_t      x_sz = 0, y_sz = 0, z_sz = 0, blocks_n_exp = 0, blocks_n = 0;
-	size_t                          bkt = 0;    /* hashtable deletion */
-	const struct rm_ch_ch_ref_hlink *e = NULL;
-	struct twhlist_node             *tmp = NULL;
+	struct twhlist_head             *h = NULL;  /* nonoverlapping checksums of @y */
+	uint8_t                         h_bits = 0;
+	struct rm_spill                 spill;
+	struct rm_spill                 *sp = NULL; /* or there, if hashtable wouldn't fit opt->mem_bytes */
 	struct rm_session               *s = NULL;
 	struct rm_session_push_local    *prvt = NULL;
 	/*char                            *y_copy = NULL; *cwd = NULL;*/
@@ -35,13 +55,14 @@ rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t c
 	const struct rm_delta_e *delta_e = NULL;
 	struct twlist_head      *lh = NULL;
 	struct rm_core_options	core_opt = {0};
+	struct rm_roll          roll;
+	uint64_t                roll_seed = 0;
 
 	if ((x == NULL) || (y == NULL) || (L == 0) || (rec_ctx == NULL) || (send_threshold == 0)) {
 		return RM_ERR_BAD_CALL;
 	}
-
-	TWDEFINE_HASHTABLE(h, RM_NONOVERLAPPING_HASH_BITS);
-	twhash_init(h);
+	roll_seed = rm_tx_roll_seed();
+	rm_roll_init(&roll, opt->roll, roll_seed, L);
 
 	/*cwd = getcwd(NULL, 0);
 	  if (cwd == NULL) {
@@ -88,9 +109,29 @@ rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t c
 		y_sz = fs.st_size;
 
 		blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0);   /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-		if (rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL) != RM_ERR_OK) {
-			err = RM_ERR_NONOVERLAPPING_INSERT;
-			goto  err_exit;
+		if (opt->mem_bytes > 0 && rm_rx_ch_ch_hash_bytes(blocks_n_exp) > opt->mem_bytes) {	/* hashtable wouldn't fit, sort checksums on disk */
+			err = rm_spill_init(&spill, opt->mem_bytes);
+			if (err != RM_ERR_OK)
+				goto err_exit;
+			sp = &spill;
+			if (rm_rx_insert_nonoverlapping_ch_ch_ref_arg(sp, f_y, y, NULL, 0, L, &roll, opt->prefilter, rm_tx_spill_add, blocks_n_exp, &blocks_n, NULL) != RM_ERR_OK) {
+				err = RM_ERR_NONOVERLAPPING_INSERT;
+				goto  err_exit;
+			}
+			err = rm_spill_finish(sp);
+			if (err != RM_ERR_OK)
+				goto err_exit;
+		} else {
+			h_bits = rm_rx_ch_ch_hash_bits(blocks_n_exp);	/* hashtable is sized for that many checksums */
+			h = rm_rx_ch_ch_hash_create(h_bits);
+			if (h == NULL) {
+				err = RM_ERR_MEM;
+				goto err_exit;
+			}
+			if (rm_rx_insert_nonoverlapping_ch_ch_ref_arg(NULL, f_y, y, h, h_bits, L, &roll, opt->prefilter, NULL, blocks_n_exp, &blocks_n, NULL) != RM_ERR_OK) {
+				err = RM_ERR_NONOVERLAPPING_INSERT;
+				goto  err_exit;
+			}
 		}
 		assert(blocks_n == blocks_n_exp && "rm_tx_local_push ASSERTION failed  indicating ERROR in blocks count either here or in rm_rx_insert_nonoverlapping_ch_ch_ref");
 	} else {
@@ -133,6 +174,7 @@ rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t c
 	}
 
 	core_opt.loglevel = opt->loglevel;
+	core_opt.delta_queue_bytes = opt->queue_bytes;
 	s = rm_session_create(RM_PUSH_LOCAL, &core_opt);    /* calc rolling checksums, produce delta vector and do file reconstruction in local session */
 	if (s == NULL) {
 		err = RM_ERR_CREATE_SESSION;
@@ -144,8 +186,13 @@ rm_tx_local_push(const char *x, const char *y, const char *z, size_t L, size_t c
 	s->rec_ctx.copy_tail_threshold = copy_tail_threshold;
 	s->rec_ctx.send_threshold = send_threshold;
 	s->rec_ctx.msg_push_len = 0;
+	s->rec_ctx.roll = roll.type;
+	s->rec_ctx.roll_seed = roll_seed;
+	s->rec_ctx.prefilter = opt->prefilter;
 	prvt = s->prvt; /* setup private session's arguments */
 	prvt->h = h;
+	prvt->h_bits = h_bits;
+	prvt->spill = sp;
 	s->f_x = f_x;
 	s->f_y = f_y;
 	s->f_z = f_z;
@@ -196,15 +243,24 @@ done:
 			fclose(f_y);
 			f_y = NULL;
 		}
-		bkt = 0;
-		twhash_for_each_safe(h, bkt, tmp, e, hlink) {
-			twhash_del((struct twhlist_node*)&e->hlink);
-			free((struct rm_ch_ch_ref_hlink*)e);
+		if (h != NULL)
+			rm_rx_ch_ch_hash_stats(h, h_bits, &s->rec_ctx.h_stats);
+		rm_rx_ch_ch_hash_free(h, h_bits);
+		h = NULL;
+		if (sp != NULL) {
+			s->rec_ctx.spill_stats = sp->stats;
+			rm_spill_free(sp);
+			sp = NULL;
 		}
 		if (z_sz != s->rec_ctx.rec_by_ref + s->rec_ctx.rec_by_raw) {
 			err = RM_ERR_FILE_SIZE_REC_MISMATCH;
 			goto err_exit;
 		}
+		if (s->rec_ctx.integrity == RM_INTEGRITY_MISMATCH) {	/* reconstructed @z differs from @x, don't rename it */
+			unlink(f_z_name);
+			err = RM_ERR_DIGEST_MISMATCH;
+			goto err_exit;
+		}
 		s->clk_cputime_stop = (double) clock() / CLOCKS_PER_SEC; 
 		cpu_time = s->clk_cputime_stop - s->clk_cputime_start;
 		clock_gettime(CLOCK_REALTIME, &s->clk_realtime_stop);    
@@ -270,13 +326,9 @@ err_exit:
 		fclose(f_z);
 		f_z = NULL;
 	}
-	if (reference_file_exist == 1) {
-		bkt = 0;
-		twhash_for_each_safe(h, bkt, tmp, e, hlink) {
-			twhash_del((struct twhlist_node*)&e->hlink);
-			free((struct rm_ch_ch_ref_hlink*)e);
-		}
-	}
+	rm_rx_ch_ch_hash_free(h, h_bits);
+	if (sp != NULL)
+		rm_spill_free(sp);
 	if (s != NULL) {
 		memcpy(rec_ctx, &s->rec_ctx, sizeof (struct rm_delta_reconstruct_ctx));
 		if (prvt != NULL) {
@@ -295,6 +347,55 @@ err_exit:
 	return err;
 }
 
+/* RX MSG_PUSH_ACK from control connection. Receiver replies with generic ACK
+ * instead if request can't be handled at all, status of request is returned
+ * then. Status of MSG_PUSH_ACK is left in @ack for the caller to check. */
+static enum rm_error rm_tx_msg_push_ack_rx(int fd, struct rm_msg_push_ack *ack)
+{
+	enum rm_error	err = RM_ERR_OK;
+	unsigned char	buf[RM_MSG_PUSH_ACK_PREFILTER_LEN];
+	size_t			len = RM_MSG_PUSH_ACK_LEN;
+
+	err = rm_tcp_rx(fd, buf, RM_MSG_ACK_LEN);														/* wait for incoming ACK, generic part */
+	if (err != RM_ERR_OK)																			/* RM_ERR_READ || RM_ERR_EOF */
+		return (err == RM_ERR_EOF ? RM_ERR_TCP_DISCONNECT : RM_ERR_TCP);
+
+	rm_deserialize_msg_ack(buf, &ack->ack);
+	if (ack->ack.hdr->pt != RM_PT_MSG_PUSH_ACK) {                                                   /* if not MSG_PUSH_ACK, i.e. generic ACK describibg some error occurred on the receiver side */
+		if (ack->ack.hdr->flags != RM_ERR_OK) {                                                     /* if request cannot be handled, maybe AUTH failure or RM_ERR_CHDIR_Z */
+			return ack->ack.hdr->flags;
+		} else {
+			RM_LOG_CRIT("ACK of type [%u] with status [%u] not expected here", ack->ack.hdr->pt, ack->ack.hdr->flags);
+		}
+	}
+	if (ack->ack.hdr->len >= RM_MSG_PUSH_ACK_CODEC_LEN && ack->ack.hdr->len <= RM_MSG_PUSH_ACK_PREFILTER_LEN) {	/* receiver accepted codec (and rolling checksum, prefilter) requested in MSG_PUSH */
+		len = ack->ack.hdr->len;
+	}
+	err = rm_tcp_rx(fd, buf + RM_MSG_ACK_LEN, len - RM_MSG_ACK_LEN);								/* wait for incoming MSG PUSH part of the ACK */
+	if (err != RM_ERR_OK)																			/* RM_ERR_READ || RM_ERR_EOF */
+		return (err == RM_ERR_EOF ? RM_ERR_TCP_DISCONNECT : RM_ERR_TCP);
+
+	err = rm_core_tcp_msg_ack_validate(buf, len);									/* validate potential ACK message: check header: hash, size and pt */
+	if (err != RM_ERR_OK) { /* bad message */
+		RM_LOG_ERR("Bad MSG_PUSH_ACK, error [%u]", err);
+		switch (err) {
+			case RM_ERR_FAIL: /* Invalid hash */
+				RM_LOG_ERR("Invalid hash [%u]", ack->ack.hdr->hash);
+				break;
+			case RM_ERR_MSG_PT_UNKNOWN: /* Unknown message type */
+				RM_LOG_ERR("Unknown payload type [%u]", ack->ack.hdr->pt);
+				break;
+			default: /* Unknown error */
+				RM_LOG_CRIT("Unknown error [%u]", err);
+				break;
+		}
+		return err;
+	}
+
+	rm_deserialize_msg_push_ack(buf, ack);
+	return RM_ERR_OK;
+}
+
 int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, size_t copy_all_threshold, size_t copy_tail_threshold, size_t send_threshold, rm_push_flags flags, struct rm_delta_reconstruct_ctx *rec_ctx, const char *addr, uint16_t port, uint16_t timeout_s, uint16_t timeout_us, const char **err_str, struct rm_tx_options *opt) {
 	enum rm_error       err = RM_ERR_OK;
 	FILE                *f_x = NULL;	/* original file, to be synced with @y */
@@ -304,19 +405,19 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	struct rm_session           *s = NULL;
 	struct rm_session_push_tx   *prvt = NULL;
 
-	struct timespec         real_time = {0};
+	struct timespec         real_time = {0}, clk_setup_done = {0};
 	double                  cpu_time = 0.0;
 
 	struct rm_msg_push  msg = {0};
 	unsigned char       *msg_raw = NULL;
-	unsigned char       *buf = NULL;
 	struct rm_msg_push_ack   ack;
 
 	struct rm_core_options	core_opt = {0};
 
-	size_t                          bkt = 0;    /* hashtable deletion */
-	const struct rm_ch_ch_ref_hlink *e = NULL;
-	struct twhlist_node             *tmp = NULL;
+	struct twhlist_head             *h = NULL;  /* synchronised between threads with sesion_local's hashtable mutex (h_mutex) */
+	uint8_t                         h_bits = 0;
+	struct rm_spill                 spill;
+	struct rm_spill                 *sp = NULL; /* checksums if hashtable wouldn't fit opt->mem_bytes */
 
 	(void) y;
 	(void) z;
@@ -327,9 +428,6 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 		return RM_ERR_BAD_CALL;
 	}
 
-	TWDEFINE_HASHTABLE(h, RM_NONOVERLAPPING_HASH_BITS);											/* synchronised between threads with sesion_local's hashtable mutex (h_mutex) */
-	twhash_init(h);
-
 	f_x = fopen(x, "rb");
 	if (f_x == NULL) 
 		return RM_ERR_OPEN_X;
@@ -347,6 +445,7 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	core_opt.loglevel = opt->loglevel;
 	core_opt.delta_conn_timeout_s = timeout_s;
 	core_opt.delta_conn_timeout_us = timeout_us;
+	core_opt.delta_queue_bytes = opt->queue_bytes;
 	s = rm_session_create(RM_PUSH_TX, &core_opt);                                               /* rx nonoverlapping checksums, calc rolling checksums, produce delta vector and tx to receiver */
 	if (s == NULL) {
 		err = RM_ERR_CREATE_SESSION;
@@ -364,10 +463,16 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 		goto err_exit;                                                                          /* RM_ERR_MEM */
 
 	msg.hdr->pt = RM_PT_MSG_PUSH;
-	msg.hdr->flags = flags;
+	msg.hdr->flags = flags | RM_BIT_7;															/* digest of @x will follow delta stream */
 	memcpy(msg.ssid, s->id, RM_UUID_LEN);
 	msg.L = L;
 	msg.bytes = x_sz;																			/* bytes to be xferred by transmitter (by delta and/or by raw) */
+	msg.delta_mode = RM_DELTA_MODE_FRAMED;														/* older receiver ignores it and replies with its delta port */
+	msg.codec = opt->codec;																		/* receiver tells in ACK if it accepts it */
+	msg.codec_level = opt->codec_level;
+	msg.roll = opt->roll;																		/* and rolling checksum */
+	msg.roll_seed = rm_tx_roll_seed();
+	msg.prefilter = opt->prefilter;
 
 	msg.x_sz = strlen(x) + 1;
 	strcpy(msg.x, x);                                                                           /* commandline tool will not pass here string longer than RM_FILE_LEN_MAX which is also the size of file name buffers in msg push */
@@ -397,71 +502,43 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	if (err != RM_ERR_OK)
 		goto err_exit;																				/* RM_ERR_WRITE */
 
-	if (rm_msg_push_ack_alloc(&ack) != RM_ERR_OK)													/* prepare for incoming ACK, allocate space for header == ACK */
-		goto err_exit;
-
-	buf = malloc(RM_MSG_PUSH_ACK_LEN);																/* buffer for incoming raw message header */
-	if (buf == NULL)
-		goto err_exit;
-
-	err = rm_tcp_rx(prvt->fd, buf, RM_MSG_ACK_LEN);													/* wait for incoming ACK, generic part */
-	if (err != RM_ERR_OK) {																			/* RM_ERR_READ || RM_ERR_EOF */
-		if (err == RM_ERR_EOF)
-			err = RM_ERR_TCP_DISCONNECT;
-		else
-			err = RM_ERR_TCP;
-		goto err_exit;
-	}
-
-	rm_deserialize_msg_ack(buf, &ack.ack);
-	if (ack.ack.hdr->pt != RM_PT_MSG_PUSH_ACK) {                                                    /* if not MSG_PUSH_ACK, i.e. generic ACK describibg some error occurred on the receiver side */
-		if (ack.ack.hdr->flags != RM_ERR_OK) {                                                      /* if request cannot be handled, maybe AUTH failure or RM_ERR_CHDIR_Z */
-			err = ack.ack.hdr->flags;
-			goto err_exit;
-		} else {
-			RM_LOG_CRIT("ACK of type [%u] with status [%u] not expected here", ack.ack.hdr->pt, ack.ack.hdr->flags);
-		}
-	}
-	err = rm_tcp_rx(prvt->fd, buf + RM_MSG_ACK_LEN, RM_MSG_PUSH_ACK_LEN - RM_MSG_ACK_LEN);          /* wait for incoming MSG PUSH part of the ACK */
-	if (err != RM_ERR_OK) {																			/* RM_ERR_READ || RM_ERR_EOF */
-		if (err == RM_ERR_EOF)
-			err = RM_ERR_TCP_DISCONNECT;
-		else
-			err = RM_ERR_TCP;
+	if (rm_msg_push_ack_alloc(&ack) != RM_ERR_OK) {													/* prepare for incoming ACK, allocate space for header == ACK */
+		err = RM_ERR_MEM;
 		goto err_exit;
 	}
-
-	err = rm_core_tcp_msg_ack_validate(buf, RM_MSG_PUSH_ACK_LEN);									/* validate potential ACK message: check header: hash, size and pt */
-	if (err != RM_ERR_OK) { /* bad message */
-		RM_LOG_ERR("Bad MSG_PUSH_ACK, error [%u]", err);
-		switch (err) {
-			case RM_ERR_FAIL: /* Invalid hash */
-				RM_LOG_ERR("Invalid hash [%u]", ack.ack.hdr->hash);
-				break;
-			case RM_ERR_MSG_PT_UNKNOWN: /* Unknown message type */
-				RM_LOG_ERR("Unknown payload type [%u]", ack.ack.hdr->pt);
-				break;
-			default: /* Unknown error */
-				RM_LOG_CRIT("Unknown error [%u]", err);
-				break;
-		}
+	err = rm_tx_msg_push_ack_rx(prvt->fd, &ack);
+	if (err != RM_ERR_OK)
 		goto err_exit;
-	}
-
-	rm_deserialize_msg_push_ack(buf, &ack);
-	free(buf);
-	buf = NULL;
-
 	if (ack.ack.hdr->flags != RM_ERR_OK) {                                                          /* if request cannot be handled */
 		err = ack.ack.hdr->flags;
 		goto err_exit;
 	}
 	prvt->msg_push_ack = &ack;
+	clock_gettime(CLOCK_REALTIME, &clk_setup_done);
+	rm_util_calc_timespec_diff(&s->clk_realtime_start, &clk_setup_done, &s->rec_ctx.time_setup);
 
-	prvt->session_local.h = h;																		/* shared hashtable, assign pointer before launching checksums receiver thread */
-	err = rm_launch_thread(&prvt->ch_ch_rx_tid, rm_session_ch_ch_rx_f, s, PTHREAD_CREATE_JOINABLE);	/* start RX nonoverlapping checksums thread (insert checksums into hashtable) */
-	if (err != RM_ERR_OK) {
-		err = RM_ERR_CH_CH_RX_THREAD_LAUNCH;
+	if (opt->mem_bytes > 0 && rm_rx_ch_ch_hash_bytes(ack.ch_ch_n) > opt->mem_bytes) {				/* hashtable wouldn't fit, checksums are sorted on disk as they come */
+		err = rm_spill_init(&spill, opt->mem_bytes);
+		if (err != RM_ERR_OK)
+			goto err_exit;
+		sp = &spill;
+	} else {
+		h_bits = rm_rx_ch_ch_hash_bits(ack.ch_ch_n);												/* hashtable is sized for checksums receiver announced */
+		h = rm_rx_ch_ch_hash_create(h_bits);
+		if (h == NULL) {
+			err = RM_ERR_MEM;
+			goto err_exit;
+		}
+	}
+	prvt->session_local.h = h;																		/* shared hashtable, assign pointer before receiving checksums */
+	prvt->session_local.h_bits = h_bits;
+	prvt->session_local.spill = sp;
+	s->rec_ctx.roll = (ack.roll == msg.roll ? ack.roll : RM_ROLL_FAST);								/* older receiver computed fast checksums */
+	s->rec_ctx.roll_seed = msg.roll_seed;
+	s->rec_ctx.prefilter = (ack.prefilter == msg.prefilter ? ack.prefilter : RM_PREFILTER_NONE);
+	rm_session_ch_ch_rx_f(s);																		/* RX nonoverlapping checksums (insert into hashtable) before rolling starts, so it doesn't run on incomplete table */
+	if (prvt->ch_ch_rx_status != RM_RX_STATUS_OK) {
+		err = RM_ERR_CH_CH_RX_THREAD;
 		goto err_exit;
 	}
 
@@ -475,6 +552,7 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	s->f_y = NULL;
 	s->f_z = NULL;
 	prvt->session_local.delta_tx_f = rm_roll_proc_cb_1;												/* enqueue into local session's tx_delta_e_queue for delta_rx_tid thread consumption */
+	prvt->session_local.delta_raw_ranges = (ack.codec == RM_CODEC_NONE);							/* literals are sent from @x unless they get compressed */
 	s->f_x_sz = x_sz;
 
 	err = rm_launch_thread(&prvt->session_local.delta_tx_tid, rm_session_delta_tx_f, s, PTHREAD_CREATE_JOINABLE); /* start tx delta vec thread (enqueue delta elements and signal to delta_rx_tid thread */
@@ -487,21 +565,16 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 		err = RM_ERR_DELTA_RX_THREAD_LAUNCH;
 		goto err_exit;
 	}
-	pthread_join(prvt->ch_ch_rx_tid, NULL);
 	pthread_join(prvt->session_local.delta_tx_tid, NULL);
 	pthread_join(prvt->session_local.delta_rx_tid, NULL);
-	if (prvt->ch_ch_rx_status != RM_TX_STATUS_OK) {
-		err = RM_ERR_CH_CH_RX_THREAD;
+	if (prvt->session_local.delta_rx_status != RM_RX_STATUS_OK) {									/* checked first, as rolling proc fails too once delta transmitter stops taking deltas */
+		err = RM_ERR_DELTA_RX_THREAD;
 		goto err_exit;
 	}
 	if (prvt->session_local.delta_tx_status != RM_TX_STATUS_OK) {
 		err = RM_ERR_DELTA_TX_THREAD;
 		goto err_exit;
 	}
-	if (prvt->session_local.delta_rx_status != RM_RX_STATUS_OK) {
-		err = RM_ERR_DELTA_RX_THREAD;
-		goto err_exit;
-	}
 
 	pthread_mutex_lock(&s->mutex);
 	if (s->f_x != NULL) {
@@ -519,10 +592,16 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	rm_util_calc_timespec_diff(&s->clk_realtime_start, &s->clk_realtime_stop, &real_time);
 	s->rec_ctx.time_cpu = cpu_time;
 	s->rec_ctx.time_real = real_time;
+	if (h != NULL)
+		rm_rx_ch_ch_hash_stats(h, h_bits, &s->rec_ctx.h_stats);
+	if (sp != NULL)
+		s->rec_ctx.spill_stats = sp->stats;
 
 	memcpy(rec_ctx, &s->rec_ctx, sizeof (struct rm_delta_reconstruct_ctx));
 
 	pthread_mutex_unlock(&s->mutex);
+	close(prvt->fd);																				/* control connection */
+	prvt->fd = -1;
 	rm_session_free(s);
 	s = NULL;
 
@@ -533,11 +612,9 @@ int rm_tx_remote_push(const char *x, const char *y, const char *z, size_t L, siz
 	free(ack.ack.hdr);
 	ack.ack.hdr = NULL;
 
-	bkt = 0;
-	twhash_for_each_safe(h, bkt, tmp, e, hlink) {
-		twhash_del((struct twhlist_node*)&e->hlink);
-		free((struct rm_ch_ch_ref_hlink*)e);
-	}
+	rm_rx_ch_ch_hash_free(h, h_bits);
+	if (sp != NULL)
+		rm_spill_free(sp);
 
 	return RM_ERR_OK;
 
@@ -547,10 +624,6 @@ err_exit:
 		free(ack.ack.hdr);
 		ack.ack.hdr = NULL;
 	}
-	if (buf != NULL) {
-		free(buf);
-		buf = NULL;
-	}
 
 	switch (err) {
 
@@ -572,6 +645,8 @@ err_exit:
 
 			if (prvt->ch_ch_rx_status == RM_RX_STATUS_CH_CH_RX_TCP_DISCONNECT)
 				RM_LOG_ERR("%s", "Receiver closed checksums channel prematurely\n");
+			else if (prvt->ch_ch_rx_status == RM_RX_STATUS_CH_CH_RX_SPILL)
+				RM_LOG_ERR("%s", "Can't spill checksums to disk\n");
 			else
 				RM_LOG_ERR("%s", "Error on checksums channel\n");
 			break;
@@ -611,15 +686,576 @@ err_exit:
 		s->f_z = NULL;
 	}
 	if (s != NULL) {
+		if (prvt != NULL && prvt->fd != -1) {
+			close(prvt->fd);
+			prvt->fd = -1;
+		}
 		rm_session_free(s);
 		s = NULL;
 	}
 
-	bkt = 0;
-	twhash_for_each_safe(h, bkt, tmp, e, hlink) {
-		twhash_del((struct twhlist_node*)&e->hlink);
-		free((struct rm_ch_ch_ref_hlink*)e);
+	rm_rx_ch_ch_hash_free(h, h_bits);
+	if (sp != NULL)
+		rm_spill_free(sp);
+
+	return err;
+}
+
+/* Regular file of directory push. */
+struct rm_tx_tree_entry {
+	char		*path;																				/* relative to @x */
+	uint64_t	bytes;
+};
+
+/* File in flight: ACK and checksums received, rolling proc queues its deltas, deltas not sent yet. */
+struct rm_tx_tree_slot {
+	struct rm_msg_push_ack	ack;
+	struct rm_session		*s;																		/* NULL if receiver rejected the file or file is empty */
+	struct twhlist_head		*h;																		/* checksums of file, sized from ACK */
+	uint8_t					h_bits;
+	struct rm_spill			spill;
+	struct rm_spill			*sp;																	/* checksums of file if hashtable wouldn't fit its share of memory limit */
+	uint8_t					rolling;																/* rolling proc thread has been launched and not joined yet */
+	enum rm_error			err;																	/* rolling proc couldn't be started */
+};
+
+/* State of directory push shared by checksums receiver and delta transmitter (main thread). */
+struct rm_tx_tree {
+	int							fd;
+	struct rm_tx_tree_entry		*entries;
+	uint64_t					entries_n;
+	struct rm_tx_tree_slot		*slots;																/* indexed by file number modulo @inflight_n */
+	uint16_t					inflight_n;
+	uint64_t					ready_n;															/* files for which ACK and checksums have been received */
+	uint64_t					done_n;																/* files for which deltas have been sent */
+	uint8_t						abort;
+	pthread_mutex_t				mutex;
+	pthread_cond_t				signal;
+	struct rm_core_options		core_opt;
+	size_t						mem_bytes;															/* limit on memory of checksums of each file in flight, 0: none */
+	const char					*x;
+	size_t						L, copy_all_threshold, copy_tail_threshold, send_threshold;
+	uint8_t						roll, prefilter;
+	uint64_t					roll_seed;
+};
+
+static int rm_tx_tree_entry_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct rm_tx_tree_entry*) a)->path, ((const struct rm_tx_tree_entry*) b)->path);
+}
+
+/* Append regular files found recursively in @root/@rel to @t->entries. Symlinks and special files are skipped. */
+static enum rm_error rm_tx_tree_walk(struct rm_tx_tree *t, const char *root, const char *rel, uint64_t *cap)
+{
+	enum rm_error			err = RM_ERR_OK;
+	DIR						*dir = NULL;
+	struct dirent			*de = NULL;
+	struct stat				fs = {0};
+	char					path[PATH_MAX], rel_path[PATH_MAX];
+	struct rm_tx_tree_entry	*entries = NULL;
+	int						n = 0;
+
+	n = snprintf(path, PATH_MAX, "%s%s%s", root, (rel[0] != '\0' ? "/" : ""), rel);
+	if (n < 0 || n > PATH_MAX - 1)
+		return RM_ERR_TOO_MUCH_REQUESTED;
+	dir = opendir(path);
+	if (dir == NULL)
+		return RM_ERR_DIR;
+
+	while ((de = readdir(dir)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+		n = snprintf(rel_path, PATH_MAX, "%s%s%s", rel, (rel[0] != '\0' ? "/" : ""), de->d_name);
+		if (n < 0 || n > RM_FILE_LEN_MAX - 1) {																/* must fit into MSG_PUSH_FILE */
+			err = RM_ERR_TOO_MUCH_REQUESTED;
+			goto done;
+		}
+		n = snprintf(path, PATH_MAX, "%s/%s", root, rel_path);
+		if (n < 0 || n > PATH_MAX - 1) {
+			err = RM_ERR_TOO_MUCH_REQUESTED;
+			goto done;
+		}
+		if (lstat(path, &fs) != 0) {
+			err = RM_ERR_FSTAT_X;
+			goto done;
+		}
+		if (S_ISDIR(fs.st_mode)) {
+			err = rm_tx_tree_walk(t, root, rel_path, cap);
+			if (err != RM_ERR_OK)
+				goto done;
+		} else if (S_ISREG(fs.st_mode)) {
+			if (t->entries_n == *cap) {
+				*cap = (*cap == 0 ? 64 : 2 * *cap);
+				entries = realloc(t->entries, *cap * sizeof(struct rm_tx_tree_entry));
+				if (entries == NULL) {
+					err = RM_ERR_MEM;
+					goto done;
+				}
+				t->entries = entries;
+			}
+			t->entries[t->entries_n].path = strdup(rel_path);
+			if (t->entries[t->entries_n].path == NULL) {
+				err = RM_ERR_MEM;
+				goto done;
+			}
+			t->entries[t->entries_n].bytes = fs.st_size;
+			++t->entries_n;
+		}
+	}
+
+done:
+	closedir(dir);
+	return err;
+}
+
+/* TX file list as MSG_PUSH_FILE messages, coalesced into writes of RM_TREE_LIST_BUF_LEN bytes. */
+static enum rm_error rm_tx_tree_list_tx(struct rm_tx_tree *t)
+{
+	enum rm_error			err = RM_ERR_OK;
+	struct rm_msg_hdr		hdr = {0};
+	struct rm_msg_push_file	msg;
+	unsigned char			*buf = NULL;
+	size_t					off = 0;
+	uint64_t				i = 0;
+
+	buf = malloc(RM_TREE_LIST_BUF_LEN);
+	if (buf == NULL)
+		return RM_ERR_MEM;
+	memset(&msg, 0, sizeof(msg));
+	msg.hdr = &hdr;
+	hdr.pt = RM_PT_MSG_PUSH_FILE;
+	for (i = 0; i < t->entries_n; ++i) {
+		msg.bytes = t->entries[i].bytes;
+		msg.path_sz = strlen(t->entries[i].path) + 1;
+		strcpy(msg.path, t->entries[i].path);
+		hdr.len = rm_calc_msg_len(&msg);
+		hdr.hash = rm_core_hdr_hash(&hdr);
+		if (off + hdr.len > RM_TREE_LIST_BUF_LEN) {
+			err = rm_tcp_write(t->fd, buf, off);
+			if (err != RM_ERR_OK)
+				goto done;
+			off = 0;
+		}
+		rm_serialize_msg_push_file(buf + off, &msg);
+		off += hdr.len;
+	}
+	if (off > 0)
+		err = rm_tcp_write(t->fd, buf, off);
+
+done:
+	free(buf);
+	return err;
+}
+
+static void rm_tx_tree_slot_release(struct rm_tx_tree_slot *slot)
+{
+	struct rm_session_push_tx	*prvt = NULL;
+
+	if (slot->s == NULL)
+		return;
+	if (slot->rolling) {																			/* deltas won't be sent, let rolling proc fail on next element */
+		prvt = slot->s->prvt;
+		rm_session_delta_queue_close(&prvt->session_local);
+		pthread_join(prvt->session_local.delta_tx_tid, NULL);
+		slot->rolling = 0;
+	}
+	if (slot->s->f_x != NULL) {
+		fclose(slot->s->f_x);
+		slot->s->f_x = NULL;
+	}
+	rm_session_free(slot->s);
+	slot->s = NULL;
+	rm_rx_ch_ch_hash_free(slot->h, slot->h_bits);
+	slot->h = NULL;
+	if (slot->sp != NULL) {
+		rm_spill_free(slot->sp);
+		slot->sp = NULL;
+	}
+}
+
+/* Open file and start rolling it over checksums received for it, its deltas are queued
+ * until delta transmitter gets to the file. */
+static enum rm_error rm_tx_tree_file_start(struct rm_tx_tree *t, struct rm_tx_tree_slot *slot, const struct rm_tx_tree_entry *e)
+{
+	struct rm_session			*s = slot->s;
+	struct rm_session_push_tx	*prvt = s->prvt;
+	struct stat					fs = {0};
+	char						path[PATH_MAX];
+
+	if ((size_t) snprintf(path, PATH_MAX, "%s/%s", t->x, e->path) > PATH_MAX - 1)
+		return RM_ERR_TOO_MUCH_REQUESTED;
+	s->f_x = fopen(path, "rb");
+	if (s->f_x == NULL)
+		return RM_ERR_OPEN_X;
+	if (fstat(fileno(s->f_x), &fs) != 0)
+		return RM_ERR_FSTAT_X;
+	if ((uint64_t) fs.st_size != e->bytes)																	/* file changed since the list was sent, receiver expects that many bytes */
+		return RM_ERR_FILE_SIZE;
+	s->f_x_sz = e->bytes;
+
+	s->rec_ctx.method = RM_RECONSTRUCT_METHOD_DELTA_RECONSTRUCTION;
+	s->rec_ctx.L = t->L;
+	s->rec_ctx.copy_all_threshold = t->copy_all_threshold;
+	s->rec_ctx.copy_tail_threshold = t->copy_tail_threshold;
+	s->rec_ctx.send_threshold = t->send_threshold;
+	s->rec_ctx.roll = (prvt->msg_push_ack->roll == t->roll ? t->roll : RM_ROLL_FAST);						/* older receiver computed fast checksums */
+	s->rec_ctx.roll_seed = t->roll_seed;
+	s->rec_ctx.prefilter = (prvt->msg_push_ack->prefilter == t->prefilter ? t->prefilter : RM_PREFILTER_NONE);
+	prvt->session_local.delta_tx_f = rm_roll_proc_cb_1;
+	prvt->session_local.delta_raw_ranges = (prvt->msg_push_ack->codec == RM_CODEC_NONE);					/* literals are sent from @x unless they get compressed */
+
+	if (rm_launch_thread(&prvt->session_local.delta_tx_tid, rm_session_delta_tx_f, s, PTHREAD_CREATE_JOINABLE) != RM_ERR_OK)
+		return RM_ERR_DELTA_TX_THREAD_LAUNCH;
+	slot->rolling = 1;
+	return RM_ERR_OK;
+}
+
+/* RX ACKs and checksums of files in list order, staying at most @inflight_n files ahead of delta transmitter,
+ * and start rolling proc of each file once its checksums are in. */
+static void* rm_tx_tree_ch_ch_rx_f(void *arg)
+{
+	struct rm_tx_tree			*t = arg;
+	struct rm_tx_tree_slot		*slot = NULL;
+	struct rm_session_push_tx	*prvt = NULL;
+	enum rm_error				err = RM_ERR_OK;
+	uint64_t					i = 0;
+
+	for (i = 0; i < t->entries_n; ++i) {
+		pthread_mutex_lock(&t->mutex);
+		while (t->abort == 0 && i - t->done_n >= t->inflight_n)
+			pthread_cond_wait(&t->signal, &t->mutex);
+		if (t->abort != 0) {
+			pthread_mutex_unlock(&t->mutex);
+			return NULL;
+		}
+		slot = &t->slots[i % t->inflight_n];
+		pthread_mutex_unlock(&t->mutex);
+
+		err = rm_tx_msg_push_ack_rx(t->fd, &slot->ack);
+		if (err != RM_ERR_OK)
+			goto fail;
+		if (slot->ack.ack.hdr->flags == RM_ERR_OK && t->entries[i].bytes > 0) {
+			slot->s = rm_session_create(RM_PUSH_TX, &t->core_opt);
+			if (slot->s == NULL)
+				goto fail;
+			prvt = slot->s->prvt;
+			prvt->fd = t->fd;																				/* checksums and deltas go over control connection */
+			prvt->msg_push_ack = &slot->ack;
+			if (t->mem_bytes > 0 && rm_rx_ch_ch_hash_bytes(slot->ack.ch_ch_n) > t->mem_bytes) {
+				if (rm_spill_init(&slot->spill, t->mem_bytes) != RM_ERR_OK)
+					goto fail;
+				slot->sp = &slot->spill;
+			} else {
+				slot->h_bits = rm_rx_ch_ch_hash_bits(slot->ack.ch_ch_n);
+				slot->h = rm_rx_ch_ch_hash_create(slot->h_bits);
+				if (slot->h == NULL)
+					goto fail;
+			}
+			prvt->session_local.h = slot->h;
+			prvt->session_local.h_bits = slot->h_bits;
+			prvt->session_local.spill = slot->sp;
+			rm_session_ch_ch_rx_f(slot->s);
+			if (prvt->ch_ch_rx_status != RM_RX_STATUS_OK)
+				goto fail;
+			slot->err = rm_tx_tree_file_start(t, slot, &t->entries[i]);										/* roll it while deltas of files before it are sent */
+		}
+
+		pthread_mutex_lock(&t->mutex);
+		t->ready_n = i + 1;
+		pthread_cond_broadcast(&t->signal);
+		pthread_mutex_unlock(&t->mutex);
+	}
+	return NULL;
+
+fail:
+	RM_LOG_ERR("Directory push: can't RX ACK or checksums of file [%" PRIu64 "] [%s]", i, t->entries[i].path);
+	pthread_mutex_lock(&t->mutex);
+	t->abort = 1;
+	pthread_cond_broadcast(&t->signal);
+	pthread_mutex_unlock(&t->mutex);
+	return NULL;
+}
+
+static void rm_tx_tree_stats_add(struct rm_delta_reconstruct_ctx *sum, const struct rm_delta_reconstruct_ctx *rec_ctx)
+{
+	uint32_t	i = 0;
+
+	sum->rec_by_ref += rec_ctx->rec_by_ref;
+	sum->rec_by_raw += rec_ctx->rec_by_raw;
+	sum->delta_ref_n += rec_ctx->delta_ref_n;
+	sum->delta_raw_n += rec_ctx->delta_raw_n;
+	sum->rec_by_tail += rec_ctx->rec_by_tail;
+	sum->rec_by_zero_diff += rec_ctx->rec_by_zero_diff;
+	sum->delta_tail_n += rec_ctx->delta_tail_n;
+	sum->delta_zero_diff_n += rec_ctx->delta_zero_diff_n;
+	sum->collisions_1st_level += rec_ctx->collisions_1st_level;
+	sum->collisions_2nd_level += rec_ctx->collisions_2nd_level;
+	sum->collisions_3rd_level += rec_ctx->collisions_3rd_level;
+	sum->next_tried_n += rec_ctx->next_tried_n;
+	sum->next_hit_n += rec_ctx->next_hit_n;
+	sum->delta_queue_limit = rec_ctx->delta_queue_limit;
+	sum->delta_queue_bytes_peak = rm_max(sum->delta_queue_bytes_peak, rec_ctx->delta_queue_bytes_peak);
+	sum->delta_queue_stalls_n += rec_ctx->delta_queue_stalls_n;
+	sum->delta_queue_stall_time += rec_ctx->delta_queue_stall_time;
+	sum->codec = rm_max(sum->codec, rec_ctx->codec);
+	sum->codec_level = rm_max(sum->codec_level, rec_ctx->codec_level);
+	sum->roll = rm_max(sum->roll, rec_ctx->roll);
+	sum->prefilter = rm_max(sum->prefilter, rec_ctx->prefilter);
+	sum->prefilter_pass_n += rec_ctx->prefilter_pass_n;
+	sum->prefilter_reject_n += rec_ctx->prefilter_reject_n;
+	sum->rec_by_raw_z += rec_ctx->rec_by_raw_z;
+	sum->rec_by_raw_stored += rec_ctx->rec_by_raw_stored;
+	sum->h_stats.bits = rm_max(sum->h_stats.bits, rec_ctx->h_stats.bits);
+	sum->h_stats.buckets_n += rec_ctx->h_stats.buckets_n;
+	sum->h_stats.entries_n += rec_ctx->h_stats.entries_n;
+	sum->h_stats.used_n += rec_ctx->h_stats.used_n;
+	sum->h_stats.chain_max = rm_max(sum->h_stats.chain_max, rec_ctx->h_stats.chain_max);
+	sum->spill_stats.entries_n += rec_ctx->spill_stats.entries_n;
+	sum->spill_stats.runs_n += rec_ctx->spill_stats.runs_n;
+	sum->spill_stats.filter_bytes = rm_max(sum->spill_stats.filter_bytes, rec_ctx->spill_stats.filter_bytes);
+	sum->spill_stats.filter_k = rm_max(sum->spill_stats.filter_k, rec_ctx->spill_stats.filter_k);
+	sum->spill_stats.index_bytes = rm_max(sum->spill_stats.index_bytes, rec_ctx->spill_stats.index_bytes);
+	sum->spill_stats.probes_n += rec_ctx->spill_stats.probes_n;
+	sum->spill_stats.false_n += rec_ctx->spill_stats.false_n;
+	sum->spill_stats.reads_n += rec_ctx->spill_stats.reads_n;
+	for (i = 0; i < RM_HASH_CHAIN_HIST_N; ++i)
+		sum->h_stats.chain_hist[i] += rec_ctx->h_stats.chain_hist[i];
+}
+
+/* TX deltas of file rolled meanwhile, followed by digest. */
+static enum rm_error rm_tx_tree_file_tx(struct rm_tx_tree_slot *slot, struct rm_delta_reconstruct_ctx *rec_ctx)
+{
+	struct rm_session			*s = slot->s;
+	struct rm_session_push_tx	*prvt = s->prvt;
+
+	if (slot->err != RM_ERR_OK)
+		return slot->err;
+	rm_session_delta_rx_f_local(s);																			/* TX deltas and digest, ACK says deltas follow on control connection */
+	pthread_join(prvt->session_local.delta_tx_tid, NULL);
+	slot->rolling = 0;
+	if (prvt->session_local.delta_rx_status != RM_RX_STATUS_OK)											/* rolling proc fails too once delta transmitter stops taking deltas */
+		return RM_ERR_DELTA_RX_THREAD;
+	if (prvt->session_local.delta_tx_status != RM_TX_STATUS_OK)
+		return RM_ERR_DELTA_TX_THREAD;
+
+	if (slot->h != NULL)
+		rm_rx_ch_ch_hash_stats(slot->h, slot->h_bits, &s->rec_ctx.h_stats);
+	if (slot->sp != NULL)
+		s->rec_ctx.spill_stats = slot->sp->stats;
+	rm_tx_tree_stats_add(rec_ctx, &s->rec_ctx);
+	return RM_ERR_OK;
+}
+
+enum rm_error rm_tx_remote_push_tree(const char *x, const char *y, const char *z, size_t L, size_t copy_all_threshold,
+		size_t copy_tail_threshold, size_t send_threshold, rm_push_flags flags,
+		struct rm_tx_tree_stats *stats, const char *addr, uint16_t port, uint16_t timeout_s, uint16_t timeout_us, const char **err_str, struct rm_tx_options *opt)
+{
+	enum rm_error				err = RM_ERR_OK;
+	struct rm_tx_tree			t;
+	struct stat					fs = {0};
+	uint64_t					cap = 0, i = 0;
+	struct rm_msg_hdr			hdr = {0};
+	struct rm_msg_push_tree		msg;
+	struct rm_msg_push_tree_ack	tree_ack;
+	unsigned char				*msg_raw = NULL;
+	unsigned char				buf[RM_MSG_PUSH_TREE_ACK_LEN];
+	uuid_t						ssid;
+	pthread_t					ch_ch_rx_tid;
+	uint8_t						ch_ch_rx_launched = 0;
+	struct rm_tx_tree_slot		*slot = NULL;
+
+	if ((x == NULL) || (y == NULL) || (L == 0) || (stats == NULL) || (send_threshold == 0))
+		return RM_ERR_BAD_CALL;
+
+	memset(stats, 0, sizeof(struct rm_tx_tree_stats));
+	memset(&t, 0, sizeof(t));
+	t.fd = -1;
+	pthread_mutex_init(&t.mutex, NULL);
+	pthread_cond_init(&t.signal, NULL);
+	t.core_opt.loglevel = opt->loglevel;
+	t.core_opt.delta_conn_timeout_s = timeout_s;
+	t.core_opt.delta_conn_timeout_us = timeout_us;
+	t.core_opt.delta_queue_bytes = opt->queue_bytes;
+	t.inflight_n = rm_max(1u, rm_min((unsigned int) (opt->inflight == 0 ? RM_TREE_INFLIGHT_DEFAULT : opt->inflight), RM_TREE_INFLIGHT_MAX));
+	t.mem_bytes = (opt->mem_bytes == 0 ? 0 : rm_max(1u, opt->mem_bytes / t.inflight_n));												/* each file in flight holds its checksums */
+	t.x = x;
+	t.L = L;
+	t.copy_all_threshold = copy_all_threshold;
+	t.copy_tail_threshold = copy_tail_threshold;
+	t.send_threshold = send_threshold;
+
+	if (stat(x, &fs) != 0) {
+		err = RM_ERR_OPEN_X;
+		goto done;
+	}
+	if (!S_ISDIR(fs.st_mode)) {
+		err = RM_ERR_DIR;
+		goto done;
+	}
+	err = rm_tx_tree_walk(&t, x, "", &cap);
+	if (err != RM_ERR_OK)
+		goto done;
+	if (t.entries_n > 0)
+		qsort(t.entries, t.entries_n, sizeof(struct rm_tx_tree_entry), rm_tx_tree_entry_cmp);				/* deterministic order, directories are processed together */
+	stats->files_n = t.entries_n;
+	for (i = 0; i < t.entries_n; ++i)
+		stats->bytes_n += t.entries[i].bytes;
+
+	t.slots = calloc(t.inflight_n, sizeof(struct rm_tx_tree_slot));
+	if (t.slots == NULL) {
+		err = RM_ERR_MEM;
+		goto done;
+	}
+	for (i = 0; i < t.inflight_n; ++i) {
+		if (rm_msg_push_ack_alloc(&t.slots[i].ack) != RM_ERR_OK) {
+			err = RM_ERR_MEM;
+			goto done;
+		}
+	}
+
+	err = rm_tcp_connect_nonblock_timeout(&t.fd, addr, port, AF_INET, timeout_s, timeout_us, err_str);
+	if (err != RM_ERR_OK)
+		goto done;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.hdr = &hdr;
+	hdr.pt = RM_PT_MSG_PUSH_TREE;
+	hdr.flags = flags | RM_BIT_7;																			/* digest of each file follows its delta stream */
+	uuid_generate(ssid);
+	memcpy(msg.ssid, ssid, RM_UUID_LEN);
+	msg.L = L;
+	msg.inflight = t.inflight_n;
+	msg.files_n = t.entries_n;
+	msg.codec = opt->codec;
+	msg.codec_level = opt->codec_level;
+	msg.roll = opt->roll;
+	msg.roll_seed = rm_tx_roll_seed();
+	msg.prefilter = opt->prefilter;
+	t.roll = msg.roll;
+	t.roll_seed = msg.roll_seed;
+	t.prefilter = msg.prefilter;
+	msg.y_sz = strlen(y) + 1;
+	strcpy(msg.y, y);
+	if (z != NULL) {
+		msg.z_sz = strlen(z) + 1;
+		strcpy(msg.z, z);
+	}
+	hdr.len = rm_calc_msg_len(&msg);
+	hdr.hash = rm_core_hdr_hash(&hdr);
+	msg_raw = malloc(hdr.len);
+	if (msg_raw == NULL) {
+		err = RM_ERR_MEM;
+		goto done;
+	}
+	rm_serialize_msg_push_tree(msg_raw, &msg);
+	err = rm_tcp_write(t.fd, msg_raw, hdr.len);																/* tx msg PUSH_TREE */
+	free(msg_raw);
+	msg_raw = NULL;
+	if (err != RM_ERR_OK)
+		goto done;
+
+	err = rm_tcp_rx(t.fd, buf, RM_MSG_ACK_LEN);																/* generic ACK: request accepted or not */
+	if (err != RM_ERR_OK) {
+		err = (err == RM_ERR_EOF ? RM_ERR_TCP_DISCONNECT : RM_ERR_TCP);
+		goto done;
+	}
+	rm_deserialize_msg_hdr(buf, &hdr);
+	if (hdr.flags != RM_ERR_OK) {																			/* request can't be handled, maybe AUTH failure or bad @y */
+		err = hdr.flags;
+		goto done;
+	}
+	if (hdr.pt != RM_PT_MSG_ACK) {
+		err = RM_ERR_MSG_PT_UNKNOWN;
+		goto done;
+	}
+
+	err = rm_launch_thread(&ch_ch_rx_tid, rm_tx_tree_ch_ch_rx_f, &t, PTHREAD_CREATE_JOINABLE);
+	if (err != RM_ERR_OK) {
+		err = RM_ERR_CH_CH_RX_THREAD_LAUNCH;
+		goto done;
+	}
+	ch_ch_rx_launched = 1;
+
+	err = rm_tx_tree_list_tx(&t);																			/* ACKs and checksums of first files are received meanwhile */
+	if (err != RM_ERR_OK)
+		goto abort;
+
+	for (i = 0; i < t.entries_n; ++i) {																		/* TX deltas in list order, files after this one are rolled meanwhile */
+		pthread_mutex_lock(&t.mutex);
+		while (t.abort == 0 && t.ready_n <= i)
+			pthread_cond_wait(&t.signal, &t.mutex);
+		if (t.abort != 0) {
+			pthread_mutex_unlock(&t.mutex);
+			err = RM_ERR_CH_CH_RX_THREAD;
+			goto abort;
+		}
+		slot = &t.slots[i % t.inflight_n];
+		pthread_mutex_unlock(&t.mutex);
+
+		if (slot->ack.ack.hdr->flags != RM_ERR_OK) {
+			RM_LOG_ERR("Directory push: receiver rejected file [%s], error [%u]", t.entries[i].path, slot->ack.ack.hdr->flags);
+		} else if (slot->s != NULL) {
+			err = rm_tx_tree_file_tx(slot, &stats->rec_ctx);
+			if (err != RM_ERR_OK) {																			/* receiver waits for the bytes it has been promised, can't continue */
+				RM_LOG_ERR("Directory push: can't TX file [%s], error [%u]", t.entries[i].path, err);
+				goto abort;
+			}
+			rm_tx_tree_slot_release(slot);
+		}
+		if (opt->loglevel > RM_LOGLEVEL_NORMAL)
+			RM_LOG_INFO("Directory push: file [%" PRIu64 "] [%s] done", i, t.entries[i].path);
+
+		pthread_mutex_lock(&t.mutex);
+		t.done_n = i + 1;
+		pthread_cond_broadcast(&t.signal);
+		pthread_mutex_unlock(&t.mutex);
+	}
+	pthread_join(ch_ch_rx_tid, NULL);
+	ch_ch_rx_launched = 0;
+
+	memset(&tree_ack, 0, sizeof(tree_ack));
+	tree_ack.ack.hdr = &hdr;
+	err = rm_tcp_rx(t.fd, buf, RM_MSG_PUSH_TREE_ACK_LEN);													/* summary */
+	if (err != RM_ERR_OK) {
+		err = (err == RM_ERR_EOF ? RM_ERR_TCP_DISCONNECT : RM_ERR_TCP);
+		goto done;
+	}
+	err = rm_core_tcp_msg_ack_validate(buf, RM_MSG_PUSH_TREE_ACK_LEN);
+	if (err != RM_ERR_OK)
+		goto done;
+	rm_deserialize_msg_push_tree_ack(buf, &tree_ack);
+	if (hdr.pt != RM_PT_MSG_PUSH_TREE_ACK) {
+		err = RM_ERR_MSG_PT_UNKNOWN;
+		goto done;
 	}
+	stats->files_ok_n = tree_ack.files_ok_n;
+	stats->files_fail_n = tree_ack.files_fail_n;
+	err = (tree_ack.files_fail_n > 0 ? RM_ERR_TREE_PARTIAL : RM_ERR_OK);
+	goto done;
+
+abort:
+	pthread_mutex_lock(&t.mutex);
+	t.abort = 1;
+	pthread_cond_broadcast(&t.signal);
+	pthread_mutex_unlock(&t.mutex);
+	shutdown(t.fd, SHUT_RDWR);																				/* wake up checksums receiver */
 
+done:
+	if (ch_ch_rx_launched)
+		pthread_join(ch_ch_rx_tid, NULL);
+	if (t.fd != -1)
+		close(t.fd);
+	if (t.slots != NULL) {
+		for (i = 0; i < t.inflight_n; ++i) {
+			rm_tx_tree_slot_release(&t.slots[i]);
+			free(t.slots[i].ack.ack.hdr);
+		}
+		free(t.slots);
+	}
+	for (i = 0; i < t.entries_n; ++i)
+		free(t.entries[i].path);
+	free(t.entries);
+	pthread_mutex_destroy(&t.mutex);
+	pthread_cond_destroy(&t.signal);
 	return err;
 }
@@ -203,3 +203,29 @@ int rm_util_chdir_umask_openlog(const char *dir, int noclose, const char *lognam
 	}
 	return RM_ERR_OK;
 }
+
+int rm_util_mkdir_p(const char *dir, mode_t mode)
+{
+	char	path[PATH_MAX];
+	char	*p = NULL;
+	size_t	len = 0;
+
+	if (dir == NULL)
+		return RM_ERR_BAD_CALL;
+	len = strlen(dir);
+	if (len == 0 || len > PATH_MAX - 1)
+		return RM_ERR_BAD_CALL;
+	memcpy(path, dir, len + 1);
+
+	for (p = path + 1; *p != '\0'; ++p) {															/* create each missing ancestor, then @dir itself */
+		if (*p != '/')
+			continue;
+		*p = '\0';
+		if (mkdir(path, mode) != 0 && errno != EEXIST)
+			return RM_ERR_DIR;
+		*p = '/';
+	}
+	if (mkdir(path, mode) != 0 && errno != EEXIST)
+		return RM_ERR_DIR;
+	return RM_ERR_OK;
+}
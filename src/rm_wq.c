@@ -12,6 +12,7 @@ const char * rm_work_type_str[] = {
 	[RM_WORK_PROCESS_MSG_PUSH] = "RM_WORK_PROCESS_MSG_PUSH",
 	[RM_WORK_PROCESS_MSG_PULL] = "RM_WORK_PROCESS_MSG_PULL",
 	[RM_WORK_PROCESS_MSG_BYE] = "RM_WORK_PROCESS_MSG_BYE",
+	[RM_WORK_PROCESS_MSG_PUSH_TREE] = "RM_WORK_PROCESS_MSG_PUSH_TREE",
 	0
 };
 
@@ -20,6 +21,7 @@ rm_wq_call_sync_dtor(struct rm_work *work) {
 	switch (work->task)
 	{
 		case RM_WORK_PROCESS_MSG_PUSH:
+		case RM_WORK_PROCESS_MSG_PUSH_TREE:
 			work->f_dtor(work);                 /* must at least free the memory allocated for the message and work struct itself, may close the TCP socket, etc... */
 			work = NULL;
 			break;
@@ -31,31 +33,120 @@ rm_wq_call_sync_dtor(struct rm_work *work) {
 	}
 }
 
-static void*
-rm_wq_worker_f(void *arg) {
-	twfifo_queue            *q;
-	struct rm_work          *work;              /* iterator over enqueued work elements */
-	struct twlist_head      *lh;
+/* @brief   Take the oldest work from worker's queue (owner and thieves alike, works are independent sessions,
+ *          so the one which waits longest behind busy owner goes first). */
+static struct rm_work*
+rm_wq_worker_dequeue(struct rm_worker *w) {
+	struct twlist_head      *lh = NULL;
+
+	pthread_mutex_lock(&w->mutex);
+	if (twlist_empty(&w->queue) == 0) {
+		lh = w->queue.next;
+		twlist_del(lh);
+		w->queue_n--;
+	}
+	pthread_mutex_unlock(&w->mutex);
+	return (lh != NULL ? tw_container_of(lh, struct rm_work, link) : NULL);
+}
+
+/* @brief   Steal work from the deepest queue of other workers.
+ * @details Depths are read under workers' locks. If victim's queue has been emptied meanwhile
+ *          (by its owner or another thief) look again, NULL means all other queues are empty. */
+static struct rm_work*
+rm_wq_worker_steal(struct rm_worker *w) {
+	struct rm_workqueue     *wq = w->wq;
+	struct rm_worker        *victim, *v;
+	struct rm_work          *work;
+	uint32_t                i, depth, queue_n;
+
+	while (1) {
+		victim = NULL;
+		depth = 0;
+		for (i = 0; i < wq->workers_n; ++i) {
+			v = &wq->workers[i];
+			if (v == w) {
+				continue;
+			}
+			pthread_mutex_lock(&v->mutex);
+			queue_n = v->queue_n;
+			pthread_mutex_unlock(&v->mutex);
+			if (queue_n > depth) {
+				victim = v;
+				depth = queue_n;
+			}
+		}
+		if (victim == NULL) {
+			return NULL;
+		}
+		work = rm_wq_worker_dequeue(victim);
+		if (work != NULL) {
+			pthread_mutex_lock(&w->mutex);
+			w->steals_n++;
+			pthread_mutex_unlock(&w->mutex);
+			return work;
+		}
+	}
+}
 
-	struct rm_worker *w = (struct rm_worker*) arg;
+/* @brief   Wake one idle worker (other than @owner), it will steal work queued to busy @owner. */
+static void
+rm_wq_wake_idle(struct rm_workqueue *wq, struct rm_worker *owner) {
+	struct rm_worker        *v;
+	uint32_t                i;
+
+	for (i = 1; i < wq->workers_n; ++i) {
+		v = &wq->workers[(owner->idx + i) % wq->workers_n];
+		pthread_mutex_lock(&v->mutex);
+		if (v->idle == 1 && v->wake == 0 && v->active == 1) {
+			v->wake = 1;
+			pthread_cond_signal(&v->signal);
+			pthread_mutex_unlock(&v->mutex);
+			return;
+		}
+		pthread_mutex_unlock(&v->mutex);
+	}
+}
 
-	pthread_mutex_lock(&w->mutex);              /* sleep on the queue and process queued work element once awoken */
-	q = &w->queue;
+static void*
+rm_wq_worker_f(void *arg) {
+	struct rm_work          *work;
+	struct rm_worker        *w = (struct rm_worker*) arg;
 
-	while (w->active == 1) {
-		for (twfifo_dequeue(q, lh); lh != NULL; twfifo_dequeue(q, lh)) {
-			work = tw_container_of(lh, struct rm_work, link);
-			pthread_mutex_unlock(&w->mutex);    /* allow for further enquing while work is being processed */
-			work->f(work);
-			rm_wq_call_sync_dtor(work);         /* process destructors for synchronous jobs */
+	while (1) {
+		work = rm_wq_worker_dequeue(w);
+		if (work == NULL) {
 			pthread_mutex_lock(&w->mutex);
+			w->idle = 1;                        /* set before looking into other queues, so work queued to busy worker after the look wakes this one */
+			pthread_mutex_unlock(&w->mutex);
+			work = rm_wq_worker_steal(w);
+		}
+		if (work == NULL) {
+			pthread_mutex_lock(&w->mutex);      /* sleep until work is queued to this worker or there is work to steal */
+			while (twlist_empty(&w->queue) != 0 && w->wake == 0 && w->active == 1) {
+				pthread_cond_wait(&w->signal, &w->mutex);
+			}
+			if (twlist_empty(&w->queue) != 0 && w->wake == 0) {     /* stopped and nothing left to do */
+				pthread_mutex_unlock(&w->mutex);
+				break;
+			}
+			w->wake = 0;
+			w->idle = 0;
+			pthread_mutex_unlock(&w->mutex);
+			continue;
 		}
 
+		pthread_mutex_lock(&w->mutex);
+		w->idle = 0;
+		w->busy = 1;
+		pthread_mutex_unlock(&w->mutex);
+		work->worker_idx = w->idx;
+		work->f(work);
+		rm_wq_call_sync_dtor(work);             /* process destructors for synchronous jobs */
+		pthread_mutex_lock(&w->mutex);
+		w->done_n++;
 		w->busy = 0;
-		pthread_cond_wait(&w->signal, &w->mutex);
+		pthread_mutex_unlock(&w->mutex);
 	}
-
-	pthread_mutex_unlock(&w->mutex);
 	return NULL;
 }
 
@@ -71,7 +162,12 @@ rm_wq_worker_init(struct rm_worker *w, struct rm_workqueue *wq) {
 }
 
 static enum rm_error rm_wq_worker_deinit(struct rm_worker *w) {
-	if (w->busy == 1) {
+	uint8_t busy;
+
+	pthread_mutex_lock(&w->mutex);
+	busy = w->busy;
+	pthread_mutex_unlock(&w->mutex);
+	if (busy == 1) {
 		RM_LOG_WARN("Skipping deinit of worker [%u], this worker is still busy", w->idx);
 		return RM_ERR_BUSY;
 	}
@@ -88,10 +184,31 @@ static enum rm_error rm_wq_worker_deinit(struct rm_worker *w) {
 	return RM_ERR_OK;
 }
 
+void
+rm_wq_worker_stats(struct rm_worker *w, struct rm_worker_stats *stats) {
+	pthread_mutex_lock(&w->mutex);
+	stats->queue_n = w->queue_n;
+	stats->steals_n = w->steals_n;
+	stats->done_n = w->done_n;
+	stats->busy = w->busy;
+	pthread_mutex_unlock(&w->mutex);
+}
+
+uint32_t
+rm_wq_workers_n_default(void) {
+	long cpus_n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus_n < 1) {
+		return RM_WORKERS_N;
+	}
+	return rm_min((uint64_t) cpus_n * RM_WORKERS_PER_CPU, RM_WORKERS_MAX);
+}
+
 enum rm_error
 rm_wq_workqueue_init(struct rm_workqueue *wq, uint32_t workers_n, const char *name) {
 	struct rm_worker    *w = NULL;
 	uint8_t             first_active_set = 0;
+	uint32_t            i = 0;
 
 	memset(wq, 0, sizeof(struct rm_workqueue));
 	wq->workers = malloc(workers_n * sizeof(struct rm_worker));
@@ -99,16 +216,19 @@ rm_wq_workqueue_init(struct rm_workqueue *wq, uint32_t workers_n, const char *na
 		return RM_ERR_MEM;
 	}
 	wq->workers_n = workers_n;
+	for (i = 0; i < workers_n; ++i) {
+		rm_wq_worker_init(&wq->workers[i], wq);			/* all queues valid before any thread may try to steal */
+		wq->workers[i].idx = i;
+	}
 
 	if (workers_n > 0) {
 		wq->workers_active_n = 0;
 		while (workers_n) {
 			--workers_n;
 			w = &wq->workers[workers_n];
-			rm_wq_worker_init(w, wq);
-			w->idx = workers_n;
 			w->active = 1;
 			if (rm_launch_thread(&w->tid, rm_wq_worker_f, w, PTHREAD_CREATE_JOINABLE) == RM_ERR_OK) {
+				w->running = 1;
 				wq->workers_active_n++;																	/* increase the number of running workers */
 				if (first_active_set == 0) {
 					wq->first_active_worker_idx = w->idx;
@@ -182,7 +302,7 @@ rm_wq_workqueue_create(uint32_t workers_n, const char *name) {
 
 enum rm_error rm_wq_workqueue_stop(struct rm_workqueue *wq) {
 	struct rm_worker    *w = NULL;
-	uint8_t             workers_n = 0;
+	uint32_t            workers_n = 0;
 	enum rm_error       err = RM_ERR_OK;
 
 	workers_n = wq->workers_n;
@@ -190,18 +310,24 @@ enum rm_error rm_wq_workqueue_stop(struct rm_workqueue *wq) {
 		while (workers_n) {
 			--workers_n;
 			w = &wq->workers[workers_n];
-			pthread_mutex_lock(&w->mutex);                                      /* lock worker thread */
-			if (w->active == 1) {
-				w->active = 0;                                                  /* tell the worker to stop */
-				pthread_cond_signal(&w->signal);                                /* signal the worker */
-				pthread_mutex_unlock(&w->mutex);                                /* let worker exit */
-				wq->workers_active_n--;                                         /* decrease the number of active/running workers */
-				if (pthread_join(w->tid, NULL) != RM_ERR_OK) {                  /* join worker thread */
-					err = RM_ERR_FAIL;
-				}
-			} else {
-				pthread_mutex_unlock(&w->mutex);
+			pthread_mutex_lock(&w->mutex);
+			w->active = 0;                                                      /* tell the worker to stop (once queued work is done) */
+			pthread_cond_signal(&w->signal);
+			pthread_mutex_unlock(&w->mutex);
+		}
+
+		workers_n = wq->workers_n;
+		while (workers_n) {
+			--workers_n;
+			w = &wq->workers[workers_n];
+			if (w->running == 0) {
+				continue;
 			}
+			wq->workers_active_n--;                                             /* decrease the number of active/running workers */
+			if (pthread_join(w->tid, NULL) != RM_ERR_OK) {                      /* join worker thread */
+				err = RM_ERR_FAIL;
+			}
+			w->running = 0;
 		}
 	}
 	return err;
@@ -236,11 +362,13 @@ rm_work_free(struct rm_work* work) {
 	free(work);
 }
 
-/*  @brief  Work dispatcher (round-robin). */
+/*  @brief  Work dispatcher.
+ *  @details Work is placed round-robin, idle workers steal it from busy ones. */
 void
 rm_wq_queue_work(struct rm_workqueue *wq, struct rm_work* work) {
 	struct rm_worker    *w = NULL;
-	uint8_t             idx = wq->next_worker_idx_to_use, sanity = 0xFF;
+	uint32_t            idx = wq->next_worker_idx_to_use, sanity = wq->workers_n;
+	uint8_t             idle = 0;
 
 	assert(wq->workers_active_n > 0 && "NO ACTIVE THREAD in the workqueue");
 
@@ -258,15 +386,22 @@ rm_wq_queue_work(struct rm_workqueue *wq, struct rm_work* work) {
 		w = &wq->workers[wq->first_active_worker_idx];
 	}
 
-	work->worker_idx = w->idx;														/* save the worker's index into work */
+	work->worker_idx = w->idx;														/* save the worker's index into work (updated if stolen) */
 	wq->next_worker_idx_to_use = idx;
 
-	pthread_mutex_lock(&w->mutex);													/* enqueue work (and move ownership to worker!) */
+	pthread_mutex_lock(&w->mutex);													/* enqueue work (and move ownership to workqueue!) */
 	twfifo_enqueue(&work->link, &w->queue);
-	w->busy = 1;
-	pthread_cond_signal(&w->signal);
+	w->queue_n++;
+	idle = w->idle;
+	if (idle == 1) {
+		w->wake = 1;
+		pthread_cond_signal(&w->signal);
+	}
 	pthread_mutex_unlock(&w->mutex);
 
+	if (idle == 0) {
+		rm_wq_wake_idle(wq, w);													/* worker is busy, let an idle one steal the work */
+	}
 	return;
 }
 
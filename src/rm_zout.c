@@ -0,0 +1,142 @@
+/* @file        rm_zout.c
+ * @brief       Write-combining output of result file @z.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        21 Oct 2026 09:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#define _GNU_SOURCE		/* fallocate, O_DIRECT */
+
+#include "rm_zout.h"
+#include "rm.h"
+
+
+static void
+rm_zout_direct_off(struct rm_zout *z) {
+	int	flags = fcntl(z->fd, F_GETFL);
+
+	if (flags != -1)
+		fcntl(z->fd, F_SETFL, flags & ~O_DIRECT);
+	z->direct = 0;
+}
+
+enum rm_error
+rm_zout_init(struct rm_zout *z, int fd, uint64_t size, uint8_t direct) {
+	void	*buf = NULL;
+	int		flags = 0;
+
+	memset(z, 0, sizeof(*z));
+	z->fd = fd;
+	if (posix_memalign(&buf, RM_ZOUT_ALIGN, RM_ZOUT_BUF_LEN) != 0)
+		return RM_ERR_MEM;
+	z->buf = buf;
+	if (size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) != 0 && errno == ENOSPC) {	/* few extents, file grows only by what is written */
+		free(z->buf);																			/* @z doesn't fit, other errors: not supported, no reservation */
+		z->buf = NULL;
+		return RM_ERR_WRITE;
+	}
+	if (direct) {
+		flags = fcntl(fd, F_GETFL);
+		if (flags != -1 && fcntl(fd, F_SETFL, flags | O_DIRECT) == 0)							/* not all filesystems support it */
+			z->direct = 1;
+	}
+	return RM_ERR_OK;
+}
+
+void
+rm_zout_free(struct rm_zout *z) {
+	free(z->buf);
+	z->buf = NULL;
+	z->buf_n = 0;
+}
+
+enum rm_error
+rm_zout_flush(struct rm_zout *z) {
+	const unsigned char	*src = z->buf;
+	size_t				bytes_n = z->buf_n;
+	uint64_t			offset = z->off;
+	ssize_t				n = 0;
+
+	if (z->direct && ((offset % RM_ZOUT_ALIGN) != 0 || (bytes_n % RM_ZOUT_ALIGN) != 0))		/* tail of @z */
+		rm_zout_direct_off(z);
+	while (bytes_n > 0) {
+		do {
+			n = pwrite(z->fd, src, bytes_n, offset);
+		} while ((n == -1) && (errno == EINTR));
+		if (n == -1 && errno == EINVAL && z->direct) {											/* filesystem refused this O_DIRECT write */
+			rm_zout_direct_off(z);
+			continue;
+		}
+		if (n <= 0)
+			return RM_ERR_WRITE;
+		src += n;
+		offset += n;
+		bytes_n -= n;
+		if (bytes_n > 0 && z->direct)																/* short O_DIRECT write, rest is not aligned anymore */
+			rm_zout_direct_off(z);
+	}
+	z->off += z->buf_n;
+	z->buf_n = 0;
+	return RM_ERR_OK;
+}
+
+enum rm_error
+rm_zout_reserve(struct rm_zout *z, uint64_t offset, unsigned char **dst, size_t *dst_n) {
+	if (offset != z->off + z->buf_n || z->buf_n == RM_ZOUT_BUF_LEN) {
+		if (rm_zout_flush(z) != RM_ERR_OK)
+			return RM_ERR_WRITE;
+		z->off = offset;
+	}
+	*dst = z->buf + z->buf_n;
+	*dst_n = RM_ZOUT_BUF_LEN - z->buf_n;
+	return RM_ERR_OK;
+}
+
+void
+rm_zout_commit(struct rm_zout *z, size_t bytes_n) {
+	assert(z->buf_n + bytes_n <= RM_ZOUT_BUF_LEN);
+	z->buf_n += bytes_n;
+}
+
+enum rm_error
+rm_zout_write(struct rm_zout *z, uint64_t offset, const unsigned char *src, size_t bytes_n) {
+	unsigned char	*dst = NULL;
+	size_t			n = 0;
+
+	while (bytes_n > 0) {
+		if (rm_zout_reserve(z, offset, &dst, &n) != RM_ERR_OK)
+			return RM_ERR_WRITE;
+		n = rm_min(n, bytes_n);
+		memcpy(dst, src, n);
+		rm_zout_commit(z, n);
+		src += n;
+		offset += n;
+		bytes_n -= n;
+	}
+	return RM_ERR_OK;
+}
+
+enum rm_error
+rm_zout_copy(struct rm_zout *z, int src_fd, uint64_t src_offset, uint64_t offset, size_t bytes_n, MD5_CTX *md5) {
+	unsigned char	*dst = NULL;
+	size_t			n = 0;
+	ssize_t			read_n = 0;
+
+	while (bytes_n > 0) {
+		if (rm_zout_reserve(z, offset, &dst, &n) != RM_ERR_OK)
+			return RM_ERR_WRITE;
+		n = rm_min(n, bytes_n);
+		do {
+			read_n = pread(src_fd, dst, n, src_offset);
+		} while ((read_n == -1) && (errno == EINTR));
+		if (read_n <= 0)
+			return RM_ERR_READ;
+		if (md5 != NULL)
+			md5_update(md5, dst, read_n);
+		rm_zout_commit(z, read_n);
+		src_offset += read_n;
+		offset += read_n;
+		bytes_n -= read_n;
+	}
+	return RM_ERR_OK;
+}
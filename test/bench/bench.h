@@ -0,0 +1,64 @@
+/* @file        bench.h
+ * @brief       Helpers shared by benchmark drivers.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 06:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_BENCH_H
+#define RSYNCME_BENCH_H
+
+
+#include "rm_defs.h"
+
+
+/* @brief   Monotonic time in ns. */
+static uint64_t
+bench_now_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * RM_NANOSEC_PER_SEC + t.tv_nsec;
+}
+
+/* @brief   CPU time of calling process in ns (all threads). */
+static uint64_t
+bench_cpu_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+	return (uint64_t) t.tv_sec * RM_NANOSEC_PER_SEC + t.tv_nsec;
+}
+
+/* @brief   Seedable generator (xorshift64*), so workloads can be recreated exactly. */
+static uint64_t
+bench_rand(uint64_t *state) {
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 2685821657736338717ULL;
+}
+
+static void
+bench_rand_seed(uint64_t *state, uint64_t seed) {
+	*state = seed ? seed : 0x9e3779b97f4a7c15ULL;   /* state must not be 0 */
+}
+
+static void
+bench_rand_fill(uint64_t *state, unsigned char *buf, size_t len) {
+	uint64_t	r = 0;
+	size_t		i = 0;
+
+	for (i = 0; i < len; ++i) {
+		if ((i & 7) == 0)
+			r = bench_rand(state);
+		buf[i] = (unsigned char) r;
+		r >>= 8;
+	}
+}
+
+
+#endif  /* RSYNCME_BENCH_H */
@@ -0,0 +1,367 @@
+/* @file        bench_kernels.c
+ * @brief       Microbenchmarks of checksum, hashing and lookup kernels.
+ * @details     Runs each kernel over block sizes and buffer alignments,
+ *              prints ns/byte and GB/s and writes the same as CSV (one row
+ *              per kernel, block and alignment, in fixed order) so results
+ *              of two builds can be diffed.
+ *              Usage: bench_kernels [-o csv] [-t ms] [-s seed]
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 06:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm.h"
+#include "bench.h"
+
+#include <getopt.h>
+
+
+#define BENCH_CSV_DEFAULT       "bench_kernels.csv"
+#define BENCH_MIN_MS_DEFAULT    200u                /* each case is repeated until it took at least this long */
+#define BENCH_ROUNDS            3u                  /* best of */
+#define BENCH_BUF_MAX           (1u << 20)          /* largest block */
+#define BENCH_BUF_PAD           64u                 /* room for misalignment */
+#define BENCH_TABLE_BYTES       (64u << 20)         /* size of file whose blocks are loaded into hashtable for lookups */
+#define BENCH_LOOKUPS_N         4096u               /* fast checksums looked up in one run of lookup kernel */
+
+
+static const size_t bench_block[] = { 64, 512, 4096, 65536, BENCH_BUF_MAX };
+static const size_t bench_align[] = { 0, 1, 8, 32 };
+
+struct bench_case {
+	const char      *kernel;
+	size_t          block;
+	size_t          align;
+	const unsigned char     *data;
+	FILE            *f_x, *f_y;
+	struct twhlist_head     *h;
+	const uint32_t  *keys;
+	struct rm_roll  roll;                           /* RM_ROLL_POLY over @block */
+	uint64_t        (*run)(struct bench_case *c);   /* returns number of bytes processed */
+};
+
+static volatile uint32_t bench_sink;                /* keeps results alive */
+
+static uint64_t
+bench_fast_check_block(struct bench_case *c) {
+	bench_sink += rm_fast_check_block(c->data + c->align, c->block);
+	return c->block;
+}
+
+static uint64_t
+bench_adler32_1(struct bench_case *c) {
+	bench_sink += rm_adler32_1(c->data + c->align, c->block);
+	return c->block;
+}
+
+static uint64_t
+bench_adler32_2(struct bench_case *c) {
+	bench_sink += rm_adler32_2(1, c->data + c->align, c->block);
+	return c->block;
+}
+
+/* Roll checksum of @block bytes through BENCH_BUF_MAX bytes, as rolling proc does in nonmatching regions. */
+static uint64_t
+bench_fast_check_roll(struct bench_case *c) {
+	const unsigned char *d = c->data + c->align;
+	uint32_t    ch = 0;
+	size_t      i = 0, n = BENCH_BUF_MAX - c->block;
+
+	ch = rm_fast_check_block(d, c->block);
+	for (i = 0; i < n; ++i) {
+		ch = rm_fast_check_roll(ch, d[i], d[i + c->block], c->block);
+	}
+	bench_sink += ch;
+	return n;
+}
+
+static uint64_t
+bench_roll_block(struct bench_case *c) {
+	bench_sink += rm_roll_f_ch(&c->roll, rm_roll_block(&c->roll, c->data + c->align, c->block));
+	return c->block;
+}
+
+/* As bench_fast_check_roll, with seeded polynomial. */
+static uint64_t
+bench_roll_roll(struct bench_case *c) {
+	const unsigned char *d = c->data + c->align;
+	uint64_t    h = 0;
+	size_t      i = 0, n = BENCH_BUF_MAX - c->block;
+
+	h = rm_roll_block(&c->roll, d, c->block);
+	for (i = 0; i < n; ++i) {
+		h = rm_roll_roll(&c->roll, h, d[i], d[i + c->block]);
+	}
+	bench_sink += rm_roll_f_ch(&c->roll, h);
+	return n;
+}
+
+/* As bench_fast_check_roll, RM_ROLL_BATCH offsets per call of rm_roll_batch. */
+static uint64_t
+bench_roll_batch(struct bench_case *c) {
+	const unsigned char *d = c->data + c->align;
+	uint64_t    h[RM_ROLL_BATCH];
+	uint64_t    last = 0;
+	size_t      i = 0, k = 0, n = BENCH_BUF_MAX - c->block;
+
+	last = rm_roll_block(&c->roll, d, c->block);
+	for (i = 0; i < n; i += k) {
+		k = rm_min(RM_ROLL_BATCH, n - i);
+		rm_roll_batch(&c->roll, last, d + i, k, h);
+		last = h[k - 1];
+	}
+	bench_sink += rm_roll_f_ch(&c->roll, last);
+	return n;
+}
+
+static uint64_t
+bench_crc32c(struct bench_case *c) {
+	bench_sink += rm_crc32c(0, c->data + c->align, c->block);
+	return c->block;
+}
+
+static uint64_t
+bench_md5(struct bench_case *c) {
+	unsigned char   res[RM_STRONG_CHECK_BYTES];
+
+	rm_md5(c->data + c->align, c->block, res);
+	bench_sink += res[0];
+	return c->block;
+}
+
+/* RM_MD5_LANES blocks at once, lanes start 4 bytes apart (blocks overlap, BENCH_BUF_PAD leaves room). */
+static uint64_t
+bench_md5_lanes(struct bench_case *c) {
+	unsigned char       res[RM_MD5_LANES][RM_STRONG_CHECK_BYTES];
+	const unsigned char *data[RM_MD5_LANES];
+	size_t              len[RM_MD5_LANES];
+	unsigned char       *out[RM_MD5_LANES];
+	size_t              k = 0;
+
+	for (k = 0; k < RM_MD5_LANES; ++k) {
+		data[k] = c->data + c->align + 4 * k;
+		len[k] = c->block;
+		out[k] = res[k];
+	}
+	rm_md5_lanes(data, len, out, RM_MD5_LANES);
+	bench_sink += res[0][0] + res[RM_MD5_LANES - 1][0];
+	return RM_MD5_LANES * c->block;
+}
+
+/* Hash fast checksums and walk their buckets, as rolling proc does at each byte.
+ * Table holds checksums of BENCH_TABLE_BYTES / @block blocks, half of looked up keys are in it. */
+static uint64_t
+bench_lookup(struct bench_case *c) {
+	const struct rm_ch_ch_ref_hlink *e = NULL;
+	uint32_t    hash = 0, i = 0, found = 0;
+
+	for (i = 0; i < BENCH_LOOKUPS_N; ++i) {
+		hash = twhash_min(c->keys[i], RM_NONOVERLAPPING_HASH_BITS);
+		twhlist_for_each_entry(e, &c->h[hash], hlink) {
+			if (e->data.ch_ch.f_ch == c->keys[i]) {
+				++found;
+				break;
+			}
+		}
+	}
+	bench_sink += found;
+	return BENCH_LOOKUPS_N;                         /* one lookup per rolled byte */
+}
+
+static uint64_t
+bench_copy_buffered_offset(struct bench_case *c) {
+	if (rm_copy_buffered_offset(c->f_x, c->f_y, c->block, c->align, c->align, NULL) != RM_ERR_OK) {
+		fprintf(stderr, "ERR, rm_copy_buffered_offset failed\n");
+		exit(EXIT_FAILURE);
+	}
+	return c->block;
+}
+
+/* @return  Best time of BENCH_ROUNDS rounds in ns per byte, *bytes and *ns of that round. */
+static double
+bench_measure(struct bench_case *c, uint64_t min_ns, uint64_t *bytes, uint64_t *ns) {
+	uint64_t    start = 0, t = 0, b = 0, iters = 0, i = 0;
+	double      best = 0.0, x = 0.0;
+	uint32_t    round = 0;
+
+	c->run(c);                                      /* warm up caches */
+	iters = 1;
+	do {                                            /* find number of iterations taking at least min_ns */
+		start = bench_now_ns();
+		for (i = 0; i < iters; ++i)
+			c->run(c);
+		t = bench_now_ns() - start;
+		if (t >= min_ns)
+			break;
+		iters *= 2;
+	} while (1);
+	for (round = 0; round < BENCH_ROUNDS; ++round) {
+		b = 0;
+		start = bench_now_ns();
+		for (i = 0; i < iters; ++i)
+			b += c->run(c);
+		t = bench_now_ns() - start;
+		x = (double) t / b;
+		if (round == 0 || x < best) {
+			best = x;
+			*bytes = b;
+			*ns = t;
+		}
+	}
+	return best;
+}
+
+static struct twhlist_head *
+bench_table_create(const unsigned char *data, size_t block, struct rm_ch_ch_ref_hlink **entries) {
+	struct twhlist_head     *h = NULL;
+	struct rm_ch_ch_ref_hlink   *e = NULL;
+	size_t  i = 0, n = BENCH_TABLE_BYTES / block;
+
+	h = malloc(sizeof(struct twhlist_head) * (1u << RM_NONOVERLAPPING_HASH_BITS));
+	e = malloc(sizeof(struct rm_ch_ch_ref_hlink) * n);
+	if (h == NULL || e == NULL) {
+		fprintf(stderr, "ERR, no memory for hashtable\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < (1u << RM_NONOVERLAPPING_HASH_BITS); ++i)
+		TWINIT_HLIST_HEAD(&h[i]);
+	for (i = 0; i < n; ++i) {                       /* blocks of pseudo file made of data buffer shifted by block number */
+		e[i].data.ch_ch.f_ch = rm_fast_check_block(data + (i % (BENCH_BUF_MAX - block + 1)), block) ^ (uint32_t) (i / (BENCH_BUF_MAX - block + 1));
+		e[i].data.ref = i;
+		TWINIT_HLIST_NODE(&e[i].hlink);
+		twhash_add_bits(h, &e[i].hlink, e[i].data.ch_ch.f_ch, RM_NONOVERLAPPING_HASH_BITS);
+	}
+	*entries = e;
+	return h;
+}
+
+static FILE *
+bench_file_create(const unsigned char *data, size_t len) {
+	FILE    *f = tmpfile();
+
+	if (f == NULL || fwrite(data, len, 1, f) != 1 || fflush(f) != 0) {
+		fprintf(stderr, "ERR, can't create temporary file\n");
+		exit(EXIT_FAILURE);
+	}
+	return f;
+}
+
+static void
+bench_usage(const char *name) {
+	fprintf(stderr, "\nusage:\t %s [-o csv] [-t ms] [-s seed]\n", name);
+	fprintf(stderr, "     \t -o csv  : output file [" BENCH_CSV_DEFAULT "]\n");
+	fprintf(stderr, "     \t -t ms   : minimal duration of each measurement [%u]\n", BENCH_MIN_MS_DEFAULT);
+	fprintf(stderr, "     \t -s seed : seed of benchmark data [1]\n\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	const char      *csv_path = BENCH_CSV_DEFAULT;
+	FILE            *csv = NULL;
+	uint64_t        min_ns = (uint64_t) BENCH_MIN_MS_DEFAULT * 1000000u, seed = 1, rnd = 0, bytes = 0, ns = 0;
+	unsigned char   *data = NULL;
+	uint32_t        keys[BENCH_LOOKUPS_N];
+	struct rm_ch_ch_ref_hlink   *entries = NULL;
+	struct bench_case   c;
+	size_t          b = 0, a = 0, k = 0, i = 0;
+	double          ns_per_byte = 0.0;
+	int             opt = 0;
+
+	const struct {
+		const char  *name;
+		uint64_t    (*run)(struct bench_case *c);
+	} kernels[] = {
+		{ "rm_fast_check_block", bench_fast_check_block },
+		{ "rm_adler32_1", bench_adler32_1 },
+		{ "rm_adler32_2", bench_adler32_2 },
+		{ "rm_fast_check_roll", bench_fast_check_roll },
+		{ "rm_roll_block(poly)", bench_roll_block },
+		{ "rm_roll_roll(poly)", bench_roll_roll },
+		{ "rm_roll_batch(fast)", bench_roll_batch },
+		{ "rm_crc32c", bench_crc32c },
+		{ "rm_md5", bench_md5 },
+		{ "rm_md5_lanes", bench_md5_lanes },
+		{ "twhash_min+bucket_walk", bench_lookup },
+		{ "rm_copy_buffered_offset", bench_copy_buffered_offset }
+	};
+
+	while ((opt = getopt(argc, argv, "o:t:s:h")) != -1) {
+		switch (opt) {
+			case 'o':
+				csv_path = optarg;
+				break;
+			case 't':
+				min_ns = strtoull(optarg, NULL, 10) * 1000000u;
+				break;
+			case 's':
+				seed = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				bench_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	data = malloc(BENCH_BUF_MAX + BENCH_BUF_PAD);
+	if (data == NULL) {
+		fprintf(stderr, "ERR, no memory\n");
+		exit(EXIT_FAILURE);
+	}
+	bench_rand_seed(&rnd, seed);
+	bench_rand_fill(&rnd, data, BENCH_BUF_MAX + BENCH_BUF_PAD);
+	csv = fopen(csv_path, "w");
+	if (csv == NULL) {
+		fprintf(stderr, "ERR, can't open [%s]\n", csv_path);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(csv, "kernel,block,align,bytes,ns,ns_per_byte,gb_per_s\n");
+	fprintf(stderr, "%-24s %8s %5s %12s %10s\n", "kernel", "block", "align", "ns/byte", "GB/s");
+
+	for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		for (b = 0; b < sizeof(bench_block) / sizeof(bench_block[0]); ++b) {
+			memset(&c, 0, sizeof(c));
+			c.kernel = kernels[k].name;
+			c.run = kernels[k].run;
+			c.block = bench_block[b];
+			c.data = data;
+			if ((c.run == bench_fast_check_roll || c.run == bench_roll_roll || c.run == bench_roll_batch) && c.block == BENCH_BUF_MAX)
+				continue;                           /* nothing to roll through */
+			if (c.run == bench_roll_block || c.run == bench_roll_roll)
+				rm_roll_init(&c.roll, RM_ROLL_POLY, seed, c.block);
+			if (c.run == bench_roll_batch)
+				rm_roll_init(&c.roll, RM_ROLL_FAST, seed, c.block);
+			if (c.run == bench_lookup) {
+				c.h = bench_table_create(data, c.block, &entries);
+				for (i = 0; i < BENCH_LOOKUPS_N; ++i)   /* every other key is in the table */
+					keys[i] = (i & 1) ? entries[bench_rand(&rnd) % (BENCH_TABLE_BYTES / c.block)].data.ch_ch.f_ch : (uint32_t) bench_rand(&rnd);
+				c.keys = keys;
+			}
+			if (c.run == bench_copy_buffered_offset) {
+				c.f_x = bench_file_create(data, BENCH_BUF_MAX + BENCH_BUF_PAD);
+				c.f_y = bench_file_create(data, BENCH_BUF_MAX + BENCH_BUF_PAD);
+			}
+			for (a = 0; a < sizeof(bench_align) / sizeof(bench_align[0]); ++a) {
+				c.align = bench_align[a];
+				ns_per_byte = bench_measure(&c, min_ns, &bytes, &ns);
+				fprintf(csv, "%s,%zu,%zu,%" PRIu64 ",%" PRIu64 ",%.4f,%.4f\n", c.kernel, c.block, c.align, bytes, ns, ns_per_byte, 1.0 / ns_per_byte);
+				fprintf(stderr, "%-24s %8zu %5zu %12.4f %10.4f\n", c.kernel, c.block, c.align, ns_per_byte, 1.0 / ns_per_byte);
+				if (c.run == bench_lookup)
+					break;                          /* alignment of data doesn't matter to lookup */
+			}
+			if (c.h != NULL) {
+				free(c.h);
+				free(entries);
+				entries = NULL;
+			}
+			if (c.f_x != NULL)
+				fclose(c.f_x);
+			if (c.f_y != NULL)
+				fclose(c.f_y);
+		}
+	}
+
+	fclose(csv);
+	free(data);
+	fprintf(stderr, "\nresults written to [%s]\n", csv_path);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,424 @@
+/* @file        bench_load.c
+ * @brief       Loopback remote push load generator.
+ * @details     Starts rsyncme_d as child process (or uses running receiver
+ *              given with -i) and runs N remote pushes (rm_tx_remote_push)
+ *              from C concurrent threads. Each thread syncs its own pair of
+ *              files: @y of given size and @x made from it by random byte
+ *              flips at given rate. Reports throughput and percentiles
+ *              (p50/p99/p999) of session setup latency (until receiver
+ *              accepted the request) and of session completion time (as seen
+ *              by transmitter: delta stream and digest sent).
+ *              With -w pushes go through bench_proxy started with given
+ *              link profile, so they run over simulated WAN.
+ *              Usage: bench_load [-D rsyncme_d | -i addr] [-p port] [-n sessions]
+ *                     [-c concurrency] [-S size] [-r flips/MiB] [-L L] [-d dir] [-s seed] [-o csv]
+ *                     [-w profile [-P bench_proxy] [-C]]
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 10:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_tx.h"
+#include "bench.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+
+#define BENCH_CSV_DEFAULT       "bench_load.csv"
+#define BENCH_DAEMON_DEFAULT    "../../build/release/rsyncme_d"
+#define BENCH_PROXY_DEFAULT     "../build/release/bench_proxy"
+#define BENCH_PROXY_PORT        5049u
+#define BENCH_CHUNK             (1u << 20)
+#define BENCH_SESSIONS_DEFAULT  100u
+#define BENCH_CONCURRENCY_DEFAULT   8u
+#define BENCH_SIZE_DEFAULT      (1u << 20)
+#define BENCH_FLIPS_DEFAULT     4.0                 /* per MiB */
+#define BENCH_READY_TIMEOUT_MS  5000u               /* wait that long for started receiver to accept connections */
+#define BENCH_TIMEOUT_S         30u                 /* connection timeout of pushes */
+#define BENCH_IDLE_TIMEOUT_MS   10000u              /* wait that long for receiver to finish last files before it is stopped */
+
+struct bench_load {
+	const char      *addr;
+	uint16_t        port;
+	size_t          L;
+	uint32_t        sessions_n;
+	uint32_t        next;                           /* next session to run */
+	uint8_t         codec, codec_level;             /* RM_CODEC_* requested for literal payloads */
+	pthread_mutex_t mutex;                          /* protects next and literal counters */
+	uint64_t        raw_n, raw_z_n;                 /* literal bytes of all sessions, before and after codec */
+	uint64_t        *setup_ns;                      /* per session */
+	uint64_t        *done_ns;
+	enum rm_error   *err;
+};
+
+struct bench_worker {
+	pthread_t           tid;
+	struct bench_load   *load;
+	char                x[PATH_MAX + 32], y[PATH_MAX + 32], z[PATH_MAX + 32];
+};
+
+static void
+bench_die(const char *what, const char *path) {
+	fprintf(stderr, "ERR, %s [%s]: %s\n", what, path, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+static int
+bench_u64_cmp(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted @v. */
+static double
+bench_percentile_ms(const uint64_t *v, uint32_t n, double p) {
+	uint32_t    rank = 0;
+
+	if (n == 0)
+		return 0.0;
+	rank = (uint32_t) (p * n + 0.999999);
+	if (rank < 1)
+		rank = 1;
+	if (rank > n)
+		rank = n;
+	return (double) v[rank - 1] / 1000000;
+}
+
+/* Write @y of @sz random bytes and @x, same with about @flips_per_mib flipped bytes per MiB. */
+static void
+bench_files_create(const char *x, const char *y, uint64_t sz, double flips_per_mib, uint64_t *rnd) {
+	static unsigned char    buf[BENCH_CHUNK];
+	FILE        *f_x = NULL, *f_y = NULL;
+	uint64_t    off = 0, n = 0, i = 0, flips_n = 0;
+
+	f_x = fopen(x, "wb");
+	f_y = fopen(y, "wb");
+	if (f_x == NULL || f_y == NULL)
+		bench_die("can't open", x);
+	for (off = 0; off < sz; off += n) {
+		n = rm_min(sz - off, (uint64_t) BENCH_CHUNK);
+		bench_rand_fill(rnd, buf, n);
+		if (fwrite(buf, n, 1, f_y) != 1)
+			bench_die("can't write", y);
+		flips_n = (uint64_t) (flips_per_mib * n / (1u << 20) + (double) (bench_rand(rnd) % 1000) / 1000);  /* fractions carried randomly */
+		for (i = 0; i < flips_n; ++i)
+			buf[bench_rand(rnd) % n] ^= (unsigned char) (1 + bench_rand(rnd) % 255);
+		if (fwrite(buf, n, 1, f_x) != 1)
+			bench_die("can't write", x);
+	}
+	if (fclose(f_x) != 0 || fclose(f_y) != 0)
+		bench_die("can't write", x);
+}
+
+static void *
+bench_worker_f(void *arg) {
+	struct bench_worker     *w = arg;
+	struct bench_load       *load = w->load;
+	struct rm_tx_options    opt = { .loglevel = RM_LOGLEVEL_NORMAL, .inflight = RM_TREE_INFLIGHT_DEFAULT, .queue_bytes = RM_DELTA_QUEUE_BYTES };
+	struct rm_delta_reconstruct_ctx rec_ctx;
+	const char      *err_str = NULL;
+	uint32_t        i = 0;
+	uint64_t        start = 0;
+
+	opt.codec = load->codec;
+	opt.codec_level = load->codec_level;
+	while (1) {
+		pthread_mutex_lock(&load->mutex);
+		i = load->next++;
+		pthread_mutex_unlock(&load->mutex);
+		if (i >= load->sessions_n)
+			break;
+		memset(&rec_ctx, 0, sizeof(rec_ctx));
+		start = bench_now_ns();
+		load->err[i] = rm_tx_remote_push(w->x, w->y, w->z, load->L, 0, 0, load->L, RM_BIT_6, &rec_ctx, load->addr, load->port,
+				BENCH_TIMEOUT_S, 0, &err_str, &opt);   /* leave @y */
+		load->done_ns[i] = bench_now_ns() - start;
+		load->setup_ns[i] = (uint64_t) rec_ctx.time_setup.tv_sec * RM_NANOSEC_PER_SEC + rec_ctx.time_setup.tv_nsec;
+		pthread_mutex_lock(&load->mutex);
+		load->raw_n += rec_ctx.rec_by_raw;
+		load->raw_z_n += (rec_ctx.codec != RM_CODEC_NONE ? rec_ctx.rec_by_raw_z : rec_ctx.rec_by_raw);
+		pthread_mutex_unlock(&load->mutex);
+	}
+	return NULL;
+}
+
+/* Start @path with @argv, output goes to @log. */
+static pid_t
+bench_child_start(const char *path, char *const argv[], const char *log) {
+	int     fd = -1;
+	pid_t   pid = 0;
+
+	pid = fork();
+	if (pid == -1)
+		bench_die("can't fork", path);
+	if (pid == 0) {
+		fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd != -1) {
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		execv(path, argv);
+		_exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+static pid_t
+bench_daemon_start(const char *path, const char *dir) {
+	char    log[PATH_MAX + 32];
+	char    *argv[] = { (char*) path, NULL };
+
+	snprintf(log, sizeof(log), "%s/rsyncme_d.log", dir);
+	return bench_child_start(path, argv, log);
+}
+
+/* Start proxy on BENCH_PROXY_PORT forwarding to receiver at @addr:@port. */
+static pid_t
+bench_proxy_start(const char *path, const char *dir, const char *profile, const char *addr, uint16_t port, uint8_t delta_conn) {
+	char    log[PATH_MAX + 32], lport[8], rport[8];
+	char    *argv[] = { (char*) path, "-w", (char*) profile, "-l", lport, "-a", (char*) addr, "-p", rport, delta_conn ? "-C" : NULL, NULL };
+
+	snprintf(log, sizeof(log), "%s/bench_proxy.log", dir);
+	snprintf(lport, sizeof(lport), "%u", BENCH_PROXY_PORT);
+	snprintf(rport, sizeof(rport), "%u", port);
+	return bench_child_start(path, argv, log);
+}
+
+/* Wait until receiver accepts connections. */
+static int
+bench_daemon_wait_ready(const char *addr, uint16_t port) {
+	struct sockaddr_in  sa;
+	struct timespec     nap = { 0, 50 * 1000000 };
+	uint32_t            waited_ms = 0;
+	int                 fd = -1, ok = 0;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_port = htons(port);
+	if (inet_pton(AF_INET, addr, &sa.sin_addr) != 1)
+		return -1;
+	for (waited_ms = 0; waited_ms < BENCH_READY_TIMEOUT_MS; waited_ms += 50) {
+		fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd == -1)
+			return -1;
+		ok = (connect(fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+		close(fd);
+		if (ok)
+			return 0;
+		nanosleep(&nap, NULL);
+	}
+	return -1;
+}
+
+/* Receiver moves result into place after transmitter is done, wait while its
+ * temporary files exist in @dir (anything not created by this program). */
+static void
+bench_daemon_wait_idle(const char *dir) {
+	struct timespec nap = { 0, 50 * 1000000 };
+	struct dirent   *de = NULL;
+	DIR             *d = NULL;
+	uint32_t        waited_ms = 0, tmp_n = 0;
+
+	for (waited_ms = 0; waited_ms < BENCH_IDLE_TIMEOUT_MS; waited_ms += 50) {
+		d = opendir(dir);
+		if (d == NULL)
+			return;
+		tmp_n = 0;
+		while ((de = readdir(d)) != NULL) {
+			if (de->d_name[0] != '.' && strncmp(de->d_name, "rm_load_", 8) != 0 && strcmp(de->d_name, "rsyncme_d.log") != 0 && strcmp(de->d_name, "bench_proxy.log") != 0)
+				++tmp_n;
+		}
+		closedir(d);
+		if (tmp_n == 0)
+			return;
+		nanosleep(&nap, NULL);
+	}
+}
+
+static void
+bench_usage(const char *name) {
+	fprintf(stderr, "\nusage:\t %s [-D rsyncme_d | -i addr] [-p port] [-n sessions] [-c concurrency] [-S size] [-r flips] [-L L] [-d dir] [-s seed] [-o csv] [-z codec] [-w profile [-P bench_proxy] [-C]]\n", name);
+	fprintf(stderr, "     \t -D path        : receiver to start on 127.0.0.1 [" BENCH_DAEMON_DEFAULT "]\n");
+	fprintf(stderr, "     \t -i addr        : use receiver already running at IPv4 @addr instead (must see files in @dir)\n");
+	fprintf(stderr, "     \t -p port        : receiver's port [%u]\n", RM_DEFAULT_PORT);
+	fprintf(stderr, "     \t -n sessions    : number of pushes [%u]\n", BENCH_SESSIONS_DEFAULT);
+	fprintf(stderr, "     \t -c concurrency : pushes in flight [%u]\n", BENCH_CONCURRENCY_DEFAULT);
+	fprintf(stderr, "     \t -S size        : size of file in bytes [%u]\n", BENCH_SIZE_DEFAULT);
+	fprintf(stderr, "     \t -r flips       : bytes of @x changed per MiB [%.1f]\n", BENCH_FLIPS_DEFAULT);
+	fprintf(stderr, "     \t -L L           : block size [%u]\n", RM_DEFAULT_L);
+	fprintf(stderr, "     \t -d dir         : directory for files [.]\n");
+	fprintf(stderr, "     \t -s seed        : seed of files [1]\n");
+	fprintf(stderr, "     \t -o csv         : per session results [" BENCH_CSV_DEFAULT "]\n");
+	fprintf(stderr, "     \t -z codec       : compress literal bytes with codec[+ref][:level] (none, zlib, zstd) [none]\n");
+	fprintf(stderr, "     \t -w profile     : push through proxy emulating link @profile (see bench_proxy -h)\n");
+	fprintf(stderr, "     \t -P path        : proxy to start on port [%u] [" BENCH_PROXY_DEFAULT "]\n", BENCH_PROXY_PORT);
+	fprintf(stderr, "     \t -C             : proxy asks receiver for dedicated delta connection\n\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	struct bench_load   load;
+	struct bench_worker *workers = NULL;
+	const char          *daemon_path = BENCH_DAEMON_DEFAULT, *dir = ".", *csv_path = BENCH_CSV_DEFAULT;
+	const char          *proxy_path = BENCH_PROXY_DEFAULT, *profile = NULL;
+	char                dir_abs[PATH_MAX];
+	uint32_t            concurrency = BENCH_CONCURRENCY_DEFAULT, i = 0, failed_n = 0, ok_n = 0;
+	uint64_t            sz = BENCH_SIZE_DEFAULT, seed = 1, rnd = 0, start = 0, wall_ns = 0;
+	uint64_t            *setup_ok = NULL, *done_ok = NULL;
+	double              flips = BENCH_FLIPS_DEFAULT, wall_s = 0.0;
+	pid_t               daemon_pid = -1, proxy_pid = -1;
+	uint8_t             delta_conn = 0;
+	FILE                *csv = NULL;
+	int                 opt = 0, status = 0;
+
+	memset(&load, 0, sizeof(load));
+	load.addr = NULL;
+	load.port = RM_DEFAULT_PORT;
+	load.L = RM_DEFAULT_L;
+	load.sessions_n = BENCH_SESSIONS_DEFAULT;
+	while ((opt = getopt(argc, argv, "D:i:p:n:c:S:r:L:d:s:o:z:w:P:Ch")) != -1) {
+		switch (opt) {
+			case 'D': daemon_path = optarg; break;
+			case 'i': load.addr = optarg; break;
+			case 'p': load.port = strtoul(optarg, NULL, 10); break;
+			case 'n': load.sessions_n = strtoul(optarg, NULL, 10); break;
+			case 'c': concurrency = strtoul(optarg, NULL, 10); break;
+			case 'S': sz = strtoull(optarg, NULL, 10); break;
+			case 'r': flips = strtod(optarg, NULL); break;
+			case 'L': load.L = strtoull(optarg, NULL, 10); break;
+			case 'd': dir = optarg; break;
+			case 's': seed = strtoull(optarg, NULL, 10); break;
+			case 'o': csv_path = optarg; break;
+			case 'z':
+				if (rm_codec_parse(optarg, &load.codec, &load.codec_level) != RM_ERR_OK || rm_codec_supported(load.codec) == 0)
+					bench_die("unknown or unsupported codec", optarg);
+				break;
+			case 'w': profile = optarg; break;
+			case 'P': proxy_path = optarg; break;
+			case 'C': delta_conn = 1; break;
+			default:
+				bench_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if (load.sessions_n == 0 || concurrency == 0 || sz == 0 || load.L == 0) {
+		bench_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+	if (realpath(dir, dir_abs) == NULL)
+		bench_die("bad directory", dir);
+	load.setup_ns = calloc(load.sessions_n, sizeof(uint64_t));
+	load.done_ns = calloc(load.sessions_n, sizeof(uint64_t));
+	load.err = calloc(load.sessions_n, sizeof(enum rm_error));
+	setup_ok = calloc(load.sessions_n, sizeof(uint64_t));
+	done_ok = calloc(load.sessions_n, sizeof(uint64_t));
+	workers = calloc(concurrency, sizeof(struct bench_worker));
+	if (load.setup_ns == NULL || load.done_ns == NULL || load.err == NULL || setup_ok == NULL || done_ok == NULL || workers == NULL)
+		bench_die("no memory", dir);
+	pthread_mutex_init(&load.mutex, NULL);
+
+	bench_rand_seed(&rnd, seed);
+	for (i = 0; i < concurrency; ++i) {             /* each thread syncs its own files, @y is left in place so it can repeat */
+		workers[i].load = &load;
+		snprintf(workers[i].x, sizeof(workers[i].x), "%s/rm_load_x_%u", dir_abs, i);
+		snprintf(workers[i].y, sizeof(workers[i].y), "%s/rm_load_y_%u", dir_abs, i);
+		snprintf(workers[i].z, sizeof(workers[i].z), "%s/rm_load_z_%u", dir_abs, i);
+		bench_files_create(workers[i].x, workers[i].y, sz, flips, &rnd);
+	}
+
+	if (load.addr == NULL) {
+		load.addr = "127.0.0.1";
+		daemon_pid = bench_daemon_start(daemon_path, dir_abs);
+	}
+	if (bench_daemon_wait_ready(load.addr, load.port) != 0) {
+		fprintf(stderr, "ERR, receiver at [%s:%u] doesn't accept connections\n", load.addr, load.port);
+		if (daemon_pid != -1)
+			kill(daemon_pid, SIGTERM);
+		exit(EXIT_FAILURE);
+	}
+	if (profile != NULL) {                          /* from now on pushes go through proxy */
+		proxy_pid = bench_proxy_start(proxy_path, dir_abs, profile, load.addr, load.port, delta_conn);
+		load.addr = "127.0.0.1";
+		load.port = BENCH_PROXY_PORT;
+		if (bench_daemon_wait_ready(load.addr, load.port) != 0) {
+			fprintf(stderr, "ERR, proxy at [%s:%u] doesn't accept connections (see %s/bench_proxy.log)\n", load.addr, load.port, dir_abs);
+			kill(proxy_pid, SIGTERM);
+			if (daemon_pid != -1)
+				kill(daemon_pid, SIGTERM);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	start = bench_now_ns();
+	for (i = 0; i < concurrency; ++i) {
+		if (pthread_create(&workers[i].tid, NULL, bench_worker_f, &workers[i]) != 0)
+			bench_die("can't create thread", dir);
+	}
+	for (i = 0; i < concurrency; ++i)
+		pthread_join(workers[i].tid, NULL);
+	wall_ns = bench_now_ns() - start;
+	wall_s = (double) wall_ns / RM_NANOSEC_PER_SEC;
+
+	if (daemon_pid != -1)
+		bench_daemon_wait_idle(dir_abs);
+	if (proxy_pid != -1) {
+		kill(proxy_pid, SIGTERM);
+		waitpid(proxy_pid, &status, 0);
+	}
+	if (daemon_pid != -1) {
+		kill(daemon_pid, SIGTERM);
+		waitpid(daemon_pid, &status, 0);
+	}
+
+	csv = fopen(csv_path, "w");
+	if (csv == NULL)
+		bench_die("can't open", csv_path);
+	fprintf(csv, "session,err,setup_ms,done_ms\n");
+	for (i = 0; i < load.sessions_n; ++i) {
+		fprintf(csv, "%u,%d,%.3f,%.3f\n", i, load.err[i], (double) load.setup_ns[i] / 1000000, (double) load.done_ns[i] / 1000000);
+		if (load.err[i] != RM_ERR_OK) {
+			++failed_n;
+			continue;
+		}
+		setup_ok[ok_n] = load.setup_ns[i];
+		done_ok[ok_n] = load.done_ns[i];
+		++ok_n;
+	}
+	fclose(csv);
+	qsort(setup_ok, ok_n, sizeof(uint64_t), bench_u64_cmp);
+	qsort(done_ok, ok_n, sizeof(uint64_t), bench_u64_cmp);
+
+	fprintf(stderr, "\nsessions    : [%u] (ok [%u], failed [%u]), concurrency [%u], file [%" PRIu64 "] bytes, [%.1f] flips/MiB, L [%zu]",
+			load.sessions_n, ok_n, failed_n, concurrency, sz, flips, load.L);
+	if (profile != NULL)
+		fprintf(stderr, "\nlink        : [%s]%s (proxy's report in [%s/bench_proxy.log])", profile, delta_conn ? ", delta connection" : "", dir_abs);
+	if (load.codec != RM_CODEC_NONE)
+		fprintf(stderr, "\nliterals    : [%" PRIu64 "] -> [%" PRIu64 "] bytes, codec [%s], level [%u]", load.raw_n, load.raw_z_n, rm_codec_str(load.codec), load.codec_level);
+	fprintf(stderr, "\ntime        : [%lf] s", wall_s);
+	fprintf(stderr, "\nthroughput  : [%lf] sessions/s, [%lf] MB/s (of files synced)", ok_n / wall_s, (double) ok_n * sz / 1000000 / wall_s);
+	fprintf(stderr, "\nsetup  [ms] : p50 [%.3f], p99 [%.3f], p999 [%.3f], max [%.3f]",
+			bench_percentile_ms(setup_ok, ok_n, 0.5), bench_percentile_ms(setup_ok, ok_n, 0.99), bench_percentile_ms(setup_ok, ok_n, 0.999), bench_percentile_ms(setup_ok, ok_n, 1.0));
+	fprintf(stderr, "\ndone   [ms] : p50 [%.3f], p99 [%.3f], p999 [%.3f], max [%.3f]",
+			bench_percentile_ms(done_ok, ok_n, 0.5), bench_percentile_ms(done_ok, ok_n, 0.99), bench_percentile_ms(done_ok, ok_n, 0.999), bench_percentile_ms(done_ok, ok_n, 1.0));
+	fprintf(stderr, "\nper session results written to [%s]\n", csv_path);
+
+	for (i = 0; i < concurrency; ++i) {
+		unlink(workers[i].x);
+		unlink(workers[i].y);
+		unlink(workers[i].z);
+	}
+	pthread_mutex_destroy(&load.mutex);
+	free(workers);
+	free(setup_ok);
+	free(done_ok);
+	free(load.err);
+	free(load.done_ns);
+	free(load.setup_ns);
+	return failed_n == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
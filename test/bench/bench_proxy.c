@@ -0,0 +1,596 @@
+/* @file        bench_proxy.c
+ * @brief       Userspace network emulation proxy.
+ * @details     Sits between transmitter and receiver (rsyncme and rsyncme_d)
+ *              and relays TCP connections with configurable one-way delay,
+ *              jitter and bandwidth cap in each direction, so protocol
+ *              changes can be measured on simulated WAN links without root
+ *              or netem. Delta connections are relayed too: receiver's delta
+ *              port in MSG_PUSH_ACK is replaced with port of proxy's own
+ *              listener, which forwards to the original one. With -C the proxy
+ *              asks receiver for dedicated delta connection (rewrites delta
+ *              mode in MSG_PUSH), so that path can be measured as well.
+ *              Usage: bench_proxy [-l port] [-a addr] [-p port] [-w profile]
+ *                     [-d delay] [-j jitter] [-b rate] [-C] [-s seed] [-v]
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 11:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_tcp.h"
+#include "bench.h"
+
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+
+
+#define PROXY_PORT_DEFAULT      5049u
+#define PROXY_CHUNK             (16u << 10)         /* max bytes read at once, unit of shaping */
+#define PROXY_QUEUE_MAX         (32u << 20)         /* max bytes held in delay line of single direction */
+#define PROXY_ACCEPT_TIMEOUT_MS 30000               /* wait that long for transmitter to connect to delta port */
+#define PROXY_POLL_MS           100
+#define PROXY_DRAIN_TIMEOUT_MS  10000               /* on SIGTERM wait that long for relayed connections to finish */
+
+struct proxy_profile {
+	const char  *name;
+	double      delay_ms;                       /* one way */
+	double      jitter_ms;                      /* delay varies uniformly within +/- jitter */
+	double      mbit;                           /* bandwidth of each direction in Mbit/s, 0: unlimited */
+};
+
+static const struct proxy_profile proxy_profiles[] = {
+	{ "loopback",           0.0,    0.0,    0.0 },
+	{ "lan",                0.2,    0.05,   1000.0 },
+	{ "metro",              5.0,    0.5,    200.0 },
+	{ "wan",                20.0,   2.0,    100.0 },
+	{ "dsl",                25.0,   5.0,    16.0 },
+	{ "intercontinental",   75.0,   5.0,    50.0 },
+	{ "mobile",             60.0,   20.0,   5.0 },
+	{ "satellite",          300.0,  30.0,   10.0 },
+};
+
+struct proxy {
+	const char              *addr;          /* receiver */
+	uint16_t                port;
+	uint64_t                delay_ns, jitter_ns;
+	double                  mbit;
+	uint8_t                 force_delta_conn;
+	uint8_t                 verbose;
+	pthread_mutex_t         mutex;          /* protects everything below */
+	uint64_t                seed;
+	uint32_t                active_n;       /* connections being relayed */
+	uint64_t                conns_n, delta_conns_n, conns_failed_n;
+	uint64_t                bytes_up, bytes_down;
+	uint64_t                push_rewritten_n, ack_rewritten_n;
+};
+
+enum proxy_hook {
+	PROXY_HOOK_NONE,
+	PROXY_HOOK_PUSH,                        /* first message from transmitter on control connection */
+	PROXY_HOOK_PUSH_ACK                     /* first message from receiver on control connection */
+};
+
+struct proxy_chunk {
+	struct proxy_chunk      *next;
+	uint64_t                due_ns;         /* monotonic, when chunk arrives at the other end */
+	size_t                  len;
+	unsigned char           data[];
+};
+
+/* Single direction of relayed connection. Reader takes bytes off the wire at
+ * most at link rate and puts them into delay line, writer delivers them when due. */
+struct proxy_pipe {
+	struct proxy            *proxy;
+	int                     from, to;
+	enum proxy_hook         hook;
+	pthread_t               reader_tid, writer_tid;
+	pthread_mutex_t         mutex;          /* protects delay line and flags */
+	pthread_cond_t          cond;
+	struct proxy_chunk      *head, *tail;
+	size_t                  queued;
+	uint8_t                 eof;            /* reader is done */
+	uint8_t                 failed;         /* writer is done */
+	uint64_t                wire_free_ns;   /* link is busy sending previous chunks until then */
+	uint64_t                last_due_ns;    /* stream is never reordered */
+	uint64_t                rnd;
+	uint64_t                bytes;
+};
+
+struct proxy_conn {
+	struct proxy            *proxy;
+	int                     client_fd, server_fd;
+	uint16_t                server_port;
+	uint8_t                 delta;          /* delta connection */
+	struct proxy_pipe       up, down;       /* transmitter to receiver, receiver to transmitter */
+};
+
+struct proxy_delta_listener {
+	struct proxy            *proxy;
+	int                     fd;
+	uint16_t                server_port;    /* receiver's delta port */
+};
+
+static volatile sig_atomic_t proxy_stop;
+
+static void *proxy_delta_f(void *arg);
+
+static void
+proxy_active_add(struct proxy *p, int n) {
+	pthread_mutex_lock(&p->mutex);
+	p->active_n += n;
+	pthread_mutex_unlock(&p->mutex);
+}
+
+static void
+proxy_sig_f(int signo) {
+	(void) signo;
+	proxy_stop = 1;
+}
+
+static void
+proxy_sleep_until(uint64_t t_ns) {
+	struct timespec t;
+
+	t.tv_sec = t_ns / RM_NANOSEC_PER_SEC;
+	t.tv_nsec = t_ns % RM_NANOSEC_PER_SEC;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR);
+}
+
+/* Open listener for transmitter's delta connection and relay it to receiver's @port.
+ * @return  proxy's port, 0 on failure (then ACK is forwarded as is) */
+static uint16_t
+proxy_delta_listen(struct proxy *p, uint16_t port) {
+	struct proxy_delta_listener *l = NULL;
+	pthread_t                   tid;
+	uint16_t                    proxy_port = 0;
+	int                         fd = -1;
+
+	if (rm_tcp_listen(&fd, INADDR_ANY, &proxy_port, 0, 1) != 0)
+		goto fail;
+	l = malloc(sizeof(*l));
+	if (l == NULL)
+		goto fail;
+	l->proxy = p;
+	l->fd = fd;
+	l->server_port = port;
+	proxy_active_add(p, 1);                                                     /* awaited connection counts as active */
+	if (rm_launch_thread(&tid, proxy_delta_f, l, PTHREAD_CREATE_DETACHED) != RM_ERR_OK) {
+		proxy_active_add(p, -1);
+		goto fail;
+	}
+	return proxy_port;
+
+fail:
+	free(l);
+	if (fd != -1)
+		close(fd);
+	return 0;
+}
+
+/* Offset of delta mode in MSG_PUSH @msg of @len bytes, 0 if absent (older transmitter). */
+static uint16_t
+proxy_push_delta_mode_offset(unsigned char *msg, uint16_t len) {
+	uint16_t    off = RM_MSG_HDR_LEN + RM_UUID_LEN + 8, sz = 0;                 /* ssid, L */
+	uint32_t    i = 0;
+
+	for (i = 0; i < 3; ++i) {                                                   /* x, y, z */
+		if (off + 2 > len)
+			return 0;
+		rm_deserialize_u16(msg + off, &sz);
+		off += 2 + sz;
+	}
+	off += 2 + 8;                                                               /* ch_ch_port, bytes */
+	return off < len ? off : 0;
+}
+
+/* Apply @pipe's hook to first message @msg of @len bytes. */
+static void
+proxy_hook(struct proxy_pipe *pipe, unsigned char *msg, uint16_t len) {
+	struct proxy    *p = pipe->proxy;
+	uint8_t         pt = rm_get_msg_hdr_pt(msg);
+	uint16_t        port = 0, proxy_port = 0, off = 0;
+
+	if (pipe->hook == PROXY_HOOK_PUSH && pt == RM_PT_MSG_PUSH && p->force_delta_conn) {
+		off = proxy_push_delta_mode_offset(msg, len);
+		if (off == 0)
+			return;                                                             /* older transmitter uses delta connection anyway */
+		msg[off] = RM_DELTA_MODE_CONN;
+		pthread_mutex_lock(&p->mutex);
+		++p->push_rewritten_n;
+		pthread_mutex_unlock(&p->mutex);
+	} else if (pipe->hook == PROXY_HOOK_PUSH_ACK && pt == RM_PT_MSG_PUSH_ACK && len >= RM_MSG_PUSH_ACK_LEN) {
+		rm_deserialize_u16(msg + RM_MSG_HDR_LEN, &port);
+		if (port == 0)
+			return;                                                             /* deltas follow on control connection */
+		proxy_port = proxy_delta_listen(p, port);
+		if (proxy_port == 0)
+			return;
+		rm_serialize_u16(msg + RM_MSG_HDR_LEN, proxy_port);                     /* header hash doesn't cover body */
+		pthread_mutex_lock(&p->mutex);
+		++p->ack_rewritten_n;
+		pthread_mutex_unlock(&p->mutex);
+	}
+}
+
+/* Put @len bytes of @data on the wire: wait for link to be free, queue them until they arrive. */
+static int
+proxy_pipe_send(struct proxy_pipe *pipe, const unsigned char *data, size_t len) {
+	struct proxy        *p = pipe->proxy;
+	struct proxy_chunk  *c = NULL;
+	uint64_t            now = bench_now_ns(), due = 0, jitter = 0;
+
+	c = malloc(sizeof(*c) + len);
+	if (c == NULL)
+		return -1;
+	memcpy(c->data, data, len);
+	c->len = len;
+	c->next = NULL;
+
+	if (pipe->wire_free_ns < now)
+		pipe->wire_free_ns = now;
+	if (p->mbit > 0.0)
+		pipe->wire_free_ns += (uint64_t) (len * 8000.0 / p->mbit);            /* serialization delay */
+	due = pipe->wire_free_ns + p->delay_ns;
+	if (p->jitter_ns > 0) {
+		jitter = bench_rand(&pipe->rnd) % (2 * p->jitter_ns + 1);
+		due = (due + jitter > p->jitter_ns) ? due + jitter - p->jitter_ns : 0;
+	}
+	c->due_ns = rm_max(due, pipe->last_due_ns);
+	pipe->last_due_ns = c->due_ns;
+
+	pthread_mutex_lock(&pipe->mutex);
+	while (pipe->queued >= PROXY_QUEUE_MAX && pipe->failed == 0)
+		pthread_cond_wait(&pipe->cond, &pipe->mutex);
+	if (pipe->failed) {
+		pthread_mutex_unlock(&pipe->mutex);
+		free(c);
+		return -1;
+	}
+	if (pipe->tail != NULL)
+		pipe->tail->next = c;
+	else
+		pipe->head = c;
+	pipe->tail = c;
+	pipe->queued += len;
+	pipe->bytes += len;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->mutex);
+
+	proxy_sleep_until(pipe->wire_free_ns);                                      /* don't take more off the wire than link would carry, sender sees backpressure */
+	return 0;
+}
+
+static void *
+proxy_pipe_reader_f(void *arg) {
+	struct proxy_pipe   *pipe = arg;
+	unsigned char       buf[PROXY_CHUNK];
+	unsigned char       *msg = NULL;
+	uint16_t            len = 0;
+	ssize_t             read_n = 0;
+
+	if (pipe->hook != PROXY_HOOK_NONE) {                                        /* first message is taken whole */
+		if (rm_tcp_read(pipe->from, buf, RM_MSG_HDR_LEN) != RM_ERR_OK)
+			goto done;
+		len = rm_get_msg_hdr_len(buf);
+		if (len < RM_MSG_HDR_LEN)
+			goto done;
+		msg = malloc(len);
+		if (msg == NULL)
+			goto done;
+		memcpy(msg, buf, RM_MSG_HDR_LEN);
+		if (rm_tcp_read(pipe->from, msg + RM_MSG_HDR_LEN, len - RM_MSG_HDR_LEN) != RM_ERR_OK)
+			goto done;
+		proxy_hook(pipe, msg, len);
+		if (proxy_pipe_send(pipe, msg, len) != 0)
+			goto done;
+	}
+	while (1) {
+		read_n = read(pipe->from, buf, sizeof(buf));
+		if (read_n < 0 && errno == EINTR)
+			continue;
+		if (read_n <= 0)
+			break;
+		if (proxy_pipe_send(pipe, buf, read_n) != 0)
+			break;
+	}
+
+done:
+	free(msg);
+	pthread_mutex_lock(&pipe->mutex);
+	pipe->eof = 1;
+	pthread_cond_broadcast(&pipe->cond);
+	pthread_mutex_unlock(&pipe->mutex);
+	return NULL;
+}
+
+static void *
+proxy_pipe_writer_f(void *arg) {
+	struct proxy_pipe   *pipe = arg;
+	struct proxy_chunk  *c = NULL;
+	uint64_t            due = 0;
+
+	while (1) {
+		pthread_mutex_lock(&pipe->mutex);
+		while (pipe->head == NULL && pipe->eof == 0)
+			pthread_cond_wait(&pipe->cond, &pipe->mutex);
+		if (pipe->head == NULL) {
+			pthread_mutex_unlock(&pipe->mutex);
+			break;
+		}
+		due = pipe->head->due_ns;                                               /* only reader appends, head stays */
+		pthread_mutex_unlock(&pipe->mutex);
+
+		proxy_sleep_until(due);
+
+		pthread_mutex_lock(&pipe->mutex);
+		c = pipe->head;
+		pipe->head = c->next;
+		if (pipe->head == NULL)
+			pipe->tail = NULL;
+		pipe->queued -= c->len;
+		pthread_cond_broadcast(&pipe->cond);
+		pthread_mutex_unlock(&pipe->mutex);
+
+		if (rm_tcp_write(pipe->to, c->data, c->len) != RM_ERR_OK) {
+			free(c);
+			pthread_mutex_lock(&pipe->mutex);
+			pipe->failed = 1;
+			pthread_cond_broadcast(&pipe->cond);
+			pthread_mutex_unlock(&pipe->mutex);
+			shutdown(pipe->from, SHUT_RD);                                      /* wake up reader */
+			break;
+		}
+		free(c);
+	}
+	shutdown(pipe->to, SHUT_WR);                                                /* pass EOF on */
+	return NULL;
+}
+
+static void
+proxy_pipe_init(struct proxy_pipe *pipe, struct proxy *p, int from, int to, enum proxy_hook hook) {
+	memset(pipe, 0, sizeof(*pipe));
+	pipe->proxy = p;
+	pipe->from = from;
+	pipe->to = to;
+	pipe->hook = hook;
+	pthread_mutex_init(&pipe->mutex, NULL);
+	pthread_cond_init(&pipe->cond, NULL);
+	pthread_mutex_lock(&p->mutex);
+	bench_rand_seed(&pipe->rnd, p->seed++);
+	pthread_mutex_unlock(&p->mutex);
+}
+
+static void
+proxy_pipe_deinit(struct proxy_pipe *pipe) {
+	struct proxy_chunk  *c = NULL;
+
+	while ((c = pipe->head) != NULL) {
+		pipe->head = c->next;
+		free(c);
+	}
+	pthread_cond_destroy(&pipe->cond);
+	pthread_mutex_destroy(&pipe->mutex);
+}
+
+/* Relay connection @c (both directions) until both ends are done with it. */
+static void
+proxy_conn_relay(struct proxy_conn *c) {
+	struct proxy    *p = c->proxy;
+	const char      *err_str = NULL;
+	struct proxy_pipe *pipes[2] = { &c->up, &c->down };
+	uint32_t        i = 0;
+
+	if (rm_tcp_connect(&c->server_fd, p->addr, c->server_port, AF_INET, &err_str) != RM_ERR_OK) {
+		if (p->verbose)
+			fprintf(stderr, "proxy: can't connect to [%s:%u]: %s\n", p->addr, c->server_port, err_str ? err_str : "");
+		pthread_mutex_lock(&p->mutex);
+		--p->active_n;
+		++p->conns_failed_n;
+		pthread_mutex_unlock(&p->mutex);
+		return;
+	}
+	proxy_pipe_init(&c->up, p, c->client_fd, c->server_fd, c->delta ? PROXY_HOOK_NONE : PROXY_HOOK_PUSH);
+	proxy_pipe_init(&c->down, p, c->server_fd, c->client_fd, c->delta ? PROXY_HOOK_NONE : PROXY_HOOK_PUSH_ACK);
+	for (i = 0; i < 2; ++i) {
+		if (rm_launch_thread(&pipes[i]->reader_tid, proxy_pipe_reader_f, pipes[i], PTHREAD_CREATE_JOINABLE) != RM_ERR_OK
+				|| rm_launch_thread(&pipes[i]->writer_tid, proxy_pipe_writer_f, pipes[i], PTHREAD_CREATE_JOINABLE) != RM_ERR_OK) {
+			fprintf(stderr, "ERR, proxy: can't launch threads\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < 2; ++i) {
+		pthread_join(pipes[i]->reader_tid, NULL);
+		pthread_join(pipes[i]->writer_tid, NULL);
+	}
+
+	pthread_mutex_lock(&p->mutex);
+	--p->active_n;
+	if (c->delta)
+		++p->delta_conns_n;
+	else
+		++p->conns_n;
+	p->bytes_up += c->up.bytes;
+	p->bytes_down += c->down.bytes;
+	pthread_mutex_unlock(&p->mutex);
+	if (p->verbose)
+		fprintf(stderr, "proxy: %s connection done, [%" PRIu64 "] bytes up, [%" PRIu64 "] bytes down\n", c->delta ? "delta" : "control", c->up.bytes, c->down.bytes);
+	proxy_pipe_deinit(&c->up);
+	proxy_pipe_deinit(&c->down);
+}
+
+/* Thread of relayed connection. */
+static void *
+proxy_conn_f(void *arg) {
+	struct proxy_conn   *c = arg;
+
+	proxy_conn_relay(c);
+	close(c->client_fd);
+	if (c->server_fd != -1)
+		close(c->server_fd);
+	free(c);
+	return NULL;
+}
+
+/* Thread of delta listener, waits for transmitter's delta connection and relays it. */
+static void *
+proxy_delta_f(void *arg) {
+	struct proxy_delta_listener *l = arg;
+	struct proxy_conn           *c = NULL;
+	struct pollfd               pfd;
+	int                         fd = -1;
+
+	pfd.fd = l->fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, PROXY_ACCEPT_TIMEOUT_MS) == 1)
+		fd = accept(l->fd, NULL, NULL);
+	close(l->fd);
+	if (fd != -1) {
+		c = calloc(1, sizeof(*c));
+		if (c != NULL) {
+			c->proxy = l->proxy;
+			c->client_fd = fd;
+			c->server_fd = -1;
+			c->server_port = l->server_port;
+			c->delta = 1;
+			free(l);
+			return proxy_conn_f(c);
+		}
+		close(fd);
+	}
+	proxy_active_add(l->proxy, -1);
+	free(l);
+	return NULL;
+}
+
+static void
+proxy_usage(const char *name) {
+	size_t  i = 0;
+
+	fprintf(stderr, "\nusage:\t %s [-l port] [-a addr] [-p port] [-w profile] [-d delay] [-j jitter] [-b rate] [-C] [-s seed] [-v]\n", name);
+	fprintf(stderr, "     \t -l port    : proxy's port [%u]\n", PROXY_PORT_DEFAULT);
+	fprintf(stderr, "     \t -a addr    : receiver's IPv4 address [127.0.0.1]\n");
+	fprintf(stderr, "     \t -p port    : receiver's port [%u]\n", RM_DEFAULT_PORT);
+	fprintf(stderr, "     \t -w profile : link profile (-d, -j, -b override its values) [loopback]\n");
+	fprintf(stderr, "     \t -d delay   : one way delay in ms\n");
+	fprintf(stderr, "     \t -j jitter  : delay varies by up to +/- jitter ms\n");
+	fprintf(stderr, "     \t -b rate    : bandwidth of each direction in Mbit/s, 0: unlimited\n");
+	fprintf(stderr, "     \t -C         : ask receiver for dedicated delta connection\n");
+	fprintf(stderr, "     \t -s seed    : seed of jitter [1]\n");
+	fprintf(stderr, "     \t -v         : report each connection\n");
+	fprintf(stderr, "\n     \t profiles (delay [ms], jitter [ms], rate [Mbit/s]):\n");
+	for (i = 0; i < sizeof(proxy_profiles) / sizeof(proxy_profiles[0]); ++i)
+		fprintf(stderr, "     \t %-18s %8.2f %8.2f %8.1f\n", proxy_profiles[i].name, proxy_profiles[i].delay_ms, proxy_profiles[i].jitter_ms, proxy_profiles[i].mbit);
+	fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	struct proxy        p;
+	struct proxy_conn   *c = NULL;
+	const struct proxy_profile  *profile = &proxy_profiles[0];
+	struct sigaction    sa;
+	struct pollfd       pfd;
+	pthread_t           tid;
+	double              delay_ms = -1.0, jitter_ms = -1.0, mbit = -1.0;
+	uint16_t            port = PROXY_PORT_DEFAULT;
+	size_t              i = 0;
+	uint32_t            waited_ms = 0, active_n = 0;
+	int                 opt = 0, fd = -1, cfd = -1;
+
+	memset(&p, 0, sizeof(p));
+	p.addr = "127.0.0.1";
+	p.port = RM_DEFAULT_PORT;
+	p.seed = 1;
+	while ((opt = getopt(argc, argv, "l:a:p:w:d:j:b:Cs:vh")) != -1) {
+		switch (opt) {
+			case 'l': port = strtoul(optarg, NULL, 10); break;
+			case 'a': p.addr = optarg; break;
+			case 'p': p.port = strtoul(optarg, NULL, 10); break;
+			case 'w':
+				for (i = 0; i < sizeof(proxy_profiles) / sizeof(proxy_profiles[0]); ++i) {
+					if (strcmp(optarg, proxy_profiles[i].name) == 0)
+						break;
+				}
+				if (i == sizeof(proxy_profiles) / sizeof(proxy_profiles[0])) {
+					fprintf(stderr, "ERR, unknown profile [%s]\n", optarg);
+					proxy_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				profile = &proxy_profiles[i];
+				break;
+			case 'd': delay_ms = strtod(optarg, NULL); break;
+			case 'j': jitter_ms = strtod(optarg, NULL); break;
+			case 'b': mbit = strtod(optarg, NULL); break;
+			case 'C': p.force_delta_conn = 1; break;
+			case 's': p.seed = strtoull(optarg, NULL, 10); break;
+			case 'v': p.verbose = 1; break;
+			default:
+				proxy_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if (delay_ms < 0.0)
+		delay_ms = profile->delay_ms;
+	if (jitter_ms < 0.0)
+		jitter_ms = profile->jitter_ms;
+	if (mbit < 0.0)
+		mbit = profile->mbit;
+	p.delay_ns = (uint64_t) (delay_ms * 1000000);
+	p.jitter_ns = (uint64_t) (jitter_ms * 1000000);
+	p.mbit = mbit;
+	pthread_mutex_init(&p.mutex, NULL);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);                                              /* peer gone, write fails instead */
+	sa.sa_handler = proxy_sig_f;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+
+	if (rm_tcp_listen(&fd, INADDR_ANY, &port, 1, RM_SERVER_LISTENQ) != 0) {
+		fprintf(stderr, "ERR, can't listen on port [%u]: %s\n", port, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fprintf(stderr, "proxy: [%u] -> [%s:%u], profile [%s], delay [%.2f] ms, jitter [%.2f] ms, rate [%.1f] Mbit/s%s\n",
+			port, p.addr, p.port, profile->name, delay_ms, jitter_ms, mbit, p.force_delta_conn ? ", delta connection" : "");
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (proxy_stop == 0) {
+		if (poll(&pfd, 1, PROXY_POLL_MS) != 1)
+			continue;
+		cfd = accept(fd, NULL, NULL);
+		if (cfd == -1)
+			continue;
+		c = calloc(1, sizeof(*c));
+		if (c == NULL) {
+			close(cfd);
+			continue;
+		}
+		c->proxy = &p;
+		c->client_fd = cfd;
+		c->server_fd = -1;
+		c->server_port = p.port;
+		proxy_active_add(&p, 1);
+		if (rm_launch_thread(&tid, proxy_conn_f, c, PTHREAD_CREATE_DETACHED) != RM_ERR_OK) {
+			proxy_active_add(&p, -1);
+			close(cfd);
+			free(c);
+		}
+	}
+	close(fd);
+
+	for (waited_ms = 0; waited_ms < PROXY_DRAIN_TIMEOUT_MS; waited_ms += PROXY_POLL_MS) {
+		pthread_mutex_lock(&p.mutex);
+		active_n = p.active_n;
+		pthread_mutex_unlock(&p.mutex);
+		if (active_n == 0)
+			break;
+		poll(NULL, 0, PROXY_POLL_MS);
+	}
+	pthread_mutex_lock(&p.mutex);
+	fprintf(stderr, "proxy: connections [%" PRIu64 "] (failed [%" PRIu64 "], unfinished [%u]), delta connections [%" PRIu64 "], bytes up [%" PRIu64 "], down [%" PRIu64 "], push rewritten [%" PRIu64 "], ack rewritten [%" PRIu64 "]\n",
+			p.conns_n, p.conns_failed_n, p.active_n, p.delta_conns_n, p.bytes_up, p.bytes_down, p.push_rewritten_n, p.ack_rewritten_n);
+	pthread_mutex_unlock(&p.mutex);
+	return EXIT_SUCCESS;
+}
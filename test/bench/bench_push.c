@@ -0,0 +1,471 @@
+/* @file        bench_push.c
+ * @brief       End-to-end local push benchmark on synthetic workloads.
+ * @details     Creates reference file @y of given size from seed and new file @x
+ *              from @y by one of mutation models, then syncs @y to @x with
+ *              rm_tx_local_push over matrix of block size and thresholds. Each
+ *              push runs in child process so peak RSS and CPU time are per run.
+ *              Files are generated in chunks, so sizes of tens of GB are fine.
+ *              Files are random or low-entropy (text, sparse), the latter show
+ *              weak checksum collisions of rolling checksums given with -r.
+ *              Usage: bench_push [-d dir] [-S sizes] [-m models] [-n mutations]
+ *                     [-L list] [-a list] [-t list] [-x list] [-r rolls]
+ *                     [-c content] [-p] [-s seed] [-o csv]
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @date        19 Oct 2026 08:00 PM
+ * @copyright   LGPLv2.1 */
+
+
+#include "rm_tx.h"
+#include "bench.h"
+
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+#define BENCH_CSV_DEFAULT       "bench_push.csv"
+#define BENCH_CHUNK             (1u << 20)          /* files are generated in chunks of this size */
+#define BENCH_EDIT_MAX          4096u               /* max length of inserted/deleted/appended/truncated block */
+#define BENCH_SHUFFLE_BLOCK     (64u << 10)         /* block moved by shuffle */
+#define BENCH_SHUFFLE_WINDOW    1024u               /* blocks are shuffled within windows of that many blocks */
+#define BENCH_LIST_MAX          16u
+#define BENCH_MUTATIONS_DEFAULT 16u
+
+enum bench_model {
+	BENCH_MODEL_FLIP,                               /* random bytes of @y flipped */
+	BENCH_MODEL_INSERT,                             /* random blocks inserted into @y (shifts the rest) */
+	BENCH_MODEL_DELETE,                             /* random blocks deleted from @y (shifts the rest) */
+	BENCH_MODEL_APPEND,                             /* random blocks appended to @y */
+	BENCH_MODEL_TRUNCATE,                           /* end of @y cut off */
+	BENCH_MODEL_SHUFFLE,                            /* blocks of @y reordered */
+	BENCH_MODEL_RANDOM,                             /* @x unrelated to @y */
+	BENCH_MODELS_N
+};
+
+enum bench_content {
+	BENCH_CONTENT_RANDOM,                           /* uniformly random bytes */
+	BENCH_CONTENT_TEXT,                             /* lines of 16 letter alphabet */
+	BENCH_CONTENT_SPARSE,                           /* mostly zeros */
+	BENCH_CONTENTS_N
+};
+
+static const char *bench_content_str[BENCH_CONTENTS_N] = {
+	[BENCH_CONTENT_RANDOM]  = "random",
+	[BENCH_CONTENT_TEXT]    = "text",
+	[BENCH_CONTENT_SPARSE]  = "sparse"
+};
+
+static const char *bench_model_str[BENCH_MODELS_N] = {
+	[BENCH_MODEL_FLIP]      = "flip",
+	[BENCH_MODEL_INSERT]    = "insert",
+	[BENCH_MODEL_DELETE]    = "delete",
+	[BENCH_MODEL_APPEND]    = "append",
+	[BENCH_MODEL_TRUNCATE]  = "truncate",
+	[BENCH_MODEL_SHUFFLE]   = "shuffle",
+	[BENCH_MODEL_RANDOM]    = "random"
+};
+
+struct bench_list {
+	uint64_t    v[BENCH_LIST_MAX];
+	uint32_t    n;
+};
+
+struct bench_result {
+	enum rm_error                   err;
+	struct rm_delta_reconstruct_ctx rec_ctx;
+	struct rusage                   ru;             /* of child that did the push */
+};
+
+static unsigned char    bench_buf[BENCH_CHUNK];
+static enum bench_content   bench_content = BENCH_CONTENT_RANDOM;   /* of @y and inserted blocks */
+
+static void
+bench_die(const char *what, const char *path) {
+	fprintf(stderr, "ERR, %s [%s]: %s\n", what, path, strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+/* Parse comma separated list of numbers with optional k, m, g (binary) suffix. */
+static int
+bench_list_parse(const char *s, struct bench_list *l) {
+	char        *end = NULL;
+	uint64_t    v = 0;
+
+	l->n = 0;
+	while (*s != '\0') {
+		if (l->n == BENCH_LIST_MAX)
+			return -1;
+		v = strtoull(s, &end, 10);
+		if (end == s)
+			return -1;
+		switch (*end) {
+			case 'k': case 'K': v <<= 10; ++end; break;
+			case 'm': case 'M': v <<= 20; ++end; break;
+			case 'g': case 'G': v <<= 30; ++end; break;
+			default: break;
+		}
+		l->v[l->n++] = v;
+		if (*end == ',')
+			++end;
+		else if (*end != '\0')
+			return -1;
+		s = end;
+	}
+	return l->n > 0 ? 0 : -1;
+}
+
+static int
+bench_models_parse(const char *s, uint8_t models[BENCH_MODELS_N]) {
+	char        name[32];
+	size_t      len = 0;
+	uint32_t    i = 0, n = 0;
+
+	memset(models, 0, BENCH_MODELS_N);
+	while (*s != '\0') {
+		len = strcspn(s, ",");
+		if (len == 0 || len >= sizeof(name))
+			return -1;
+		memcpy(name, s, len);
+		name[len] = '\0';
+		for (i = 0; i < BENCH_MODELS_N; ++i) {
+			if (strcmp(name, bench_model_str[i]) == 0)
+				break;
+		}
+		if (i == BENCH_MODELS_N)
+			return -1;
+		models[i] = 1;
+		++n;
+		s += len;
+		if (*s == ',')
+			++s;
+	}
+	return n > 0 ? 0 : -1;
+}
+
+/* Parse comma separated list of rolling checksums. */
+static int
+bench_rolls_parse(const char *s, uint8_t rolls[RM_ROLL_POLY + 1], uint32_t *n) {
+	char        name[32];
+	size_t      len = 0;
+
+	*n = 0;
+	while (*s != '\0') {
+		len = strcspn(s, ",");
+		if (len == 0 || len >= sizeof(name) || *n == RM_ROLL_POLY + 1)
+			return -1;
+		memcpy(name, s, len);
+		name[len] = '\0';
+		if (rm_roll_parse(name, &rolls[*n]) != RM_ERR_OK)
+			return -1;
+		++*n;
+		s += len;
+		if (*s == ',')
+			++s;
+	}
+	return *n > 0 ? 0 : -1;
+}
+
+static int
+bench_content_parse(const char *s) {
+	uint32_t    i = 0;
+
+	for (i = 0; i < BENCH_CONTENTS_N; ++i) {
+		if (strcmp(s, bench_content_str[i]) == 0) {
+			bench_content = i;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Random bytes turned into bench_content. */
+static void
+bench_write_random(FILE *f, uint64_t *rnd, uint64_t len, const char *path) {
+	size_t  n = 0, i = 0;
+
+	while (len > 0) {
+		n = rm_min(len, (uint64_t) BENCH_CHUNK);
+		bench_rand_fill(rnd, bench_buf, n);
+		if (bench_content == BENCH_CONTENT_TEXT) {
+			for (i = 0; i < n; ++i)
+				bench_buf[i] = (bench_buf[i] < 4) ? '\n' : (bench_buf[i] < 40 ? ' ' : 'a' + (bench_buf[i] & 0x0f));
+		} else if (bench_content == BENCH_CONTENT_SPARSE) {
+			for (i = 0; i < n; ++i)
+				bench_buf[i] = (bench_buf[i] < 4) ? bench_buf[i] + 1 : 0;
+		}
+		if (fwrite(bench_buf, n, 1, f) != 1)
+			bench_die("can't write", path);
+		len -= n;
+	}
+}
+
+/* Copy @len bytes of @f_y from @from to current position of @f_x. */
+static void
+bench_copy(FILE *f_y, FILE *f_x, uint64_t from, uint64_t len, const char *path) {
+	size_t  n = 0;
+
+	if (fseeko(f_y, from, SEEK_SET) != 0)
+		bench_die("can't seek", path);
+	while (len > 0) {
+		n = rm_min(len, (uint64_t) BENCH_CHUNK);
+		if (fread(bench_buf, n, 1, f_y) != 1 || fwrite(bench_buf, n, 1, f_x) != 1)
+			bench_die("can't copy", path);
+		len -= n;
+	}
+}
+
+static int
+bench_pos_cmp(const void *a, const void *b) {
+	uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+
+	return (x > y) - (x < y);
+}
+
+/* Make @x from @y (of @y_sz bytes) applying @n mutations of @model.
+ * @return  Size of @x. */
+static uint64_t
+bench_mutate(enum bench_model model, const char *y, const char *x, uint64_t y_sz, uint32_t n, uint64_t *rnd) {
+	FILE        *f_y = NULL, *f_x = NULL;
+	uint64_t    *pos = NULL, at = 0, len = 0, x_sz = 0, blocks_n = 0, w = 0, i = 0, j = 0, k = 0, tmp = 0;
+	uint64_t    perm[BENCH_SHUFFLE_WINDOW];
+	unsigned char   b = 0;
+
+	f_y = fopen(y, "rb");
+	if (f_y == NULL)
+		bench_die("can't open", y);
+	f_x = fopen(x, "wb");
+	if (f_x == NULL)
+		bench_die("can't open", x);
+
+	switch (model) {
+
+		case BENCH_MODEL_FLIP:
+		case BENCH_MODEL_INSERT:
+		case BENCH_MODEL_DELETE:
+			pos = malloc(sizeof(uint64_t) * (n + 1));
+			if (pos == NULL)
+				bench_die("no memory", x);
+			for (i = 0; i < n; ++i)
+				pos[i] = y_sz ? bench_rand(rnd) % y_sz : 0;
+			qsort(pos, n, sizeof(uint64_t), bench_pos_cmp);
+			for (i = 0; i < n; ++i) {
+				if (pos[i] < at)
+					continue;                       /* inside block deleted already */
+				bench_copy(f_y, f_x, at, pos[i] - at, y);
+				at = pos[i];
+				if (model == BENCH_MODEL_FLIP) {
+					if (at == y_sz)
+						continue;
+					if (fread(&b, 1, 1, f_y) != 1)
+						bench_die("can't read", y);
+					b ^= (unsigned char) (1 + bench_rand(rnd) % 255);
+					if (fwrite(&b, 1, 1, f_x) != 1)
+						bench_die("can't write", x);
+					++at;
+				} else {
+					len = 1 + bench_rand(rnd) % BENCH_EDIT_MAX;
+					if (model == BENCH_MODEL_INSERT)
+						bench_write_random(f_x, rnd, len, x);
+					else
+						at = rm_min(at + len, y_sz);
+				}
+			}
+			bench_copy(f_y, f_x, at, y_sz - at, y);
+			free(pos);
+			break;
+
+		case BENCH_MODEL_APPEND:
+			bench_copy(f_y, f_x, 0, y_sz, y);
+			for (i = 0; i < n; ++i)
+				bench_write_random(f_x, rnd, 1 + bench_rand(rnd) % BENCH_EDIT_MAX, x);
+			break;
+
+		case BENCH_MODEL_TRUNCATE:
+			for (i = 0; i < n; ++i)
+				len += 1 + bench_rand(rnd) % BENCH_EDIT_MAX;
+			bench_copy(f_y, f_x, 0, y_sz - rm_min(len, y_sz / 2), y);
+			break;
+
+		case BENCH_MODEL_SHUFFLE:
+			blocks_n = y_sz / BENCH_SHUFFLE_BLOCK;
+			for (w = 0; w < blocks_n; w += BENCH_SHUFFLE_WINDOW) {
+				k = rm_min(blocks_n - w, (uint64_t) BENCH_SHUFFLE_WINDOW);
+				for (i = 0; i < k; ++i)
+					perm[i] = w + i;
+				for (i = k; i > 1; --i) {           /* Fisher-Yates */
+					j = bench_rand(rnd) % i;
+					tmp = perm[i - 1];
+					perm[i - 1] = perm[j];
+					perm[j] = tmp;
+				}
+				for (i = 0; i < k; ++i)
+					bench_copy(f_y, f_x, perm[i] * BENCH_SHUFFLE_BLOCK, BENCH_SHUFFLE_BLOCK, y);
+			}
+			bench_copy(f_y, f_x, blocks_n * BENCH_SHUFFLE_BLOCK, y_sz - blocks_n * BENCH_SHUFFLE_BLOCK, y);
+			break;
+
+		case BENCH_MODEL_RANDOM:
+		default:
+			bench_write_random(f_x, rnd, y_sz, x);
+			break;
+	}
+
+	x_sz = ftello(f_x);
+	if (fclose(f_x) != 0)
+		bench_die("can't write", x);
+	fclose(f_y);
+	return x_sz;
+}
+
+/* Push in child process, so resource usage is of this run only. */
+static void
+bench_run(const char *x, const char *y, const char *z, size_t L, size_t copy_all_threshold, size_t copy_tail_threshold, size_t send_threshold,
+		uint8_t roll, uint8_t prefilter, struct bench_result *res, double *wall_s) {
+	struct rm_tx_options    opt = { .loglevel = RM_LOGLEVEL_NORMAL, .inflight = RM_TREE_INFLIGHT_DEFAULT, .queue_bytes = RM_DELTA_QUEUE_BYTES, .roll = roll, .prefilter = prefilter };
+	int         fds[2] = { -1, -1 }, status = 0;
+	pid_t       pid = 0;
+	uint64_t    start = 0;
+
+	memset(res, 0, sizeof(struct bench_result));
+	if (pipe(fds) != 0)
+		bench_die("can't create pipe", z);
+	start = bench_now_ns();
+	pid = fork();
+	if (pid == -1)
+		bench_die("can't fork", z);
+	if (pid == 0) {
+		close(fds[0]);
+		res->err = rm_tx_local_push(x, y, z, L, copy_all_threshold, copy_tail_threshold, send_threshold, RM_BIT_6, &res->rec_ctx, &opt);  /* leave @y */
+		getrusage(RUSAGE_SELF, &res->ru);
+		if (write(fds[1], res, sizeof(struct bench_result)) != sizeof(struct bench_result))
+			_exit(EXIT_FAILURE);
+		_exit(EXIT_SUCCESS);
+	}
+	close(fds[1]);
+	if (read(fds[0], res, sizeof(struct bench_result)) != sizeof(struct bench_result))
+		res->err = RM_ERR_FAIL;
+	close(fds[0]);
+	if (waitpid(pid, &status, 0) == -1)
+		bench_die("can't wait for child", z);
+	*wall_s = (double) (bench_now_ns() - start) / RM_NANOSEC_PER_SEC;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+		res->err = RM_ERR_FAIL;
+	unlink(z);
+}
+
+static void
+bench_usage(const char *name) {
+	fprintf(stderr, "\nusage:\t %s [-d dir] [-S sizes] [-m models] [-n mutations] [-L list] [-a list] [-t list] [-x list] [-r rolls] [-c content] [-p] [-s seed] [-o csv]\n", name);
+	fprintf(stderr, "     \t -d dir       : directory for @x, @y and @z [.]\n");
+	fprintf(stderr, "     \t -S sizes     : sizes of @y, e.g. 4k,1m,10g [1m,64m]\n");
+	fprintf(stderr, "     \t -m models    : flip,insert,delete,append,truncate,shuffle,random [all]\n");
+	fprintf(stderr, "     \t -n mutations : number of mutations (flip, insert, delete, append, truncate) [%u]\n", BENCH_MUTATIONS_DEFAULT);
+	fprintf(stderr, "     \t -L list      : block sizes [%u]\n", RM_DEFAULT_L);
+	fprintf(stderr, "     \t -a list      : copy all thresholds [0]\n");
+	fprintf(stderr, "     \t -t list      : copy tail thresholds [0]\n");
+	fprintf(stderr, "     \t -x list      : send thresholds, 0: block size [0]\n");
+	fprintf(stderr, "     \t -r rolls     : rolling checksums, fast,poly [fast]\n");
+	fprintf(stderr, "     \t -c content   : random, text or sparse [random]\n");
+	fprintf(stderr, "     \t -p           : check fast checksum matches with CRC32C before MD5\n");
+	fprintf(stderr, "     \t -s seed      : seed of workload [1]\n");
+	fprintf(stderr, "     \t -o csv       : output file [" BENCH_CSV_DEFAULT "]\n\n");
+	fprintf(stderr, "     \t Lists are comma separated, numbers may have k, m or g suffix.\n\n");
+}
+
+int
+main(int argc, char *argv[]) {
+	const char          *dir = ".", *csv_path = BENCH_CSV_DEFAULT;
+	char                dir_abs[PATH_MAX], x[PATH_MAX + 16], y[PATH_MAX + 16], z[PATH_MAX + 16];
+	struct bench_list   sizes = { { 1u << 20, 64u << 20 }, 2 }, Ls = { { RM_DEFAULT_L }, 1 },
+						alls = { { 0 }, 1 }, tails = { { 0 }, 1 }, sends = { { 0 }, 1 };
+	uint8_t             models[BENCH_MODELS_N];
+	uint8_t             rolls[RM_ROLL_POLY + 1] = { RM_ROLL_FAST }, prefilter = RM_PREFILTER_NONE;
+	uint32_t            mutations = BENCH_MUTATIONS_DEFAULT, m = 0, si = 0, li = 0, ai = 0, ti = 0, xi = 0, ri = 0, rolls_n = 1;
+	uint64_t            seed = 1, rnd = 0, y_sz = 0, x_sz = 0;
+	size_t              send_threshold = 0;
+	FILE                *f = NULL, *csv = NULL;
+	struct bench_result res;
+	double              wall_s = 0.0, cpu_s = 0.0;
+	int                 opt = 0;
+
+	memset(models, 1, sizeof(models));
+	while ((opt = getopt(argc, argv, "d:S:m:n:L:a:t:x:r:c:ps:o:h")) != -1) {
+		switch (opt) {
+			case 'd': dir = optarg; break;
+			case 'S': if (bench_list_parse(optarg, &sizes) != 0) goto usage; break;
+			case 'm': if (bench_models_parse(optarg, models) != 0) goto usage; break;
+			case 'n': mutations = strtoul(optarg, NULL, 10); break;
+			case 'L': if (bench_list_parse(optarg, &Ls) != 0) goto usage; break;
+			case 'a': if (bench_list_parse(optarg, &alls) != 0) goto usage; break;
+			case 't': if (bench_list_parse(optarg, &tails) != 0) goto usage; break;
+			case 'x': if (bench_list_parse(optarg, &sends) != 0) goto usage; break;
+			case 'r': if (bench_rolls_parse(optarg, rolls, &rolls_n) != 0) goto usage; break;
+			case 'c': if (bench_content_parse(optarg) != 0) goto usage; break;
+			case 'p': prefilter = RM_PREFILTER_CRC32C; break;
+			case 's': seed = strtoull(optarg, NULL, 10); break;
+			case 'o': csv_path = optarg; break;
+			default: goto usage;
+		}
+	}
+	for (li = 0; li < Ls.n; ++li) {
+		if (Ls.v[li] == 0)
+			goto usage;
+	}
+	if (realpath(dir, dir_abs) == NULL)
+		bench_die("bad directory", dir);
+	snprintf(x, sizeof(x), "%s/rm_bench_x", dir_abs);
+	snprintf(y, sizeof(y), "%s/rm_bench_y", dir_abs);
+	snprintf(z, sizeof(z), "%s/rm_bench_z", dir_abs);
+
+	csv = fopen(csv_path, "w");
+	if (csv == NULL)
+		bench_die("can't open", csv_path);
+	fprintf(csv, "y_size,x_size,content,model,mutations,L,copy_all_threshold,copy_tail_threshold,send_threshold,roll,err,wall_s,cpu_s,"
+			"rec_by_ref,rec_by_raw,delta_ref_n,delta_raw_n,collisions_1st,collisions_2nd,prefilter_pass,prefilter_reject,peak_rss_kb\n");
+	fprintf(stderr, "%12s %9s %6s %6s %6s %6s %5s %3s %10s %10s %12s %12s %8s %8s %10s\n",
+			"y_size", "model", "L", "all", "tail", "send", "roll", "err", "wall [s]", "cpu [s]", "by ref", "by raw", "coll1", "coll2", "rss [kB]");
+
+	for (si = 0; si < sizes.n; ++si) {
+		for (m = 0; m < BENCH_MODELS_N; ++m) {
+			if (models[m] == 0)
+				continue;
+			y_sz = sizes.v[si];
+			bench_rand_seed(&rnd, seed ^ (y_sz * 31 + m));  /* same workload for same seed, size and model */
+			f = fopen(y, "wb");
+			if (f == NULL)
+				bench_die("can't open", y);
+			bench_write_random(f, &rnd, y_sz, y);
+			if (fclose(f) != 0)
+				bench_die("can't write", y);
+			x_sz = bench_mutate(m, y, x, y_sz, mutations, &rnd);
+
+			for (li = 0; li < Ls.n; ++li)
+			for (ai = 0; ai < alls.n; ++ai)
+			for (ti = 0; ti < tails.n; ++ti)
+			for (xi = 0; xi < sends.n; ++xi)
+			for (ri = 0; ri < rolls_n; ++ri) {
+				send_threshold = sends.v[xi] ? sends.v[xi] : Ls.v[li];
+				bench_run(x, y, z, Ls.v[li], alls.v[ai], tails.v[ti], send_threshold, rolls[ri], prefilter, &res, &wall_s);
+				cpu_s = res.ru.ru_utime.tv_sec + res.ru.ru_stime.tv_sec + (double) (res.ru.ru_utime.tv_usec + res.ru.ru_stime.tv_usec) / 1000000;
+				fprintf(csv, "%" PRIu64 ",%" PRIu64 ",%s,%s,%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%zu,%s,%d,%.6f,%.6f,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%zu,%ld\n",
+						y_sz, x_sz, bench_content_str[bench_content], bench_model_str[m], mutations, Ls.v[li], alls.v[ai], tails.v[ti], send_threshold,
+						rm_roll_str(rolls[ri]), res.err, wall_s, cpu_s,
+						res.rec_ctx.rec_by_ref, res.rec_ctx.rec_by_raw, res.rec_ctx.delta_ref_n, res.rec_ctx.delta_raw_n,
+						res.rec_ctx.collisions_1st_level, res.rec_ctx.collisions_2nd_level, res.rec_ctx.prefilter_pass_n, res.rec_ctx.prefilter_reject_n, res.ru.ru_maxrss);
+				fflush(csv);
+				fprintf(stderr, "%12" PRIu64 " %9s %6" PRIu64 " %6" PRIu64 " %6" PRIu64 " %6zu %5s %3d %10.4f %10.4f %12zu %12zu %8zu %8zu %10ld\n",
+						y_sz, bench_model_str[m], Ls.v[li], alls.v[ai], tails.v[ti], send_threshold, rm_roll_str(rolls[ri]), res.err, wall_s, cpu_s,
+						res.rec_ctx.rec_by_ref, res.rec_ctx.rec_by_raw, res.rec_ctx.collisions_1st_level, res.rec_ctx.collisions_2nd_level, res.ru.ru_maxrss);
+			}
+		}
+	}
+	unlink(x);
+	unlink(y);
+	fclose(csv);
+	fprintf(stderr, "\nresults written to [%s]\n", csv_path);
+	return EXIT_SUCCESS;
+
+usage:
+	bench_usage(argv[0]);
+	exit(EXIT_FAILURE);
+}
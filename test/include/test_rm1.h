@@ -29,6 +29,8 @@
 #define RM_TEST_L_MAX               1024UL
 #define RM_TEST_FNAMES_N            13U
 #define RM_TEST_1_2_BUF_SZ          10u
+#define RM_TEST_1_X_SZ              40000u  /* random bytes, rolled over */
+#define RM_TEST_1_ROLL_N            20000u  /* offsets rolled over */
 const char* rm_test_fnames[RM_TEST_FNAMES_N];
 size_t      rm_test_fsizes[RM_TEST_FNAMES_N];
 size_t      rm_test_L_blocks[RM_TEST_L_BLOCKS_SIZE];
@@ -46,6 +48,8 @@ struct test_rm_state
     struct rm_ch_ch *array; /* will be big enough to serve as storage
                                for checksums for each test file */
     struct test_rm_file f_2;
+    unsigned char   *x; /* random content */
+    size_t          x_sz;
 };
 
 struct test_rm_state	rm_state;	/* global tests state */
@@ -89,5 +93,16 @@ test_rm_fast_check_roll(void **state);
 void
 test_rm_rx_insert_nonoverlapping_ch_ch_array_1(void **state);
 
+/* @brief   Test polynomial rolling checksum: state rolled over @x
+ *          is same as state computed on window at each offset,
+ *          for windows of different size, also when tail shrinks. */
+void
+test_rm_roll_1(void **state);
+
+/* @brief   Test batched rolling of fast and polynomial checksum: states
+ *          are same as from rm_roll_roll called for each offset. */
+void
+test_rm_roll_batch_1(void **state);
+
 
 #endif	/* RSYNCME_TEST_RM1_H */
@@ -0,0 +1,114 @@
+/* @file        test_rm11.h
+ * @brief       Test suite #11.
+ * @details     Tests of delta integrity check, framed channel and literal codec.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_TEST_RM11_H
+#define RSYNCME_TEST_RM11_H
+
+
+#include "rm_defs.h"
+#include "rm.h"
+#include "rm_rx.h"
+#include "rm_error.h"
+#include "rm_tcp.h"
+#include "rm_codec.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+
+#define RM_TEST_11_DELETE_FILES     1	/* 0 no, 1 yes */
+#define RM_TEST_11_X_SZ             200777
+#define RM_TEST_11_L                512
+#define RM_TEST_11_F_X              "rm_f_x_ts11"
+#define RM_TEST_11_F_Y              "rm_f_y_ts11"
+#define RM_TEST_11_F_Z              "rm_f_z_ts11"
+#define RM_TEST_11_CODEC_L          4096
+
+struct test_rm_state
+{
+    struct rm_session   *s;
+    unsigned char       *x;         /* content of @x file */
+    unsigned char       *y;         /* content of @y file, @x with few edits and without tail */
+    size_t              x_sz, y_sz;
+};
+
+/* @brief   The setup function which is called before
+ *          all unit tests are executed.
+ * @details Handles all side-effects: allocates memory needed
+ *          by tests, makes IO system calls, cancels test suite
+ *          run if preconditions can't be met. */
+int
+test_rm_setup(void **state);
+
+/* @brief   The teardown function  called after all
+ *          tests have finished. */
+int
+test_rm_teardown(void **state);
+
+
+/* @brief   Test integrity check of reconstructed file: delta of @x against @y
+ *          applied to @y gives file which digest is same as digest of @x. */
+void
+test_rm_integrity_1(void **state);
+
+/* @brief   Test integrity check of reconstructed file: delta with corrupted
+ *          literal byte gives file which digest differs from digest of @x. */
+void
+test_rm_integrity_2(void **state);
+
+/* @brief   Test integrity check of reconstructed file: delta with reference
+ *          to wrong block gives file which digest differs from digest of @x. */
+void
+test_rm_integrity_3(void **state);
+
+/* @brief   Test framed channel: stream of delta channel made of buffered
+ *          and file bytes is carried in frames of valid length, received
+ *          intact when socket gives it in short reads and followed
+ *          by unframed message. */
+void
+test_rm_tcp_chan_1(void **state);
+
+/* @brief   Test framed channel: frame of other channel and frame
+ *          of zero length are reported as RM_ERR_MSG_PT_UNKNOWN. */
+void
+test_rm_tcp_chan_2(void **state);
+
+/* @brief   Test framed channel: range of file of RM_TCP_FRAME_SENDFILE_MIN
+ *          bytes or more is sent in own frames with sendfile after bytes
+ *          buffered before it, shorter range is copied into frame and peer
+ *          receives the stream intact. */
+void
+test_rm_tcp_chan_3(void **state);
+
+/* @brief   Test splice of framed literals: after header of each frame
+ *          exactly its payload is spliced from socket into file, digest
+ *          of payload is computed from tee'd pipe (file is write only)
+ *          and next frame is received intact. */
+void
+test_rm_tcp_chan_4(void **state);
+
+/* @brief   Test zlib codec: literal payloads compressed by transmitter
+ *          are decompressed by receiver to same bytes, compressed payload
+ *          is always smaller, short and incompressible payloads are sent
+ *          stored and compression resumes after back-off. */
+void
+test_rm_codec_1(void **state);
+
+/* @brief   Test reference-aware zlib codec: literals which are near-copies
+ *          of matched blocks of @y compress against them and decompress
+ *          to same bytes, incompressible payload is sent stored
+ *          and newly matched block ends back-off. */
+void
+test_rm_codec_2(void **state);
+
+
+#endif	/* RSYNCME_TEST_RM11_H */
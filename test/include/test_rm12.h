@@ -0,0 +1,91 @@
+/* @file        test_rm12.h
+ * @brief       Test suite #12.
+ * @details     Tests of workqueue and of session executor.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_TEST_RM12_H
+#define RSYNCME_TEST_RM12_H
+
+
+#include "rm_defs.h"
+#include "rm.h"
+#include "rm_error.h"
+#include "rm_wq.h"
+#include "rm_exec.h"
+#include "rm_tcp.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+
+#define RM_TEST_12_JOBS_N           16      /* jobs queued behind busy worker */
+#define RM_TEST_12_WAIT_MS          5000    /* max time to wait for workers */
+
+int RM_TEST_MOCK_SYSCONF;
+
+struct test_rm_state
+{
+    pthread_mutex_t     mutex;
+    pthread_cond_t      signal;     /* job started, job done or blocked jobs released */
+    size_t              order[RM_TEST_12_JOBS_N];   /* ids of jobs in order they were done */
+    size_t              order_n;
+    uint8_t             release;    /* blocking jobs may return */
+};
+
+/* @brief   The setup function which is called before
+ *          all unit tests are executed.
+ * @details Handles all side-effects: allocates memory needed
+ *          by tests, makes IO system calls, cancels test suite
+ *          run if preconditions can't be met. */
+int
+test_rm_setup(void **state);
+
+/* @brief   The teardown function  called after all
+ *          tests have finished. */
+int
+test_rm_teardown(void **state);
+
+long
+__real_sysconf(int name);
+
+long
+__wrap_sysconf(int name);
+
+
+/* @brief   Test stealing: worker which has finished its own work takes
+ *          works queued to busy worker, oldest first. */
+void
+test_rm_wq_1(void **state);
+
+/* @brief   Test idle wake-up: work queued to busy worker is done
+ *          by sleeping idle worker, which is woken for it. */
+void
+test_rm_wq_2(void **state);
+
+/* @brief   Test default number of workers: RM_WORKERS_PER_CPU per online
+ *          CPU, capped at RM_WORKERS_MAX, RM_WORKERS_N if number of CPUs
+ *          can't be determined. */
+void
+test_rm_wq_3(void **state);
+
+/* @brief   Test executor: task is stepped when its descriptor is ready,
+ *          re-armed for other events and for other descriptor it returns,
+ *          destroyed once done, task still waiting is aborted on stop. */
+void
+test_rm_exec_1(void **state);
+
+/* @brief   Test executor: task submitted after executor threads have
+ *          aborted their tasks is refused and caller still owns it. */
+void
+test_rm_exec_2(void **state);
+
+
+#endif	/* RSYNCME_TEST_RM12_H */
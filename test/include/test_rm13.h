@@ -0,0 +1,85 @@
+/* @file        test_rm13.h
+ * @brief       Test suite #13.
+ * @details     Tests of directory push: validation of paths in file list
+ *              and handling of requests and files rejected by receiver.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_TEST_RM13_H
+#define RSYNCME_TEST_RM13_H
+
+
+#include "rm_defs.h"
+#include "rm.h"
+#include "rm_error.h"
+#include "rm_tcp.h"
+#include "rm_tx.h"
+#include "rm_do_msg.h"
+#include "rm_serialize.h"
+#include "rm_core.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+
+#define RM_TEST_13_DELETE_FILES     1	/* 0 no, 1 yes */
+#define RM_TEST_13_X                "rm_d_x_ts13"   /* tree pushed to fake receiver */
+#define RM_TEST_13_FILES_N          3
+#define RM_TEST_13_L                512
+
+struct test_rm_fake_rx {
+    int                 listen_fd;
+    uint16_t            port;
+    enum rm_error       tree_err;   /* sent in ACK of MSG_PUSH_TREE */
+    enum rm_error       file_err;   /* sent in MSG_PUSH_ACK of nonempty file, empty files are accepted */
+    uint64_t            files_n;    /* as received in MSG_PUSH_TREE */
+    char                paths[RM_TEST_13_FILES_N][RM_FILE_LEN_MAX];     /* as received in MSG_PUSH_FILE */
+    uint64_t            bytes[RM_TEST_13_FILES_N];
+    uint8_t             paths_valid;
+    uint8_t             eof;        /* transmitter sent nothing after summary */
+    enum rm_error       err;        /* of fake receiver itself */
+};
+
+struct test_rm_state
+{
+    struct test_rm_fake_rx  rx;
+};
+
+/* @brief   The setup function which is called before
+ *          all unit tests are executed.
+ * @details Handles all side-effects: allocates memory needed
+ *          by tests, makes IO system calls, cancels test suite
+ *          run if preconditions can't be met. */
+int
+test_rm_setup(void **state);
+
+/* @brief   The teardown function  called after all
+ *          tests have finished. */
+int
+test_rm_teardown(void **state);
+
+
+/* @brief   Test validation of paths in file list: relative paths are accepted,
+ *          absolute, empty, with "..", "." or empty components are not. */
+void
+test_rm_tree_path_1(void **state);
+
+/* @brief   Test reject of directory push request: error in ACK of MSG_PUSH_TREE
+ *          is returned to caller, nothing else is sent. */
+void
+test_rm_tree_ack_1(void **state);
+
+/* @brief   Test reject of files: files rejected in their MSG_PUSH_ACK are skipped,
+ *          empty file accepted needs no deltas, counts from MSG_PUSH_TREE_ACK
+ *          are returned with RM_ERR_TREE_PARTIAL. */
+void
+test_rm_tree_ack_2(void **state);
+
+
+#endif	/* RSYNCME_TEST_RM13_H */
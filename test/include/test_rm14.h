@@ -0,0 +1,81 @@
+/* @file        test_rm14.h
+ * @brief       Test suite #14.
+ * @details     Black box testing of daemon's metrics socket (using built
+ *              daemon and commandline utility).
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_TEST_RM14_H
+#define RSYNCME_TEST_RM14_H
+
+
+#include "rm_defs.h"
+#include "rm.h"
+#include "rm_error.h"
+#include "rm_tcp.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+
+#define RM_TEST_14_DELETE_FILES     1	/* 0 no, 1 yes */
+#define RM_TEST_14_SOCK             "rm_ts14.sock"
+#define RM_TEST_14_F_X              "rm_f_x_ts14"
+#define RM_TEST_14_F_Y              "rm_f_y_ts14"
+#define RM_TEST_14_F_Z              "rm_f_z_ts14"
+#define RM_TEST_14_X_SZ             100000
+#define RM_TEST_14_REPLY_MAX        65536   /* daemon sends reply at once, so it must fit into socket's buffer anyway */
+#define RM_TEST_14_WAIT_MS          5000    /* for daemon to start listening and for session to end */
+#define RM_TEST_14_CMD_LEN_MAX      (4 * PATH_MAX)
+
+struct test_rm_state
+{
+    pid_t   daemon_pid;
+    char    dir[PATH_MAX];              /* daemon changes its working directory, so it is given absolute paths */
+    char    sock[sizeof(((struct sockaddr_un*) 0)->sun_path)];
+};
+
+/* @brief   The setup function which is called before
+ *          all unit tests are executed.
+ * @details Handles all side-effects: allocates memory needed
+ *          by tests, makes IO system calls, cancels test suite
+ *          run if preconditions can't be met. Starts daemon
+ *          serving metrics on RM_TEST_14_SOCK and waits until
+ *          it accepts connections. */
+int
+test_rm_setup(void **state);
+
+/* @brief   The teardown function  called after all
+ *          tests have finished. Stops the daemon. */
+int
+test_rm_teardown(void **state);
+
+
+/* @brief   Test text metrics are in Prometheus exposition format: each
+ *          sample is on own line as "name{labels} value" and is preceded
+ *          by "# TYPE" line of its family, there are counters of sessions,
+ *          of workers and of executor threads. */
+void
+test_rm_metrics_1(void **state);
+
+/* @brief   Test request for JSON gives single JSON object, empty request
+ *          (just EOF) gives text. */
+void
+test_rm_metrics_2(void **state);
+
+/* @brief   Test counters of daemon after push of @x against same @y:
+ *          sessions_ended_n increments and all bytes are reconstructed
+ *          by reference. */
+void
+test_rm_metrics_3(void **state);
+
+
+#endif	/* RSYNCME_TEST_RM14_H */
@@ -0,0 +1,119 @@
+/* @file        test_rm15.h
+ * @brief       Test suite #15.
+ * @details     Tests of write-combining output of result file.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#ifndef RSYNCME_TEST_RM15_H
+#define RSYNCME_TEST_RM15_H
+
+
+#include "rm_defs.h"
+#include "rm.h"
+#include "rm_error.h"
+#include "rm_tcp.h"
+#include "rm_zout.h"
+
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+
+#define RM_TEST_15_DELETE_FILES     1	/* 0 no, 1 yes */
+#define RM_TEST_15_X_SZ             (2 * RM_ZOUT_BUF_LEN + 5000)    /* two full chunks and unaligned tail */
+#define RM_TEST_15_F_X              "rm_f_x_ts15"
+#define RM_TEST_15_F_Z              "rm_f_z_ts15"
+#define RM_TEST_15_WRITES_MAX       64
+
+/* What wrapped pwrite does. */
+enum test_rm_pwrite_mock {
+    RM_TEST_PWRITE_REAL,            /* write */
+    RM_TEST_PWRITE_EINVAL_DIRECT,   /* fail with EINVAL while O_DIRECT is on */
+    RM_TEST_PWRITE_SHORT_ONCE,      /* write only RM_ZOUT_ALIGN bytes in first call */
+    RM_TEST_PWRITE_EIO              /* fail with EIO */
+};
+
+/* Call of pwrite on @z, as seen by wrap. */
+struct test_rm_pwrite {
+    uint64_t    offset;
+    size_t      bytes_n;
+    uint8_t     direct;             /* O_DIRECT was on */
+    ssize_t     ret;
+};
+
+struct test_rm_state
+{
+    unsigned char           *x;     /* random content, also in RM_TEST_15_F_X */
+    int                     fd_x;
+    struct rm_zout          *z;     /* output under test, pwrite wrap reads its O_DIRECT flag */
+    struct test_rm_pwrite   writes[RM_TEST_15_WRITES_MAX];
+    size_t                  writes_n;
+};
+
+/* @brief   The setup function which is called before
+ *          all unit tests are executed.
+ * @details Handles all side-effects: allocates memory needed
+ *          by tests, makes IO system calls, cancels test suite
+ *          run if preconditions can't be met. */
+int
+test_rm_setup(void **state);
+
+/* @brief   The teardown function  called after all
+ *          tests have finished. */
+int
+test_rm_teardown(void **state);
+
+ssize_t
+__real_pwrite(int fd, const void *buf, size_t count, off_t offset);
+ssize_t
+__real_pwrite64(int fd, const void *buf, size_t count, off64_t offset);
+int
+__real_fallocate(int fd, int mode, off_t offset, off_t len);
+int
+__real_fallocate64(int fd, int mode, off64_t offset, off64_t len);
+ssize_t
+__wrap_pwrite(int fd, const void *buf, size_t count, off_t offset);
+ssize_t
+__wrap_pwrite64(int fd, const void *buf, size_t count, off64_t offset);
+int
+__wrap_fallocate(int fd, int mode, off_t offset, off_t len);
+int
+__wrap_fallocate64(int fd, int mode, off64_t offset, off64_t len);
+
+
+/* @brief   Test bytes written at non-contiguous offsets (gaps, jumps back
+ *          and forward, runs longer than buffer) and copied from other file:
+ *          each run is flushed by own pwrite, none longer than RM_ZOUT_BUF_LEN,
+ *          and file holds same bytes as were written. */
+void
+test_rm_zout_1(void **state);
+
+/* @brief   Test O_DIRECT: full chunks are written with O_DIRECT, unaligned
+ *          tail of file is written buffered and file is same as written bytes. */
+void
+test_rm_zout_2(void **state);
+
+/* @brief   Test O_DIRECT write refused with EINVAL: same chunk is written
+ *          again buffered, O_DIRECT stays off and file is same as written bytes. */
+void
+test_rm_zout_3(void **state);
+
+/* @brief   Test short O_DIRECT write: rest of chunk is written buffered
+ *          from where short write ended and file is same as written bytes,
+ *          failed write is reported as RM_ERR_WRITE. */
+void
+test_rm_zout_4(void **state);
+
+/* @brief   Test preallocation: ENOSPC from fallocate(FALLOC_FL_KEEP_SIZE)
+ *          fails init with RM_ERR_WRITE, other errors are ignored, size
+ *          of file is only what is written. */
+void
+test_rm_zout_5(void **state);
+
+
+#endif	/* RSYNCME_TEST_RM15_H */
@@ -1,7 +1,8 @@
 /*
  * @file        test_rm2.h
  * @brief       Test suite #2.
- * @details     Test of nonoverlapping checksums error reporting.
+ * @details     Test of nonoverlapping checksums error reporting
+ *              and of checksums spilled to disk.
  * @author      Piotr Gregor piotrek.gregor at gmail.com
  * @version     0.1.2
  * @date        24 Jan 2016 06:19 PM
@@ -17,6 +18,8 @@
 #include "rm.h"
 #include "rm_rx.h"
 #include "rm_error.h"
+#include "rm_tx.h"
+#include "rm_spill.h"
 
 
 #include <stdarg.h>
@@ -29,6 +32,14 @@
 #define RM_TEST_L_BLOCKS_SIZE       26
 #define RM_TEST_L_MAX               1024UL
 #define RM_TEST_FNAMES_N            13
+#define RM_TEST_2_SPILL_N           100000  /* checksums, make few sorted runs with minimal memory */
+#define RM_TEST_2_SPILL_F_CH_N      40000   /* distinct fast checksums, even only */
+#define RM_TEST_2_SPILL_L           32      /* local push: small blocks, so hashtable of them takes more than RM_SPILL_MEM_MIN */
+#define RM_TEST_2_SPILL_BLOCKS_N    80000   /* of @y, few sorted runs in RM_SPILL_MEM_MIN */
+#define RM_TEST_2_SPILL_INS         20000   /* random bytes inserted into @x */
+#define RM_TEST_2_SPILL_F_X         "rm_f_x_ts2_spill"
+#define RM_TEST_2_SPILL_F_Y         "rm_f_y_ts2_spill"
+#define RM_TEST_2_SPILL_F_Z         "rm_f_z_ts2_spill"
 const char* rm_test_fnames[RM_TEST_FNAMES_N];
 size_t      rm_test_fsizes[RM_TEST_FNAMES_N];
 size_t      rm_test_L_blocks[RM_TEST_L_BLOCKS_SIZE];
@@ -113,5 +124,19 @@ test_rm_rx_insert_nonoverlapping_ch_ch_ref_5(void **state);
 void
 test_rm_rx_insert_nonoverlapping_ch_ch_ref_6(void **state);
 
+/* @brief   Test spill of checksums: for each fast checksum present or not
+ *          (also those rejected by Bloom filter) rm_spill_find returns same
+ *          candidates as in-memory hashtable, one per strong checksum. */
+void
+test_rm_spill_1(void **state);
+
+/* @brief   Test local push with memory limit below size of checksums
+ *          hashtable: checksums of @y are spilled to disk in few sorted runs,
+ *          Bloom filter rejects most of fast checksums rolled over inserted
+ *          bytes, pages of sorted file are read for those it lets through
+ *          and delta is same as with checksums in memory. */
+void
+test_rm_spill_2(void **state);
+
 
 #endif	// RSYNCME_TEST_RM2_H
@@ -1,7 +1,8 @@
 /*
  * @file        test_rm3.h
  * @brief       Test suite #3.
- * @details     Test of ref_link nonoverlapping checksums calculation correctness.
+ * @details     Test of ref_link nonoverlapping checksums calculation correctness
+ *              and of checksum kernels.
  * @author      Piotr Gregor <piotrek.gregor at gmail.com>
  * @version     0.1.2
  * @date        6 Mar 2016 11:29 PM
@@ -29,6 +30,8 @@
 #define RM_TEST_L_BLOCKS_SIZE       26
 #define RM_TEST_L_MAX               1024UL
 #define RM_TEST_FNAMES_N            13
+#define RM_TEST_3_X_SZ              20000u  /* random bytes checksummed */
+#define RM_TEST_3_MD5_N             20      /* blocks hashed at once, at most */
 const char* rm_test_fnames[RM_TEST_FNAMES_N];
 size_t    rm_test_fsizes[RM_TEST_FNAMES_N];
 size_t    rm_test_L_blocks[RM_TEST_L_BLOCKS_SIZE];
@@ -37,6 +40,8 @@ struct test_rm_state
 {
 	size_t      *l;
 	void        *buf;
+	unsigned char *x;   /* random content */
+	size_t      x_sz;
 };
 
 struct test_rm_state	rm_state;	/* global tests state */
@@ -68,5 +73,18 @@ test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_1(void **state);
 void
 test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_2(void **state);
 
+/* @brief   Test CRC32C: check value of "123456789" is 0xE3069283 on both
+ *          SSE4.2 (if CPU has it) and table driven path, checksum continued
+ *          over split data is same and both paths agree on random data. */
+void
+test_rm_crc32c_1(void **state);
+
+/* @brief   Test MD5 of blocks hashed in parallel lanes: digests are same
+ *          as from rm_md5 for ragged block lengths (0 and around padding
+ *          boundaries too) and for numbers of blocks which are not
+ *          multiples of RM_MD5_LANES. */
+void
+test_rm_md5_lanes_1(void **state);
+
 
 #endif	// RSYNCME_TEST_RM3_H
@@ -73,5 +73,12 @@ test_rm_rx_insert_nonoverlapping_ch_ch_ref_2(void **state);
 void
 test_rm_rx_insert_nonoverlapping_ch_ch_ref_3(void **state);
 
+/* @brief   Test of hashtable sizing: number of buckets is smallest power of 2
+ *          giving load of at most RM_NONOVERLAPPING_HASH_LOAD, for small,
+ *          medium and huge number of blocks, clamped to
+ *          [RM_NONOVERLAPPING_HASH_BITS_MIN, RM_NONOVERLAPPING_HASH_BITS_MAX]. */
+void
+test_rm_rx_ch_ch_hash_bits_1(void **state);
+
 
 #endif	/* RSYNCME_TEST_RM4_H */
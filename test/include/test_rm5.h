@@ -32,6 +32,9 @@
 #define RM_TEST_5_9_FILE_IDX        3
 #define RM_TEST_5_FILE_X_SZ         200
 #define RM_TEST_5_FILE_Y_SZ         300
+#define RM_TEST_5_22_RAW_N          1000    /* literal bytes in each delta element */
+#define RM_TEST_5_22_E_N            50      /* delta elements produced */
+#define RM_TEST_5_22_E_IN_QUEUE     2       /* delta elements that fit in queue */
 
 const char* rm_test_fnames[RM_TEST_FNAMES_N];
 size_t    rm_test_fsizes[RM_TEST_FNAMES_N];
@@ -181,5 +184,13 @@ test_rm_rolling_ch_proc_20(void **state);
 void
 test_rm_rolling_ch_proc_21(void **state);
 
+/* @brief   Test limit of delta queue: rolling proc callback waits while
+ *          queue would exceed tx_delta_e_queue_limit bytes (slow consumer),
+ *          each wait is counted in stall counters, queue never holds more
+ *          than the limit and closing the queue wakes up blocked producer,
+ *          which then fails with RM_ERR_QUEUE_CLOSED. */
+void
+test_rm_rolling_ch_proc_22(void **state);
+
 
 #endif	/* RSYNCME_TEST_RM5_H */
@@ -30,6 +30,12 @@
 #define RM_TEST_FNAMES_N            15
 #define RM_TEST_8_FILE_X_SZ         200
 #define RM_TEST_8_FILE_Y_SZ         300
+#define RM_TEST_8_NEXT_L            512
+#define RM_TEST_8_NEXT_BLOCKS_N     64
+#define RM_TEST_8_NEXT_K            20      /* block of @x with same fast but different strong checksum */
+#define RM_TEST_8_NEXT_F_X          "rm_f_x_ts8_next"
+#define RM_TEST_8_NEXT_F_Y          "rm_f_y_ts8_next"
+#define RM_TEST_8_NEXT_F_Z          "rm_f_z_ts8_next"
 
 const char* rm_test_fnames[RM_TEST_FNAMES_N];
 size_t    rm_test_fsizes[RM_TEST_FNAMES_N];
@@ -137,5 +143,13 @@ test_rm_tx_local_push_13(void **state);
 void
 test_rm_tx_local_push_14(void **state);
 
+/* @brief   Test verification of block following last match before hashtable lookup.
+ * @details Each block of @x matching block of @y after previous one is tried
+ *          and matched without lookup, block which has fast checksum same
+ *          as the block expected but different strong checksum is tried
+ *          and not matched, then matching resumes through hashtable. */
+void
+test_rm_tx_local_push_15(void **state);
+
 
 #endif	/* RSYNCME_TEST_RM8_H */
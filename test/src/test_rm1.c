@@ -96,6 +96,16 @@ test_rm_setup(void **state) {
     fclose(rm_state.f_2.f);
     rm_state.f_2.f = NULL;
 
+    rm_state.x_sz = RM_TEST_1_X_SZ;
+    rm_state.x = malloc(rm_state.x_sz);
+    if (rm_state.x == NULL) {
+        RM_LOG_ERR("Can't allocate memory for random buffer of [%zu] bytes, malloc failed", rm_state.x_sz);
+    }
+    assert_true(rm_state.x != NULL);
+    for (i = 0; i < rm_state.x_sz; ++i) {
+        rm_state.x[i] = rand();
+    }
+
     return 0;
 }
 
@@ -125,6 +135,7 @@ test_rm_teardown(void **state) {
         free(rm_state->array);
     }
     remove(rm_state->f_2.name);
+    free(rm_state->x);
     return 0;
 }
 
@@ -773,3 +784,66 @@ test_rm_rx_insert_nonoverlapping_ch_ch_array_1(void **state) {
     RM_LOG_INFO("%s", "PASSED test #8 (non-overlapping blocks)");
 }
 
+void
+test_rm_roll_1(void **state) {
+    struct test_rm_state    *rm_state;
+    struct rm_roll          r;
+    uint64_t                h;
+    size_t                  i, k, L, len;
+    const size_t            L_blocks[7] = { 1, 2, 7, 64, 511, 512, 4096 };
+    const unsigned char     *data;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    data = rm_state->x;
+    for (i = 0; i < 7; ++i) {
+        L = L_blocks[i];
+        rm_roll_init(&r, RM_ROLL_POLY, rand(), L);
+        h = rm_roll_block(&r, data, L);
+        for (k = 0; k < RM_TEST_1_ROLL_N; ++k) {
+            h = rm_roll_roll(&r, h, data[k], data[k + L]);
+            assert_true(h == rm_roll_block(&r, data + k + 1, L));
+            assert_int_equal(rm_roll_f_ch(&r, h), rm_roll_f_ch(&r, rm_roll_block(&r, data + k + 1, L)));
+        }
+        for (k = RM_TEST_1_ROLL_N + 1, len = L; len > 1; ++k, --len) {    /* window at the end of file shrinks */
+            h = rm_roll_roll_tail(&r, h, data[k - 1], len);
+            assert_true(h == rm_roll_block(&r, data + k, len - 1));
+        }
+    }
+    RM_LOG_INFO("%s", "PASSED test #9 (polynomial rolling checksum)");
+}
+
+void
+test_rm_roll_batch_1(void **state) {
+    struct test_rm_state    *rm_state;
+    struct rm_roll          r;
+    uint64_t                h, exp, res[100];
+    size_t                  t, i, j, k, off, L;
+    const uint8_t           types[2] = { RM_ROLL_FAST, RM_ROLL_POLY };
+    const size_t            L_blocks[4] = { 1, 16, 511, 4096 };
+    const size_t            batch_n[7] = { 0, 1, 15, 16, 17, RM_ROLL_BATCH, 100 };
+    const unsigned char     *data;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    for (t = 0; t < 2; ++t) {
+        for (i = 0; i < 4; ++i) {
+            L = L_blocks[i];
+            rm_roll_init(&r, types[t], rand(), L);
+            for (j = 0; j < 7; ++j) {
+                for (off = 0; off < 3; ++off) {     /* unaligned too */
+                    data = rm_state->x + 1000 * j + off;
+                    h = rm_roll_block(&r, data, L);
+                    memset(res, 0, sizeof(res));
+                    rm_roll_batch(&r, h, data, batch_n[j], res);
+                    exp = h;
+                    for (k = 0; k < batch_n[j]; ++k) {
+                        exp = rm_roll_roll(&r, exp, data[k], data[k + L]);
+                        assert_true(res[k] == exp);
+                    }
+                }
+            }
+        }
+    }
+    RM_LOG_INFO("%s", "PASSED test #10 (batched rolling checksum)");
+}
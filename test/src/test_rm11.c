@@ -0,0 +1,640 @@
+/* @file        test_rm11.c
+ * @brief       Test suite #11.
+ * @details     Tests of delta integrity check, framed channel and literal codec.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "test_rm11.h"
+
+
+enum rm_loglevel RM_LOGLEVEL = RM_LOGLEVEL_NORMAL;
+
+struct test_rm_state	rm_state;	/* global tests state */
+
+static int
+test_rm_write_file(const char *name, const unsigned char *buf, size_t n) {
+    FILE    *f;
+
+    f = fopen(name, "wb");
+    if (f == NULL) {
+        RM_LOG_CRIT("Can't create file [%s]!", name);
+        return -1;
+    }
+    if (n > 0 && fwrite(buf, n, 1, f) != 1) {
+        RM_LOG_CRIT("Can't write [%zu] bytes to file [%s]!", n, name);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+int test_rm_setup(void **state)
+{
+    int         err = -1;
+    size_t      i = 0;
+    unsigned long const seed = time(NULL);
+	struct rm_core_options opt = { .loglevel = RM_LOGLEVEL_NORMAL };
+
+#ifdef DEBUG
+    err = rm_util_chdir_umask_openlog("../build/debug", 1, "rsyncme_test_11", 1);
+#else
+    err = rm_util_chdir_umask_openlog("../build/release", 1, "rsyncme_test_11", 1);
+#endif
+    if (err != RM_ERR_OK) {
+        exit(EXIT_FAILURE);
+    }
+    *state = &rm_state;
+
+    srand(seed);
+    rm_state.x_sz = RM_TEST_11_X_SZ;
+    rm_state.y_sz = RM_TEST_11_X_SZ - 777;  /* @x has tail not found in @y */
+    rm_state.x = malloc(rm_state.x_sz);
+    rm_state.y = malloc(rm_state.y_sz);
+    if (rm_state.x == NULL || rm_state.y == NULL) {
+        RM_LOG_CRIT("%s", "Can't allocate memory for file buffers!");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < rm_state.x_sz; ++i) {
+        rm_state.x[i] = rand();
+    }
+    memcpy(rm_state.y, rm_state.x, rm_state.y_sz);
+    for (i = 0; i < 100; ++i) {             /* few edits, so delta has literals in the middle too */
+        rm_state.y[1000 + i] ^= 0x5a;
+        rm_state.y[50000 + i] ^= 0x5a;
+        rm_state.y[150001 + i] ^= 0x5a;
+    }
+    if (test_rm_write_file(RM_TEST_11_F_X, rm_state.x, rm_state.x_sz) != 0
+            || test_rm_write_file(RM_TEST_11_F_Y, rm_state.y, rm_state.y_sz) != 0) {
+        exit(EXIT_FAILURE);
+    }
+
+    rm_state.s = rm_session_create(RM_PUSH_LOCAL, &opt);
+    if (rm_state.s == NULL) {
+        RM_LOG_ERR("%s", "Can't allocate session local push");
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+int test_rm_teardown(void **state)
+{
+    struct  test_rm_state *rm_state;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    if (RM_TEST_11_DELETE_FILES == 1) { /* delete all test files */
+        RM_LOG_INFO("Removing files [%s] [%s]", RM_TEST_11_F_X, RM_TEST_11_F_Y);
+        if (remove(RM_TEST_11_F_X) != 0 || remove(RM_TEST_11_F_Y) != 0) {
+            assert_true(1 == 0 && "Can't remove!");
+        }
+    }
+    free(rm_state->x);
+    free(rm_state->y);
+    rm_session_free(rm_state->s);
+    return 0;
+}
+
+/* Delta of @x against @y is made by rolling proc, (optionally) corrupted
+ * and applied to @y, digest of the result is compared to digest of @x
+ * the way receiver does it. Returns 1 if digests match. */
+static int
+test_rm_integrity(struct test_rm_state *rm_state, int corrupt) {
+    int                     err;
+    FILE                    *f_x, *f_y, *f_z;
+    size_t                  L = RM_TEST_11_L, blocks_n_exp, blocks_n;
+    struct rm_session       *s;
+    struct rm_session_push_local    *prvt;
+    struct rm_rx_delta_element_arg  arg;
+    struct rm_delta_reconstruct_ctx rec_ctx;
+    MD5_CTX                 z_md5;
+    unsigned char           z_digest[RM_STRONG_CHECK_BYTES];
+    int                     corrupted = 0;
+
+    /* hashtable deletion */
+    unsigned int            bkt;
+    struct twhlist_node     *tmp;
+    const struct rm_ch_ch_ref_hlink *e;
+
+    /* delta queue */
+    const twfifo_queue      *q;
+    struct rm_delta_e       *delta_e;
+    struct twlist_head      *lh;
+
+    TWDEFINE_HASHTABLE(h, RM_NONOVERLAPPING_HASH_BITS);
+    twhash_init(h);
+
+    f_x = fopen(RM_TEST_11_F_X, "rb");
+    f_y = fopen(RM_TEST_11_F_Y, "rb");
+    f_z = tmpfile();
+    assert_true(f_x != NULL && f_y != NULL && f_z != NULL);
+
+    blocks_n_exp = rm_state->y_sz / L + (rm_state->y_sz % L ? 1 : 0);
+    err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, RM_TEST_11_F_Y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
+    assert_int_equal(err, RM_ERR_OK);
+    assert_int_equal(blocks_n_exp, blocks_n);
+
+    s = rm_state->s;
+    memset(&s->rec_ctx, 0, sizeof(struct rm_delta_reconstruct_ctx));
+    s->rec_ctx.L = L;
+    s->rec_ctx.copy_all_threshold = 0;
+    s->rec_ctx.copy_tail_threshold = 0;
+    s->rec_ctx.send_threshold = L;
+    prvt = s->prvt;
+    prvt->h = h;
+    s->f_x = f_x;
+    prvt->delta_tx_f = rm_roll_proc_cb_1;
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);
+    assert_int_equal(err, RM_ERR_OK);
+
+    memset(&rec_ctx, 0, sizeof(rec_ctx));   /* receiver side */
+    rec_ctx.L = L;
+    md5_init(&z_md5);
+    memset(&arg, 0, sizeof(arg));
+    arg.f_y = f_y;
+    arg.f_z = f_z;
+    arg.rec_ctx = &rec_ctx;
+    arg.z_md5 = &z_md5;
+    q = &prvt->tx_delta_e_queue;
+    for (twfifo_dequeue(q, lh); lh != NULL; twfifo_dequeue(q, lh)) {
+        delta_e = tw_container_of(lh, struct rm_delta_e, link);
+        if (corrupted == 0) {
+            if (corrupt == 1 && delta_e->type == RM_DELTA_ELEMENT_RAW_BYTES && delta_e->raw_bytes_n > 0) {
+                delta_e->raw_bytes[0] ^= 0x01;
+                corrupted = 1;
+            } else if (corrupt == 2 && delta_e->type == RM_DELTA_ELEMENT_REFERENCE) {
+                delta_e->ref = (delta_e->ref + 1) % (rm_state->y_sz / L);   /* other full block of @y */
+                corrupted = 1;
+            }
+        }
+        arg.delta_e = delta_e;
+        err = rm_rx_process_delta_element(&arg);
+        assert_int_equal(err, RM_ERR_OK);
+        if (delta_e->raw_bytes != NULL) {
+            free(delta_e->raw_bytes);
+        }
+        free(delta_e);
+    }
+    assert_int_equal(corrupted, corrupt != 0);
+    assert_int_equal(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw, rm_state->x_sz);
+    md5_final(&z_md5, z_digest);
+
+    twhash_for_each_safe(h, bkt, tmp, e, hlink) {
+        twhash_del((struct twhlist_node*)&e->hlink);
+        free((struct rm_ch_ch_ref_hlink*)e);
+    }
+    fclose(f_x);
+    fclose(f_y);
+    fclose(f_z);
+    return memcmp(z_digest, s->rec_ctx.x_digest.data, RM_STRONG_CHECK_BYTES) == 0;
+}
+
+void
+test_rm_integrity_1(void **state) {
+    assert_int_equal(test_rm_integrity(*state, 0), 1);
+    RM_LOG_INFO("%s", "PASSED test #1 (digest of reconstructed file matches digest of @x)");
+}
+
+void
+test_rm_integrity_2(void **state) {
+    assert_int_equal(test_rm_integrity(*state, 1), 0);
+    RM_LOG_INFO("%s", "PASSED test #2 (corrupted literal fails integrity check)");
+}
+
+void
+test_rm_integrity_3(void **state) {
+    assert_int_equal(test_rm_integrity(*state, 2), 0);
+    RM_LOG_INFO("%s", "PASSED test #3 (reference to wrong block fails integrity check)");
+}
+
+struct test_rm_relay {
+    int                 fd;     /* write end of socket */
+    const unsigned char *buf;
+    size_t              n;
+};
+
+/* Writes wire bytes to socket in chunks of 1 to 13 bytes,
+ * so reader sees frame headers and payloads split anywhere. */
+static void *
+test_rm_relay_f(void *arg) {
+    struct test_rm_relay    *r = arg;
+    size_t                  pos = 0, n = 0, chunk = 0;
+
+    while (pos < r->n) {
+        n = rm_min(r->n - pos, chunk % 13 + 1);
+        if (rm_tcp_tx(r->fd, (void*) (r->buf + pos), n) != RM_ERR_OK) {
+            break;
+        }
+        pos += n;
+        ++chunk;
+    }
+    shutdown(r->fd, SHUT_WR);
+    return NULL;
+}
+
+void
+test_rm_tcp_chan_1(void **state) {
+    struct test_rm_state    *rm_state;
+    struct rm_tcp_chan      c;
+    struct test_rm_relay    relay;
+    pthread_t               tid;
+    FILE                    *f_wire;
+    int                     fd_x, sp[2];
+    unsigned char           *wire, *dst, *p;
+    size_t                  wire_n, pos, payload_n, frames_n, i, n, len;
+    char                    end[4] = "END", end_rx[4] = { 0 };
+    const size_t            rx_n[5] = { 1, 3, 4093, 65536, 17 };
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    f_wire = tmpfile();             /* TX writes wire bytes here */
+    fd_x = open(RM_TEST_11_F_X, O_RDONLY);
+    assert_true(f_wire != NULL && fd_x != -1);
+
+    assert_int_equal(rm_tcp_chan_init(&c, fileno(f_wire), RM_TCP_CHAN_DELTA, 1), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x, 1), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x + 1, 99), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x + 100, 70000), RM_ERR_OK);     /* spans frames */
+    assert_int_equal(rm_tcp_chan_tx_file(&c, fd_x, 70100, 20000), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x + 90100, rm_state->x_sz - 90100), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_flush(&c), RM_ERR_OK);
+    assert_int_equal(rm_tcp_tx(fileno(f_wire), end, sizeof(end)), RM_ERR_OK);      /* unframed message follows stream */
+    rm_tcp_chan_free(&c);
+    close(fd_x);
+
+    wire_n = ftello(f_wire);
+    wire = malloc(wire_n);
+    assert_true(wire != NULL);
+    assert_int_equal(pread(fileno(f_wire), wire, wire_n, 0), wire_n);
+    fclose(f_wire);
+
+    pos = payload_n = frames_n = 0; /* frames of valid length carry exactly the stream */
+    while (pos < wire_n - sizeof(end)) {
+        assert_true(pos + RM_TCP_FRAME_HDR_LEN <= wire_n - sizeof(end));
+        assert_int_equal(wire[pos], RM_TCP_CHAN_DELTA);
+        len = (wire[pos + 2] << 8) | wire[pos + 3];
+        assert_true(len > 0 && len <= RM_TCP_FRAME_LEN_MAX);
+        assert_memory_equal(wire + pos + RM_TCP_FRAME_HDR_LEN, rm_state->x + payload_n, len);
+        pos += RM_TCP_FRAME_HDR_LEN + len;
+        payload_n += len;
+        ++frames_n;
+    }
+    assert_int_equal(pos, wire_n - sizeof(end));
+    assert_int_equal(payload_n, rm_state->x_sz);
+    assert_true(frames_n >= rm_state->x_sz / RM_TCP_FRAME_LEN_MAX + 1);
+
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sp), 0);
+    relay.fd = sp[0];
+    relay.buf = wire;
+    relay.n = wire_n;
+    assert_int_equal(pthread_create(&tid, NULL, test_rm_relay_f, &relay), 0);
+    dst = malloc(rm_state->x_sz);
+    assert_true(dst != NULL);
+    assert_int_equal(rm_tcp_chan_init(&c, sp[1], RM_TCP_CHAN_DELTA, 1), RM_ERR_OK);
+    for (p = dst, i = 0; p < dst + rm_state->x_sz; p += n, ++i) {
+        n = rm_min(rx_n[i % 5], (size_t) (dst + rm_state->x_sz - p));
+        assert_int_equal(rm_tcp_chan_rx(&c, p, n), RM_ERR_OK);
+    }
+    assert_memory_equal(dst, rm_state->x, rm_state->x_sz);
+    assert_int_equal(rm_tcp_rx(sp[1], end_rx, sizeof(end_rx)), RM_ERR_OK);        /* stream ended on frame boundary */
+    assert_memory_equal(end_rx, end, sizeof(end));
+    rm_tcp_chan_free(&c);
+    pthread_join(tid, NULL);
+    close(sp[0]);
+    close(sp[1]);
+    free(dst);
+    free(wire);
+    RM_LOG_INFO("PASSED test #4 (framed channel), [%zu] bytes in [%zu] frames", payload_n, frames_n);
+}
+
+void
+test_rm_tcp_chan_2(void **state) {
+    struct rm_tcp_chan      c;
+    int                     sp[2];
+    unsigned char           buf[8];
+    unsigned char           frame_ch_ch[5] = { RM_TCP_CHAN_CH_CH, 0, 0, 1, 0xab };
+    unsigned char           frame_empty[4] = { RM_TCP_CHAN_DELTA, 0, 0, 0 };
+
+    (void) state;
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sp), 0);
+    assert_int_equal(rm_tcp_chan_init(&c, sp[1], RM_TCP_CHAN_DELTA, 1), RM_ERR_OK);
+    assert_int_equal(rm_tcp_tx(sp[0], frame_ch_ch, sizeof(frame_ch_ch)), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_rx(&c, buf, 1), RM_ERR_MSG_PT_UNKNOWN);
+    assert_int_equal(rm_tcp_rx(sp[1], buf, 1), RM_ERR_OK);                          /* payload of foreign frame */
+    assert_int_equal(rm_tcp_tx(sp[0], frame_empty, sizeof(frame_empty)), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_rx(&c, buf, 1), RM_ERR_MSG_PT_UNKNOWN);
+    rm_tcp_chan_free(&c);
+    close(sp[0]);
+    close(sp[1]);
+    RM_LOG_INFO("%s", "PASSED test #5 (framed channel, foreign and empty frames)");
+}
+
+struct test_rm_chan_reader {
+    int                 fd;
+    unsigned char       *dst;
+    size_t              n;
+    enum rm_error       err;
+    char                end[4];     /* unframed message following stream */
+};
+
+static void *
+test_rm_chan_reader_f(void *arg) {
+    struct test_rm_chan_reader  *r = arg;
+    struct rm_tcp_chan          c;
+
+    r->err = rm_tcp_chan_init(&c, r->fd, RM_TCP_CHAN_DELTA, 1);
+    if (r->err == RM_ERR_OK) {
+        r->err = rm_tcp_chan_rx(&c, r->dst, r->n);
+    }
+    if (r->err == RM_ERR_OK) {
+        r->err = rm_tcp_rx(r->fd, r->end, sizeof(r->end));
+    }
+    rm_tcp_chan_free(&c);
+    return NULL;
+}
+
+void
+test_rm_tcp_chan_3(void **state) {
+    struct test_rm_state        *rm_state;
+    struct rm_tcp_chan          c;
+    struct test_rm_chan_reader  reader;
+    pthread_t                   tid;
+    int                         fd_x, sp[2];
+    char                        end[4] = "END";
+    const size_t                big_n = 2 * RM_TCP_FRAME_LEN_MAX + 17, small_n = RM_TCP_FRAME_SENDFILE_MIN - 1;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_true(100 + big_n + small_n < rm_state->x_sz);
+    fd_x = open(RM_TEST_11_F_X, O_RDONLY);
+    assert_true(fd_x != -1);
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sp), 0);
+    reader.fd = sp[1];
+    reader.n = rm_state->x_sz;
+    reader.dst = malloc(reader.n);
+    assert_true(reader.dst != NULL);
+    assert_int_equal(pthread_create(&tid, NULL, test_rm_chan_reader_f, &reader), 0);
+
+    assert_int_equal(rm_tcp_chan_init(&c, sp[0], RM_TCP_CHAN_DELTA, 1), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x, 100), RM_ERR_OK);                         /* buffered, goes before range */
+    assert_int_equal(rm_tcp_chan_tx_file(&c, fd_x, 100, big_n), RM_ERR_OK);                     /* own frames, sendfile */
+    assert_int_equal(c.sendfile_n, big_n);
+    assert_int_equal(rm_tcp_chan_tx_file(&c, fd_x, 100 + big_n, small_n), RM_ERR_OK);           /* copied into frame */
+    assert_int_equal(c.sendfile_n, big_n);
+    assert_int_equal(rm_tcp_chan_tx(&c, rm_state->x + 100 + big_n + small_n, rm_state->x_sz - 100 - big_n - small_n), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_flush(&c), RM_ERR_OK);
+    assert_int_equal(rm_tcp_tx(sp[0], end, sizeof(end)), RM_ERR_OK);
+    rm_tcp_chan_free(&c);
+    pthread_join(tid, NULL);
+
+    assert_int_equal(reader.err, RM_ERR_OK);
+    assert_memory_equal(reader.dst, rm_state->x, rm_state->x_sz);
+    assert_memory_equal(reader.end, end, sizeof(end));
+    close(fd_x);
+    close(sp[0]);
+    close(sp[1]);
+    free(reader.dst);
+    RM_LOG_INFO("PASSED test #6 (framed channel, [%zu] bytes of file sent with sendfile)", big_n);
+}
+
+struct test_rm_chan_writer {
+    int                 fd;
+    int                 fd_x;
+    uint64_t            off;    /* range of @x sent from file */
+    size_t              n;
+    const void          *tail;  /* bytes buffered after it */
+    size_t              tail_n;
+    enum rm_error       err;
+};
+
+static void *
+test_rm_chan_writer_f(void *arg) {
+    struct test_rm_chan_writer  *w = arg;
+    struct rm_tcp_chan          c;
+
+    w->err = rm_tcp_chan_init(&c, w->fd, RM_TCP_CHAN_DELTA, 1);
+    if (w->err == RM_ERR_OK) {
+        w->err = rm_tcp_chan_tx_file(&c, w->fd_x, w->off, w->n);
+    }
+    if (w->err == RM_ERR_OK) {
+        w->err = rm_tcp_chan_tx(&c, w->tail, w->tail_n);
+    }
+    if (w->err == RM_ERR_OK) {
+        w->err = rm_tcp_chan_flush(&c);
+    }
+    rm_tcp_chan_free(&c);
+    return NULL;
+}
+
+void
+test_rm_tcp_chan_4(void **state) {
+    struct test_rm_state        *rm_state;
+    struct test_rm_chan_writer  writer;
+    struct rm_tcp_file_rx       r;
+    struct rm_tcp_chan          c;
+    pthread_t                   tid;
+    int                         fd_x, fd_z, sp[2];
+    unsigned char               hdr[RM_TCP_FRAME_HDR_LEN], *z;
+    uint16_t                    len;
+    size_t                      frame_left, moved, z_n, frames_n;
+    MD5_CTX                     md5;
+    unsigned char               digest[RM_STRONG_CHECK_BYTES], digest_exp[RM_STRONG_CHECK_BYTES];
+    char                        tail[4] = "END", tail_rx[4] = { 0 };
+    enum rm_error               err;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    fd_x = open(RM_TEST_11_F_X, O_RDONLY);
+    fd_z = open(RM_TEST_11_F_Z, O_WRONLY | O_CREAT | O_TRUNC, 0644);   /* write only: digest can't be read back from it */
+    assert_true(fd_x != -1 && fd_z != -1);
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sp), 0);
+    writer.fd = sp[0];
+    writer.fd_x = fd_x;
+    writer.off = 1000;
+    writer.n = 2 * RM_TCP_FRAME_LEN_MAX + 5;
+    writer.tail = tail;
+    writer.tail_n = sizeof(tail);
+    assert_true(writer.off + writer.n <= rm_state->x_sz);
+    assert_int_equal(pthread_create(&tid, NULL, test_rm_chan_writer_f, &writer), 0);
+
+    assert_int_equal(rm_tcp_file_rx_init(&r, 1), RM_ERR_OK);
+    assert_true(r.pipe_fd[0] != -1 && r.tee_fd[0] != -1);
+    md5_init(&md5);
+    for (z_n = 0, frames_n = 0; z_n < writer.n; ++frames_n) {     /* frame header is read, its payload spliced into @z */
+        assert_int_equal(rm_tcp_rx(sp[1], hdr, RM_TCP_FRAME_HDR_LEN), RM_ERR_OK);
+        rm_deserialize_u16(hdr + 2, &len);
+        assert_int_equal(hdr[0], RM_TCP_CHAN_DELTA);
+        assert_true(len > 0 && z_n + len <= writer.n);
+        for (frame_left = len; frame_left > 0; frame_left -= moved, z_n += moved) {
+            err = rm_tcp_file_rx_splice(&r, sp[1], fd_z, z_n, frame_left, &md5, &moved);
+            assert_int_equal(err, RM_ERR_OK);
+            assert_true(moved > 0 && moved <= frame_left);
+        }
+    }
+    md5_final(&md5, digest);
+    assert_int_equal(frames_n, writer.n / RM_TCP_FRAME_LEN_MAX + 1);
+    assert_true(r.pipe_fd[0] != -1 && r.tee_fd[0] != -1);            /* spliced and tee'd all the time */
+    rm_tcp_file_rx_free(&r);
+
+    assert_int_equal(rm_tcp_chan_init(&c, sp[1], RM_TCP_CHAN_DELTA, 1), RM_ERR_OK);
+    assert_int_equal(rm_tcp_chan_rx(&c, tail_rx, sizeof(tail_rx)), RM_ERR_OK);      /* splice took no byte of next frame */
+    assert_memory_equal(tail_rx, tail, sizeof(tail));
+    rm_tcp_chan_free(&c);
+    pthread_join(tid, NULL);
+    assert_int_equal(writer.err, RM_ERR_OK);
+
+    rm_md5(rm_state->x + writer.off, writer.n, digest_exp);
+    assert_memory_equal(digest, digest_exp, RM_STRONG_CHECK_BYTES);
+    z = malloc(writer.n);
+    assert_true(z != NULL);
+    close(fd_z);
+    fd_z = open(RM_TEST_11_F_Z, O_RDONLY);
+    assert_true(fd_z != -1);
+    assert_int_equal(pread(fd_z, z, writer.n + 1, 0), writer.n);
+    assert_memory_equal(z, rm_state->x + writer.off, writer.n);
+    free(z);
+    close(fd_z);
+    close(fd_x);
+    close(sp[0]);
+    close(sp[1]);
+    unlink(RM_TEST_11_F_Z);
+    RM_LOG_INFO("PASSED test #7 (framed channel, [%zu] bytes spliced from [%zu] frames, digest through tee)", z_n, frames_n);
+}
+
+/* Literal payload @src goes through compressor @tx and decompressor @rx
+ * the way it goes through transmitter and receiver. Returns size
+ * of compressed payload, 0 if it was sent stored. */
+static size_t
+test_rm_codec_xfer(struct rm_codec *tx, struct rm_codec *rx, const unsigned char *src, size_t src_n) {
+    const unsigned char     *z;
+    unsigned char           *out;
+    size_t                  z_n, in, out_n, src_used, dst_used;
+
+    assert_int_equal(rm_codec_compress(tx, src, src_n, &z, &z_n), RM_ERR_OK);
+    if (z_n == 0) {
+        return 0;
+    }
+    assert_true(z_n < src_n && z_n <= rm_codec_bound(src_n));
+    out = malloc(src_n);
+    assert_true(out != NULL);
+    assert_int_equal(rm_codec_element_start(rx), RM_ERR_OK);
+    in = out_n = 0;
+    do {
+        assert_int_equal(rm_codec_decompress(rx, z + in, z_n - in, &src_used, out + out_n, src_n - out_n, &dst_used), RM_ERR_OK);
+        assert_true(src_used > 0 || dst_used > 0 || in == z_n);
+        in += src_used;
+        out_n += dst_used;
+    } while (in < z_n || (out_n < src_n && dst_used > 0));
+    assert_int_equal(out_n, src_n);
+    assert_memory_equal(out, src, src_n);
+    free(out);
+    return z_n;
+}
+
+static void
+test_rm_codec_text(unsigned char *buf, size_t n, size_t seq) {
+    size_t  pos = 0;
+    int     k;
+
+    while (pos < n) {
+        k = snprintf((char*) buf + pos, n - pos, "%zu lorem ipsum dolor sit amet\n", seq++);
+        if (k < 0 || (size_t) k >= n - pos) {
+            memset(buf + pos, '.', n - pos);
+            break;
+        }
+        pos += k;
+    }
+}
+
+void
+test_rm_codec_1(void **state) {
+    struct test_rm_state    *rm_state;
+    struct rm_codec         tx, rx;
+    unsigned char           buf[2000];
+    size_t                  i, z_n, compressed_n = 0, stored_n = 0, resumed_n = 0;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_int_equal(rm_codec_init(&tx, RM_CODEC_ZLIB, 0, 1, -1), RM_ERR_OK);
+    assert_int_equal(rm_codec_init(&rx, RM_CODEC_ZLIB, 0, 0, -1), RM_ERR_OK);
+
+    for (i = 0; i < 20; ++i) {                                              /* text compresses */
+        test_rm_codec_text(buf, sizeof(buf), i * 100);
+        z_n = test_rm_codec_xfer(&tx, &rx, buf, sizeof(buf));
+        assert_true(z_n > 0);
+        ++compressed_n;
+    }
+    assert_int_equal(test_rm_codec_xfer(&tx, &rx, buf, RM_CODEC_MIN_BYTES - 1), 0);    /* too short */
+    ++stored_n;
+    assert_int_equal(test_rm_codec_xfer(&tx, &rx, rm_state->x, 4096), 0);  /* random bytes don't get smaller, taken out of deflate window */
+    ++stored_n;
+    for (i = 0; i < 2 * RM_CODEC_SKIP_MIN / sizeof(buf); ++i) {             /* back-off, then text compresses again against window from before */
+        test_rm_codec_text(buf, sizeof(buf), i * 100);
+        z_n = test_rm_codec_xfer(&tx, &rx, buf, sizeof(buf));
+        if (z_n == 0) {
+            assert_int_equal(resumed_n, 0);
+            ++stored_n;
+        } else {
+            ++resumed_n;
+        }
+    }
+    assert_true(stored_n >= 2 + RM_CODEC_SKIP_MIN / sizeof(buf));
+    assert_true(resumed_n > 0);
+    rm_codec_free(&tx);
+    rm_codec_free(&rx);
+    RM_LOG_INFO("PASSED test #8 (zlib codec), payloads compressed [%zu], stored [%zu], compressed after back-off [%zu]", compressed_n, stored_n, resumed_n);
+}
+
+void
+test_rm_codec_2(void **state) {
+    struct test_rm_state    *rm_state;
+    struct rm_codec         tx, rx, plain;
+    unsigned char           buf[RM_TEST_11_CODEC_L];
+    const unsigned char     *z;
+    int                     fd_y;
+    uint8_t                 type, level;
+    size_t                  k, L = RM_TEST_11_CODEC_L, n, z_n, pos = 0, compressed_n = 0;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_int_equal(rm_codec_parse("zlib+ref", &type, &level), RM_ERR_OK);
+    assert_int_equal(type, RM_CODEC_ZLIB | RM_CODEC_REF);
+    fd_y = open(RM_TEST_11_F_Y, O_RDONLY);      /* matched blocks are equal on both sides, read them from @y */
+    assert_true(fd_y != -1);
+    assert_int_equal(rm_codec_init(&tx, type, level, 1, fd_y), RM_ERR_OK);
+    assert_int_equal(rm_codec_init(&rx, type, level, 0, fd_y), RM_ERR_OK);
+    assert_int_equal(rm_codec_init(&plain, RM_CODEC_ZLIB, 0, 1, -1), RM_ERR_OK);
+
+    for (k = 0; k < rm_state->y_sz / L; ++k) {
+        rm_codec_dict_add(&tx, k, pos, k * L, L);   /* REFERENCE to block k */
+        rm_codec_dict_add(&rx, k, pos, k * L, L);
+        pos += L;
+        n = L - 7;                                  /* literals: block k shifted, with few edits */
+        memcpy(buf, rm_state->y + k * L + 7, n);
+        buf[k % n] ^= 0xff;
+        buf[(k * 31) % n] ^= 0xff;
+        if (k == 5) {                               /* random bytes not in @y don't compress */
+            memcpy(buf, rm_state->x + rm_state->x_sz - n, n);
+            buf[0] ^= 0xff;
+            assert_int_equal(test_rm_codec_xfer(&tx, &rx, buf, n), 0);
+            assert_int_equal(test_rm_codec_xfer(&tx, &rx, buf, n), 0);  /* backing off */
+            pos += 2 * n;
+            continue;
+        }
+        z_n = test_rm_codec_xfer(&tx, &rx, buf, n);
+        assert_true(z_n > 0 && z_n < n / 4);        /* compressed against matched block */
+        assert_int_equal(rm_codec_compress(&plain, buf, n, &z, &z_n), RM_ERR_OK);
+        assert_int_equal(z_n, 0);                   /* without it they are random bytes */
+        pos += n;
+        ++compressed_n;
+    }
+    assert_int_equal(compressed_n, rm_state->y_sz / L - 1);
+    rm_codec_free(&tx);
+    rm_codec_free(&rx);
+    rm_codec_free(&plain);
+    close(fd_y);
+    RM_LOG_INFO("PASSED test #9 (reference-aware zlib codec), payloads compressed [%zu]", compressed_n);
+}
@@ -0,0 +1,395 @@
+/* @file        test_rm12.c
+ * @brief       Test suite #12.
+ * @details     Tests of workqueue and of session executor.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "test_rm12.h"
+
+
+enum rm_loglevel RM_LOGLEVEL = RM_LOGLEVEL_NORMAL;
+
+struct test_rm_state	rm_state;	/* global tests state */
+
+int RM_TEST_MOCK_SYSCONF = 0;
+
+int test_rm_setup(void **state)
+{
+    int         err = -1;
+
+#ifdef DEBUG
+    err = rm_util_chdir_umask_openlog("../build/debug", 1, "rsyncme_test_12", 1);
+#else
+    err = rm_util_chdir_umask_openlog("../build/release", 1, "rsyncme_test_12", 1);
+#endif
+    if (err != RM_ERR_OK) {
+        exit(EXIT_FAILURE);
+    }
+    *state = &rm_state;
+    memset(&rm_state, 0, sizeof(rm_state));
+    pthread_mutex_init(&rm_state.mutex, NULL);
+    pthread_cond_init(&rm_state.signal, NULL);
+    return 0;
+}
+
+int test_rm_teardown(void **state)
+{
+    struct  test_rm_state *rm_state;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    pthread_mutex_destroy(&rm_state->mutex);
+    pthread_cond_destroy(&rm_state->signal);
+    return 0;
+}
+
+long
+__wrap_sysconf(int name) {
+    if (RM_TEST_MOCK_SYSCONF == 0 || name != _SC_NPROCESSORS_ONLN) {
+        return __real_sysconf(name);
+    }
+    return mock_type(long);
+}
+
+struct test_rm_job {
+    struct rm_work          work;   /* must be first */
+    size_t                  id;
+    uint8_t                 block;  /* wait until released */
+    uint8_t                 started;
+    uint8_t                 done;
+    uint32_t                worker_idx;
+};
+
+static void *
+test_rm_job_f(void *arg) {
+    struct test_rm_job      *job = arg;
+    uint8_t                 blocker;
+
+    pthread_mutex_lock(&rm_state.mutex);
+    blocker = job->block;
+    job->started = 1;
+    job->worker_idx = job->work.worker_idx;
+    pthread_cond_broadcast(&rm_state.signal);
+    while (job->block && rm_state.release == 0) {
+        pthread_cond_wait(&rm_state.signal, &rm_state.mutex);
+    }
+    if (blocker == 0 && rm_state.order_n < RM_TEST_12_JOBS_N) {
+        rm_state.order[rm_state.order_n++] = job->id;
+    }
+    job->done = 1;
+    pthread_cond_broadcast(&rm_state.signal);
+    pthread_mutex_unlock(&rm_state.mutex);
+    return NULL;
+}
+
+static void
+test_rm_job_dtor(void *arg) {
+    (void) arg;                     /* jobs are owned by test */
+}
+
+static void
+test_rm_job_init(struct test_rm_job *job, size_t id, uint8_t block) {
+    memset(job, 0, sizeof(*job));
+    rm_work_init(&job->work, RM_WORK_PROCESS_MSG_PUSH, NULL, NULL, -1, test_rm_job_f, test_rm_job_dtor);
+    job->id = id;
+    job->block = block;
+}
+
+/* Queue @job to worker @idx (round-robin dispatcher starts from it). */
+static void
+test_rm_job_queue(struct rm_workqueue *wq, struct test_rm_job *job, uint32_t idx) {
+    wq->next_worker_idx_to_use = idx;
+    rm_wq_queue_work(wq, &job->work);
+}
+
+/* Wait until *@flag is set, returns 0 on timeout. */
+static int
+test_rm_wait(const uint8_t *flag) {
+    struct timespec         ts;
+    int                     err = 0;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += RM_TEST_12_WAIT_MS / 1000;
+    pthread_mutex_lock(&rm_state.mutex);
+    while (*flag == 0 && err == 0) {
+        err = pthread_cond_timedwait(&rm_state.signal, &rm_state.mutex, &ts);
+    }
+    err = *flag;
+    pthread_mutex_unlock(&rm_state.mutex);
+    return err;
+}
+
+static void
+test_rm_release(uint8_t release) {
+    pthread_mutex_lock(&rm_state.mutex);
+    rm_state.release = release;
+    rm_state.order_n = 0;
+    pthread_cond_broadcast(&rm_state.signal);
+    pthread_mutex_unlock(&rm_state.mutex);
+}
+
+void
+test_rm_wq_1(void **state) {
+    struct rm_workqueue     *wq;
+    struct test_rm_job      blocker_a, blocker_b, jobs[RM_TEST_12_JOBS_N];
+    struct rm_worker_stats  stats_a, stats_b;
+    uint32_t                a, b;
+    size_t                  i;
+
+    (void) state;
+    test_rm_release(0);
+    wq = rm_wq_workqueue_create(2, "test_wq_1");
+    assert_true(wq != NULL && wq->workers_active_n == 2);
+
+    test_rm_job_init(&blocker_a, 0, 1);                             /* make both workers busy */
+    test_rm_job_queue(wq, &blocker_a, 0);
+    assert_true(test_rm_wait(&blocker_a.started) != 0);
+    a = blocker_a.worker_idx;
+    b = 1 - a;
+    test_rm_job_init(&blocker_b, 0, 1);
+    test_rm_job_queue(wq, &blocker_b, b);
+    assert_true(test_rm_wait(&blocker_b.started) != 0);
+    assert_int_equal(blocker_b.worker_idx, b);
+
+    for (i = 0; i < RM_TEST_12_JOBS_N; ++i) {                       /* queue behind busy @a */
+        test_rm_job_init(&jobs[i], i, 0);
+        test_rm_job_queue(wq, &jobs[i], a);
+    }
+    rm_wq_worker_stats(&wq->workers[a], &stats_a);
+    assert_int_equal(stats_a.queue_n, RM_TEST_12_JOBS_N);
+
+    pthread_mutex_lock(&rm_state.mutex);                            /* @b is done with own work, steals all from @a */
+    blocker_b.block = 0;
+    pthread_cond_broadcast(&rm_state.signal);
+    pthread_mutex_unlock(&rm_state.mutex);
+    assert_true(test_rm_wait(&jobs[RM_TEST_12_JOBS_N - 1].done) != 0);
+    pthread_mutex_lock(&rm_state.mutex);
+    assert_int_equal(rm_state.order_n, RM_TEST_12_JOBS_N);
+    for (i = 0; i < RM_TEST_12_JOBS_N; ++i) {
+        assert_int_equal(rm_state.order[i], i);                     /* oldest first */
+        assert_int_equal(jobs[i].worker_idx, b);
+    }
+    assert_int_equal(blocker_a.done, 0);
+    pthread_mutex_unlock(&rm_state.mutex);
+    rm_wq_worker_stats(&wq->workers[a], &stats_a);
+    rm_wq_worker_stats(&wq->workers[b], &stats_b);
+    assert_int_equal(stats_a.queue_n, 0);
+    assert_int_equal(stats_b.steals_n, RM_TEST_12_JOBS_N);
+
+    test_rm_release(1);
+    assert_true(test_rm_wait(&blocker_a.done) != 0);
+    assert_int_equal(rm_wq_workqueue_stop(wq), RM_ERR_OK);
+    rm_wq_worker_stats(&wq->workers[a], &stats_a);
+    rm_wq_worker_stats(&wq->workers[b], &stats_b);
+    assert_int_equal(stats_a.done_n, 1);
+    assert_int_equal(stats_b.done_n, RM_TEST_12_JOBS_N + 1);
+    rm_wq_workqueue_free(wq);
+    RM_LOG_INFO("%s", "PASSED test #1 (stealing, oldest work first)");
+}
+
+void
+test_rm_wq_2(void **state) {
+    struct rm_workqueue     *wq;
+    struct test_rm_job      blocker, job;
+    struct rm_worker_stats  stats;
+    uint32_t                a, b;
+
+    (void) state;
+    test_rm_release(0);
+    wq = rm_wq_workqueue_create(2, "test_wq_2");
+    assert_true(wq != NULL && wq->workers_active_n == 2);
+
+    test_rm_job_init(&blocker, 0, 1);
+    test_rm_job_queue(wq, &blocker, 0);
+    assert_true(test_rm_wait(&blocker.started) != 0);
+    a = blocker.worker_idx;
+    b = 1 - a;
+    usleep(100000);                                                 /* let @b go to sleep */
+    pthread_mutex_lock(&wq->workers[b].mutex);
+    assert_int_equal(wq->workers[b].idle, 1);
+    pthread_mutex_unlock(&wq->workers[b].mutex);
+
+    test_rm_job_init(&job, 1, 0);                                   /* queued to busy @a, @b is woken to steal it */
+    test_rm_job_queue(wq, &job, a);
+    assert_true(test_rm_wait(&job.done) != 0);
+    assert_int_equal(job.worker_idx, b);
+    assert_int_equal(blocker.done, 0);
+    rm_wq_worker_stats(&wq->workers[b], &stats);
+    assert_int_equal(stats.steals_n, 1);
+
+    test_rm_release(1);
+    assert_true(test_rm_wait(&blocker.done) != 0);
+    assert_int_equal(rm_wq_workqueue_stop(wq), RM_ERR_OK);
+    rm_wq_workqueue_free(wq);
+    RM_LOG_INFO("%s", "PASSED test #2 (idle worker woken for work queued to busy one)");
+}
+
+void
+test_rm_wq_3(void **state) {
+    (void) state;
+    RM_TEST_MOCK_SYSCONF = 1;
+    will_return(__wrap_sysconf, 1);
+    assert_int_equal(rm_wq_workers_n_default(), RM_WORKERS_PER_CPU);
+    will_return(__wrap_sysconf, 12);
+    assert_int_equal(rm_wq_workers_n_default(), 12 * RM_WORKERS_PER_CPU);
+    will_return(__wrap_sysconf, RM_WORKERS_MAX / RM_WORKERS_PER_CPU + 1);   /* capped */
+    assert_int_equal(rm_wq_workers_n_default(), RM_WORKERS_MAX);
+    will_return(__wrap_sysconf, 1000000);
+    assert_int_equal(rm_wq_workers_n_default(), RM_WORKERS_MAX);
+    will_return(__wrap_sysconf, -1);                                /* unknown */
+    assert_int_equal(rm_wq_workers_n_default(), RM_WORKERS_N);
+    will_return(__wrap_sysconf, 0);
+    assert_int_equal(rm_wq_workers_n_default(), RM_WORKERS_N);
+    RM_TEST_MOCK_SYSCONF = 0;
+    RM_LOG_INFO("%s", "PASSED test #3 (default number of workers)");
+}
+
+struct test_rm_exec_task {
+    struct rm_exec_task     task;   /* must be first */
+    int                     fd_next;    /* descriptor to wait on after reply is sent */
+    uint8_t                 phase;
+    uint32_t                steps_n;
+    uint8_t                 done;
+    uint8_t                 aborted;
+};
+
+/* Receive 'x' on @fd, reply 'y' once writable, then receive 'z' on @fd_next. */
+static enum rm_exec_wait
+test_rm_exec_task_f(struct rm_exec_task *task) {
+    struct test_rm_exec_task    *t = (struct test_rm_exec_task*) task;
+    unsigned char               c = 0;
+
+    t->steps_n++;
+    switch (t->phase) {
+        case 0:
+            if (read(t->task.fd, &c, 1) != 1 || c != 'x') {
+                return RM_EXEC_DONE;
+            }
+            t->phase = 1;
+            return RM_EXEC_WAIT_OUT;                                /* same descriptor, other events */
+        case 1:
+            if (write(t->task.fd, "y", 1) != 1) {
+                return RM_EXEC_DONE;
+            }
+            t->phase = 2;
+            t->task.fd = t->fd_next;
+            return RM_EXEC_WAIT_IN;                                 /* other descriptor */
+        default:
+            if (read(t->task.fd, &c, 1) == 1 && c == 'z') {
+                t->phase = 3;
+            }
+            return RM_EXEC_DONE;
+    }
+}
+
+static void
+test_rm_exec_task_dtor(struct rm_exec_task *task, uint8_t aborted) {
+    struct test_rm_exec_task    *t = (struct test_rm_exec_task*) task;
+
+    pthread_mutex_lock(&rm_state.mutex);
+    t->aborted = aborted;
+    t->done = 1;
+    pthread_cond_broadcast(&rm_state.signal);
+    pthread_mutex_unlock(&rm_state.mutex);
+}
+
+static void
+test_rm_exec_task_init(struct test_rm_exec_task *t, int fd, int fd_next) {
+    memset(t, 0, sizeof(*t));
+    t->task.fd = fd;
+    t->task.fd_registered = -1;
+    t->task.f = test_rm_exec_task_f;
+    t->task.f_dtor = test_rm_exec_task_dtor;
+    t->fd_next = fd_next;
+}
+
+void
+test_rm_exec_1(void **state) {
+    struct rm_exec              e;
+    struct test_rm_exec_task    t1, t2;
+    int                         a[2], b[2], c[2];
+    unsigned char               ch = 0;
+    struct pollfd               pfd;
+
+    (void) state;
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, a), 0);
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, b), 0);
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, c), 0);
+    assert_int_equal(rm_tcp_set_socket_blocking_mode(a[0], 0), 0);
+    assert_int_equal(rm_tcp_set_socket_blocking_mode(b[0], 0), 0);
+    assert_int_equal(rm_tcp_set_socket_blocking_mode(c[0], 0), 0);
+    assert_int_equal(rm_exec_init(&e, 2), RM_ERR_OK);
+
+    test_rm_exec_task_init(&t1, a[0], b[0]);
+    assert_int_equal(rm_exec_submit(&e, &t1.task, RM_EXEC_WAIT_IN), RM_ERR_OK);
+    test_rm_exec_task_init(&t2, c[0], c[0]);                        /* never gets its 'x' */
+    assert_int_equal(rm_exec_submit(&e, &t2.task, RM_EXEC_WAIT_IN), RM_ERR_OK);
+    assert_true(t1.task.thread != t2.task.thread);                  /* least loaded thread */
+    usleep(100000);
+    assert_int_equal(t1.steps_n, 0);                                /* not stepped until readable */
+
+    assert_int_equal(write(a[1], "x", 1), 1);
+    pfd.fd = a[1];
+    pfd.events = POLLIN;
+    assert_int_equal(poll(&pfd, 1, RM_TEST_12_WAIT_MS), 1);
+    assert_int_equal(read(a[1], &ch, 1), 1);                        /* stepped on readable, then on writable */
+    assert_int_equal(ch, 'y');
+    assert_int_equal(write(b[1], "z", 1), 1);                       /* re-armed on other descriptor */
+    assert_true(test_rm_wait(&t1.done) != 0);
+    assert_int_equal(t1.aborted, 0);
+    assert_int_equal(t1.phase, 3);
+    assert_int_equal(t1.steps_n, 3);
+    pthread_mutex_lock(&t1.task.thread->mutex);
+    assert_int_equal(t1.task.thread->tasks_n, 0);
+    pthread_mutex_unlock(&t1.task.thread->mutex);
+
+    assert_int_equal(t2.done, 0);
+    assert_int_equal(rm_exec_stop(&e), RM_ERR_OK);                  /* task still waiting is aborted */
+    assert_int_equal(t2.done, 1);
+    assert_int_equal(t2.aborted, 1);
+    assert_int_equal(t2.steps_n, 0);
+
+    close(a[0]); close(a[1]); close(b[0]); close(b[1]); close(c[0]); close(c[1]);
+    RM_LOG_INFO("%s", "PASSED test #4 (executor steps, re-arms, aborts on stop)");
+}
+
+void
+test_rm_exec_2(void **state) {
+    struct rm_exec              e;
+    struct test_rm_exec_task    t;
+    int                         a[2];
+    uint32_t                    i;
+
+    (void) state;
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, a), 0);
+    assert_int_equal(rm_tcp_set_socket_blocking_mode(a[0], 0), 0);
+    assert_int_equal(rm_exec_init(&e, 2), RM_ERR_OK);
+
+    e.stop = 1;                                                     /* let threads abort their tasks... */
+    for (i = 0; i < e.threads_n; ++i) {
+        pthread_join(e.threads[i].tid, NULL);
+        e.threads[i].running = 0;
+        assert_int_equal(e.threads[i].stopped, 1);
+    }
+    e.stop = 0;                                                     /* ...and submit as if stop had not been seen yet */
+    for (i = 0; i < e.threads_n; ++i) {
+        e.threads[i].running = 1;
+    }
+    test_rm_exec_task_init(&t, a[0], a[0]);
+    assert_int_equal(write(a[1], "x", 1), 1);
+    assert_int_equal(rm_exec_submit(&e, &t.task, RM_EXEC_WAIT_IN), RM_ERR_BAD_CALL);
+    assert_int_equal(t.done, 0);                                    /* refused, not leaked in list of stopped thread */
+    for (i = 0; i < e.threads_n; ++i) {
+        assert_int_equal(e.threads[i].tasks_n, 0);
+        e.threads[i].running = 0;
+    }
+    assert_int_equal(rm_exec_stop(&e), RM_ERR_OK);
+    assert_int_equal(rm_exec_submit(&e, &t.task, RM_EXEC_WAIT_IN), RM_ERR_BAD_CALL);
+    assert_int_equal(t.steps_n, 0);
+
+    close(a[0]); close(a[1]);
+    RM_LOG_INFO("%s", "PASSED test #5 (executor refuses task once stopped)");
+}
@@ -0,0 +1,252 @@
+/* @file        test_rm13.c
+ * @brief       Test suite #13.
+ * @details     Tests of directory push: validation of paths in file list
+ *              and handling of requests and files rejected by receiver.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "test_rm13.h"
+
+
+enum rm_loglevel RM_LOGLEVEL = RM_LOGLEVEL_NORMAL;
+
+struct test_rm_state	rm_state;	/* global tests state */
+
+static const char *test_rm_13_files[RM_TEST_13_FILES_N] = { "a", "b", "c/d" };  /* in order transmitter sends them */
+static const size_t test_rm_13_files_sz[RM_TEST_13_FILES_N] = { 10, 0, 5 };
+
+int test_rm_setup(void **state)
+{
+    int         err = -1;
+    FILE        *f = NULL;
+    char        path[PATH_MAX];
+    size_t      i = 0, j = 0;
+
+#ifdef DEBUG
+    err = rm_util_chdir_umask_openlog("../build/debug", 1, "rsyncme_test_13", 1);
+#else
+    err = rm_util_chdir_umask_openlog("../build/release", 1, "rsyncme_test_13", 1);
+#endif
+    if (err != RM_ERR_OK) {
+        exit(EXIT_FAILURE);
+    }
+    *state = &rm_state;
+    memset(&rm_state, 0, sizeof(rm_state));
+
+    if (mkdir(RM_TEST_13_X, 0755) != 0 && errno != EEXIST) {
+        RM_LOG_PERR("Can't create directory [%s]", RM_TEST_13_X);
+        exit(EXIT_FAILURE);
+    }
+    if (mkdir(RM_TEST_13_X "/c", 0755) != 0 && errno != EEXIST) {
+        RM_LOG_PERR("Can't create directory [%s]", RM_TEST_13_X "/c");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < RM_TEST_13_FILES_N; ++i) {
+        snprintf(path, PATH_MAX, "%s/%s", RM_TEST_13_X, test_rm_13_files[i]);
+        f = fopen(path, "wb");
+        if (f == NULL) {
+            RM_LOG_PERR("Can't open file [%s]", path);
+            exit(EXIT_FAILURE);
+        }
+        for (j = 0; j < test_rm_13_files_sz[i]; ++j) {
+            fputc('a' + j, f);
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+int test_rm_teardown(void **state)
+{
+    struct  test_rm_state *rm_state;
+    char                  path[PATH_MAX];
+    size_t                i = 0;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    if (RM_TEST_13_DELETE_FILES == 1) {
+        for (i = 0; i < RM_TEST_13_FILES_N; ++i) {
+            snprintf(path, PATH_MAX, "%s/%s", RM_TEST_13_X, test_rm_13_files[i]);
+            unlink(path);
+        }
+        rmdir(RM_TEST_13_X "/c");
+        rmdir(RM_TEST_13_X);
+    }
+    return 0;
+}
+
+void
+test_rm_tree_path_1(void **state) {
+    (void) state;
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a"), 1);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a/b/c"), 1);
+    assert_int_equal(rm_do_msg_push_tree_path_valid(".a/..b/b..c/..."), 1);
+    assert_int_equal(rm_do_msg_push_tree_path_valid(""), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("/"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("/a"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("/etc/passwd"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid(".."), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("../a"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a/.."), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a/../../b"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("."), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("./a"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a/./b"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a//b"), 0);
+    assert_int_equal(rm_do_msg_push_tree_path_valid("a/"), 0);
+    RM_LOG_INFO("%s", "PASSED test #1 (validation of paths in file list)");
+}
+
+/* Read message of type @pt into @buf, its length into @len. */
+static enum rm_error
+test_rm_msg_rx(int fd, enum rm_pt_type pt, unsigned char *buf, size_t buf_len, struct rm_msg_hdr *hdr) {
+    enum rm_error   err = RM_ERR_OK;
+
+    err = rm_tcp_rx(fd, buf, RM_MSG_HDR_LEN);
+    if (err != RM_ERR_OK) {
+        return err;
+    }
+    if (rm_core_tcp_msg_hdr_validate(buf, RM_MSG_HDR_LEN) != RM_ERR_OK) {
+        return RM_ERR_FAIL;
+    }
+    rm_deserialize_msg_hdr(buf, hdr);
+    if (hdr->pt != pt || hdr->len < RM_MSG_HDR_LEN || hdr->len > buf_len) {
+        return RM_ERR_MSG_PT_UNKNOWN;
+    }
+    return rm_tcp_rx(fd, buf + RM_MSG_HDR_LEN, hdr->len - RM_MSG_HDR_LEN);
+}
+
+/* Receiver which rejects request or nonempty files. */
+static void *
+test_rm_fake_rx_f(void *arg) {
+    struct test_rm_fake_rx      *rx = arg;
+    struct rm_msg_hdr           hdr = {0};
+    struct rm_msg_push_tree     tree, *tree_p = &tree;
+    struct rm_msg_push_file     file;
+    unsigned char               buf[RM_MSG_PUSH_FILE_LEN_MAX > RM_MSG_PUSH_TREE_ACK_LEN ? 2 * RM_MSG_PUSH_FILE_LEN_MAX : RM_MSG_PUSH_TREE_ACK_LEN];
+    uint64_t                    i = 0, ok_n = 0, fail_n = 0;
+    enum rm_error               err = RM_ERR_OK;
+    int                         fd = -1;
+
+    fd = accept(rx->listen_fd, NULL, NULL);
+    if (fd < 0) {
+        rx->err = RM_ERR_TCP;
+        return NULL;
+    }
+    rx->err = test_rm_msg_rx(fd, RM_PT_MSG_PUSH_TREE, buf, sizeof(buf), &hdr);
+    if (rx->err != RM_ERR_OK) {
+        goto done;
+    }
+    memset(&tree, 0, sizeof(tree));
+    rm_deserialize_msg_push_tree(buf + RM_MSG_HDR_LEN, &hdr, &tree_p);
+    rx->files_n = tree.files_n;
+    rx->err = rm_tcp_tx_msg_ack(fd, RM_PT_MSG_ACK, rx->tree_err, NULL);
+    if (rx->err != RM_ERR_OK || rx->tree_err != RM_ERR_OK) {
+        goto eof;
+    }
+
+    rx->paths_valid = 1;
+    memset(&file, 0, sizeof(file));
+    file.hdr = &hdr;
+    for (i = 0; i < rx->files_n && i < RM_TEST_13_FILES_N; ++i) {
+        rx->err = test_rm_msg_rx(fd, RM_PT_MSG_PUSH_FILE, buf, sizeof(buf), &hdr);
+        if (rx->err != RM_ERR_OK) {
+            goto done;
+        }
+        rm_deserialize_msg_push_file_body(buf + RM_MSG_HDR_LEN, &file);
+        strcpy(rx->paths[i], file.path);
+        rx->bytes[i] = file.bytes;
+        rx->paths_valid &= rm_do_msg_push_tree_path_valid(file.path);
+    }
+    for (i = 0; i < rx->files_n && i < RM_TEST_13_FILES_N; ++i) {
+        err = (rx->bytes[i] > 0 ? rx->file_err : RM_ERR_OK);
+        rx->err = rm_tcp_tx_msg_ack(fd, RM_PT_MSG_PUSH_ACK, err, NULL);
+        if (rx->err != RM_ERR_OK) {
+            goto done;
+        }
+        if (err == RM_ERR_OK) {
+            ++ok_n;
+        } else {
+            ++fail_n;
+        }
+    }
+    rm_tcp_msg_push_tree_ack_serialize(buf, rx->file_err, ok_n, fail_n);
+    rx->err = rm_tcp_tx(fd, buf, RM_MSG_PUSH_TREE_ACK_LEN);
+    if (rx->err != RM_ERR_OK) {
+        goto done;
+    }
+
+eof:
+    rx->eof = (read(fd, buf, 1) == 0);                                  /* nothing more comes, transmitter closes connection */
+done:
+    close(fd);
+    return NULL;
+}
+
+static void
+test_rm_fake_rx_start(struct test_rm_fake_rx *rx, pthread_t *tid, enum rm_error tree_err, enum rm_error file_err) {
+    memset(rx, 0, sizeof(*rx));
+    rx->tree_err = tree_err;
+    rx->file_err = file_err;
+    assert_int_equal(rm_tcp_listen(&rx->listen_fd, INADDR_LOOPBACK, &rx->port, 0, 1), RM_ERR_OK);
+    assert_true(rx->port != 0);
+    assert_int_equal(pthread_create(tid, NULL, test_rm_fake_rx_f, rx), 0);
+}
+
+static enum rm_error
+test_rm_push_tree(struct test_rm_fake_rx *rx, struct rm_tx_tree_stats *stats) {
+    struct rm_tx_options    opt = { .loglevel = RM_LOGLEVEL_NORMAL, .inflight = 1, .queue_bytes = RM_DELTA_QUEUE_BYTES };
+    const char              *err_str = NULL;
+
+    return rm_tx_remote_push_tree(RM_TEST_13_X, "y", NULL, RM_TEST_13_L, 0, 0, 1, 0, stats, "127.0.0.1", rx->port, 5, 0, &err_str, &opt);
+}
+
+void
+test_rm_tree_ack_1(void **state) {
+    struct test_rm_state        *rm_state = *state;
+    struct test_rm_fake_rx      *rx = &rm_state->rx;
+    struct rm_tx_tree_stats     stats;
+    pthread_t                   tid;
+
+    test_rm_fake_rx_start(rx, &tid, RM_ERR_Y_NULL, RM_ERR_OK);
+    assert_int_equal(test_rm_push_tree(rx, &stats), RM_ERR_Y_NULL);
+    pthread_join(tid, NULL);
+    close(rx->listen_fd);
+    assert_int_equal(rx->err, RM_ERR_OK);
+    assert_int_equal(rx->files_n, RM_TEST_13_FILES_N);
+    assert_int_equal(rx->eof, 1);                                       /* no file list after reject */
+    assert_int_equal(stats.files_ok_n, 0);
+    assert_int_equal(stats.files_fail_n, 0);
+    RM_LOG_INFO("%s", "PASSED test #2 (rejected request)");
+}
+
+void
+test_rm_tree_ack_2(void **state) {
+    struct test_rm_state        *rm_state = *state;
+    struct test_rm_fake_rx      *rx = &rm_state->rx;
+    struct rm_tx_tree_stats     stats;
+    pthread_t                   tid;
+    size_t                      i = 0;
+
+    test_rm_fake_rx_start(rx, &tid, RM_ERR_OK, RM_ERR_OPEN_Y);
+    assert_int_equal(test_rm_push_tree(rx, &stats), RM_ERR_TREE_PARTIAL);
+    pthread_join(tid, NULL);
+    close(rx->listen_fd);
+    assert_int_equal(rx->err, RM_ERR_OK);
+    assert_int_equal(rx->files_n, RM_TEST_13_FILES_N);
+    assert_int_equal(rx->paths_valid, 1);
+    for (i = 0; i < RM_TEST_13_FILES_N; ++i) {
+        assert_true(strcmp(rx->paths[i], test_rm_13_files[i]) == 0);
+        assert_int_equal(rx->bytes[i], test_rm_13_files_sz[i]);
+    }
+    assert_int_equal(rx->eof, 1);                                       /* no deltas of rejected files */
+    assert_int_equal(stats.files_n, RM_TEST_13_FILES_N);
+    assert_int_equal(stats.bytes_n, 15);
+    assert_int_equal(stats.files_ok_n, 1);
+    assert_int_equal(stats.files_fail_n, 2);
+    assert_int_equal(stats.rec_ctx.delta_raw_n + stats.rec_ctx.delta_ref_n, 0);
+    RM_LOG_INFO("%s", "PASSED test #3 (rejected files)");
+}
@@ -0,0 +1,312 @@
+/* @file        test_rm14.c
+ * @brief       Test suite #14.
+ * @details     Black box testing of daemon's metrics socket (using built
+ *              daemon and commandline utility).
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "test_rm14.h"
+
+
+enum rm_loglevel RM_LOGLEVEL = RM_LOGLEVEL_NORMAL;
+
+struct test_rm_state	rm_state;	/* global tests state */
+
+/* @brief   Send request @req (NULL for none) to metrics socket @path
+ *          and read reply until daemon closes connection.
+ * @return  Length of reply, -1 on error. */
+static ssize_t
+test_rm_14_scrape(const char *path, const char *req, char *buf, size_t buf_sz) {
+    struct sockaddr_un  addr;
+    int                 fd = -1;
+    ssize_t             n = 0, len = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (req != NULL && rm_tcp_write(fd, req, strlen(req)) != RM_ERR_OK) {
+        close(fd);
+        return -1;
+    }
+    shutdown(fd, SHUT_WR);
+    while ((size_t) len < buf_sz - 1) {
+        n = read(fd, buf + len, buf_sz - 1 - len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        len += n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return (n < 0 ? -1 : len);
+}
+
+/* @brief   Value of unlabeled sample @name in text metrics @buf.
+ * @return  0 if found, -1 otherwise. */
+static int
+test_rm_14_value(const char *buf, const char *name, double *v) {
+    const char  *p = buf;
+    size_t      name_len = strlen(name);
+
+    while (p != NULL && *p != '\0') {
+        if (strncmp(p, name, name_len) == 0 && p[name_len] == ' ') {
+            *v = strtod(p + name_len + 1, NULL);
+            return 0;
+        }
+        p = strchr(p, '\n');
+        if (p != NULL) {
+            ++p;
+        }
+    }
+    return -1;
+}
+
+/* @brief   Scrape text metrics until @name reaches at least @min or RM_TEST_14_WAIT_MS passes. */
+static void
+test_rm_14_wait_value(const char *path, char *buf, size_t buf_sz, const char *name, double min) {
+    double      v = 0.0;
+    uint32_t    waited_ms = 0;
+
+    for (waited_ms = 0; ; waited_ms += 10) {
+        assert_true(test_rm_14_scrape(path, "text\n", buf, buf_sz) > 0);
+        assert_int_equal(test_rm_14_value(buf, name, &v), 0);
+        if (v >= min || waited_ms >= RM_TEST_14_WAIT_MS) {
+            return;
+        }
+        usleep(10000);
+    }
+}
+
+int test_rm_setup(void **state) {
+    int             err = -1, fd = -1;
+    FILE            *f = NULL;
+    char            buf[RM_TEST_14_REPLY_MAX];
+    unsigned char   x[RM_TEST_14_X_SZ];
+    uint32_t        waited_ms = 0;
+    size_t          i = 0;
+
+#ifdef DEBUG
+    err = rm_util_chdir_umask_openlog("../build/debug", 1, "rsyncme_test_14", 0);   /* keep SIGCHLD, daemon and commandline utility are waited for */
+#else
+    err = rm_util_chdir_umask_openlog("../build/release", 1, "rsyncme_test_14", 0);
+#endif
+    if (err != RM_ERR_OK) {
+        exit(EXIT_FAILURE);
+    }
+    *state = &rm_state;
+    memset(&rm_state, 0, sizeof(rm_state));
+    if (getcwd(rm_state.dir, sizeof(rm_state.dir)) == NULL) {
+        RM_LOG_PERR("%s", "Can't get working directory");
+        exit(EXIT_FAILURE);
+    }
+    if (strlen(rm_state.dir) + 1 + strlen(RM_TEST_14_SOCK) >= sizeof(rm_state.sock)) {
+        RM_LOG_ERR("Path of metrics socket in [%s] is too long", rm_state.dir);
+        exit(EXIT_FAILURE);
+    }
+    snprintf(rm_state.sock, sizeof(rm_state.sock), "%s/%s", rm_state.dir, RM_TEST_14_SOCK);
+
+    srand(time(NULL));
+    for (i = 0; i < RM_TEST_14_X_SZ; ++i) {
+        x[i] = rand() % 256;
+    }
+    f = fopen(RM_TEST_14_F_X, "wb");
+    if (f == NULL || fwrite(x, 1, RM_TEST_14_X_SZ, f) != RM_TEST_14_X_SZ) {
+        RM_LOG_PERR("Can't write file [%s]", RM_TEST_14_F_X);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+    f = fopen(RM_TEST_14_F_Y, "wb");
+    if (f == NULL || fwrite(x, 1, RM_TEST_14_X_SZ, f) != RM_TEST_14_X_SZ) {
+        RM_LOG_PERR("Can't write file [%s]", RM_TEST_14_F_Y);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+
+    unlink(rm_state.sock);
+    rm_state.daemon_pid = fork();
+    if (rm_state.daemon_pid < 0) {
+        RM_LOG_PERR("%s", "Can't fork daemon");
+        exit(EXIT_FAILURE);
+    }
+    if (rm_state.daemon_pid == 0) {
+        fd = open("/dev/null", O_WRONLY);
+        if (fd >= 0) {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+        execl("./rsyncme_d", "rsyncme_d", "--metrics", rm_state.sock, (char*) NULL);   /* execute built image of daemon from debug/release build folder and not from system global path */
+        _exit(127);
+    }
+    for (waited_ms = 0; test_rm_14_scrape(rm_state.sock, NULL, buf, sizeof(buf)) <= 0; waited_ms += 10) {   /* metrics socket is opened after daemon's TCP port */
+        if (waited_ms >= RM_TEST_14_WAIT_MS || waitpid(rm_state.daemon_pid, NULL, WNOHANG) != 0) {
+            RM_LOG_ERR("%s", "Daemon doesn't serve metrics (is ./rsyncme_d there and port free?)");
+            kill(rm_state.daemon_pid, SIGKILL);
+            exit(EXIT_FAILURE);
+        }
+        usleep(10000);
+    }
+    return 0;
+}
+
+int test_rm_teardown(void **state) {
+    struct  test_rm_state *rm_state;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    if (rm_state->daemon_pid > 0) {
+        kill(rm_state->daemon_pid, SIGKILL);
+        waitpid(rm_state->daemon_pid, NULL, 0);
+    }
+    unlink(rm_state->sock);
+    if (RM_TEST_14_DELETE_FILES == 1) {
+        unlink(RM_TEST_14_F_X);
+        unlink(RM_TEST_14_F_Y);
+        unlink(RM_TEST_14_F_Z);
+    }
+    return 0;
+}
+
+void
+test_rm_metrics_1(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    char                    buf[RM_TEST_14_REPLY_MAX];
+    char                    family[128] = "", type[16], *line = NULL, *eol = NULL, *p = NULL, *end = NULL;
+    size_t                  name_len = 0, families_n = 0, samples_n = 0;
+    double                  v = 0.0;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_true(test_rm_14_scrape(rm_state->sock, "text\n", buf, sizeof(buf)) > 0);
+    assert_true(strstr(buf, "collisions") == NULL);
+    assert_true(buf[strlen(buf) - 1] == '\n');
+
+    for (line = buf; *line != '\0'; line = eol + 1) {
+        eol = strchr(line, '\n');
+        assert_true(eol != NULL);
+        *eol = '\0';
+        if (line[0] == '#') {
+            assert_int_equal(strncmp(line, "# TYPE rsyncme_", 15), 0);
+            assert_int_equal(sscanf(line, "# TYPE %127s %15s", family, type), 2);
+            assert_true(strcmp(type, "counter") == 0 || strcmp(type, "gauge") == 0);
+            ++families_n;
+            continue;
+        }
+        name_len = strspn(line, "abcdefghijklmnopqrstuvwxyz0123456789_");              /* sample belongs to family declared last */
+        assert_true(name_len > 0);
+        assert_int_equal(name_len, strlen(family));
+        assert_int_equal(strncmp(line, family, name_len), 0);
+        p = line + name_len;
+        if (*p == '{') {
+            p = strchr(p, '}');
+            assert_true(p != NULL);
+            ++p;
+        }
+        assert_true(*p == ' ');                                                         /* single value per line */
+        ++p;
+        v = strtod(p, &end);
+        assert_true(end != p && *end == '\0');
+        ++samples_n;
+    }
+    assert_true(families_n > 0);
+    assert_true(samples_n >= families_n - 1);                                           /* errors_n family may be empty */
+
+    assert_true(test_rm_14_scrape(rm_state->sock, "text\n", buf, sizeof(buf)) > 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_uptime_s", &v), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_started_n", &v), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_ended_n", &v), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_n", &v), 0);
+    assert_true(v == 0.0);
+    assert_true(strstr(buf, "# TYPE rsyncme_worker_queue_n gauge\nrsyncme_worker_queue_n{idx=\"0\"} ") != NULL);
+    assert_true(strstr(buf, "\n# TYPE rsyncme_worker_steals_n counter\n") != NULL);
+    assert_true(strstr(buf, "# TYPE rsyncme_exec_thread_steps_n counter\nrsyncme_exec_thread_steps_n{idx=\"0\"} ") != NULL);
+    RM_LOG_INFO("%s", "PASSED test #1 (text metrics in Prometheus exposition format)");
+}
+
+void
+test_rm_metrics_2(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    char                    buf[RM_TEST_14_REPLY_MAX];
+    ssize_t                 len = 0;
+    double                  scrapes_n = 0.0, v = 0.0;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    len = test_rm_14_scrape(rm_state->sock, "json\n", buf, sizeof(buf));
+    assert_true(len > 2);
+    assert_true(buf[0] == '{');
+    assert_true(buf[len - 2] == '}' && buf[len - 1] == '\n');
+    assert_true(strchr(buf, '\n') == buf + len - 1);
+    assert_true(strstr(buf, "\"sessions_started_n\":") != NULL);
+    assert_true(strstr(buf, "\"workers\":[{\"queue_n\":") != NULL);
+    assert_true(strstr(buf, "\"exec_threads\":[{\"tasks_n\":") != NULL);
+    assert_true(strstr(buf, "\"sessions\":[]") != NULL);
+    assert_true(strstr(buf, "\"sessions_n\":0}") != NULL);
+    assert_true(strstr(buf, "collisions") == NULL);
+
+    assert_true(test_rm_14_scrape(rm_state->sock, NULL, buf, sizeof(buf)) > 0);      /* just EOF */
+    assert_int_equal(strncmp(buf, "# TYPE rsyncme_", 15), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_scrapes_n", &scrapes_n), 0);
+    assert_true(test_rm_14_scrape(rm_state->sock, "text\n", buf, sizeof(buf)) > 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_scrapes_n", &v), 0);
+    assert_true(v == scrapes_n + 1);
+    RM_LOG_INFO("%s", "PASSED test #2 (JSON metrics, default format)");
+}
+
+void
+test_rm_metrics_3(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    char                    buf[RM_TEST_14_REPLY_MAX];
+    char                    cmd[RM_TEST_14_CMD_LEN_MAX];
+    double                  started_n = 0.0, ended_n = 0.0, by_ref = 0.0, by_raw = 0.0, v = 0.0;
+    int                     status = -1;
+    FILE                    *f_x = NULL, *f_z = NULL;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_true(test_rm_14_scrape(rm_state->sock, "text\n", buf, sizeof(buf)) > 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_started_n", &started_n), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_ended_n", &ended_n), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_rec_by_ref", &by_ref), 0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_rec_by_raw", &by_raw), 0);
+
+    snprintf(cmd, sizeof(cmd), "./rsyncme push -x %s/%s -i 127.0.0.1 -y %s/%s -z %s/%s --leave > /dev/null 2>&1",
+            rm_state->dir, RM_TEST_14_F_X, rm_state->dir, RM_TEST_14_F_Y, rm_state->dir, RM_TEST_14_F_Z);  /* execute built image of rsyncme from debug/release build folder and not from system global path */
+    status = system(cmd);
+    assert_true(status != -1 && WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+
+    test_rm_14_wait_value(rm_state->sock, buf, sizeof(buf), "rsyncme_sessions_ended_n", ended_n + 1);     /* client may be done before daemon finalizes @z and counts the session */
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_ended_n", &v), 0);
+    assert_true(v == ended_n + 1);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_started_n", &v), 0);
+    assert_true(v == started_n + 1);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_rec_by_ref", &v), 0);
+    assert_true(v == by_ref + RM_TEST_14_X_SZ);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_rec_by_raw", &v), 0);
+    assert_true(v == by_raw);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_delta_raw_n", &v), 0);
+    assert_true(v == 0.0);
+    assert_int_equal(test_rm_14_value(buf, "rsyncme_sessions_n", &v), 0);
+    assert_true(v == 0.0);
+    f_x = fopen(RM_TEST_14_F_X, "rb");
+    f_z = fopen(RM_TEST_14_F_Z, "rb");
+    assert_true(f_x != NULL && f_z != NULL);
+    assert_int_equal(rm_file_cmp(f_x, f_z, 0, 0, RM_TEST_14_X_SZ), RM_ERR_OK);
+    fclose(f_x);
+    fclose(f_z);
+    RM_LOG_INFO("%s", "PASSED test #3 (counters after push)");
+}
@@ -0,0 +1,360 @@
+/* @file        test_rm15.c
+ * @brief       Test suite #15.
+ * @details     Tests of write-combining output of result file.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright   LGPLv2.1 */
+
+
+#include "test_rm15.h"
+
+
+enum rm_loglevel RM_LOGLEVEL = RM_LOGLEVEL_NORMAL;
+
+struct test_rm_state	rm_state;	/* global tests state */
+
+int RM_TEST_MOCK_PWRITE     = RM_TEST_PWRITE_REAL;
+int RM_TEST_MOCK_FALLOCATE  = 0;
+
+int test_rm_setup(void **state)
+{
+    int         err = -1;
+    size_t      i = 0;
+
+#ifdef DEBUG
+    err = rm_util_chdir_umask_openlog("../build/debug", 1, "rsyncme_test_15", 1);
+#else
+    err = rm_util_chdir_umask_openlog("../build/release", 1, "rsyncme_test_15", 1);
+#endif
+    if (err != RM_ERR_OK) {
+        exit(EXIT_FAILURE);
+    }
+    *state = &rm_state;
+    memset(&rm_state, 0, sizeof(rm_state));
+    rm_state.x = malloc(RM_TEST_15_X_SZ);
+    if (rm_state.x == NULL) {
+        RM_LOG_ERR("%s", "Can't allocate memory for @x");
+        exit(EXIT_FAILURE);
+    }
+    srand(time(NULL));
+    for (i = 0; i < RM_TEST_15_X_SZ; ++i) {
+        rm_state.x[i] = rand() % 256;
+    }
+    rm_state.fd_x = open(RM_TEST_15_F_X, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (rm_state.fd_x < 0 || rm_tcp_write(rm_state.fd_x, rm_state.x, RM_TEST_15_X_SZ) != RM_ERR_OK) {
+        RM_LOG_PERR("Can't write file [%s]", RM_TEST_15_F_X);
+        exit(EXIT_FAILURE);
+    }
+    return 0;
+}
+
+int test_rm_teardown(void **state)
+{
+    struct  test_rm_state *rm_state;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    free(rm_state->x);
+    close(rm_state->fd_x);
+    if (RM_TEST_15_DELETE_FILES == 1) {
+        unlink(RM_TEST_15_F_X);
+        unlink(RM_TEST_15_F_Z);
+    }
+    return 0;
+}
+
+/* @brief   Record call and do what RM_TEST_MOCK_PWRITE says. */
+static ssize_t
+test_rm_15_pwrite(int fd, const void *buf, size_t count, off64_t offset, ssize_t (*real)(int, const void*, size_t, off64_t)) {
+    struct test_rm_pwrite   *w = NULL;
+    uint8_t                 direct = (rm_state.z != NULL && rm_state.z->direct);
+    ssize_t                 ret = -1;
+
+    if (rm_state.z == NULL || fd != rm_state.z->fd) {
+        return real(fd, buf, count, offset);
+    }
+    if (RM_TEST_MOCK_PWRITE == RM_TEST_PWRITE_EINVAL_DIRECT && direct) {
+        errno = EINVAL;
+    } else if (RM_TEST_MOCK_PWRITE == RM_TEST_PWRITE_SHORT_ONCE && count > RM_ZOUT_ALIGN) {
+        RM_TEST_MOCK_PWRITE = RM_TEST_PWRITE_REAL;
+        ret = real(fd, buf, RM_ZOUT_ALIGN, offset);
+    } else if (RM_TEST_MOCK_PWRITE == RM_TEST_PWRITE_EIO) {
+        errno = EIO;
+    } else {
+        ret = real(fd, buf, count, offset);
+    }
+    if (rm_state.writes_n < RM_TEST_15_WRITES_MAX) {
+        w = &rm_state.writes[rm_state.writes_n++];
+        w->offset = offset;
+        w->bytes_n = count;
+        w->direct = direct;
+        w->ret = ret;
+    }
+    return ret;
+}
+
+static ssize_t
+test_rm_15_real_pwrite(int fd, const void *buf, size_t count, off64_t offset) {
+    return __real_pwrite(fd, buf, count, offset);
+}
+
+static ssize_t
+test_rm_15_real_pwrite64(int fd, const void *buf, size_t count, off64_t offset) {
+    return __real_pwrite64(fd, buf, count, offset);
+}
+
+ssize_t
+__wrap_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    return test_rm_15_pwrite(fd, buf, count, offset, test_rm_15_real_pwrite);
+}
+
+ssize_t
+__wrap_pwrite64(int fd, const void *buf, size_t count, off64_t offset) {
+    return test_rm_15_pwrite(fd, buf, count, offset, test_rm_15_real_pwrite64);
+}
+
+int
+__wrap_fallocate(int fd, int mode, off_t offset, off_t len) {
+    if (RM_TEST_MOCK_FALLOCATE == 0) {
+        return __real_fallocate(fd, mode, offset, len);
+    }
+    errno = mock_type(int);
+    return -1;
+}
+
+int
+__wrap_fallocate64(int fd, int mode, off64_t offset, off64_t len) {
+    if (RM_TEST_MOCK_FALLOCATE == 0) {
+        return __real_fallocate64(fd, mode, offset, len);
+    }
+    errno = mock_type(int);
+    return -1;
+}
+
+/* @brief   Open empty @z and start recording writes to it. */
+static int
+test_rm_15_open(struct test_rm_state *rm_state, struct rm_zout *z) {
+    int fd = open(RM_TEST_15_F_Z, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    assert_true(fd >= 0);
+    memset(z, 0, sizeof(*z));
+    z->fd = fd;
+    rm_state->z = z;
+    rm_state->writes_n = 0;
+    return fd;
+}
+
+/* @brief   Check @z holds exactly @bytes_n bytes of @expected. */
+static void
+test_rm_15_check(int fd, const unsigned char *expected, size_t bytes_n) {
+    struct stat     st;
+    unsigned char   *buf = NULL;
+    size_t          read_n = 0;
+    ssize_t         n = 0;
+
+    assert_int_equal(fstat(fd, &st), 0);
+    assert_int_equal(st.st_size, bytes_n);
+    buf = malloc(bytes_n + 1);
+    assert_true(buf != NULL);
+    while (read_n < bytes_n) {
+        n = pread(fd, buf + read_n, bytes_n - read_n, read_n);
+        assert_true(n > 0);
+        read_n += n;
+    }
+    assert_memory_equal(buf, expected, bytes_n);
+    free(buf);
+}
+
+/* @brief   Check recorded write @idx. */
+static void
+test_rm_15_check_write(const struct test_rm_state *rm_state, size_t idx, uint64_t offset, size_t bytes_n, uint8_t direct, ssize_t ret) {
+    const struct test_rm_pwrite *w = &rm_state->writes[idx];
+
+    assert_true(idx < rm_state->writes_n);
+    assert_int_equal(w->offset, offset);
+    assert_int_equal(w->bytes_n, bytes_n);
+    assert_int_equal(w->direct, direct);
+    assert_int_equal(w->ret, ret);
+}
+
+/* @brief   Stop recording writes to @z and close it. */
+static void
+test_rm_15_close(struct test_rm_state *rm_state, struct rm_zout *z) {
+    close(z->fd);
+    rm_zout_free(z);
+    rm_state->z = NULL;
+    RM_TEST_MOCK_PWRITE = RM_TEST_PWRITE_REAL;
+}
+
+void
+test_rm_zout_1(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    struct rm_zout          z;
+    unsigned char           *expected = NULL;
+    unsigned char           digest[16], digest_copied[16];
+    MD5_CTX                 md5;
+    int                     fd = -1;
+    size_t                  i = 0;
+    struct {
+        uint64_t    offset;
+        size_t      bytes_n;
+        uint8_t     copy;       /* with rm_zout_copy from @x file, else rm_zout_write */
+    } runs[] = {
+        { 0, 3000, 0 },
+        { 10000, RM_ZOUT_BUF_LEN + 7000, 0 },   /* fills buffer */
+        { 4000, 5000, 0 },                      /* back */
+        { 3000, 1000, 1 },                      /* back again, fills gap */
+        { RM_TEST_15_X_SZ - 100, 100, 1 }       /* forward, leaves gap */
+    };
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    expected = calloc(RM_TEST_15_X_SZ, 1);
+    assert_true(expected != NULL);
+    fd = test_rm_15_open(rm_state, &z);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 0), RM_ERR_OK);
+    for (i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i) {
+        if (runs[i].copy) {
+            md5_init(&md5);
+            assert_int_equal(rm_zout_copy(&z, rm_state->fd_x, runs[i].offset, runs[i].offset, runs[i].bytes_n, &md5), RM_ERR_OK);
+            md5_final(&md5, digest_copied);
+            rm_md5(rm_state->x + runs[i].offset, runs[i].bytes_n, digest);
+            assert_memory_equal(digest, digest_copied, 16);
+        } else {
+            assert_int_equal(rm_zout_write(&z, runs[i].offset, rm_state->x + runs[i].offset, runs[i].bytes_n), RM_ERR_OK);
+        }
+        memcpy(expected + runs[i].offset, rm_state->x + runs[i].offset, runs[i].bytes_n);
+    }
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+
+    assert_int_equal(rm_state->writes_n, 6);                                            /* write per run, longer run is split at full buffer */
+    test_rm_15_check_write(rm_state, 0, 0, 3000, 0, 3000);
+    test_rm_15_check_write(rm_state, 1, 10000, RM_ZOUT_BUF_LEN, 0, RM_ZOUT_BUF_LEN);
+    test_rm_15_check_write(rm_state, 2, 10000 + RM_ZOUT_BUF_LEN, 7000, 0, 7000);
+    test_rm_15_check_write(rm_state, 3, 4000, 5000, 0, 5000);
+    test_rm_15_check_write(rm_state, 4, 3000, 1000, 0, 1000);
+    test_rm_15_check_write(rm_state, 5, RM_TEST_15_X_SZ - 100, 100, 0, 100);
+    test_rm_15_check(fd, expected, RM_TEST_15_X_SZ);
+    test_rm_15_close(rm_state, &z);
+    free(expected);
+    RM_LOG_INFO("%s", "PASSED test #1 (non-contiguous offsets)");
+}
+
+void
+test_rm_zout_2(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    struct rm_zout          z;
+    unsigned char           *dst = NULL;
+    size_t                  dst_n = 0, off = 0, n = 0;
+    int                     fd = -1;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    fd = test_rm_15_open(rm_state, &z);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 1), RM_ERR_OK);
+    z.direct = 1;                                                                       /* also if filesystem has no O_DIRECT, path depends on the flag only */
+    for (off = 0; off < RM_TEST_15_X_SZ; off += n) {                                    /* in pieces of odd length */
+        assert_int_equal(rm_zout_reserve(&z, off, &dst, &dst_n), RM_ERR_OK);
+        n = rm_min(rm_min(dst_n, 777u), RM_TEST_15_X_SZ - off);
+        memcpy(dst, rm_state->x + off, n);
+        rm_zout_commit(&z, n);
+    }
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+
+    assert_int_equal(rm_state->writes_n, 3);
+    test_rm_15_check_write(rm_state, 0, 0, RM_ZOUT_BUF_LEN, 1, RM_ZOUT_BUF_LEN);
+    test_rm_15_check_write(rm_state, 1, RM_ZOUT_BUF_LEN, RM_ZOUT_BUF_LEN, 1, RM_ZOUT_BUF_LEN);
+    test_rm_15_check_write(rm_state, 2, 2 * RM_ZOUT_BUF_LEN, 5000, 0, 5000);           /* tail */
+    assert_int_equal(z.direct, 0);
+    test_rm_15_check(fd, rm_state->x, RM_TEST_15_X_SZ);
+    test_rm_15_close(rm_state, &z);
+    RM_LOG_INFO("%s", "PASSED test #2 (O_DIRECT, unaligned tail)");
+}
+
+void
+test_rm_zout_3(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    struct rm_zout          z;
+    int                     fd = -1;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    fd = test_rm_15_open(rm_state, &z);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 1), RM_ERR_OK);
+    z.direct = 1;
+    RM_TEST_MOCK_PWRITE = RM_TEST_PWRITE_EINVAL_DIRECT;
+    assert_int_equal(rm_zout_write(&z, 0, rm_state->x, RM_ZOUT_BUF_LEN + RM_ZOUT_ALIGN), RM_ERR_OK);
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+
+    assert_int_equal(rm_state->writes_n, 3);
+    test_rm_15_check_write(rm_state, 0, 0, RM_ZOUT_BUF_LEN, 1, -1);                     /* refused */
+    test_rm_15_check_write(rm_state, 1, 0, RM_ZOUT_BUF_LEN, 0, RM_ZOUT_BUF_LEN);        /* same chunk again, buffered */
+    test_rm_15_check_write(rm_state, 2, RM_ZOUT_BUF_LEN, RM_ZOUT_ALIGN, 0, RM_ZOUT_ALIGN);  /* aligned, but O_DIRECT stays off */
+    assert_int_equal(z.direct, 0);
+    test_rm_15_check(fd, rm_state->x, RM_ZOUT_BUF_LEN + RM_ZOUT_ALIGN);
+    test_rm_15_close(rm_state, &z);
+    RM_LOG_INFO("%s", "PASSED test #3 (O_DIRECT, EINVAL)");
+}
+
+void
+test_rm_zout_4(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    struct rm_zout          z;
+    int                     fd = -1;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    fd = test_rm_15_open(rm_state, &z);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 1), RM_ERR_OK);
+    z.direct = 1;
+    RM_TEST_MOCK_PWRITE = RM_TEST_PWRITE_SHORT_ONCE;
+    assert_int_equal(rm_zout_write(&z, 0, rm_state->x, 2 * RM_ZOUT_BUF_LEN), RM_ERR_OK);
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+
+    assert_int_equal(rm_state->writes_n, 3);
+    test_rm_15_check_write(rm_state, 0, 0, RM_ZOUT_BUF_LEN, 1, RM_ZOUT_ALIGN);                          /* short */
+    test_rm_15_check_write(rm_state, 1, RM_ZOUT_ALIGN, RM_ZOUT_BUF_LEN - RM_ZOUT_ALIGN, 0, RM_ZOUT_BUF_LEN - RM_ZOUT_ALIGN); /* rest */
+    test_rm_15_check_write(rm_state, 2, RM_ZOUT_BUF_LEN, RM_ZOUT_BUF_LEN, 0, RM_ZOUT_BUF_LEN);
+    assert_int_equal(z.direct, 0);
+    test_rm_15_check(fd, rm_state->x, 2 * RM_ZOUT_BUF_LEN);
+
+    RM_TEST_MOCK_PWRITE = RM_TEST_PWRITE_EIO;
+    assert_int_equal(rm_zout_write(&z, 2 * RM_ZOUT_BUF_LEN, rm_state->x, 100), RM_ERR_OK);  /* gathered only */
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_WRITE);
+    test_rm_15_close(rm_state, &z);
+    RM_LOG_INFO("%s", "PASSED test #4 (O_DIRECT, short write)");
+}
+
+void
+test_rm_zout_5(void **state) {
+    struct test_rm_state    *rm_state = NULL;
+    struct rm_zout          z;
+    struct stat             st;
+    int                     fd = -1;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    fd = test_rm_15_open(rm_state, &z);
+    RM_TEST_MOCK_FALLOCATE = 1;
+    will_return(__wrap_fallocate, ENOSPC);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 0), RM_ERR_WRITE);
+    assert_true(z.buf == NULL);
+    will_return(__wrap_fallocate, EOPNOTSUPP);                                          /* ignored */
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 0), RM_ERR_OK);
+    RM_TEST_MOCK_FALLOCATE = 0;
+    assert_int_equal(rm_zout_write(&z, 0, rm_state->x, 5000), RM_ERR_OK);
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+    test_rm_15_check(fd, rm_state->x, 5000);
+    test_rm_15_close(rm_state, &z);
+
+    fd = test_rm_15_open(rm_state, &z);
+    assert_int_equal(rm_zout_init(&z, fd, RM_TEST_15_X_SZ, 0), RM_ERR_OK);             /* reserved, if filesystem can */
+    assert_int_equal(fstat(fd, &st), 0);
+    assert_int_equal(st.st_size, 0);                                                    /* FALLOC_FL_KEEP_SIZE */
+    assert_int_equal(rm_zout_write(&z, 0, rm_state->x, 5000), RM_ERR_OK);
+    assert_int_equal(rm_zout_flush(&z), RM_ERR_OK);
+    test_rm_15_check(fd, rm_state->x, 5000);
+    test_rm_15_close(rm_state, &z);
+    RM_LOG_INFO("%s", "PASSED test #5 (fallocate, ENOSPC)");
+}
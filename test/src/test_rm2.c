@@ -1,6 +1,7 @@
 /* @file        test_rm2.c
  * @brief       Test suite #2.
- * @details     Test of nonoverlapping checksums error reporting.
+ * @details     Test of nonoverlapping checksums error reporting
+ *              and of checksums spilled to disk.
  * @author      Piotr Gregor <piotrek.gregor at gmail.com>
  * @version     0.1.2
  * @date        10 Jan 2016 04:13 PM
@@ -201,7 +202,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_2(void **state)
             RM_LOG_INFO("Mocking fstat64, expectation [%d]", res_expected);
             RM_TEST_MOCK_FSTAT64 = 1;
             will_return(__wrap_fstat64, -1);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, 0, NULL, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, 0, NULL, NULL);
             assert_int_equal(res, res_expected);
             RM_TEST_MOCK_FSTAT64 = 0;
 
@@ -269,7 +270,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_3(void **state)
             RM_LOG_INFO("Mocking first call to malloc, expectation [%d]", res_expected);
             RM_TEST_MOCK_MALLOC = 1;
             will_return(__wrap_malloc, NULL);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, 0, NULL, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, 0, NULL, NULL);
             assert_int_equal(res, res_expected);
             RM_TEST_MOCK_MALLOC = 0;
 
@@ -337,7 +338,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_4(void **state)
             RM_LOG_INFO("Mocking fread, expectation [%d]", res_expected);
             RM_TEST_MOCK_FREAD = 1;
             will_return(__wrap_fread, file_sz);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, 0, NULL, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, 0, NULL, NULL);
             assert_int_equal(res, res_expected);
             RM_TEST_MOCK_FREAD = 0;
 
@@ -412,7 +413,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_5(void **state)
             RM_TEST_MOCK_MALLOC = 1;
             will_return(__wrap_malloc, buf_mocked);
             will_return(__wrap_malloc, NULL);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, 1, NULL, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, 1, NULL, NULL);
             assert_int_equal(res, res_expected);
             RM_TEST_MOCK_MALLOC = 0;
             /* no need to free(buf_mocked) - it has been freed by rm_rx_insert_nonoverlapping */
@@ -488,7 +489,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_6(void **state)
 
             RM_LOG_INFO("Testing error reporting: file [%s], size [%zu], block size L [%zu], buffer [%zu]", fname, file_sz, L, RM_TEST_L_MAX);
             RM_LOG_INFO("Mocking fread, expectation [%d]", res_expected);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, f_tx_ch_ch_ref, 0, NULL, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, f_tx_ch_ch_ref, 0, NULL, NULL);
             assert_int_equal(res, res_expected);
 
             bkt = 0;
@@ -503,3 +504,174 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_6(void **state)
         fclose(f);
     }
 }
+
+static int
+test_rm_ch_ch_ref_cmp(const void *a, const void *b) {
+    const struct rm_ch_ch_ref   *x = a, *y = b;
+    int                         res;
+
+    res = memcmp(x->ch_ch.s_ch.data, y->ch_ch.s_ch.data, RM_STRONG_CHECK_BYTES);
+    if (res != 0) {
+        return res;
+    }
+    return (x->ref > y->ref) - (x->ref < y->ref);
+}
+
+void
+test_rm_spill_1(void **state) {
+    struct rm_spill         sp;
+    struct rm_ch_ch_ref     ref, *exp;
+    struct rm_ch_ch_ref_hlink   *e;
+    const struct rm_ch_ch_ref   *hits;
+    struct twhlist_node     *tmp;
+    unsigned int            bkt;
+    size_t                  i, j, hits_n, exp_n, exp_max = 0, found_n = 0, queries_n = 0;
+    uint32_t                f_ch, f_ch_max;
+
+    TWDEFINE_HASHTABLE(h, RM_NONOVERLAPPING_HASH_BITS);
+    twhash_init(h);
+    (void) state;
+
+    assert_int_equal(rm_spill_init(&sp, RM_SPILL_MEM_MIN), RM_ERR_OK);
+    for (i = 0; i < RM_TEST_2_SPILL_N; ++i) {
+        memset(&ref, 0, sizeof(ref));
+        if (i % 50 == 0) {                          /* one fast checksum spans many pages */
+            ref.ch_ch.f_ch = 2 * 7777;
+            ref.ch_ch.s_ch.data[4] = i % 700;
+            ref.ch_ch.s_ch.data[5] = (i % 700) >> 8;
+        } else {                                    /* few blocks with same content */
+            ref.ch_ch.f_ch = 2 * (rand() % RM_TEST_2_SPILL_F_CH_N);
+            ref.ch_ch.s_ch.data[4] = rand() % 3;
+        }
+        memcpy(ref.ch_ch.s_ch.data, &ref.ch_ch.f_ch, sizeof(ref.ch_ch.f_ch));
+        ref.ch_ch.c_ch = i;
+        ref.ref = i;
+        assert_int_equal(rm_spill_add(&sp, &ref), RM_ERR_OK);
+        e = malloc(sizeof(*e));
+        assert_true(e != NULL);
+        e->data = ref;
+        TWINIT_HLIST_NODE(&e->hlink);
+        twhash_add_bits(h, &e->hlink, ref.ch_ch.f_ch, RM_NONOVERLAPPING_HASH_BITS);
+    }
+    assert_int_equal(rm_spill_finish(&sp), RM_ERR_OK);
+    assert_true(sp.stats.runs_n > 1);
+    assert_int_equal(sp.stats.entries_n, RM_TEST_2_SPILL_N);
+
+    exp = NULL;
+    f_ch_max = 2 * RM_TEST_2_SPILL_F_CH_N + 1000;
+    for (f_ch = 0; f_ch < f_ch_max; ++f_ch) {       /* odd ones and those past the range are not there */
+        exp_n = 0;
+        twhlist_for_each_entry(e, &h[twhash_min(f_ch, RM_NONOVERLAPPING_HASH_BITS)], hlink) {
+            if (e->data.ch_ch.f_ch != f_ch) {
+                continue;
+            }
+            if (exp_n == exp_max) {
+                exp_max = rm_max((size_t) 64, 2 * exp_max);
+                exp = realloc(exp, exp_max * sizeof(*exp));
+                assert_true(exp != NULL);
+            }
+            exp[exp_n++] = e->data;
+        }
+        if (exp_n > 0) {                            /* hashtable candidates, one per strong checksum (lowest block) */
+            qsort(exp, exp_n, sizeof(*exp), test_rm_ch_ch_ref_cmp);
+            for (i = 1, j = 1; i < exp_n; ++i) {
+                if (memcmp(exp[i].ch_ch.s_ch.data, exp[j - 1].ch_ch.s_ch.data, RM_STRONG_CHECK_BYTES) != 0) {
+                    exp[j++] = exp[i];
+                }
+            }
+            exp_n = j;
+        }
+        assert_int_equal(rm_spill_find(&sp, f_ch, &hits, &hits_n), RM_ERR_OK);
+        ++queries_n;
+        assert_int_equal(hits_n, exp_n);
+        for (i = 0; i < hits_n; ++i) {
+            assert_int_equal(hits[i].ch_ch.f_ch, f_ch);
+            assert_memory_equal(hits[i].ch_ch.s_ch.data, exp[i].ch_ch.s_ch.data, RM_STRONG_CHECK_BYTES);
+            assert_int_equal(hits[i].ch_ch.c_ch, exp[i].ch_ch.c_ch);
+            assert_int_equal(hits[i].ref, exp[i].ref);
+        }
+        found_n += (hits_n > 0);
+    }
+    assert_true(sp.stats.probes_n < queries_n);     /* filter rejected some fast checksums */
+    assert_true(found_n > 0 && found_n < queries_n);
+
+    RM_LOG_INFO("PASSED test of spill of checksums: runs [%zu], queries [%zu], found [%zu], filter passed [%" PRIu64 "], false [%" PRIu64 "]",
+            sp.stats.runs_n, queries_n, found_n, sp.stats.probes_n, sp.stats.false_n);
+    free(exp);
+    rm_spill_free(&sp);
+    twhash_for_each_safe(h, bkt, tmp, e, hlink) {
+        twhash_del((struct twhlist_node*)&e->hlink);
+        free(e);
+    }
+}
+
+void
+test_rm_spill_2(void **state) {
+    enum rm_error           status;
+    FILE                    *f;
+    unsigned char           *x, *y, *z;
+    size_t                  i, k, y_sz = RM_TEST_2_SPILL_L * RM_TEST_2_SPILL_BLOCKS_N, x_sz = y_sz + RM_TEST_2_SPILL_INS;
+    struct rm_delta_reconstruct_ctx rec_ctx, rec_ctx_mem;
+    struct rm_tx_options    opt = { .loglevel = RM_LOGLEVEL_NORMAL };
+
+    (void) state;
+    assert_true(rm_rx_ch_ch_hash_bytes(RM_TEST_2_SPILL_BLOCKS_N) > RM_SPILL_MEM_MIN);
+    x = malloc(x_sz);
+    y = malloc(y_sz);
+    z = malloc(x_sz);
+    assert_true(x != NULL && y != NULL && z != NULL);
+    for (i = 0; i < y_sz; ++i) {
+        y[i] = rand() % 256;
+    }
+    k = RM_TEST_2_SPILL_L * (RM_TEST_2_SPILL_BLOCKS_N / 3);
+    memcpy(x, y, k);
+    for (i = 0; i < RM_TEST_2_SPILL_INS; ++i) {     /* rolled over, fast checksums of them are not in @y */
+        x[k + i] = rand() % 256;
+    }
+    memcpy(x + k + RM_TEST_2_SPILL_INS, y + k, y_sz - k);
+    f = fopen(RM_TEST_2_SPILL_F_X, "wb");
+    assert_true(f != NULL && fwrite(x, 1, x_sz, f) == x_sz);
+    fclose(f);
+    f = fopen(RM_TEST_2_SPILL_F_Y, "wb");
+    assert_true(f != NULL && fwrite(y, 1, y_sz, f) == y_sz);
+    fclose(f);
+
+    memset(&rec_ctx_mem, 0, sizeof(rec_ctx_mem));   /* no limit, hashtable */
+    opt.mem_bytes = 0;
+    status = rm_tx_local_push(RM_TEST_2_SPILL_F_X, RM_TEST_2_SPILL_F_Y, RM_TEST_2_SPILL_F_Z, RM_TEST_2_SPILL_L, 0, 0, RM_TEST_2_SPILL_L, RM_BIT_6, &rec_ctx_mem, &opt);
+    assert_int_equal(status, RM_ERR_OK);
+    assert_int_equal(rec_ctx_mem.spill_stats.entries_n, 0);
+
+    memset(&rec_ctx, 0, sizeof(rec_ctx));           /* hashtable wouldn't fit, spill */
+    opt.mem_bytes = RM_SPILL_MEM_MIN;
+    status = rm_tx_local_push(RM_TEST_2_SPILL_F_X, RM_TEST_2_SPILL_F_Y, RM_TEST_2_SPILL_F_Z, RM_TEST_2_SPILL_L, 0, 0, RM_TEST_2_SPILL_L, RM_BIT_6, &rec_ctx, &opt);
+    assert_int_equal(status, RM_ERR_OK);
+    assert_int_equal(rec_ctx.spill_stats.entries_n, RM_TEST_2_SPILL_BLOCKS_N);
+    assert_true(rec_ctx.spill_stats.runs_n > 1);
+    assert_true(rec_ctx.spill_stats.filter_bytes > 0 && rec_ctx.spill_stats.filter_k > 0);
+    assert_true(rec_ctx.spill_stats.probes_n > 0);
+    assert_true(rec_ctx.spill_stats.probes_n < rec_ctx.delta_ref_n + RM_TEST_2_SPILL_INS / 2);  /* matched blocks and few of offsets rolled over inserted bytes */
+    assert_true(rec_ctx.spill_stats.false_n <= rec_ctx.spill_stats.probes_n);
+    assert_true(rec_ctx.spill_stats.reads_n > 0);
+
+    assert_int_equal(rec_ctx.delta_ref_n, rec_ctx_mem.delta_ref_n);
+    assert_int_equal(rec_ctx.delta_raw_n, rec_ctx_mem.delta_raw_n);
+    assert_int_equal(rec_ctx.rec_by_ref, rec_ctx_mem.rec_by_ref);
+    assert_int_equal(rec_ctx.rec_by_raw, rec_ctx_mem.rec_by_raw);
+    assert_true(rec_ctx.rec_by_ref >= y_sz - 2 * RM_TEST_2_SPILL_L);
+    f = fopen(RM_TEST_2_SPILL_F_Z, "rb");
+    assert_true(f != NULL && fread(z, 1, x_sz, f) == x_sz);
+    fclose(f);
+    assert_memory_equal(x, z, x_sz);
+
+    if (RM_TEST_DELETE_FILES == 1) {
+        unlink(RM_TEST_2_SPILL_F_X);
+        unlink(RM_TEST_2_SPILL_F_Y);
+        unlink(RM_TEST_2_SPILL_F_Z);
+    }
+    RM_LOG_INFO("PASSED test of local push with checksums spilled to disk: runs [%zu], filter [%zu] bytes, passed [%" PRIu64 "], false [%" PRIu64 "], pages read [%" PRIu64 "]",
+            rec_ctx.spill_stats.runs_n, rec_ctx.spill_stats.filter_bytes, rec_ctx.spill_stats.probes_n, rec_ctx.spill_stats.false_n, rec_ctx.spill_stats.reads_n);
+    free(x);
+    free(y);
+    free(z);
+}
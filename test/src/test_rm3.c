@@ -1,7 +1,8 @@
 /* @file        test_rm3.c
  * @brief       Test suite #3.
  * @details     Test of ref_link nonoverlapping
- *              checksums calculation correctness.
+ *              checksums calculation correctness
+ *              and of checksum kernels.
  * @author      Piotr Gregor <piotrek.gregor at gmail.com>
  * @version     0.1.2
  * @date        6 Mar 2016 11:29 PM
@@ -77,6 +78,16 @@ test_rm_setup(void **state) {
     }
     assert_true(buf != NULL && "Can't allocate buffer");
     rm_state.buf = buf;
+
+    rm_state.x_sz = RM_TEST_3_X_SZ;
+    rm_state.x = malloc(rm_state.x_sz);
+    if (rm_state.x == NULL) {
+        RM_LOG_ERR("Can't allocate memory for random buffer of [%zu] bytes, malloc failed", rm_state.x_sz);
+    }
+    assert_true(rm_state.x != NULL && "Can't allocate buffer");
+    for (i = 0; i < rm_state.x_sz; ++i) {
+        rm_state.x[i] = rand();
+    }
     return 0;
 }
 
@@ -102,6 +113,7 @@ test_rm_teardown(void **state) {
         }
     }
     free(rm_state->buf);
+    free(rm_state->x);
     return 0;
 }
 
@@ -262,3 +274,61 @@ test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_2(void **state) {
         fclose(f);
     }
 }
+
+void
+test_rm_crc32c_1(void **state) {
+    struct test_rm_state    *rm_state;
+    const unsigned char     check[9] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    size_t                  i, off, len;
+    uint32_t                crc;
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    assert_int_equal(rm_crc32c(0, check, sizeof(check)), 0xE3069283);
+    assert_int_equal(rm_crc32c_sw(0, check, sizeof(check)), 0xE3069283);
+    assert_int_equal(rm_crc32c(0, check, 0), 0);
+    assert_int_equal(rm_crc32c_sw(0, check, 0), 0);
+    for (i = 0; i <= sizeof(check); ++i) {          /* continued over split data */
+        assert_int_equal(rm_crc32c(rm_crc32c(0, check, i), check + i, sizeof(check) - i), 0xE3069283);
+        assert_int_equal(rm_crc32c_sw(rm_crc32c_sw(0, check, i), check + i, sizeof(check) - i), 0xE3069283);
+    }
+    for (i = 0; i < 1000; ++i) {                    /* unaligned, ragged lengths */
+        off = rand() % 64;
+        len = rand() % 5000;
+        crc = rand();
+        assert_int_equal(rm_crc32c(crc, rm_state->x + off, len), rm_crc32c_sw(crc, rm_state->x + off, len));
+    }
+    RM_LOG_INFO("%s", "PASSED test of CRC32C");
+}
+
+void
+test_rm_md5_lanes_1(void **state) {
+    struct test_rm_state    *rm_state;
+    const unsigned char     *data[RM_TEST_3_MD5_N];
+    size_t                  len[RM_TEST_3_MD5_N];
+    unsigned char           digests[RM_TEST_3_MD5_N][16], exp[16];
+    unsigned char           *res[RM_TEST_3_MD5_N];
+    size_t                  round, n, i;
+    const size_t            len_edge[8] = { 0, 1, 55, 56, 63, 64, 65, 119 };   /* around MD5 padding boundaries */
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    for (i = 0; i < RM_TEST_3_MD5_N; ++i) {
+        res[i] = digests[i];
+    }
+    for (round = 0; round < 20; ++round) {
+        for (n = 0; n <= RM_TEST_3_MD5_N; ++n) {
+            for (i = 0; i < n; ++i) {
+                len[i] = (rand() % 2 ? len_edge[rand() % 8] : (size_t) rand() % 3000);
+                data[i] = rm_state->x + rand() % (rm_state->x_sz - len[i]);
+            }
+            memset(digests, 0, sizeof(digests));
+            rm_md5_lanes(data, len, res, n);
+            for (i = 0; i < n; ++i) {
+                rm_md5(data[i], len[i], exp);
+                assert_memory_equal(digests[i], exp, 16);
+            }
+        }
+    }
+    RM_LOG_INFO("%s", "PASSED test of MD5 lanes");
+}
@@ -164,7 +164,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_1(void **state)
             RM_LOG_INFO("Testing of splitting file into non-overlapping blocks: file [%s], size [%zu], block size L [%zu], buffer"
                     " [%zu]", fname, file_sz, L, RM_TEST_L_MAX);
             blocks_n = file_sz / L + (file_sz % L ? 1 : 0); /* number of blocks */
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, blocks_n, &entries_n, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n, &entries_n, NULL);
             assert_int_equal(res, RM_ERR_OK);
             assert_int_equal(entries_n, blocks_n);
 
@@ -249,7 +249,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_2(void **state)
                     " [%zu]", fname, file_sz, L, RM_TEST_L_MAX);
             blocks_n = file_sz / L + (file_sz % L ? 1 : 0);
             f_tx_ch_ch_ref_2_callback_count = 0; /* reset callback counter */
-            rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, f_tx_ch_ch_ref_test_2, blocks_n, &entries_n, NULL);
+            rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, f_tx_ch_ch_ref_test_2, blocks_n, &entries_n, NULL);
             assert_int_equal(f_tx_ch_ch_ref_2_callback_count, blocks_n);
 
             blocks_n = 0;
@@ -325,7 +325,7 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_3(void **state)
             RM_LOG_INFO("Testing checksum correctness: file [%s], size [%zu], block size L [%zu], buffer"
                     " [%zu]", fname, file_sz, L, RM_TEST_L_MAX);
             blocks_n = file_sz / L + (file_sz % L ? 1 : 0);
-            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, L, NULL, blocks_n, &entries_n, NULL);
+            res = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f, fname, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n, &entries_n, NULL);
             assert_int_equal(res, RM_ERR_OK);
             assert_int_equal(entries_n, blocks_n);
             rewind(f);
@@ -423,3 +423,40 @@ void test_rm_rx_insert_nonoverlapping_ch_ch_ref_3(void **state)
     }
     return;
 }
+
+void
+test_rm_rx_ch_ch_hash_bits_1(void **state) {
+    uint64_t    blocks_n = 0, buckets_n = 0;
+    uint8_t     bits = 0, b = 0;
+    (void) state;
+
+    assert_int_equal(rm_rx_ch_ch_hash_bits(0), RM_NONOVERLAPPING_HASH_BITS_MIN);   /* small */
+    assert_int_equal(rm_rx_ch_ch_hash_bits(1), RM_NONOVERLAPPING_HASH_BITS_MIN);
+    blocks_n = ((uint64_t) 1 << RM_NONOVERLAPPING_HASH_BITS_MIN) * RM_NONOVERLAPPING_HASH_LOAD;
+    assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n), RM_NONOVERLAPPING_HASH_BITS_MIN);
+    assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n + 1), RM_NONOVERLAPPING_HASH_BITS_MIN + 1);
+
+    for (b = RM_NONOVERLAPPING_HASH_BITS_MIN + 1; b <= RM_NONOVERLAPPING_HASH_BITS_MAX; ++b) {    /* medium, each power of 2 and around it */
+        blocks_n = ((uint64_t) 1 << b) * RM_NONOVERLAPPING_HASH_LOAD;
+        assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n - 1), b);
+        assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n), b);
+        if (b < RM_NONOVERLAPPING_HASH_BITS_MAX) {
+            assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n + 1), b + 1);
+        }
+    }
+    for (blocks_n = 1; blocks_n < 10000000; blocks_n = blocks_n * 3 + 7) {              /* load is at most RM_NONOVERLAPPING_HASH_LOAD, with fewest buckets */
+        bits = rm_rx_ch_ch_hash_bits(blocks_n);
+        buckets_n = (uint64_t) 1 << bits;
+        assert_true(bits >= RM_NONOVERLAPPING_HASH_BITS_MIN && bits <= RM_NONOVERLAPPING_HASH_BITS_MAX);
+        assert_true(buckets_n * RM_NONOVERLAPPING_HASH_LOAD >= blocks_n);
+        assert_true(bits == RM_NONOVERLAPPING_HASH_BITS_MIN || (buckets_n / 2) * RM_NONOVERLAPPING_HASH_LOAD < blocks_n);
+        assert_true(rm_rx_ch_ch_hash_bytes(blocks_n) >= buckets_n * sizeof(struct twhlist_head));
+    }
+
+    blocks_n = ((uint64_t) 1 << RM_NONOVERLAPPING_HASH_BITS_MAX) * RM_NONOVERLAPPING_HASH_LOAD; /* huge, clamped */
+    assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n + 1), RM_NONOVERLAPPING_HASH_BITS_MAX);
+    assert_int_equal(rm_rx_ch_ch_hash_bits(blocks_n * 1000), RM_NONOVERLAPPING_HASH_BITS_MAX);
+    assert_int_equal(rm_rx_ch_ch_hash_bits(UINT64_MAX), RM_NONOVERLAPPING_HASH_BITS_MAX);
+    assert_int_equal(RM_NONOVERLAPPING_HASH_BITS_MAX, 28);
+    RM_LOG_INFO("%s", "PASSED test of hashtable sizing (small, medium, huge number of blocks)");
+}
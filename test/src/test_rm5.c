@@ -347,7 +347,10 @@ static enum rm_error rm_rolling_ch_proc_tx(struct rm_roll_proc_cb_arg  *cb_arg,
     delta_e->raw_bytes_n = raw_bytes_n;
     TWINIT_LIST_HEAD(&delta_e->link);
     cb_arg->delta_e = delta_e;                  /* tx, signal delta_rx_tid, etc */
-    delta_f(cb_arg);                            /* TX, enqueue delta */
+    if (delta_f(cb_arg) != RM_ERR_OK) {         /* TX, enqueue delta */
+        free(delta_e);                          /* not taken, raw bytes are still owned by caller */
+        return RM_ERR_TX;
+    }
 
     return RM_ERR_OK;
 }
@@ -471,7 +474,7 @@ void test_rm_rolling_ch_proc_1(void **state)
             } else {
                 blocks_n_exp = 0;
             }
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -491,7 +494,7 @@ void test_rm_rolling_ch_proc_1(void **state)
             prvt->h = h;
             s->f_x = f_x;                        /* run on same file */
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (file_sz == 0) {
                 assert_int_equal(err, RM_ERR_TOO_MUCH_REQUESTED);
                 continue;
@@ -729,7 +732,7 @@ void test_rm_rolling_ch_proc_2(void **state)
             RM_LOG_INFO("Testing #2 (first byte changed): file @x[%s] size [%zu] file @y[%s], size [%zu], block size L [%zu]", buf_x_name, f_x_sz, f_y_name, f_y_sz, L);
 
             blocks_n_exp = f_y_sz / L + (f_y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_x);
@@ -745,7 +748,7 @@ void test_rm_rolling_ch_proc_2(void **state)
             prvt->h = h;
             s->f_x = f_x;                        /* run on @x */
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
             assert_int_equal(err, RM_ERR_OK);
 
             q = &prvt->tx_delta_e_queue; /* verify s->prvt delta queue content */
@@ -989,7 +992,7 @@ void test_rm_rolling_ch_proc_3(void **state)
             RM_LOG_INFO("Testing #3 (last byte changed): file @x[%s] size [%zu] file @y[%s], size [%zu], block size L [%zu]", buf_x_name, f_x_sz, f_y_name, f_y_sz, L);
 
             blocks_n_exp = f_y_sz / L + (f_y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_x);
@@ -1005,7 +1008,7 @@ void test_rm_rolling_ch_proc_3(void **state)
             prvt->h = h;
             s->f_x = f_x;                        /* run on @x */
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
             assert_int_equal(err, RM_ERR_OK);
 
             q = &prvt->tx_delta_e_queue; /* verify s->prvt delta queue content */
@@ -1258,7 +1261,7 @@ void test_rm_rolling_ch_proc_4(void **state)
             RM_LOG_INFO("Testing #4 (2 bytes changed): file @x[%s] size [%zu] file @y[%s], size [%zu], block size L [%zu]", buf_x_name, f_x_sz, f_y_name, f_y_sz, L);
 
             blocks_n_exp = f_y_sz / L + (f_y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_x);
@@ -1275,7 +1278,7 @@ void test_rm_rolling_ch_proc_4(void **state)
             prvt->h = h;
             s->f_x = f_x;                        /* run on @x */
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
             assert_int_equal(err, RM_ERR_OK);
 
             q = &prvt->tx_delta_e_queue; /* verify s->prvt delta queue content */
@@ -1590,7 +1593,7 @@ void test_rm_rolling_ch_proc_5(void **state)
             RM_LOG_INFO("Testing #5 (3 bytes changed): file @x[%s] size [%zu] file @y[%s], size [%zu], block size L [%zu]", buf_x_name, f_x_sz, f_y_name, f_y_sz, L);
 
             blocks_n_exp = f_y_sz / L + (f_y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_x);
@@ -1607,7 +1610,7 @@ void test_rm_rolling_ch_proc_5(void **state)
             prvt->h = h;
             s->f_x = f_x;                        /* run on @x */
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
             assert_int_equal(err, RM_ERR_OK);
 
             q = &prvt->tx_delta_e_queue; /* verify s->prvt delta queue content */
@@ -1802,7 +1805,7 @@ void test_rm_rolling_ch_proc_6(void **state)
         RM_LOG_ERR("Can't open file [%s]!", rm_state->f.name);
         assert_true(1 == 0 && "Can't open @x file!");
     }
-    err = rm_rolling_ch_proc(s, h, NULL, f_x, rm_roll_proc_cb_1, 0); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, f_x, rm_roll_proc_cb_1, 0); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #6 (Test error reporting: NULL session)");
@@ -1831,7 +1834,7 @@ void test_rm_rolling_ch_proc_7(void **state)
     prvt->h = h;
     s->f_x = NULL;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #7 (Test error reporting: NULL file pointer)");
 }
@@ -1874,7 +1877,7 @@ void test_rm_rolling_ch_proc_8(void **state)
     assert_true(fs.st_size == 0);
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_TOO_MUCH_REQUESTED);
     RM_LOG_INFO("%s", "PASSED test #8 (Test error reporting: zero size file)");
@@ -1909,7 +1912,7 @@ void test_rm_rolling_ch_proc_9(void **state)
     }
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #9 (Test error reporting: L == 0, [and zero size file])");
@@ -1954,7 +1957,7 @@ void test_rm_rolling_ch_proc_10(void **state)
     assert_true(file_sz > 0);
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #10 (Test error reporting: L == 0, [and nonzero size file])");
@@ -1999,7 +2002,7 @@ void test_rm_rolling_ch_proc_11(void **state)
     assert_true(file_sz > 0);
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_TOO_MUCH_REQUESTED);
     RM_LOG_INFO("%s", "PASSED test #11 (Test error reporting: reading out of range on nonzero size file)");
@@ -2072,7 +2075,7 @@ test_rm_rolling_ch_proc_12(void **state) {
         } else {
             blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
         }
-        err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+        err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
         if (L == 0) {
             assert_int_equal(err, RM_ERR_BAD_CALL);
             continue;
@@ -2091,7 +2094,7 @@ test_rm_rolling_ch_proc_12(void **state) {
         prvt->h = h;
         s->f_x = f_x;
         prvt->delta_tx_f = rm_roll_proc_cb_1;
-        err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);
+        err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);
         if (x_sz == 0) {
             assert_int_equal(err, RM_ERR_TOO_MUCH_REQUESTED);
             continue;
@@ -2229,7 +2232,7 @@ void test_rm_rolling_ch_proc_13(void **state)
         } else {
             blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
         }
-        err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+        err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
         if (L == 0) {
             assert_int_equal(err, RM_ERR_BAD_CALL);
             continue;
@@ -2248,7 +2251,7 @@ void test_rm_rolling_ch_proc_13(void **state)
         prvt->h = h;
         s->f_x = f_x;
         prvt->delta_tx_f = rm_roll_proc_cb_1;
-        err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);
+        err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);
         if (x_sz == 0) {
             assert_int_equal(err, RM_ERR_TOO_MUCH_REQUESTED);
             continue;
@@ -2394,7 +2397,7 @@ void test_rm_rolling_ch_proc_14(void **state)
             } else {
                 blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
             }
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
             } else {
@@ -2413,7 +2416,7 @@ void test_rm_rolling_ch_proc_14(void **state)
             prvt->h = h;
             s->f_x = f_x;
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -2581,7 +2584,7 @@ void test_rm_rolling_ch_proc_15(void **state)
             } else {
                 blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0); /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
             }
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
             } else {
@@ -2600,7 +2603,7 @@ void test_rm_rolling_ch_proc_15(void **state)
             prvt->h = h;
             s->f_x = f_x;
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -2808,7 +2811,7 @@ void test_rm_rolling_ch_proc_16(void **state)
             }
             RM_LOG_INFO("Testing #16 (copy tail threshold #2): file [%s], size [%zu], @y size [%zu], block size L [%zu], threshold [%zu]", buf_x_name, f_x_sz, f_y_sz, L, threshold);
 
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
             } else {
@@ -2828,7 +2831,7 @@ void test_rm_rolling_ch_proc_16(void **state)
             prvt->h = h;
             s->f_x = f_x;
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -3050,7 +3053,7 @@ void test_rm_rolling_ch_proc_17(void **state)
             }
             RM_LOG_INFO("Testing #17 (copy tail threshold #3): file [%s], size [%zu], @y size [%zu], block size L [%zu], threshold [%zu]", buf_x_name, f_x_sz, f_y_sz, L, threshold);
 
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
             } else {
@@ -3070,7 +3073,7 @@ void test_rm_rolling_ch_proc_17(void **state)
             prvt->h = h;
             s->f_x = f_x;
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -3203,7 +3206,7 @@ test_rm_rolling_ch_proc_18(void **state) {
     }
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #18 (Test error reporting: send threshold == 0, [and zero size file])");
@@ -3248,7 +3251,7 @@ test_rm_rolling_ch_proc_19(void **state) {
     assert_true(file_sz > 0);
     s->f_x = f_x;                        /* run on @x */
     prvt->delta_tx_f = rm_roll_proc_cb_1;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, file_sz); /* run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #19 (Test error reporting: send threshold == 0, [and nonzero size file])");
@@ -3283,7 +3286,7 @@ test_rm_rolling_ch_proc_20(void **state) {
     }
     s->f_x = f_x;
     prvt->delta_tx_f = NULL;
-    err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
+    err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0); /* 1. run rolling checksum procedure */
     fclose(f_x);
     assert_int_equal(err, RM_ERR_BAD_CALL);
     RM_LOG_INFO("%s", "PASSED test #20 (Test error reporting: NULL delta function pointer)");
@@ -3350,7 +3353,7 @@ test_rm_rolling_ch_proc_21(void **state) {
             prvt->h = NULL;
             s->f_x = f_x;
             prvt->delta_tx_f = rm_roll_proc_cb_1;
-            err = rm_rolling_ch_proc(s, NULL, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
+            err = rm_rolling_ch_proc(s, NULL, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);    /* 1. run rolling checksum procedure */
             if (L == 0) {
                 assert_int_equal(err, RM_ERR_BAD_CALL);
                 continue;
@@ -3424,3 +3427,127 @@ test_rm_rolling_ch_proc_21(void **state) {
     RM_LOG_INFO("%s", "PASSED test #21 (NULL hashtable pointer)");
     return;
 }
+
+struct test_rm_22_producer
+{
+    struct rm_session   *s;
+    size_t              e_n;        /* delta elements to produce */
+    size_t              ok_n;       /* delta elements taken by queue */
+    enum rm_error       err;        /* first error returned by callback */
+};
+
+static void *
+test_rm_22_producer_f(void *arg) {
+    struct test_rm_22_producer  *p = arg;
+    struct rm_roll_proc_cb_arg  cb_arg;
+    struct rm_delta_e           *delta_e;
+    enum rm_error               err;
+
+    p->err = RM_ERR_OK;
+    for (p->ok_n = 0; p->ok_n < p->e_n; ++p->ok_n) {
+        delta_e = malloc(sizeof(*delta_e));
+        assert_true(delta_e != NULL);
+        memset(delta_e, 0, sizeof(*delta_e));
+        delta_e->type = RM_DELTA_ELEMENT_RAW_BYTES;
+        delta_e->raw_bytes_n = RM_TEST_5_22_RAW_N;
+        delta_e->raw_bytes = malloc(RM_TEST_5_22_RAW_N);
+        assert_true(delta_e->raw_bytes != NULL);
+        memset(delta_e->raw_bytes, p->ok_n & 0xff, RM_TEST_5_22_RAW_N);
+        TWINIT_LIST_HEAD(&delta_e->link);
+        cb_arg.delta_e = delta_e;
+        cb_arg.s = p->s;
+        err = rm_roll_proc_cb_1(&cb_arg);
+        if (err != RM_ERR_OK) {     /* ownership not taken */
+            free(delta_e->raw_bytes);
+            free(delta_e);
+            p->err = err;
+            break;
+        }
+    }
+    return NULL;
+}
+
+void
+test_rm_rolling_ch_proc_22(void **state) {
+    struct test_rm_state            *rm_state;
+    struct rm_session               *s;
+    struct rm_session_push_local    *prvt;
+    struct test_rm_22_producer      p;
+    pthread_t                       tid;
+    struct twlist_head              *lh;
+    struct rm_delta_e               *delta_e;
+    size_t                          charge, limit, limit_saved, i;
+    struct timespec                 ts = { 0, 1000000 };    /* 1 ms */
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    s = rm_state->s;
+    prvt = s->prvt;
+    assert_true(twlist_empty(&prvt->tx_delta_e_queue) != 0);
+
+    charge = sizeof(struct rm_delta_e) + RM_TEST_5_22_RAW_N;
+    limit = RM_TEST_5_22_E_IN_QUEUE * charge;
+    limit_saved = prvt->tx_delta_e_queue_limit;
+    memset(&s->rec_ctx, 0, sizeof(struct rm_delta_reconstruct_ctx));
+    pthread_mutex_lock(&prvt->tx_delta_e_queue_mutex);
+    prvt->tx_delta_e_queue_limit = limit;
+    prvt->tx_delta_e_queue_bytes = 0;
+    prvt->tx_delta_e_queue_bytes_peak = 0;
+    prvt->tx_delta_e_queue_stalls_n = 0;
+    prvt->tx_delta_e_queue_stall_time = 0;
+    prvt->tx_delta_e_queue_closed = 0;
+    pthread_mutex_unlock(&prvt->tx_delta_e_queue_mutex);
+
+    /* 1. slow consumer: producer stalls, queue never holds more than limit */
+    p.s = s;
+    p.e_n = RM_TEST_5_22_E_N;
+    assert_int_equal(pthread_create(&tid, NULL, test_rm_22_producer_f, &p), 0);
+    for (i = 0; i < RM_TEST_5_22_E_N; ++i) {
+        nanosleep(&ts, NULL);   /* let producer fill up the queue */
+        pthread_mutex_lock(&prvt->tx_delta_e_queue_mutex);
+        for (twfifo_dequeue(&prvt->tx_delta_e_queue, lh); lh == NULL; twfifo_dequeue(&prvt->tx_delta_e_queue, lh))
+            pthread_cond_wait(&prvt->tx_delta_e_queue_signal, &prvt->tx_delta_e_queue_mutex);
+        assert_true(prvt->tx_delta_e_queue_bytes <= limit);
+        delta_e = tw_container_of(lh, struct rm_delta_e, link);
+        assert_int_equal(delta_e->raw_bytes[0], i & 0xff);
+        prvt->tx_delta_e_queue_bytes -= rm_delta_e_queue_charge(delta_e);
+        pthread_cond_signal(&prvt->tx_delta_e_queue_space);
+        pthread_mutex_unlock(&prvt->tx_delta_e_queue_mutex);
+        free(delta_e->raw_bytes);
+        free(delta_e);
+    }
+    pthread_join(tid, NULL);
+    assert_int_equal(p.err, RM_ERR_OK);
+    assert_int_equal(p.ok_n, RM_TEST_5_22_E_N);
+    assert_int_equal(prvt->tx_delta_e_queue_bytes, 0);
+    assert_true(prvt->tx_delta_e_queue_bytes_peak <= limit);
+    assert_true(prvt->tx_delta_e_queue_stalls_n > 0);
+    assert_true(prvt->tx_delta_e_queue_stall_time > 0);
+    RM_LOG_INFO("Delta queue limit [%zu] bytes, peak [%zu] bytes, producer stalled [%zu] times for [%f] s",
+            limit, prvt->tx_delta_e_queue_bytes_peak, prvt->tx_delta_e_queue_stalls_n, prvt->tx_delta_e_queue_stall_time);
+
+    /* 2. no consumer: close wakes up producer blocked on full queue */
+    p.e_n = RM_TEST_5_22_E_N;
+    assert_int_equal(pthread_create(&tid, NULL, test_rm_22_producer_f, &p), 0);
+    for (;;) {
+        pthread_mutex_lock(&prvt->tx_delta_e_queue_mutex);
+        i = prvt->tx_delta_e_queue_bytes;
+        pthread_mutex_unlock(&prvt->tx_delta_e_queue_mutex);
+        if (i + charge > limit)
+            break;
+        nanosleep(&ts, NULL);
+    }
+    nanosleep(&ts, NULL);       /* let producer block */
+    rm_session_delta_queue_close(prvt);
+    pthread_join(tid, NULL);
+    assert_int_equal(p.err, RM_ERR_QUEUE_CLOSED);
+    assert_int_equal(p.ok_n, RM_TEST_5_22_E_IN_QUEUE);
+    assert_true(twlist_empty(&prvt->tx_delta_e_queue) != 0);
+    assert_int_equal(prvt->tx_delta_e_queue_bytes, 0);
+
+    pthread_mutex_lock(&prvt->tx_delta_e_queue_mutex);
+    prvt->tx_delta_e_queue_limit = limit_saved;
+    prvt->tx_delta_e_queue_closed = 0;
+    pthread_mutex_unlock(&prvt->tx_delta_e_queue_mutex);
+    RM_LOG_INFO("%s", "PASSED test #22 (delta queue limit and close)");
+}
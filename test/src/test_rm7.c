@@ -423,7 +423,7 @@ void test_rm_rx_process_delta_element_1(void **state)
 
             /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
             blocks_n_exp = y_sz / L + (y_sz % L ? 1 : 0);
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, y, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_y);
@@ -450,7 +450,7 @@ void test_rm_rx_process_delta_element_1(void **state)
             s->f_z = f_z->f;
             prvt->delta_tx_f = test_rm_roll_proc_cb_delta_element_call;    /* mock the callback */
             /* 1. run rolling checksum procedure */
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);
             assert_int_equal(err, RM_ERR_OK);
 
             /* verify s->prvt delta queue content */
@@ -828,7 +828,7 @@ void test_rm_rx_process_delta_element_2(void **state)
 
             /* split @y file into non-overlapping blocks and calculate checksums on these blocks, expected number of blocks is */
             blocks_n_exp = f_y_sz / L + (f_y_sz % L ? 1 : 0);
-            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, L, NULL, blocks_n_exp, &blocks_n, NULL);
+            err = rm_rx_insert_nonoverlapping_ch_ch_ref(0, f_y, f_y_name, h, RM_NONOVERLAPPING_HASH_BITS, L, NULL, blocks_n_exp, &blocks_n, NULL);
             assert_int_equal(err, RM_ERR_OK);
             assert_int_equal(blocks_n_exp, blocks_n);
             rewind(f_x);
@@ -857,7 +857,7 @@ void test_rm_rx_process_delta_element_2(void **state)
             s->f_z = f_z->f;
             prvt->delta_tx_f = test_rm_roll_proc_cb_delta_element_call;    /* mock the callback */
             /* 1. run rolling checksum procedure */
-            err = rm_rolling_ch_proc(s, h, NULL, s->f_x, prvt->delta_tx_f, 0);
+            err = rm_rolling_ch_proc(s, h, RM_NONOVERLAPPING_HASH_BITS, NULL, s->f_x, prvt->delta_tx_f, 0);
             assert_int_equal(err, RM_ERR_OK);
 
             /* verify s->prvt delta queue content */
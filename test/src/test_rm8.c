@@ -435,6 +435,7 @@ test_rm_tx_local_push_1(void **state) {
             assert_int_equal(rec_ctx.rec_by_raw, 0);
             assert_int_equal(rec_ctx.rec_by_ref, f_y_sz); /* in this test y_sz == file_sz is size of both @x and @y */
             assert_true(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
+            assert_true(rec_ctx.integrity == RM_INTEGRITY_OK || (rec_ctx.integrity == RM_INTEGRITY_NOT_CHECKED && rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == 0)); /* digest of @z must match digest of @x */
             assert_true(rec_ctx.delta_zero_diff_n == 0 || (rec_ctx.delta_zero_diff_n == 1 && rec_ctx.rec_by_ref == f_y_sz && rec_ctx.rec_by_zero_diff == f_y_sz && rec_ctx.delta_tail_n == 0 && rec_ctx.delta_raw_n == 0));
 
             f_x = fopen(buf_x_name, "rb+");
@@ -675,6 +676,7 @@ test_rm_tx_local_push_2(void **state) {
 
             assert_int_equal(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw, f_x_sz);  /* validate reconstruction ctx */
             assert_true(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
+            assert_true(rec_ctx.integrity == RM_INTEGRITY_OK || (rec_ctx.integrity == RM_INTEGRITY_NOT_CHECKED && rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == 0)); /* digest of @z must match digest of @x */
             assert_true(rec_ctx.delta_zero_diff_n == 0);
             assert_true(rec_ctx.rec_by_zero_diff == 0);
 
@@ -964,6 +966,7 @@ test_rm_tx_local_push_3(void **state) {
 
             assert_int_equal(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw, f_x_sz);  /* validate reconstruction ctx */
             assert_true(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
+            assert_true(rec_ctx.integrity == RM_INTEGRITY_OK || (rec_ctx.integrity == RM_INTEGRITY_NOT_CHECKED && rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == 0)); /* digest of @z must match digest of @x */
             assert_true(rec_ctx.delta_zero_diff_n == 0);
             assert_true(rec_ctx.rec_by_zero_diff == 0);
 
@@ -1260,6 +1263,7 @@ test_rm_tx_local_push_4(void **state) {
 
             assert_int_equal(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw, f_x_sz);  /* validate reconstruction ctx */
             assert_true(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
+            assert_true(rec_ctx.integrity == RM_INTEGRITY_OK || (rec_ctx.integrity == RM_INTEGRITY_NOT_CHECKED && rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == 0)); /* digest of @z must match digest of @x */
             assert_true(rec_ctx.delta_zero_diff_n == 0);
             assert_true(rec_ctx.rec_by_zero_diff == 0);
 
@@ -1656,6 +1660,7 @@ test_rm_tx_local_push_5(void **state) {
 
             assert_int_equal(rec_ctx.rec_by_ref + rec_ctx.rec_by_raw, f_x_sz);  /* validate reconstruction ctx */
             assert_true(rec_ctx.delta_tail_n == 0 || rec_ctx.delta_tail_n == 1);
+            assert_true(rec_ctx.integrity == RM_INTEGRITY_OK || (rec_ctx.integrity == RM_INTEGRITY_NOT_CHECKED && rec_ctx.rec_by_ref + rec_ctx.rec_by_raw == 0)); /* digest of @z must match digest of @x */
             assert_true(rec_ctx.delta_zero_diff_n == 0);
             assert_true(rec_ctx.rec_by_zero_diff == 0);
 
@@ -2983,3 +2988,66 @@ test_rm_tx_local_push_14(void **state) {
     RM_LOG_INFO("%s", "PASSED test #14 (zero send threshold, zero sized file)");
     return;
 }
+
+void
+test_rm_tx_local_push_15(void **state) {
+    enum rm_error           status;
+    struct test_rm_state    *rm_state;
+    FILE                    *f;
+    unsigned char           *x, *y, *z;
+    unsigned char           *b;
+    size_t                  i, sz = RM_TEST_8_NEXT_L * RM_TEST_8_NEXT_BLOCKS_N;
+    struct rm_delta_reconstruct_ctx rec_ctx;
+	struct rm_tx_options opt = { .loglevel = RM_LOGLEVEL_NORMAL };
+
+    rm_state = *state;
+    assert_true(rm_state != NULL);
+    x = malloc(sz);
+    y = malloc(sz);
+    z = malloc(sz);
+    assert_true(x != NULL && y != NULL && z != NULL);
+    for (i = 0; i < sz; ++i) {
+        y[i] = rand() % 256;
+    }
+    b = y + RM_TEST_8_NEXT_K * RM_TEST_8_NEXT_L + 100;
+    b[0] = b[1] = b[2] = 100;
+    memcpy(x, y, sz);
+    b = x + RM_TEST_8_NEXT_K * RM_TEST_8_NEXT_L + 100;
+    b[0] += 1;                                                          /* sum and sum of sums don't change */
+    b[1] -= 2;
+    b[2] += 1;
+    assert_int_equal(rm_fast_check_block(x + RM_TEST_8_NEXT_K * RM_TEST_8_NEXT_L, RM_TEST_8_NEXT_L), rm_fast_check_block(y + RM_TEST_8_NEXT_K * RM_TEST_8_NEXT_L, RM_TEST_8_NEXT_L));
+
+    f = fopen(RM_TEST_8_NEXT_F_X, "wb");
+    assert_true(f != NULL && fwrite(x, 1, sz, f) == sz);
+    fclose(f);
+    f = fopen(RM_TEST_8_NEXT_F_Y, "wb");
+    assert_true(f != NULL && fwrite(y, 1, sz, f) == sz);
+    fclose(f);
+
+    RM_LOG_INFO("%s", "Testing local push #15 [block following last match]");
+    memset(&rec_ctx, 0, sizeof (struct rm_delta_reconstruct_ctx));
+    status = rm_tx_local_push(RM_TEST_8_NEXT_F_X, RM_TEST_8_NEXT_F_Y, RM_TEST_8_NEXT_F_Z, RM_TEST_8_NEXT_L, 0, 0, RM_TEST_8_NEXT_L, RM_BIT_6, &rec_ctx, &opt);
+    assert_int_equal(status, RM_ERR_OK);
+    assert_int_equal(rec_ctx.next_tried_n, RM_TEST_8_NEXT_BLOCKS_N - 2);  /* all but 1st block and block after nonmatching one (found by lookup) */
+    assert_int_equal(rec_ctx.next_hit_n, RM_TEST_8_NEXT_BLOCKS_N - 3);    /* and block which only fast checksum matches */
+    assert_int_equal(rec_ctx.delta_ref_n, RM_TEST_8_NEXT_BLOCKS_N - 1);
+    assert_int_equal(rec_ctx.rec_by_ref, sz - RM_TEST_8_NEXT_L);
+    assert_int_equal(rec_ctx.rec_by_raw, RM_TEST_8_NEXT_L);
+
+    f = fopen(RM_TEST_8_NEXT_F_Z, "rb");
+    assert_true(f != NULL && fread(z, 1, sz, f) == sz);
+    fclose(f);
+    assert_memory_equal(x, z, sz);
+
+    if (RM_TEST_8_DELETE_FILES == 1) {
+        unlink(RM_TEST_8_NEXT_F_X);
+        unlink(RM_TEST_8_NEXT_F_Y);
+        unlink(RM_TEST_8_NEXT_F_Z);
+    }
+    free(x);
+    free(y);
+    free(z);
+    RM_LOG_INFO("%s", "PASSED test #15 (block following last match)");
+    return;
+}
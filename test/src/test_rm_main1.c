@@ -20,7 +20,9 @@ int main(void)
             cmocka_unit_test(test_rm_adler32_1),
 	        cmocka_unit_test(test_rm_adler32_2),
 	        cmocka_unit_test(test_rm_fast_check_roll),
-	        cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_array_1)
+	        cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_array_1),
+	        cmocka_unit_test(test_rm_roll_1),
+	        cmocka_unit_test(test_rm_roll_batch_1)
     };
     return cmocka_run_group_tests(tests,
 		test_rm_setup, test_rm_teardown);
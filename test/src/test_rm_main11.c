@@ -0,0 +1,26 @@
+/* @file        test_rm_main11.c
+ * @brief       Execution of test suite 11.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright	LGPLv2.1 */
+
+
+#include "rm_defs.h"
+#include "test_rm11.h"
+
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+	    cmocka_unit_test(test_rm_integrity_1),
+	    cmocka_unit_test(test_rm_integrity_2),
+	    cmocka_unit_test(test_rm_integrity_3),
+	    cmocka_unit_test(test_rm_tcp_chan_1),
+	    cmocka_unit_test(test_rm_tcp_chan_2),
+	    cmocka_unit_test(test_rm_tcp_chan_3),
+	    cmocka_unit_test(test_rm_tcp_chan_4),
+	    cmocka_unit_test(test_rm_codec_1),
+	    cmocka_unit_test(test_rm_codec_2)
+    };
+    return cmocka_run_group_tests(tests, test_rm_setup, test_rm_teardown);
+}
@@ -0,0 +1,22 @@
+/* @file        test_rm_main12.c
+ * @brief       Execution of test suite 12.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright	LGPLv2.1 */
+
+
+#include "rm_defs.h"
+#include "test_rm12.h"
+
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+	    cmocka_unit_test(test_rm_wq_1),
+	    cmocka_unit_test(test_rm_wq_2),
+	    cmocka_unit_test(test_rm_wq_3),
+	    cmocka_unit_test(test_rm_exec_1),
+	    cmocka_unit_test(test_rm_exec_2)
+    };
+    return cmocka_run_group_tests(tests, test_rm_setup, test_rm_teardown);
+}
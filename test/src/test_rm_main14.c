@@ -0,0 +1,20 @@
+/* @file        test_rm_main14.c
+ * @brief       Execution of test suite 14.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright	LGPLv2.1 */
+
+
+#include "rm_defs.h"
+#include "test_rm14.h"
+
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+	    cmocka_unit_test(test_rm_metrics_1),
+	    cmocka_unit_test(test_rm_metrics_2),
+	    cmocka_unit_test(test_rm_metrics_3)
+    };
+    return cmocka_run_group_tests(tests, test_rm_setup, test_rm_teardown);
+}
@@ -0,0 +1,22 @@
+/* @file        test_rm_main15.c
+ * @brief       Execution of test suite 15.
+ * @author      Piotr Gregor <piotrgregor@rsyncme.org>
+ * @version     0.1.3
+ * @date        19 Oct 2026 10:00 AM
+ * @copyright	LGPLv2.1 */
+
+
+#include "rm_defs.h"
+#include "test_rm15.h"
+
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+	    cmocka_unit_test(test_rm_zout_1),
+	    cmocka_unit_test(test_rm_zout_2),
+	    cmocka_unit_test(test_rm_zout_3),
+	    cmocka_unit_test(test_rm_zout_4),
+	    cmocka_unit_test(test_rm_zout_5)
+    };
+    return cmocka_run_group_tests(tests, test_rm_setup, test_rm_teardown);
+}
@@ -19,7 +19,9 @@ int main(void)
         cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_3),
         cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_4),
         cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_5),
-        cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_6)
+        cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_6),
+        cmocka_unit_test(test_rm_spill_1),
+        cmocka_unit_test(test_rm_spill_2)
     };
     return cmocka_run_group_tests(tests,
 		test_rm_setup, test_rm_teardown);
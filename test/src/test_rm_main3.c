@@ -16,7 +16,9 @@ int main(void)
 {
     const struct CMUnitTest tests[] = {
 	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_1),
-	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_2)
+	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_link_2),
+	    cmocka_unit_test(test_rm_crc32c_1),
+	    cmocka_unit_test(test_rm_md5_lanes_1)
     };
     return cmocka_run_group_tests(tests,
 		test_rm_setup, test_rm_teardown);
@@ -18,7 +18,8 @@ int main(void)
     const struct CMUnitTest tests[] = {
 	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_1),
 	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_2),
-	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_3)
+	    cmocka_unit_test(test_rm_rx_insert_nonoverlapping_ch_ch_ref_3),
+	    cmocka_unit_test(test_rm_rx_ch_ch_hash_bits_1)
     };
     return cmocka_run_group_tests(tests,
 		test_rm_setup, test_rm_teardown);
@@ -25,7 +25,8 @@ int main(void) {
 	    cmocka_unit_test(test_rm_tx_local_push_11),
 	    cmocka_unit_test(test_rm_tx_local_push_12),
 	    cmocka_unit_test(test_rm_tx_local_push_13),
-	    cmocka_unit_test(test_rm_tx_local_push_14)
+	    cmocka_unit_test(test_rm_tx_local_push_14),
+	    cmocka_unit_test(test_rm_tx_local_push_15)
     };
     return cmocka_run_group_tests(tests,
 		test_rm_setup, test_rm_teardown);